@@ -1,33 +0,0 @@
-/*
- * colorspace.h:  Routines to perform colorspace conversions.
- *
- *
- *  Copyright (C) 2001 Matthew J. Marjanovic <maddog@mir.com>
- *
- *
- *  This program is free software; you can redistribute it and/or
- *  modify it under the terms of the GNU General Public License
- *  as published by the Free Software Foundation; either version 2
- *  of the License, or (at your option) any later version.
- *
- *  This program is distributed in the hope that it will be useful,
- *  but WITHOUT ANY WARRANTY; without even the implied warranty of
- *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- *  GNU General Public License for more details.
- *
- *  You should have received a copy of the GNU General Public License
- *  along with this program; if not, write to the Free Software
- *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
- *
- */
-
-
-
-void convert_RGB_to_YCbCr(uint8_t *planes[], int length);
-
-
-void convert_YCbCr_to_RGB(uint8_t *planes[], int length);
-
-void convert_Y255_to_Y219(uint8_t *plane, int length);
-void convert_Y219_to_Y255(uint8_t *plane, int length);
-
@@ -48,8 +48,7 @@ png2yuv
 #include "yuv4mpeg.h"
 #include "mpegconsts.h"
 
-#include "subsample.h"
-#include "colorspace.h"
+#include "y4mconvert.h"
 
 #define DEFAULT_CHROMA_MODE Y4M_CHROMA_420JPEG
 
@@ -65,7 +64,7 @@ typedef struct _parameters
 
   png_uint_32 width;
   png_uint_32 height;
-  int ss_mode; /**< subsampling mode (based on ssm_id from subsample.h) */
+  int ss_mode; /**< subsampling mode (a Y4M_CHROMA_* mode) */
 
   int new_width; /// new MPEG2 width, in case the original one is uneven
   int new_height; /// new MPEG2 width, in case the original one is uneven
@@ -170,7 +169,7 @@ static void parse_commandline(int argc, char ** argv, parameters_t *param)
       param->ss_mode = y4m_chroma_parse_keyword(optarg);
       if (param->ss_mode == Y4M_UNKNOWN) {
 	mjpeg_error_exit1("Unknown subsampling mode option:  %s", optarg);
-      } else if (!chroma_sub_implemented(param->ss_mode)) {
+      } else if (!y4m_chroma_sub_implemented(param->ss_mode)) {
 	mjpeg_error_exit1("Unsupported subsampling mode option:  %s", optarg);
       }
       break;
@@ -491,8 +490,8 @@ static int generate_YUV4MPEG(parameters_t *param)
 	{
 	  mjpeg_debug("Converting frame to YUV format.");
 	  /* Transform colorspace, then subsample (in place) */
-	  convert_RGB_to_YCbCr(yuv, param->new_height *  param->new_width);
-	  chroma_subsample(param->ss_mode, yuv, param->new_width, param->new_height);
+	  y4m_convert_RGB_to_YCbCr(yuv, param->new_height *  param->new_width);
+	  y4m_chroma_subsample(param->ss_mode, yuv, param->new_width, param->new_height);
 
 	  mjpeg_debug("Frame decoded, now writing to output stream.");
 	}
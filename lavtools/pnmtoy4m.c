@@ -36,7 +36,7 @@
 
 #include <yuv4mpeg.h>
 #include <mpegconsts.h>
-#include "colorspace.h"
+#include <y4mconvert.h>
 
 #ifndef O_BINARY
 # define O_BINARY 0
@@ -861,15 +861,15 @@ int main(int argc, char **argv)
       switch (pnm.format) {
       case FMT_PPM_PLAIN:
       case FMT_PPM_RAW:
-        convert_RGB_to_YCbCr(planes, pnm.width * pnm.height);
+        y4m_convert_RGB_to_YCbCr(planes, pnm.width * pnm.height);
         if (cl.deinterleave)
-          convert_RGB_to_YCbCr(planes2, pnm.width * pnm.height);
+          y4m_convert_RGB_to_YCbCr(planes2, pnm.width * pnm.height);
         break;
       case FMT_PGM_PLAIN:
       case FMT_PGM_RAW:
-        convert_Y255_to_Y219(planes[0], pnm.width * pnm.height);
+        y4m_convert_Y255_to_Y219(planes[0], pnm.width * pnm.height);
         if (cl.deinterleave)
-          convert_Y255_to_Y219(planes2[0], pnm.width * pnm.height);
+          y4m_convert_Y255_to_Y219(planes2[0], pnm.width * pnm.height);
         break;
       case FMT_PBM_PLAIN:
       case FMT_PBM_RAW:
@@ -878,21 +878,21 @@ int main(int argc, char **argv)
       case FMT_PAM:
         switch (pnm.tupl) {
         case TUPL_RGB:
-          convert_RGB_to_YCbCr(planes, pnm.width * pnm.height);
+          y4m_convert_RGB_to_YCbCr(planes, pnm.width * pnm.height);
           if (cl.deinterleave)
-            convert_RGB_to_YCbCr(planes2, pnm.width * pnm.height);
+            y4m_convert_RGB_to_YCbCr(planes2, pnm.width * pnm.height);
           break;
         case TUPL_GRAY:
-          convert_Y255_to_Y219(planes[0], pnm.width * pnm.height);
+          y4m_convert_Y255_to_Y219(planes[0], pnm.width * pnm.height);
           if (cl.deinterleave)
-            convert_Y255_to_Y219(planes2[0], pnm.width * pnm.height);
+            y4m_convert_Y255_to_Y219(planes2[0], pnm.width * pnm.height);
           break;
         case TUPL_RGB_ALPHA:
-          convert_RGB_to_YCbCr(planes, pnm.width * pnm.height);
-          convert_Y255_to_Y219(planes[3], pnm.width * pnm.height);
+          y4m_convert_RGB_to_YCbCr(planes, pnm.width * pnm.height);
+          y4m_convert_Y255_to_Y219(planes[3], pnm.width * pnm.height);
           if (cl.deinterleave) {
-            convert_RGB_to_YCbCr(planes2, pnm.width * pnm.height);
-            convert_Y255_to_Y219(planes2[3], pnm.width * pnm.height);
+            y4m_convert_RGB_to_YCbCr(planes2, pnm.width * pnm.height);
+            y4m_convert_Y255_to_Y219(planes2[3], pnm.width * pnm.height);
           }
           break;
         case TUPL_GRAY_ALPHA:
@@ -35,8 +35,7 @@
 
 #include <yuv4mpeg.h>
 #include <mpegconsts.h>
-#include "subsample.h"
-#include "colorspace.h"
+#include <y4mconvert.h>
 
 #ifndef O_BINARY
 # define O_BINARY 0
@@ -102,7 +101,7 @@ void usage(const char *progname)
     for (m = 0;
 	 (keyword = y4m_chroma_keyword(m)) != NULL;
 	 m++)
-      if (chroma_sub_implemented(m))
+      if (y4m_chroma_sub_implemented(m))
 	fprintf(stderr, "            '%s' -> %s\n",
 		keyword, y4m_chroma_description(m));
   }
@@ -177,7 +176,7 @@ void parse_args(cl_info_t *cl, int argc, char **argv)
       if (cl->ss_mode == Y4M_UNKNOWN) {
 	mjpeg_error("Unknown subsampling mode option:  %s", optarg);
 	goto ERROR_EXIT;
-      } else if (!chroma_sub_implemented(cl->ss_mode)) {
+      } else if (!y4m_chroma_sub_implemented(cl->ss_mode)) {
 	mjpeg_error("Unsupported subsampling mode option:  %s", optarg);
 	goto ERROR_EXIT;
       }
@@ -327,7 +326,7 @@ void read_ppm_into_two_buffers(int fd,
 			       uint8_t *rowbuffer,
 			       int width, int height, int bgr)
 {
-  int x, y;
+  int y;
   uint8_t *pixels;
   uint8_t *R = buffers[0];
   uint8_t *G = buffers[1];
@@ -342,35 +341,19 @@ void read_ppm_into_two_buffers(int fd,
     pixels = rowbuffer;
     if (y4m_read(fd, pixels, width * 3))
       mjpeg_error_exit1("read error A  y=%d", y);
-    if (bgr) {
-      for (x = 0; x < width; x++) {
-	*(B++) = *(pixels++);
-	*(G++) = *(pixels++);
-	*(R++) = *(pixels++);
-      }
-    } else {
-      for (x = 0; x < width; x++) {
-	*(R++) = *(pixels++);
-	*(G++) = *(pixels++);
-	*(B++) = *(pixels++);
-      }
-    }
+    if (bgr)
+      y4m_unpack_rgb(B, G, R, pixels, width);
+    else
+      y4m_unpack_rgb(R, G, B, pixels, width);
+    R += width;  G += width;  B += width;
     pixels = rowbuffer;
     if (y4m_read(fd, pixels, width * 3))
       mjpeg_error_exit1("read error B  y=%d", y);
-    if (bgr) {
-      for (x = 0; x < width; x++) {
-	*(B2++) = *(pixels++);
-	*(G2++) = *(pixels++);
-	*(R2++) = *(pixels++);
-      }
-    } else {
-      for (x = 0; x < width; x++) {
-	*(R2++) = *(pixels++);
-	*(G2++) = *(pixels++);
-	*(B2++) = *(pixels++);
-      }
-    }
+    if (bgr)
+      y4m_unpack_rgb(B2, G2, R2, pixels, width);
+    else
+      y4m_unpack_rgb(R2, G2, B2, pixels, width);
+    R2 += width;  G2 += width;  B2 += width;
   }
 }
 
@@ -382,7 +365,7 @@ void read_ppm_into_one_buffer(int fd,
 			      uint8_t *rowbuffer,
 			      int width, int height, int bgr) 
 {
-  int x, y;
+  int y;
   uint8_t *pixels;
   uint8_t *R = buffers[0];
   uint8_t *G = buffers[1];
@@ -391,19 +374,11 @@ void read_ppm_into_one_buffer(int fd,
   for (y = 0; y < height; y++) {
     pixels = rowbuffer;
     y4m_read(fd, pixels, width * 3);
-    if (bgr) {
-      for (x = 0; x < width; x++) {
-	*(B++) = *(pixels++);
-	*(G++) = *(pixels++);
-	*(R++) = *(pixels++);
-      }
-    } else {
-      for (x = 0; x < width; x++) {
-	*(R++) = *(pixels++);
-	*(G++) = *(pixels++);
-	*(B++) = *(pixels++);
-      }
-    }
+    if (bgr)
+      y4m_unpack_rgb(B, G, R, pixels, width);
+    else
+      y4m_unpack_rgb(R, G, B, pixels, width);
+    R += width;  G += width;  B += width;
   }
 }
 
@@ -598,11 +573,11 @@ int main(int argc, char **argv)
        because we don't know when we will see the last one. */
     if ((count >= cl.offset) || (cl.repeatlast)) {
       /* Transform colorspace, then subsample (in place) */
-      convert_RGB_to_YCbCr(buffers, ppm.width * field_height);
-      chroma_subsample(cl.ss_mode, buffers, ppm.width, field_height);
+      y4m_convert_RGB_to_YCbCr(buffers, ppm.width * field_height);
+      y4m_chroma_subsample(cl.ss_mode, buffers, ppm.width, field_height);
       if (cl.interlace != Y4M_ILACE_NONE) {
-	convert_RGB_to_YCbCr(buffers2, ppm.width * field_height);
-	chroma_subsample(cl.ss_mode, buffers2, ppm.width, field_height);
+	y4m_convert_RGB_to_YCbCr(buffers2, ppm.width * field_height);
+	y4m_chroma_subsample(cl.ss_mode, buffers2, ppm.width, field_height);
       }
     }
 
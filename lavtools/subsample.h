@@ -1,33 +0,0 @@
-/*
- * subsample.h:  Routines to do chroma subsampling.  ("Work In Progress")
- *
- *
- *  Copyright (C) 2001 Matthew J. Marjanovic <maddog@mir.com>
- *
- *
- *  This program is free software; you can redistribute it and/or
- *  modify it under the terms of the GNU General Public License
- *  as published by the Free Software Foundation; either version 2
- *  of the License, or (at your option) any later version.
- *
- *  This program is distributed in the hope that it will be useful,
- *  but WITHOUT ANY WARRANTY; without even the implied warranty of
- *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
- *  GNU General Public License for more details.
- *
- *  You should have received a copy of the GNU General Public License
- *  along with this program; if not, write to the Free Software
- *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
- *
- */
-
-
-
-#include "yuv4mpeg.h"
-
-
-int chroma_sub_implemented(int mode);
-void chroma_subsample(int mode, uint8_t *ycbcr[], int width, int height);
-
-int chroma_super_implemented(int mode);
-void chroma_supersample(int mode, uint8_t *ycbcr[], int width, int height);
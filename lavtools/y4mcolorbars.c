@@ -33,8 +33,7 @@
 #include <yuv4mpeg.h>
 #include <mpegconsts.h>
 
-#include "subsample.h"
-#include "colorspace.h"
+#include <y4mconvert.h>
 
 #define DEFAULT_CHROMA_MODE Y4M_CHROMA_444
 
@@ -91,7 +90,7 @@ void usage(const char *progname)
     for (m = 0;
 	 (keyword = y4m_chroma_keyword(m)) != NULL;
 	 m++)
-      if (chroma_sub_implemented(m))
+      if (y4m_chroma_sub_implemented(m))
 	fprintf(stderr, "            '%s' -> %s\n",
 		keyword, y4m_chroma_description(m));
   }
@@ -164,7 +163,7 @@ void parse_args(cl_info_t *cl, int argc, char **argv)
       if (cl->ss_mode == Y4M_UNKNOWN) {
 	mjpeg_error("Unknown subsampling mode option:  %s", optarg);
 	goto ERROR_EXIT;
-      } else if (!chroma_sub_implemented(cl->ss_mode)) {
+      } else if (!y4m_chroma_sub_implemented(cl->ss_mode)) {
 	mjpeg_error("Unsupported subsampling mode option:  %s", optarg);
 	goto ERROR_EXIT;
       }
@@ -372,8 +371,8 @@ void create_bars(uint8_t *ycbcr[], int width, int height, int iq_mode)
   uint8_t *i_pixel;
   uint8_t *q_pixel;
 
-  convert_RGB_to_YCbCr(rainbow, 7);
-  convert_RGB_to_YCbCr(wobnair, 7);
+  y4m_convert_RGB_to_YCbCr(rainbow, 7);
+  y4m_convert_RGB_to_YCbCr(wobnair, 7);
 
   switch (iq_mode) {
   case IQ_MODE_CBCR100:
@@ -528,7 +527,7 @@ int main(int argc, char **argv)
   for (i = 0; i < 3; i++)
     planes[i] = malloc(cl.width * cl.height * sizeof(planes[i][0]));
   create_bars(planes, cl.width, cl.height, cl.iq_mode);
-  chroma_subsample(cl.ss_mode, planes, cl.width, cl.height);
+  y4m_chroma_subsample(cl.ss_mode, planes, cl.width, cl.height);
 
   /* We're on the air! */
   for (i = 0; i < cl.framecount; i++) {
@@ -56,7 +56,7 @@
 #include <limits.h>
 
 #include "yuv4mpeg.h"
-#include "subsample.h"
+#include "y4mconvert.h"
 
 struct
     {
@@ -601,7 +601,7 @@ int ss_h = dosuper ? 1 : SS_H;
 int ss_v = dosuper ? 1 : SS_V;
 /* If we have to supersample the chroma, then do it now, before shifting */
 if (dosuper)
-chroma_supersample(Y4M_CHROMA_420JPEG, yuv1, w, h);
+y4m_chroma_supersample(Y4M_CHROMA_420JPEG, yuv1, w, h);
 /* Do the horizontal shifting first.  The frame is shifted into
 * the yuv2 frame. Even if there is no horizontal shifting to do,
 * we copy the frame because the vertical shift is desctructive,
@@ -619,7 +619,7 @@ vertical_shift(yuv2[2], shift->y/ss_v, w/ss_h, ws/ss_h, h/ss_v, 128);
 }
 /* Undo the supersampling */
 if (dosuper)
-chroma_subsample(Y4M_CHROMA_420JPEG, yuv1, w, h);
+y4m_chroma_subsample(Y4M_CHROMA_420JPEG, yuv1, w, h);
 }
 
 /*
@@ -36,7 +36,7 @@
 
 #include <yuv4mpeg.h>
 #include <mpegconsts.h>
-#include "colorspace.h"
+#include <y4mconvert.h>
 
 
 /* command-line parameters */
@@ -428,14 +428,14 @@ void convert_chroma(int chroma, uint8_t *buffers[], int width, int height)
 {
   switch (chroma) {
   case Y4M_CHROMA_444:
-    convert_YCbCr_to_RGB(buffers, width * height);
+    y4m_convert_YCbCr_to_RGB(buffers, width * height);
     break;
   case Y4M_CHROMA_444ALPHA:
-    convert_YCbCr_to_RGB(buffers, width * height);
-    convert_Y219_to_Y255(buffers[3], width * height);
+    y4m_convert_YCbCr_to_RGB(buffers, width * height);
+    y4m_convert_Y219_to_Y255(buffers[3], width * height);
     break;
   case Y4M_CHROMA_MONO:
-    convert_Y219_to_Y255(buffers[0], width * height);
+    y4m_convert_Y219_to_Y255(buffers[0], width * height);
     break;
   default:
     assert(0);  break;
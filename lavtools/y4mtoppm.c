@@ -35,8 +35,7 @@
 
 #include <yuv4mpeg.h>
 #include <mpegconsts.h>
-#include "subsample.h"
-#include "colorspace.h"
+#include <y4mconvert.h>
 
 
 /* command-line parameters */
@@ -121,8 +120,7 @@ void write_ppm_from_two_buffers(FILE *fp,
 				uint8_t *rowbuffer,
 				int width, int height)
 {
-  int x, y;
-  uint8_t *pixels;
+  int y;
   uint8_t *R = buffers[0];
   uint8_t *G = buffers[1];
   uint8_t *B = buffers[2];
@@ -133,19 +131,11 @@ void write_ppm_from_two_buffers(FILE *fp,
   mjpeg_debug("write PPM image from two buffers, %dx%d", width, height);
   fprintf(fp, "P6\n%d %d 255\n", width, height);
   for (y = 0; y < height; y += 2) {
-    pixels = rowbuffer;
-    for (x = 0; x < width; x++) {
-      *(pixels++) = *(R++);
-      *(pixels++) = *(G++);
-      *(pixels++) = *(B++);
-    }
+    y4m_pack_rgb(rowbuffer, R, G, B, width);
+    R += width;  G += width;  B += width;
     fwrite(rowbuffer, sizeof(rowbuffer[0]), width * 3, fp);
-    pixels = rowbuffer;
-    for (x = 0; x < width; x++) {
-      *(pixels++) = *(R2++);
-      *(pixels++) = *(G2++);
-      *(pixels++) = *(B2++);
-    }
+    y4m_pack_rgb(rowbuffer, R2, G2, B2, width);
+    R2 += width;  G2 += width;  B2 += width;
     fwrite(rowbuffer, sizeof(rowbuffer[0]), width * 3, fp);
   }
 }
@@ -158,8 +148,7 @@ void write_ppm_from_one_buffer(FILE *fp,
 			       uint8_t *rowbuffer,
 			       int width, int height) 
 {
-  int x, y;
-  uint8_t *pixels;
+  int y;
   uint8_t *R = buffers[0];
   uint8_t *G = buffers[1];
   uint8_t *B = buffers[2];
@@ -167,12 +156,8 @@ void write_ppm_from_one_buffer(FILE *fp,
   mjpeg_debug("write PPM image from one buffer, %dx%d", width, height);
   fprintf(fp, "P6\n%d %d 255\n", width, height);
   for (y = 0; y < height; y++) {
-    pixels = rowbuffer;
-    for (x = 0; x < width; x++) {
-      *(pixels++) = *(R++);
-      *(pixels++) = *(G++);
-      *(pixels++) = *(B++);
-    }
+    y4m_pack_rgb(rowbuffer, R, G, B, width);
+    R += width;  G += width;  B += width;
     fwrite(rowbuffer, sizeof(rowbuffer[0]), width * 3, fp);
   }
 }
@@ -216,7 +201,7 @@ int main(int argc, char **argv)
     mjpeg_error("Cannot (yet) handle 'mixed' interlacing mode!");
     exit(1);
   }
-  if (!chroma_super_implemented(chroma))
+  if (!y4m_chroma_super_implemented(chroma))
     mjpeg_error_exit1("Cannot handle stream's chroma mode!");
     
   /*** Allocate buffers ***/
@@ -245,10 +230,10 @@ int main(int argc, char **argv)
       if (err != Y4M_OK) break;
       if (chroma != Y4M_CHROMA_444) {
 	mjpeg_debug("supersampling noninterlaced frame...");
-	chroma_supersample(chroma, buffers, width, height);
+	y4m_chroma_supersample(chroma, buffers, width, height);
       }
       mjpeg_debug("color converting noninterlaced frame...");
-      convert_YCbCr_to_RGB(buffers, width * height);
+      y4m_convert_YCbCr_to_RGB(buffers, width * height);
       write_ppm_from_one_buffer(cl.outfp, buffers, rowbuffer, width, height);
     } else {
       err = y4m_read_fields(in_fd, &streaminfo, &frameinfo, 
@@ -256,14 +241,14 @@ int main(int argc, char **argv)
       if (err != Y4M_OK) break;
       if (chroma != Y4M_CHROMA_444) {
 	mjpeg_debug("supersampling top field...");
-	chroma_supersample(chroma, buffers, width, height / 2);
+	y4m_chroma_supersample(chroma, buffers, width, height / 2);
 	mjpeg_debug("supersampling bottom field...");
-	chroma_supersample(chroma, buffers2, width, height / 2);
+	y4m_chroma_supersample(chroma, buffers2, width, height / 2);
       }
       mjpeg_debug("color converting top field...");
-      convert_YCbCr_to_RGB(buffers, width * height / 2);
+      y4m_convert_YCbCr_to_RGB(buffers, width * height / 2);
       mjpeg_debug("color converting bottom field...");
-      convert_YCbCr_to_RGB(buffers2, width * height / 2);
+      y4m_convert_YCbCr_to_RGB(buffers2, width * height / 2);
       if (cl.interleave) {
 	write_ppm_from_two_buffers(cl.outfp, buffers, buffers2, 
 				   rowbuffer, width, height);
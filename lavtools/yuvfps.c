@@ -115,12 +115,7 @@ static void resample(  int fdIn
   long long          srcInc ;
   long long          dstInc ;
   long long          currCount ;
-  int i;
 
-  // Allocate memory for the YUV channels
-  for (i = 0; i < y4m_si_get_plane_count(inStrInfo); i++)
-    yuv_data[i] = (uint8_t *) checked_malloc(y4m_si_get_plane_length(inStrInfo, i));
- 
   /* Initialize counters */
   srcInc = (long long)src_frame_rate.n * (long long)frame_rate.d ;
   dstInc = (long long)frame_rate.n * (long long)src_frame_rate.d ;
@@ -130,28 +125,30 @@ static void resample(  int fdIn
   src_frame_counter = 0 ;
   dest_frame_counter = 0 ;
   y4m_init_frame_info( &in_frame );
-  read_error_code = y4m_read_frame(fdIn,inStrInfo,&in_frame,yuv_data );
+  // Frames are passed through as borrowed from the reader, uncopied
+  read_error_code = y4m_borrow_frame(fdIn,inStrInfo,&in_frame,yuv_data );
   ++src_frame_counter ;
   currCount = 0 ;
 
-  while( Y4M_ERR_EOF != read_error_code && write_error_code == Y4M_OK ) {
+  // Only frames that were read completely are written out
+  while( read_error_code == Y4M_OK && write_error_code == Y4M_OK ) {
     write_error_code = y4m_write_frame( fdOut, outStrInfo, &in_frame, yuv_data );
     mjpeg_info( "Writing source frame %d at dest frame %d", src_frame_counter,++dest_frame_counter );
     currCount += srcInc ;
-    while( currCount >= dstInc && Y4M_ERR_EOF != read_error_code ) {
+    while( currCount >= dstInc && read_error_code == Y4M_OK ) {
       currCount -= dstInc ;
       ++src_frame_counter ;
+      y4m_release_frame( yuv_data );
       y4m_fini_frame_info( &in_frame );
       y4m_init_frame_info( &in_frame );
-      read_error_code = y4m_read_frame(fdIn, inStrInfo,&in_frame,yuv_data );
+      read_error_code = y4m_borrow_frame(fdIn, inStrInfo,&in_frame,yuv_data );
     }
   }
   
   // Clean-up regardless an error happened or not
+  if( read_error_code == Y4M_OK )
+    y4m_release_frame( yuv_data );
   y4m_fini_frame_info( &in_frame );
-  for (i = 0; i < y4m_si_get_plane_count(inStrInfo); i++) {
-    free( yuv_data[i] );
-  }
 
   if( read_error_code != Y4M_ERR_EOF )
     mjpeg_error_exit1 ("Error reading from input stream!");
@@ -71,6 +71,7 @@
 #include "mpeg2coder.hh"
 #include "format_codes.h"
 #include "mpegconsts.h"
+#include "y4mconvert.h"
 
 #ifdef HAVE_ALTIVEC
 /* needed for ALTIVEC_BENCHMARK and print_benchmark_statistics() */
@@ -146,8 +147,11 @@ protected:
     bool LoadFrame( ImagePlanes &image );
 private:
     int PipeRead(  uint8_t *buf, int len);
+    int RowRead( uint8_t *row, int len);
 
     int pipe_fd;
+    int bitdepth;
+    uint8_t *deep_row;          // one row of input with bitdepth > 8
     y4m_stream_info_t _si;
     y4m_frame_info_t _fi;
 };
@@ -155,7 +159,9 @@ private:
 
 Y4MPipeReader::Y4MPipeReader( EncoderParams &encparams, int istrm_fd ) :
     PictureReader( encparams ),
-    pipe_fd( istrm_fd )
+    pipe_fd( istrm_fd ),
+    bitdepth( 8 ),
+    deep_row( 0 )
 {
     y4m_init_stream_info(&_si);
     y4m_init_frame_info(&_fi);
@@ -166,6 +172,7 @@ Y4MPipeReader::~Y4MPipeReader()
 {
     y4m_fini_stream_info(&_si);
     y4m_fini_frame_info(&_fi);
+    delete [] deep_row;
 }
 
 
@@ -185,10 +192,31 @@ void Y4MPipeReader::StreamPictureParams( MPEG2EncInVidParams &strm )
    int n;
    y4m_ratio_t sar;
 
+   /* Deeper than 8 bit input is reduced to 8 bits here, and only here */
+   if (y4m_accept_extensions(-1) < 2)
+       y4m_accept_extensions(2);
    if ((n = y4m_read_stream_header (pipe_fd, &_si)) != Y4M_OK) {
        mjpeg_error("Could not read YUV4MPEG2 header: %s!", y4m_strerr(n));
       exit (1);
    }
+   switch (y4m_si_get_chroma(&_si)) {
+   case Y4M_CHROMA_420JPEG:
+   case Y4M_CHROMA_420MPEG2:
+   case Y4M_CHROMA_420PALDV:
+       if (y4m_si_get_interlace(&_si) != Y4M_ILACE_MIXED)
+           break;
+       /* fall through */
+   default:
+       mjpeg_error("Could not read YUV4MPEG2 header: %s!",
+                   y4m_strerr(Y4M_ERR_FEATURE));
+       exit (1);
+   }
+   bitdepth = y4m_si_get_bitdepth(&_si);
+   if (bitdepth > 8)
+   {
+       mjpeg_info("Reducing %d bit input samples to 8 bits", bitdepth);
+       deep_row = new uint8_t[2 * y4m_si_get_width(&_si)];
+   }
 
    strm.horizontal_size = y4m_si_get_width(&_si);
    strm.vertical_size = y4m_si_get_height(&_si);
@@ -238,7 +266,7 @@ bool Y4MPipeReader::LoadFrame( ImagePlanes &image )
    int i;
    for(i=0;i<v;i++)
    {
-       if( PipeRead(image.Plane(0)+i*encparams.phy_width,h)!=h)
+       if( RowRead(image.Plane(0)+i*encparams.phy_width,h)!=h)
            return true;
    }
 
@@ -246,12 +274,12 @@ bool Y4MPipeReader::LoadFrame( ImagePlanes &image )
    h = encparams.horizontal_size/2;
    for(i=0;i<v;i++)
    {
-       if(PipeRead(image.Plane(1)+i*encparams.phy_chrom_width,h)!=h)
+       if(RowRead(image.Plane(1)+i*encparams.phy_chrom_width,h)!=h)
            return true;
    }
    for(i=0;i<v;i++)
    {
-       if(PipeRead(image.Plane(2)+i*encparams.phy_chrom_width,h)!=h)
+       if(RowRead(image.Plane(2)+i*encparams.phy_chrom_width,h)!=h)
            return true;
    }
    return false;
@@ -261,17 +289,21 @@ bool Y4MPipeReader::LoadFrame( ImagePlanes &image )
 
 int Y4MPipeReader::PipeRead(uint8_t *buf, int len)
 {
-   int n, r;
+   /* y4m_read() also returns data read ahead with the frame header */
+   ssize_t left = y4m_read(pipe_fd, buf, len);
 
-   r = 0;
+   return left == 0 ? len : len - static_cast<int>(left < 0 ? -left : left);
+}
 
-   while(r<len)
-   {
-      n = read(pipe_fd,buf+r,len-r);
-      if(n==0) return r;
-      r += n;
-   }
-   return r;
+/* Read 'len' samples into 'row', reducing them to 8 bits if need be */
+int Y4MPipeReader::RowRead(uint8_t *row, int len)
+{
+   if( bitdepth <= 8 )
+       return PipeRead(row, len);
+   if( PipeRead(deep_row, 2*len) != 2*len )
+       return 0;
+   y4m_convert_deep_to_8(row, deep_row, bitdepth, len);
+   return len;
 }
 
 
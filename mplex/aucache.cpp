@@ -0,0 +1,206 @@
+/*
+ *  aucache.cpp:  Cache of the access units scanned from an elementary
+ *                stream so that repeated multiplexing runs on the same
+ *                input can skip parsing it.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mjpeg_logging.h"
+#include "aucache.hpp"
+
+#define AU_CACHE_MAGIC      "MPLXAUC"
+#define AU_CACHE_VERSION    1
+
+/* Header and AU records are written as they are held in memory */
+struct AUCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t key_len;
+    uint32_t state_len;
+    uint64_t aus;
+};
+
+struct AUCacheRecord
+{
+    uint64_t start;
+    int64_t  PTS;
+    int64_t  DTS;
+    uint32_t length;
+    int32_t  dorder;
+    int32_t  porder;
+    uint32_t type;
+    uint8_t  seq_header;
+    uint8_t  end_seq;
+    uint8_t  reserved[6];
+};
+
+AUCache::AUCache( const char *cache_dir, const char *_key ) :
+    key( _key ),
+    replaying( false ),
+    replay_next( 0 )
+{
+    // FNV-1a hash of the key names the file, the key itself is
+    // checked on loading.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for( const char *p = _key; *p != '\0'; ++p )
+    {
+        hash ^= static_cast<uint8_t>(*p);
+        hash *= 0x100000001b3ULL;
+    }
+    char name[32];
+    snprintf( name, sizeof(name), "/%016llx.auc",
+              static_cast<unsigned long long>(hash) );
+    path = std::string(cache_dir) + name;
+}
+
+bool AUCache::Load()
+{
+    FILE *f = fopen( path.c_str(), "rb" );
+    if( f == NULL )
+        return false;
+
+    AUCacheHeader hdr;
+    std::vector<char> file_key;
+    struct stat st;
+    bool ok =
+        fstat( fileno( f ), &st ) == 0
+        && fread( &hdr, sizeof(hdr), 1, f ) == 1
+        && memcmp( hdr.magic, AU_CACHE_MAGIC, sizeof(AU_CACHE_MAGIC) ) == 0
+        && hdr.version == AU_CACHE_VERSION
+        && hdr.record_size == sizeof(AUCacheRecord)
+        && hdr.key_len == key.size();
+    // The counts must fit the file before anything is allocated for them
+    if( ok )
+    {
+        uint64_t size = static_cast<uint64_t>(st.st_size) - sizeof(hdr);
+        ok = hdr.state_len <= size / sizeof(double)
+            && hdr.aus <= size / sizeof(AUCacheRecord)
+            && sizeof(hdr) + hdr.key_len
+               + hdr.state_len * sizeof(double)
+               + hdr.aus * sizeof(AUCacheRecord)
+               == static_cast<uint64_t>(st.st_size);
+    }
+    if( ok )
+    {
+        file_key.resize( hdr.key_len );
+        scan_state.resize( hdr.state_len );
+        ok = fread( &file_key[0], 1, hdr.key_len, f ) == hdr.key_len
+            && memcmp( &file_key[0], key.data(), hdr.key_len ) == 0
+            && ( hdr.state_len == 0
+                 || fread( &scan_state[0], sizeof(double), hdr.state_len, f )
+                    == hdr.state_len );
+    }
+
+    AUCacheRecord rec;
+    AUnit unit;
+    aus.clear();
+    aus.reserve( ok ? hdr.aus : 0 );
+    for( uint64_t i = 0; ok && i < hdr.aus; ++i )
+    {
+        ok = fread( &rec, sizeof(rec), 1, f ) == 1;
+        unit.start = rec.start;
+        unit.length = rec.length;
+        unit.PTS = rec.PTS;
+        unit.DTS = rec.DTS;
+        unit.dorder = rec.dorder;
+        unit.porder = rec.porder;
+        unit.type = rec.type;
+        unit.seq_header = rec.seq_header != 0;
+        unit.end_seq = rec.end_seq != 0;
+        aus.push_back( unit );
+    }
+    fclose( f );
+
+    if( !ok )
+    {
+        mjpeg_warn( "Ignoring out of date or damaged AU cache %s", path.c_str() );
+        aus.clear();
+        scan_state.clear();
+        return false;
+    }
+    replaying = true;
+    replay_next = 0;
+    return true;
+}
+
+bool AUCache::Save()
+{
+    std::string tmp_path = path + ".tmp";
+    FILE *f = fopen( tmp_path.c_str(), "wb" );
+    if( f == NULL )
+    {
+        mjpeg_warn( "Could not create AU cache %s", tmp_path.c_str() );
+        return false;
+    }
+
+    AUCacheHeader hdr;
+    memset( &hdr, 0, sizeof(hdr) );
+    memcpy( hdr.magic, AU_CACHE_MAGIC, sizeof(AU_CACHE_MAGIC) );
+    hdr.version = AU_CACHE_VERSION;
+    hdr.record_size = sizeof(AUCacheRecord);
+    hdr.key_len = key.size();
+    hdr.state_len = scan_state.size();
+    hdr.aus = aus.size();
+    bool ok =
+        fwrite( &hdr, sizeof(hdr), 1, f ) == 1
+        && fwrite( key.data(), 1, key.size(), f ) == key.size()
+        && ( scan_state.empty()
+             || fwrite( &scan_state[0], sizeof(double), scan_state.size(), f )
+                == scan_state.size() );
+
+    AUCacheRecord rec;
+    memset( &rec, 0, sizeof(rec) );
+    std::vector<AUnit>::iterator i;
+    for( i = aus.begin(); ok && i < aus.end(); ++i )
+    {
+        rec.start = i->start;
+        rec.length = i->length;
+        rec.PTS = i->PTS;
+        rec.DTS = i->DTS;
+        rec.dorder = i->dorder;
+        rec.porder = i->porder;
+        rec.type = i->type;
+        rec.seq_header = i->seq_header;
+        rec.end_seq = i->end_seq;
+        ok = fwrite( &rec, sizeof(rec), 1, f ) == 1;
+    }
+    ok = ( fclose( f ) == 0 ) && ok;
+    if( !ok || rename( tmp_path.c_str(), path.c_str() ) != 0 )
+    {
+        mjpeg_warn( "Could not write AU cache %s", path.c_str() );
+        unlink( tmp_path.c_str() );
+        return false;
+    }
+    mjpeg_info( "Saved %u AUs to cache %s",
+                static_cast<unsigned int>(aus.size()), path.c_str() );
+    return true;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
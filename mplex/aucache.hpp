@@ -0,0 +1,80 @@
+/*
+ *  aucache.hpp:  Cache of the access units scanned from an elementary
+ *                stream so that repeated multiplexing runs on the same
+ *                input can skip parsing it.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __AUCACHE_HH__
+#define __AUCACHE_HH__
+
+#include <string>
+#include <vector>
+#include "aunit.hpp"
+
+/*************************************************************************
+ *
+ * AUCache - the AU list of one input stream, either being recorded
+ * as the stream is scanned for the first time or loaded from a
+ * previous run for replay.
+ *
+ * Cache files live in a user specified directory and are named after
+ * (and contain) a key identifying the input data, e.g. the device,
+ * inode, size and modification time of a file.  Alongside the AUs
+ * the scanning stream can store a few values of its own (statistics
+ * normally accumulated by the parser).  The files are a private,
+ * host-specific format: anything that does not match exactly is
+ * ignored and rebuilt.
+ *
+ *************************************************************************/
+
+class AUCache
+{
+public:
+    AUCache( const char *cache_dir, const char *key );
+
+    bool Load();
+    bool Save();
+
+    /* Recording: the AU buffer of the stream appends to this */
+    inline std::vector<AUnit> *Record() { return &aus; }
+
+    /* Replay */
+    inline bool Replaying() const { return replaying; }
+    inline const AUnit *NextReplay()
+        {
+            return replay_next < aus.size() ? &aus[replay_next++] : 0;
+        }
+
+    std::vector<double> scan_state;
+
+private:
+    std::string key;
+    std::string path;
+    std::vector<AUnit> aus;
+    bool replaying;
+    size_t replay_next;
+};
+
+#endif // __AUCACHE_HH__
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -57,6 +57,8 @@ public:
     static bool Probe(IBitStream &bs);
     virtual void Close();
     virtual unsigned int NominalBitRate();
+    virtual bool SaveScanState( vector<double> &state );
+    virtual void RestoreScanState( const vector<double> &state );
 
 
 private:
@@ -95,9 +97,12 @@ public:
     static bool Probe(IBitStream &bs);
     virtual void Close();
     virtual unsigned int NominalBitRate();
+    virtual bool SaveScanState( vector<double> &state );
+    virtual void RestoreScanState( const vector<double> &state );
 
     virtual unsigned int ReadPacketPayload(uint8_t *dst, unsigned int to_read);
     virtual unsigned int StreamHeaderSize() { return 4; }
+    inline unsigned int SubStreamId() const { return AC3_SUB_STR_0 + stream_num; }
     
 
 private:
@@ -123,9 +128,12 @@ public:
     static bool Probe(IBitStream &bs);
     virtual void Close();
     virtual unsigned int NominalBitRate();
+    virtual bool SaveScanState( vector<double> &state );
+    virtual void RestoreScanState( const vector<double> &state );
 
     virtual unsigned int ReadPacketPayload(uint8_t *dst, unsigned int to_read);
     virtual unsigned int StreamHeaderSize() { return 4; }
+    inline unsigned int SubStreamId() const { return DTS_SUB_STR_0 + stream_num; }
     
 
 private:
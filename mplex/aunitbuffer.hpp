@@ -2,13 +2,14 @@
 #define __AUNITBUFFER_H__
 
 #include <deque>
+#include <vector>
 #include "mjpeg_logging.h"
 #include "aunit.hpp"
 
 class AUStream
 {
 public:
-	AUStream()  {}
+	AUStream() : record(0) {}
 	~AUStream() 
 	{
 		for( std::deque<AUnit *>::iterator i = buf.begin(); i != buf.end(); ++i )
@@ -20,6 +21,8 @@ public:
 		if( buf.size() >= BUF_SIZE_SANITY )
 			mjpeg_error_exit1( "INTERNAL ERROR: AU buffer overflow" );
 		buf.push_back( new AUnit(rec) );
+		if( record != 0 )
+			record->push_back( rec );
 	}
 
 	inline AUnit *Next( ) 
@@ -41,9 +44,26 @@ public:
 			if( buf.empty() )
 				mjpeg_error_exit1( "INTERNAL ERROR: droplast empty AU buffer" );
 			buf.pop_back();
-			
+			if( record != 0 )
+			{
+				// Can't undo an AU appended before recording started
+				if( record->empty() )
+					record = 0;
+				else
+					record->pop_back();
+			}
 		}
 
+	//
+	// Keep a copy of every AU appended (until recording is stopped
+	// by passing 0) e.g. to cache the AU list of a stream.
+	//
+	inline void RecordTo( std::vector<AUnit> *_record )
+		{
+			record = _record;
+		}
+	inline bool Recording() const { return record != 0; }
+
 	inline AUnit *Lookahead( unsigned int n)
 	{
 		return buf.size() <= n ? 0 : buf[n];
@@ -57,6 +77,7 @@ private:
 
 	
 	std::deque<AUnit *> buf;
+	std::vector<AUnit> *record;
 };
 
 
@@ -160,6 +160,12 @@ public:
     void ScanDone();
  
 	inline const char *StreamName() { return streamname; }
+
+    //
+    // Identity of the data being read (e.g. for a file its device,
+    // inode, size and modification time) used to key cached scanning
+    // results.  0 if it has none (e.g. pipes).
+    virtual const char *CacheKey() { return 0; }
 protected:
 	bool ReadIntoBuffer( unsigned int to_read = BUFFER_SIZE );
 	virtual size_t ReadStreamBytes( uint8_t *buf, size_t number ) = 0;
@@ -264,6 +264,23 @@ void DTSStream::Close()
     mjpeg_info   ("Frames         : %8u",  num_frames);
 }
 
+bool DTSStream::SaveScanState( vector<double> &state )
+{
+    state.push_back( num_syncword );
+    state.push_back( num_frames );
+    state.push_back( AU_start );
+    return true;
+}
+
+void DTSStream::RestoreScanState( const vector<double> &state )
+{
+    if( state.size() != 3 )
+        return;
+    num_syncword = static_cast<unsigned int>(state[0]);
+    num_frames = static_cast<unsigned int>(state[1]);
+    AU_start = static_cast<bitcount_t>(state[2]);
+}
+
 /*************************************************************************
 	OutputAudioInfo
 	gibt gesammelte Informationen zu den Audio Access Units aus.
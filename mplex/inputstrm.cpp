@@ -70,6 +70,7 @@ MuxStream::BufferSizeCode()
 ElementaryStream::ElementaryStream( IBitStream &ibs,
                                     Multiplexor &into, stream_kind _kind) : 
 
+    au_cache(0),
     stream_length(0),
     bs( ibs ),
     eoscan(false),
@@ -88,6 +89,8 @@ ElementaryStream::~ElementaryStream ()
 {
     if( au != 0 )
         delete au;
+    if( au_cache != 0 )
+        delete au_cache;
 }
 
 /***********************************
@@ -101,17 +104,106 @@ ElementaryStream::~ElementaryStream ()
 void 
 ElementaryStream::AUBufferLookaheadFill( unsigned int look_ahead)
 {
+    //
+    // In live mode we scan no more AU's at a time than the
+    // user specified look-ahead: each AU scanned before it is
+    // needed is data we have to wait for our (live) source to produce.
+    //
+    unsigned int chunk = static_cast<unsigned int>(FRAME_CHUNK);
+    if( muxinto.live_lookahead != 0 && muxinto.live_lookahead < chunk )
+        chunk = muxinto.live_lookahead;
     while( !eoscan &&
            ( look_ahead+1 > aunits.MaxAULookahead() 
              || bs.BufferedBytes() < muxinto.sector_size ) )
     {
-        FillAUbuffer(FRAME_CHUNK);
+        if( au_cache != 0 && au_cache->Replaying() )
+            ReplayAUbuffer(chunk);
+        else
+            FillAUbuffer(chunk);
     }
     if( eoscan )
+    {
         bs.ScanDone();
+        if( aunits.Recording() )
+            SaveAUCache();
+    }
         
 }
 
+/***********************************
+ *
+ * AU caching.  The first time a stream is multiplexed every AU the
+ * parser appends to the AU buffer is recorded and, if the whole
+ * stream was scanned, saved with the parser's state.  Later runs
+ * append the saved AUs instead of parsing, only skipping the scan
+ * position over the AU data so that it gets buffered for muxing.
+ *
+ **********************************/
+
+void ElementaryStream::OpenAUCache( const char *cache_dir )
+{
+    vector<double> state;
+    const char *key = bs.CacheKey();
+    if( key == 0 || !SaveScanState( state ) )
+    {
+        mjpeg_info( "Stream %02x: AU caching not possible", stream_id );
+        return;
+    }
+    au_cache = new AUCache( cache_dir, key );
+    if( au_cache->Load() )
+    {
+        mjpeg_info( "Stream %02x: using cached AU's (%s)",
+                    stream_id, bs.StreamName() );
+        RestoreScanState( au_cache->scan_state );
+    }
+    else
+        aunits.RecordTo( au_cache->Record() );
+}
+
+void ElementaryStream::ReplayAUbuffer( unsigned int frames_to_buffer )
+{
+    const AUnit *cached = 0;
+
+    // The stream header(s) parsed on initialisation need not end on
+    // a byte boundary...
+    while( bs.bitcount() % 8 != 0 && !bs.eos() )
+        (void)bs.Get1Bit();
+    while( frames_to_buffer > 0 && (cached = au_cache->NextReplay()) != 0 )
+    {
+        AUnit unit = *cached;
+        aunits.Append( unit );
+        ++decoding_order;
+        --frames_to_buffer;
+        bitcount_t au_end = cached->start/8 + cached->length;
+        if( au_end > bs.bitcount()/8 )
+            bs.SeekFwdBits( static_cast<unsigned int>(au_end - bs.bitcount()/8) );
+        if( muxinto.AfterMaxPTS( unit.PTS ) )
+        {
+            eoscan = true;
+            break;
+        }
+    }
+    if( !eoscan && cached == 0 )
+    {
+        // Buffer anything following the last AU as a full scan would
+        while( !bs.eos() )
+            bs.SeekFwdBits( 64*1024 );
+        eoscan = true;
+    }
+    last_buffered_AU = decoding_order;
+}
+
+void ElementaryStream::SaveAUCache()
+{
+    aunits.RecordTo( 0 );
+    // Only complete scans of the whole stream are worth caching
+    if( !bs.eos() || muxinto.max_PTS != 0 )
+        return;
+    au_cache->scan_state.clear();
+    if( SaveScanState( au_cache->scan_state ) )
+        au_cache->Save();
+}
+
 /******************************************
  *
  * Move on to the next Access unit in the Elementary stream
@@ -134,6 +226,7 @@ ElementaryStream::NextAU()
 
 		au = p_au;
 		au_unsent = p_au->length;
+        muxinto.IndexAUStart( *this, *au );
 		return true;
 	}
 	else
@@ -36,6 +36,7 @@
 #include "bits.hpp"
 #include "aunitbuffer.hpp"
 #include "decodebufmodel.hpp"
+#include "aucache.hpp"
 
 using std::vector;
 
@@ -191,6 +192,16 @@ public:
 
 	void SetSyncOffset( clockticks timestamp_delay );
 
+    /******************************************************************
+     * Use (or, if there is none yet, create) a cache of the stream's
+     * AU list in cache_dir so repeated runs needn't re-parse it.
+     * Streams support this by saving / restoring the parser state
+     * that is not held in the AUs (mainly statistics).
+     ******************************************************************/
+    void OpenAUCache( const char *cache_dir );
+    virtual bool SaveScanState( vector<double> &state ) { return false; }
+    virtual void RestoreScanState( const vector<double> &state ) {}
+
 	void BufferAndOutputSector();
  
 	inline bool BuffersInHeader() { return buffers_in_header; }
@@ -232,6 +243,10 @@ public:
     bitcount_t bytes_read;
 private:
     void AUBufferLookaheadFill( unsigned int look_ahead);
+    void ReplayAUbuffer( unsigned int frames_to_buffer );
+    void SaveAUCache();
+
+    AUCache *au_cache;
 
 
 
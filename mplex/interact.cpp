@@ -78,6 +78,8 @@ MultiplexJob::MultiplexJob()
     outfile_pattern = 0;
     packets_per_pack = 1;
     run_in_frames = 0;      // Select default run-in...
+    live_lookahead = 0;     // Normal (non-live) multiplexing
+    transport_stream = false;
     audio_tracks = 0;
     video_tracks = 0;
     subtitle_tracks = 0;
@@ -86,6 +88,8 @@ MultiplexJob::MultiplexJob()
     z_alpha_tracks = 0;
 #endif
     vdr_index_pathname = 0;
+    stream_index_pathname = 0;
+    au_cache_dir = 0;
     outfile_pattern = 0;
 }
 
@@ -68,9 +68,14 @@ public:
   int max_timeouts;
   const char *outfile_pattern;
   const char *vdr_index_pathname;
+  const char *stream_index_pathname;
+  const char *au_cache_dir;     // Cache scanned AU lists here (0 = off)
   int max_segment_size;
   int min_pes_header_len;
   int run_in_frames;            // Run-in expressed in Frame intervals
+  int live_lookahead;           // Live mode: max. AU's scanned ahead
+                                // of the AU being muxed (0 = off)
+  bool transport_stream;        // Output MPEG-2 transport stream
   Workarounds workarounds;      // Special work-around flags that
                                 // constrain the syntax to suit
                                 // the foibles of particular MPEG
@@ -84,6 +84,7 @@ public:
     virtual uint64_t SegmentSize( );
     virtual void NextSegment();
     virtual void Write(uint8_t *data, unsigned int len);
+    virtual void Flush();
 
 private:
     FILE *strm;
@@ -158,6 +159,17 @@ FileOutputStream::Write( uint8_t *buf, unsigned int len )
 
 
 
+void
+FileOutputStream::Flush()
+{
+    if( fflush( strm ) != 0 )
+    {
+        mjpeg_error_exit1( "Failed write: %s", cur_filename );
+    }
+}
+
+
+
 /********************************
  *
  * IFileBitStream - Input bit stream class for bit streams sourced
@@ -179,10 +191,12 @@ public:
  	IFileBitStream( const char *bs_filename, 
 					unsigned int buf_size = BUFFER_SIZE);
 	~IFileBitStream();
+	virtual const char *CacheKey();
 
 private:
 	FILE *fileh;
 	char *filename;
+	char cache_key[96];
 	virtual size_t ReadStreamBytes( uint8_t *buf, size_t number ) 
 		{
 			return fread(buf,sizeof(uint8_t), number, fileh ); 
@@ -232,6 +246,23 @@ IFileBitStream::~IFileBitStream()
     Release();
 }
 
+/**
+   Only regular files have a stable identity: device, inode, size and
+   modification time.
+*/
+const char *IFileBitStream::CacheKey()
+{
+    struct stat st;
+    if( fstat( fileno(fileh), &st ) != 0 || !S_ISREG(st.st_mode) )
+        return 0;
+    snprintf( cache_key, sizeof(cache_key), "%llx:%llx:%lld:%lld",
+              static_cast<unsigned long long>(st.st_dev),
+              static_cast<unsigned long long>(st.st_ino),
+              static_cast<long long>(st.st_size),
+              static_cast<long long>(st.st_mtime) );
+    return cache_key;
+}
+
 
 /*******************************
  *
@@ -263,12 +294,14 @@ private:
 };
 
 const char CmdLineMultiplexJob::short_options[] =
-        "o:i:b:r:O:v:f:l:s:S:p:W:L:R:VCMhd:";
+        "o:i:x:c:b:r:O:v:f:l:s:S:p:W:L:R:P:VCMThd:";
 #if defined(HAVE_GETOPT_LONG)
 struct option CmdLineMultiplexJob::long_options[] = 
 {
     { "verbose",           1, 0, 'v' },
     { "vdr-index",         1, 0, 'i' },
+    { "stream-index",      1, 0, 'x' },
+    { "scan-cache",        1, 0, 'c' },
     { "format",            1, 0, 'f' },
     { "mux-bitrate",       1, 0, 'r' },
     { "video-buffer",      1, 0, 'b' },
@@ -280,6 +313,8 @@ struct option CmdLineMultiplexJob::long_options[] =
     { "system-headers",    0, 0, 'h' },
     { "ignore-seqend-markers",     0, 0, 'M' },
     { "run-in",            1, 0, 'R' },
+    { "live",              1, 0, 'P' },
+    { "transport-stream",  0, 0, 'T' },
     { "max-segment-size",  1, 0, 'S' },
     { "mux-limit",          1, 0, 'l' },
     { "packets-per-pack",  1, 0, 'p' },
@@ -318,6 +353,12 @@ CmdLineMultiplexJob::CmdLineMultiplexJob(unsigned int argc, char *argv[]) :
         case 'i' :
             vdr_index_pathname = optarg;
             break;
+        case 'x' :
+            stream_index_pathname = optarg;
+            break;
+        case 'c' :
+            au_cache_dir = optarg;
+            break;
         case 'v' :
             verbose = atoi(optarg);
             if( verbose < 0 || verbose > 2 )
@@ -363,6 +404,12 @@ CmdLineMultiplexJob::CmdLineMultiplexJob(unsigned int argc, char *argv[]) :
                 Usage(argv[0]);
             break;
 
+        case 'P':
+            live_lookahead = atoi(optarg);
+            if( live_lookahead < 1 || live_lookahead > 100 )
+                Usage(argv[0]);
+            break;
+
         case 'O':
             if( ! ParseTimeOffset(optarg) )
             {
@@ -403,6 +450,9 @@ CmdLineMultiplexJob::CmdLineMultiplexJob(unsigned int argc, char *argv[]) :
         case 'M' :
             multifile_segment = true;
             break;
+        case 'T' :
+            transport_stream = true;
+            break;
         case 'W' :
             if( ! ParseWorkaroundOpt( optarg ) )
             {
@@ -471,6 +521,9 @@ void CmdLineMultiplexJob::Usage(char *str)
     "  Force constant bit-rate video multiplexing\n"
     "--run-in|-R num\n"
     "  Force a 'run-in' of exactly num frame intervals\n"
+    "--live|-P num\n"
+    "  Low-latency live multiplexing: scan at most num access units ahead\n"
+    "  and flush each pack as soon as it is complete [1..100]\n"
 	"--packets-per-pack|-p num\n"
     "  Number of packets per pack generic formats [1..100]\n"
 	"--system-headers|-h\n"
@@ -480,8 +533,16 @@ void CmdLineMultiplexJob::Usage(char *str)
 	"--ignore-seqend-markers|-M\n"
     "  Don't switch to a new output file if a  sequence end marker\n"
 	"  is encountered in the input video.\n"
+    "--transport-stream|-T\n"
+    "  Generate an MPEG-2 transport stream (generic MPEG-2 format only)\n"
     "--vdr-index|-i <vdr-index-filename>\n"
     "  Generate a VDR index file with the output stream\n"
+    "--stream-index|-x <index-filename>\n"
+    "  Write a binary access unit index (offset, SCR, PTS/DTS, I-frame)\n"
+    "  of the output stream for seeking and cutting\n"
+    "--scan-cache|-c <directory>\n"
+    "  Cache the scanned structure of input files in directory so\n"
+    "  later runs on the same files need not parse them again\n"
     "--workaround|-W workaround [, workaround ]\n"
 	"--help|-?\n"
     "  Print this lot out!\n", str);
@@ -689,10 +750,15 @@ int main (int argc, char* argv[])
     FileOutputStream *index = job.vdr_index_pathname != 0 
                              ? new FileOutputStream( job.vdr_index_pathname ) 
                              : 0;
-	Multiplexor mux(job, output, index );
+    FileOutputStream *stream_index = job.stream_index_pathname != 0
+                             ? new FileOutputStream( job.stream_index_pathname )
+                             : 0;
+	Multiplexor mux(job, output, index, stream_index );
 	mux.Multiplex();
     if( index != 0 )
         delete index;
+    if( stream_index != 0 )
+        delete stream_index;
     return (0);	
 }
 
@@ -283,6 +283,25 @@ void MPAStream::Close()
 	
 }
 
+bool MPAStream::SaveScanState( vector<double> &state )
+{
+    state.push_back( num_syncword );
+    state.push_back( num_frames[0] );
+    state.push_back( num_frames[1] );
+    state.push_back( AU_start );
+    return true;
+}
+
+void MPAStream::RestoreScanState( const vector<double> &state )
+{
+    if( state.size() != 4 )
+        return;
+    num_syncword = static_cast<unsigned int>(state[0]);
+    num_frames[0] = static_cast<unsigned int>(state[1]);
+    num_frames[1] = static_cast<unsigned int>(state[2]);
+    AU_start = static_cast<bitcount_t>(state[3]);
+}
+
 /*************************************************************************
 	OutputAudioInfo
 	gibt gesammelte Informationen zu den Audio Access Units aus.
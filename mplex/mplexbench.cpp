@@ -0,0 +1,686 @@
+/*
+ *  mplexbench.cpp:  Multiplexer benchmark and bitstream regression check.
+ *
+ *  Synthetic elementary streams (MPEG-1/2 video, MPEG audio, AC3, LPCM
+ *  and subtitles) are generated in memory and multiplexed with each of
+ *  the main output format profiles.  For each profile the throughput,
+ *  the number of heap allocations and the peak heap use are reported
+ *  and a hash of the output is compared with the value recorded
+ *  below, so that changes to the multiplexer that alter its output do
+ *  not go unnoticed.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <new>
+#include <vector>
+
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "mpegconsts.h"
+#include "interact.hpp"
+#include "bits.hpp"
+#include "outputstrm.hpp"
+#include "multiplexor.hpp"
+
+/**************************************************************
+ *
+ * Heap accounting: all operator new / delete calls are counted and
+ * the live and peak number of bytes tracked.  Each block carries
+ * its size in front of the returned memory.
+ *
+ **************************************************************/
+
+static const size_t heap_hdr = 16;
+static uint64_t heap_allocs = 0;
+static uint64_t heap_live = 0;
+static uint64_t heap_peak = 0;
+
+static void *CountedAlloc( size_t size )
+{
+    uint8_t *p = static_cast<uint8_t *>(malloc( size + heap_hdr ));
+    if( p == 0 )
+        throw std::bad_alloc();
+    *reinterpret_cast<size_t *>(p) = size;
+    ++heap_allocs;
+    heap_live += size;
+    if( heap_live > heap_peak )
+        heap_peak = heap_live;
+    return p + heap_hdr;
+}
+
+static void CountedFree( void *ptr )
+{
+    if( ptr == 0 )
+        return;
+    uint8_t *p = static_cast<uint8_t *>(ptr) - heap_hdr;
+    heap_live -= *reinterpret_cast<size_t *>(p);
+    free( p );
+}
+
+void *operator new( size_t size )
+{
+    return CountedAlloc( size );
+}
+
+void *operator new[]( size_t size )
+{
+    return CountedAlloc( size );
+}
+
+void operator delete( void *ptr )
+{
+    CountedFree( ptr );
+}
+
+void operator delete[]( void *ptr )
+{
+    CountedFree( ptr );
+}
+
+/**************************************************************
+ *
+ * Synthetic elementary streams.  The contents are deterministic
+ * (fixed seed pseudo-random payload) so the multiplexed output is
+ * reproducible.  Only the headers mplex parses are real: picture data
+ * and audio samples are filler.
+ *
+ **************************************************************/
+
+class Random
+{
+public:
+    Random( uint32_t seed ) : state( seed ) {}
+    inline uint32_t Next()
+        {
+            state = state * 1664525U + 1013904223U;
+            return state >> 8;
+        }
+    /* Never zero, so picture data cannot emulate a start code */
+    inline uint8_t NonZeroByte() { return 1 + Next() % 255; }
+private:
+    uint32_t state;
+};
+
+class BitWriter
+{
+public:
+    BitWriter( std::vector<uint8_t> &_out ) :
+        out( _out ), bits( 0 ), nbits( 0 ) {}
+    void PutBits( uint32_t val, int n )
+        {
+            while( n > 0 )
+            {
+                --n;
+                bits = (bits << 1) | ((val >> n) & 1);
+                if( ++nbits == 8 )
+                {
+                    out.push_back( bits );
+                    bits = 0;
+                    nbits = 0;
+                }
+            }
+        }
+    void Align()
+        {
+            if( nbits != 0 )
+                PutBits( 0, 8-nbits );
+        }
+    void StartCode( uint8_t code )
+        {
+            Align();
+            PutBits( 0x000001, 24 );
+            PutBits( code, 8 );
+        }
+private:
+    std::vector<uint8_t> &out;
+    uint8_t bits;
+    int nbits;
+};
+
+static const unsigned int frame_rate = 25;
+
+/*
+ * Video: closed GOPs of 12 pictures with 2 B pictures between
+ * references, sequence header before every GOP.
+ */
+
+static void MakeVideo( std::vector<uint8_t> &out,
+                       int mpeg, unsigned int width, unsigned int height,
+                       unsigned int kbps, unsigned int vbv_kb,
+                       unsigned int seconds )
+{
+    static const int gop_type[12] =
+        { 1, 2, 3, 3, 2, 3, 3, 2, 3, 3, 2, 3 };
+    static const int gop_temp_ref[12] =
+        { 0, 3, 1, 2, 6, 4, 5, 9, 7, 8, 11, 10 };
+    static const double type_scale[4] = { 0.0, 3.0, 1.2, 0.6 };
+    Random rnd( 0x5eed0001 );
+    BitWriter bw( out );
+    unsigned int avg_bytes = kbps * 1000 / 8 / frame_rate;
+    unsigned int frames = seconds * frame_rate;
+
+    for( unsigned int f = 0; f < frames; ++f )
+    {
+        unsigned int gop_pic = f % 12;
+        int type = gop_type[gop_pic];
+        size_t pic_start = out.size();
+
+        if( gop_pic == 0 )
+        {
+            bw.StartCode( 0xb3 );
+            bw.PutBits( width, 12 );
+            bw.PutBits( height, 12 );
+            bw.PutBits( mpeg == 1 ? 1 : 2, 4 );     // Aspect
+            bw.PutBits( 3, 4 );                     // 25 frames/sec
+            bw.PutBits( kbps * 1000 / 400, 18 );
+            bw.PutBits( 1, 1 );
+            bw.PutBits( vbv_kb / 2, 10 );
+            bw.PutBits( 0, 3 );                     // CSPF, no matrices
+            if( mpeg == 2 )
+            {
+                bw.StartCode( 0xb5 );
+                bw.PutBits( 1, 4 );                 // Sequence extension
+                bw.PutBits( 0x48, 8 );              // Main@Main
+                bw.PutBits( 0, 1 );
+                bw.PutBits( 1, 2 );                 // 4:2:0
+                bw.PutBits( 0, 4+12 );
+                bw.PutBits( 1, 1 );
+                bw.PutBits( 0, 8+1+2+5 );
+            }
+            unsigned int secs = f / frame_rate;
+            bw.StartCode( 0xb8 );
+            bw.PutBits( 0, 1 );
+            bw.PutBits( secs / 3600, 5 );
+            bw.PutBits( secs / 60 % 60, 6 );
+            bw.PutBits( 1, 1 );
+            bw.PutBits( secs % 60, 6 );
+            bw.PutBits( f % frame_rate, 6 );
+            bw.PutBits( 1, 1 );                     // Closed GOP
+            bw.PutBits( 0, 1+5 );
+        }
+
+        bw.StartCode( 0x00 );
+        bw.PutBits( gop_temp_ref[gop_pic], 10 );
+        bw.PutBits( type, 3 );
+        bw.PutBits( 0xffff, 16 );                   // VBV delay
+        if( type != 1 )
+            bw.PutBits( mpeg == 1 ? 2 : 7, 4 );
+        if( type == 3 )
+            bw.PutBits( mpeg == 1 ? 2 : 7, 4 );
+        bw.PutBits( 0, 1 );
+        if( mpeg == 2 )
+        {
+            bw.StartCode( 0xb5 );
+            bw.PutBits( 8, 4 );                     // Picture coding ext.
+            bw.PutBits( type == 1 ? 0xffff : type == 2 ? 0x22ff : 0x2222,
+                        16 );
+            bw.PutBits( 0, 2 );
+            bw.PutBits( 3, 2 );                     // Frame picture
+            bw.PutBits( 1, 1 );                     // Top field first
+            bw.PutBits( 0, 6 );
+            bw.PutBits( 1, 1 );                     // chroma_420_type
+            bw.PutBits( 0, 2 );
+        }
+
+        unsigned int size = static_cast<unsigned int>(
+            avg_bytes * type_scale[type] * (0.9 + 0.2 * (rnd.Next() % 1000) / 1000.0));
+        bw.StartCode( 0x01 );
+        while( out.size() < pic_start + size )
+            out.push_back( rnd.NonZeroByte() );
+    }
+    bw.StartCode( 0xb7 );
+}
+
+/*
+ * MPEG-1 layer II audio, padded to the exact nominal bit-rate.
+ */
+
+static void MakeMPA( std::vector<uint8_t> &out,
+                     unsigned int freq, unsigned int kbps,
+                     unsigned int seconds )
+{
+    static const unsigned int bitrate_index[] =
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 };
+    unsigned int rate_code = 0;
+    while( bitrate_index[rate_code] != kbps )
+        ++rate_code;
+    unsigned int frames = seconds * freq / 1152;
+    unsigned int rem = 0;
+    Random rnd( 0x5eed0002 );
+    BitWriter bw( out );
+
+    for( unsigned int f = 0; f < frames; ++f )
+    {
+        unsigned int size = 144 * kbps * 1000 / freq;
+        rem += 144 * kbps * 1000 % freq;
+        unsigned int padding = 0;
+        if( rem >= freq )
+        {
+            rem -= freq;
+            padding = 1;
+        }
+        bw.PutBits( 0x7ff, 11 );
+        bw.PutBits( 3, 2 );                         // MPEG-1
+        bw.PutBits( 2, 2 );                         // Layer II
+        bw.PutBits( 1, 1 );                         // No CRC
+        bw.PutBits( rate_code, 4 );
+        bw.PutBits( freq == 44100 ? 0 : freq == 48000 ? 1 : 2, 2 );
+        bw.PutBits( padding, 1 );
+        bw.PutBits( 0, 1 );
+        bw.PutBits( 0, 2+2 );                       // Stereo
+        bw.PutBits( 0, 1+1+2 );
+        for( unsigned int i = 4; i < size + padding; ++i )
+            out.push_back( rnd.Next() & 0xff );
+    }
+}
+
+/*
+ * AC3 at 48kHz, 192 kbit/sec (768 byte frames of 1536 samples).
+ */
+
+static void MakeAC3( std::vector<uint8_t> &out, unsigned int seconds )
+{
+    static const unsigned int frame_bytes = 768;
+    unsigned int frames = seconds * 48000 / 1536;
+    Random rnd( 0x5eed0003 );
+    BitWriter bw( out );
+
+    for( unsigned int f = 0; f < frames; ++f )
+    {
+        bw.PutBits( 0x0b77, 16 );
+        bw.PutBits( 0, 16 );                        // CRC1
+        bw.PutBits( 0, 2 );                         // 48kHz
+        bw.PutBits( 20, 6 );                        // 192 kbit/sec
+        bw.PutBits( 8, 5 );                         // bsid
+        bw.PutBits( 0, 3 );
+        bw.PutBits( 2, 3 );                         // Stereo
+        bw.PutBits( 0, 5 );
+        for( unsigned int i = 7; i < frame_bytes; ++i )
+            out.push_back( rnd.Next() & 0xff );
+    }
+}
+
+/*
+ * LPCM: 48kHz 16 bit stereo samples (the default LPCM parameters).
+ */
+
+static void MakeLPCM( std::vector<uint8_t> &out, unsigned int seconds )
+{
+    Random rnd( 0x5eed0004 );
+    size_t bytes = static_cast<size_t>(seconds) * 48000 * 2 * 2;
+    out.reserve( bytes );
+    for( size_t i = 0; i < bytes; ++i )
+        out.push_back( rnd.Next() & 0xff );
+}
+
+/*
+ * Subtitles: one subpicture every 2 seconds, in the "SUBTITLE" version
+ * 3 container read by SUBPStream (which holds the header in host
+ * layout).  Each record has to fit in a single packet.
+ */
+
+struct SubtitleHeader
+{
+    unsigned int header_length;
+    unsigned int header_version;
+    unsigned int payload_length;
+    unsigned int lpts;
+    double rpts;
+    unsigned int discont_ctr;
+};
+
+static void MakeSubtitles( std::vector<uint8_t> &out, unsigned int seconds )
+{
+    Random rnd( 0x5eed0005 );
+    for( unsigned int s = 1; s < seconds; s += 2 )
+    {
+        SubtitleHeader hdr;
+        memset( &hdr, 0, sizeof(hdr) );
+        hdr.header_length = sizeof(hdr);
+        hdr.header_version = 0x00030001;
+        hdr.payload_length = 512 + rnd.Next() % 1024;
+        hdr.rpts = s;
+        out.insert( out.end(), "SUBTITLE", "SUBTITLE" + 8 );
+        out.insert( out.end(),
+                    reinterpret_cast<uint8_t *>(&hdr),
+                    reinterpret_cast<uint8_t *>(&hdr) + sizeof(hdr) );
+        out.push_back( 0x20 );                      // Subpicture stream id
+        for( unsigned int i = 1; i < hdr.payload_length; ++i )
+            out.push_back( rnd.Next() & 0xff );
+    }
+}
+
+/**************************************************************
+ *
+ * In-memory input and hashing output for Multiplexor
+ *
+ **************************************************************/
+
+class MemoryBitStream : public IBitStream
+{
+public:
+    MemoryBitStream( const char *name, const std::vector<uint8_t> &_data ) :
+        data( _data ),
+        pos( 0 )
+        {
+            streamname = name;
+            SetBufSize( BUFFER_SIZE );
+            eobs = false;
+            byteidx = 0;
+            if( !ReadIntoBuffer() && buffered == 0 )
+                mjpeg_error_exit1( "Empty synthetic stream %s", name );
+        }
+    ~MemoryBitStream() { Release(); }
+
+private:
+    virtual size_t ReadStreamBytes( uint8_t *buf, size_t number )
+        {
+            if( number > data.size() - pos )
+                number = data.size() - pos;
+            memcpy( buf, &data[pos], number );
+            pos += number;
+            return number;
+        }
+    virtual bool EndOfStream() { return pos == data.size(); }
+
+    const std::vector<uint8_t> &data;
+    size_t pos;
+};
+
+/* 64-bit FNV-1a of everything written, across segments */
+
+class HashOutputStream : public OutputStream
+{
+public:
+    HashOutputStream() : hash( 0xcbf29ce484222325ULL ), total( 0 ) {}
+    virtual int Open() { segment_len = 0; return 0; }
+    virtual void Close() {}
+    virtual uint64_t SegmentSize() { return segment_len; }
+    virtual void NextSegment() { ++segment_num; segment_len = 0; }
+    virtual void Write( uint8_t *data, unsigned int len )
+        {
+            for( unsigned int i = 0; i < len; ++i )
+            {
+                hash ^= data[i];
+                hash *= 0x100000001b3ULL;
+            }
+            segment_len += len;
+            total += len;
+        }
+
+    uint64_t hash;
+    uint64_t total;
+};
+
+/**************************************************************
+ *
+ * Format profiles
+ *
+ **************************************************************/
+
+#define BENCH_MPA       0x01
+#define BENCH_AC3       0x02
+#define BENCH_LPCM      0x04
+#define BENCH_SUBP      0x08
+
+struct BenchProfile
+{
+    const char *name;
+    int mux_format;
+    bool transport;
+    int mpeg;                   // Video
+    unsigned int width;
+    unsigned int height;
+    unsigned int video_kbps;
+    unsigned int vbv_kb;
+    unsigned int audio_freq;    // MPEG audio
+    unsigned int streams;
+    unsigned int unit_size;     // Sector / transport packet size
+    uint64_t golden;            // Output hash at the default length
+};
+
+static const unsigned int default_seconds = 30;
+
+static const BenchProfile profiles[] =
+{
+    { "mpeg1",  MPEG_FORMAT_MPEG1, false, 1, 352, 288, 1150,  40, 48000,
+      BENCH_MPA, 2048, 0xedb85c6f9ba7daa9ULL },
+    { "vcd",    MPEG_FORMAT_VCD,   false, 1, 352, 288, 1150,  40, 44100,
+      BENCH_MPA, 2352, 0xcb3ea93f7b8d158cULL },
+    { "mpeg2",  MPEG_FORMAT_MPEG2, false, 2, 720, 576, 6000, 224, 48000,
+      BENCH_MPA|BENCH_AC3, 2048, 0x0af36fa056c05cb7ULL },
+    { "svcd",   MPEG_FORMAT_SVCD,  false, 2, 480, 576, 2000, 224, 44100,
+      BENCH_MPA, 2324, 0x137c09e205f53869ULL },
+    { "dvdnav", MPEG_FORMAT_DVD_NAV, false, 2, 720, 576, 6000, 224, 48000,
+      BENCH_AC3|BENCH_LPCM|BENCH_SUBP, 2048, 0x0b065f281e1dd6bfULL },
+    { "dvd",    MPEG_FORMAT_DVD,   false, 2, 720, 576, 6000, 224, 48000,
+      BENCH_AC3|BENCH_LPCM|BENCH_SUBP, 2048, 0x3aef7ebb6161f4b8ULL },
+    { "ts",     MPEG_FORMAT_MPEG2, true,  2, 720, 576, 6000, 224, 48000,
+      BENCH_MPA|BENCH_AC3, 188, 0x07a54d8e4173803dULL }
+};
+
+static const unsigned int num_profiles = sizeof(profiles)/sizeof(profiles[0]);
+
+class BenchJob : public MultiplexJob
+{
+public:
+    BenchJob( const BenchProfile &prof,
+              std::vector<const std::vector<uint8_t> *> &data,
+              std::vector<const char *> &names )
+        {
+            verbose = 0;
+            mux_format = prof.mux_format;
+            transport_stream = prof.transport;
+            outfile_pattern = "mplexbench";
+            for( unsigned int i = 0; i < data.size(); ++i )
+                inputs.push_back( new MemoryBitStream( names[i], *data[i] ) );
+            SetupInputStreams( inputs );
+        }
+    ~BenchJob()
+        {
+            for( unsigned int i = 0; i < inputs.size(); ++i )
+                delete inputs[i];
+        }
+private:
+    std::vector<IBitStream *> inputs;
+};
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void Usage( const char *prog )
+{
+    fprintf( stderr,
+             "Usage: %s [options] [profile ...]\n"
+             "  -n secs   Length of the synthetic streams (default %u)\n"
+             "  -r runs   Multiplex each profile this many times and\n"
+             "            report the fastest (default 3)\n"
+             "  -g        Print the output hashes as golden table entries\n"
+             "  -v num    Verbosity of the multiplexer (default 0)\n"
+             "Profiles:",
+             prog, default_seconds );
+    for( unsigned int i = 0; i < num_profiles; ++i )
+        fprintf( stderr, " %s", profiles[i].name );
+    fprintf( stderr, "\n" );
+    exit( 1 );
+}
+
+int main( int argc, char *argv[] )
+{
+    unsigned int seconds = default_seconds;
+    unsigned int runs = 3;
+    bool print_golden = false;
+    int verbose = 0;
+    int n;
+
+    while( (n = getopt( argc, argv, "n:r:gv:" )) != -1 )
+    {
+        switch( n )
+        {
+        case 'n' :
+            seconds = atoi( optarg );
+            if( seconds < 2 )
+                Usage( argv[0] );
+            break;
+        case 'r' :
+            runs = atoi( optarg );
+            if( runs < 1 )
+                Usage( argv[0] );
+            break;
+        case 'g' :
+            print_golden = true;
+            break;
+        case 'v' :
+            verbose = atoi( optarg );
+            break;
+        default :
+            Usage( argv[0] );
+        }
+    }
+    (void)mjpeg_default_handler_verbosity( verbose );
+
+    std::vector<const BenchProfile *> selected;
+    for( int i = optind; i < argc; ++i )
+    {
+        unsigned int p;
+        for( p = 0; p < num_profiles; ++p )
+            if( strcmp( argv[i], profiles[p].name ) == 0 )
+                break;
+        if( p == num_profiles )
+            Usage( argv[0] );
+        selected.push_back( &profiles[p] );
+    }
+    if( selected.empty() )
+        for( unsigned int p = 0; p < num_profiles; ++p )
+            selected.push_back( &profiles[p] );
+
+    bool check = seconds == default_seconds;
+    unsigned int failures = 0;
+
+    printf( "%-8s %10s %9s %10s %10s %10s %-18s %s\n",
+            "profile", "bytes", "secs", "sectors/s", "allocs", "peak KB",
+            "hash", "golden" );
+    for( unsigned int s = 0; s < selected.size(); ++s )
+    {
+        const BenchProfile &prof = *selected[s];
+        std::vector<uint8_t> video, mpa, ac3, lpcm, subp;
+        std::vector<const std::vector<uint8_t> *> data;
+        std::vector<const char *> names;
+
+        MakeVideo( video, prof.mpeg, prof.width, prof.height,
+                   prof.video_kbps, prof.vbv_kb, seconds );
+        data.push_back( &video );
+        names.push_back( "synthetic.m2v" );
+        if( prof.streams & BENCH_MPA )
+        {
+            MakeMPA( mpa, prof.audio_freq, 224, seconds );
+            data.push_back( &mpa );
+            names.push_back( "synthetic.mp2" );
+        }
+        if( prof.streams & BENCH_AC3 )
+        {
+            MakeAC3( ac3, seconds );
+            data.push_back( &ac3 );
+            names.push_back( "synthetic.ac3" );
+        }
+        if( prof.streams & BENCH_LPCM )
+        {
+            MakeLPCM( lpcm, seconds );
+            data.push_back( &lpcm );
+            names.push_back( "synthetic.lpcm" );
+        }
+        if( prof.streams & BENCH_SUBP )
+        {
+            MakeSubtitles( subp, seconds );
+            data.push_back( &subp );
+            names.push_back( "synthetic.sub" );
+        }
+
+        double best = 0.0;
+        uint64_t hash = 0, bytes = 0, allocs = 0, peak = 0;
+        for( unsigned int r = 0; r < runs; ++r )
+        {
+            uint64_t allocs_before = heap_allocs;
+            heap_peak = heap_live;
+            uint64_t live_before = heap_live;
+            double start = Now();
+            {
+                BenchJob job( prof, data, names );
+                HashOutputStream output;
+                Multiplexor mux( job, output, 0, 0 );
+                mux.Multiplex();
+                hash = output.hash;
+                bytes = output.total;
+            }
+            double elapsed = Now() - start;
+            if( r == 0 || elapsed < best )
+                best = elapsed;
+            allocs = heap_allocs - allocs_before;
+            peak = heap_peak - live_before;
+        }
+
+        const char *verdict = "-";
+        if( check && prof.golden != 0 )
+        {
+            verdict = hash == prof.golden ? "ok" : "MISMATCH";
+            if( hash != prof.golden )
+                ++failures;
+        }
+        printf( "%-8s %10llu %9.4f %10.0f %10llu %10llu %016llx %s\n",
+                prof.name,
+                static_cast<unsigned long long>(bytes),
+                best,
+                bytes / prof.unit_size / best,
+                static_cast<unsigned long long>(allocs),
+                static_cast<unsigned long long>(peak / 1024),
+                static_cast<unsigned long long>(hash),
+                verdict );
+        if( print_golden )
+            printf( "    golden %s: 0x%016llxULL\n", prof.name,
+                    static_cast<unsigned long long>(hash) );
+    }
+
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    printf( "Process peak RSS %ld KB\n", usage.ru_maxrss );
+    if( failures != 0 )
+    {
+        fprintf( stderr, "%u profile(s) produced output differing from the golden hash!\n",
+                 failures );
+        return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -23,6 +23,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <mjpeg_types.h>
 #include <mjpeg_logging.h>
@@ -36,6 +37,7 @@
 #include "zalphastrm.hpp"
 #endif
 #include "multiplexor.hpp"
+#include "tsstrm.hpp"
 
 
 /****************
@@ -46,21 +48,36 @@
  *
  ***************/
 
-Multiplexor::Multiplexor(MultiplexJob &job, OutputStream &output, OutputStream *index)
+Multiplexor::Multiplexor(MultiplexJob &job, OutputStream &output, OutputStream *index,
+                         OutputStream *stream_index_strm)
 {
     underrun_ignore = 0;
     underruns = 0;
+    live_packs = 0;
+    live_latency_max = 0;
+    live_latency_sum = 0.0;
 	start_of_new_pack = false;
     InitSyntaxParameters(job);
     InitInputStreams(job);
 
-    psstrm = new PS_Stream(mpeg, sector_size, output, max_segment_size );
+    if( transport_stream )
+        psstrm = new TS_Stream( sector_size, output, max_segment_size,
+                                estreams );
+    else
+        psstrm = new PS_Stream(mpeg, sector_size, output, max_segment_size );
     vdr_index = index;
+    indexed_strm = 0;
+    stream_index = stream_index_strm != 0
+        ? new StreamIndex( *stream_index_strm, sector_size, mux_format,
+                           transport_stream )
+        : 0;
 }
 
 Multiplexor::~Multiplexor()
 {
     delete psstrm;
+    if( stream_index != 0 )
+        delete stream_index;
     while (!estreams.empty()) {
         delete estreams.back();
         estreams.pop_back();
@@ -93,6 +110,8 @@ void Multiplexor::InitSyntaxParameters(MultiplexJob &job)
 	split_at_seq_end = !job.multifile_segment;
     workarounds = job.workarounds;
     run_in_frames = job.run_in_frames;
+    live_lookahead = job.live_lookahead;
+    transport_stream = job.transport_stream;
     max_segment_size = static_cast<uint64_t>(job.max_segment_size)
                        * static_cast<uint64_t>(1024 * 1024);
     max_PTS = static_cast<clockticks>(job.max_PTS) * CLOCKS;
@@ -291,6 +310,17 @@ void Multiplexor::InitSyntaxParameters(MultiplexJob &job)
      vbr = true;
  if( job.CBR )
      vbr = false;
+
+ //
+ // Transport streams are built from the sectors of a plain MPEG-2
+ // program stream so only the generic profile makes sense.
+ //
+ if( transport_stream )
+ {
+     if( mux_format != MPEG_FORMAT_MPEG2 )
+         mjpeg_error_exit1( "Transport stream output requires the generic MPEG-2 format (-f 3)" );
+     mjpeg_info( "Selecting MPEG-2 transport stream output" );
+ }
 }
 
 /**************************************
@@ -485,6 +515,13 @@ void Multiplexor::InitInputStreamsForVideo(MultiplexJob & job )
 #endif		
         }
     }
+
+    if( job.au_cache_dir != 0 )
+    {
+        std::vector<ElementaryStream *>::iterator str;
+        for( str = estreams.begin(); str < estreams.end(); ++str )
+            (*str)->OpenAUCache( job.au_cache_dir );
+    }
 }
 
 
@@ -639,6 +676,22 @@ clockticks Multiplexor::RunInDelay()
             data_delay += 3*(*str)->BufferSize()/4;
         }
         ByteposTimecode( data_delay, delay );
+
+        //
+        // Live: a run-in longer than the look-ahead bound is simply
+        // latency added up-front...
+        //
+        if( live_lookahead != 0 && frame_interval != 0.0 )
+        {
+            clockticks live_delay = 
+                static_cast<clockticks>(live_lookahead * frame_interval);
+            if( delay > live_delay )
+            {
+                mjpeg_info( "Live mode: run-in limited to %d frame intervals",
+                            live_lookahead );
+                delay = live_delay;
+            }
+        }
     }
     
     // Round delay a multiple of frame interval if its known...
@@ -677,6 +730,8 @@ void Multiplexor::Init()
 	psstrm->Open();
     if( vdr_index != 0 )
         vdr_index->Open();
+    if( stream_index != 0 )
+        stream_index->Open();
 	
     /* These are used to make (conservative) decisions
 	   about whether a packet should fit into the recieve buffers... 
@@ -879,6 +934,58 @@ void Multiplexor::MuxStatus(log_level_t level)
 }
 
 
+/**
+   Live mode: a pack is complete.  Push it out to the consumer at once
+   and account for its latency.  The latency of a pack is the time from
+   its nominal real-time arrival (its SCR, relative to the start of
+   multiplexing) to the presentation of the data it carries (its PTS)
+   plus however far behind real-time the multiplexor is running.
+   @param PTS the presentation time of the AU starting in the pack (0 if
+   the pack carried no data)
+ */
+void Multiplexor::LivePackComplete( clockticks PTS )
+{
+	struct timeval now;
+	psstrm->Flush();
+	if( stream_index != 0 )
+		stream_index->Flush();
+	gettimeofday( &now, NULL );
+	double wall_elapsed = now.tv_sec + now.tv_usec / 1000000.0
+		- live_start_time;
+	clockticks lag = static_cast<clockticks>(wall_elapsed * CLOCKS)
+		- current_SCR;
+	if( lag < 0 )
+		lag = 0;
+	clockticks latency = lag + ( PTS > current_SCR ? PTS - current_SCR : 0 );
+
+	++live_packs;
+	live_latency_sum += static_cast<double>(latency);
+	if( latency > live_latency_max )
+		live_latency_max = latency;
+	mjpeg_debug( "Live pack %d: SCR=%lld PTS=%lld wall lag=%lld latency=%lld (mpt)",
+				 live_packs,
+				 static_cast<long long>(current_SCR/300),
+				 static_cast<long long>(PTS/300),
+				 static_cast<long long>(lag/300),
+				 static_cast<long long>(latency/300) );
+	if( live_packs % 1000 == 0 )
+		LiveStatus( mjpeg_loglev_t("info") );
+}
+
+/**
+   Prints the live mode end-to-end latency statistics.
+   @param level the desired log level 
+ */
+void Multiplexor::LiveStatus( log_level_t level )
+{
+	if( live_packs == 0 )
+		return;
+	mjpeg_log( level, "Live: %d packs latency avg %.1f ms max %.1f ms",
+			   live_packs,
+			   live_latency_sum / live_packs * 1000.0 / CLOCKS,
+			   static_cast<double>(live_latency_max) * 1000.0 / CLOCKS );
+}
+
 /**
    Append input substreams to the output multiplex stream.
  */
@@ -1091,6 +1198,12 @@ void Multiplexor::Multiplex()
 	bool video_first = true;
 
 	Init( );
+	if( live_lookahead != 0 )
+	{
+		struct timeval now;
+		gettimeofday( &now, NULL );
+		live_start_time = now.tv_sec + now.tv_usec / 1000000.0;
+	}
 
 	unsigned int i;
     for(i = 0; i < estreams.size() ; ++i )
@@ -1297,8 +1410,10 @@ void Multiplexor::Multiplex()
 		if( underrun_ignore > 0 )
 			--underrun_ignore;
 
+		clockticks despatch_PTS = 0;
 		if( despatch )
 		{
+			despatch_PTS = despatch->RequiredPTS();
 			despatch->BufferAndOutputSector();
 			video_first = false;
 			if( current_SCR >=  earliest && underrun_ignore == 0)
@@ -1370,7 +1485,11 @@ void Multiplexor::Multiplex()
 		{
 			--packets_left_in_pack;
 			if (packets_left_in_pack == 0) 
+			{
 				packets_left_in_pack = packets_per_pack;
+				if( live_lookahead != 0 )
+					LivePackComplete( despatch_PTS );
+			}
 		}
 
 		MuxStatus( mjpeg_loglev_t("debug") );
@@ -1398,9 +1517,13 @@ void Multiplexor::Multiplex()
 	psstrm->Close();
     if( vdr_index != 0)
         vdr_index->Close();
+    if( stream_index != 0 )
+        stream_index->Close();
         
 	mjpeg_info( "Multiplex completion at SCR=%lld.", current_SCR/300);
 	MuxStatus( mjpeg_loglev_t("info") );
+	if( live_lookahead != 0 )
+		LiveStatus( mjpeg_loglev_t("info") );
 	for( str = estreams.begin(); str < estreams.end(); ++str )
 	{
 		(*str)->Close();
@@ -1463,6 +1586,23 @@ Multiplexor::WritePacket( unsigned int     max_packet_data_size,
                                     uint8_t 	 timestamps
 	                     )
 {
+    ElementaryStream *estrm = stream_index != 0
+        ? dynamic_cast<ElementaryStream *>(&strm)
+        : 0;
+    unsigned int aus_at_start = 0;
+    if( estrm != 0 )
+    {
+        // Access units starting in this packet are picked up by
+        // IndexAUStart as the stream moves on to them while the
+        // payload is read...
+        indexed_strm = estrm;
+        indexed_packet_offset = psstrm->OutputPosition();
+        indexed_packet_SCR = current_SCR;
+        indexed_packet_aus.clear();
+        if( estrm->NewAUNextSector() && estrm->au != 0 )
+            IndexAUStart( *estrm, *estrm->au );
+        aus_at_start = indexed_packet_aus.size();
+    }
     unsigned int written =
         psstrm->CreateSector ( pack_header_ptr,
                                sys_header_ptr,
@@ -1473,6 +1613,17 @@ Multiplexor::WritePacket( unsigned int     max_packet_data_size,
                                PTS,
                                DTS,
                                timestamps );
+    if( estrm != 0 )
+    {
+        // ... except that an AU that started exactly at the end of
+        // the packet actually starts in the next one.
+        indexed_strm = 0;
+        if( estrm->NewAUNextSector() && indexed_packet_aus.size() > aus_at_start )
+            indexed_packet_aus.pop_back();
+        std::vector<StreamIndexEntry>::iterator e;
+        for( e = indexed_packet_aus.begin(); e < indexed_packet_aus.end(); ++e )
+            stream_index->Append( *e );
+    }
     NextPosAndSCR();
     return written;
 }
@@ -1513,6 +1664,47 @@ Multiplexor::IndexLastPacket( ElementaryStream &strm, int index_type )
     }
 }
 
+/***************************************************
+
+  IndexAUStart
+  - Called by an elementary stream each time it moves on
+  to a new access unit.  While a packet is being written
+  for the stream (see WritePacket) this means the AU starts
+  in that packet and a stream index entry is generated.
+***************************************************/
+void
+Multiplexor::IndexAUStart( ElementaryStream &strm, const AUnit &unit )
+{
+    if( &strm != indexed_strm )
+        return;
+
+    StreamIndexEntry entry;
+    entry.offset = indexed_packet_offset;
+    entry.SCR = indexed_packet_SCR;
+    entry.PTS = strm.RequiredPTS( &unit );
+    entry.DTS = strm.RequiredDTS( &unit );
+    entry.segment = static_cast<uint16_t>(psstrm->SegmentNum());
+    entry.stream = 0;
+    while( entry.stream < estreams.size() && estreams[entry.stream] != &strm )
+        ++entry.stream;
+    entry.stream_id = strm.stream_id;
+    entry.au_type = 0;
+    entry.flags = 0;
+    if( entry.DTS != entry.PTS )
+        entry.flags |= STREAM_INDEX_HAS_DTS;
+    if( strm.Kind() == ElementaryStream::video )
+    {
+        entry.au_type = unit.type;
+        if( unit.type == IFRAME )
+            entry.flags |= STREAM_INDEX_IFRAME | STREAM_INDEX_RANDOM_ACCESS;
+        if( unit.seq_header )
+            entry.flags |= STREAM_INDEX_SEQ_HEADER;
+    }
+    else
+        entry.flags |= STREAM_INDEX_RANDOM_ACCESS;
+    indexed_packet_aus.push_back( entry );
+}
+
 /***************************************************
  *
  * WriteRawSector - Write out a packet carrying data for
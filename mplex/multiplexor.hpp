@@ -8,12 +8,14 @@
 #include "inputstrm.hpp"
 #include "padstrm.hpp"
 #include "systems.hpp"
+#include "streamindex.hpp"
 
 
 class Multiplexor
 {
 public:
-	Multiplexor(MultiplexJob &job, OutputStream &output, OutputStream *index);
+	Multiplexor(MultiplexJob &job, OutputStream &output, OutputStream *index,
+                OutputStream *stream_index_strm = 0);
         ~Multiplexor ();
 	void Multiplex ();
 
@@ -33,6 +35,7 @@ public:
 		);
 
     void IndexLastPacket( ElementaryStream &strm, int index_type );
+    void IndexAUStart( ElementaryStream &strm, const AUnit &unit );
 	bool AfterMaxPTS(clockticks &timestamp) 
 		{ return max_PTS != 0 && timestamp >= max_PTS; }
 
@@ -66,6 +69,8 @@ public:
 	int mpeg;
 	int data_rate;
     unsigned int    run_in_frames;
+    unsigned int    live_lookahead; /* Live mode: AU look-ahead bound (0 = off) */
+    bool transport_stream;
     int mux_format;
 	uint64_t max_segment_size;
 
@@ -106,11 +111,23 @@ private:
 	unsigned int underruns;
 	unsigned int underrun_ignore;
 
+	/* Live mode latency statistics */
+	double live_start_time;
+	unsigned int live_packs;
+	clockticks live_latency_max;
+	double live_latency_sum;
+
 	/* Output data stream... */
 	PS_Stream *psstrm;
 	bitcount_t bytes_output;
     clockticks ticks_per_sector;
     OutputStream *vdr_index;
+    StreamIndex *stream_index;
+    /* Stream index entries for the packet currently being written */
+    ElementaryStream *indexed_strm;
+    uint64_t indexed_packet_offset;
+    clockticks indexed_packet_SCR;
+    vector<StreamIndexEntry> indexed_packet_aus;
 public:
 	clockticks current_SCR;
 private:
@@ -146,6 +163,8 @@ private:
 	void OutputSuffix();
 	void OutputPadding ( bool vcd_audio_pad );
 	void MuxStatus( log_level_t level );
+	void LivePackComplete( clockticks PTS );
+	void LiveStatus( log_level_t level );
 
 	void WriteRawSector( uint8_t *rawpackets,
 						 unsigned int     length
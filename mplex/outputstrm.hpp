@@ -38,6 +38,7 @@ public:
     virtual uint64_t SegmentSize( ) = 0;
     virtual void NextSegment() = 0;
     virtual void Write(uint8_t *data, unsigned int len) = 0;
+    virtual void Flush() {}
     int SegmentNum() const { return segment_num; }
 protected:
     int         segment_num;
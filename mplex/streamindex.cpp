@@ -0,0 +1,133 @@
+/*
+ *  streamindex.cpp:  Binary access unit index written alongside the
+ *                    multiplexed output stream.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include "mjpeg_logging.h"
+#include "streamindex.hpp"
+
+/*
+ * The file format is little-endian whatever the host so fields are
+ * serialised a byte at a time rather than by copying the structs.
+ */
+
+static inline uint8_t *PutLE( uint8_t *buf, uint64_t val, unsigned int bytes )
+{
+    for( unsigned int i = 0; i < bytes; ++i )
+    {
+        buf[i] = static_cast<uint8_t>(val & 0xff);
+        val >>= 8;
+    }
+    return buf+bytes;
+}
+
+StreamIndex::StreamIndex( OutputStream &_index_strm,
+                          unsigned int sector_size,
+                          unsigned int mux_format,
+                          bool transport )
+    : index_strm( _index_strm ),
+      batched( 0 ),
+      entries( 0 )
+{
+    memset( &header, 0, sizeof(header) );
+    strcpy( header.magic, STREAM_INDEX_MAGIC );
+    header.version = STREAM_INDEX_VERSION;
+    header.header_size = STREAM_INDEX_HEADER_SIZE;
+    header.entry_size = STREAM_INDEX_ENTRY_SIZE;
+    header.flags = transport ? STREAM_INDEX_TRANSPORT : 0;
+    header.sector_size = sector_size;
+    header.clock_rate = 27000000;
+    header.mux_format = mux_format;
+    batch = new uint8_t[STREAM_INDEX_BATCH*STREAM_INDEX_ENTRY_SIZE];
+}
+
+StreamIndex::~StreamIndex()
+{
+    delete [] batch;
+}
+
+void StreamIndex::Open()
+{
+    uint8_t buf[STREAM_INDEX_HEADER_SIZE];
+    uint8_t *p = buf;
+
+    if( index_strm.Open() )
+        mjpeg_error_exit1( "Could not open stream index file" );
+    memcpy( p, header.magic, sizeof(header.magic) );
+    p += sizeof(header.magic);
+    p = PutLE( p, header.version, 2 );
+    p = PutLE( p, header.header_size, 2 );
+    p = PutLE( p, header.entry_size, 2 );
+    p = PutLE( p, header.flags, 2 );
+    p = PutLE( p, header.sector_size, 4 );
+    p = PutLE( p, header.clock_rate, 4 );
+    p = PutLE( p, header.mux_format, 4 );
+    p = PutLE( p, header.reserved, 4 );
+    index_strm.Write( buf, STREAM_INDEX_HEADER_SIZE );
+}
+
+void StreamIndex::Append( const StreamIndexEntry &entry )
+{
+    uint8_t *p = batch + batched * STREAM_INDEX_ENTRY_SIZE;
+
+    p = PutLE( p, entry.offset, 8 );
+    p = PutLE( p, static_cast<uint64_t>(entry.SCR), 8 );
+    p = PutLE( p, static_cast<uint64_t>(entry.PTS), 8 );
+    p = PutLE( p, static_cast<uint64_t>(entry.DTS), 8 );
+    p = PutLE( p, entry.segment, 2 );
+    *p++ = entry.stream;
+    *p++ = entry.stream_id;
+    *p++ = entry.au_type;
+    *p++ = entry.flags;
+    p = PutLE( p, 0, 2 );
+
+    ++entries;
+    if( ++batched == STREAM_INDEX_BATCH )
+        WriteBatch();
+}
+
+void StreamIndex::WriteBatch()
+{
+    if( batched == 0 )
+        return;
+    index_strm.Write( batch, batched * STREAM_INDEX_ENTRY_SIZE );
+    batched = 0;
+}
+
+void StreamIndex::Flush()
+{
+    WriteBatch();
+    index_strm.Flush();
+}
+
+void StreamIndex::Close()
+{
+    WriteBatch();
+    index_strm.Close();
+    mjpeg_info( "Stream index: %u entries", entries );
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
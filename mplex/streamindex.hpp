@@ -0,0 +1,129 @@
+/*
+ *  streamindex.hpp:  Binary access unit index written alongside the
+ *                    multiplexed output stream.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __STREAMINDEX_HH__
+#define __STREAMINDEX_HH__
+
+#include "mjpeg_types.h"
+#include "outputstrm.hpp"
+
+/*************************************************************************
+ *
+ * Stream index file format (version 1)
+ *
+ * A fixed size header followed by fixed size entries, one for each
+ * access unit of each elementary stream, in the order the packets
+ * carrying their starts were written.  All fields are little-endian
+ * and naturally aligned, so on little-endian hosts the file can be
+ * mmap-ed and used directly as a StreamIndexHeader followed by an
+ * array of StreamIndexEntry.  The number of entries is (file size -
+ * header_size) / entry_size.  Readers should check magic and version
+ * and use header_size / entry_size from the header so that later
+ * versions may append fields.
+ *
+ * Timestamps are in 27MHz system clock ticks.  offset is the byte
+ * offset within output segment 'segment' of the sector (program
+ * stream) or of the first transport packet (transport stream) that
+ * carries the start of the access unit: a decoder can start reading
+ * there.  Entries flagged STREAM_INDEX_RANDOM_ACCESS are clean entry
+ * points for seeking and cutting (video I pictures, all audio frames);
+ * a video stream's sequence header must be taken from an earlier entry
+ * if the I picture does not carry one (STREAM_INDEX_SEQ_HEADER).
+ *
+ *************************************************************************/
+
+#define STREAM_INDEX_MAGIC          "MPLXIDX"
+#define STREAM_INDEX_VERSION        1
+
+/* StreamIndexHeader.flags */
+#define STREAM_INDEX_TRANSPORT      0x0001
+
+/* StreamIndexEntry.flags */
+#define STREAM_INDEX_IFRAME         0x01    /* I picture */
+#define STREAM_INDEX_SEQ_HEADER     0x02    /* AU starts with a sequence header */
+#define STREAM_INDEX_RANDOM_ACCESS  0x04    /* Decoding may (re)start here */
+#define STREAM_INDEX_HAS_DTS        0x08    /* DTS differs from PTS */
+
+struct StreamIndexHeader
+{
+    char     magic[8];                  /* "MPLXIDX\0" */
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t entry_size;
+    uint16_t flags;
+    uint32_t sector_size;
+    uint32_t clock_rate;                /* 27000000 */
+    uint32_t mux_format;                /* -f format code */
+    uint32_t reserved;
+};
+
+struct StreamIndexEntry
+{
+    uint64_t offset;
+    int64_t  SCR;
+    int64_t  PTS;
+    int64_t  DTS;
+    uint16_t segment;
+    uint8_t  stream;                    /* Input stream number (0 = first) */
+    uint8_t  stream_id;
+    uint8_t  au_type;                   /* IFRAME/PFRAME/BFRAME, 0 for audio */
+    uint8_t  flags;
+    uint16_t reserved;
+};
+
+#define STREAM_INDEX_HEADER_SIZE    32
+#define STREAM_INDEX_ENTRY_SIZE     40
+
+/* Entries collected before being written out */
+#define STREAM_INDEX_BATCH          256
+
+class StreamIndex
+{
+public:
+    StreamIndex( OutputStream &_index_strm,
+                 unsigned int sector_size,
+                 unsigned int mux_format,
+                 bool transport );
+    ~StreamIndex();
+
+    void Open();
+    void Close();
+    void Append( const StreamIndexEntry &entry );
+    void Flush();
+    inline unsigned int Entries() const { return entries; }
+
+private:
+    void WriteBatch();
+
+    OutputStream &index_strm;
+    StreamIndexHeader header;
+    uint8_t *batch;
+    unsigned int batched;
+    unsigned int entries;
+};
+
+#endif // __STREAMINDEX_HH__
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -52,7 +52,7 @@ PS_Stream::~PS_Stream()
 bool
 PS_Stream::SegmentLimReached()
 {
-	uint64_t written = output_strm.SegmentSize();
+	uint64_t written = OutputPosition();
 	return max_segment_size != 0 && written > max_segment_size;
 }
 
@@ -459,7 +459,7 @@ PS_Stream::CreateSector (Pack_struc	 	 *pack,
 		sector_pack_area -= 4;
 
     BufferSectorHeader( index, pack, sys_header, index );
-    last_pack_start = output_strm.SegmentSize()
+    last_pack_start = OutputPosition()
                       + static_cast<bitcount_t>(index-sector_buf);
     
     BufferPacketHeader( index, type, mpeg_version,
@@ -120,16 +120,19 @@ public:
                            vector<MuxStream *> &streams
         );
 
-    inline int Open() { return output_strm.Open(); }
-    inline void Close() { output_strm.Close(); }
-    inline void RawWrite(uint8_t *data, unsigned int len)
+    virtual int Open() { return output_strm.Open(); }
+    virtual void Close() { output_strm.Close(); }
+    virtual void RawWrite(uint8_t *data, unsigned int len)
         {
             return output_strm.Write( data, len );
         }
-    inline void NextSegment() { output_strm.NextSegment(); }
+    virtual void NextSegment() { output_strm.NextSegment(); }
+    virtual void Flush() { output_strm.Flush(); }
     bool SegmentLimReached();
     inline int SegmentNum() const { return output_strm.SegmentNum(); }
     inline bitcount_t LastPackStart() const { return last_pack_start; }
+    // Byte offset in the current segment the next sector will start at
+    virtual uint64_t OutputPosition() { return output_strm.SegmentSize(); }
 protected:
     static void 
     BufferDtsPtsMpeg1ScrTimecode (clockticks    timecode,
@@ -142,8 +145,8 @@ protected:
 
     virtual bool StreamWithMPeg2HeaderExt( uint8_t type );
 
-private:
     OutputStream &output_strm; 
+private:
     unsigned int mpeg_version;
     unsigned int sector_size;
     uint64_t max_segment_size;
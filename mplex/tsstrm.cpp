@@ -0,0 +1,570 @@
+/*
+ *  tsstrm.cpp: MPEG-2 Transport stream packet generator
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mjpeg_logging.h"
+#include "mplexconsts.hpp"
+#include "videostrm.hpp"
+#include "audiostrm.hpp"
+#include "tsstrm.hpp"
+
+/* ISO 13818-1 asks for a PCR at least every 100ms, we are generous... */
+#define PCR_INTERVAL (CLOCKS/25)
+/* ... PAT/PMT repetition is a matter of channel change / seek latency */
+#define PSI_INTERVAL (CLOCKS/10)
+/*
+ * Packs are due this many transport packets ahead of their SCR.  The
+ * rate covers the PCR only and PSI packets on average, but they come
+ * in bursts of up to three (plus one for rounding) that the lead
+ * absorbs until the following null packets have made up for them.
+ */
+#define SCR_LEAD_PACKETS 4
+
+TS_Stream::TS_Stream( unsigned int _sector_size,
+                      OutputStream &_output_strm,
+                      uint64_t max_seg_size,
+                      vector<ElementaryStream *> &streams )
+    : PS_Stream( 2, _sector_size, _output_strm, max_seg_size ),
+      pcr_pid( 0 ),
+      pat_continuity( 0 ),
+      pmt_continuity( 0 ),
+      ts_rate( 0 ),
+      PCR_origin( 0 ),
+      packets_out( 0 ),
+      late_packs( 0 ),
+      max_lateness( 0 ),
+      last_PCR( 0 ),
+      last_PSI( 0 ),
+      PCR_pending( true ),
+      PSI_pending( true ),
+      batched( 0 ),
+      ps_sector_size( _sector_size )
+{
+    std::vector<ElementaryStream *>::iterator str;
+    unsigned int pid = TS_FIRST_ES_PID;
+    for( str = streams.begin(); str < streams.end(); ++str )
+    {
+        TSProgramStream ps;
+        ps.stream_id = (*str)->stream_id;
+        ps.sub_stream_id = -1;
+        ps.pid = pid++;
+        ps.continuity = 0;
+        if( dynamic_cast<VideoStream *>(*str) != 0 )
+        {
+            ps.stream_type = 0x02;  // 13818-2 (or 11172-2) video
+            if( pcr_pid == 0 )
+                pcr_pid = ps.pid;
+        }
+        else if( dynamic_cast<MPAStream *>(*str) != 0 )
+            ps.stream_type = 0x03;  // 11172-3 audio
+        else if( dynamic_cast<AC3Stream *>(*str) != 0 )
+        {
+            ps.stream_type = 0x81;  // ATSC A/52 audio
+            ps.sub_stream_id =
+                static_cast<AC3Stream *>(*str)->SubStreamId();
+        }
+        else if( dynamic_cast<DTSStream *>(*str) != 0 )
+        {
+            ps.stream_type = 0x82;
+            ps.sub_stream_id =
+                static_cast<DTSStream *>(*str)->SubStreamId();
+        }
+        else
+        {
+            mjpeg_error_exit1( "Stream %02x: only MPEG video, MPEG audio, AC3 and DTS can be carried in a transport stream", ps.stream_id );
+        }
+        program.push_back( ps );
+    }
+    if( program.empty() )
+        mjpeg_error_exit1( "Transport stream: no streams to multiplex!" );
+    if( pcr_pid == 0 )
+        pcr_pid = program[0].pid;
+    batch = new uint8_t[TS_BATCH_PACKETS*TS_PACKET_SIZE];
+}
+
+TS_Stream::~TS_Stream()
+{
+    delete [] batch;
+}
+
+int TS_Stream::Open()
+{
+    PSI_pending = true;
+    PCR_pending = true;
+    batched = 0;
+    return output_strm.Open();
+}
+
+void TS_Stream::Close()
+{
+    WriteBatch();
+    output_strm.Close();
+    if( late_packs > 0 )
+        mjpeg_warn( "Transport stream: %u packs sent up to %.1f ms after their SCR",
+                    late_packs, static_cast<double>(max_lateness)/(CLOCKS/1000) );
+}
+
+void TS_Stream::NextSegment()
+{
+    WriteBatch();
+    output_strm.NextSegment();
+    // Each new file must be decodable on its own
+    PSI_pending = true;
+    PCR_pending = true;
+}
+
+void TS_Stream::Flush()
+{
+    WriteBatch();
+    output_strm.Flush();
+}
+
+uint64_t TS_Stream::OutputPosition()
+{
+    return output_strm.SegmentSize() + batched * TS_PACKET_SIZE;
+}
+
+/*************************************************************************
+ *
+ * The transport stream clock.  The rate allows for every sector of the
+ * program stream to need a whole number of transport packets, plus the
+ * PCR only and PSI packets, so the transport stream keeps up with the
+ * program stream's SCR.  Positions are converted in whole seconds
+ * first so that long streams don't overflow.
+ *
+ *************************************************************************/
+
+void TS_Stream::StartClock( const uint8_t *pack )
+{
+    uint64_t mux_rate = ((pack[10] << 14) | (pack[11] << 6) | (pack[12] >> 2));
+    uint64_t sector_packets =
+        (ps_sector_size + TS_PACKET_SIZE-5) / (TS_PACKET_SIZE-4);
+    ts_rate = (mux_rate * 50 * sector_packets * TS_PACKET_SIZE
+               + ps_sector_size - 1) / ps_sector_size
+        + (CLOCKS/PCR_INTERVAL + 2*CLOCKS/PSI_INTERVAL) * TS_PACKET_SIZE;
+    PCR_origin = PackSCR( pack );
+    mjpeg_info( "Transport stream rate: %d bytes/sec",
+                static_cast<int>(ts_rate) );
+}
+
+// PCR of the byte 'offset' into the next transport packet
+clockticks TS_Stream::PacketPCR( unsigned int offset ) const
+{
+    uint64_t bytes = packets_out * TS_PACKET_SIZE + offset;
+    return PCR_origin
+        + static_cast<clockticks>( (bytes / ts_rate) * CLOCKS
+                                   + (bytes % ts_rate) * CLOCKS / ts_rate );
+}
+
+bool TS_Stream::PCRDue() const
+{
+    return PCR_pending || PacketPCR(0) - last_PCR >= PCR_INTERVAL;
+}
+
+void TS_Stream::WriteBatch()
+{
+    if( batched == 0 )
+        return;
+    output_strm.Write( batch, batched*TS_PACKET_SIZE );
+    batched = 0;
+}
+
+TSProgramStream *TS_Stream::FindStream( uint8_t stream_id, int sub_stream_id )
+{
+    std::vector<TSProgramStream>::iterator ps;
+    for( ps = program.begin(); ps < program.end(); ++ps )
+    {
+        if( ps->stream_id == stream_id && ps->sub_stream_id == sub_stream_id )
+            return &*ps;
+    }
+    return 0;
+}
+
+/*************************************************************************
+ *
+ * RawWrite - take apart a program stream sector built by the
+ * Multiplexor and re-packetise its contents as transport packets.
+ *
+ *************************************************************************/
+
+void TS_Stream::RawWrite( uint8_t *data, unsigned int len )
+{
+    uint8_t *p = data;
+    uint8_t *end = data+len;
+    unsigned int pkt_len;
+    clockticks SCR;
+    uint64_t due, packet, lead;
+    unsigned int psi;
+    bool opening;
+
+    while( p+6 <= end && p[0] == 0 && p[1] == 0 && p[2] == 1 )
+    {
+        switch( p[3] )
+        {
+        case (PACK_START & 0xff) :
+            pkt_len = 14 + (p[13] & 0x7);
+            if( ts_rate == 0 )
+                StartClock( p );
+            //
+            // The first transport packet starting at or after the SCR,
+            // less the lead, carries the pack's data.  Null packets (and
+            // the PAT and PMT when they are due) fill the time up to it.
+            //
+            SCR = PackSCR( p );
+            due = SCR > PCR_origin ? static_cast<uint64_t>(SCR - PCR_origin) : 0;
+            due = (due / CLOCKS) * ts_rate
+                + ((due % CLOCKS) * ts_rate + CLOCKS - 1) / CLOCKS;
+            packet = (due + TS_PACKET_SIZE - 1) / TS_PACKET_SIZE;
+            lead = packet > SCR_LEAD_PACKETS ? packet - SCR_LEAD_PACKETS : 0;
+            psi = ( PSI_pending || PacketPCR(0) - last_PSI >= PSI_INTERVAL )
+                ? 2 : 0;
+            opening = packets_out == 0;
+            if( packets_out + psi < lead )
+                BufferNullPackets( lead - psi - packets_out );
+            if( psi > 0 )
+            {
+                last_PSI = PacketPCR(0);
+                BufferPAT();
+                BufferPMT();
+                PSI_pending = false;
+            }
+            // Only the PAT and PMT opening the stream come before the
+            // first pack's SCR can be met
+            if( packets_out > packet && !opening )
+            {
+                ++late_packs;
+                if( PacketPCR(0) - SCR > max_lateness )
+                    max_lateness = PacketPCR(0) - SCR;
+            }
+            break;
+        case (SYS_HEADER_START & 0xff) :
+            pkt_len = 6 + ((p[4] << 8) | p[5]);
+            break;
+        case (ISO11172_END & 0xff) :
+            pkt_len = 4;
+            break;
+        case PADDING_STR :
+            // The null packets before the next pack stand in for it
+            pkt_len = 6 + ((p[4] << 8) | p[5]);
+            break;
+        default :
+            pkt_len = 6 + ((p[4] << 8) | p[5]);
+            BufferPESPacket( p, pkt_len );
+            break;
+        }
+        p += pkt_len;
+    }
+}
+
+void TS_Stream::BufferPESPacket( uint8_t *packet, unsigned int len )
+{
+    uint8_t stream_id = packet[3];
+    unsigned int header_len = 9 + packet[8];
+    int sub_stream_id = -1;
+
+    //
+    // AC3/DTS sub-streams in private stream 1 packets carry a DVD
+    // style sub-stream header which has no place in a transport stream.
+    //
+    if( stream_id == PRIVATE_STR_1 )
+    {
+        sub_stream_id = packet[header_len];
+        if( len >= header_len+4 )
+        {
+            memmove( packet+header_len, packet+header_len+4,
+                     len-header_len-4 );
+            len -= 4;
+            BufferPacketSize( packet+4, packet+len );
+        }
+    }
+
+    TSProgramStream *ps = FindStream( stream_id, sub_stream_id );
+    if( ps == 0 )
+        mjpeg_error_exit1( "INTERNAL: no transport stream PID for stream %02x", stream_id );
+
+    if( ps->pid != pcr_pid && PCRDue() )
+        BufferPCRPacket();
+
+    bool unit_start = true;
+    while( len > 0 )
+    {
+        bool with_PCR = unit_start && ps->pid == pcr_pid && PCRDue();
+        unsigned int room = TS_PACKET_SIZE - 4 - (with_PCR ? 8 : 0);
+        unsigned int chunk = len < room ? len : room;
+        BufferTSPacket( ps->pid, ps->continuity, unit_start,
+                        packet, chunk, with_PCR );
+        packet += chunk;
+        len -= chunk;
+        unit_start = false;
+    }
+}
+
+/*************************************************************************
+ *
+ * BufferTSPacket - Append a transport packet to the output batch.
+ * Short payloads are stuffed out in the adaptation field.  A zero
+ * length payload gives an adaptation field only packet (used to
+ * carry a PCR on its own).
+ *
+ *************************************************************************/
+
+void TS_Stream::BufferTSPacket( unsigned int pid,
+                                unsigned int &continuity,
+                                bool unit_start,
+                                const uint8_t *payload,
+                                unsigned int payload_len,
+                                bool with_PCR )
+{
+    uint8_t *pkt = batch + batched*TS_PACKET_SIZE;
+    uint8_t *index = pkt;
+    bool adaptation = with_PCR || payload_len < TS_PACKET_SIZE-4;
+    unsigned int adaptation_control;
+    unsigned int cc;
+
+    if( payload_len == 0 )
+    {
+        adaptation_control = 2;
+        cc = (continuity + 15) & 0xf; // Not incremented
+    }
+    else
+    {
+        adaptation_control = adaptation ? 3 : 1;
+        cc = continuity;
+        continuity = (continuity + 1) & 0xf;
+    }
+
+    *(index++) = TS_SYNC_BYTE;
+    *(index++) = static_cast<uint8_t>((unit_start ? 0x40 : 0) | (pid >> 8));
+    *(index++) = static_cast<uint8_t>(pid & 0xff);
+    *(index++) = static_cast<uint8_t>((adaptation_control << 4) | cc);
+
+    if( adaptation )
+    {
+        unsigned int field_len = TS_PACKET_SIZE - 5 - payload_len;
+        *(index++) = static_cast<uint8_t>(field_len);
+        if( field_len > 0 )
+        {
+            *(index++) = with_PCR ? 0x10 : 0x00;
+            if( with_PCR )
+            {
+                // Stamped with the time its last base bit (byte 10) arrives
+                clockticks PCR = PacketPCR( 10 );
+                clockticks base = PCR / 300;
+                unsigned int ext = static_cast<unsigned int>(PCR % 300);
+                *(index++) = static_cast<uint8_t>(base >> 25);
+                *(index++) = static_cast<uint8_t>(base >> 17);
+                *(index++) = static_cast<uint8_t>(base >> 9);
+                *(index++) = static_cast<uint8_t>(base >> 1);
+                *(index++) = static_cast<uint8_t>(((base & 1) << 7) | 0x7e
+                                                  | (ext >> 8));
+                *(index++) = static_cast<uint8_t>(ext & 0xff);
+                last_PCR = PCR;
+                PCR_pending = false;
+            }
+            while( index < pkt + TS_PACKET_SIZE - payload_len )
+                *(index++) = static_cast<uint8_t>(STUFFING_BYTE);
+        }
+    }
+    memcpy( index, payload, payload_len );
+
+    ++packets_out;
+    if( ++batched == TS_BATCH_PACKETS )
+        WriteBatch();
+}
+
+void TS_Stream::BufferPCRPacket()
+{
+    std::vector<TSProgramStream>::iterator ps;
+    for( ps = program.begin(); ps < program.end(); ++ps )
+    {
+        if( ps->pid == pcr_pid )
+            break;
+    }
+    BufferTSPacket( pcr_pid, ps->continuity, false, 0, 0, true );
+}
+
+/*************************************************************************
+ *
+ * BufferNullPackets - fill n packets worth of time in the fixed rate
+ * stream.  A PCR only packet takes the place of a null packet when a
+ * PCR is due so long gaps still get their PCRs.
+ *
+ *************************************************************************/
+
+void TS_Stream::BufferNullPackets( uint64_t n )
+{
+    for( ; n > 0; --n )
+    {
+        if( PCRDue() )
+        {
+            BufferPCRPacket();
+            continue;
+        }
+        uint8_t *pkt = batch + batched*TS_PACKET_SIZE;
+        pkt[0] = TS_SYNC_BYTE;
+        pkt[1] = static_cast<uint8_t>(TS_NULL_PID >> 8);
+        pkt[2] = static_cast<uint8_t>(TS_NULL_PID & 0xff);
+        pkt[3] = 0x10;
+        memset( pkt+4, STUFFING_BYTE, TS_PACKET_SIZE-4 );
+        ++packets_out;
+        if( ++batched == TS_BATCH_PACKETS )
+            WriteBatch();
+    }
+}
+
+/*************************************************************************
+ *
+ * Program Specific Information: a single program with a PAT
+ * pointing at its PMT.
+ *
+ *************************************************************************/
+
+void TS_Stream::BufferPSISection( unsigned int pid, unsigned int &continuity,
+                                  uint8_t *section, unsigned int len )
+{
+    uint8_t payload[TS_PACKET_SIZE-4];
+    uint32_t crc;
+
+    // Section length field counts from after itself, including the CRC
+    section[1] = static_cast<uint8_t>(0xb0 | ((len+4-3) >> 8));
+    section[2] = static_cast<uint8_t>((len+4-3) & 0xff);
+    crc = CRC32( section, len );
+    section[len++] = static_cast<uint8_t>(crc >> 24);
+    section[len++] = static_cast<uint8_t>(crc >> 16);
+    section[len++] = static_cast<uint8_t>(crc >> 8);
+    section[len++] = static_cast<uint8_t>(crc);
+    assert( len+1 <= sizeof(payload) );
+
+    payload[0] = 0;             // pointer_field
+    memcpy( payload+1, section, len );
+    memset( payload+1+len, STUFFING_BYTE, sizeof(payload)-1-len );
+    BufferTSPacket( pid, continuity, true, payload, sizeof(payload), false );
+}
+
+void TS_Stream::BufferPAT()
+{
+    uint8_t section[TS_PACKET_SIZE];
+    uint8_t *index = section;
+
+    *(index++) = 0x00;          // table_id: program_association_section
+    index += 2;                 // section_length: filled in later
+    *(index++) = 0x00;          // transport_stream_id
+    *(index++) = 0x01;
+    *(index++) = 0xc1;          // version 0, current_next_indicator
+    *(index++) = 0x00;          // section_number
+    *(index++) = 0x00;          // last_section_number
+    *(index++) = static_cast<uint8_t>(TS_PROGRAM_NUMBER >> 8);
+    *(index++) = static_cast<uint8_t>(TS_PROGRAM_NUMBER & 0xff);
+    *(index++) = static_cast<uint8_t>(0xe0 | (TS_PMT_PID >> 8));
+    *(index++) = static_cast<uint8_t>(TS_PMT_PID & 0xff);
+    BufferPSISection( TS_PAT_PID, pat_continuity, section, index-section );
+}
+
+void TS_Stream::BufferPMT()
+{
+    uint8_t section[TS_PACKET_SIZE];
+    uint8_t *index = section;
+
+    *(index++) = 0x02;          // table_id: TS_program_map_section
+    index += 2;                 // section_length: filled in later
+    *(index++) = static_cast<uint8_t>(TS_PROGRAM_NUMBER >> 8);
+    *(index++) = static_cast<uint8_t>(TS_PROGRAM_NUMBER & 0xff);
+    *(index++) = 0xc1;          // version 0, current_next_indicator
+    *(index++) = 0x00;          // section_number
+    *(index++) = 0x00;          // last_section_number
+    *(index++) = static_cast<uint8_t>(0xe0 | (pcr_pid >> 8));
+    *(index++) = static_cast<uint8_t>(pcr_pid & 0xff);
+    *(index++) = 0xf0;          // program_info_length = 0
+    *(index++) = 0x00;
+
+    std::vector<TSProgramStream>::iterator ps;
+    for( ps = program.begin(); ps < program.end(); ++ps )
+    {
+        *(index++) = ps->stream_type;
+        *(index++) = static_cast<uint8_t>(0xe0 | (ps->pid >> 8));
+        *(index++) = static_cast<uint8_t>(ps->pid & 0xff);
+        if( ps->stream_type == 0x81 )
+        {
+            // registration_descriptor: format_identifier "AC-3"
+            *(index++) = 0xf0;
+            *(index++) = 6;
+            *(index++) = 0x05;
+            *(index++) = 4;
+            *(index++) = 'A';
+            *(index++) = 'C';
+            *(index++) = '-';
+            *(index++) = '3';
+        }
+        else
+        {
+            *(index++) = 0xf0;
+            *(index++) = 0;
+        }
+    }
+    BufferPSISection( TS_PMT_PID, pmt_continuity, section, index-section );
+}
+
+/*************************************************************************
+ *
+ * PackSCR - Recover the SCR from an MPEG-2 pack header.
+ *
+ *************************************************************************/
+
+clockticks TS_Stream::PackSCR( const uint8_t *pack )
+{
+    const uint8_t *b = pack+4;
+    clockticks base =
+        (static_cast<clockticks>((b[0] >> 3) & 0x7) << 30)
+        | (static_cast<clockticks>(b[0] & 0x3) << 28)
+        | (static_cast<clockticks>(b[1]) << 20)
+        | (static_cast<clockticks>(b[2] >> 3) << 15)
+        | (static_cast<clockticks>(b[2] & 0x3) << 13)
+        | (static_cast<clockticks>(b[3]) << 5)
+        | static_cast<clockticks>(b[4] >> 3);
+    unsigned int ext = ((b[4] & 0x3) << 7) | (b[5] >> 1);
+    return base * 300 + ext;
+}
+
+/* MPEG-2 systems CRC: polynomial 0x04c11db7, no reflection */
+uint32_t TS_Stream::CRC32( const uint8_t *data, unsigned int len )
+{
+    uint32_t crc = 0xffffffff;
+    unsigned int i;
+    int bit;
+    for( i = 0; i < len; ++i )
+    {
+        crc ^= static_cast<uint32_t>(data[i]) << 24;
+        for( bit = 0; bit < 8; ++bit )
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : (crc << 1);
+    }
+    return crc;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
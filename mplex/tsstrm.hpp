@@ -0,0 +1,138 @@
+/*
+ *  tsstrm.hpp:  MPEG-2 Transport stream packet generator
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __TSSTRM_HH__
+#define __TSSTRM_HH__
+
+#include "systems.hpp"
+#include <vector>
+
+using std::vector;
+
+#define TS_PACKET_SIZE          188
+#define TS_SYNC_BYTE            0x47
+#define TS_PAT_PID              0x0000
+#define TS_PMT_PID              0x0100
+#define TS_NULL_PID             0x1fff
+#define TS_FIRST_ES_PID         0x0101
+#define TS_PROGRAM_NUMBER       1
+
+/* Number of TS packets collected before being written out */
+#define TS_BATCH_PACKETS        348
+
+/*************************************************************************
+ *
+ * TS_Stream - Transport stream output.
+ *
+ * The Multiplexor schedules and builds its sectors exactly as it does
+ * for a program stream (SCR, decoder buffer model, AU splitting are
+ * all reused unchanged).  Instead of being written out the sectors
+ * are taken apart here: system headers, padding and the end code are
+ * dropped and every PES packet is cut into 188 byte transport packets
+ * on the PID of its elementary stream.  A PAT and PMT are repeated
+ * regularly.  Transport packets are collected and written in large
+ * batches.
+ *
+ * The transport stream has a fixed rate of its own, a little above the
+ * program stream's mux rate plus the transport overhead.  The PCR of
+ * each transport packet follows from its position at that rate, and
+ * null packets are inserted before each pack until its data reaches
+ * the position its SCR asks for, less a few packets of lead that
+ * absorb the bursts of PCR only and PSI packets.
+ *
+ *************************************************************************/
+
+class ElementaryStream;
+
+struct TSProgramStream
+{
+    uint8_t stream_id;
+    int sub_stream_id;          // Private stream 1 sub-stream or -1
+    unsigned int pid;
+    uint8_t stream_type;
+    unsigned int continuity;
+};
+
+class TS_Stream : public PS_Stream
+{
+public:
+    TS_Stream( unsigned int _sector_size,
+               OutputStream &_output_strm,
+               uint64_t max_segment_size, // 0 = No Limit
+               vector<ElementaryStream *> &streams
+        );
+    virtual ~TS_Stream();
+
+    virtual int Open();
+    virtual void Close();
+    virtual void RawWrite(uint8_t *data, unsigned int len);
+    virtual void NextSegment();
+    virtual void Flush();
+    virtual uint64_t OutputPosition();
+
+private:
+    TSProgramStream *FindStream( uint8_t stream_id, int sub_stream_id );
+    void BufferTSPacket( unsigned int pid,
+                         unsigned int &continuity,
+                         bool unit_start,
+                         const uint8_t *payload,
+                         unsigned int payload_len,
+                         bool with_PCR );
+    void BufferNullPackets( uint64_t n );
+    void BufferPCRPacket();
+    void BufferPESPacket( uint8_t *packet, unsigned int len );
+    void BufferPSISection( unsigned int pid, unsigned int &continuity,
+                           uint8_t *section, unsigned int len );
+    void BufferPAT();
+    void BufferPMT();
+    void WriteBatch();
+    void StartClock( const uint8_t *pack );
+    clockticks PacketPCR( unsigned int offset ) const;
+    bool PCRDue() const;
+    static clockticks PackSCR( const uint8_t *pack );
+    static uint32_t CRC32( const uint8_t *data, unsigned int len );
+
+    vector<TSProgramStream> program;
+    unsigned int pcr_pid;
+    unsigned int pat_continuity;
+    unsigned int pmt_continuity;
+
+    uint64_t ts_rate;           // Bytes/sec, 0 until the first pack
+    clockticks PCR_origin;      // PCR of the first byte of the stream
+    uint64_t packets_out;       // Transport packets so far, all segments
+    unsigned int late_packs;
+    clockticks max_lateness;
+    clockticks last_PCR;
+    clockticks last_PSI;
+    bool PCR_pending;
+    bool PSI_pending;
+
+    uint8_t *batch;
+    unsigned int batched;
+    unsigned int ps_sector_size;
+};
+
+#endif // __TSSTRM_HH__
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
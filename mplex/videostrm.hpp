@@ -36,6 +36,8 @@ public:
     static bool Probe(IBitStream &bs );
 
 	void Close();
+    virtual bool SaveScanState( vector<double> &state );
+    virtual void RestoreScanState( const vector<double> &state );
 
     inline int DecoderOrder() { return au->dorder; }
 	inline int AUType()	{ return au->type; }
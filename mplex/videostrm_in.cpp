@@ -356,6 +356,43 @@ void VideoStream::Close()
 
 
 
+bool VideoStream::SaveScanState( vector<double> &state )
+{
+    int i;
+    state.push_back( num_sequence );
+    state.push_back( num_seq_end );
+    state.push_back( num_pictures );
+    state.push_back( num_groups );
+    for( i = 0; i < 4; ++i )
+    {
+        state.push_back( num_frames[i] );
+        state.push_back( static_cast<double>(avg_frames[i]) );
+    }
+    state.push_back( fields_presented );
+    state.push_back( pulldown_32 );
+    state.push_back( max_bits_persec );
+    return true;
+}
+
+void VideoStream::RestoreScanState( const vector<double> &state )
+{
+    int i;
+    if( state.size() != 15 )
+        return;
+    num_sequence = static_cast<unsigned int>(state[0]);
+    num_seq_end = static_cast<unsigned int>(state[1]);
+    num_pictures = static_cast<unsigned int>(state[2]);
+    num_groups = static_cast<unsigned int>(state[3]);
+    for( i = 0; i < 4; ++i )
+    {
+        num_frames[i] = static_cast<unsigned int>(state[4+2*i]);
+        avg_frames[i] = static_cast<int64_t>(state[5+2*i]);
+    }
+    fields_presented = static_cast<int>(state[12]);
+    pulldown_32 = static_cast<int>(state[13]);
+    max_bits_persec = state[14];
+}
+
 /*************************************************************************
 	OutputSeqHdrInfo
      Display sequence header parameters
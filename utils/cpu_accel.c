@@ -118,6 +118,7 @@ static int testsseill()
 static int x86_accel (void)
 {
     long eax, ebx, ecx, edx;
+    long maxleaf;
     int32_t AMD;
     int32_t caps;
 
@@ -144,6 +145,23 @@ static int x86_accel (void)
 	 : "a" (op)			\
 	 : "cc", "edi")
 
+/* the same, for the leaves with sub-leaves in ecx */
+#define cpuid_count(op,count,eax,ebx,ecx,edx)	\
+    asm ( "push %%"REG_b"\n" \
+	      "cpuid\n" \
+	      "mov   %%"REG_b", %%"REG_S"\n" \
+	      "pop   %%"REG_b"\n"  \
+	 : "=a" (eax),			\
+	   "=S" (ebx),			\
+	   "=c" (ecx),			\
+	   "=d" (edx)			\
+	 : "a" (op), "c" (count)		\
+	 : "cc", "edi")
+
+/* xgetbv, spelled out for assemblers that do not know it */
+#define xgetbv(index,eax,edx)	\
+    asm ( ".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (index))
+
     asm ("pushf\n\t"
 	 "pop %0\n\t"
 	 "mov %0,%1\n\t"
@@ -164,6 +182,7 @@ static int x86_accel (void)
     cpuid (0x00000000, eax, ebx, ecx, edx);
     if (!eax)			// vendor string only
 	return 0;
+    maxleaf = eax;
 
     AMD = (ebx == 0x68747541) && (ecx == 0x444d4163) && (edx == 0x69746e65);
 
@@ -188,6 +207,29 @@ static int x86_accel (void)
 		if( !testsseill() )
 			caps |= ACCEL_X86_SSE;
 	}
+	if( (caps & ACCEL_X86_SSE) && (edx & 0x04000000) )
+		caps |= ACCEL_X86_SSE2;
+
+	/* AVX2 and AVX-512 need the O.S. to save the wider registers too,
+	   which it says in XCR0 (readable once OSXSAVE is set): YMM state
+	   for AVX2, and opmask and ZMM state as well for AVX-512.
+	*/
+	if( (caps & ACCEL_X86_SSE2) && (ecx & 0x18000000) == 0x18000000
+	    && maxleaf >= 7 )
+	{
+		long xcr0, xcr0_hi;
+
+		xgetbv (0, xcr0, xcr0_hi);
+		cpuid_count (0x00000007, 0, eax, ebx, ecx, edx);
+		if( (xcr0 & 0x06) == 0x06 && (ebx & 0x00000020) )
+		{
+			caps |= ACCEL_X86_AVX2;
+			/* AVX512F and AVX512BW */
+			if( (xcr0 & 0xe6) == 0xe6
+			    && (ebx & 0x40010000) == 0x40010000 )
+				caps |= ACCEL_X86_AVX512BW;
+		}
+	}
 
     cpuid (0x80000000, eax, ebx, ecx, edx);
     if (eax < 0x80000001)	// no extended capabilities
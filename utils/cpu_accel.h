@@ -30,6 +30,9 @@
 #define ACCEL_X86_3DNOW	0x40000000
 #define ACCEL_X86_MMXEXT 0x20000000
 #define ACCEL_X86_SSE   0x10000000
+#define ACCEL_X86_SSE2  0x08000000
+#define ACCEL_X86_AVX2  0x04000000
+#define ACCEL_X86_AVX512BW 0x02000000
 
 #ifdef __cplusplus
 extern "C" {
@@ -0,0 +1,1945 @@
+/*
+ * y4mconvert.c:  Pixel format conversions for YUV4MPEG2 frames:
+ *                colorspace, sample depth, chroma resampling and
+ *                packed <-> planar.
+ *
+ *
+ *  Copyright (C) 2001 Matthew J. Marjanovic <maddog@mir.com>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+/*
+ * Large frames are split into bands of rows, each converted by a
+ *  thread of its own.  The SSE2 kernels compute exactly what the plain
+ *  C loops do, so the output does not depend on either.  The AVX2 ones,
+ *  picked at run time, do the same again, leaving the rest of a row to
+ *  the SSE2 and C loops.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include <mjpeg_types.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+/* built for AVX2 by function attributes, whatever the flags of the rest
+   of the file */
+#if defined(__SSE2__) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+# include <immintrin.h>
+# define HAVE_AVX2_KERNELS 1
+# define AVX2_FN __attribute__ ((target ("avx2")))
+#endif
+
+#include "cpu_accel.h"
+#include "y4mconvert.h"
+
+
+
+/*************************************************************************
+ * Row bands
+ *************************************************************************/
+
+#define MAX_THREADS 16
+#define MIN_BAND_BYTES (64 * 1024)  /* less is not worth a thread */
+
+static int _convert_threads = -1;
+
+int y4m_convert_threads(int n)
+{
+  int old = _convert_threads;
+  if (old < 0) {
+    const char *env = getenv("MJPEG_CONVERT_THREADS");
+    if (env != NULL)
+      old = atoi(env);
+    else
+      old = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (old < 1) old = 1;
+    if (old > MAX_THREADS) old = MAX_THREADS;
+  }
+  if (n > MAX_THREADS) n = MAX_THREADS;
+  _convert_threads = (n > 0) ? n : old;
+  return old;
+}
+
+
+typedef void (*band_fn)(void *arg, int first, int last);
+
+typedef struct {
+  band_fn fn;
+  void *arg;
+  int first, last;
+} band_t;
+
+/* number of bands 'count' units of 'unitbytes' each would be split in */
+static int band_count(int count, int unitbytes)
+{
+#ifdef HAVE_PTHREAD
+  int n = y4m_convert_threads(-1);
+  long bytes = (long)count * unitbytes;
+  if (n > bytes / MIN_BAND_BYTES) n = bytes / MIN_BAND_BYTES;
+  if (n > count) n = count;
+  return (n > 1) ? n : 1;
+#else
+  return 1;
+#endif
+}
+
+static void *run_band(void *p)
+{
+  band_t *b = p;
+  (*b->fn)(b->arg, b->first, b->last);
+  return NULL;
+}
+
+
+/* The kernels, from SSE2 (when built for it) up; MJPEG_CONVERT_SIMD picks
+   a lower level than the processor allows, to compare them. */
+enum { SIMD_SSE2, SIMD_AVX2 };
+static const char *simd_names[] = { "sse2", "avx2" };
+
+static int _convert_simd = -1;
+
+static void simd_init(void)
+{
+  int avail = SIMD_SSE2, level;
+  const char *env;
+
+  if (_convert_simd >= 0)
+    return;
+#if defined(HAVE_AVX2_KERNELS)
+  if ((cpu_accel() & (ACCEL_X86_SSE2 | ACCEL_X86_AVX2)) ==
+      (ACCEL_X86_SSE2 | ACCEL_X86_AVX2))
+    avail = SIMD_AVX2;
+#endif
+  level = avail;
+  if ((env = getenv("MJPEG_CONVERT_SIMD")) != NULL) {
+    for (level = SIMD_AVX2; level >= SIMD_SSE2; level--)
+      if (strcasecmp(env, simd_names[level]) == 0)
+	break;
+    if (level < SIMD_SSE2) {
+      mjpeg_warn("Unknown MJPEG_CONVERT_SIMD \"%s\", using %s",
+		 env, simd_names[avail]);
+      level = avail;
+    } else if (level > avail) {
+      mjpeg_warn("MJPEG_CONVERT_SIMD \"%s\" not available, using %s",
+		 env, simd_names[avail]);
+      level = avail;
+    }
+  }
+  _convert_simd = level;
+}
+
+/* call fn(arg, first, last) over [0, count), in bands run in parallel */
+static void run_bands(band_fn fn, void *arg, int count, int unitbytes)
+{
+#ifdef HAVE_PTHREAD
+  band_t bands[MAX_THREADS];
+  pthread_t threads[MAX_THREADS];
+  int n = band_count(count, unitbytes);
+  int i, started;
+#endif
+
+  simd_init();
+#ifdef HAVE_PTHREAD
+
+  if (n > 1) {
+    for (i = 0; i < n; i++) {
+      bands[i].fn = fn;
+      bands[i].arg = arg;
+      bands[i].first = (int)((long)count * i / n);
+      bands[i].last = (int)((long)count * (i + 1) / n);
+    }
+    for (started = 1; started < n; started++)
+      if (pthread_create(&threads[started], NULL, run_band, &bands[started]))
+	break;
+    run_band(&bands[0]);
+    /* bands whose thread could not be created are done here */
+    for (i = started; i < n; i++)
+      run_band(&bands[i]);
+    for (i = 1; i < started; i++)
+      pthread_join(threads[i], NULL);
+    return;
+  }
+#endif
+  (*fn)(arg, 0, count);
+}
+
+
+
+/*************************************************************************
+ * Colorspace
+ *************************************************************************/
+
+#define FP_BITS 18
+
+/* precomputed tables */
+
+static int Y_R[256];
+static int Y_G[256];
+static int Y_B[256];
+static int Cb_R[256];
+static int Cb_G[256];
+static int Cb_B[256];
+static int Cr_R[256];
+static int Cr_G[256];
+static int Cr_B[256];
+static int conv_RY_inited = 0;
+
+static int RGB_Y[256];
+static int R_Cr[256];
+static int G_Cb[256];
+static int G_Cr[256];
+static int B_Cb[256];
+static int conv_YR_inited = 0;
+
+
+static int myround(double n)
+{
+  if (n >= 0)
+    return (int)(n + 0.5);
+  else
+    return (int)(n - 0.5);
+}
+
+
+
+static void init_RGB_to_YCbCr_tables(void)
+{
+  int i;
+
+  /*
+   * Q_Z[i] =   (coefficient * i
+   *             * (Q-excursion) / (Z-excursion) * fixed-point-factor)
+   *
+   * to one of each, add the following:
+   *             + (fixed-point-factor / 2)         --- for rounding later
+   *             + (Q-offset * fixed-point-factor)  --- to add the offset
+   *
+   */
+  for (i = 0; i < 256; i++) {
+    Y_R[i] = myround(0.299 * (double)i
+		     * 219.0 / 255.0 * (double)(1<<FP_BITS));
+    Y_G[i] = myround(0.587 * (double)i
+		     * 219.0 / 255.0 * (double)(1<<FP_BITS));
+    Y_B[i] = myround((0.114 * (double)i
+		      * 219.0 / 255.0 * (double)(1<<FP_BITS))
+		     + (double)(1<<(FP_BITS-1))
+		     + (16.0 * (double)(1<<FP_BITS)));
+
+    Cb_R[i] = myround(-0.168736 * (double)i
+		      * 224.0 / 255.0 * (double)(1<<FP_BITS));
+    Cb_G[i] = myround(-0.331264 * (double)i
+		      * 224.0 / 255.0 * (double)(1<<FP_BITS));
+    Cb_B[i] = myround((0.500 * (double)i
+		       * 224.0 / 255.0 * (double)(1<<FP_BITS))
+		      + (double)(1<<(FP_BITS-1))
+		      + (128.0 * (double)(1<<FP_BITS)));
+
+    Cr_R[i] = myround(0.500 * (double)i
+		      * 224.0 / 255.0 * (double)(1<<FP_BITS));
+    Cr_G[i] = myround(-0.418688 * (double)i
+		      * 224.0 / 255.0 * (double)(1<<FP_BITS));
+    Cr_B[i] = myround((-0.081312 * (double)i
+		       * 224.0 / 255.0 * (double)(1<<FP_BITS))
+		      + (double)(1<<(FP_BITS-1))
+		      + (128.0 * (double)(1<<FP_BITS)));
+  }
+  conv_RY_inited = 1;
+}
+
+
+
+
+static void init_YCbCr_to_RGB_tables(void)
+{
+  int i;
+
+  /*
+   * Q_Z[i] =   (coefficient * i
+   *             * (Q-excursion) / (Z-excursion) * fixed-point-factor)
+   *
+   * to one of each, add the following:
+   *             + (fixed-point-factor / 2)         --- for rounding later
+   *             + (Q-offset * fixed-point-factor)  --- to add the offset
+   *
+   */
+
+  /* clip Y values under 16 */
+  for (i = 0; i < 16; i++) {
+    RGB_Y[i] = myround((1.0 * (double)(16 - 16)
+		     * 255.0 / 219.0 * (double)(1<<FP_BITS))
+		    + (double)(1<<(FP_BITS-1)));
+  }
+  for (i = 16; i < 236; i++) {
+    RGB_Y[i] = myround((1.0 * (double)(i - 16)
+		     * 255.0 / 219.0 * (double)(1<<FP_BITS))
+		    + (double)(1<<(FP_BITS-1)));
+  }
+  /* clip Y values above 235 */
+  for (i = 236; i < 256; i++) {
+    RGB_Y[i] = myround((1.0 * (double)(235 - 16)
+		     * 255.0 / 219.0 * (double)(1<<FP_BITS))
+		    + (double)(1<<(FP_BITS-1)));
+  }
+
+  /* clip Cb/Cr values below 16 */
+  for (i = 0; i < 16; i++) {
+    R_Cr[i] = myround(1.402 * (double)(-112)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    G_Cr[i] = myround(-0.714136 * (double)(-112)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    G_Cb[i] = myround(-0.344136 * (double)(-112)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    B_Cb[i] = myround(1.772 * (double)(-112)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+  }
+  for (i = 16; i < 241; i++) {
+    R_Cr[i] = myround(1.402 * (double)(i - 128)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    G_Cr[i] = myround(-0.714136 * (double)(i - 128)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    G_Cb[i] = myround(-0.344136 * (double)(i - 128)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    B_Cb[i] = myround(1.772 * (double)(i - 128)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+  }
+  /* clip Cb/Cr values above 240 */
+  for (i = 241; i < 256; i++) {
+    R_Cr[i] = myround(1.402 * (double)(112)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    G_Cr[i] = myround(-0.714136 * (double)(112)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    G_Cb[i] = myround(-0.344136 * (double)(i - 128)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+    B_Cb[i] = myround(1.772 * (double)(112)
+		   * 255.0 / 224.0 * (double)(1<<FP_BITS));
+  }
+  conv_YR_inited = 1;
+}
+
+
+
+static void RGB_to_YCbCr_band(void *arg, int first, int last)
+{
+  uint8_t **planes = arg;
+  uint8_t *Y, *Cb, *Cr;
+  int i;
+
+  for ( i = first, Y = planes[0] + first,
+	  Cb = planes[1] + first, Cr = planes[2] + first;
+	i < last;
+	i++, Y++, Cb++, Cr++ ) {
+    int r = *Y;
+    int g = *Cb;
+    int b = *Cr;
+
+    *Y = (Y_R[r] + Y_G[g]+ Y_B[b]) >> FP_BITS;
+    *Cb = (Cb_R[r] + Cb_G[g]+ Cb_B[b]) >> FP_BITS;
+    *Cr = (Cr_R[r] + Cr_G[g]+ Cr_B[b]) >> FP_BITS;
+  }
+}
+
+/*
+ * in-place conversion [R', G', B'] --> [Y', Cb, Cr]
+ *
+ */
+
+void y4m_convert_RGB_to_YCbCr(uint8_t *planes[], int length)
+{
+  if (!conv_RY_inited) init_RGB_to_YCbCr_tables();
+  run_bands(RGB_to_YCbCr_band, planes, length, 3);
+}
+
+
+
+static void YCbCr_to_RGB_band(void *arg, int first, int last)
+{
+  uint8_t **planes = arg;
+  uint8_t *R, *G, *B;
+  int i;
+
+  for ( i = first, R = planes[0] + first,
+	  G = planes[1] + first, B = planes[2] + first;
+	i < last;
+	i++, R++, G++, B++ ) {
+    int y = *R;
+    int cb = *G;
+    int cr = *B;
+
+    int r = (RGB_Y[y] + R_Cr[cr]) >> FP_BITS;
+    int g = (RGB_Y[y] + G_Cb[cb]+ G_Cr[cr]) >> FP_BITS;
+    int b = (RGB_Y[y] + B_Cb[cb]) >> FP_BITS;
+
+    *R = (r < 0) ? 0 : (r > 255) ? 255 : r ;
+    *G = (g < 0) ? 0 : (g > 255) ? 255 : g ;
+    *B = (b < 0) ? 0 : (b > 255) ? 255 : b ;
+  }
+}
+
+/*
+ * in-place conversion [Y', Cb, Cr] --> [R', G', B']
+ *
+ */
+
+void y4m_convert_YCbCr_to_RGB(uint8_t *planes[], int length)
+{
+  if (!conv_YR_inited) init_YCbCr_to_RGB_tables();
+  run_bands(YCbCr_to_RGB_band, planes, length, 3);
+}
+
+
+static uint8_t Y219_255[256];
+static int conv_Y219_Y255_inited = 0;
+static uint8_t Y255_219[256];
+static int conv_Y255_Y219_inited = 0;
+
+static void init_Y255_to_Y219_tables(void)
+{
+  int i;
+  for (i = 0; i < 256; i++)
+    Y255_219[i] = myround((double)i * 219.0 / 255.0) + 16;
+  conv_Y255_Y219_inited = 1;
+}
+
+static void init_Y219_to_Y255_tables(void)
+{
+  int i = 0;
+  for ( ; i < 16; i++)  Y219_255[i] = 0;
+  for ( ; i < 236; i++) Y219_255[i] = myround((double)(i-16) * 255.0 / 219.0);
+  for ( ; i < 256; i++) Y219_255[i] = 255;
+  conv_Y219_Y255_inited = 1;
+}
+
+
+static void lookup(uint8_t *plane, int length, const uint8_t *table)
+{
+  while (length > 0) {
+    *plane = table[*plane];
+    plane++;
+    length--;
+  }
+}
+
+static void Y255_to_Y219_band(void *arg, int first, int last)
+{
+  lookup((uint8_t *)arg + first, last - first, Y255_219);
+}
+
+static void Y219_to_Y255_band(void *arg, int first, int last)
+{
+  lookup((uint8_t *)arg + first, last - first, Y219_255);
+}
+
+void y4m_convert_Y255_to_Y219(uint8_t *plane, int length)
+{
+  if (!conv_Y255_Y219_inited) init_Y255_to_Y219_tables();
+  run_bands(Y255_to_Y219_band, plane, length, 1);
+}
+
+void y4m_convert_Y219_to_Y255(uint8_t *plane, int length)
+{
+  if (!conv_Y219_Y255_inited) init_Y219_to_Y255_tables();
+  run_bands(Y219_to_Y255_band, plane, length, 1);
+}
+
+
+
+/*
+ * Deep samples (two bytes each, least significant first) are on the
+ *  8-bit scale times 2^(bitdepth - 8), as y4m_convert_8_to_deep() makes
+ *  them:  Y' [16,235] is [16 << s, 235 << s], and so on.
+ */
+
+static inline int get16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static inline void put16(uint8_t *p, int v)
+{
+  p[0] = v & 0xff;
+  p[1] = v >> 8;
+}
+
+static inline int clip(int v, int lo, int hi)
+{
+  return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+
+typedef struct {
+  uint8_t **planes;
+  int shift, max;
+  int64_t k[9];           /* coefficients, FP_BITS fixed point */
+} deep_cs_t;
+
+/* coefficient i, for samples of the given excursions, in k[i] */
+static void init_deep_cs(deep_cs_t *cs, uint8_t *planes[], int bitdepth,
+			 const double coef[9], const double excursion[9])
+{
+  int i;
+
+  cs->planes = planes;
+  cs->shift = bitdepth - 8;
+  cs->max = (1 << bitdepth) - 1;
+  for (i = 0; i < 9; i++)
+    cs->k[i] = myround(coef[i] * excursion[i] * (double)(1<<FP_BITS));
+}
+
+static void RGB_to_YCbCr_deep_band(void *arg, int first, int last)
+{
+  deep_cs_t *cs = arg;
+  const int64_t *k = cs->k;
+  const int64_t half = 1 << (FP_BITS-1);
+  const int64_t y0 = ((int64_t)16 << cs->shift << FP_BITS) + half;
+  const int64_t c0 = ((int64_t)128 << cs->shift << FP_BITS) + half;
+  uint8_t *Y = cs->planes[0] + 2 * first;
+  uint8_t *Cb = cs->planes[1] + 2 * first;
+  uint8_t *Cr = cs->planes[2] + 2 * first;
+  int i;
+
+  for (i = first; i < last; i++, Y += 2, Cb += 2, Cr += 2) {
+    int64_t r = get16(Y);
+    int64_t g = get16(Cb);
+    int64_t b = get16(Cr);
+
+    put16(Y, clip((int)((k[0]*r + k[1]*g + k[2]*b + y0) >> FP_BITS), 0, cs->max));
+    put16(Cb, clip((int)((k[3]*r + k[4]*g + k[5]*b + c0) >> FP_BITS), 0, cs->max));
+    put16(Cr, clip((int)((k[6]*r + k[7]*g + k[8]*b + c0) >> FP_BITS), 0, cs->max));
+  }
+}
+
+void y4m_convert_RGB_to_YCbCr_deep(uint8_t *planes[], int bitdepth, int length)
+{
+  static const double coef[9] = {
+    0.299, 0.587, 0.114,                /* Y' */
+    -0.168736, -0.331264, 0.500,        /* Cb */
+    0.500, -0.418688, -0.081312,        /* Cr */
+  };
+  static const double excursion[9] = {
+    219.0 / 255.0, 219.0 / 255.0, 219.0 / 255.0,
+    224.0 / 255.0, 224.0 / 255.0, 224.0 / 255.0,
+    224.0 / 255.0, 224.0 / 255.0, 224.0 / 255.0,
+  };
+  deep_cs_t cs;
+
+  init_deep_cs(&cs, planes, bitdepth, coef, excursion);
+  run_bands(RGB_to_YCbCr_deep_band, &cs, length, 6);
+}
+
+
+static void YCbCr_to_RGB_deep_band(void *arg, int first, int last)
+{
+  deep_cs_t *cs = arg;
+  const int64_t *k = cs->k;
+  const int64_t half = 1 << (FP_BITS-1);
+  int s = cs->shift;
+  uint8_t *R = cs->planes[0] + 2 * first;
+  uint8_t *G = cs->planes[1] + 2 * first;
+  uint8_t *B = cs->planes[2] + 2 * first;
+  int i;
+
+  for (i = first; i < last; i++, R += 2, G += 2, B += 2) {
+    /* clipped to the nominal ranges, as by the 8-bit tables */
+    int64_t y = k[0] * (clip(get16(R), 16 << s, 235 << s) - (16 << s)) + half;
+    int64_t cb = clip(get16(G), 16 << s, 240 << s) - (128 << s);
+    int64_t cr = clip(get16(B), 16 << s, 240 << s) - (128 << s);
+
+    put16(R, clip((int)((y + k[1]*cr) >> FP_BITS), 0, cs->max));
+    put16(G, clip((int)((y + k[2]*cb + k[3]*cr) >> FP_BITS), 0, cs->max));
+    put16(B, clip((int)((y + k[4]*cb) >> FP_BITS), 0, cs->max));
+  }
+}
+
+void y4m_convert_YCbCr_to_RGB_deep(uint8_t *planes[], int bitdepth, int length)
+{
+  static const double coef[9] = {
+    1.0,                                /* Y' */
+    1.402,                              /* R from Cr */
+    -0.344136, -0.714136,               /* G from Cb, Cr */
+    1.772,                              /* B from Cb */
+  };
+  static const double excursion[9] = {
+    255.0 / 219.0,
+    255.0 / 224.0,
+    255.0 / 224.0, 255.0 / 224.0,
+    255.0 / 224.0,
+  };
+  deep_cs_t cs;
+
+  init_deep_cs(&cs, planes, bitdepth, coef, excursion);
+  run_bands(YCbCr_to_RGB_deep_band, &cs, length, 6);
+}
+
+
+/* Y' range tables for deep samples, of 2^bitdepth entries, made for the
+   last bit depth asked for */
+static uint16_t *Y255_219_deep = NULL;
+static int Y255_219_deep_bits = 0;
+static uint16_t *Y219_255_deep = NULL;
+static int Y219_255_deep_bits = 0;
+
+static uint16_t *init_deep_Y_table(uint16_t **table, int *bits,
+				   int bitdepth, int to219)
+{
+  int s = bitdepth - 8;
+  int max = (1 << bitdepth) - 1;
+  int i;
+
+  if (*bits == bitdepth)
+    return *table;
+  free(*table);
+  if ((*table = malloc(sizeof(**table) << bitdepth)) == NULL)
+    mjpeg_error_exit1("Could not allocate Y' table");
+  for (i = 0; i <= max; i++) {
+    double v = (double)i / (double)(1 << s);      /* on the 8-bit scale */
+    if (to219)
+      v = v * 219.0 / 255.0 + 16.0;
+    else
+      v = (((v < 16.0) ? 16.0 : (v > 235.0) ? 235.0 : v) - 16.0)
+	* 255.0 / 219.0;
+    (*table)[i] = clip(myround(v * (double)(1 << s)), 0, max);
+  }
+  *bits = bitdepth;
+  return *table;
+}
+
+typedef struct {
+  uint8_t *plane;
+  const uint16_t *table;
+  int mask;
+} deep_lookup_t;
+
+static void lookup_deep_band(void *arg, int first, int last)
+{
+  deep_lookup_t *lu = arg;
+  uint8_t *p = lu->plane + 2 * first;
+  int i;
+
+  for (i = first; i < last; i++, p += 2)
+    put16(p, lu->table[get16(p) & lu->mask]);
+}
+
+void y4m_convert_Y255_to_Y219_deep(uint8_t *plane, int bitdepth, int length)
+{
+  deep_lookup_t lu;
+
+  lu.plane = plane;
+  lu.table = init_deep_Y_table(&Y255_219_deep, &Y255_219_deep_bits,
+			       bitdepth, 1);
+  lu.mask = (1 << bitdepth) - 1;
+  run_bands(lookup_deep_band, &lu, length, 2);
+}
+
+void y4m_convert_Y219_to_Y255_deep(uint8_t *plane, int bitdepth, int length)
+{
+  deep_lookup_t lu;
+
+  lu.plane = plane;
+  lu.table = init_deep_Y_table(&Y219_255_deep, &Y219_255_deep_bits,
+			       bitdepth, 0);
+  lu.mask = (1 << bitdepth) - 1;
+  run_bands(lookup_deep_band, &lu, length, 2);
+}
+
+
+
+/*************************************************************************
+ * Sample depth
+ *************************************************************************/
+
+typedef struct {
+  uint8_t *dst;
+  const uint8_t *src;
+  int shift;
+} depth_t;
+
+#if defined(HAVE_AVX2_KERNELS)
+/* these return how many samples they did */
+AVX2_FN static int deep_to_8_avx2(uint8_t *out, const uint8_t *in, int n,
+				  int round, int shift)
+{
+  const __m256i r = _mm256_set1_epi16(round);
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  int i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(in + 2 * i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(in + 2 * i + 32));
+    a = _mm256_srl_epi16(_mm256_adds_epu16(a, r), sh);
+    b = _mm256_srl_epi16(_mm256_adds_epu16(b, r), sh);
+    _mm256_storeu_si256((__m256i *)(out + i),
+			_mm256_permute4x64_epi64(_mm256_packus_epi16(a, b),
+						 0xd8));
+  }
+  return i;
+}
+
+AVX2_FN static int deep_from_8_avx2(uint8_t *out, const uint8_t *in, int n,
+				    int shift)
+{
+  const __m128i sh = _mm_cvtsi32_si128(shift);
+  int i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in + i)));
+    __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in + i + 16)));
+    _mm256_storeu_si256((__m256i *)(out + 2 * i), _mm256_sll_epi16(a, sh));
+    _mm256_storeu_si256((__m256i *)(out + 2 * i + 32), _mm256_sll_epi16(b, sh));
+  }
+  return i;
+}
+#endif
+
+static void deep_to_8_band(void *arg, int first, int last)
+{
+  depth_t *d = arg;
+  const uint8_t *in = d->src + 2 * first;
+  uint8_t *out = d->dst + first;
+  int round = 1 << (d->shift - 1);
+  int n = last - first;
+  int i = 0;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    i = deep_to_8_avx2(out, in, n, round, d->shift);
+#endif
+#if defined(__SSE2__)
+  const __m128i r = _mm_set1_epi16(round);
+  const __m128i sh = _mm_cvtsi32_si128(d->shift);
+  for ( ; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(in + 2 * i + 16));
+    a = _mm_srl_epi16(_mm_adds_epu16(a, r), sh);
+    b = _mm_srl_epi16(_mm_adds_epu16(b, r), sh);
+    _mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(a, b));
+  }
+#endif
+  for ( ; i < n; i++) {
+    int v = ((in[2*i] | (in[2*i + 1] << 8)) + round) >> d->shift;
+    out[i] = (v > 255) ? 255 : v;
+  }
+}
+
+static void deep_from_8_band(void *arg, int first, int last)
+{
+  depth_t *d = arg;
+  const uint8_t *in = d->src + first;
+  uint8_t *out = d->dst + 2 * first;
+  int n = last - first;
+  int i = 0;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    i = deep_from_8_avx2(out, in, n, d->shift);
+#endif
+#if defined(__SSE2__)
+  const __m128i z = _mm_setzero_si128();
+  const __m128i sh = _mm_cvtsi32_si128(d->shift);
+  for ( ; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+    _mm_storeu_si128((__m128i *)(out + 2 * i),
+		     _mm_sll_epi16(_mm_unpacklo_epi8(a, z), sh));
+    _mm_storeu_si128((__m128i *)(out + 2 * i + 16),
+		     _mm_sll_epi16(_mm_unpackhi_epi8(a, z), sh));
+  }
+#endif
+  for ( ; i < n; i++) {
+    int v = in[i] << d->shift;
+    out[2*i] = v & 0xff;
+    out[2*i + 1] = v >> 8;
+  }
+}
+
+void y4m_convert_deep_to_8(uint8_t *dst, const uint8_t *deep,
+			   int bitdepth, int length)
+{
+  depth_t d;
+
+  d.dst = dst;
+  d.src = deep;
+  d.shift = bitdepth - 8;
+  run_bands(deep_to_8_band, &d, length, 3);
+}
+
+void y4m_convert_8_to_deep(uint8_t *deep, const uint8_t *src,
+			   int bitdepth, int length)
+{
+  depth_t d;
+
+  d.dst = deep;
+  d.src = src;
+  d.shift = bitdepth - 8;
+  run_bands(deep_from_8_band, &d, length, 3);
+}
+
+
+
+/*************************************************************************
+ * Chroma Subsampling
+ *
+ *  Each output row is computed from input rows at or after its own
+ *  position in the plane, so a single band can be done in place.
+ *  Several bands write to a separate buffer instead.
+ *************************************************************************/
+
+
+/* vertical/horizontal interstitial siting
+ *
+ *    Y   Y   Y   Y
+ *      C       C
+ *    Y   Y   Y   Y
+ *
+ *    Y   Y   Y   Y
+ *      C       C
+ *    Y   Y   Y   Y
+ *
+ */
+
+#if defined(HAVE_AVX2_KERNELS)
+/* these return the column they stopped at */
+AVX2_FN static int ss_444_to_420jpeg_avx2(uint8_t *out, const uint8_t *in0,
+					  const uint8_t *in1, int cwidth)
+{
+  const __m256i lo = _mm256_set1_epi16(0x00ff);
+  int x;
+
+  for (x = 0; x + 32 <= cwidth; x += 32) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)(in0 + 2 * x));
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(in0 + 2 * x + 32));
+    __m256i b0 = _mm256_loadu_si256((const __m256i *)(in1 + 2 * x));
+    __m256i b1 = _mm256_loadu_si256((const __m256i *)(in1 + 2 * x + 32));
+    __m256i s0 = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a0, lo),
+						   _mm256_srli_epi16(a0, 8)),
+				  _mm256_add_epi16(_mm256_and_si256(b0, lo),
+						   _mm256_srli_epi16(b0, 8)));
+    __m256i s1 = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a1, lo),
+						   _mm256_srli_epi16(a1, 8)),
+				  _mm256_add_epi16(_mm256_and_si256(b1, lo),
+						   _mm256_srli_epi16(b1, 8)));
+    __m256i p = _mm256_packus_epi16(_mm256_srli_epi16(s0, 2),
+				    _mm256_srli_epi16(s1, 2));
+    _mm256_storeu_si256((__m256i *)(out + x),
+			_mm256_permute4x64_epi64(p, 0xd8));
+  }
+  return x;
+}
+
+/* from column x on, not the first one */
+AVX2_FN static int ss_121_avx2(uint8_t *out, const uint8_t *in0,
+			       const uint8_t *in1, int cwidth, int x)
+{
+  const __m256i lo = _mm256_set1_epi16(0x00ff);
+  const __m256i two = _mm256_set1_epi16(2);
+
+  /* the last load reaches in0[2*x + 32] */
+  for ( ; 2 * x + 33 <= 2 * cwidth; x += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(in0 + 2 * x - 1));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(in0 + 2 * x + 1));
+    __m256i s = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a, lo),
+						  _mm256_and_si256(b, lo)),
+				 _mm256_slli_epi16(_mm256_srli_epi16(a, 8), 1));
+    if (in1 != NULL) {
+      a = _mm256_loadu_si256((const __m256i *)(in1 + 2 * x - 1));
+      b = _mm256_loadu_si256((const __m256i *)(in1 + 2 * x + 1));
+      s = _mm256_add_epi16(s, _mm256_add_epi16(
+			     _mm256_add_epi16(_mm256_and_si256(a, lo),
+					      _mm256_and_si256(b, lo)),
+			     _mm256_slli_epi16(_mm256_srli_epi16(a, 8), 1)));
+      s = _mm256_srli_epi16(s, 3);
+    } else {
+      s = _mm256_srli_epi16(_mm256_add_epi16(s, two), 2);
+    }
+    s = _mm256_permute4x64_epi64(_mm256_packus_epi16(s, s), 0xd8);
+    _mm_storeu_si128((__m128i *)(out + x), _mm256_castsi256_si128(s));
+  }
+  return x;
+}
+#endif
+
+static void ss_444_to_420jpeg_row(uint8_t *out, const uint8_t *in0,
+				  const uint8_t *in1, int cwidth)
+{
+  int x = 0;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    x = ss_444_to_420jpeg_avx2(out, in0, in1, cwidth);
+#endif
+#if defined(__SSE2__)
+  const __m128i lo = _mm_set1_epi16(0x00ff);
+  for ( ; x + 16 <= cwidth; x += 16) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *)(in0 + 2 * x));
+    __m128i a1 = _mm_loadu_si128((const __m128i *)(in0 + 2 * x + 16));
+    __m128i b0 = _mm_loadu_si128((const __m128i *)(in1 + 2 * x));
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(in1 + 2 * x + 16));
+    __m128i s0 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a0, lo),
+					     _mm_srli_epi16(a0, 8)),
+			       _mm_add_epi16(_mm_and_si128(b0, lo),
+					     _mm_srli_epi16(b0, 8)));
+    __m128i s1 = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a1, lo),
+					     _mm_srli_epi16(a1, 8)),
+			       _mm_add_epi16(_mm_and_si128(b1, lo),
+					     _mm_srli_epi16(b1, 8)));
+    _mm_storeu_si128((__m128i *)(out + x),
+		     _mm_packus_epi16(_mm_srli_epi16(s0, 2),
+				      _mm_srli_epi16(s1, 2)));
+  }
+#endif
+  for ( ; x < cwidth; x++)
+    out[x] = (in0[2*x] + in0[2*x + 1] + in1[2*x] + in1[2*x + 1]) >> 2;
+}
+
+
+/* horizontal cositing, [1,2,1] kernel:
+ *
+ *    inX[0] [1] [2]
+ *        |   |   |
+ *    C   C   C   C
+ *         \  |  /
+ *          \ | /
+ *            C
+ *
+ * With two input rows (vertical interstitial siting, 4:2:0 MPEG-2) the
+ *  sum of both is truncated, as it always was; a single row (4:2:2,
+ *  4:2:0 PAL-DV) is rounded.  The first column repeats its sample to
+ *  the left.
+ */
+
+static void ss_121_row(uint8_t *out, const uint8_t *in0,
+		       const uint8_t *in1, int cwidth)
+{
+  int x = 1;
+
+  if (cwidth <= 0)
+    return;
+  if (in1 != NULL)
+    out[0] = (3 * in0[0] + in0[1] + 3 * in1[0] + in1[1]) >> 3;
+  else
+    out[0] = (3 * in0[0] + in0[1] + 2) >> 2;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    x = ss_121_avx2(out, in0, in1, cwidth, x);
+#endif
+#if defined(__SSE2__)
+  {
+    const __m128i lo = _mm_set1_epi16(0x00ff);
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i z = _mm_setzero_si128();
+    /* the last load reaches in0[2*x + 16] */
+    for ( ; 2 * x + 17 <= 2 * cwidth; x += 8) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(in0 + 2 * x - 1));
+      __m128i b = _mm_loadu_si128((const __m128i *)(in0 + 2 * x + 1));
+      __m128i s = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, lo),
+					      _mm_and_si128(b, lo)),
+				_mm_slli_epi16(_mm_srli_epi16(a, 8), 1));
+      if (in1 != NULL) {
+	a = _mm_loadu_si128((const __m128i *)(in1 + 2 * x - 1));
+	b = _mm_loadu_si128((const __m128i *)(in1 + 2 * x + 1));
+	s = _mm_add_epi16(s, _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, lo),
+							 _mm_and_si128(b, lo)),
+					   _mm_slli_epi16(_mm_srli_epi16(a, 8),
+							  1)));
+	s = _mm_srli_epi16(s, 3);
+      } else {
+	s = _mm_srli_epi16(_mm_add_epi16(s, two), 2);
+      }
+      _mm_storel_epi64((__m128i *)(out + x), _mm_packus_epi16(s, z));
+    }
+  }
+#endif
+  for ( ; x < cwidth; x++) {
+    const uint8_t *p = in0 + 2 * x - 1;
+    if (in1 != NULL) {
+      const uint8_t *q = in1 + 2 * x - 1;
+      out[x] = (p[0] + (2 * p[1]) + p[2] +
+		q[0] + (2 * q[1]) + q[2]) >> 3;
+    } else {
+      out[x] = (p[0] + (2 * p[1]) + p[2] + 2) >> 2;
+    }
+  }
+}
+
+
+/* the same two, for deep samples */
+
+static void ss_444_to_420jpeg_row_deep(uint8_t *out, const uint8_t *in0,
+				       const uint8_t *in1, int cwidth)
+{
+  int x = 0;
+
+#if defined(__SSE2__)
+  /* in 32-bit lanes, packed back (signed) around 0x8000 */
+  const __m128i lo = _mm_set1_epi32(0xffff);
+  const __m128i bias = _mm_set1_epi32(0x8000);
+  const __m128i unbias = _mm_set1_epi16((short)0x8000);
+  for ( ; x + 8 <= cwidth; x += 8) {
+    __m128i a0 = _mm_loadu_si128((const __m128i *)(in0 + 4 * x));
+    __m128i a1 = _mm_loadu_si128((const __m128i *)(in0 + 4 * x + 16));
+    __m128i b0 = _mm_loadu_si128((const __m128i *)(in1 + 4 * x));
+    __m128i b1 = _mm_loadu_si128((const __m128i *)(in1 + 4 * x + 16));
+    __m128i s0 = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(a0, lo),
+					     _mm_srli_epi32(a0, 16)),
+			       _mm_add_epi32(_mm_and_si128(b0, lo),
+					     _mm_srli_epi32(b0, 16)));
+    __m128i s1 = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(a1, lo),
+					     _mm_srli_epi32(a1, 16)),
+			       _mm_add_epi32(_mm_and_si128(b1, lo),
+					     _mm_srli_epi32(b1, 16)));
+    s0 = _mm_sub_epi32(_mm_srli_epi32(s0, 2), bias);
+    s1 = _mm_sub_epi32(_mm_srli_epi32(s1, 2), bias);
+    _mm_storeu_si128((__m128i *)(out + 2 * x),
+		     _mm_xor_si128(_mm_packs_epi32(s0, s1), unbias));
+  }
+#endif
+  for ( ; x < cwidth; x++)
+    put16(out + 2 * x, (get16(in0 + 4 * x) + get16(in0 + 4 * x + 2) +
+			get16(in1 + 4 * x) + get16(in1 + 4 * x + 2)) >> 2);
+}
+
+static void ss_121_row_deep(uint8_t *out, const uint8_t *in0,
+			    const uint8_t *in1, int cwidth)
+{
+  int x;
+
+  for (x = 0; x < cwidth; x++) {
+    /* the first column repeats its sample to the left */
+    int l = (x > 0) ? 2 * x - 1 : 0;
+    int s = get16(in0 + 2 * l) + 2 * get16(in0 + 4 * x) + get16(in0 + 4 * x + 2);
+    if (in1 != NULL) {
+      s += get16(in1 + 2 * l) + 2 * get16(in1 + 4 * x) + get16(in1 + 4 * x + 2);
+      put16(out + 2 * x, s >> 3);
+    } else {
+      put16(out + 2 * x, (s + 2) >> 2);
+    }
+  }
+}
+
+
+typedef struct {
+  int mode;
+  int width;              /* of the 4:4:4 planes */
+  int cwidth;             /* of the subsampled planes */
+  int rows;               /* subsampled rows */
+  const uint8_t *in[2];   /* Cb, Cr */
+  uint8_t *out[2];
+  uint8_t *tmp;           /* per band, for supersampling */
+  int deep;               /* two bytes per sample */
+} resample_t;
+
+
+static void subsample_band_deep(resample_t *rs, int first, int last)
+{
+  int w = 2 * rs->width;  /* in bytes */
+  int cw = rs->cwidth;
+  int p, y;
+
+  for (p = 0; p < 2; p++) {
+    for (y = first; y < last; y++) {
+      const uint8_t *in = rs->in[p];
+      uint8_t *out = rs->out[p] + 2 * y * cw;
+      switch (rs->mode) {
+      case Y4M_CHROMA_420JPEG:
+	ss_444_to_420jpeg_row_deep(out, in + 2 * y * w, in + (2 * y + 1) * w, cw);
+	break;
+      case Y4M_CHROMA_420MPEG2:
+	ss_121_row_deep(out, in + 2 * y * w, in + (2 * y + 1) * w, cw);
+	break;
+      case Y4M_CHROMA_420PALDV:
+	ss_121_row_deep(out, in + (2 * y + p) * w, NULL, cw);
+	break;
+      case Y4M_CHROMA_422:
+	ss_121_row_deep(out, in + y * w, NULL, cw);
+	break;
+      }
+    }
+  }
+}
+
+static void subsample_band(void *arg, int first, int last)
+{
+  resample_t *rs = arg;
+  int w = rs->width;
+  int cw = rs->cwidth;
+  int p, y;
+
+  if (rs->deep) {
+    subsample_band_deep(rs, first, last);
+    return;
+  }
+  for (p = 0; p < 2; p++) {
+    for (y = first; y < last; y++) {
+      const uint8_t *in = rs->in[p];
+      uint8_t *out = rs->out[p] + y * cw;
+      switch (rs->mode) {
+      case Y4M_CHROMA_420JPEG:
+	ss_444_to_420jpeg_row(out, in + 2 * y * w, in + (2 * y + 1) * w, cw);
+	break;
+      case Y4M_CHROMA_420MPEG2:
+	ss_121_row(out, in + 2 * y * w, in + (2 * y + 1) * w, cw);
+	break;
+      case Y4M_CHROMA_420PALDV:
+	/* Cb is sited on the even lines, Cr on the odd ones */
+	ss_121_row(out, in + (2 * y + p) * w, NULL, cw);
+	break;
+      case Y4M_CHROMA_422:
+	ss_121_row(out, in + y * w, NULL, cw);
+	break;
+      }
+    }
+  }
+}
+
+
+
+int y4m_chroma_sub_implemented(int mode)
+{
+  switch (mode) {
+  case Y4M_CHROMA_420JPEG:
+  case Y4M_CHROMA_420MPEG2:
+  case Y4M_CHROMA_420PALDV:
+  case Y4M_CHROMA_422:
+  case Y4M_CHROMA_444:
+    return 1; /* yes, supported */
+  case Y4M_CHROMA_411:
+  case Y4M_CHROMA_444ALPHA:
+  case Y4M_CHROMA_MONO:
+  default:
+    return 0; /* no, unsupported */
+  }
+}
+
+
+static void chroma_subsample(int mode, uint8_t *ycbcr[], int width, int height,
+			     int deep)
+{
+  resample_t rs;
+  uint8_t *buf = NULL;
+  int ss = deep ? 2 : 1;
+  int size, p;
+
+  switch (mode) {
+  case Y4M_CHROMA_420JPEG:
+  case Y4M_CHROMA_420MPEG2:
+  case Y4M_CHROMA_420PALDV:
+    rs.rows = height / 2;
+    break;
+  case Y4M_CHROMA_422:
+    rs.rows = height;
+    break;
+  default:
+    return;
+  }
+  rs.mode = mode;
+  rs.width = width;
+  rs.cwidth = width / 2;
+  rs.deep = deep;
+  size = rs.cwidth * rs.rows * ss;
+  for (p = 0; p < 2; p++)
+    rs.in[p] = rs.out[p] = ycbcr[p + 1];
+  if (band_count(rs.rows, 2 * 2 * width * ss) > 1 &&
+      (buf = malloc(2 * size)) != NULL) {
+    rs.out[0] = buf;
+    rs.out[1] = buf + size;
+  }
+  if (buf != NULL) {
+    run_bands(subsample_band, &rs, rs.rows, 2 * 2 * width * ss);
+    memcpy(ycbcr[1], rs.out[0], size);
+    memcpy(ycbcr[2], rs.out[1], size);
+    free(buf);
+  } else {
+    simd_init();
+    subsample_band(&rs, 0, rs.rows);
+  }
+}
+
+void y4m_chroma_subsample(int mode, uint8_t *ycbcr[], int width, int height)
+{
+  chroma_subsample(mode, ycbcr, width, height, 0);
+}
+
+void y4m_chroma_subsample_deep(int mode, uint8_t *ycbcr[],
+			       int width, int height)
+{
+  chroma_subsample(mode, ycbcr, width, height, 1);
+}
+
+
+
+/*************************************************************************
+ * Chroma Supersampling
+ *
+ *  The subsampled planes are first copied aside; bands of output rows
+ *  are then computed from the copy.
+ *************************************************************************/
+
+
+/* vertical/horizontal interstitial siting (4:2:0 JPEG)
+ *
+ *    Y   Y   Y   Y
+ *      C       C       C      inm
+ *    Y   Y   Y   Y
+ *
+ *    Y   Y   Y - Y           out0
+ *      C     | C |     C      in0
+ *    Y   Y   Y - Y           out1
+ *
+ *
+ *      C       C       C      inp
+ *
+ *
+ *  Each 2x2 block of output pixels is reconstituted from the
+ *   "surrounding" 3x3 block of samples by a triangle filter.
+ *  Boundary conditions are handled by cheap reflection; i.e. any
+ *   neighbour missing at an edge is replaced by the center sample.
+ *
+ *  Away from the edges the filter is separable:  with
+ *   U = inm + 3*in0 (and D = inp + 3*in0),
+ *   out0[2x] = (U[x-1] + 3*U[x] + 8) >> 4, out0[2x+1] = (U[x+1] + 3*U[x] + 8) >> 4.
+ */
+
+static void ss_420jpeg_to_444_cols(uint8_t *out0, uint8_t *out1,
+				   const uint8_t *in, int cwidth, int crows,
+				   int y, int x0, int x1)
+{
+  const uint8_t *in0 = in + y * cwidth;
+  const uint8_t *inm = (y == 0) ? in0 : in0 - cwidth;
+  const uint8_t *inp = (y == crows - 1) ? in0 : in0 + cwidth;
+  int top = (y == 0);
+  int bot = (y == crows - 1);
+  int x;
+
+  for (x = x0; x < x1; x++) {
+    int left = (x == 0);
+    int right = (x == cwidth - 1);
+    int c00 = in0[x];
+    int cmm = (left || top) ? c00 : inm[x - 1];
+    int cm0 = top ? c00 : inm[x];
+    int cmp = (right || top) ? c00 : inm[x + 1];
+    int c0m = left ? c00 : in0[x - 1];
+    int c0p = right ? c00 : in0[x + 1];
+    int cpm = (left || bot) ? c00 : inp[x - 1];
+    int cp0 = bot ? c00 : inp[x];
+    int cpp = (right || bot) ? c00 : inp[x + 1];
+
+    out0[2*x]     = (1*cmm + 3*(cm0+c0m) + 9*c00 + 8) >> 4;
+    out0[2*x + 1] = (1*cmp + 3*(cm0+c0p) + 9*c00 + 8) >> 4;
+    out1[2*x]     = (1*cpm + 3*(cp0+c0m) + 9*c00 + 8) >> 4;
+    out1[2*x + 1] = (1*cpp + 3*(cp0+c0p) + 9*c00 + 8) >> 4;
+  }
+}
+
+#if defined(__SSE2__)
+/* one output row from U = n + 3*c, for x in [x, x+8) */
+static inline __m128i triangle_sse2(const uint8_t *n, const uint8_t *c)
+{
+  const __m128i z = _mm_setzero_si128();
+  const __m128i k8 = _mm_set1_epi16(8);
+  __m128i um, u0, up, t, even, odd;
+
+  t = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(c - 1)), z);
+  um = _mm_add_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(n - 1)), z),
+		     _mm_add_epi16(t, _mm_add_epi16(t, t)));
+  t = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)c), z);
+  u0 = _mm_add_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)n), z),
+		     _mm_add_epi16(t, _mm_add_epi16(t, t)));
+  t = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(c + 1)), z);
+  up = _mm_add_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(n + 1)), z),
+		     _mm_add_epi16(t, _mm_add_epi16(t, t)));
+  t = _mm_add_epi16(_mm_add_epi16(u0, _mm_add_epi16(u0, u0)), k8);
+  even = _mm_srli_epi16(_mm_add_epi16(um, t), 4);
+  odd = _mm_srli_epi16(_mm_add_epi16(up, t), 4);
+  return _mm_unpacklo_epi8(_mm_packus_epi16(even, z),
+			   _mm_packus_epi16(odd, z));
+}
+#endif
+
+#if defined(HAVE_AVX2_KERNELS)
+/* the same, for x in [x, x+16); even and odd samples are < 256 */
+AVX2_FN static inline __m256i triangle_avx2(const uint8_t *n, const uint8_t *c)
+{
+  const __m256i k8 = _mm256_set1_epi16(8);
+  __m256i um, u0, up, t, even, odd;
+
+  t = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(c - 1)));
+  um = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(n - 1))),
+			_mm256_add_epi16(t, _mm256_add_epi16(t, t)));
+  t = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)c));
+  u0 = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)n)),
+			_mm256_add_epi16(t, _mm256_add_epi16(t, t)));
+  t = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(c + 1)));
+  up = _mm256_add_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(n + 1))),
+			_mm256_add_epi16(t, _mm256_add_epi16(t, t)));
+  t = _mm256_add_epi16(_mm256_add_epi16(u0, _mm256_add_epi16(u0, u0)), k8);
+  even = _mm256_srli_epi16(_mm256_add_epi16(um, t), 4);
+  odd = _mm256_srli_epi16(_mm256_add_epi16(up, t), 4);
+  return _mm256_or_si256(even, _mm256_slli_epi16(odd, 8));
+}
+
+/* interior: the last load reaches in0[x + 16] */
+AVX2_FN static int ss_420jpeg_to_444_avx2(uint8_t *out0, uint8_t *out1,
+					  const uint8_t *in0, int cwidth, int x)
+{
+  for ( ; x + 17 <= cwidth; x += 16) {
+    _mm256_storeu_si256((__m256i *)(out0 + 2 * x),
+			triangle_avx2(in0 - cwidth + x, in0 + x));
+    _mm256_storeu_si256((__m256i *)(out1 + 2 * x),
+			triangle_avx2(in0 + cwidth + x, in0 + x));
+  }
+  return x;
+}
+#endif
+
+static void ss_420jpeg_to_444_row(uint8_t *out0, uint8_t *out1,
+				  const uint8_t *in, int cwidth, int crows,
+				  int y)
+{
+  int x = 0;
+
+#if defined(__SSE2__)
+  if (y > 0 && y < crows - 1 && cwidth > 1) {
+    const uint8_t *in0 = in + y * cwidth;
+    ss_420jpeg_to_444_cols(out0, out1, in, cwidth, crows, y, 0, 1);
+    x = 1;
+#if defined(HAVE_AVX2_KERNELS)
+    if (_convert_simd >= SIMD_AVX2)
+      x = ss_420jpeg_to_444_avx2(out0, out1, in0, cwidth, x);
+#endif
+    /* interior: the last load reaches in0[x + 8] */
+    for ( ; x + 9 <= cwidth; x += 8) {
+      _mm_storeu_si128((__m128i *)(out0 + 2 * x),
+		       triangle_sse2(in0 - cwidth + x, in0 + x));
+      _mm_storeu_si128((__m128i *)(out1 + 2 * x),
+		       triangle_sse2(in0 + cwidth + x, in0 + x));
+    }
+  }
+#endif
+  ss_420jpeg_to_444_cols(out0, out1, in, cwidth, crows, y, x, cwidth);
+}
+
+
+#if defined(HAVE_AVX2_KERNELS)
+AVX2_FN static int ss_cosited_avx2(uint8_t *out, const uint8_t *in, int cwidth)
+{
+  int x;
+
+  for (x = 0; x + 33 <= cwidth; x += 32) {
+    __m256i c = _mm256_loadu_si256((const __m256i *)(in + x));
+    __m256i a = _mm256_avg_epu8(c, _mm256_loadu_si256((const __m256i *)(in + x + 1)));
+    __m256i l = _mm256_unpacklo_epi8(c, a);
+    __m256i h = _mm256_unpackhi_epi8(c, a);
+    _mm256_storeu_si256((__m256i *)(out + 2 * x),
+			_mm256_permute2x128_si256(l, h, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 2 * x + 32),
+			_mm256_permute2x128_si256(l, h, 0x31));
+  }
+  return x;
+}
+
+AVX2_FN static int ss_vertical_avx2(uint8_t *out, const uint8_t *a,
+				    const uint8_t *b, int cwidth, int mid)
+{
+  const __m256i two = _mm256_set1_epi16(2);
+  int x;
+
+  for (x = 0; x + 32 <= cwidth; x += 32) {
+    if (mid) {
+      _mm256_storeu_si256((__m256i *)(out + x),
+			  _mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(a + x)),
+					  _mm256_loadu_si256((const __m256i *)(b + x))));
+    } else {
+      __m256i l = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + x)));
+      __m256i h = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(a + x + 16)));
+      l = _mm256_add_epi16(_mm256_add_epi16(l, _mm256_add_epi16(l, l)),
+			   _mm256_add_epi16(_mm256_cvtepu8_epi16(
+					      _mm_loadu_si128((const __m128i *)(b + x))), two));
+      h = _mm256_add_epi16(_mm256_add_epi16(h, _mm256_add_epi16(h, h)),
+			   _mm256_add_epi16(_mm256_cvtepu8_epi16(
+					      _mm_loadu_si128((const __m128i *)(b + x + 16))), two));
+      l = _mm256_packus_epi16(_mm256_srli_epi16(l, 2), _mm256_srli_epi16(h, 2));
+      _mm256_storeu_si256((__m256i *)(out + x),
+			  _mm256_permute4x64_epi64(l, 0xd8));
+    }
+  }
+  return x;
+}
+#endif
+
+/* horizontal cositing:  a new sample between each pair of old ones */
+static void ss_cosited_row(uint8_t *out, const uint8_t *in, int cwidth)
+{
+  int x = 0;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    x = ss_cosited_avx2(out, in, cwidth);
+#endif
+#if defined(__SSE2__)
+  for ( ; x + 17 <= cwidth; x += 16) {
+    __m128i c = _mm_loadu_si128((const __m128i *)(in + x));
+    __m128i a = _mm_avg_epu8(c, _mm_loadu_si128((const __m128i *)(in + x + 1)));
+    _mm_storeu_si128((__m128i *)(out + 2 * x), _mm_unpacklo_epi8(c, a));
+    _mm_storeu_si128((__m128i *)(out + 2 * x + 16), _mm_unpackhi_epi8(c, a));
+  }
+#endif
+  for ( ; x < cwidth; x++) {
+    int n = (x + 1 < cwidth) ? in[x + 1] : in[x];
+    out[2*x] = in[x];
+    out[2*x + 1] = (in[x] + n + 1) >> 1;
+  }
+}
+
+/* out = (3 * a + b + 2) / 4, or (a + b + 1) / 2 if 'mid' */
+static void ss_vertical_row(uint8_t *out, const uint8_t *a, const uint8_t *b,
+			    int cwidth, int mid)
+{
+  int x = 0;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    x = ss_vertical_avx2(out, a, b, cwidth, mid);
+#endif
+#if defined(__SSE2__)
+  const __m128i z = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  for ( ; x + 16 <= cwidth; x += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + x));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + x));
+    if (mid) {
+      _mm_storeu_si128((__m128i *)(out + x), _mm_avg_epu8(va, vb));
+    } else {
+      __m128i l = _mm_unpacklo_epi8(va, z);
+      __m128i h = _mm_unpackhi_epi8(va, z);
+      l = _mm_add_epi16(_mm_add_epi16(l, _mm_add_epi16(l, l)),
+			_mm_add_epi16(_mm_unpacklo_epi8(vb, z), two));
+      h = _mm_add_epi16(_mm_add_epi16(h, _mm_add_epi16(h, h)),
+			_mm_add_epi16(_mm_unpackhi_epi8(vb, z), two));
+      _mm_storeu_si128((__m128i *)(out + x),
+		       _mm_packus_epi16(_mm_srli_epi16(l, 2),
+					_mm_srli_epi16(h, 2)));
+    }
+  }
+#endif
+  for ( ; x < cwidth; x++)
+    out[x] = mid ? (a[x] + b[x] + 1) >> 1 : (3 * a[x] + b[x] + 2) >> 2;
+}
+
+
+/* the same three, for deep samples */
+
+static void ss_420jpeg_to_444_row_deep(uint8_t *out0, uint8_t *out1,
+				       const uint8_t *in, int cwidth, int crows,
+				       int y)
+{
+  const uint8_t *in0 = in + 2 * y * cwidth;
+  const uint8_t *inm = (y == 0) ? in0 : in0 - 2 * cwidth;
+  const uint8_t *inp = (y == crows - 1) ? in0 : in0 + 2 * cwidth;
+  int top = (y == 0);
+  int bot = (y == crows - 1);
+  int x;
+
+  for (x = 0; x < cwidth; x++) {
+    int left = (x == 0);
+    int right = (x == cwidth - 1);
+    int c00 = get16(in0 + 2 * x);
+    int cmm = (left || top) ? c00 : get16(inm + 2 * x - 2);
+    int cm0 = top ? c00 : get16(inm + 2 * x);
+    int cmp = (right || top) ? c00 : get16(inm + 2 * x + 2);
+    int c0m = left ? c00 : get16(in0 + 2 * x - 2);
+    int c0p = right ? c00 : get16(in0 + 2 * x + 2);
+    int cpm = (left || bot) ? c00 : get16(inp + 2 * x - 2);
+    int cp0 = bot ? c00 : get16(inp + 2 * x);
+    int cpp = (right || bot) ? c00 : get16(inp + 2 * x + 2);
+
+    put16(out0 + 4 * x,     (1*cmm + 3*(cm0+c0m) + 9*c00 + 8) >> 4);
+    put16(out0 + 4 * x + 2, (1*cmp + 3*(cm0+c0p) + 9*c00 + 8) >> 4);
+    put16(out1 + 4 * x,     (1*cpm + 3*(cp0+c0m) + 9*c00 + 8) >> 4);
+    put16(out1 + 4 * x + 2, (1*cpp + 3*(cp0+c0p) + 9*c00 + 8) >> 4);
+  }
+}
+
+static void ss_cosited_row_deep(uint8_t *out, const uint8_t *in, int cwidth)
+{
+  int x = 0;
+
+#if defined(__SSE2__)
+  for ( ; x + 9 <= cwidth; x += 8) {
+    __m128i c = _mm_loadu_si128((const __m128i *)(in + 2 * x));
+    __m128i a = _mm_avg_epu16(c, _mm_loadu_si128((const __m128i *)(in + 2 * x + 2)));
+    _mm_storeu_si128((__m128i *)(out + 4 * x), _mm_unpacklo_epi16(c, a));
+    _mm_storeu_si128((__m128i *)(out + 4 * x + 16), _mm_unpackhi_epi16(c, a));
+  }
+#endif
+  for ( ; x < cwidth; x++) {
+    int c = get16(in + 2 * x);
+    int n = (x + 1 < cwidth) ? get16(in + 2 * x + 2) : c;
+    put16(out + 4 * x, c);
+    put16(out + 4 * x + 2, (c + n + 1) >> 1);
+  }
+}
+
+static void ss_vertical_row_deep(uint8_t *out, const uint8_t *a,
+				 const uint8_t *b, int cwidth, int mid)
+{
+  int x = 0;
+
+#if defined(__SSE2__)
+  if (mid)
+    for ( ; x + 8 <= cwidth; x += 8)
+      _mm_storeu_si128((__m128i *)(out + 2 * x),
+		       _mm_avg_epu16(_mm_loadu_si128((const __m128i *)(a + 2 * x)),
+				     _mm_loadu_si128((const __m128i *)(b + 2 * x))));
+#endif
+  for ( ; x < cwidth; x++) {
+    int va = get16(a + 2 * x);
+    int vb = get16(b + 2 * x);
+    put16(out + 2 * x, mid ? (va + vb + 1) >> 1 : (3 * va + vb + 2) >> 2);
+  }
+}
+
+
+/* output rows [first, last) of both planes, of deep samples */
+static void supersample_band_deep(resample_t *rs, int first, int last)
+{
+  int w = 2 * rs->width;  /* in bytes */
+  int cw = rs->cwidth;
+  int cwb = 2 * cw;
+  int crows = rs->rows;
+  int p, y;
+
+  for (p = 0; p < 2; p++) {
+    const uint8_t *in = rs->in[p];
+    uint8_t *out = rs->out[p];
+
+    if (rs->mode == Y4M_CHROMA_420JPEG) {
+      for (y = first; y < last; y++)
+	ss_420jpeg_to_444_row_deep(out + 2 * y * w, out + (2 * y + 1) * w,
+				   in, cw, crows, y);
+      continue;
+    }
+    for (y = first; y < last; y++) {
+      const uint8_t *row = rs->tmp;
+      int j = y / 2;
+      int odd = y & 1;
+      switch (rs->mode) {
+      case Y4M_CHROMA_422:
+	row = in + y * cwb;
+	break;
+      case Y4M_CHROMA_420MPEG2:
+	if (odd)
+	  ss_vertical_row_deep(rs->tmp, in + j * cwb,
+			       in + ((j + 1 < crows) ? j + 1 : j) * cwb, cw, 0);
+	else
+	  ss_vertical_row_deep(rs->tmp, in + j * cwb,
+			       in + ((j > 0) ? j - 1 : j) * cwb, cw, 0);
+	break;
+      case Y4M_CHROMA_420PALDV:
+	if (odd == p)
+	  row = in + j * cwb;
+	else if (p == 0)
+	  ss_vertical_row_deep(rs->tmp, in + j * cwb,
+			       in + ((j + 1 < crows) ? j + 1 : j) * cwb, cw, 1);
+	else
+	  ss_vertical_row_deep(rs->tmp, in + ((j > 0) ? j - 1 : j) * cwb,
+			       in + j * cwb, cw, 1);
+	break;
+      }
+      ss_cosited_row_deep(out + y * w, row, cw);
+    }
+  }
+}
+
+/* output rows [first, last) of both planes */
+static void supersample_band(void *arg, int first, int last)
+{
+  resample_t *rs = arg;
+  int w = rs->width;
+  int cw = rs->cwidth;
+  int crows = rs->rows;
+  int p, y;
+
+  if (rs->deep) {
+    supersample_band_deep(rs, first, last);
+    return;
+  }
+  for (p = 0; p < 2; p++) {
+    const uint8_t *in = rs->in[p];
+    uint8_t *out = rs->out[p];
+
+    if (rs->mode == Y4M_CHROMA_420JPEG) {
+      /* in pairs of output rows */
+      for (y = first; y < last; y++)
+	ss_420jpeg_to_444_row(out + 2 * y * w, out + (2 * y + 1) * w,
+			      in, cw, crows, y);
+      continue;
+    }
+    for (y = first; y < last; y++) {
+      const uint8_t *row = rs->tmp;
+      int j = y / 2;
+      int odd = y & 1;
+      switch (rs->mode) {
+      case Y4M_CHROMA_422:
+	row = in + y * cw;
+	break;
+      case Y4M_CHROMA_420MPEG2:
+	/* vertically interstitial, nearest sample weighs 3/4 */
+	if (odd)
+	  ss_vertical_row(rs->tmp, in + j * cw,
+			  in + ((j + 1 < crows) ? j + 1 : j) * cw, cw, 0);
+	else
+	  ss_vertical_row(rs->tmp, in + j * cw,
+			  in + ((j > 0) ? j - 1 : j) * cw, cw, 0);
+	break;
+      case Y4M_CHROMA_420PALDV:
+	/* Cb is sited on the even lines, Cr on the odd ones */
+	if (odd == p)
+	  row = in + j * cw;
+	else if (p == 0)
+	  ss_vertical_row(rs->tmp, in + j * cw,
+			  in + ((j + 1 < crows) ? j + 1 : j) * cw, cw, 1);
+	else
+	  ss_vertical_row(rs->tmp, in + ((j > 0) ? j - 1 : j) * cw,
+			  in + j * cw, cw, 1);
+	break;
+      }
+      ss_cosited_row(out + y * w, row, cw);
+    }
+  }
+}
+
+static void supersample_band_tmp(void *arg, int first, int last)
+{
+  resample_t rs = *(resample_t *)arg;
+
+  if ((rs.tmp = malloc(rs.deep ? 2 * rs.cwidth : rs.cwidth)) == NULL)
+    mjpeg_error_exit1("Could not allocate chroma row buffer");
+  supersample_band(&rs, first, last);
+  free(rs.tmp);
+}
+
+
+
+int y4m_chroma_super_implemented(int mode)
+{
+  switch (mode) {
+  case Y4M_CHROMA_420JPEG:
+  case Y4M_CHROMA_420MPEG2:
+  case Y4M_CHROMA_420PALDV:
+  case Y4M_CHROMA_422:
+  case Y4M_CHROMA_444:
+    return 1; /* yes, supported */
+  case Y4M_CHROMA_411:
+  case Y4M_CHROMA_444ALPHA:
+  case Y4M_CHROMA_MONO:
+  default:
+    return 0; /* no, unsupported */
+  }
+}
+
+
+static void chroma_supersample(int mode, uint8_t *ycbcr[], int width, int height,
+			       int deep)
+{
+  resample_t rs;
+  uint8_t *buf;
+  int ss = deep ? 2 : 1;
+  int size, p;
+
+  switch (mode) {
+  case Y4M_CHROMA_420JPEG:
+  case Y4M_CHROMA_420MPEG2:
+  case Y4M_CHROMA_420PALDV:
+    rs.rows = height / 2;
+    break;
+  case Y4M_CHROMA_422:
+    rs.rows = height;
+    break;
+  default:
+    return;
+  }
+  rs.mode = mode;
+  rs.width = width;
+  rs.cwidth = width / 2;
+  rs.deep = deep;
+  size = rs.cwidth * rs.rows * ss;
+  if (size == 0)
+    return;
+  if ((buf = malloc(2 * size)) == NULL)
+    mjpeg_error_exit1("Could not allocate chroma buffer");
+  for (p = 0; p < 2; p++) {
+    memcpy(buf + p * size, ycbcr[p + 1], size);
+    rs.in[p] = buf + p * size;
+    rs.out[p] = ycbcr[p + 1];
+  }
+  /* 4:2:0 JPEG is done in pairs of output rows; as when subsampling,
+     the last row of an odd height is left alone */
+  if (mode == Y4M_CHROMA_420JPEG)
+    run_bands(supersample_band_tmp, &rs, rs.rows, 2 * 2 * width * ss);
+  else if (mode == Y4M_CHROMA_422)
+    run_bands(supersample_band_tmp, &rs, rs.rows, 2 * width * ss);
+  else
+    run_bands(supersample_band_tmp, &rs, 2 * rs.rows, 2 * width * ss);
+  free(buf);
+}
+
+void y4m_chroma_supersample(int mode, uint8_t *ycbcr[], int width, int height)
+{
+  chroma_supersample(mode, ycbcr, width, height, 0);
+}
+
+void y4m_chroma_supersample_deep(int mode, uint8_t *ycbcr[],
+				 int width, int height)
+{
+  chroma_supersample(mode, ycbcr, width, height, 1);
+}
+
+
+
+/*************************************************************************
+ * Packed <-> planar
+ *************************************************************************/
+
+void y4m_pack_rgb(uint8_t *rgb,
+		  const uint8_t *r, const uint8_t *g, const uint8_t *b,
+		  int length)
+{
+  int x;
+
+  for (x = 0; x < length; x++) {
+    *(rgb++) = r[x];
+    *(rgb++) = g[x];
+    *(rgb++) = b[x];
+  }
+}
+
+void y4m_unpack_rgb(uint8_t *r, uint8_t *g, uint8_t *b,
+		    const uint8_t *rgb, int length)
+{
+  int x;
+
+  for (x = 0; x < length; x++) {
+    r[x] = *(rgb++);
+    g[x] = *(rgb++);
+    b[x] = *(rgb++);
+  }
+}
+
+
+typedef struct {
+  uint8_t *packed;
+  uint8_t *planes[3];
+  int width;
+  int uyvy;
+} pack422_t;
+
+#if defined(HAVE_AVX2_KERNELS)
+/* these return how many pixel pairs they did */
+AVX2_FN static int pack_422_avx2(uint8_t *p, const uint8_t *Y,
+				 const uint8_t *Cb, const uint8_t *Cr,
+				 int n, int uyvy)
+{
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m256i y = _mm256_loadu_si256((const __m256i *)(Y + 2 * i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(Cb + i));
+    __m128i r = _mm_loadu_si128((const __m128i *)(Cr + i));
+    __m256i c = _mm256_inserti128_si256(
+		  _mm256_castsi128_si256(_mm_unpacklo_epi8(b, r)),
+		  _mm_unpackhi_epi8(b, r), 1);
+    __m256i l, h;
+    if (uyvy) {
+      l = _mm256_unpacklo_epi8(c, y);
+      h = _mm256_unpackhi_epi8(c, y);
+    } else {
+      l = _mm256_unpacklo_epi8(y, c);
+      h = _mm256_unpackhi_epi8(y, c);
+    }
+    _mm256_storeu_si256((__m256i *)(p + 4 * i),
+			_mm256_permute2x128_si256(l, h, 0x20));
+    _mm256_storeu_si256((__m256i *)(p + 4 * i + 32),
+			_mm256_permute2x128_si256(l, h, 0x31));
+  }
+  return i;
+}
+
+AVX2_FN static int unpack_422_avx2(uint8_t *Y, uint8_t *Cb, uint8_t *Cr,
+				   const uint8_t *p, int n, int uyvy)
+{
+  const __m256i lo = _mm256_set1_epi16(0x00ff);
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)(p + 4 * i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(p + 4 * i + 32));
+    __m256i al = _mm256_and_si256(a, lo), ah = _mm256_srli_epi16(a, 8);
+    __m256i bl = _mm256_and_si256(b, lo), bh = _mm256_srli_epi16(b, 8);
+    __m256i y, c, t;
+    if (uyvy) {
+      y = _mm256_packus_epi16(ah, bh);
+      c = _mm256_packus_epi16(al, bl);
+    } else {
+      y = _mm256_packus_epi16(al, bl);
+      c = _mm256_packus_epi16(ah, bh);
+    }
+    _mm256_storeu_si256((__m256i *)(Y + 2 * i),
+			_mm256_permute4x64_epi64(y, 0xd8));
+    c = _mm256_permute4x64_epi64(c, 0xd8);
+    t = _mm256_and_si256(c, lo);
+    t = _mm256_permute4x64_epi64(_mm256_packus_epi16(t, t), 0xd8);
+    _mm_storeu_si128((__m128i *)(Cb + i), _mm256_castsi256_si128(t));
+    t = _mm256_srli_epi16(c, 8);
+    t = _mm256_permute4x64_epi64(_mm256_packus_epi16(t, t), 0xd8);
+    _mm_storeu_si128((__m128i *)(Cr + i), _mm256_castsi256_si128(t));
+  }
+  return i;
+}
+#endif
+
+/* rows [first, last); Y and chroma samples 'first * width' in */
+static void pack_422_band(void *arg, int first, int last)
+{
+  pack422_t *pk = arg;
+  int n = (last - first) * pk->width / 2;     /* pixel pairs */
+  uint8_t *p = pk->packed + 2 * first * pk->width;
+  const uint8_t *Y = pk->planes[0] + first * pk->width;
+  const uint8_t *Cb = pk->planes[1] + first * pk->width / 2;
+  const uint8_t *Cr = pk->planes[2] + first * pk->width / 2;
+  int i = 0;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    i = pack_422_avx2(p, Y, Cb, Cr, n, pk->uyvy);
+#endif
+#if defined(__SSE2__)
+  for ( ; i + 8 <= n; i += 8) {
+    __m128i y = _mm_loadu_si128((const __m128i *)(Y + 2 * i));
+    __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(Cb + i)),
+				  _mm_loadl_epi64((const __m128i *)(Cr + i)));
+    if (pk->uyvy) {
+      _mm_storeu_si128((__m128i *)(p + 4 * i), _mm_unpacklo_epi8(c, y));
+      _mm_storeu_si128((__m128i *)(p + 4 * i + 16), _mm_unpackhi_epi8(c, y));
+    } else {
+      _mm_storeu_si128((__m128i *)(p + 4 * i), _mm_unpacklo_epi8(y, c));
+      _mm_storeu_si128((__m128i *)(p + 4 * i + 16), _mm_unpackhi_epi8(y, c));
+    }
+  }
+#endif
+  p += 4 * i;
+  for ( ; i < n; i++) {
+    if (pk->uyvy) {
+      *p++ = Cb[i];
+      *p++ = Y[2*i];
+      *p++ = Cr[i];
+      *p++ = Y[2*i + 1];
+    } else {
+      *p++ = Y[2*i];
+      *p++ = Cb[i];
+      *p++ = Y[2*i + 1];
+      *p++ = Cr[i];
+    }
+  }
+}
+
+static void unpack_422_band(void *arg, int first, int last)
+{
+  pack422_t *pk = arg;
+  int n = (last - first) * pk->width / 2;     /* pixel pairs */
+  const uint8_t *p = pk->packed + 2 * first * pk->width;
+  uint8_t *Y = pk->planes[0] + first * pk->width;
+  uint8_t *Cb = pk->planes[1] + first * pk->width / 2;
+  uint8_t *Cr = pk->planes[2] + first * pk->width / 2;
+  int i = 0;
+
+#if defined(HAVE_AVX2_KERNELS)
+  if (_convert_simd >= SIMD_AVX2)
+    i = unpack_422_avx2(Y, Cb, Cr, p, n, pk->uyvy);
+#endif
+#if defined(__SSE2__)
+  const __m128i lo = _mm_set1_epi16(0x00ff);
+  const __m128i z = _mm_setzero_si128();
+  for ( ; i + 8 <= n; i += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(p + 4 * i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(p + 4 * i + 16));
+    __m128i y, c;
+    if (pk->uyvy) {
+      y = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+      c = _mm_packus_epi16(_mm_and_si128(a, lo), _mm_and_si128(b, lo));
+    } else {
+      y = _mm_packus_epi16(_mm_and_si128(a, lo), _mm_and_si128(b, lo));
+      c = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    }
+    _mm_storeu_si128((__m128i *)(Y + 2 * i), y);
+    _mm_storel_epi64((__m128i *)(Cb + i),
+		     _mm_packus_epi16(_mm_and_si128(c, lo), z));
+    _mm_storel_epi64((__m128i *)(Cr + i),
+		     _mm_packus_epi16(_mm_srli_epi16(c, 8), z));
+  }
+#endif
+  p += 4 * i;
+  for ( ; i < n; i++) {
+    if (pk->uyvy) {
+      Cb[i] = *p++;
+      Y[2*i] = *p++;
+      Cr[i] = *p++;
+      Y[2*i + 1] = *p++;
+    } else {
+      Y[2*i] = *p++;
+      Cb[i] = *p++;
+      Y[2*i + 1] = *p++;
+      Cr[i] = *p++;
+    }
+  }
+}
+
+void y4m_pack_422(uint8_t *packed, uint8_t *const planes[],
+		  int width, int height, int uyvy)
+{
+  pack422_t pk;
+
+  pk.packed = packed;
+  pk.planes[0] = planes[0];
+  pk.planes[1] = planes[1];
+  pk.planes[2] = planes[2];
+  pk.width = width;
+  pk.uyvy = uyvy;
+  run_bands(pack_422_band, &pk, height, 4 * width);
+}
+
+void y4m_unpack_422(uint8_t *planes[], const uint8_t *packed,
+		    int width, int height, int uyvy)
+{
+  pack422_t pk;
+
+  pk.packed = (uint8_t *)packed;
+  pk.planes[0] = planes[0];
+  pk.planes[1] = planes[1];
+  pk.planes[2] = planes[2];
+  pk.width = width;
+  pk.uyvy = uyvy;
+  run_bands(unpack_422_band, &pk, height, 4 * width);
+}
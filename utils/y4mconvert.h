@@ -0,0 +1,128 @@
+/*
+ * y4mconvert.h:  Pixel format conversions for YUV4MPEG2 frames:
+ *                colorspace, sample depth, chroma resampling and
+ *                packed <-> planar.
+ *
+ *
+ *  Copyright (C) 2001 Matthew J. Marjanovic <maddog@mir.com>
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __Y4MCONVERT_H__
+#define __Y4MCONVERT_H__
+
+#include <mjpeg_types.h>
+#include "yuv4mpeg.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Number of threads a conversion may split a frame's rows across.
+ *  Defaults to $MJPEG_CONVERT_THREADS, or to the number of processors.
+ *  If n > 0, sets it to n.  Returns the previous setting.
+ *  Small frames are always converted by the calling thread alone.
+ */
+int y4m_convert_threads(int n);
+
+
+/*
+ * in-place colorspace conversions, on 'length' samples of each plane
+ *
+ *  [R', G', B'] <--> [Y', Cb, Cr]   (planes[0..2])
+ *  Y' [0,255] <--> Y' [16,235]
+ */
+void y4m_convert_RGB_to_YCbCr(uint8_t *planes[], int length);
+void y4m_convert_YCbCr_to_RGB(uint8_t *planes[], int length);
+
+void y4m_convert_Y255_to_Y219(uint8_t *plane, int length);
+void y4m_convert_Y219_to_Y255(uint8_t *plane, int length);
+
+/*
+ * the same, on samples of 'bitdepth' (9..16) bits, stored as two bytes
+ *  each, least significant byte first (as in the YUV4MPEG2 stream), and
+ *  scaled by 2^(bitdepth - 8):  Y' [16,235] is [16 << s, 235 << s], etc.
+ */
+void y4m_convert_RGB_to_YCbCr_deep(uint8_t *planes[], int bitdepth,
+				   int length);
+void y4m_convert_YCbCr_to_RGB_deep(uint8_t *planes[], int bitdepth,
+				   int length);
+
+void y4m_convert_Y255_to_Y219_deep(uint8_t *plane, int bitdepth, int length);
+void y4m_convert_Y219_to_Y255_deep(uint8_t *plane, int bitdepth, int length);
+
+
+/*
+ * sample depth conversions, on 'length' samples
+ *
+ *  'deep' holds samples of 'bitdepth' (9..16) bits, stored as two bytes
+ *  each, least significant byte first (as in the YUV4MPEG2 stream).
+ *  Reducing rounds to nearest; expanding scales by 2^(bitdepth - 8).
+ */
+void y4m_convert_deep_to_8(uint8_t *dst, const uint8_t *deep,
+			   int bitdepth, int length);
+void y4m_convert_8_to_deep(uint8_t *deep, const uint8_t *src,
+			   int bitdepth, int length);
+
+
+/*
+ * in-place chroma resampling of ycbcr[1] and ycbcr[2], between 4:4:4
+ *  and the given mode.  Both planes must be large enough for 4:4:4
+ *  (width x height).
+ *
+ *  *_implemented() return non-zero if the mode is supported.
+ */
+int y4m_chroma_sub_implemented(int mode);
+void y4m_chroma_subsample(int mode, uint8_t *ycbcr[], int width, int height);
+
+int y4m_chroma_super_implemented(int mode);
+void y4m_chroma_supersample(int mode, uint8_t *ycbcr[], int width, int height);
+
+/* the same, on samples of two bytes each (of any bit depth) */
+void y4m_chroma_subsample_deep(int mode, uint8_t *ycbcr[],
+			       int width, int height);
+void y4m_chroma_supersample_deep(int mode, uint8_t *ycbcr[],
+				 int width, int height);
+
+
+/*
+ * packed <-> planar
+ *
+ *  *_rgb:  'length' pixels of R'G'B' triplets (pass r and b swapped
+ *          for B'G'R')
+ *  *_422:  width x height 4:2:2 frame, packed as YUYV (YUY2), or as
+ *          UYVY if 'uyvy' is non-zero
+ */
+void y4m_pack_rgb(uint8_t *rgb,
+		  const uint8_t *r, const uint8_t *g, const uint8_t *b,
+		  int length);
+void y4m_unpack_rgb(uint8_t *r, uint8_t *g, uint8_t *b,
+		    const uint8_t *rgb, int length);
+
+void y4m_pack_422(uint8_t *packed, uint8_t *const planes[],
+		  int width, int height, int uyvy);
+void y4m_unpack_422(uint8_t *planes[], const uint8_t *packed,
+		    int width, int height, int uyvy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __Y4MCONVERT_H__ */
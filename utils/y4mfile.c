@@ -0,0 +1,436 @@
+/*
+ * y4mfile.c:  Random access to the frames of a YUV4MPEG2 file
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "y4mfile.h"
+#include "yuv4mpeg_intern.h"
+#include "mjpeg_logging.h"
+
+
+#define Y4M_INDEX_SUFFIX  ".idx"
+#define Y4M_INDEX_MAGIC   "Y4MIDX1\n"
+#define Y4M_INDEX_HEAD    32        /* magic, file size, mtime, count */
+
+struct _y4m_file {
+  char *filename;
+  int fd;
+  off_t size;
+  time_t mtime;
+  y4m_stream_info_t si;
+  const uint8_t *map;           /* whole file, or NULL: use pread(2) */
+  size_t framelength;
+  uint8_t *buf;                 /* a frame and its header, without map */
+  off_t *offsets;               /* of each frame header */
+  int count;
+  int alloced;
+};
+
+
+/* callback reader over a block of memory */
+typedef struct {
+  const uint8_t *p;
+  size_t left;
+} y4m_memsrc_t;
+
+static ssize_t y4m_mem_read(void *data, void *buf, size_t len)
+{
+  y4m_memsrc_t *m = (y4m_memsrc_t *)data;
+  size_t n = (len < m->left) ? len : m->left;
+
+  memcpy(buf, m->p, n);
+  m->p += n;
+  m->left -= n;
+  return len - n;               /* as y4m_read():  > 0 at eof */
+}
+
+
+/* The len bytes of the file at off; NULL if they are not all there */
+static const uint8_t *y4m_file_bytes(y4m_file_t *f, off_t off, size_t len)
+{
+  size_t got = 0;
+  ssize_t n;
+
+  if (off < 0 || off + (off_t)len > f->size)
+    return NULL;
+  if (f->map != NULL)
+    return f->map + off;
+  while (got < len) {
+    n = pread(f->fd, f->buf + got, len - got, off + got);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return NULL;
+    got += n;
+  }
+  return f->buf;
+}
+
+/* Length of the header line at off, including the '\n', or 0 */
+static size_t y4m_file_line(y4m_file_t *f, off_t off, const uint8_t **line)
+{
+  size_t len = Y4M_LINE_MAX;
+  const uint8_t *nl;
+
+  if (off + (off_t)len > f->size)
+    len = f->size - off;
+  if ((*line = y4m_file_bytes(f, off, len)) == NULL)
+    return 0;
+  if ((nl = memchr(*line, '\n', len)) == NULL)
+    return 0;
+  return nl - *line + 1;
+}
+
+static int y4m_is_frame_line(const uint8_t *line)
+{
+  return !strncmp((const char *)line, Y4M_FRAME_MAGIC,
+                  sizeof(Y4M_FRAME_MAGIC) - 1);
+}
+
+/* Does a frame header start at off? */
+static int y4m_file_is_frame(y4m_file_t *f, off_t off)
+{
+  const uint8_t *line;
+
+  return y4m_file_line(f, off, &line) > 0 && y4m_is_frame_line(line);
+}
+
+static int y4m_file_add_offset(y4m_file_t *f, off_t off)
+{
+  if (f->count == f->alloced) {
+    int n = (f->alloced > 0) ? 2 * f->alloced : 1024;
+    off_t *o = realloc(f->offsets, n * sizeof(off_t));
+    if (o == NULL)
+      return Y4M_ERR_SYSTEM;
+    f->offsets = o;
+    f->alloced = n;
+  }
+  f->offsets[f->count++] = off;
+  return Y4M_OK;
+}
+
+/* Index the file by hopping from frame header to frame header */
+static int y4m_file_scan(y4m_file_t *f, off_t off,
+                         const uint8_t *stream_line, size_t stream_len)
+{
+  const uint8_t *line;
+  size_t len;
+  int err;
+
+  while (off < f->size) {
+    if ((len = y4m_file_line(f, off, &line)) == 0)
+      break;
+    /* a repeated stream header, as from concatenated files */
+    if (len == stream_len && !memcmp(line, stream_line, len)) {
+      off += len;
+      continue;
+    }
+    if (!y4m_is_frame_line(line))
+      break;
+    if (off + (off_t)len + (off_t)f->framelength > f->size)
+      break;
+    if ((err = y4m_file_add_offset(f, off)) != Y4M_OK)
+      return err;
+    off += len + f->framelength;
+  }
+  if (off < f->size)
+    mjpeg_warn("%s: no frame at byte %lld, indexed %d frames before it",
+               f->filename, (long long)off, f->count);
+  return Y4M_OK;
+}
+
+
+static void y4m_put64(uint8_t *p, uint64_t v)
+{
+  int i;
+  for (i = 0; i < 8; i++, v >>= 8)
+    p[i] = v & 0xff;
+}
+
+static uint64_t y4m_get64(const uint8_t *p)
+{
+  uint64_t v = 0;
+  int i;
+  for (i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static char *y4m_index_name(const char *filename)
+{
+  char *name = malloc(strlen(filename) + sizeof(Y4M_INDEX_SUFFIX));
+
+  if (name != NULL)
+    sprintf(name, "%s%s", filename, Y4M_INDEX_SUFFIX);
+  return name;
+}
+
+/* Load the sidecar index, if there is one that matches the file */
+static int y4m_file_load_index(y4m_file_t *f)
+{
+  char *name = y4m_index_name(f->filename);
+  uint8_t head[Y4M_INDEX_HEAD];
+  uint8_t *data = NULL;
+  struct stat st;
+  uint64_t count;
+  off_t prev = -1;
+  int fd, i, ok = 0;
+
+  if (name == NULL)
+    return 0;
+  fd = open(name, O_RDONLY);
+  free(name);
+  if (fd < 0)
+    return 0;
+  if (fstat(fd, &st) != 0 || read(fd, head, sizeof(head)) != sizeof(head) ||
+      memcmp(head, Y4M_INDEX_MAGIC, 8) ||
+      y4m_get64(head + 8) != (uint64_t)f->size ||
+      y4m_get64(head + 16) != (uint64_t)f->mtime)
+    goto done;
+  count = y4m_get64(head + 24);
+  if (count > (uint64_t)f->size / (f->framelength + 1) ||
+      (off_t)(Y4M_INDEX_HEAD + 8 * count) != st.st_size ||
+      (data = malloc(8 * count + 1)) == NULL ||
+      read(fd, data, 8 * count) != (ssize_t)(8 * count) ||
+      (f->offsets = malloc((count + 1) * sizeof(off_t))) == NULL)
+    goto done;
+  f->alloced = count + 1;
+  for (i = 0; i < (int)count; i++) {
+    off_t off = (off_t)y4m_get64(data + 8 * i);
+    if (off <= prev || off + (off_t)f->framelength > f->size)
+      goto done;
+    f->offsets[i] = prev = off;
+  }
+  f->count = count;
+  ok = count == 0 ||
+    (y4m_file_is_frame(f, f->offsets[0]) &&
+     y4m_file_is_frame(f, f->offsets[count - 1]));
+ done:
+  if (!ok) {
+    free(f->offsets);
+    f->offsets = NULL;
+    f->alloced = f->count = 0;
+  }
+  free(data);
+  close(fd);
+  return ok;
+}
+
+int y4m_file_save_index(const y4m_file_t *f)
+{
+  char *name = y4m_index_name(f->filename);
+  char *tmp;
+  uint8_t *data;
+  size_t len = Y4M_INDEX_HEAD + 8 * (size_t)f->count;
+  int fd, i, err = Y4M_ERR_SYSTEM;
+
+  if (name == NULL)
+    return Y4M_ERR_SYSTEM;
+  if ((data = malloc(len)) == NULL ||
+      (tmp = malloc(strlen(name) + 2)) == NULL) {
+    free(data);
+    free(name);
+    return Y4M_ERR_SYSTEM;
+  }
+  memcpy(data, Y4M_INDEX_MAGIC, 8);
+  y4m_put64(data + 8, f->size);
+  y4m_put64(data + 16, f->mtime);
+  y4m_put64(data + 24, f->count);
+  for (i = 0; i < f->count; i++)
+    y4m_put64(data + Y4M_INDEX_HEAD + 8 * i, f->offsets[i]);
+  /* written aside and renamed, so that no reader sees half an index */
+  sprintf(tmp, "%s~", name);
+  if ((fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0666)) >= 0) {
+    if (y4m_write(fd, data, len) == 0 && close(fd) == 0 &&
+        rename(tmp, name) == 0)
+      err = Y4M_OK;
+    else
+      unlink(tmp);
+  }
+  free(tmp);
+  free(data);
+  free(name);
+  return err;
+}
+
+
+y4m_file_t *y4m_file_open(const char *filename, y4m_stream_info_t *si,
+                          int *err)
+{
+  y4m_file_t *f;
+  struct stat st;
+  y4m_cb_reader_t cb;
+  y4m_memsrc_t src;
+  const uint8_t *line;
+  size_t len;
+  void *m;
+  int e = Y4M_ERR_SYSTEM;
+
+  if ((f = calloc(1, sizeof(*f))) == NULL)
+    goto fail;
+  f->fd = -1;
+  y4m_init_stream_info(&f->si);
+  if ((f->filename = strdup(filename)) == NULL ||
+      (f->fd = open(filename, O_RDONLY)) < 0 ||
+      fstat(f->fd, &st) != 0)
+    goto fail;
+  f->size = st.st_size;
+  f->mtime = st.st_mtime;
+  if ((off_t)(size_t)f->size == f->size && f->size > 0) {
+    m = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+    if (m != MAP_FAILED)
+      f->map = m;
+  }
+  /* without a mapping, header lines are read into buf */
+  if (f->map == NULL && (f->buf = malloc(Y4M_LINE_MAX)) == NULL)
+    goto fail;
+
+  /* the stream header */
+  e = Y4M_ERR_HEADER;
+  if ((len = y4m_file_line(f, 0, &line)) == 0)
+    goto fail;
+  src.p = line;
+  src.left = len;
+  cb.read = y4m_mem_read;
+  cb.data = &src;
+  if ((e = y4m_read_stream_header_cb(&cb, si)) != Y4M_OK)
+    goto fail;
+  y4m_copy_stream_info(&f->si, si);
+  f->framelength = y4m_si_get_framelength(si);
+  if (f->map == NULL) {
+    uint8_t *b = realloc(f->buf, f->framelength + Y4M_LINE_MAX);
+    e = Y4M_ERR_SYSTEM;
+    if (b == NULL)
+      goto fail;
+    f->buf = b;
+    /* (a copy: buf is about to be reused) */
+    line = memcpy(f->buf + Y4M_LINE_MAX, f->buf, len);
+  }
+
+  /* the frame index */
+  if (!y4m_file_load_index(f) &&
+      (e = y4m_file_scan(f, len, line, len)) != Y4M_OK)
+    goto fail;
+  return f;
+
+ fail:
+  if (err != NULL)
+    *err = e;
+  if (f != NULL)
+    y4m_file_close(f);
+  return NULL;
+}
+
+void y4m_file_close(y4m_file_t *f)
+{
+  if (f->map != NULL)
+    munmap((void *)f->map, f->size);
+  if (f->fd >= 0)
+    close(f->fd);
+  free(f->buf);
+  free(f->offsets);
+  free(f->filename);
+  y4m_fini_stream_info(&f->si);
+  free(f);
+}
+
+int y4m_file_frame_count(const y4m_file_t *f)
+{
+  return f->count;
+}
+
+
+/* Parse the header of frame n into fi; *data is its frame data */
+static int y4m_file_frame(y4m_file_t *f, int n, y4m_frame_info_t *fi,
+                          const uint8_t **data)
+{
+  y4m_cb_reader_t cb;
+  y4m_memsrc_t src;
+  const uint8_t *line;
+  size_t len;
+  int err;
+
+  if (n < 0 || n >= f->count)
+    return Y4M_ERR_RANGE;
+  if ((len = y4m_file_line(f, f->offsets[n], &line)) == 0)
+    return Y4M_ERR_SYSTEM;
+  /* (the file may have been rewritten since it was indexed) */
+  if (!y4m_is_frame_line(line))
+    return Y4M_ERR_MAGIC;
+  src.p = line;
+  src.left = len;
+  cb.read = y4m_mem_read;
+  cb.data = &src;
+  if ((err = y4m_read_frame_header_cb(&cb, &f->si, fi)) != Y4M_OK)
+    return err;
+  if ((*data = y4m_file_bytes(f, f->offsets[n] + len, f->framelength))
+      == NULL)
+    return Y4M_ERR_SYSTEM;
+  /* frames are mostly read in order: have the next one paged in */
+  if (f->map != NULL && n + 1 < f->count) {
+    long page = sysconf(_SC_PAGESIZE);
+    off_t start = f->offsets[n + 1] & ~(off_t)(page - 1);
+    posix_madvise((void *)(f->map + start),
+                  f->offsets[n + 1] - start + Y4M_LINE_MAX + f->framelength,
+                  POSIX_MADV_WILLNEED);
+  }
+  return Y4M_OK;
+}
+
+int y4m_file_read_frame(y4m_file_t *f, int n, y4m_frame_info_t *fi,
+                        uint8_t * const *planes)
+{
+  const uint8_t *data;
+  int err, p, len;
+
+  if ((err = y4m_file_frame(f, n, fi, &data)) != Y4M_OK)
+    return err;
+  for (p = 0; p < y4m_si_get_plane_count(&f->si); p++) {
+    len = y4m_si_get_plane_length(&f->si, p);
+    memcpy(planes[p], data, len);
+    data += len;
+  }
+  return Y4M_OK;
+}
+
+int y4m_file_borrow_frame(y4m_file_t *f, int n, y4m_frame_info_t *fi,
+                          uint8_t **planes)
+{
+  const uint8_t *data;
+  int err, p;
+
+  if ((err = y4m_file_frame(f, n, fi, &data)) != Y4M_OK)
+    return err;
+  for (p = 0; p < y4m_si_get_plane_count(&f->si); p++) {
+    planes[p] = (uint8_t *)data;
+    data += y4m_si_get_plane_length(&f->si, p);
+  }
+  return Y4M_OK;
+}
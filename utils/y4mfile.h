@@ -0,0 +1,75 @@
+/*
+ * y4mfile.h:  Random access to the frames of a YUV4MPEG2 file
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __Y4MFILE_H__
+#define __Y4MFILE_H__
+
+#include <mjpeg_types.h>
+#include "yuv4mpeg.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A YUV4MPEG2 stream in a regular file, memory mapped, with an index
+ *  of the file offsets of its frames.  Any frame can be read without
+ *  reading those before it.
+ *
+ *  The index is loaded from the sidecar file "<filename>.idx" if there
+ *  is one that is up to date with the file (same size and modification
+ *  time), and is otherwise built by skipping from frame header to
+ *  frame header through the file, which touches one page per frame.
+ *  A file too large to map is read with pread(2) instead.
+ */
+typedef struct _y4m_file y4m_file_t;
+
+/* Open filename and read its stream header into si (which must have
+    been initialized).  Returns NULL on error, with *err set to a
+    Y4M_ERR_* code if err is not NULL. */
+y4m_file_t *y4m_file_open(const char *filename, y4m_stream_info_t *si,
+                          int *err);
+
+void y4m_file_close(y4m_file_t *f);
+
+/* number of (complete) frames in the file */
+int y4m_file_frame_count(const y4m_file_t *f);
+
+/* Read frame n (counting from 0) into planes, like y4m_read_frame().
+    Returns Y4M_ERR_RANGE if there is no frame n. */
+int y4m_file_read_frame(y4m_file_t *f, int n, y4m_frame_info_t *fi,
+                        uint8_t * const *planes);
+
+/* Point planes[] at the data of frame n, without copying it.  The data
+    is read-only, and stays valid until the next call for this file,
+    or until the file is closed if it is mapped. */
+int y4m_file_borrow_frame(y4m_file_t *f, int n, y4m_frame_info_t *fi,
+                          uint8_t **planes);
+
+/* Write the index to the sidecar file, for the next y4m_file_open()
+    of the file.  Returns Y4M_OK or Y4M_ERR_SYSTEM. */
+int y4m_file_save_index(const y4m_file_t *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __Y4MFILE_H__ */
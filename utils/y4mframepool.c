@@ -0,0 +1,283 @@
+/*
+ * y4mframepool.c:  Run a per-frame YUV4MPEG2 filter on several threads
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#include "y4mframepool.h"
+#include "mjpeg_logging.h"
+
+
+#define MAX_THREADS 64
+#define SLOTS_PER_THREAD 2      /* a frame being filtered, one waiting */
+
+static int _pool_threads = -1;
+
+int y4m_frame_pool_threads(int n)
+{
+  int old = _pool_threads;
+  if (old < 0) {
+    const char *env = getenv("MJPEG_FRAME_THREADS");
+    if (env != NULL)
+      old = atoi(env);
+    else
+      old = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (old < 1) old = 1;
+    if (old > MAX_THREADS) old = MAX_THREADS;
+  }
+  if (n > MAX_THREADS) n = MAX_THREADS;
+  _pool_threads = (n > 0) ? n : old;
+  return old;
+}
+
+
+/* a frame on its way through the pool */
+typedef struct {
+  int done;
+  int err;
+  y4m_frame_info_t fi;
+  uint8_t *in[Y4M_MAX_NUM_PLANES];
+  uint8_t *out[Y4M_MAX_NUM_PLANES];
+} slot_t;
+
+static void free_slots(slot_t *slots, int count, int inplace)
+{
+  int i, p;
+
+  for (i = 0; i < count; i++) {
+    for (p = 0; p < Y4M_MAX_NUM_PLANES; p++) {
+      free(slots[i].in[p]);
+      if (!inplace)
+        free(slots[i].out[p]);
+    }
+    y4m_fini_frame_info(&slots[i].fi);
+  }
+  free(slots);
+}
+
+static slot_t *alloc_slots(int count, const y4m_stream_info_t *istream,
+                           const y4m_stream_info_t *ostream)
+{
+  slot_t *slots = calloc(count, sizeof(slot_t));
+  int i, p, fail = 0;
+
+  if (slots == NULL)
+    return NULL;
+  for (i = 0; i < count; i++) {
+    y4m_init_frame_info(&slots[i].fi);
+    for (p = 0; p < y4m_si_get_plane_count(istream); p++)
+      fail |= (slots[i].in[p] =
+               malloc(y4m_si_get_plane_length(istream, p))) == NULL;
+    if (ostream == NULL)
+      for (p = 0; p < Y4M_MAX_NUM_PLANES; p++)
+        slots[i].out[p] = slots[i].in[p];
+    else
+      for (p = 0; p < y4m_si_get_plane_count(ostream); p++)
+        fail |= (slots[i].out[p] =
+                 malloc(y4m_si_get_plane_length(ostream, p))) == NULL;
+  }
+  if (fail) {
+    free_slots(slots, count, ostream == NULL);
+    return NULL;
+  }
+  return slots;
+}
+
+
+/* the whole job done by the calling thread */
+static int run_serial(int fdin, const y4m_stream_info_t *istream,
+                      int fdout, const y4m_stream_info_t *ostream,
+                      y4m_frame_pool_fn fn, void *arg, slot_t *s)
+{
+  int frame, err;
+
+  for (frame = 0; ; frame++) {
+    if ((err = y4m_read_frame(fdin, istream, &s->fi, s->in)) != Y4M_OK)
+      return (err == Y4M_ERR_EOF) ? Y4M_OK : err;
+    if ((err = (*fn)(arg, 0, frame, &s->fi, s->in, s->out)) != Y4M_OK ||
+        (err = y4m_write_frame(fdout, ostream, &s->fi, s->out)) != Y4M_OK)
+      return err;
+  }
+}
+
+
+#ifdef HAVE_PTHREAD
+
+/*
+ * Frames are read and written by the calling thread, in order, through
+ *  a ring of slots:  [tail, next) are being filtered (or are done),
+ *  [next, head) wait for a worker.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t queued;        /* a frame to filter, or quit */
+  pthread_cond_t filtered;      /* a frame is done */
+  slot_t *slots;
+  int nslots;
+  int head, next;
+  int quit;
+  y4m_frame_pool_fn fn;
+  void *arg;
+} pool_t;
+
+typedef struct {
+  pool_t *pool;
+  int thread;
+} worker_t;
+
+static void *worker(void *p)
+{
+  worker_t *w = p;
+  pool_t *pool = w->pool;
+  slot_t *s;
+  int frame;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->next == pool->head && !pool->quit)
+      pthread_cond_wait(&pool->queued, &pool->lock);
+    if (pool->quit)
+      break;
+    frame = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+
+    s = &pool->slots[frame % pool->nslots];
+    s->err = (*pool->fn)(pool->arg, w->thread, frame, &s->fi, s->in, s->out);
+
+    pthread_mutex_lock(&pool->lock);
+    s->done = 1;
+    pthread_cond_signal(&pool->filtered);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+static int run_threads(int fdin, const y4m_stream_info_t *istream,
+                       int fdout, const y4m_stream_info_t *ostream,
+                       pool_t *pool, int nthreads)
+{
+  pthread_t threads[MAX_THREADS];
+  worker_t workers[MAX_THREADS];
+  slot_t *s;
+  int tail = 0, eof = 0, err = Y4M_OK, done, started, i;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->queued, NULL);
+  pthread_cond_init(&pool->filtered, NULL);
+  for (started = 0; started < nthreads; started++) {
+    workers[started].pool = pool;
+    workers[started].thread = started;
+    if (pthread_create(&threads[started], NULL, worker, &workers[started]))
+      break;
+  }
+  if (started == 0)
+    err = Y4M_ERR_SYSTEM;
+  else if (started < nthreads)
+    mjpeg_warn("Only %d of %d frame threads started", started, nthreads);
+
+  while (err == Y4M_OK) {
+    /* write the oldest frame as soon as it is done... */
+    s = &pool->slots[tail % pool->nslots];
+    if (tail < pool->head) {
+      pthread_mutex_lock(&pool->lock);
+      while (!s->done && (eof || pool->head - tail == pool->nslots))
+        pthread_cond_wait(&pool->filtered, &pool->lock);
+      done = s->done;
+      s->done = 0;
+      pthread_mutex_unlock(&pool->lock);
+      if (done) {
+        if ((err = s->err) == Y4M_OK)
+          err = y4m_write_frame(fdout, ostream == NULL ? istream : ostream,
+                                &s->fi, s->out);
+        tail++;
+        continue;
+      }
+    }
+    else if (eof)
+      break;
+    /* ...and otherwise keep the workers fed */
+    s = &pool->slots[pool->head % pool->nslots];
+    err = y4m_read_frame(fdin, istream, &s->fi, s->in);
+    if (err == Y4M_OK) {
+      pthread_mutex_lock(&pool->lock);
+      pool->head++;
+      pthread_cond_signal(&pool->queued);
+      pthread_mutex_unlock(&pool->lock);
+    }
+    else if (err == Y4M_ERR_EOF) {
+      eof = 1;
+      err = Y4M_OK;
+    }
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->queued);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  pthread_cond_destroy(&pool->filtered);
+  pthread_cond_destroy(&pool->queued);
+  pthread_mutex_destroy(&pool->lock);
+  return err;
+}
+
+#endif /* HAVE_PTHREAD */
+
+
+int y4m_frame_pool_run(int fdin, const y4m_stream_info_t *istream,
+                       int fdout, const y4m_stream_info_t *ostream,
+                       y4m_frame_pool_fn fn, void *arg)
+{
+  int nthreads = 1, nslots, err;
+  slot_t *slots;
+
+#ifdef HAVE_PTHREAD
+  nthreads = y4m_frame_pool_threads(-1);
+#endif
+  nslots = (nthreads > 1) ? SLOTS_PER_THREAD * nthreads : 1;
+  if ((slots = alloc_slots(nslots, istream, ostream)) == NULL)
+    return Y4M_ERR_SYSTEM;
+
+#ifdef HAVE_PTHREAD
+  if (nthreads > 1) {
+    pool_t pool;
+
+    pool.slots = slots;
+    pool.nslots = nslots;
+    pool.head = pool.next = 0;
+    pool.quit = 0;
+    pool.fn = fn;
+    pool.arg = arg;
+    err = run_threads(fdin, istream, fdout, ostream, &pool, nthreads);
+  }
+  else
+#endif
+    err = run_serial(fdin, istream, fdout,
+                     ostream == NULL ? istream : ostream, fn, arg, slots);
+
+  free_slots(slots, nslots, ostream == NULL);
+  return err;
+}
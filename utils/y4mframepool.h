@@ -0,0 +1,75 @@
+/*
+ * y4mframepool.h:  Run a per-frame YUV4MPEG2 filter on several threads
+ *
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __Y4MFRAMEPOOL_H__
+#define __Y4MFRAMEPOOL_H__
+
+#include <mjpeg_types.h>
+#include "yuv4mpeg.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Number of worker threads y4m_frame_pool_run() uses.
+ *  Defaults to $MJPEG_FRAME_THREADS, or to the number of processors.
+ *  If n > 0, sets it to n.  Returns the previous setting.
+ */
+int y4m_frame_pool_threads(int n);
+
+/*
+ * A filter whose output frame depends on its input frame only.
+ *
+ *  Computes the planes 'out' of frame number 'frame' (counting from 0)
+ *  from its planes 'in'; for an in-place filter, out == in.  'fi' is
+ *  the frame's header, and may be changed.  'thread' is the number
+ *  (0 .. y4m_frame_pool_threads() - 1) of the worker thread calling,
+ *  for the filter to pick its scratch buffers by.
+ *
+ *  Returns Y4M_OK, or an error code that stops the pool.
+ */
+typedef int (*y4m_frame_pool_fn)(void *arg, int thread, int frame,
+                                 y4m_frame_info_t *fi,
+                                 uint8_t * const *in, uint8_t * const *out);
+
+/*
+ * Read frames from fdin until the end of the stream, run fn on each of
+ *  them, on as many threads as frames are available, and write the
+ *  results to fdout in the order they were read.  The output is the
+ *  same whatever the number of threads.
+ *
+ *  ostream describes the output frames; if it is NULL, fn filters
+ *  in place and the output frames are those of istream.
+ *  Stream headers are left to the caller.
+ *
+ *  Returns Y4M_OK at the (clean) end of the input stream, or the first
+ *  error in reading, filtering or writing a frame.
+ */
+int y4m_frame_pool_run(int fdin, const y4m_stream_info_t *istream,
+                       int fdout, const y4m_stream_info_t *ostream,
+                       y4m_frame_pool_fn fn, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __Y4MFRAMEPOOL_H__ */
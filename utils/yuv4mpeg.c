@@ -23,9 +23,27 @@
 #include <config.h>
 
 #include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#if defined(_POSIX_SHARED_MEMORY_OBJECTS) && _POSIX_SHARED_MEMORY_OBJECTS > 0 \
+ && defined(_POSIX_SEMAPHORES) && _POSIX_SEMAPHORES > 0
+#define Y4M_SHM_TRANSPORT
+#include <fcntl.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#endif
 #define INTERNAL_Y4M_LIBCODE_STUFF_QPX
 #include "yuv4mpeg.h"
 #include "yuv4mpeg_intern.h"
@@ -34,6 +52,9 @@
 
 static int _y4mparam_allow_unknown_tags = 1;  /* default is forgiveness */
 static int _y4mparam_feature_level = 0;       /* default is ol YUV4MPEG2 */
+static int _y4mparam_buffered_reads = 1;      /* default is buffered fd reads */
+static int _y4mparam_shm_transport = -1;      /* default from environment */
+static int _y4mparam_stats = -1;              /* default from environment */
 
 static void *(*_y4m_alloc)(size_t bytes) = malloc;
 static void (*_y4m_free)(void *ptr) = free;
@@ -55,6 +76,307 @@ int y4m_accept_extensions(int level)
   return old;
 }
 
+int y4m_buffered_reads(int yn)
+{
+  int old = _y4mparam_buffered_reads;
+  if (yn >= 0)
+    _y4mparam_buffered_reads = (yn) ? 1 : 0;
+  return old;
+}
+
+int y4m_shm_transport(int yn)
+{
+  int old = _y4mparam_shm_transport;
+  if (old < 0) {
+    const char *env = getenv("MJPEG_Y4M_SHM");
+    old = (env == NULL || atoi(env) != 0) ? 1 : 0;
+  }
+  _y4mparam_shm_transport = (yn >= 0) ? ((yn) ? 1 : 0) : old;
+  return old;
+}
+
+static void y4m_stats_exit(void);
+
+int y4m_stats(int n)
+{
+  int old = _y4mparam_stats;
+  if (old < 0) {
+    const char *env = getenv("MJPEG_Y4M_STATS");
+    old = (env != NULL && atoi(env) > 0) ? atoi(env) : 0;
+  }
+  _y4mparam_stats = (n >= 0) ? n : old;
+  if (_y4mparam_stats > 0) {
+    static int registered = 0;
+    if (!registered)
+      registered = (atexit(y4m_stats_exit) == 0);
+  }
+  return old;
+}
+
+
+/*************************************************************************
+ *
+ * Pipeline statistics
+ *
+ *   With statistics on, the time spent in read(2) and write(2) of
+ *   streams, and waiting for free shared-memory slots, is added up and
+ *   frames are stamped as they pass through the process:  reading a
+ *   frame header adds an XY4MT=<program>:<in> tag to it, and writing
+ *   the frame completes the tag to XY4MT=<program>:<in>+<ms taken>.
+ *   A frame which was not read (a source) starts with <out>+0.  Times
+ *   are milliseconds of the system clock, modulo Y4M_STATS_CLOCK.
+ *
+ *   A filter that passes frame tags along (with y4m_copy_frame_info())
+ *   thus passes on the stamps of all stages upstream of it; one which
+ *   does not starts a new chain.  The counters are not locked, so in a
+ *   program reading and writing in different threads they are only
+ *   approximate.
+ *
+ *************************************************************************/
+
+#define Y4M_STATS_TAG     "XY4MT="
+#define Y4M_STATS_CLOCK   100000000L  /* ms; the stamps wrap around */
+#define Y4M_STATS_NAME    10          /* chars of program name in a stamp */
+#define Y4M_STATS_STAGES  8
+
+typedef struct {
+  char name[Y4M_STATS_NAME + 1];
+  long frames;
+  double busy;                  /* ms from reading to writing frames */
+  double hop;                   /* ms from writing to the next reading */
+  long first_out, last_out;
+} y4m_stage_stats_t;
+
+static struct {
+  double start, since;          /* s, of first frame / this report */
+  long frames_in, frames_out;
+  double read_wait, write_wait; /* s blocked since the last report */
+  long total_in, total_out;
+  int stages;
+  y4m_stage_stats_t stage[Y4M_STATS_STAGES];
+  double latency;               /* ms from the first stage to this one */
+} _y4m_stats;
+
+static double y4m_stats_now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static long y4m_stats_ms(double t)
+{
+  return (long)((long long)(t * 1000.0) % Y4M_STATS_CLOCK);
+}
+
+/* ms from stamp a to stamp b */
+static long y4m_stats_diff(long a, long b)
+{
+  long d = (b - a) % Y4M_STATS_CLOCK;
+  return (d < 0) ? d + Y4M_STATS_CLOCK : d;
+}
+
+static const char *y4m_stats_name(void)
+{
+#ifdef HAVE___PROGNAME
+  extern const char *__progname;
+  return __progname;
+#else
+  return "y4m";
+#endif
+}
+
+/* Start of a wait to be timed, 0 if statistics are off */
+static double y4m_stats_begin(void)
+{
+  if (_y4mparam_stats < 0) y4m_stats(-1);
+  return (_y4mparam_stats > 0) ? y4m_stats_now() : 0.0;
+}
+
+static void y4m_stats_end(double t0, double *wait)
+{
+  if (t0 > 0.0)
+    *wait += y4m_stats_now() - t0;
+}
+
+static void y4m_stats_report(double now)
+{
+  double span = now - _y4m_stats.since;
+  long frames = (_y4m_stats.frames_out > _y4m_stats.frames_in) ?
+    _y4m_stats.frames_out : _y4m_stats.frames_in;
+  int k;
+
+  if (span <= 0.0) span = 1e-6;
+  mjpeg_info("y4m stats: %ld frames read, %ld written, %.2f fps; "
+	     "blocked %.1f%% reading, %.1f%% writing",
+	     _y4m_stats.frames_in, _y4m_stats.frames_out, frames / span,
+	     100.0 * _y4m_stats.read_wait / span,
+	     100.0 * _y4m_stats.write_wait / span);
+  for (k = 0; k < _y4m_stats.stages; k++) {
+    y4m_stage_stats_t *st = &_y4m_stats.stage[k];
+    long out_span = y4m_stats_diff(st->first_out, st->last_out);
+    if (st->frames == 0) continue;
+    mjpeg_info("y4m stats:   stage %d %-*s %7.2f fps, %7.1f ms busy, "
+	       "%6.1f ms to next stage", k + 1, Y4M_STATS_NAME, st->name,
+	       (out_span > 0) ? (st->frames - 1) * 1000.0 / out_span : 0.0,
+	       st->busy / st->frames, st->hop / st->frames);
+  }
+  if (_y4m_stats.stages > 0 && _y4m_stats.frames_in > 0)
+    mjpeg_info("y4m stats:   latency from stage 1 to here %.1f ms",
+	       _y4m_stats.latency / _y4m_stats.frames_in);
+  _y4m_stats.since = now;
+  _y4m_stats.frames_in = _y4m_stats.frames_out = 0;
+  _y4m_stats.read_wait = _y4m_stats.write_wait = 0.0;
+  _y4m_stats.latency = 0.0;
+  for (k = 0; k < Y4M_STATS_STAGES; k++)
+    _y4m_stats.stage[k].frames = 0;
+}
+
+/* Count a frame, and report if the interval is up */
+static void y4m_stats_frame(double now, long *count, long *total)
+{
+  if (_y4m_stats.start == 0.0)
+    _y4m_stats.start = _y4m_stats.since = now;
+  (*count)++;
+  (*total)++;
+  if (now - _y4m_stats.since >= _y4mparam_stats)
+    y4m_stats_report(now);
+}
+
+static void y4m_stats_exit(void)
+{
+  double now;
+
+  if (_y4m_stats.start == 0.0)
+    return;
+  now = y4m_stats_now();
+  if (_y4m_stats.frames_in > 0 || _y4m_stats.frames_out > 0)
+    y4m_stats_report(now);
+  mjpeg_info("y4m stats: %ld frames read, %ld written in %.1f s",
+	     _y4m_stats.total_in, _y4m_stats.total_out,
+	     now - _y4m_stats.start);
+}
+
+/* Parse stamp tag "XY4MT=name:in+busy" (busy < 0 if not yet written) */
+static int y4m_stats_parse(const char *tag, char *name, long *in, long *busy)
+{
+  const char *colon, *p;
+  char *end;
+  size_t n;
+
+  if (strncmp(tag, Y4M_STATS_TAG, strlen(Y4M_STATS_TAG)))
+    return 0;
+  tag += strlen(Y4M_STATS_TAG);
+  if ((colon = strrchr(tag, ':')) == NULL)
+    return 0;
+  n = colon - tag;
+  if (n > Y4M_STATS_NAME) n = Y4M_STATS_NAME;
+  memcpy(name, tag, n);
+  name[n] = '\0';
+  *in = strtol(colon + 1, &end, 10);
+  if (end == colon + 1)
+    return 0;
+  *busy = -1;
+  if (*end == '+') {
+    p = end + 1;
+    *busy = strtol(p, &end, 10);
+    if (end == p) *busy = -1;
+  }
+  return 1;
+}
+
+/* A frame header was read: account for the stages it passed, stamp it */
+static void y4m_stats_frame_in(y4m_frame_info_t *fi)
+{
+  char name[Y4M_STATS_NAME + 1];
+  char tag[Y4M_MAX_XTAG_SIZE];
+  long in, busy, out, prev_out = 0;
+  double now;
+  int n, k = 0;
+
+  if (y4m_stats_begin() == 0.0)
+    return;
+  now = y4m_stats_now();
+  for (n = 0; n < fi->x_tags.count; n++) {
+    y4m_stage_stats_t *st;
+    if (!y4m_stats_parse(fi->x_tags.tags[n], name, &in, &busy) || busy < 0)
+      continue;
+    out = (in + busy) % Y4M_STATS_CLOCK;
+    if (k > 0)
+      _y4m_stats.stage[k-1].hop += y4m_stats_diff(prev_out, in);
+    if (k == Y4M_STATS_STAGES)
+      break;
+    st = &_y4m_stats.stage[k];
+    if (strcmp(st->name, name) || st->frames == 0) {
+      strcpy(st->name, name);
+      st->frames = 0;
+      st->busy = st->hop = 0.0;
+      st->first_out = out;
+    }
+    st->frames++;
+    st->busy += busy;
+    st->last_out = out;
+    prev_out = out;
+    k++;
+  }
+  if (k > 0) {
+    _y4m_stats.stage[k-1].hop += y4m_stats_diff(prev_out, y4m_stats_ms(now));
+    _y4m_stats.latency +=
+      y4m_stats_diff(_y4m_stats.stage[0].last_out, y4m_stats_ms(now));
+  }
+  _y4m_stats.stages = k;
+  snprintf(tag, sizeof(tag), "%s%.*s:%ld", Y4M_STATS_TAG, Y4M_STATS_NAME,
+	   y4m_stats_name(), y4m_stats_ms(now));
+  y4m_xtag_add(&(fi->x_tags), tag);
+  y4m_stats_frame(now, &_y4m_stats.frames_in, &_y4m_stats.total_in);
+}
+
+/*
+ * Print the xtags of a frame about to be written into s[maxn], as
+ * y4m_snprint_xtags() does, with this process' stamp completed (or
+ * added, for a frame that was not read).  A stamp that does not fit is
+ * left out.
+ */
+static int y4m_stats_snprint_xtags(char *s, int maxn,
+				   const y4m_xtag_list_t *xtags)
+{
+  char name[Y4M_STATS_NAME + 1];
+  char stamp[Y4M_MAX_XTAG_SIZE + 2];
+  long in, busy, now_ms;
+  double now = y4m_stats_now();
+  int i, room, n, open_tag = -1;
+
+  now_ms = y4m_stats_ms(now);
+  for (i = xtags->count - 1; i >= 0; i--)
+    if (y4m_stats_parse(xtags->tags[i], name, &in, &busy)) {
+      if (busy < 0) open_tag = i;
+      break;
+    }
+  for (i = 0, room = maxn - 1; i < xtags->count; i++) {
+    if (i == open_tag) continue;
+    n = snprintf(s, room + 1, " %s", xtags->tags[i]);
+    if ((n < 0) || (n > room)) return Y4M_ERR_HEADER;
+    s += n;
+    room -= n;
+  }
+  if (open_tag >= 0) {
+    busy = y4m_stats_diff(in, now_ms);
+    n = snprintf(stamp, sizeof(stamp), " %s+%ld", xtags->tags[open_tag],
+		 (busy > 99999) ? 99999 : busy);
+  } else {
+    n = snprintf(stamp, sizeof(stamp), " %s%.*s:%ld+0", Y4M_STATS_TAG,
+		 Y4M_STATS_NAME, y4m_stats_name(), now_ms);
+  }
+  if ((n > 0) && (n < (int)sizeof(stamp)) && (n <= room)) {
+    memcpy(s, stamp, n);
+    s += n;
+  }
+  s[0] = '\n';
+  s[1] = '\0';
+  y4m_stats_frame(now, &_y4m_stats.frames_out, &_y4m_stats.total_out);
+  return Y4M_OK;
+}
+
 
 /*************************************************************************
  *
@@ -68,14 +390,16 @@ int y4m_accept_extensions(int level)
  *     
  *************************************************************************/
 
-ssize_t y4m_read(int fd, void *buf, size_t len)
+static ssize_t y4m_read_raw(int fd, void *buf, size_t len)
 {
    ssize_t n;
    uint8_t *ptr = (uint8_t *)buf;
+   double t0 = y4m_stats_begin();
 
    while (len > 0) {
      n = read(fd, ptr, len);
      if (n <= 0) {
+       y4m_stats_end(t0, &_y4m_stats.read_wait);
        /* return amount left to read */
        if (n == 0)
 	 return len;  /* n == 0 --> eof */
@@ -85,21 +409,423 @@ ssize_t y4m_read(int fd, void *buf, size_t len)
      ptr += n;
      len -= n;
    }
+   y4m_stats_end(t0, &_y4m_stats.read_wait);
    return 0;
 }
 
+/*************************************************************************
+ *
+ * Frame blocks
+ *
+ *   Reference counted buffers shared by the read buffers of fd readers
+ *   and by borrowed and allocated frames (see y4m_borrow_frame()).
+ *   A read buffer counts one reference of its own; frames borrowed
+ *   from it keep it alive after the reader has moved on to a fresh
+ *   block.  Unreferenced blocks are kept for reuse, until exit.
+ *
+ *   Frames may be borrowed in one thread and released in another, so
+ *   the block list and reference counts, and the table of fd readers,
+ *   are only touched under _y4m_lock.  Each reader (i.e. each fd) must
+ *   still be read by only one thread at a time.
+ *
+ *************************************************************************/
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t _y4m_lock = PTHREAD_MUTEX_INITIALIZER;
+#define y4m_lock()    pthread_mutex_lock(&_y4m_lock)
+#define y4m_unlock()  pthread_mutex_unlock(&_y4m_lock)
+#else
+#define y4m_lock()
+#define y4m_unlock()
+#endif
+
+typedef struct _y4m_frame_block {
+  uint8_t *data;
+  size_t size;
+  int refs;
+  struct _y4m_frame_block *next;
+} y4m_frame_block_t;
+
+static y4m_frame_block_t *_y4m_frame_blocks = NULL;
+
+/* An unreferenced block of at least 'size' bytes, with one reference */
+static y4m_frame_block_t *y4m_frame_block_get(size_t size)
+{
+  y4m_frame_block_t *b, *best = NULL;
+
+  y4m_lock();
+  for (b = _y4m_frame_blocks; b != NULL; b = b->next)
+    if (b->refs == 0 && b->size >= size &&
+        (best == NULL || b->size < best->size))
+      best = b;
+  if (best == NULL) {
+    best = _y4m_alloc(sizeof(*best));
+    if (best != NULL && (best->data = _y4m_alloc(size)) == NULL) {
+      _y4m_free(best);
+      best = NULL;
+    }
+    if (best != NULL) {
+      best->size = size;
+      best->next = _y4m_frame_blocks;
+      _y4m_frame_blocks = best;
+    }
+  }
+  if (best != NULL)
+    best->refs = 1;
+  y4m_unlock();
+  return best;
+}
+
+static void y4m_frame_block_ref(y4m_frame_block_t *b)
+{
+  y4m_lock();
+  b->refs++;
+  y4m_unlock();
+}
+
+/* Drop a reference; a block no one else uses is freed if 'discard' */
+static void y4m_frame_block_unref(y4m_frame_block_t *b, int discard)
+{
+  y4m_frame_block_t **l;
+
+  y4m_lock();
+  if (--b->refs == 0 && discard) {
+    for (l = &_y4m_frame_blocks; *l != NULL; l = &(*l)->next)
+      if (*l == b) {
+        *l = b->next;
+        break;
+      }
+    _y4m_free(b->data);
+    _y4m_free(b);
+  }
+  y4m_unlock();
+}
+
+/* Does anyone besides its holder use the block? */
+static int y4m_frame_block_shared(y4m_frame_block_t *b)
+{
+  int shared;
+
+  y4m_lock();
+  shared = (b->refs > 1);
+  y4m_unlock();
+  return shared;
+}
+
+/* Release a frame in the block holding the byte at p; 0 if there is none */
+static int y4m_frame_block_release(const uint8_t *p)
+{
+  y4m_frame_block_t *b;
+
+  y4m_lock();
+  for (b = _y4m_frame_blocks; b != NULL; b = b->next)
+    if (p >= b->data && p < b->data + b->size) {
+      if (b->refs > 0)
+        b->refs--;
+      break;
+    }
+  y4m_unlock();
+  return (b != NULL);
+}
+
+
+/*************************************************************************
+ *
+ * Buffered fd readers
+ *
+ *   Header lines are parsed out of a read buffer rather than fetched a
+ *   byte per read(2), and plane data is copied out of the buffer
+ *   or, for the bulk of a large frame, read straight into the caller's
+ *   planes.  One reader is kept per file descriptor so that bytes read
+ *   ahead by one call are there for the next; the fd-based API uses
+ *   them implicitly.  As a reader may hold bytes already read from
+ *   its fd, raw data must then be fetched with y4m_read() not read(2).
+ *
+ *   A descriptor number can be closed and reused for another file, so
+ *   buffered bytes are only trusted while the fd still refers to the
+ *   same file (and, for regular files, the same file position).  The
+ *   buffer is given back at end of file and when its bytes turn out to
+ *   be stale, and a new one taken if the fd is read again; what is left
+ *   is freed at exit.
+ *
+ *************************************************************************/
+
+#define Y4M_READER_BUFSIZE  (128*1024)
+#define Y4M_READER_MAX_FD   1024
+
+typedef struct _y4m_shm y4m_shm_t;
+
+typedef struct _y4m_reader {
+  int fd;
+  y4m_frame_block_t *block;     /* holds buf, NULL if there is none */
+  uint8_t *buf;
+  size_t pos;                   /* next unconsumed byte in buf */
+  size_t len;                   /* end of valid data in buf */
+  dev_t dev;                    /* identity of fd when buf was filled */
+  ino_t ino;
+  off_t offset;                 /* fd position at end of buf, or -1 */
+  int identified;               /* dev/ino/offset are current */
+  y4m_cb_reader_t cb;           /* buffered callback view of the reader */
+  y4m_shm_t *shm;               /* ring frame data may come through */
+  uint8_t *slot_data;           /* unread data of the current frame's slot */
+  size_t slot_left;
+  int slot;
+} y4m_reader_t;
+
+static y4m_reader_t *_y4m_fd_readers[Y4M_READER_MAX_FD];
+static int _y4m_fd_readers_exit = 0;    /* exit hook registered */
+
+static ssize_t y4m_reader_read(void *data, void *buf, size_t len);
+static void y4m_shm_release(y4m_shm_t *shm, int slot);
+
+/* Record the identity of the fd before data is buffered */
+static void y4m_reader_identify(y4m_reader_t *r)
+{
+  struct stat st;
+
+  r->identified = 1;
+  if (fstat(r->fd, &st) != 0) {
+    r->dev = 0;
+    r->ino = 0;
+    r->offset = -1;
+    return;
+  }
+  r->dev = st.st_dev;
+  r->ino = st.st_ino;
+  r->offset = S_ISREG(st.st_mode) ? lseek(r->fd, 0, SEEK_CUR) : -1;
+}
+
+/* Give back the reader's buffer; frames borrowed from it keep it alive */
+static void y4m_reader_drop_buffer(y4m_reader_t *r)
+{
+  r->pos = r->len = 0;
+  if (r->block != NULL) {
+    y4m_frame_block_unref(r->block, 1);
+    r->block = NULL;
+    r->buf = NULL;
+  }
+}
+
+/* Fill the (empty) buffer with up to 'want' bytes: > 0 bytes read, 0 eof */
+static ssize_t y4m_reader_fill(y4m_reader_t *r, size_t want)
+{
+  ssize_t n;
+  double t0;
+
+  r->pos = r->len = 0;
+  if (!r->identified)
+    y4m_reader_identify(r);
+  /* Frames borrowed from the buffer pin it: continue in a new one */
+  if (r->block == NULL || y4m_frame_block_shared(r->block)) {
+    y4m_frame_block_t *b = y4m_frame_block_get(Y4M_READER_BUFSIZE);
+    if (b == NULL)
+      return -1;
+    if (r->block != NULL)
+      y4m_frame_block_unref(r->block, 0);
+    r->block = b;
+    r->buf = b->data;
+  }
+  t0 = y4m_stats_begin();
+  do {
+    n = read(r->fd, r->buf, want);
+  } while (n < 0 && errno == EINTR);
+  y4m_stats_end(t0, &_y4m_stats.read_wait);
+  if (n > 0) {
+    r->len = n;
+    if (r->offset >= 0)
+      r->offset += n;
+  } else if (n == 0)
+    y4m_reader_drop_buffer(r);
+  return n;
+}
+
+/* Throw away buffered bytes unless fd is still the stream they came from */
+static void y4m_reader_check(y4m_reader_t *r)
+{
+  struct stat st;
+
+  if (r->pos == r->len)
+    return;
+  if (fstat(r->fd, &st) != 0
+      || st.st_dev != r->dev || st.st_ino != r->ino
+      || (r->offset >= 0 && lseek(r->fd, 0, SEEK_CUR) != r->offset))
+    y4m_reader_drop_buffer(r);
+}
+
+/* Free the readers and the unused frame blocks */
+static void y4m_fd_readers_exit(void)
+{
+  y4m_frame_block_t **l, *b;
+  int fd;
+
+  for (fd = 0; fd < Y4M_READER_MAX_FD; fd++)
+    if (_y4m_fd_readers[fd] != NULL) {
+      y4m_reader_drop_buffer(_y4m_fd_readers[fd]);
+      _y4m_free(_y4m_fd_readers[fd]);
+      _y4m_fd_readers[fd] = NULL;
+    }
+  y4m_lock();
+  for (l = &_y4m_frame_blocks; (b = *l) != NULL; )
+    if (b->refs == 0) {
+      *l = b->next;
+      _y4m_free(b->data);
+      _y4m_free(b);
+    } else
+      l = &b->next;
+  y4m_unlock();
+}
+
+/* Buffered reader for fd, or NULL if reads of fd are unbuffered */
+static y4m_reader_t *y4m_fd_reader(int fd)
+{
+  y4m_reader_t *r;
+
+  if (!_y4mparam_buffered_reads || fd < 0 || fd >= Y4M_READER_MAX_FD)
+    return NULL;
+  y4m_lock();
+  r = _y4m_fd_readers[fd];
+  if (r == NULL && (r = _y4m_alloc(sizeof(*r))) != NULL) {
+    r->block = NULL;
+    r->buf = NULL;
+    r->fd = fd;
+    r->pos = r->len = 0;
+    r->identified = 0;
+    r->offset = -1;
+    r->cb.read = y4m_reader_read;
+    r->cb.data = r;
+    r->shm = NULL;
+    r->slot_left = 0;
+    _y4m_fd_readers[fd] = r;
+    if (!_y4m_fd_readers_exit)
+      _y4m_fd_readers_exit = (atexit(y4m_fd_readers_exit) == 0);
+  }
+  y4m_unlock();
+  if (r == NULL)
+    return NULL;
+  y4m_reader_check(r);
+  /* Nothing buffered: the fd may since have been reused */
+  if (r->pos == r->len)
+    r->identified = 0;
+  return r;
+}
+
+/* y4m_read() semantics on top of the buffer */
+static ssize_t y4m_reader_read(void *data, void *buf, size_t len)
+{
+  y4m_reader_t *r = (y4m_reader_t *)data;
+  uint8_t *ptr = (uint8_t *)buf;
+  size_t n;
+  ssize_t got;
+
+  /* Data of a frame sent through the shared-memory ring */
+  if (r->slot_left > 0) {
+    n = (len < r->slot_left) ? len : r->slot_left;
+    memcpy(ptr, r->slot_data, n);
+    r->slot_data += n;
+    r->slot_left -= n;
+    if (r->slot_left == 0)
+      y4m_shm_release(r->shm, r->slot);
+    ptr += n;
+    len -= n;
+  }
+  while (len > 0) {
+    if (r->pos == r->len) {
+      /* Large remainders go straight to the destination */
+      if (len >= Y4M_READER_BUFSIZE / 2) {
+        got = y4m_read_raw(r->fd, ptr, len);
+        if (r->offset >= 0)
+          r->offset += len - (got < 0 ? -got : got);
+        return got;
+      }
+      got = y4m_reader_fill(r, Y4M_READER_BUFSIZE);
+      if (got == 0)
+        return len;
+      if (got < 0)
+        return -len;
+    }
+    n = r->len - r->pos;
+    if (n > len)
+      n = len;
+    memcpy(ptr, r->buf + r->pos, n);
+    r->pos += n;
+    ptr += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/*
+ * Read a header line into line[n...] up to and including the '\n',
+ * which is replaced by '\0'.  Returns the index of the '\n', or
+ * Y4M_LINE_MAX if there was none within the maximum line length,
+ * or -1 on read error / eof.
+ */
+static int y4m_read_line_cb(y4m_cb_reader_t *fd, char *line, int n)
+{
+  y4m_reader_t *r;
+  const uint8_t *nl;
+  size_t avail;
+
+  if (fd->read != y4m_reader_read) {
+    for (; n < Y4M_LINE_MAX; n++) {
+      if (y4m_read_cb(fd, line+n, 1))
+        return -1;
+      if (line[n] == '\n') {
+        line[n] = '\0';
+        break;
+      }
+    }
+    return n;
+  }
+
+  r = (y4m_reader_t *)fd->data;
+  while (n < Y4M_LINE_MAX) {
+    if (r->pos == r->len && y4m_reader_fill(r, Y4M_READER_BUFSIZE) <= 0)
+      return -1;
+    avail = r->len - r->pos;
+    if (avail > (size_t)(Y4M_LINE_MAX - n))
+      avail = Y4M_LINE_MAX - n;
+    nl = memchr(r->buf + r->pos, '\n', avail);
+    if (nl != NULL)
+      avail = nl - (r->buf + r->pos) + 1;
+    memcpy(line + n, r->buf + r->pos, avail);
+    r->pos += avail;
+    n += avail;
+    if (nl != NULL) {
+      line[n-1] = '\0';
+      return n-1;
+    }
+  }
+  return n;
+}
+
+ssize_t y4m_read(int fd, void *buf, size_t len)
+{
+  y4m_reader_t *r;
+
+  if (fd >= 0 && fd < Y4M_READER_MAX_FD && _y4m_fd_readers[fd] != NULL) {
+    r = _y4m_fd_readers[fd];
+    y4m_reader_check(r);
+    if (r->pos < r->len || r->slot_left > 0)
+      return y4m_reader_read(r, buf, len);
+  }
+  return y4m_read_raw(fd, buf, len);
+}
+
 ssize_t y4m_write(int fd, const void *buf, size_t len)
 {
    ssize_t n;
    const uint8_t *ptr = (const uint8_t *)buf;
+   double t0 = y4m_stats_begin();
 
    while (len > 0) {
      n = write(fd, ptr, len);
-     if (n <= 0) return -len;  /* return amount left to write */
+     if (n <= 0) break;
      ptr += n;
      len -= n;
    }
-   return 0;
+   y4m_stats_end(t0, &_y4m_stats.write_wait);
+   return -len;  /* return amount left to write */
 }
 
 /* read len bytes from fd into buf */
@@ -120,7 +846,7 @@ ssize_t y4m_write_cb(y4m_cb_writer_t * fd, const void *buf, size_t len)
 ssize_t y4m_read_fd(void * data, void *buf, size_t len)
   {
   int * f = (int*)data;
-  return y4m_read(*f, buf, len);
+  return y4m_read_raw(*f, buf, len);
   }
 
 /* write len bytes from fd into buf */
@@ -132,6 +858,11 @@ ssize_t y4m_write_fd(void * data, const void *buf, size_t len)
 
 static void set_cb_reader_from_fd(y4m_cb_reader_t * ret, int * fd)
   {
+  y4m_reader_t *r = y4m_fd_reader(*fd);
+  if (r != NULL) {
+    *ret = r->cb;
+    return;
+  }
   ret->read = y4m_read_fd;
   ret->data = fd;
   }
@@ -143,6 +874,425 @@ static void set_cb_writer_from_fd(y4m_cb_writer_t * ret, int * fd)
   }
 
 
+/*************************************************************************
+ *
+ * Shared-memory frame transport
+ *
+ *   Between processes using this library on either end of a pipe, frame
+ *   data can bypass the pipe.  The writer creates a POSIX shared memory
+ *   ring of frame slots and names it in an X-tag of the stream header;
+ *   a reader that maps the ring acknowledges in its control block.  The
+ *   tag is removed as the header is read, so it does not travel further
+ *   down a pipeline.
+ *
+ *   Frame headers still go through the pipe.  That of a frame whose data
+ *   is in the ring carries the slot number in an X-tag, frames without
+ *   it are read from the pipe as usual.  The writer does not wait for
+ *   the acknowledgement: it sends frames through the pipe until it sees
+ *   one, and after Y4M_SHM_ACK_FRAMES frames without it withdraws the
+ *   ring (the reader does not use this library, reads the stream some
+ *   other way or could not map the ring).  It also sends frames through
+ *   the pipe when it runs out of free slots.
+ *
+ *   The shared memory object is unlinked as soon as the reader has
+ *   mapped it, when the writer withdraws it, or at the latest when the
+ *   writer exits.  So that a writer killed by SIGPIPE (the reader went
+ *   away first), SIGINT, SIGTERM or SIGHUP does not leave it behind, the
+ *   first ring offered installs handlers for those signals, where the
+ *   program has not set its own, that unlink the rings still offered and
+ *   then die of the signal as before.  Only a writer killed outright
+ *   (SIGKILL) before the reader acknowledged leaves its ring behind.
+ *   The list of mapped rings and their counts of lent frames are guarded
+ *   by _y4m_lock, like the frame blocks.
+ *
+ *************************************************************************/
+
+#define Y4M_SHM_TAG         "XY4MSHM="
+#define Y4M_SHM_SLOT_TAG    "XY4MSLOT="
+#define Y4M_SHM_MAGIC       "Y4MSHM1"
+#define Y4M_SHM_SLOTS       6
+#define Y4M_SHM_ALIGN       4096
+#define Y4M_SHM_ACK_FRAMES  25      /* frames for a reader to acknowledge */
+#define Y4M_SHM_SLOT_WAIT   1000    /* ms for a free slot */
+
+#ifdef Y4M_SHM_TRANSPORT
+
+typedef struct _y4m_shm_ctl {
+  char magic[8];
+  uint32_t slots;
+  uint32_t reserved;
+  uint64_t slot_size;
+  uint64_t data_offset;
+  uint64_t pipe_dev;            /* the pipe the ring was offered through */
+  uint64_t pipe_ino;
+  volatile int ack;             /* set by the reader */
+  volatile int full[Y4M_SHM_SLOTS];
+  sem_t free;                   /* number of slots not full */
+} y4m_shm_ctl_t;
+
+struct _y4m_shm {
+  y4m_shm_ctl_t *ctl;
+  size_t map_len;
+  uint8_t *slots;
+  size_t slot_size;
+  int nslots;
+  int lent;                     /* slots lent out as borrowed frames */
+  dev_t dev;                    /* the pipe written to */
+  ino_t ino;
+  int unacked;                  /* frames sent before the ack, -1 after */
+  char name[Y4M_MAX_XTAG_SIZE]; /* until unlinked, "" after */
+  struct _y4m_shm *next;
+};
+
+static y4m_shm_t *_y4m_shm_rings = NULL;
+static y4m_shm_t *_y4m_fd_shm_writers[Y4M_READER_MAX_FD];
+static int _y4m_shm_writers_exit = 0;   /* exit and signal hooks set */
+static const int _y4m_shm_signals[] = { SIGPIPE, SIGINT, SIGTERM, SIGHUP };
+
+/* Map the ring in shared memory object sfd, of map_len bytes */
+static y4m_shm_t *y4m_shm_map(int sfd, size_t map_len)
+{
+  y4m_shm_t *shm;
+  void *m = mmap(NULL, map_len, PROT_READ|PROT_WRITE, MAP_SHARED, sfd, 0);
+
+  if (m == MAP_FAILED)
+    return NULL;
+  if ((shm = _y4m_alloc(sizeof(*shm))) == NULL) {
+    munmap(m, map_len);
+    return NULL;
+  }
+  shm->ctl = (y4m_shm_ctl_t *)m;
+  shm->map_len = map_len;
+  shm->lent = 0;
+  shm->unacked = -1;
+  shm->name[0] = '\0';
+  y4m_lock();
+  shm->next = _y4m_shm_rings;
+  _y4m_shm_rings = shm;
+  y4m_unlock();
+  return shm;
+}
+
+static void y4m_shm_unlink(y4m_shm_t *shm)
+{
+  if (shm->name[0] != '\0') {
+    shm_unlink(shm->name);
+    shm->name[0] = '\0';
+  }
+}
+
+static void y4m_shm_unmap(y4m_shm_t *shm)
+{
+  y4m_shm_t **l;
+
+  y4m_shm_unlink(shm);
+  y4m_lock();
+  for (l = &_y4m_shm_rings; *l != NULL; l = &(*l)->next)
+    if (*l == shm) {
+      *l = shm->next;
+      break;
+    }
+  y4m_unlock();
+  munmap(shm->ctl, shm->map_len);
+  _y4m_free(shm);
+}
+
+/* Unlink the rings offered but not (yet) taken up */
+static void y4m_shm_writers_exit(void)
+{
+  int fd;
+
+  for (fd = 0; fd < Y4M_READER_MAX_FD; fd++)
+    if (_y4m_fd_shm_writers[fd] != NULL)
+      y4m_shm_unlink(_y4m_fd_shm_writers[fd]);
+}
+
+/* The same when killed by a signal, which is then delivered as before */
+static void y4m_shm_writers_signal(int sig)
+{
+  y4m_shm_writers_exit();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+/* Hook the above to program exit, and to the signals that would
+   otherwise kill the writer without it (under _y4m_lock) */
+static void y4m_shm_writers_hook(void)
+{
+  struct sigaction sa, old;
+  size_t i;
+
+  if (_y4m_shm_writers_exit)
+    return;
+  _y4m_shm_writers_exit = 1;
+  atexit(y4m_shm_writers_exit);
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = y4m_shm_writers_signal;
+  sigemptyset(&sa.sa_mask);
+  for (i = 0; i < sizeof(_y4m_shm_signals) / sizeof(_y4m_shm_signals[0]); i++)
+    if (sigaction(_y4m_shm_signals[i], NULL, &old) == 0 &&
+        !(old.sa_flags & SA_SIGINFO) && old.sa_handler == SIG_DFL)
+      sigaction(_y4m_shm_signals[i], &sa, NULL);
+}
+
+static void y4m_shm_release(y4m_shm_t *shm, int slot)
+{
+  __sync_synchronize();
+  shm->ctl->full[slot] = 0;
+  sem_post(&shm->ctl->free);
+}
+
+/* The ring, if any, that the frame at p was lent from (under _y4m_lock) */
+static y4m_shm_t *y4m_shm_find(const uint8_t *p)
+{
+  y4m_shm_t *shm;
+
+  for (shm = _y4m_shm_rings; shm != NULL; shm = shm->next)
+    if (p >= shm->slots && p < shm->slots + shm->nslots * shm->slot_size)
+      return shm;
+  return NULL;
+}
+
+/* Create a ring for frames of framelength bytes to be sent down pipe fd */
+static y4m_shm_t *y4m_shm_create(int fd, size_t framelength,
+                                 char *name, size_t namelen)
+{
+  static unsigned int serial = 0;
+  struct stat st;
+  struct timespec now;
+  y4m_shm_t *shm;
+  size_t slot_size, data_offset;
+  int sfd;
+
+  if (!y4m_shm_transport(-1) || fd < 0 || fd >= Y4M_READER_MAX_FD ||
+      fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode))
+    return NULL;
+  clock_gettime(CLOCK_REALTIME, &now);
+  snprintf(name, namelen, "/y4m-%x-%x", (unsigned int)getpid(),
+           (unsigned int)now.tv_nsec ^ (serial++ << 24));
+  slot_size = (framelength + Y4M_SHM_ALIGN - 1) & ~(size_t)(Y4M_SHM_ALIGN - 1);
+  data_offset = (sizeof(y4m_shm_ctl_t) + Y4M_SHM_ALIGN - 1) &
+    ~(size_t)(Y4M_SHM_ALIGN - 1);
+  sfd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+  if (sfd < 0)
+    return NULL;
+  if (ftruncate(sfd, data_offset + Y4M_SHM_SLOTS * slot_size) != 0 ||
+      (shm = y4m_shm_map(sfd, data_offset + Y4M_SHM_SLOTS * slot_size))
+      == NULL) {
+    close(sfd);
+    shm_unlink(name);
+    return NULL;
+  }
+  close(sfd);
+  memcpy(shm->ctl->magic, Y4M_SHM_MAGIC, sizeof(Y4M_SHM_MAGIC));
+  shm->ctl->slots = shm->nslots = Y4M_SHM_SLOTS;
+  shm->ctl->slot_size = shm->slot_size = slot_size;
+  shm->ctl->data_offset = data_offset;
+  shm->slots = (uint8_t *)shm->ctl + data_offset;
+  shm->dev = st.st_dev;
+  shm->ino = st.st_ino;
+  shm->ctl->pipe_dev = st.st_dev;
+  shm->ctl->pipe_ino = st.st_ino;
+  if (sem_init(&shm->ctl->free, 1, Y4M_SHM_SLOTS) != 0) {
+    y4m_shm_unmap(shm);
+    shm_unlink(name);
+    return NULL;
+  }
+  strncpy(shm->name, name, sizeof(shm->name) - 1);
+  shm->name[sizeof(shm->name) - 1] = '\0';
+  shm->unacked = 0;
+  y4m_lock();
+  y4m_shm_writers_hook();
+  y4m_unlock();
+  return shm;
+}
+
+/* Writer's ring for fd, provided fd is still the pipe it was made for */
+static y4m_shm_t *y4m_shm_writer(int fd)
+{
+  y4m_shm_t *shm;
+  struct stat st;
+
+  if (fd < 0 || fd >= Y4M_READER_MAX_FD ||
+      (shm = _y4m_fd_shm_writers[fd]) == NULL)
+    return NULL;
+  if (fstat(fd, &st) != 0 || st.st_dev != shm->dev || st.st_ino != shm->ino) {
+    _y4m_fd_shm_writers[fd] = NULL;
+    y4m_shm_unmap(shm);
+    return NULL;
+  }
+  return shm;
+}
+
+/* Whether the reader has taken up the writer's ring on fd yet; after
+   Y4M_SHM_ACK_FRAMES frames without it the ring is withdrawn */
+static int y4m_shm_ready(int fd, y4m_shm_t *shm)
+{
+  if (shm->unacked < 0)
+    return 1;
+  __sync_synchronize();
+  if (shm->ctl->ack) {
+    shm->unacked = -1;
+    y4m_shm_unlink(shm);
+    return 1;
+  }
+  if (++shm->unacked > Y4M_SHM_ACK_FRAMES) {
+    _y4m_fd_shm_writers[fd] = NULL;
+    y4m_shm_unmap(shm);
+  }
+  return 0;
+}
+
+/* A free slot to write a frame to, or -1 to write through the pipe */
+static int y4m_shm_acquire(y4m_shm_t *shm, int fd)
+{
+  struct timespec until;
+  struct pollfd pfd;
+  int waits, slot, got;
+  double t0;
+
+  for (waits = 0; sem_trywait(&shm->ctl->free) != 0; waits++) {
+    if ((errno != EAGAIN && errno != EINTR) || waits >= Y4M_SHM_SLOT_WAIT)
+      return -1;
+    /* Check now and then that the reader is still there */
+    if (waits % 100 == 99) {
+      pfd.fd = fd;
+      pfd.events = POLLOUT;
+      if (poll(&pfd, 1, 0) == 1 && (pfd.revents & (POLLERR|POLLHUP)))
+        return -1;
+    }
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += 1000000;
+    if (until.tv_nsec >= 1000000000) {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000;
+    }
+    t0 = y4m_stats_begin();
+    got = (sem_timedwait(&shm->ctl->free, &until) == 0);
+    y4m_stats_end(t0, &_y4m_stats.write_wait);
+    if (got)
+      break;
+  }
+  for (slot = 0; slot < shm->nslots; slot++)
+    if (!shm->ctl->full[slot])
+      return slot;
+  sem_post(&shm->ctl->free);
+  return -1;
+}
+
+/* Reader: map the ring named by tag, and acknowledge it */
+static void y4m_shm_attach(y4m_reader_t *r, const char *tag)
+{
+  struct stat st, pst;
+  y4m_shm_t *shm;
+  int sfd, lent;
+
+  if (fstat(r->fd, &pst) != 0 || !S_ISFIFO(pst.st_mode))
+    return;
+  sfd = shm_open(tag + strlen(Y4M_SHM_TAG), O_RDWR, 0);
+  if (sfd < 0)
+    return;
+  shm = (fstat(sfd, &st) == 0 && st.st_size >= (off_t)sizeof(y4m_shm_ctl_t))
+    ? y4m_shm_map(sfd, st.st_size) : NULL;
+  close(sfd);
+  if (shm == NULL)
+    return;
+  /* The tag may have been passed on by a stage not using the ring */
+  if (memcmp(shm->ctl->magic, Y4M_SHM_MAGIC, sizeof(Y4M_SHM_MAGIC)) ||
+      shm->ctl->pipe_dev != (uint64_t)pst.st_dev ||
+      shm->ctl->pipe_ino != (uint64_t)pst.st_ino ||
+      shm->ctl->slots > Y4M_SHM_SLOTS ||
+      shm->ctl->data_offset + shm->ctl->slots * shm->ctl->slot_size
+      > (uint64_t)st.st_size) {
+    y4m_shm_unmap(shm);
+    return;
+  }
+  shm->nslots = shm->ctl->slots;
+  shm->slot_size = shm->ctl->slot_size;
+  shm->slots = (uint8_t *)shm->ctl + shm->ctl->data_offset;
+  /* Mapped, the name is no longer needed */
+  shm_unlink(tag + strlen(Y4M_SHM_TAG));
+  if (r->shm != NULL) {
+    if (r->slot_left > 0) {
+      y4m_shm_release(r->shm, r->slot);
+      r->slot_left = 0;
+    }
+    /* frames still lent out keep the old ring mapped */
+    y4m_lock();
+    lent = r->shm->lent;
+    y4m_unlock();
+    if (lent == 0)
+      y4m_shm_unmap(r->shm);
+  }
+  r->shm = shm;
+  shm->ctl->ack = 1;
+  __sync_synchronize();
+}
+
+#else /* !Y4M_SHM_TRANSPORT */
+
+static void y4m_shm_release(y4m_shm_t *shm, int slot)
+{
+}
+
+#endif /* Y4M_SHM_TRANSPORT */
+
+/* Handle (and remove) the ring tag of a stream header read by fd */
+static void y4m_shm_stream_tag(y4m_cb_reader_t *fd, y4m_stream_info_t *si)
+{
+  const char *tag;
+  int n;
+
+  for (n = 0; n < si->x_tags.count; n++) {
+    tag = si->x_tags.tags[n];
+    if (strncmp(tag, Y4M_SHM_TAG, strlen(Y4M_SHM_TAG)))
+      continue;
+#ifdef Y4M_SHM_TRANSPORT
+    if (fd->read == y4m_reader_read)
+      y4m_shm_attach((y4m_reader_t *)fd->data, tag);
+#endif
+    y4m_xtag_remove(&si->x_tags, n);
+    return;
+  }
+}
+
+/* Take the slot named by the last tag of frame header fi, if any */
+static int y4m_reader_take_slot(y4m_reader_t *r, const y4m_stream_info_t *si,
+                                y4m_frame_info_t *fi)
+{
+  y4m_xtag_list_t *tags = &fi->x_tags;
+  const char *tag;
+  int slot;
+
+  if (tags->count == 0)
+    return Y4M_OK;
+  tag = tags->tags[tags->count - 1];
+  if (strncmp(tag, Y4M_SHM_SLOT_TAG, strlen(Y4M_SHM_SLOT_TAG)))
+    return Y4M_OK;
+  slot = atoi(tag + strlen(Y4M_SHM_SLOT_TAG));
+  y4m_xtag_remove(tags, tags->count - 1);
+#ifdef Y4M_SHM_TRANSPORT
+  if (r->shm != NULL && slot >= 0 && slot < r->shm->nslots &&
+      (size_t)y4m_si_get_framelength(si) <= r->shm->slot_size) {
+    r->slot = slot;
+    r->slot_data = r->shm->slots + slot * r->shm->slot_size;
+    r->slot_left = y4m_si_get_framelength(si);
+    return Y4M_OK;
+  }
+#endif
+  return Y4M_ERR_BADTAG;
+}
+
+/* Give back the slot of a frame whose data was skipped */
+static void y4m_reader_drop_slot(y4m_reader_t *r)
+{
+  if (r->slot_left > 0) {
+    y4m_shm_release(r->shm, r->slot);
+    r->slot_left = 0;
+  }
+}
+
+
 /*************************************************************************
  *
  * "Extra tags" handling
@@ -290,6 +1440,7 @@ void y4m_clear_stream_info(y4m_stream_info_t *info)
   } else {
     info->chroma = Y4M_UNKNOWN;
   }
+  info->bitdepth = 8;
   y4m_xtag_clearlist(&(info->x_tags));
 }
 
@@ -304,6 +1455,7 @@ void y4m_copy_stream_info(y4m_stream_info_t *dest,
   dest->framerate = src->framerate;
   dest->sampleaspect = src->sampleaspect;
   dest->chroma = src->chroma;
+  dest->bitdepth = src->bitdepth;
   y4m_copy_xtag_list(&(dest->x_tags), &(src->x_tags));
 }
 
@@ -320,6 +1472,7 @@ static int y4m_compare_stream_info(const y4m_stream_info_t *s1,const y4m_stream_
         s1->sampleaspect.n != s2->sampleaspect.n ||
         s1->sampleaspect.d != s2->sampleaspect.d ||
         s1->chroma         != s2->chroma         ||
+        s1->bitdepth       != s2->bitdepth       ||
         s1->x_tags.count   != s2->x_tags.count   )
         return 1;
 
@@ -380,6 +1533,15 @@ void y4m_si_set_chroma(y4m_stream_info_t *si, int chroma_mode)
 int y4m_si_get_chroma(const y4m_stream_info_t *si)
 { return si->chroma; }
 
+void y4m_si_set_bitdepth(y4m_stream_info_t *si, int bitdepth)
+{ si->bitdepth = bitdepth; }
+
+int y4m_si_get_bitdepth(const y4m_stream_info_t *si)
+{ return si->bitdepth; }
+
+int y4m_si_get_sample_size(const y4m_stream_info_t *si)
+{ return (si->bitdepth > 8) ? 2 : 1; }
+
 
 int y4m_si_get_plane_count(const y4m_stream_info_t *si)
 {
@@ -471,7 +1633,7 @@ int y4m_si_get_plane_length(const y4m_stream_info_t *si, int plane)
   int w = y4m_si_get_plane_width(si, plane);
   int h = y4m_si_get_plane_height(si, plane);
   if ((w != Y4M_UNKNOWN) && (h != Y4M_UNKNOWN))
-    return (w * h);
+    return (w * h * y4m_si_get_sample_size(si));
   else
     return Y4M_UNKNOWN;
 }
@@ -556,6 +1718,52 @@ y4m_xtag_list_t *y4m_fi_xtags(y4m_frame_info_t *fi)
  *
  *************************************************************************/
 
+/* chroma keywords of streams with more than 8 bits per sample:
+    "420p10", "422p12", "mono16", ... (the spelling ffmpeg uses) */
+static const struct {
+  int chroma;
+  const char *prefix;
+} deep_chroma[] = {
+  { Y4M_CHROMA_420JPEG, "420p" },
+  { Y4M_CHROMA_422,     "422p" },
+  { Y4M_CHROMA_444,     "444p" },
+  { Y4M_CHROMA_MONO,    "mono" },
+};
+
+#define DEEP_CHROMA_COUNT (sizeof(deep_chroma) / sizeof(deep_chroma[0]))
+
+static int y4m_chroma_parse_deep_keyword(const char *s, int *bitdepth)
+{
+  unsigned int k;
+
+  for (k = 0; k < DEEP_CHROMA_COUNT; k++) {
+    size_t n = strlen(deep_chroma[k].prefix);
+    char *end;
+    long depth;
+    if (strncasecmp(deep_chroma[k].prefix, s, n)) continue;
+    depth = strtol(s + n, &end, 10);
+    if ((end == s + n) || (*end != '\0') || (depth <= 8) || (depth > 16))
+      return Y4M_UNKNOWN;
+    *bitdepth = (int)depth;
+    return deep_chroma[k].chroma;
+  }
+  return Y4M_UNKNOWN;
+}
+
+static const char *y4m_chroma_deep_keyword(char *buf, int chroma_mode,
+					   int bitdepth)
+{
+  unsigned int k;
+
+  if ((bitdepth <= 8) || (bitdepth > 16)) return NULL;
+  for (k = 0; k < DEEP_CHROMA_COUNT; k++) {
+    if (deep_chroma[k].chroma != chroma_mode) continue;
+    sprintf(buf, "%s%d", deep_chroma[k].prefix, bitdepth);
+    return buf;
+  }
+  return NULL;
+}
+
 int y4m_parse_stream_tags(char *s, y4m_stream_info_t *i)
 {
   char *token, *value;
@@ -601,8 +1809,12 @@ int y4m_parse_stream_tags(char *s, y4m_stream_info_t *i)
       break;
     case 'C':
       i->chroma = y4m_chroma_parse_keyword(value);
-      if (i->chroma == Y4M_UNKNOWN)
-	return Y4M_ERR_HEADER;
+      i->bitdepth = 8;
+      if (i->chroma == Y4M_UNKNOWN) {
+	i->chroma = y4m_chroma_parse_deep_keyword(value, &(i->bitdepth));
+	if (i->chroma == Y4M_UNKNOWN)
+	  return Y4M_ERR_HEADER;
+      }
       break;
     case 'X':  /* 'X' meta-tag */
       if ((err = y4m_xtag_add(&(i->x_tags), token)) != Y4M_OK) return err;
@@ -638,6 +1850,9 @@ int y4m_parse_stream_tags(char *s, y4m_stream_info_t *i)
     if (i->interlace == Y4M_ILACE_MIXED)
       return Y4M_ERR_FEATURE;
   }
+  /*      - More than 8 bits per sample requires level >= 2 */
+  if ((i->bitdepth > 8) && (_y4mparam_feature_level < 2))
+    return Y4M_ERR_FEATURE;
 
   /* ta da!  done. */
   return Y4M_OK;
@@ -762,14 +1977,8 @@ static int y4m_read_stream_header_line_cb(y4m_cb_reader_t * fd, y4m_stream_info_
     /* start with a clean slate */
     y4m_clear_stream_info(i);
     /* read the header line */
-    for (; n < Y4M_LINE_MAX; n++) {
-        if (y4m_read_cb(fd, line+n, 1)) 
-            return Y4M_ERR_SYSTEM;
-        if (line[n] == '\n') {
-            line[n] = '\0';           /* Replace linefeed by end of string */
-            break;
-        }
-    }
+    if ((n = y4m_read_line_cb(fd, line, n)) < 0)
+        return Y4M_ERR_SYSTEM;
     /* look for keyword in header */
     if (strncmp(line, Y4M_MAGIC, strlen(Y4M_MAGIC)))
         return Y4M_ERR_MAGIC;
@@ -777,6 +1986,7 @@ static int y4m_read_stream_header_line_cb(y4m_cb_reader_t * fd, y4m_stream_info_
         return Y4M_ERR_HEADER;
     if ((err = y4m_parse_stream_tags(line + strlen(Y4M_MAGIC), i)) != Y4M_OK)
         return err;
+    y4m_shm_stream_tag(fd, i);
 
     return Y4M_OK;
 }
@@ -784,7 +1994,10 @@ static int y4m_read_stream_header_line_cb(y4m_cb_reader_t * fd, y4m_stream_info_
 static int y4m_reread_stream_header_line_cb(y4m_cb_reader_t *fd,const y4m_stream_info_t *si,char *line,int n)
 {
     y4m_stream_info_t i;
-    int err=y4m_read_stream_header_line_cb(fd,&i,line,n);
+    int err;
+
+    y4m_init_stream_info(&i);
+    err=y4m_read_stream_header_line_cb(fd,&i,line,n);
     if( err==Y4M_OK && y4m_compare_stream_info(si,&i) )
         err=Y4M_ERR_HEADER;
     y4m_fini_stream_info(&i);
@@ -812,8 +2025,12 @@ int y4m_write_stream_header_cb(y4m_cb_writer_t * fd, const y4m_stream_info_t *i)
   int err;
   y4m_ratio_t rate = i->framerate;
   y4m_ratio_t aspect = i->sampleaspect;
+  char deep_keyword[16];
   const char *chroma_keyword = y4m_chroma_keyword(i->chroma);
 
+  if (i->bitdepth != 8)
+    chroma_keyword = y4m_chroma_deep_keyword(deep_keyword, i->chroma,
+					     i->bitdepth);
   if ((i->chroma == Y4M_UNKNOWN) || (chroma_keyword == NULL))
     return Y4M_ERR_HEADER;
   if (_y4mparam_feature_level < 1) {
@@ -824,6 +2041,8 @@ int y4m_write_stream_header_cb(y4m_cb_writer_t * fd, const y4m_stream_info_t *i)
     if (i->interlace == Y4M_ILACE_MIXED)
       return Y4M_ERR_FEATURE;
   }
+  if ((i->bitdepth > 8) && (_y4mparam_feature_level < 2))
+    return Y4M_ERR_FEATURE;
   y4m_ratio_reduce(&rate);
   y4m_ratio_reduce(&aspect);
   n = snprintf(s, sizeof(s), "%s W%d H%d F%d:%d I%s A%d:%d C%s",
@@ -849,7 +2068,37 @@ int y4m_write_stream_header_cb(y4m_cb_writer_t * fd, const y4m_stream_info_t *i)
 int y4m_write_stream_header(int fd, const y4m_stream_info_t *i)
 {
   y4m_cb_writer_t w;
+#ifdef Y4M_SHM_TRANSPORT
+  y4m_stream_info_t si;
+  y4m_shm_t *shm;
+  char tag[Y4M_MAX_XTAG_SIZE];
+  char name[Y4M_MAX_XTAG_SIZE - (sizeof(Y4M_SHM_TAG) - 1)];
+  int err;
+#endif
+
   set_cb_writer_from_fd(&w, &fd);
+#ifdef Y4M_SHM_TRANSPORT
+  /* Offer a ring to the reader unless there already is one; the frames
+     go through the pipe until the reader acknowledges it */
+  if (y4m_shm_writer(fd) == NULL &&
+      (shm = y4m_shm_create(fd, y4m_si_get_framelength(i),
+                            name, sizeof(name))) != NULL) {
+    y4m_init_stream_info(&si);
+    y4m_copy_stream_info(&si, i);
+    snprintf(tag, sizeof(tag), "%s%s", Y4M_SHM_TAG, name);
+    err = y4m_xtag_add(&si.x_tags, tag);
+    if (err == Y4M_OK)
+      err = y4m_write_stream_header_cb(&w, &si);
+    y4m_fini_stream_info(&si);
+    if (err == Y4M_OK)
+      _y4m_fd_shm_writers[fd] = shm;
+    else
+      y4m_shm_unmap(shm);
+    /* nothing was written if the tag did not fit */
+    if (err == Y4M_OK || err == Y4M_ERR_SYSTEM)
+      return err;
+  }
+#endif
   return y4m_write_stream_header_cb(&w, i);
 }
 
@@ -867,13 +2116,27 @@ int y4m_read_frame_header_cb(y4m_cb_reader_t * fd,
 			  y4m_frame_info_t *fi)
 {
   char line[Y4M_LINE_MAX];
-  char *p;
   int n;
   ssize_t remain;
+  y4m_reader_t *r = NULL;
+  int err;
 
+  if (fd->read == y4m_reader_read) {
+    r = (y4m_reader_t *)fd->data;
+    y4m_reader_drop_slot(r);
+  }
  again:  
   /* start with a clean slate */
   y4m_clear_frame_info(fi);
+  /* With a buffered reader and large frames read little more than the
+     header line ahead: the bulk of the frame data can then be read
+     directly into the planes. */
+  if (r != NULL) {
+    if (r->pos == r->len &&
+        y4m_si_get_framelength(si) >= Y4M_READER_BUFSIZE / 2 &&
+        y4m_reader_fill(r, Y4M_LINE_MAX) < 0)
+      return Y4M_ERR_SYSTEM;
+  }
   /* This is more clever than read_stream_header...
      Try to read "FRAME\n" all at once, and don't try to parse
      if nothing else is there...
@@ -893,25 +2156,26 @@ int y4m_read_frame_header_cb(y4m_cb_reader_t * fd,
           return err;
       goto again;
   }
-  if (line[sizeof(Y4M_FRAME_MAGIC)-1] == '\n')
+  if (line[sizeof(Y4M_FRAME_MAGIC)-1] == '\n') {
+    y4m_stats_frame_in(fi);
     return Y4M_OK; /* done -- no tags:  that was the end-of-line. */
+  }
 
   if (line[sizeof(Y4M_FRAME_MAGIC)-1] != Y4M_DELIM[0]) {
     return Y4M_ERR_MAGIC; /* wasn't a space -- what was it? */
   }
 
   /* proceed to get the tags... (overwrite the magic) */
-  for (n = 0, p = line; n < Y4M_LINE_MAX; n++, p++) {
-    if (y4m_read_cb(fd, p, 1))
-      return Y4M_ERR_SYSTEM;
-    if (*p == '\n') {
-      *p = '\0';           /* Replace linefeed by end of string */
-      break;
-    }
-  }
+  if ((n = y4m_read_line_cb(fd, line, 0)) < 0)
+    return Y4M_ERR_SYSTEM;
   if (n >= Y4M_LINE_MAX) return Y4M_ERR_HEADER;
   /* non-zero on error */
-  return y4m_parse_frame_tags(line, si, fi);
+  if ((err = y4m_parse_frame_tags(line, si, fi)) != Y4M_OK)
+    return err;
+  if (r != NULL && (err = y4m_reader_take_slot(r, si, fi)) != Y4M_OK)
+    return err;
+  y4m_stats_frame_in(fi);
+  return Y4M_OK;
 }
 
 int y4m_read_frame_header(int fd,
@@ -924,16 +2188,16 @@ int y4m_read_frame_header(int fd,
   }
 
 
-int y4m_write_frame_header_cb(y4m_cb_writer_t * fd,
-			   const y4m_stream_info_t *si,
-			   const y4m_frame_info_t *fi)
+/* Format the header line of frame fi into s[Y4M_LINE_MAX+1] */
+static int y4m_snprint_frame_header(char *s, const y4m_stream_info_t *si,
+                                    const y4m_frame_info_t *fi)
 {
-  char s[Y4M_LINE_MAX+1];
-  int n, err;
+  const size_t maxn = Y4M_LINE_MAX+1;
+  int n;
 
   if (si->interlace == Y4M_ILACE_MIXED) {
     if (_y4mparam_feature_level < 1) return Y4M_ERR_FEATURE;
-    n = snprintf(s, sizeof(s), "%s I%c%c%c", Y4M_FRAME_MAGIC,
+    n = snprintf(s, maxn, "%s I%c%c%c", Y4M_FRAME_MAGIC,
 		 (fi->presentation == Y4M_PRESENT_TOP_FIRST)        ? 't' :
 		 (fi->presentation == Y4M_PRESENT_TOP_FIRST_RPT)    ? 'T' :
 		 (fi->presentation == Y4M_PRESENT_BOTTOM_FIRST)     ? 'b' :
@@ -950,12 +2214,23 @@ int y4m_write_frame_header_cb(y4m_cb_writer_t * fd,
 		 '?'
 		 );
   } else {
-    n = snprintf(s, sizeof(s), "%s", Y4M_FRAME_MAGIC);
+    n = snprintf(s, maxn, "%s", Y4M_FRAME_MAGIC);
   }
   
   if ((n < 0) || (n > Y4M_LINE_MAX)) return Y4M_ERR_HEADER;
-  if ((err = y4m_snprint_xtags(s + n, sizeof(s) - n - 1, &(fi->x_tags))) 
-      != Y4M_OK) 
+  if (y4m_stats_begin() != 0.0)
+    return y4m_stats_snprint_xtags(s + n, maxn - n - 1, &(fi->x_tags));
+  return y4m_snprint_xtags(s + n, maxn - n - 1, &(fi->x_tags));
+}
+
+int y4m_write_frame_header_cb(y4m_cb_writer_t * fd,
+			   const y4m_stream_info_t *si,
+			   const y4m_frame_info_t *fi)
+{
+  char s[Y4M_LINE_MAX+1];
+  int err;
+
+  if ((err = y4m_snprint_frame_header(s, si, fi)) != Y4M_OK)
     return err;
   /* non-zero on error */
   return (y4m_write_cb(fd, s, strlen(s)) ? Y4M_ERR_SYSTEM : Y4M_OK);
@@ -984,9 +2259,8 @@ int y4m_read_frame_data_cb(y4m_cb_reader_t * fd, const y4m_stream_info_t *si,
   
   /* Read each plane */
   for (p = 0; p < planes; p++) {
-    int w = y4m_si_get_plane_width(si, p);
-    int h = y4m_si_get_plane_height(si, p);
-    if (y4m_read_cb(fd, frame[p], w*h)) return Y4M_ERR_SYSTEM;
+    if (y4m_read_cb(fd, frame[p], y4m_si_get_plane_length(si, p)))
+      return Y4M_ERR_SYSTEM;
   }
   return Y4M_OK;
 }
@@ -1030,19 +2304,176 @@ int y4m_write_frame_cb(y4m_cb_writer_t * fd, const y4m_stream_info_t *si,
   if ((err = y4m_write_frame_header_cb(fd, si, fi)) != Y4M_OK) return err;
   /* Write each plane */
   for (p = 0; p < planes; p++) {
-    int w = y4m_si_get_plane_width(si, p);
-    int h = y4m_si_get_plane_height(si, p);
-    if (y4m_write_cb(fd, frame[p], w*h)) return Y4M_ERR_SYSTEM;
+    if (y4m_write_cb(fd, frame[p], y4m_si_get_plane_length(si, p)))
+      return Y4M_ERR_SYSTEM;
   }
   return Y4M_OK;
 }
 
+/* The header and planes of a frame go out in a single writev(2) */
 int y4m_write_frame(int fd, const y4m_stream_info_t *si, 
 		    const y4m_frame_info_t *fi, uint8_t * const *frame)
 {
-  y4m_cb_writer_t w;
-  set_cb_writer_from_fd(&w, &fd);
-  return y4m_write_frame_cb(&w, si, fi, frame);
+  char s[Y4M_LINE_MAX+1];
+  struct iovec iov[1 + Y4M_MAX_NUM_PLANES];
+  struct iovec *v = iov;
+  int planes = y4m_si_get_plane_count(si);
+  int err, p, n;
+  ssize_t done;
+  double t0;
+#ifdef Y4M_SHM_TRANSPORT
+  y4m_shm_t *shm;
+  uint8_t *slot_data;
+  int slot;
+#endif
+
+  if ((err = y4m_snprint_frame_header(s, si, fi)) != Y4M_OK)
+    return err;
+#ifdef Y4M_SHM_TRANSPORT
+  /* Only the header goes down the pipe if the data fits in a free slot */
+  n = strlen(s);
+  if ((shm = y4m_shm_writer(fd)) != NULL && y4m_shm_ready(fd, shm) &&
+      (size_t)y4m_si_get_framelength(si) <= shm->slot_size &&
+      n + sizeof(Y4M_SHM_SLOT_TAG) + 4 <= sizeof(s) &&
+      (slot = y4m_shm_acquire(shm, fd)) >= 0) {
+    slot_data = shm->slots + slot * shm->slot_size;
+    for (p = 0; p < planes; p++) {
+      memcpy(slot_data, frame[p], y4m_si_get_plane_length(si, p));
+      slot_data += y4m_si_get_plane_length(si, p);
+    }
+    shm->ctl->full[slot] = 1;
+    __sync_synchronize();
+    snprintf(s + n - 1, sizeof(s) - n + 1, " %s%d\n", Y4M_SHM_SLOT_TAG, slot);
+    if (y4m_write(fd, s, strlen(s)) == 0)
+      return Y4M_OK;
+    y4m_shm_release(shm, slot);
+    return Y4M_ERR_SYSTEM;
+  }
+#endif
+  iov[0].iov_base = s;
+  iov[0].iov_len = strlen(s);
+  for (p = 0; p < planes; p++) {
+    iov[1+p].iov_base = frame[p];
+    iov[1+p].iov_len = y4m_si_get_plane_length(si, p);
+  }
+  n = 1 + planes;
+  while (n > 0) {
+    t0 = y4m_stats_begin();
+    done = writev(fd, v, n);
+    y4m_stats_end(t0, &_y4m_stats.write_wait);
+    if (done < 0 && errno == EINTR)
+      continue;
+    if (done <= 0)
+      return Y4M_ERR_SYSTEM;
+    /* skip what was written, resume partway into a buffer */
+    while (n > 0 && (size_t)done >= v->iov_len) {
+      done -= v->iov_len;
+      v++;
+      n--;
+    }
+    if (n > 0) {
+      v->iov_base = (uint8_t *)v->iov_base + done;
+      v->iov_len -= done;
+    }
+  }
+  return Y4M_OK;
+}
+
+
+/*************************************************************************
+ *
+ * Borrowed and allocated frames
+ *
+ *************************************************************************/
+
+/* Point planes[] at the consecutive planes of a frame starting at base */
+static void y4m_set_frame_planes(const y4m_stream_info_t *si, uint8_t *base,
+                                 uint8_t **planes)
+{
+  int p;
+
+  for (p = 0; p < y4m_si_get_plane_count(si); p++) {
+    planes[p] = base;
+    base += y4m_si_get_plane_length(si, p);
+  }
+}
+
+int y4m_borrow_frame(int fd, const y4m_stream_info_t *si,
+                     y4m_frame_info_t *fi, uint8_t **planes)
+{
+  y4m_cb_reader_t cb;
+  y4m_reader_t *r;
+  y4m_frame_block_t *b;
+  size_t len = y4m_si_get_framelength(si);
+  int err;
+#ifdef Y4M_SHM_TRANSPORT
+  int lend;
+#endif
+
+  set_cb_reader_from_fd(&cb, &fd);
+  if ((err = y4m_read_frame_header_cb(&cb, si, fi)) != Y4M_OK)
+    return err;
+  /* A frame already complete in the read buffer is lent in place */
+  if (cb.read == y4m_reader_read) {
+    r = (y4m_reader_t *)cb.data;
+#ifdef Y4M_SHM_TRANSPORT
+    /* as is one in a slot of the ring, unless that leaves the writer
+       short of slots */
+    y4m_lock();
+    lend = r->slot_left == len && r->shm->lent + 2 < r->shm->nslots;
+    if (lend)
+      r->shm->lent++;
+    y4m_unlock();
+    if (lend) {
+      y4m_set_frame_planes(si, r->slot_data, planes);
+      r->slot_left = 0;
+      return Y4M_OK;
+    }
+#endif
+    if (r->slot_left == 0 && r->len - r->pos >= len) {
+      y4m_frame_block_ref(r->block);
+      y4m_set_frame_planes(si, r->buf + r->pos, planes);
+      r->pos += len;
+      return Y4M_OK;
+    }
+  }
+  /* Otherwise it is read into a block of its own */
+  if ((b = y4m_frame_block_get(len)) == NULL)
+    return Y4M_ERR_SYSTEM;
+  if (y4m_read_cb(&cb, b->data, len)) {
+    y4m_frame_block_unref(b, 0);
+    return Y4M_ERR_SYSTEM;
+  }
+  y4m_set_frame_planes(si, b->data, planes);
+  return Y4M_OK;
+}
+
+int y4m_alloc_frame(const y4m_stream_info_t *si, uint8_t **planes)
+{
+  y4m_frame_block_t *b = y4m_frame_block_get(y4m_si_get_framelength(si));
+
+  if (b == NULL)
+    return Y4M_ERR_SYSTEM;
+  y4m_set_frame_planes(si, b->data, planes);
+  return Y4M_OK;
+}
+
+void y4m_release_frame(uint8_t * const *planes)
+{
+#ifdef Y4M_SHM_TRANSPORT
+  y4m_shm_t *shm;
+#endif
+
+  if (y4m_frame_block_release(planes[0]))
+    return;
+#ifdef Y4M_SHM_TRANSPORT
+  y4m_lock();
+  if ((shm = y4m_shm_find(planes[0])) != NULL)
+    shm->lent--;
+  y4m_unlock();
+  if (shm != NULL)
+    y4m_shm_release(shm, (planes[0] - shm->slots) / shm->slot_size);
+#endif
 }
 
 /*************************************************************************
@@ -1060,19 +2491,21 @@ int y4m_read_fields_data_cb(y4m_cb_reader_t * fd, const y4m_stream_info_t *si,
   int p;
   int planes = y4m_si_get_plane_count(si);
   const int maxrbuf=32*1024;
-  uint8_t *rbuf=_y4m_alloc(maxrbuf);
+  uint8_t rbuf[32*1024];
   int rbufpos=0,rbuflen=0;
+  /* A buffered reader hands out lines straight from its buffer */
+  int direct = (fd->read == y4m_reader_read);
   
   /* Read each plane */
   for (p = 0; p < planes; p++) {
     uint8_t *dsttop = upper_field[p];
     uint8_t *dstbot = lower_field[p];
     int height = y4m_si_get_plane_height(si, p);
-    int width = y4m_si_get_plane_width(si, p);
+    int width = y4m_si_get_plane_width(si, p) * y4m_si_get_sample_size(si);
     int y;
     /* alternately read one line into each field */
     for (y = 0; y < height; y += 2) {
-      if( width*2 >= maxrbuf ) {
+      if( direct || width*2 >= maxrbuf ) {
         if (y4m_read_cb(fd, dsttop, width)) goto y4merr;
         if (y4m_read_cb(fd, dstbot, width)) goto y4merr;
       } else {
@@ -1092,11 +2525,9 @@ int y4m_read_fields_data_cb(y4m_cb_reader_t * fd, const y4m_stream_info_t *si,
       dstbot+=width;
     }
   }
-  _y4m_free(rbuf);
   return Y4M_OK;
 
  y4merr:
-  _y4m_free(rbuf);
   return Y4M_ERR_SYSTEM;
 }
 
@@ -1150,7 +2581,7 @@ int y4m_write_fields_cb(y4m_cb_writer_t * fd, const y4m_stream_info_t *si,
     uint8_t *srctop = upper_field[p];
     uint8_t *srcbot = lower_field[p];
     int height = y4m_si_get_plane_height(si, p);
-    int width = y4m_si_get_plane_width(si, p);
+    int width = y4m_si_get_plane_width(si, p) * y4m_si_get_sample_size(si);
     int y;
     /* alternately write one line from each field */
     for (y = 0; y < height; y += 2) {
@@ -1224,6 +2655,9 @@ void y4m_log_stream_info(log_level_t level, const char *prefix,
     if (desc == NULL) desc = "unknown!";
     mjpeg_log(level, "%s      chroma:  %s", prefix, desc);
   }
+  if (i->bitdepth != 8)
+    mjpeg_log(level, "%s   bit depth:  %d bits per sample", prefix,
+	      i->bitdepth);
   if ((i->framerate.n == 0) && (i->framerate.d == 0))
     mjpeg_log(level, "%s  frame rate:  ??? fps", prefix);
   else
@@ -303,8 +303,14 @@ void y4m_si_set_sampleaspect(y4m_stream_info_t *si, y4m_ratio_t sar);
 /*      level 1                   */
 void y4m_si_set_chroma(y4m_stream_info_t *si, int chroma_mode);
 int y4m_si_get_chroma(const y4m_stream_info_t *si);
-
-/* derived quantities (no setter) */
+/*      level 2                   */
+void y4m_si_set_bitdepth(y4m_stream_info_t *si, int bitdepth);
+int y4m_si_get_bitdepth(const y4m_stream_info_t *si);
+
+/* derived quantities (no setter)
+    plane width and height are in samples; plane and frame lengths are
+    in bytes, and so are doubled for streams of more than 8 bits per
+    sample (sample size 2)        */
 /*      level 0                   */
 int y4m_si_get_framelength(const y4m_stream_info_t *si);
 /*      level 1                   */
@@ -312,6 +318,8 @@ int y4m_si_get_plane_count(const y4m_stream_info_t *si);
 int y4m_si_get_plane_width(const y4m_stream_info_t *si, int plane);
 int y4m_si_get_plane_height(const y4m_stream_info_t *si, int plane);
 int y4m_si_get_plane_length(const y4m_stream_info_t *si, int plane);
+/*      level 2                   */
+int y4m_si_get_sample_size(const y4m_stream_info_t *si);
 
 
 /* access stream_info xtag_list */
@@ -357,7 +365,10 @@ y4m_xtag_list_t *y4m_fi_xtags(y4m_frame_info_t *fi);
  *
  ************************************************************************/
 
-/* read len bytes from fd into buf */
+/* read len bytes from fd into buf
+   (this includes any bytes the library has already read ahead from fd
+    while parsing headers, so use it rather than read(2) to fetch raw
+    data from a stream also read with the y4m_read_*() functions) */
 ssize_t y4m_read(int fd, void *buf, size_t len);
 
 /* write len bytes from fd into buf */
@@ -546,6 +557,41 @@ int y4m_read_fields_cb(y4m_cb_reader_t * fd, const y4m_stream_info_t *si,
                        uint8_t * const *upper_field, 
                        uint8_t * const *lower_field);
 
+/************************************************************************
+ *  borrowed and allocated frames
+ *
+ *  Instead of copying each frame into buffers of its own, a filter can
+ *  borrow it from the reader of file descriptor fd: planes[] is set to
+ *  point at the frame data where the library holds it, normally inside
+ *  the read-ahead buffer of fd.  Frames not entirely buffered are read
+ *  into a separate block (directly, for the bulk of large frames).
+ *  The planes of a frame are consecutive in memory, in plane order.
+ *
+ *  A borrowed frame remains valid, and can be modified in place or
+ *  passed unchanged to y4m_write_frame(), until it is handed back with
+ *  y4m_release_frame(); any number of frames may be borrowed at once.
+ *  y4m_alloc_frame() provides writable planes for an output frame
+ *  from the same pool of blocks; release them the same way.
+ *
+ *  o these functions return Y4M_OK / Y4M_ERR_*, as above
+ *  o only the fd based API is covered: with buffered reads disabled
+ *     (see y4m_buffered_reads()) every frame is read into a block
+ ************************************************************************/
+
+/* read a frame header from file descriptor fd and borrow its data
+   o planes[] receives 1-4 pointers, one for each image plane */
+int y4m_borrow_frame(int fd, const y4m_stream_info_t *si,
+                     y4m_frame_info_t *fi, uint8_t **planes);
+
+/* allocate planes for a frame described by si
+   o planes[] receives 1-4 pointers, one for each image plane */
+int y4m_alloc_frame(const y4m_stream_info_t *si, uint8_t **planes);
+
+/* release a frame from y4m_borrow_frame() or y4m_alloc_frame()
+   o may be called from any thread, not just the one that read it */
+void y4m_release_frame(uint8_t * const *planes);
+
+
 /************************************************************************
  *  miscellaneous functions
  ************************************************************************/
@@ -575,6 +621,7 @@ int y4m_allow_unknown_tags(int yn);
                    when reading or writing a stream which exceeds it.
     o level = 1:  allow reading/writing streams which contain non-420jpeg
                    chroma and/or mixed-mode interlacing
+    o level = 2:  also allow streams with more than 8 bits per sample
     o level = -1: don't change, just return current setting
 
    return value:  previous setting of level
@@ -582,6 +629,55 @@ int y4m_allow_unknown_tags(int yn);
 int y4m_accept_extensions(int level);
 
 
+/* set 'buffered_reads' flag for library...
+    o yn = 1 :  default - the fd based read functions keep a read-ahead
+                 buffer per file descriptor, so header lines are parsed
+                 without a read(2) per byte
+    o yn = 0 :  read file descriptors unbuffered, exactly as far as
+                 needed; for applications that read(2) the stream
+                 themselves between y4m_read_*() calls
+    o yn = -1:  don't change, just return current setting
+
+   return value:  previous setting of flag
+*/
+int y4m_buffered_reads(int yn);
+
+
+/* set 'shm_transport' flag for library...
+    o yn = 1 :  default (unless the environment variable MJPEG_Y4M_SHM
+                 is set to 0) - a stream header written to a pipe with
+                 y4m_write_stream_header() offers the reader a POSIX shared
+                 memory ring; if the reader accepts, y4m_write_frame()
+                 passes frame data through the ring and only the frame
+                 headers through the pipe.  Readers using the fd based
+                 API (with buffered reads) accept such offers.  The
+                 writer does not wait for the answer: frames are sent
+                 through the pipe until the reader has accepted, and
+                 always if it does not.
+    o yn = 0 :  always send frames through the pipe
+    o yn = -1:  don't change, just return current setting
+
+   return value:  previous setting of flag
+*/
+int y4m_shm_transport(int yn);
+
+
+/* set 'stats' interval for library...
+    o n > 0 :  every n seconds, log (at info level) the frames this
+                process read and wrote, the share of time it was blocked
+                reading and writing streams, and the throughput and
+                latency of each stage upstream of it; frames are stamped
+                with XY4MT= tags as they are read and written, so that
+                the last stage of a pipeline sees those of all before it
+    o n = 0 :  default (unless the environment variable MJPEG_Y4M_STATS
+                is set to a number of seconds) - no statistics, no stamps
+    o n = -1:  don't change, just return current setting
+
+   return value:  previous setting
+*/
+int y4m_stats(int n);
+
+
 END_CDECLS
 
 
@@ -639,6 +735,10 @@ END_CDECLS
            444       - non-subsampled Y'CbCr
 	   444alpha  - Y'CbCr with alpha channel (with Y' black/white point)
            mono      - Y' plane only
+           420pN, 422pN, 444pN, monoN
+                     - as 420jpeg, 422, 444 and mono, but N (9..16) bits
+                       per sample, each stored as two bytes, least
+                       significant byte first (level 2 extension)
      I - [char] interlacing:  p - progressive (none)
                               t - top-field-first
                               b - bottom-field-first
@@ -725,6 +825,7 @@ struct _y4m_stream_info {
   y4m_ratio_t Y4MPRIVATIZE(framerate);    /* see Y4M_FPS_* definitions    */
   y4m_ratio_t Y4MPRIVATIZE(sampleaspect); /* see Y4M_SAR_* definitions    */
   int Y4MPRIVATIZE(chroma);               /* see Y4M_CHROMA_* definitions */
+  int Y4MPRIVATIZE(bitdepth);             /* bits per sample, 8..16       */
 
   /* mystical X tags */
   y4m_xtag_list_t Y4MPRIVATIZE(x_tags);
@@ -13,6 +13,10 @@
 // An allocator for small classes.  It gets large chunks from the
 // standard memory allocator & divides it up.  It's able to handle
 // several different object sizes at once.
+//
+// Once every object has been deallocated (e.g. at the end of a frame),
+// the chunks are handed out again from the start, instead of being
+// given back to the standard memory allocator.
 template <size_t SIZES>
 class Allocator
 {
@@ -36,6 +40,11 @@ public:
 	uint32_t GetNumAllocated (void) const { return m_ulAllocated; }
 		// Get the number of allocated blocks.
 
+	void Reset (void);
+		// Start handing out our chunks from the beginning again.
+		// Only safe if there are no live allocations.
+		// (Called automatically when the last block is deallocated.)
+
 private:
 	// One chunk of memory.
 	class Chunk
@@ -43,7 +52,7 @@ private:
 	public:
 		Chunk *m_pNext;
 			// The next allocated chunk.
-		char *m_aSpace;
+		char m_aSpace[];
 			// The memory to divide up.
 	};
 
@@ -51,11 +60,14 @@ private:
 		// The size of allocated chunks.  Set by the constructor.
 
 	Chunk *m_pChunks;
-		// A linked-list of all the allocated chunks.
+		// A linked-list of all the allocated chunks, in the order
+		// they're handed out.
+
+	Chunk *m_pCurrentChunk;
+		// The chunk being handed out now.
 
 	char *m_pFreeChunk;
-		// The next piece of unallocated memory in the
-		// most-recently-allocated chunk.
+		// The next piece of unallocated memory in the current chunk.
 
 	void *m_apFree[SIZES];
 		// Linked lists of freed pieces of memory, for all the sizes we
@@ -83,7 +95,7 @@ private:
 // time from the standard memory allocator.
 template <size_t SIZES>
 Allocator<SIZES>::Allocator (size_t a_nChunkSize)
-	: m_pChunks (NULL), m_pFreeChunk (NULL)
+	: m_pChunks (NULL), m_pCurrentChunk (NULL), m_pFreeChunk (NULL)
 {
 	// Round our chunk size up to the nearest pointer size.
 	m_nChunkSize = ((a_nChunkSize + sizeof (Chunk *) - 1)
@@ -174,7 +186,7 @@ Allocator<SIZES>::Allocate (size_t a_nSize, size_t a_nBytes)
 	// If there's enough unallocated space in the current chunk,
 	// use it.
 	if (m_pFreeChunk != NULL
-	&& size_t (m_pFreeChunk - ((char *)m_pChunks))
+	&& size_t (m_pFreeChunk - ((char *)m_pCurrentChunk))
 		<= m_nChunkSize - a_nBytes)
 	{
 		// Remember the allocated memory.
@@ -198,7 +210,12 @@ Allocator<SIZES>::Allocate (size_t a_nSize, size_t a_nBytes)
 	// (Not currently possible, unless we make m_aiSizes[] a non-debug
 	// thing.)
 
-	// Add a new chunk to our list.
+	// If a chunk allocated before the last reset is left, use it.
+	if (m_pCurrentChunk != NULL && m_pCurrentChunk->m_pNext != NULL)
+		m_pCurrentChunk = m_pCurrentChunk->m_pNext;
+
+	// Otherwise, add a new chunk to the end of our list.
+	else
 	{
 		// Allocate a new chunk.
 		Chunk *pNewChunk = (Chunk *) malloc (m_nChunkSize);
@@ -206,18 +223,22 @@ Allocator<SIZES>::Allocate (size_t a_nSize, size_t a_nBytes)
 			return NULL;
 
 		// Hook it into our list.
-		pNewChunk->m_pNext = m_pChunks;
-		m_pChunks = pNewChunk;
+		pNewChunk->m_pNext = NULL;
+		if (m_pCurrentChunk == NULL)
+			m_pChunks = pNewChunk;
+		else
+			m_pCurrentChunk->m_pNext = pNewChunk;
+		m_pCurrentChunk = pNewChunk;
 	}
 
 	// The unallocated portion of the new chunk is here.
-	m_pFreeChunk = m_pChunks->m_aSpace + a_nBytes;
+	m_pFreeChunk = m_pCurrentChunk->m_aSpace + a_nBytes;
 
 	// That's one more allocation.
 	++m_ulAllocated;
 
 	// Return the allocated memory.
-	return (void *) (&(m_pChunks->m_aSpace));
+	return (void *) (m_pCurrentChunk->m_aSpace);
 }
 
 
@@ -238,17 +259,17 @@ Allocator<SIZES>::Deallocate (size_t a_nSize, size_t /* a_nBytes */,
 	// That's one less allocation.
 	--m_ulAllocated;
 
-	// If all memory is unallocated, free up our chunks & start over.
+	// If all memory is unallocated, start over.
 	if (m_ulAllocated == 0UL)
-		Purge();
+		Reset();
 }
 
 
 
-// Free up all chunks.
+// Start handing out our chunks from the beginning again.
 template <size_t SIZES>
 void
-Allocator<SIZES>::Purge (void)
+Allocator<SIZES>::Reset (void)
 {
 	// Make sure there are no live allocations
 	assert (m_ulAllocated == 0UL);
@@ -256,7 +277,21 @@ Allocator<SIZES>::Purge (void)
 	// Empty the free-space list.
 	for (size_t i = 0; i < SIZES; ++i)
 		m_apFree[i] = NULL;
-	m_pFreeChunk = NULL;
+
+	// Hand out the first chunk again.
+	m_pCurrentChunk = m_pChunks;
+	m_pFreeChunk = (m_pChunks == NULL) ? NULL : m_pChunks->m_aSpace;
+}
+
+
+
+// Free up all chunks.
+template <size_t SIZES>
+void
+Allocator<SIZES>::Purge (void)
+{
+	// Make sure there are no live allocations
+	assert (m_ulAllocated == 0UL);
 
 	// Free all allocated chunks.
 	while (m_pChunks != NULL)
@@ -270,6 +305,9 @@ Allocator<SIZES>::Purge (void)
 		// Move to the next chunk.
 		m_pChunks = pNextChunk;
 	}
+
+	// Now there's nothing to hand out.
+	Reset();
 }
 
 
@@ -0,0 +1,382 @@
+#ifndef __ARENAALLOCATOR_H__
+#define __ARENAALLOCATOR_H__
+
+// This file (C) 2009 Steven Boswell.  All rights reserved.
+// Released to the public under the GNU General Public License v2.
+// See the file COPYING for more information.
+
+#include "config.h"
+#include "mjpeg_types.h"
+#include <assert.h>
+#include <stdlib.h>
+#include "Status_t.h"
+#include "Limits.hh"
+
+
+
+// An allocator for variable-sized blocks of memory that are all freed
+// by the end of a frame.  It gets large chunks from the standard memory
+// allocator & hands them out in order, i.e. as an arena.
+//
+// Block sizes are rounded up to the next power of two, and freed blocks
+// are kept in one linked list per power of two, so that memory freed in
+// the middle of a frame gets reused right away.  Once every block has
+// been freed (i.e. at the end of each frame), the arena is reset in
+// constant time: the free lists are forgotten and the chunks are handed
+// out again from the start.  Chunks are only given back to the standard
+// memory allocator when the arena is destroyed, so after the first few
+// frames, no more memory is allocated, and the peak memory use is the
+// most that any one frame needed.
+class ArenaAllocator
+{
+public:
+	ArenaAllocator (size_t a_nChunkSize);
+		// Constructor.  Specify the number of bytes to allocate at a
+		// time from the standard memory allocator.
+
+	void Init (Status_t &a_reStatus);
+		// Construction method.
+
+	~ArenaAllocator();
+		// Destructor.
+
+	void *Allocate (size_t a_nSize, size_t a_nBytes);
+		// Allocate memory for another object.
+		// Use the given size-bucket, which must be for the given number
+		// of bytes.
+		// Returns NULL if memory is exhausted.
+
+	void Deallocate (size_t a_nSize, size_t a_nBytes, void *a_pMemory);
+		// Deallocate previously-allocated memory.
+
+	uint32_t GetNumAllocated (void) const { return m_ulAllocated; }
+		// Get the number of allocated blocks.
+
+	void Reset (void);
+		// Start handing out the arena from the beginning again.
+		// Only safe if there are no live allocations.
+		// (Called automatically when the last block is deallocated.)
+
+private:
+	// One chunk of memory.
+	class Chunk
+	{
+	public:
+		Chunk *m_pNext;
+			// The next allocated chunk.
+		size_t m_nBytes;
+			// The size of m_aSpace.
+		char m_aSpace[];
+			// The memory to divide up.
+	};
+
+	enum { kBuckets = 8 * sizeof (size_t) };
+		// The number of block sizes, i.e. powers of two, we manage.
+
+	size_t m_nChunkSize;
+		// The size of all allocated chunks (unless a particular request is
+		// over this size).  Set by the constructor.
+
+	Chunk *m_pChunks;
+		// A linked-list of all the allocated chunks, in the order
+		// they're handed out.
+
+	Chunk *m_pCurrentChunk;
+		// The chunk being handed out now.
+
+	char *m_pFreeChunk;
+	size_t m_nFreeChunk;
+		// The next piece of unallocated memory in the current chunk.
+
+	void *m_apFree[kBuckets];
+		// Linked lists of freed pieces of memory, for all the sizes we
+		// manage.
+
+	uint32_t m_ulAllocated;
+		// The number of live allocations, i.e. those that haven't been
+		// deleted yet.
+
+	static size_t GetBucket (size_t a_nBytes);
+		// Get the bucket for blocks of the given size, i.e. the
+		// smallest bucket whose blocks are at least that big.
+
+	void FreeRestOfChunk (void);
+		// Put the rest of the current chunk into the free lists.
+
+	bool NextChunk (size_t a_nBytes);
+		// Move to the next chunk that can hold the given number of
+		// bytes, allocating it if necessary.
+		// Returns false if memory is exhausted.
+
+	void Purge (void);
+		// Free up all chunks.
+		// Only safe if there are no live allocations.
+};
+
+
+
+// Constructor.  Specify the number of bytes to allocate at a
+// time from the standard memory allocator.
+ArenaAllocator::ArenaAllocator (size_t a_nChunkSize)
+	: m_nChunkSize (a_nChunkSize), m_pChunks (NULL),
+	m_pCurrentChunk (NULL), m_pFreeChunk (NULL), m_nFreeChunk (0),
+	m_ulAllocated (0UL)
+{
+	// All our buckets are empty.
+	for (size_t i = 0; i < kBuckets; ++i)
+		m_apFree[i] = NULL;
+}
+
+
+
+// Construction method.
+void
+ArenaAllocator::Init (Status_t &a_reStatus)
+{
+	// Make sure they didn't start us off with an error.
+	assert (a_reStatus == g_kNoError);
+
+	// Nothing else to do; chunks are allocated on demand.
+}
+
+
+
+// Destructor.
+ArenaAllocator::~ArenaAllocator()
+{
+	// If all allocated objects were deallocated, go ahead and free
+	// up our memory.  (If there are any allocated objects left, then
+	// generally, that means this is a global allocator, and since C++
+	// doesn't guarantee order of destruction for global objects, we
+	// have no guarantee our clients have been destroyed, and so it
+	// isn't safe to delete our memory.)
+	if (m_ulAllocated == 0UL)
+		Purge();
+}
+
+
+
+// Allocate memory for another object.
+// Use the given size-bucket, which must be for the given number
+// of bytes.
+// Returns NULL if memory is exhausted.
+void *
+ArenaAllocator::Allocate (size_t a_nSize, size_t a_nBytes)
+{
+	void *pAlloc;
+		// The memory we allocate.
+
+	// Make sure they gave us a valid size.
+	// (This allocator has only one bucket, as far as clients know.)
+	assert (a_nSize == 0);
+
+	// Find the power of two that holds this many bytes.
+	size_t nBucket = GetBucket (a_nBytes);
+	a_nBytes = sizeof (void *) << nBucket;
+
+	// If there's a free piece of memory of this size, return it.
+	if (m_apFree[nBucket] != NULL)
+	{
+		// Remember the allocated memory.
+		pAlloc = m_apFree[nBucket];
+
+		// Remove it from our list.
+		m_apFree[nBucket] = *(void **)pAlloc;
+
+		// That's one more allocation.
+		++m_ulAllocated;
+
+		// Return the allocated memory.
+		return pAlloc;
+	}
+
+	// If there isn't enough unallocated space in the current chunk,
+	// move on to the next one.
+	if (m_nFreeChunk < a_nBytes && !NextChunk (a_nBytes))
+		return NULL;
+
+	// Allocate the next piece of the current chunk.
+	pAlloc = (void *) m_pFreeChunk;
+	m_pFreeChunk += a_nBytes;
+	m_nFreeChunk -= a_nBytes;
+
+	// That's one more allocation.
+	++m_ulAllocated;
+
+	// Return the allocated memory.
+	return pAlloc;
+}
+
+
+
+// Deallocate previously-allocated memory.
+void
+ArenaAllocator::Deallocate (size_t a_nSize, size_t a_nBytes,
+	void *a_pMemory)
+{
+	// Make sure they gave us a valid size.
+	// (This allocator has only one bucket, as far as clients know.)
+	assert (a_nSize == 0);
+
+	// Put this memory into the bucket for its size.
+	size_t nBucket = GetBucket (a_nBytes);
+	*(void **)a_pMemory = m_apFree[nBucket];
+	m_apFree[nBucket] = a_pMemory;
+
+	// That's one less allocation.
+	assert (m_ulAllocated > 0UL);
+	--m_ulAllocated;
+
+	// If all memory is unallocated, start over.
+	if (m_ulAllocated == 0UL)
+		Reset();
+}
+
+
+
+// Start handing out the arena from the beginning again.
+// Only safe if there are no live allocations.
+void
+ArenaAllocator::Reset (void)
+{
+	// Make sure there are no live allocations
+	assert (m_ulAllocated == 0UL);
+
+	// Forget about all freed memory.
+	for (size_t i = 0; i < kBuckets; ++i)
+		m_apFree[i] = NULL;
+
+	// Hand out the first chunk again.
+	m_pCurrentChunk = m_pChunks;
+	if (m_pCurrentChunk == NULL)
+	{
+		m_pFreeChunk = NULL;
+		m_nFreeChunk = 0;
+	}
+	else
+	{
+		m_pFreeChunk = m_pCurrentChunk->m_aSpace;
+		m_nFreeChunk = m_pCurrentChunk->m_nBytes;
+	}
+}
+
+
+
+// Get the bucket for blocks of the given size, i.e. the
+// smallest bucket whose blocks are at least that big.
+size_t
+ArenaAllocator::GetBucket (size_t a_nBytes)
+{
+	size_t nBucket = 0;
+	size_t nBlockBytes = sizeof (void *);
+	while (nBlockBytes < a_nBytes)
+	{
+		nBlockBytes <<= 1;
+		++nBucket;
+	}
+	assert (nBucket < kBuckets);
+	return nBucket;
+}
+
+
+
+// Put the rest of the current chunk into the free lists.
+void
+ArenaAllocator::FreeRestOfChunk (void)
+{
+	// Carve the rest of the chunk into the biggest blocks that fit.
+	// (Every block size is a multiple of the pointer size, so there's
+	// never anything left over.)
+	while (m_nFreeChunk >= sizeof (void *))
+	{
+		size_t nBucket = GetBucket (m_nFreeChunk);
+		if ((sizeof (void *) << nBucket) > m_nFreeChunk)
+			--nBucket;
+		size_t nBlockBytes = sizeof (void *) << nBucket;
+
+		*(void **)m_pFreeChunk = m_apFree[nBucket];
+		m_apFree[nBucket] = (void *) m_pFreeChunk;
+		m_pFreeChunk += nBlockBytes;
+		m_nFreeChunk -= nBlockBytes;
+	}
+
+	// Now there's no more free chunk.
+	m_pFreeChunk = NULL;
+	m_nFreeChunk = 0;
+}
+
+
+
+// Move to the next chunk that can hold the given number of
+// bytes, allocating it if necessary.
+// Returns false if memory is exhausted.
+bool
+ArenaAllocator::NextChunk (size_t a_nBytes)
+{
+	// Don't waste the rest of the current chunk.
+	FreeRestOfChunk();
+
+	// Look for a chunk, allocated during a previous frame, that's big
+	// enough.  (Those that are too small are put into the free lists.)
+	while (m_pCurrentChunk != NULL && m_pCurrentChunk->m_pNext != NULL)
+	{
+		m_pCurrentChunk = m_pCurrentChunk->m_pNext;
+		m_pFreeChunk = m_pCurrentChunk->m_aSpace;
+		m_nFreeChunk = m_pCurrentChunk->m_nBytes;
+		if (m_nFreeChunk >= a_nBytes)
+			return true;
+		FreeRestOfChunk();
+	}
+
+	// Create a new chunk.
+	// Make sure it's big enough to handle this allocation, i.e. in case
+	// it's bigger than the configured chunk size.
+	size_t nBytes = Max (a_nBytes, m_nChunkSize);
+	Chunk *pNewChunk = (Chunk *) malloc (sizeof (Chunk) + nBytes);
+	if (pNewChunk == NULL)
+		return false;
+	pNewChunk->m_pNext = NULL;
+	pNewChunk->m_nBytes = nBytes;
+
+	// Hook it onto the end of our list.
+	if (m_pCurrentChunk == NULL)
+		m_pChunks = pNewChunk;
+	else
+		m_pCurrentChunk->m_pNext = pNewChunk;
+	m_pCurrentChunk = pNewChunk;
+
+	// Hand out the new chunk.
+	m_pFreeChunk = pNewChunk->m_aSpace;
+	m_nFreeChunk = nBytes;
+	return true;
+}
+
+
+
+// Free up all chunks.
+void
+ArenaAllocator::Purge (void)
+{
+	// Make sure there are no live allocations
+	assert (m_ulAllocated == 0UL);
+
+	// Free all allocated chunks.
+	while (m_pChunks != NULL)
+	{
+		// Remember the next chunk.
+		Chunk *pNextChunk = m_pChunks->m_pNext;
+
+		// Free this chunk.
+		free (m_pChunks);
+
+		// Move to the next chunk.
+		m_pChunks = pNextChunk;
+	}
+
+	// Now there's nothing to hand out.
+	Reset();
+}
+
+
+
+#endif // __ARENAALLOCATOR_H__
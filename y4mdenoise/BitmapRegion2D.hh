@@ -26,6 +26,12 @@
 // slower (adding maybe 1% to the runtime).
 //#define DIRECT_BITMAPREGION_SUBTRACT
 
+// Define this to work on the bitmap a word at a time wherever possible,
+// i.e. to set/clear extents with masks instead of bit by bit, to limit
+// whole-region operations to the words in the active area, and to have
+// flood-fills test and add runs of points instead of single points.
+#define WORDWISE_BITMAPREGION
+
 
 
 // Part of BitmapRegion2D<> breaks gcc 2.95.  An earlier arrangement of
@@ -156,6 +162,14 @@ public:
 		// Add the given point to the region.
 		// (Basically a one-point Union().)
 
+	#ifdef WORDWISE_BITMAPREGION
+	void UnionExcept (INDEX a_tnY, INDEX a_tnXStart, INDEX a_tnXEnd,
+			const BitmapRegion2D<INDEX,SIZE> &a_rExcept1,
+			const BitmapRegion2D<INDEX,SIZE> &a_rExcept2);
+		// Add the points of the given horizontal extent that aren't in
+		// either of the other regions.  Used by FloodFill().
+	#endif // WORDWISE_BITMAPREGION
+
 	// A structure that implements flood-fills using BitmapRegion2D<> to
 	// do the work.  (The definition of this class follows the
 	// definition of Region<>.)
@@ -221,6 +235,17 @@ public:
 	void IteratorBackward (ConstIterator &a_ritHere) const;
 		// Move one of our iterators backward.
 
+	#ifdef WORDWISE_BITMAPREGION
+	bool GetActiveWords (SIZE &a_rtnFirst, SIZE &a_rtnLast) const;
+		// Get the index of the first and last bitmap words that
+		// the active area covers.  Returns false if it's empty.
+
+	void SetBits (SIZE a_tnFirst, SIZE a_tnLast);
+	void ClearBits (SIZE a_tnFirst, SIZE a_tnLast);
+		// Set/clear the bitmap's bits from a_tnFirst to a_tnLast
+		// inclusive.
+	#endif // WORDWISE_BITMAPREGION
+
 	static int FindFirstSetBit (unsigned int a_nWord, int a_nSkip);
 	static int FindFirstClearBit (unsigned int a_nWord, int a_nSkip);
 	static int FindLastSetBit (unsigned int a_nWord, int a_nSkip);
@@ -499,10 +524,27 @@ BitmapRegion2D<INDEX,SIZE>::Assign (Status_t &a_reStatus,
 	assert (m_tnWidth == a_rOther.m_tnWidth
 		&& m_tnHeight == a_rOther.m_tnHeight);
 
+	#ifdef WORDWISE_BITMAPREGION
+
+	// If we're being assigned to ourselves, we're done.
+	if (this == &a_rOther)
+		return;
+
+	// Empty ourselves, then copy the other region's active area.
+	Clear();
+	SIZE tnFirst, tnLast;
+	if (a_rOther.GetActiveWords (tnFirst, tnLast))
+		memcpy (m_pnPoints + tnFirst, a_rOther.m_pnPoints + tnFirst,
+			(tnLast - tnFirst + 1) * sizeof (unsigned int));
+
+	#else // WORDWISE_BITMAPREGION
+
 	// Copy the other region's bitmap.
 	memcpy (m_pnPoints, a_rOther.m_pnPoints,
 		m_tnBitmapInts * sizeof (unsigned int));
 
+	#endif // WORDWISE_BITMAPREGION
+
 	// Copy its active area.
 	m_tnXMin = a_rOther.m_tnXMin;
 	m_tnXMax = a_rOther.m_tnXMax;
@@ -560,9 +602,18 @@ BitmapRegion2D<INDEX,SIZE>::NumberOfPoints (void) const
 
 	// Loop through the bitmap's bytes, look up how many set bits
 	// there are in each byte, count them up.
+	#ifdef WORDWISE_BITMAPREGION
+	SIZE tnFirst, tnLast;
+	if (!GetActiveWords (tnFirst, tnLast))
+		return 0;
+	uint8_t *pnPoints = (uint8_t *) (m_pnPoints + tnFirst);
+	tnLimit = (tnLast - tnFirst + 1)
+		* (sizeof (unsigned int) / sizeof (uint8_t));
+	#else // WORDWISE_BITMAPREGION
 	uint8_t *pnPoints = (uint8_t *) m_pnPoints;
 	tnLimit = m_tnBitmapInts
 		* (sizeof (unsigned int) / sizeof (uint8_t));
+	#endif // WORDWISE_BITMAPREGION
 	tnPoints = 0;
 	for (tnI = 0; tnI < tnLimit; ++tnI)
 		tnPoints += m_anSetBitsPerByte[pnPoints[tnI]];
@@ -578,8 +629,15 @@ template <class INDEX, class SIZE>
 void
 BitmapRegion2D<INDEX,SIZE>::Clear (void)
 {
-	// Clear all the bits.
+	// Clear all the bits.  (Only the active area can have any set.)
+	#ifdef WORDWISE_BITMAPREGION
+	SIZE tnFirst, tnLast;
+	if (GetActiveWords (tnFirst, tnLast))
+		memset (m_pnPoints + tnFirst, 0,
+			ARRAYSIZE (unsigned int, tnLast - tnFirst + 1));
+	#else // WORDWISE_BITMAPREGION
 	memset (m_pnPoints, 0, ARRAYSIZE (unsigned int, m_tnBitmapInts));
+	#endif // WORDWISE_BITMAPREGION
 
 	// Reset the active area.
 	m_tnXMin = m_tnWidth;
@@ -621,8 +679,10 @@ BitmapRegion2D<INDEX,SIZE>::Union (INDEX a_tnY, INDEX a_tnXStart,
 {
 	SIZE tnI;
 		// The index of the bitmap integer to modify.
+	#ifndef WORDWISE_BITMAPREGION
 	INDEX tnX;
 		// Used to loop through points.
+	#endif // WORDWISE_BITMAPREGION
 
 	// Make sure they gave us a non-empty extent.
 	assert (a_tnXStart < a_tnXEnd);
@@ -648,6 +708,14 @@ BitmapRegion2D<INDEX,SIZE>::Union (INDEX a_tnY, INDEX a_tnXStart,
 	m_tnYMin = Min (m_tnYMin, a_tnY);
 	m_tnYMax = Max (m_tnYMax, a_tnY);
 
+	#ifdef WORDWISE_BITMAPREGION
+
+	// Set all the points' bits.
+	tnI = SIZE (a_tnY) * SIZE (m_tnWidth);
+	SetBits (tnI + SIZE (a_tnXStart), tnI + SIZE (a_tnXEnd - 1));
+
+	#else // WORDWISE_BITMAPREGION
+
 	// Loop through all the points, set them.
 	for (tnX = a_tnXStart; tnX < a_tnXEnd; ++tnX)
 	{
@@ -657,6 +725,8 @@ BitmapRegion2D<INDEX,SIZE>::Union (INDEX a_tnY, INDEX a_tnXStart,
 			|= (1U << (tnI % (g_knBitsPerByte
 				* sizeof (unsigned int))));
 	}
+
+	#endif // WORDWISE_BITMAPREGION
 }
 
 
@@ -691,8 +761,16 @@ BitmapRegion2D<INDEX,SIZE>::Union (Status_t &a_reStatus,
 		&& m_tnHeight == a_rOther.m_tnHeight);
 
 	// Unify with the other region's bitmap.
+	#ifdef WORDWISE_BITMAPREGION
+	SIZE tnFirst, tnLast;
+	if (!a_rOther.GetActiveWords (tnFirst, tnLast))
+		return;
+	for (SIZE i = tnFirst; i <= tnLast; ++i)
+		m_pnPoints[i] |= a_rOther.m_pnPoints[i];
+	#else // WORDWISE_BITMAPREGION
 	for (SIZE i = 0; i < m_tnBitmapInts; ++i)
 		m_pnPoints[i] |= a_rOther.m_pnPoints[i];
+	#endif // WORDWISE_BITMAPREGION
 
 	// Factor the other region's active area into our own.
 	m_tnXMin = Min (m_tnXMin, a_rOther.m_tnXMin);
@@ -796,8 +874,15 @@ BitmapRegion2D<INDEX,SIZE>::Intersection (Status_t &a_reStatus,
 		&& m_tnHeight == a_rOther.m_tnHeight);
 
 	// Intersect with the other region's bitmap.
+	#ifdef WORDWISE_BITMAPREGION
+	SIZE tnFirst, tnLast;
+	if (GetActiveWords (tnFirst, tnLast))
+		for (SIZE i = tnFirst; i <= tnLast; ++i)
+			m_pnPoints[i] &= a_rOther.m_pnPoints[i];
+	#else // WORDWISE_BITMAPREGION
 	for (SIZE i = 0; i < m_tnBitmapInts; ++i)
 		m_pnPoints[i] &= a_rOther.m_pnPoints[i];
+	#endif // WORDWISE_BITMAPREGION
 
 	// The active area may have shrunk, but we don't recalculate it;
 	// that would take too long.
@@ -813,8 +898,10 @@ BitmapRegion2D<INDEX,SIZE>::Subtract (Status_t &a_reStatus, INDEX a_tnY,
 {
 	SIZE tnI;
 		// The index of the bitmap integer to modify.
+	#ifndef WORDWISE_BITMAPREGION
 	INDEX tnX;
 		// Used to loop through points.
+	#endif // WORDWISE_BITMAPREGION
 
 	// Make sure they didn't start us off with an error.
 	assert (a_reStatus == g_kNoError);
@@ -837,6 +924,14 @@ BitmapRegion2D<INDEX,SIZE>::Subtract (Status_t &a_reStatus, INDEX a_tnY,
 	if (a_tnXEnd > m_tnWidth)
 		a_tnXEnd = m_tnWidth;
 
+	#ifdef WORDWISE_BITMAPREGION
+
+	// Clear all the points' bits.
+	tnI = SIZE (a_tnY) * SIZE (m_tnWidth);
+	ClearBits (tnI + SIZE (a_tnXStart), tnI + SIZE (a_tnXEnd - 1));
+
+	#else // WORDWISE_BITMAPREGION
+
 	// Loop through all the points, clear them.
 	for (tnX = a_tnXStart; tnX < a_tnXEnd; ++tnX)
 	{
@@ -847,6 +942,8 @@ BitmapRegion2D<INDEX,SIZE>::Subtract (Status_t &a_reStatus, INDEX a_tnY,
 				* sizeof (unsigned int)))));
 	}
 
+	#endif // WORDWISE_BITMAPREGION
+
 	// The active area may have shrunk, but we don't recalculate it;
 	// that would take too long.
 }
@@ -1040,6 +1137,11 @@ BitmapRegion2D<INDEX,SIZE>::FloodFill (Status_t &a_reStatus,
 	{
 		INDEX tnX;
 			// Where we're looking for extents.
+		#ifdef WORDWISE_BITMAPREGION
+		typename CONTROL::Extent oLine;
+			// The part of the current line that runs can be followed
+			// into.
+		#endif // WORDWISE_BITMAPREGION
 
 		// Get the extent, converting the type if necessary.
 		typename CONTROL::Extent oExtent;
@@ -1056,6 +1158,116 @@ BitmapRegion2D<INDEX,SIZE>::FloodFill (Status_t &a_reStatus,
 		assert (oExtent.m_tnXStart < oExtent.m_tnXEnd);
 		assert (tnY == oExtent.m_tnY);		// (Sanity check)
 
+		#ifdef WORDWISE_BITMAPREGION
+
+		// We're about to check these points.  Put them in the
+		// already-checked list now.
+		a_rControl.m_oAlreadyDone.Union (tnY, oExtent.m_tnXStart,
+			oExtent.m_tnXEnd);
+
+		// If we're expanding, find the part of this line that runs can
+		// be followed into.  (ShouldUseExtent() clips extents to a
+		// bounding box, so it can tell us that.)
+		oLine.m_tnY = tnY;
+		oLine.m_tnXStart = oLine.m_tnXEnd = 0;
+		if (a_bExpand)
+		{
+			oLine.m_tnXEnd = m_tnWidth;
+			if (!a_rControl.ShouldUseExtent (oLine))
+				oLine.m_tnXStart = oLine.m_tnXEnd = 0;
+		}
+
+		// Run through the pixels described by this extent, find the
+		// runs of them that can be added to the region, and remember
+		// where to search next.
+		for (tnX = oExtent.m_tnXStart; tnX < oExtent.m_tnXEnd; )
+		{
+			// Skip points that aren't in the region.
+			if (!a_rControl.IsPointInRegion (tnX, tnY))
+			{
+				++tnX;
+				continue;
+			}
+
+			// Find the end of this run of points in the region.
+			INDEX tnRunStart = tnX;
+			while (++tnX < oExtent.m_tnXEnd
+					&& a_rControl.IsPointInRegion (tnX, tnY))
+				;
+
+			// If the run reaches either end of the extent, follow it
+			// past there, through points that aren't waiting to be
+			// tested and haven't been tested already.  Otherwise the
+			// flood-fill would only spread one point per pass along
+			// the line, and would spend most of its time iterating
+			// through one-point extents.
+			if (tnRunStart == oExtent.m_tnXStart)
+			{
+				while (tnRunStart > oLine.m_tnXStart
+				&& !a_rControl.m_oToDo.DoesContainPoint
+						(tnY, tnRunStart - 1)
+				&& !a_rControl.m_oAlreadyDone.DoesContainPoint
+						(tnY, tnRunStart - 1)
+				&& !a_rControl.m_oNextToDo.DoesContainPoint
+						(tnY, tnRunStart - 1))
+				{
+					a_rControl.m_oAlreadyDone.SetPoint (tnY,
+						tnRunStart - 1);
+					if (!a_rControl.IsPointInRegion (tnRunStart - 1, tnY))
+						break;
+					--tnRunStart;
+				}
+			}
+			if (tnX == oExtent.m_tnXEnd)
+			{
+				while (tnX < oLine.m_tnXEnd
+				&& !a_rControl.m_oToDo.DoesContainPoint (tnY, tnX)
+				&& !a_rControl.m_oAlreadyDone.DoesContainPoint (tnY, tnX)
+				&& !a_rControl.m_oNextToDo.DoesContainPoint (tnY, tnX))
+				{
+					a_rControl.m_oAlreadyDone.SetPoint (tnY, tnX);
+					if (!a_rControl.IsPointInRegion (tnX, tnY))
+						break;
+					++tnX;
+				}
+			}
+
+			// Add the run to the region.
+			Union (tnY, tnRunStart, tnX);
+
+			// Now add all surrounding points to the to-do-next list.
+			// (Points that are in the to-do list or that have been
+			// checked already are left out.)
+			if (a_bExpand)
+			{
+				// Add the extent above this one.
+				if (tnY > 0)
+					a_rControl.m_oNextToDo.UnionExcept (tnY - 1,
+						tnRunStart, tnX, a_rControl.m_oToDo,
+						a_rControl.m_oAlreadyDone);
+
+				// Add the extent to the left.
+				if (tnRunStart > 0)
+					a_rControl.m_oNextToDo.UnionExcept (tnY,
+						tnRunStart - 1, tnRunStart, a_rControl.m_oToDo,
+						a_rControl.m_oAlreadyDone);
+
+				// Add the extent to the right.
+				if (tnX < m_tnWidth)
+					a_rControl.m_oNextToDo.UnionExcept (tnY,
+						tnX, tnX + 1, a_rControl.m_oToDo,
+						a_rControl.m_oAlreadyDone);
+
+				// Add the extent below this one.
+				if (tnY < m_tnHeight - 1)
+					a_rControl.m_oNextToDo.UnionExcept (tnY + 1,
+						tnRunStart, tnX, a_rControl.m_oToDo,
+						a_rControl.m_oAlreadyDone);
+			}
+		}
+
+		#else // WORDWISE_BITMAPREGION
+
 		// Run through the pixels described by this extent, see if
 		// they can be added to the region, and remember where to
 		// search next.
@@ -1105,6 +1317,8 @@ BitmapRegion2D<INDEX,SIZE>::FloodFill (Status_t &a_reStatus,
 			}
 		}
 
+		#endif // WORDWISE_BITMAPREGION
+
 nextExtent:
 		// Move to the next extent.
 		++itExtent;
@@ -1208,6 +1422,156 @@ BitmapRegion2D<INDEX,SIZE>::UnionSurroundingExtents
 
 
 
+#ifdef WORDWISE_BITMAPREGION
+
+// Add the points of the given horizontal extent that aren't in
+// either of the other regions.
+template <class INDEX, class SIZE>
+void
+BitmapRegion2D<INDEX,SIZE>::UnionExcept (INDEX a_tnY, INDEX a_tnXStart,
+	INDEX a_tnXEnd, const BitmapRegion2D<INDEX,SIZE> &a_rExcept1,
+	const BitmapRegion2D<INDEX,SIZE> &a_rExcept2)
+{
+	SIZE tnWordIndex, tnLastWordIndex;
+		// The range of words to modify.
+	SIZE tnBitIndex, tnLastBitIndex;
+		// The first and last bit to modify.
+	unsigned int nMask;
+		// The bits of the current word that are in the extent.
+	unsigned int nSet;
+		// All the bits that got set.
+
+	// Make sure the regions are the exact same size.
+	assert (m_tnWidth == a_rExcept1.m_tnWidth
+		&& m_tnHeight == a_rExcept1.m_tnHeight);
+	assert (m_tnWidth == a_rExcept2.m_tnWidth
+		&& m_tnHeight == a_rExcept2.m_tnHeight);
+
+	// Make sure they gave us a non-empty extent that's in range.
+	assert (a_tnXStart < a_tnXEnd);
+	assert (a_tnY >= 0 && a_tnY < m_tnHeight);
+	assert (a_tnXStart >= 0 && a_tnXEnd <= m_tnWidth);
+
+	// Find the words and bits that the extent covers.
+	tnBitIndex = SIZE (a_tnY) * SIZE (m_tnWidth) + SIZE (a_tnXStart);
+	tnLastBitIndex = tnBitIndex + SIZE (a_tnXEnd - a_tnXStart - 1);
+	tnWordIndex = tnBitIndex >> Limits<unsigned int>::Log2Bits;
+	tnLastWordIndex = tnLastBitIndex >> Limits<unsigned int>::Log2Bits;
+
+	// Loop through those words, set every bit that's in the extent
+	// but isn't set in either of the other regions.
+	nMask = (~0U) << (tnBitIndex & (Limits<unsigned int>::Bits - 1));
+	nSet = 0U;
+	for (;;)
+	{
+		if (tnWordIndex == tnLastWordIndex)
+			nMask &= (~0U) >> (Limits<unsigned int>::Bits - 1
+				- (tnLastBitIndex & (Limits<unsigned int>::Bits - 1)));
+		unsigned int nBits = nMask & ~(a_rExcept1.m_pnPoints[tnWordIndex]
+			| a_rExcept2.m_pnPoints[tnWordIndex]);
+		m_pnPoints[tnWordIndex] |= nBits;
+		nSet |= nBits;
+		if (tnWordIndex == tnLastWordIndex)
+			break;
+		++tnWordIndex;
+		nMask = ~0U;
+	}
+
+	// If anything got set, factor this extent into the active area.
+	// (It may be a little bigger than what got set, but that's fine.)
+	if (nSet != 0U)
+	{
+		m_tnXMin = Min (m_tnXMin, a_tnXStart);
+		m_tnXMax = Max (m_tnXMax, a_tnXEnd);
+		m_tnYMin = Min (m_tnYMin, a_tnY);
+		m_tnYMax = Max (m_tnYMax, a_tnY);
+	}
+}
+
+
+
+// Get the index of the first and last bitmap words that the active
+// area covers.
+template <class INDEX, class SIZE>
+bool
+BitmapRegion2D<INDEX,SIZE>::GetActiveWords (SIZE &a_rtnFirst,
+	SIZE &a_rtnLast) const
+{
+	// If the active area is empty, let our caller know.
+	if (m_tnXMin >= m_tnXMax || m_tnYMin > m_tnYMax)
+		return false;
+
+	// Every set bit is between the start of the active area on its
+	// first line and the end of it on its last line.
+	a_rtnFirst = (SIZE (m_tnYMin) * SIZE (m_tnWidth) + SIZE (m_tnXMin))
+		>> Limits<unsigned int>::Log2Bits;
+	a_rtnLast = (SIZE (m_tnYMax) * SIZE (m_tnWidth)
+		+ SIZE (m_tnXMax - INDEX (1))) >> Limits<unsigned int>::Log2Bits;
+	return true;
+}
+
+
+
+// Set the bitmap's bits from a_tnFirst to a_tnLast inclusive.
+template <class INDEX, class SIZE>
+void
+BitmapRegion2D<INDEX,SIZE>::SetBits (SIZE a_tnFirst, SIZE a_tnLast)
+{
+	SIZE tnWordIndex = a_tnFirst >> Limits<unsigned int>::Log2Bits;
+	SIZE tnLastWordIndex = a_tnLast >> Limits<unsigned int>::Log2Bits;
+		// The range of words to modify.
+	unsigned int nFirstMask
+		= (~0U) << (a_tnFirst & (Limits<unsigned int>::Bits - 1));
+	unsigned int nLastMask = (~0U) >> (Limits<unsigned int>::Bits - 1
+		- (a_tnLast & (Limits<unsigned int>::Bits - 1)));
+		// The bits to modify in the first and last words.
+
+	// Set the partial first word, all the whole words, and the partial
+	// last word.
+	if (tnWordIndex == tnLastWordIndex)
+	{
+		m_pnPoints[tnWordIndex] |= (nFirstMask & nLastMask);
+		return;
+	}
+	m_pnPoints[tnWordIndex++] |= nFirstMask;
+	while (tnWordIndex < tnLastWordIndex)
+		m_pnPoints[tnWordIndex++] = ~0U;
+	m_pnPoints[tnWordIndex] |= nLastMask;
+}
+
+
+
+// Clear the bitmap's bits from a_tnFirst to a_tnLast inclusive.
+template <class INDEX, class SIZE>
+void
+BitmapRegion2D<INDEX,SIZE>::ClearBits (SIZE a_tnFirst, SIZE a_tnLast)
+{
+	SIZE tnWordIndex = a_tnFirst >> Limits<unsigned int>::Log2Bits;
+	SIZE tnLastWordIndex = a_tnLast >> Limits<unsigned int>::Log2Bits;
+		// The range of words to modify.
+	unsigned int nFirstMask
+		= (~0U) << (a_tnFirst & (Limits<unsigned int>::Bits - 1));
+	unsigned int nLastMask = (~0U) >> (Limits<unsigned int>::Bits - 1
+		- (a_tnLast & (Limits<unsigned int>::Bits - 1)));
+		// The bits to modify in the first and last words.
+
+	// Clear the partial first word, all the whole words, and the
+	// partial last word.
+	if (tnWordIndex == tnLastWordIndex)
+	{
+		m_pnPoints[tnWordIndex] &= ~(nFirstMask & nLastMask);
+		return;
+	}
+	m_pnPoints[tnWordIndex++] &= ~nFirstMask;
+	while (tnWordIndex < tnLastWordIndex)
+		m_pnPoints[tnWordIndex++] = 0U;
+	m_pnPoints[tnWordIndex] &= ~nLastMask;
+}
+
+#endif // WORDWISE_BITMAPREGION
+
+
+
 // Move one of our iterators forward.
 template <class INDEX, class SIZE>
 void
@@ -7,6 +7,7 @@
 
 #include "config.h"
 #include <assert.h>
+#include <limits.h>
 #include "mjpeg_types.h"
 #include "TemplateLib.hh"
 #include "Limits.hh"
@@ -15,6 +16,7 @@
 #include "SetRegion2D.hh"
 #include "BitmapRegion2D.hh"
 #include "Vector.hh"
+#include "motionsearch.h"
 
 // HACK: for development error messages.
 #include <stdio.h>
@@ -198,10 +200,15 @@ public:
 			PIXELINDEX a_tnSearchRadiusX, PIXELINDEX a_tnSearchRadiusY,
 			PixelValue_t a_nZeroTolerance, PixelValue_t a_nTolerance,
 			FRAMESIZE a_nMatchCountThrottle,
-			FRAMESIZE a_nMatchSizeThrottle);
+			FRAMESIZE a_nMatchSizeThrottle,
+			bool a_bFastSearch = false);
 		// Initializer.  Provide the number of frames over which to
 		// accumulate pixel data, the dimensions of the frames, the
 		// search radius, the error tolerances, and the match throttles.
+		// If a_bFastSearch is true, matches are only looked for near
+		// the block motion vectors found by utils/motionsearch.c,
+		// instead of in the whole search radius; init_motion_search()
+		// must have been called.
 
 	const ReferenceFrame_t *GetFrameReadyForOutput (void);
 		// If a frame is ready to be output, return it, otherwise return
@@ -380,6 +387,62 @@ private:
 		// The search window.  It contains all the cells needed to
 		// analyze the image.
 
+	bool m_bFastSearch;
+		// true if matches come from the block motion vectors, false if
+		// they come from the pixel-sorter.
+
+	enum { m_knBlockSize = 16 };
+		// The width/height of the blocks that utils/motionsearch.c
+		// finds motion vectors for.
+
+	PIXELINDEX m_tnBlocksX, m_tnBlocksY;
+		// The number of blocks across/down the frame.
+
+	uint8_t *m_pNewPlane, *m_pReferencePlane;
+		// The first dimension of the new-frame & reference-frame
+		// pixels, padded out to whole blocks, and each followed by
+		// its 2x2 and 4x4 sub-sampled versions, which is the layout
+		// utils/motionsearch.c expects.
+
+	me_result_set *m_pSub44Set, *m_pSub22Set;
+		// The intermediate results of the hierarchical search.
+
+	me_result_s *m_pBlockVectors;
+		// The best motion vector found for each block.
+
+	enum { m_knCandidateVectors = 6 };
+		// The most block motion vectors a pixel-group is tested
+		// against, i.e. its own block's, its four neighbors', and zero.
+
+	PIXELINDEX m_atnCandidateX[m_knCandidateVectors],
+			m_atnCandidateY[m_knCandidateVectors];
+	int m_nCandidateVectors;
+		// The distinct block motion vectors near the current
+		// pixel-group.
+
+	int m_nCandidate;
+		// The next candidate to test.  Each block motion vector is
+		// refined by testing the pixel-groups within one pixel of it.
+
+	void FindBlockVectors (const Pixel_t *a_pPixels);
+		// Find the best motion vector for each block of the new frame
+		// in the reference frame.
+
+	void StartCandidateSearch (void);
+		// Collect the block motion vectors near the current
+		// pixel-group.
+
+	const typename SearchWindow_t::PixelGroup *FoundNextCandidate
+			(const typename SearchWindow_t::PixelGroup &a_rSearch
+			#ifdef THROTTLE_PIXELSORTER_WITH_SAD
+			, Tolerance_t &a_rtnSAD
+			#endif // THROTTLE_PIXELSORTER_WITH_SAD
+			);
+		// If there is another candidate pixel-group that matches the
+		// one being searched for, return it, and backpatch the
+		// sum-of-absolute-differences.
+		// If the search is over, returns NULL.
+
 #ifdef THROTTLE_PIXELSORTER_WITH_SAD
 
 	// A pixel group that matches the current pixel-group, with the
@@ -703,6 +766,14 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	m_nMatchCountThrottle = 0;
 	m_nMatchSizeThrottle = 0;
 
+	// No block motion vectors yet.
+	m_bFastSearch = false;
+	m_tnBlocksX = m_tnBlocksY = PIXELINDEX (0);
+	m_pNewPlane = m_pReferencePlane = NULL;
+	m_pSub44Set = m_pSub22Set = NULL;
+	m_pBlockVectors = NULL;
+	m_nCandidateVectors = m_nCandidate = 0;
+
 	// No active search yet.
 	m_tnX = m_tnY = m_tnStepX = PIXELINDEX (0);
 	m_pNewFrame = NULL;
@@ -753,6 +824,13 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		delete m_ppFrames[i];
 	}
 	delete[] m_ppFrames;
+
+	// Destroy the block-motion-vector search's workspace.
+	delete[] m_pNewPlane;
+	delete[] m_pReferencePlane;
+	delete m_pSub44Set;
+	delete m_pSub22Set;
+	delete[] m_pBlockVectors;
 }
 
 
@@ -769,7 +847,7 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	PIXELINDEX a_tnHeight, PIXELINDEX a_tnSearchRadiusX,
 	PIXELINDEX a_tnSearchRadiusY, PixelValue_t a_tnZeroTolerance,
 	PixelValue_t a_tnTolerance, FRAMESIZE a_nMatchCountThrottle,
-	FRAMESIZE a_nMatchSizeThrottle)
+	FRAMESIZE a_nMatchSizeThrottle, bool a_bFastSearch)
 {
 	int i;
 		// Used to loop through things.
@@ -943,6 +1021,46 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 		* a_tnTolerance);
 	m_nMatchCountThrottle = a_nMatchCountThrottle;
 	m_nMatchSizeThrottle = a_nMatchSizeThrottle;
+	m_bFastSearch = a_bFastSearch;
+
+	// If matches will come from block motion vectors, allocate space
+	// for the search.
+	if (m_bFastSearch)
+	{
+		FRAMESIZE tnPlaneSize;
+			// The size of each padded plane and its sub-sampled
+			// versions.
+
+		// Figure out how many blocks cover the frame.
+		m_tnBlocksX = (a_tnWidth + PIXELINDEX (m_knBlockSize - 1))
+			/ PIXELINDEX (m_knBlockSize);
+		m_tnBlocksY = (a_tnHeight + PIXELINDEX (m_knBlockSize - 1))
+			/ PIXELINDEX (m_knBlockSize);
+
+		// Each plane is followed by its 2x2 and 4x4 sub-sampled
+		// versions.  Leave a little extra, since the sub-sampled
+		// searches may read past the right edge.
+		tnPlaneSize = FRAMESIZE (m_tnBlocksX) * FRAMESIZE (m_tnBlocksY)
+			* FRAMESIZE (m_knBlockSize * m_knBlockSize);
+		tnPlaneSize += tnPlaneSize / 4 + tnPlaneSize / 16
+			+ FRAMESIZE (m_tnBlocksX) * FRAMESIZE (m_knBlockSize);
+
+		// Allocate the planes, the intermediate results, and the
+		// block motion vectors.
+		m_pNewPlane = new uint8_t[tnPlaneSize];
+		m_pReferencePlane = new uint8_t[tnPlaneSize];
+		m_pSub44Set = new me_result_set;
+		m_pSub22Set = new me_result_set;
+		m_pBlockVectors = new me_result_s[FRAMESIZE (m_tnBlocksX)
+			* FRAMESIZE (m_tnBlocksY)];
+		if (m_pNewPlane == NULL || m_pReferencePlane == NULL
+		|| m_pSub44Set == NULL || m_pSub22Set == NULL
+		|| m_pBlockVectors == NULL)
+		{
+			a_reStatus = g_kOutOfMemory;
+			return;
+		}
+	}
 
 	// Initialize our flood-fill controllers.  (This happens after we
 	// store our parameters, because these methods may need those
@@ -1278,6 +1396,11 @@ noMatch:
 		// (Skip it if they turned motion-detection off.)
 		if (m_tnTolerance > 0)
 		{
+			// If matches will come from block motion vectors, find
+			// them now.
+			if (m_bFastSearch)
+				FindBlockVectors (a_pPixels);
+
 			// Start searching in the upper-left corner, and prepare to
 			// move right.
 			m_tnX = m_tnY = 0;
@@ -1365,20 +1488,30 @@ noMatch:
 				// it to the frame now.
 
 				// Set up the search-window in a radius around the
-				// current pixel-group.
-				m_oSearchWindow.PrepareForSearch (a_reStatus, true);
+				// current pixel-group.  (The pixel-sorter isn't needed
+				// if matches come from block motion vectors.)
+				m_oSearchWindow.PrepareForSearch (a_reStatus,
+					!m_bFastSearch);
 				if (a_reStatus != g_kNoError)
 					return;
 
 				// Search for matches for the current pixel-group
-				// within the search radius.
-				m_oSearchWindow.StartSearch (itMatch, oCurrentGroup);
+				// within the search radius, or near the block motion
+				// vectors.
+				if (m_bFastSearch)
+					StartCandidateSearch();
+				else
+					m_oSearchWindow.StartSearch (itMatch, oCurrentGroup);
 				#ifdef THROTTLE_PIXELSORTER_WITH_SAD
 				m_setMatches.Clear();
-				while (pMatch = m_oSearchWindow.FoundNextMatch (itMatch,
-					tnSAD), pMatch != NULL)
+				while (pMatch = (m_bFastSearch
+					? FoundNextCandidate (oCurrentGroup, tnSAD)
+					: m_oSearchWindow.FoundNextMatch (itMatch, tnSAD)),
+					pMatch != NULL)
 				#else // THROTTLE_PIXELSORTER_WITH_SAD
-				while (pMatch = m_oSearchWindow.FoundNextMatch (itMatch),
+				while (pMatch = (m_bFastSearch
+					? FoundNextCandidate (oCurrentGroup)
+					: m_oSearchWindow.FoundNextMatch (itMatch)),
 					pMatch != NULL)
 				#endif // THROTTLE_PIXELSORTER_WITH_SAD
 				{
@@ -1924,6 +2057,8 @@ nextGroup:
 	#endif // PRUNING_FLOOD_FILL_WITH_BITMAP_REGIONS
 
 	// Make sure our temporary memory allocations have been purged.
+	// (That also resets their arenas, so the next frame reuses the
+	// same memory.)
 	assert (m_oRegionAllocator.GetNumAllocated() == 0);
 	assert (m_oMovedRegionSetAllocator.GetNumAllocated() == 0);
 }
@@ -1978,6 +2113,258 @@ MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 
 
 
+// Find the best motion vector for each block of the new frame
+// in the reference frame.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME>
+void
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME>::FindBlockVectors (const Pixel_t *a_pPixels)
+{
+	int nLineStride, nLines, nPlane;
+		// The dimensions of the padded planes.
+	int nRadiusX, nRadiusY;
+		// The search radius, as far as the block search is concerned.
+	int x, y;
+		// Used to loop through pixels and blocks.
+
+	// Make sure we have a reference frame to work with.
+	assert (m_pReferenceFrame != NULL);
+
+	// Get the dimensions of the padded planes.
+	nLineStride = int (m_tnBlocksX) * m_knBlockSize;
+	nLines = int (m_tnBlocksY) * m_knBlockSize;
+	nPlane = nLineStride * nLines;
+
+	// Copy the first dimension of both frames' pixels into the planes.
+	// Repeat the last column & line into the padding.
+	for (y = 0; y < nLines; ++y)
+	{
+		PIXELINDEX tnY = PIXELINDEX (Min (y, int (m_tnHeight) - 1));
+		uint8_t *pNewLine = m_pNewPlane + y * nLineStride;
+		uint8_t *pReferenceLine = m_pReferencePlane + y * nLineStride;
+
+		for (x = 0; x < nLineStride; ++x)
+		{
+			PIXELINDEX tnX = PIXELINDEX (Min (x, int (m_tnWidth) - 1));
+
+			pNewLine[x] = uint8_t (a_pPixels[FRAMESIZE (tnY)
+				* FRAMESIZE (m_tnWidth) + FRAMESIZE (tnX)][0]);
+			pReferenceLine[x] = uint8_t (m_pReferenceFrame->GetPixel
+				(tnX, tnY)->GetValue()[0]);
+		}
+	}
+
+	// Generate the 2x2 and 4x4 sub-sampled versions of the planes.
+	(*psubsample_image) (m_pNewPlane, nLineStride,
+		m_pNewPlane + nPlane, m_pNewPlane + nPlane + nPlane / 4);
+	(*psubsample_image) (m_pReferencePlane, nLineStride,
+		m_pReferencePlane + nPlane,
+		m_pReferencePlane + nPlane + nPlane / 4);
+
+	// The 4x4 sub-sampled search steps through candidates 4 pixels at a
+	// time, and motion vectors have to fit in a signed byte.
+	nRadiusX = Min (int (m_tnSearchRadiusX), 124);
+	nRadiusY = Min (int (m_tnSearchRadiusY), 124);
+
+	// Find the best motion vector for each block, the way mpeg2enc
+	// does: the best matches in the 4x4 sub-sampled planes are refined
+	// in the 2x2 sub-sampled planes, and the best of those are refined
+	// in the full planes.
+	for (y = 0; y < int (m_tnBlocksY); ++y)
+	{
+		for (x = 0; x < int (m_tnBlocksX); ++x)
+		{
+			int i0, j0, ilow, jlow, ihigh, jhigh;
+				// The block's location, and the range of locations to
+				// search for it in the reference frame.
+			uint8_t *pBlock;
+				// The block, in the new frame.
+			me_result_s oBest;
+				// The best match found so far.
+
+			// Get the range of locations to search.
+			i0 = x * m_knBlockSize;
+			j0 = y * m_knBlockSize;
+			ilow = Max (i0 - (nRadiusX & ~3), 0);
+			jlow = Max (j0 - (nRadiusY & ~3), 0);
+			ihigh = Min (i0 + nRadiusX, nLineStride - m_knBlockSize);
+			jhigh = Min (j0 + nRadiusY, nLines - m_knBlockSize);
+
+			// Start with the zero motion vector.  Its SAD is also the
+			// basis for the thresholds in the sub-sampled searches.
+			pBlock = m_pNewPlane + j0 * nLineStride + i0;
+			oBest.weight = uint16_t ((*psad_00) (m_pReferencePlane
+				+ j0 * nLineStride + i0, pBlock, nLineStride,
+				m_knBlockSize, INT_MAX));
+			oBest.x = oBest.y = 0;
+
+			// Search the sub-sampled planes, then the full planes.
+			(*pbuild_sub44_mests) (m_pSub44Set,
+				ilow, jlow, ihigh, jhigh, i0, j0, oBest.weight,
+				m_pReferencePlane + nPlane + nPlane / 4,
+				m_pNewPlane + nPlane + nPlane / 4
+					+ (j0 >> 2) * (nLineStride >> 2) + (i0 >> 2),
+				nLineStride >> 2, m_knBlockSize >> 2, 2);
+			(*pbuild_sub22_mests) (m_pSub44Set, m_pSub22Set,
+				i0, j0, ihigh, jhigh, oBest.weight,
+				m_pReferencePlane + nPlane,
+				m_pNewPlane + nPlane
+					+ (j0 >> 1) * (nLineStride >> 1) + (i0 >> 1),
+				nLineStride >> 1, m_knBlockSize >> 1, 3);
+			(*pfind_best_one_pel) (m_pSub22Set, m_pReferencePlane,
+				pBlock, i0, j0, ihigh, jhigh, nLineStride,
+				m_knBlockSize, &oBest);
+
+			// Remember the best motion vector.
+			m_pBlockVectors[y * int (m_tnBlocksX) + x] = oBest;
+		}
+	}
+}
+
+
+
+// Collect the block motion vectors near the current pixel-group.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME>
+void
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME>::StartCandidateSearch (void)
+{
+	static const int anNeighbors[m_knCandidateVectors - 1][2]
+		= { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+		// The block containing the pixel-group, then its neighbors.
+	int nBlockX, nBlockY;
+		// The block containing the center of the pixel-group.
+	int i, j;
+		// Used to loop through blocks & candidates.
+
+	// Find the block containing the center of the pixel-group.
+	nBlockX = (int (m_tnX) + PGW / 2) / m_knBlockSize;
+	nBlockY = (int (m_tnY) + PGH / 2) / m_knBlockSize;
+
+	// Collect the distinct motion vectors of that block and its
+	// neighbors, and the zero motion vector.
+	m_nCandidateVectors = 0;
+	for (i = 0; i < m_knCandidateVectors; ++i)
+	{
+		PIXELINDEX tnMotionX, tnMotionY;
+			// The next candidate motion vector.
+
+		// Get the next candidate motion vector.
+		if (i < m_knCandidateVectors - 1)
+		{
+			int x = nBlockX + anNeighbors[i][0];
+			int y = nBlockY + anNeighbors[i][1];
+			if (x < 0 || x >= int (m_tnBlocksX)
+			|| y < 0 || y >= int (m_tnBlocksY))
+				continue;
+			const me_result_s &rVector
+				= m_pBlockVectors[y * int (m_tnBlocksX) + x];
+			tnMotionX = PIXELINDEX (rVector.x);
+			tnMotionY = PIXELINDEX (rVector.y);
+		}
+		else
+			tnMotionX = tnMotionY = PIXELINDEX (0);
+
+		// Skip it if it's already been collected.
+		for (j = 0; j < m_nCandidateVectors; ++j)
+			if (m_atnCandidateX[j] == tnMotionX
+			&& m_atnCandidateY[j] == tnMotionY)
+				break;
+		if (j < m_nCandidateVectors)
+			continue;
+
+		// Collect it.
+		m_atnCandidateX[m_nCandidateVectors] = tnMotionX;
+		m_atnCandidateY[m_nCandidateVectors] = tnMotionY;
+		++m_nCandidateVectors;
+	}
+
+	// Start with the first candidate.
+	m_nCandidate = 0;
+}
+
+
+
+// If there is another candidate pixel-group that matches the one
+// being searched for, return it, and backpatch the
+// sum-of-absolute-differences.
+// If the search is over, returns NULL.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME>
+const typename MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,
+	FRAMESIZE,PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME>::SearchWindow_t::PixelGroup *
+MotionSearcher<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME>::FoundNextCandidate
+	(const typename SearchWindow_t::PixelGroup &a_rSearch
+	#ifdef THROTTLE_PIXELSORTER_WITH_SAD
+	, Tolerance_t &a_rtnSAD
+	#endif // THROTTLE_PIXELSORTER_WITH_SAD
+	)
+{
+	// Loop through the pixel-groups within one pixel of each candidate
+	// motion vector, and return the next one that matches.
+	while (m_nCandidate < m_nCandidateVectors * 9)
+	{
+		int nVector, nOffset, j;
+			// The candidate motion vector, and which of the pixel-groups
+			// around it to test.
+		PIXELINDEX tnMotionX, tnMotionY;
+			// The motion vector to test.
+		const typename SearchWindow_t::PixelGroup *pGroup;
+			// The pixel-group to test.
+
+		// Get the motion vector to test.
+		nVector = m_nCandidate / 9;
+		nOffset = m_nCandidate % 9;
+		++m_nCandidate;
+		tnMotionX = m_atnCandidateX[nVector]
+			+ PIXELINDEX (nOffset % 3 - 1);
+		tnMotionY = m_atnCandidateY[nVector]
+			+ PIXELINDEX (nOffset / 3 - 1);
+
+		// If an earlier candidate motion vector already tested this
+		// pixel-group, skip it.
+		for (j = 0; j < nVector; ++j)
+			if (AbsoluteValue (tnMotionX - m_atnCandidateX[j]) <= 1
+			&& AbsoluteValue (tnMotionY - m_atnCandidateY[j]) <= 1)
+				break;
+		if (j < nVector)
+			continue;
+
+		// Get the pixel-group, if it's in the search window and hasn't
+		// been used yet.
+		pGroup = m_oSearchWindow.GetPixelGroup (m_tnX + tnMotionX,
+			m_tnY + tnMotionY);
+		if (pGroup == NULL)
+			continue;
+
+		// If it matches, return it.
+		if (pGroup->IsWithinTolerance (a_rSearch, m_tnTolerance
+			#ifdef THROTTLE_PIXELSORTER_WITH_SAD
+			, a_rtnSAD
+			#endif // THROTTLE_PIXELSORTER_WITH_SAD
+			))
+			return pGroup;
+	}
+
+	// The search is over.
+	return NULL;
+}
+
+
+
 #ifdef THROTTLE_PIXELSORTER_WITH_SAD
 
 // Default constructor.
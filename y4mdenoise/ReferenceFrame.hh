@@ -58,6 +58,32 @@ public:
 		// a_tnTolerance must have been previously retrieved from
 		// MakeTolerance().
 
+	static bool IsWithinTolerance (const Pixel<NUM,DIM,TOL> *a_pThese,
+			const Pixel<NUM,DIM,TOL> *a_pOthers, int a_nPixels,
+			TOL a_tnTolerance, TOL &a_rtnSAD);
+		// Return true if each of the a_nPixels pixels in the first
+		// array is within the specified tolerance of the corresponding
+		// pixel in the second array, and backpatch the total
+		// sample-array-difference.  (Pixel types may specialize this to
+		// compare the pixels all at once.)
+		// a_tnTolerance must have been previously retrieved from
+		// MakeTolerance().
+
+	static void CompareWithSplit (const Pixel<NUM,DIM,TOL> *a_pThese,
+			const Pixel<NUM,DIM,TOL> *a_pSplits, int a_nPixels,
+			TOL a_tnTolerance, uint32_t &a_rnGreater, bool &a_rbEqual,
+			bool &a_rbWithinTolerance);
+		// Compare each dimension of each of the a_nPixels pixels in
+		// the first array with the corresponding split value in the
+		// second array.  Backpatch a bitmask with bit
+		// (pixel * DIM + dimension) set for every value that's greater
+		// than its split value, whether any value equals its split
+		// value, and whether any value, all by itself, is within the
+		// given tolerance of its split value.  Used to walk the
+		// search-window's pixel-sorter.
+		// a_tnTolerance must have been previously retrieved from
+		// MakeTolerance().
+
 private:
 	NUM m_atnVal[DIM];
 		// The pixel value.
@@ -325,6 +351,78 @@ Pixel<NUM,2,TOL>::IsWithinTolerance
 
 
 
+// Return true if each pixel in the first array is within the
+// specified tolerance of the corresponding pixel in the second array.
+template <class NUM, int DIM, class TOL>
+bool
+Pixel<NUM,DIM,TOL>::IsWithinTolerance (const Pixel<NUM,DIM,TOL> *a_pThese,
+	const Pixel<NUM,DIM,TOL> *a_pOthers, int a_nPixels,
+	TOL a_tnTolerance, TOL &a_rtnSAD)
+{
+	// Compare the pixels one at a time.
+	a_rtnSAD = 0;
+	for (int i = 0; i < a_nPixels; ++i)
+	{
+		TOL tnSAD;
+			// The sample-array-difference between these two pixels.
+
+		// If this pixel is not within the tolerance of the
+		// corresponding pixel in the other array, exit now.
+		if (!a_pThese[i].IsWithinTolerance (a_pOthers[i], a_tnTolerance,
+				tnSAD))
+			return false;
+
+		// Sum up the sample-array-differences.
+		a_rtnSAD += tnSAD;
+	}
+
+	// The pixels are equal, within the given tolerance.
+	return true;
+}
+
+
+
+// Compare each dimension of each pixel in the first array with the
+// corresponding split value in the second array.
+template <class NUM, int DIM, class TOL>
+void
+Pixel<NUM,DIM,TOL>::CompareWithSplit (const Pixel<NUM,DIM,TOL> *a_pThese,
+	const Pixel<NUM,DIM,TOL> *a_pSplits, int a_nPixels,
+	TOL a_tnTolerance, uint32_t &a_rnGreater, bool &a_rbEqual,
+	bool &a_rbWithinTolerance)
+{
+	a_rnGreater = 0;
+	a_rbEqual = a_rbWithinTolerance = false;
+	for (int p = 0; p < a_nPixels; ++p)
+	{
+		for (int i = 0; i < DIM; ++i)
+		{
+			// Compare this dimension with its split value.
+			if (a_pThese[p][i] == a_pSplits[p][i])
+				a_rbEqual = true;
+			if (a_pThese[p][i] > a_pSplits[p][i])
+				a_rnGreater |= uint32_t (1) << (p * DIM + i);
+
+			// Find out if this dimension, all by itself, is within the
+			// tolerance.  (Once one is, the rest needn't be checked.)
+			if (!a_rbWithinTolerance)
+			{
+				// Collapse all dimensions but the current one.
+				Pixel<NUM,DIM,TOL> oThis = a_pThese[p];
+				for (int j = 0; j < DIM; ++j)
+					if (j != i)
+						oThis[j] = a_pSplits[p][j];
+
+				// Compare what's left.
+				if (oThis.IsWithinTolerance (a_pSplits[p], a_tnTolerance))
+					a_rbWithinTolerance = true;
+			}
+		}
+	}
+}
+
+
+
 // Default constructor.
 template <class ACCUM_NUM, class PIXEL_NUM, int DIM, class PIXEL>
 ReferencePixel<ACCUM_NUM,PIXEL_NUM,DIM,PIXEL>::ReferencePixel()
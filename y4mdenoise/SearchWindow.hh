@@ -131,6 +131,16 @@ public:
 		// them there.
 		// This must be called before StartSearch()/FoundNextMatch() if
 		// any of the Move*() methods have been called.
+		// Unless OPTIONALLY_SORT_PIXEL_GROUPS is defined, a_bSortPixels
+		// must be the same for every search in a frame.
+
+	const PixelGroup *GetPixelGroup (PIXELINDEX a_tnX,
+			PIXELINDEX a_tnY) const;
+		// Return the pixel group at this index, if it's within the
+		// search window prepared by PrepareForSearch() and contains no
+		// used reference pixels.  Otherwise, return NULL.
+		// Allows the client to test candidate matches of its own
+		// choosing, instead of searching the pixel-sorter.
 
 #ifdef OPTIONALLY_SORT_PIXEL_GROUPS
 
@@ -720,47 +730,19 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	#endif // CALCULATE_SAD
 	) const
 {
-	PIXELINDEX tnX, tnY;
-		// Used to loop through pixels.
-
-	// Compare the two pixel groups, pixel by pixel.
+	// Compare the two pixel groups.  (The pixel type may be able to
+	// compare all the pixels at once.)
 	#ifdef CALCULATE_SAD
-	a_rtnSAD = 0;
+	return Pixel_t::IsWithinTolerance (&(m_atPixels[0][0]),
+		&(a_rOther.m_atPixels[0][0]), PGW * PGH, a_tnTolerance,
+		a_rtnSAD);
+	#else // CALCULATE_SAD
+	Tolerance_t tnSAD;
+		// The sum-of-absolute-differences, which we don't need.
+	return Pixel_t::IsWithinTolerance (&(m_atPixels[0][0]),
+		&(a_rOther.m_atPixels[0][0]), PGW * PGH, a_tnTolerance,
+		tnSAD);
 	#endif // CALCULATE_SAD
-	for (tnY = 0; tnY < PGH; ++tnY)
-	{
-		for (tnX = 0; tnX < PGW; ++tnX)
-		{
-			#ifdef CALCULATE_SAD
-			Tolerance_t tnSAD;
-			#endif // CALCULATE_SAD
-				// The sum-of-absolute-differences between these two
-				// pixels.
-
-			// Get the two pixels of interest.
-			const Pixel_t &rThisPixel = m_atPixels[tnY][tnX];
-			const Pixel_t &rOtherPixel = a_rOther.m_atPixels[tnY][tnX];
-
-			// If this pixel value is not within the tolerance of
-			// the corresponding pixel in the other group, exit now.
-			if (!rThisPixel.IsWithinTolerance (rOtherPixel, a_tnTolerance
-				#ifdef CALCULATE_SAD
-				, tnSAD
-				#endif // CALCULATE_SAD
-				))
-			{
-				return false;
-			}
-
-			// Sum up the sum-of-absolute-differences.
-			#ifdef CALCULATE_SAD
-			a_rtnSAD += tnSAD;
-			#endif // CALCULATE_SAD
-		}
-	}
-
-	// The pixel groups are equal, within the given tolerance.
-	return true;
 }
 
 
@@ -849,9 +831,11 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	assert (a_reStatus == g_kNoError);
 
 	// (If we're not doing the expanding-regions variant, make sure
-	// they always want to add search-window cells to the pixel-sorter.)
+	// they're not switching between sorting & not sorting in the middle
+	// of a frame.)
 	#ifndef OPTIONALLY_SORT_PIXEL_GROUPS
-	assert (a_bSortPixels);
+	assert (a_bSortPixels
+		|| m_tnSearchWindowSortLeft == m_tnSearchWindowSortRight);
 	#endif // OPTIONALLY_SORT_PIXEL_GROUPS
 
 	// Make sure we have a new frame & reference frame to work with.
@@ -977,7 +961,7 @@ sortCell:;
 			// Put this cell into the pixel-sorter, if it's not
 			// there already.
 			#ifndef OPTIONALLY_SORT_PIXEL_GROUPS
-			if (pCell->m_pForward == pCell)
+			if (a_bSortPixels && pCell->m_pForward == pCell)
 			{
 				// (Sanity check: the backward pointer should be
 				// circular too.)
@@ -1007,10 +991,13 @@ nextXPixel:;
 #ifndef OPTIONALLY_SORT_PIXEL_GROUPS
 
 	// The search-window now looks like this.
-	m_tnSearchWindowSortLeft = tnSearchWindowPixelLeft;
-	m_tnSearchWindowSortRight = tnSearchWindowPixelRight;
-	m_tnSearchWindowSortTop = tnSearchWindowPixelTop;
-	m_tnSearchWindowSortBottom = tnSearchWindowPixelBottom;
+	if (a_bSortPixels)
+	{
+		m_tnSearchWindowSortLeft = tnSearchWindowPixelLeft;
+		m_tnSearchWindowSortRight = tnSearchWindowPixelRight;
+		m_tnSearchWindowSortTop = tnSearchWindowPixelTop;
+		m_tnSearchWindowSortBottom = tnSearchWindowPixelBottom;
+	}
 
 #else // OPTIONALLY_SORT_PIXEL_GROUPS
 
@@ -1125,6 +1112,42 @@ nextXPixel:;
 
 
 
+// Return the pixel group at this index, if it's within the search
+// window prepared by PrepareForSearch() and contains no used reference
+// pixels.  Otherwise, return NULL.
+template <class PIXEL_NUM, int DIM, class PIXEL_TOL, class PIXELINDEX,
+	class FRAMESIZE, PIXELINDEX PGW, PIXELINDEX PGH,
+	class SORTERBITMASK, class PIXEL, class REFERENCEPIXEL,
+	class REFERENCEFRAME>
+const typename SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME>::PixelGroup *
+SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
+	PGW,PGH,SORTERBITMASK,PIXEL,REFERENCEPIXEL,
+	REFERENCEFRAME>::GetPixelGroup (PIXELINDEX a_tnX,
+	PIXELINDEX a_tnY) const
+{
+	// If the index is outside the search window, there's nothing here.
+	if (a_tnX < m_tnSearchWindowPixelLeft
+		|| a_tnX >= m_tnSearchWindowPixelRight
+		|| a_tnY < m_tnSearchWindowPixelTop
+		|| a_tnY >= m_tnSearchWindowPixelBottom)
+		return NULL;
+
+	// Get the cell.
+	const SearchWindowCell *pCell = &(m_ppSearchWindow[a_tnY][a_tnX]);
+
+	// If the cell was invalidated, i.e. it contains used reference
+	// pixels, it can't be a match.
+	if (pCell->m_pForward == NULL)
+		return NULL;
+
+	// Return the pixel group.
+	return pCell;
+}
+
+
+
 #ifdef OPTIONALLY_SORT_PIXEL_GROUPS
 
 // Return the cell at this index.
@@ -1699,9 +1722,8 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	(const PixelGroup *a_pPixelGroup, Tolerance_t a_tnTwiceTolerance,
 	SORTERBITMASK &a_rtnChildIndex, bool &a_rbMatchAtThisLevel) const
 {
-	PIXELINDEX tnX, tnY;
-	int i;
-		// Used to loop through pixels & pixel dimensions.
+	uint32_t nGreater;
+		// Which pixel values are greater than their split values.
 	bool bPixelGroupStopsHere;
 		// True if one of the pixel-group's pixels exactly matches
 		// its corresponding split-point.
@@ -1712,61 +1734,19 @@ SearchWindow<PIXEL_NUM,DIM,PIXEL_TOL,PIXELINDEX,FRAMESIZE,
 	// Compare the group's pixel values to our split values, and
 	// determine which child branch it should descend, or if it
 	// should stop at this level.
-	a_rtnChildIndex = 0;
-	bPixelGroupStopsHere = false;
-	a_rbMatchAtThisLevel = false;
-	for (tnY = 0; tnY < PGH; ++tnY)
-	{
-		for (tnX = 0; tnX < PGW; ++tnX)
-		{
-			// Get the two pixels of interest.
-			const Pixel_t &rGroupPixel
-				= a_pPixelGroup->m_atPixels[tnY][tnX];
-			const Pixel_t &rSplitPixel
-				= m_oSplitValue.m_atPixels[tnY][tnX];
-
-			// Determine the effect each dimension has on the
-			// bitmask that we use to determine the index of the
-			// child branch that this cell should descend into.
-			// (If the pixel value is right on a branch's split value,
-			// then all pixels that would match it have been found at
-			// this level.)
-			for (i = 0; i < DIM; i++)
-			{
-				if (rGroupPixel[i] == rSplitPixel[i])
-					bPixelGroupStopsHere = true;
-				if (rGroupPixel[i] > rSplitPixel[i])
-					a_rtnChildIndex |= GetBitMask (tnY, tnX, i);
-
-				// If the current pixel is within twice the tolerance
-				// of the split-point, then some of the search-window
-				// cells that had to stop at this point in the tree may
-				// match the current pixel-group.  (And once we figure
-				// that out, we don't have to check any other pixels for
-				// this property.)
-				if (!a_rbMatchAtThisLevel)
-				{
-					// Make copies of the two pixels.
-					Pixel_t oGroupPixel = rGroupPixel;
-					Pixel_t oSplitPixel = rSplitPixel;
-
-					// Collapse all dimensions but the current one.
-					for (int j = 0; j < DIM; ++j)
-						if (j != i)
-							oGroupPixel[j] = oSplitPixel[j];
-
-					// If this axis, all by itself, is within twice the
-					// tolerance, then we can no longer rule out matches
-					// at this level.
-					if (oGroupPixel.IsWithinTolerance (oSplitPixel,
-						a_tnTwiceTolerance))
-					{
-						a_rbMatchAtThisLevel = true;
-					}
-				}
-			}
-		}
-	}
+	// (If a pixel value is right on a branch's split value, then all
+	// pixels that would match it have been found at this level.
+	// And if a pixel value is within twice the tolerance of the
+	// split-point, then some of the search-window cells that had to
+	// stop at this point in the tree may match the current
+	// pixel-group.)
+	// The bitmask of greater pixel values is laid out the way
+	// GetBitMask() lays out pixel dimensions.
+	Pixel_t::CompareWithSplit (&(a_pPixelGroup->m_atPixels[0][0]),
+		&(m_oSplitValue.m_atPixels[0][0]), PGW * PGH,
+		a_tnTwiceTolerance, nGreater, bPixelGroupStopsHere,
+		a_rbMatchAtThisLevel);
+	a_rtnChildIndex = SORTERBITMASK (nGreater);
 
 	// Return whether the pixel group can descend into a child branch.
 	return bPixelGroupStopsHere;
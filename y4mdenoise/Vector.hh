@@ -13,7 +13,18 @@
 #include <new>
 #include "mjpeg_types.h"
 #include "Status_t.h"
+
+
+
+// Define this to allocate vector items from an arena that's reset
+// once all of its items are freed, instead of from a free-space set.
+#define VECTOR_USES_ARENA_ALLOCATOR
+
+#ifdef VECTOR_USES_ARENA_ALLOCATOR
+#include "ArenaAllocator.hh"
+#else // VECTOR_USES_ARENA_ALLOCATOR
 #include "VariableSizeAllocator.hh"
+#endif // VECTOR_USES_ARENA_ALLOCATOR
 
 
 
@@ -47,7 +58,11 @@ private:
 		// Disallow copying and assignment.
 
 public:
+	#ifdef VECTOR_USES_ARENA_ALLOCATOR
+	typedef ArenaAllocator Allocator_t;
+	#else // VECTOR_USES_ARENA_ALLOCATOR
 	typedef VariableSizeAllocator Allocator_t;
+	#endif // VECTOR_USES_ARENA_ALLOCATOR
 		// The type of node allocator to use.
 
 	static Allocator_t sm_oNodeAllocator;
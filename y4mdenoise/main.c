@@ -71,6 +71,8 @@ int main(int argc, char *argv[])
   denoiser.matchCountThrottle = 16;
   denoiser.matchSizeThrottle  = 256;
   denoiser.threads            = 1;
+  denoiser.bands              = 1;
+  denoiser.fast               = 0;
   
   /* process commandline */
   process_commandline(argc, argv);
@@ -276,7 +278,7 @@ process_commandline(int argc, char *argv[])
 {
   char c;
 
-  while ((c = getopt (argc, argv, "h?z:Z:t:T:r:R:m:M:f:BI:p:v:")) != -1)
+  while ((c = getopt (argc, argv, "h?z:Z:t:T:r:R:m:M:f:FBI:p:j:v:")) != -1)
   {
     switch (c)
     {
@@ -347,6 +349,11 @@ process_commandline(int argc, char *argv[])
         denoiser.frames = atoi(optarg);
         break;
       }
+      case 'F':
+      {
+        denoiser.fast = 1;
+        break;
+      }
       case 'B':
       {
         denoiser.bwonly = 1;
@@ -372,6 +379,16 @@ process_commandline(int argc, char *argv[])
         denoiser.threads = threads;
         break;
       }
+      case 'j':
+      {
+	 	int bands = atoi (optarg);
+		if (bands < 1)
+		{
+      		mjpeg_error_exit1 ("-j must be at least 1");
+		}
+        denoiser.bands = bands;
+        break;
+      }
       case 'v':
         verbose = atoi (optarg);
         if (verbose < 0 || verbose > 2)
@@ -422,6 +439,8 @@ display_help (void)
 	"------------------\n"
 	"-p    parallelism: 0=no threads, 1=r/w thread only, 2=do color in\n"
 	"      separate thread (default: 1)\n"
+	"-j    Number of horizontal bands to denoise in parallel, each in its\n"
+	"      own thread (default: 1)\n"
 	"-r    Radius for motion-search (default: 16)\n"
 	"-R    Radius for color motion-search (default: -r setting)\n"
 	"-t    Error tolerance (default: 3)\n"
@@ -433,6 +452,8 @@ display_help (void)
 	"-M    Match-size throttle (apply first match whose flood-fill is the\n"
 	"      size of this many pixel-groups or greater) (default: 3)\n"
 	"-f    Number of reference frames (default: 10)\n"
+	"-F    Fast mode: only look for matches near the best motion vector of\n"
+	"      each 16x16 block, found as mpeg2enc does (default: off)\n"
 	"-B    Black-and-white mode; denoise intensity, set color to white\n"
 	"-I    Interlacing type: 0=frame, 1=top-field-first, 2=bottom-field-first\n"
 	"      (default: taken from stream header)\n"
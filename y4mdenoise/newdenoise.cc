@@ -8,12 +8,17 @@
 
 #include <assert.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
 #include "mjpeg_types.h"
 #include "mjpeg_logging.h"
 #include "yuv4mpeg.h"
+#include "cpu_accel.h"
 #include <stdio.h>
 #include "newdenoise.hh"
 #include "MotionSearcher.hh"
@@ -49,29 +54,80 @@ class MotionSearcherCbCr
 	: public MotionSearcher<uint8_t, 2, int32_t, int16_t, int32_t, 2, 2,
 		uint16_t, PixelCbCr, ReferencePixelCbCr, ReferenceFrameCbCr> {};
 #endif
-MotionSearcherY g_oMotionSearcherY;
-MotionSearcherCbCr g_oMotionSearcherCbCr;
 
 // Whether the denoisers should be used.
 bool g_bMotionSearcherY;
 bool g_bMotionSearcherCbCr;
 
-// Pixel buffers, used to translate provided input into the form the
-// denoiser needs.
-int g_nPixelsY, g_nWidthY, g_nHeightY;
-MotionSearcherY::Pixel_t *g_pPixelsY;
-int g_nPixelsCbCr, g_nWidthCbCr, g_nHeightCbCr;
-MotionSearcherCbCr::Pixel_t *g_pPixelsCbCr;
+// Whether pixel-groups are compared with SSE2.
+static bool g_bPixelsSSE2;
 
-// Internal methods to output a frame.
-static void output_frame
-	(const MotionSearcherY::ReferenceFrame_t *a_pFrameY,
-	const MotionSearcherCbCr::ReferenceFrame_t *a_pFrameCbCr,
-	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr);
-static void output_field
-	(int a_nMask, const MotionSearcherY::ReferenceFrame_t *a_pFrameY,
+// The frame is denoised in horizontal bands, each one by its own
+// motion-searchers, so that several bands can be denoised at once.
+// Neighboring bands search a search-radius worth of lines in common,
+// so that motion across the border between them is still found, but
+// each band only outputs the lines it owns.
+template <class MOTIONSEARCHER>
+class DenoiserBand
+{
+public:
+	DenoiserBand() : m_pPixels (NULL) {}
+		// Default constructor.
+
+	~DenoiserBand() { delete[] m_pPixels; }
+		// Destructor.
+
+	MOTIONSEARCHER m_oMotionSearcher;
+		// The denoiser for this band.
+
+	typename MOTIONSEARCHER::Pixel_t *m_pPixels;
+	int m_nPixels;
+		// Pixel buffer, used to translate provided input into the
+		// form the denoiser needs.
+
+	int m_nFirstLine, m_nLines;
+		// The lines searched by this band's denoiser.  (These are
+		// field lines, if the video is interlaced.)
+
+	int m_nFirstOwnLine, m_nOwnLines;
+		// The lines this band outputs.
+};
+typedef DenoiserBand<MotionSearcherY> DenoiserBandY;
+typedef DenoiserBand<MotionSearcherCbCr> DenoiserBandCbCr;
+
+// The bands.
+int g_nBands;
+DenoiserBandY *g_aBandsY;
+DenoiserBandCbCr *g_aBandsCbCr;
+
+// The size of the provided frames.
+int g_nWidthY, g_nHeightY;
+int g_nWidthCbCr, g_nHeightCbCr;
+
+// Denoise one band of a frame, or of a pair of fields.
+int newdenoise_frame_intensity (int a_nBand, const uint8_t *a_pInputY,
+	uint8_t *a_pOutputY);
+int newdenoise_frame_color (int a_nBand, const uint8_t *a_pInputCb,
+	const uint8_t *a_pInputCr, uint8_t *a_pOutputCb,
+	uint8_t *a_pOutputCr);
+int newdenoise_interlaced_frame_intensity (int a_nBand,
+	const uint8_t *a_pInputY, uint8_t *a_pOutputY);
+int newdenoise_interlaced_frame_color (int a_nBand,
+	const uint8_t *a_pInputCb, const uint8_t *a_pInputCr,
+	uint8_t *a_pOutputCb, uint8_t *a_pOutputCr);
+
+// Internal methods to convert a band's input/output.
+static void input_band_y (DenoiserBandY &a_rBand, int a_nMask,
+	int a_nStep, const uint8_t *a_pInputY);
+static void input_band_cbcr (DenoiserBandCbCr &a_rBand, int a_nMask,
+	int a_nStep, const uint8_t *a_pInputCb, const uint8_t *a_pInputCr);
+static void output_band_y (const DenoiserBandY &a_rBand, int a_nMask,
+	int a_nStep, const MotionSearcherY::ReferenceFrame_t *a_pFrameY,
+	uint8_t *a_pOutputY);
+static void output_band_cbcr (const DenoiserBandCbCr &a_rBand,
+	int a_nMask, int a_nStep,
 	const MotionSearcherCbCr::ReferenceFrame_t *a_pFrameCbCr,
-	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr);
+	uint8_t *a_pOutputCb, uint8_t *a_pOutputCr);
 
 
 
@@ -273,25 +329,28 @@ private:
 		// Where we are in the process of denoising.
 };
 
-// A class to run the intensity denoiser in a separate thread.
-class DenoiserThreadY : public DenoiserThread
+// A class to denoise a band of the frame in a separate thread.
+// Its color is denoised here too, unless that has a thread of its own.
+class DenoiserThreadBand : public DenoiserThread
 {
 private:
 	typedef DenoiserThread BaseClass;
 		// Keep track of who our base class is.
 
 public:
-	DenoiserThreadY();
+	DenoiserThreadBand();
 		// Default constructor.
 	
-	virtual ~DenoiserThreadY();
+	virtual ~DenoiserThreadBand();
 		// Destructor.
 
-	void Initialize (void);
+	void Initialize (int a_nBand);
 		// Initialize.  Set up all private thread data and start the
 		// worker thread.
 	
-	void AddFrame (const uint8_t *a_pInputY, uint8_t *a_pOutputY);
+	void AddFrame (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
+			const uint8_t *a_pInputCr, uint8_t *a_pOutputY,
+			uint8_t *a_pOutputCb, uint8_t *a_pOutputCr);
 		// Add a frame to the denoiser.
 	
 	int WaitForAddFrame (void);
@@ -303,8 +362,14 @@ protected:
 		// Denoise the current frame.
 
 private:
+	int m_nBand;
+		// The band of the frame that this thread denoises.
 	const uint8_t *m_pInputY;
+	const uint8_t *m_pInputCb;
+	const uint8_t *m_pInputCr;
 	uint8_t *m_pOutputY;
+	uint8_t *m_pOutputCb;
+	uint8_t *m_pOutputCr;
 		// Input/output buffers.
 };
 
@@ -322,7 +387,7 @@ public:
 	virtual ~DenoiserThreadCbCr();
 		// Destructor.
 
-	void Initialize (void);
+	void Initialize (int a_nBand);
 		// Initialize.  Set up all private thread data and start the
 		// worker thread.
 	
@@ -340,6 +405,8 @@ protected:
 		// Denoise the current frame.
 
 private:
+	int m_nBand;
+		// The band of the frame that this thread denoises.
 	const uint8_t *m_pInputCb;
 	const uint8_t *m_pInputCr;
 	uint8_t *m_pOutputCb;
@@ -471,9 +538,10 @@ protected:
 		// Write frames to the raw-video stream.
 };
 
-// Threads for denoising intensity & color.
-DenoiserThreadY g_oDenoiserThreadY;
-DenoiserThreadCbCr g_oDenoiserThreadCbCr;
+// Threads for denoising the bands after the first, and for denoising
+// color.
+DenoiserThreadBand *g_aoDenoiserThreadBand;
+DenoiserThreadCbCr *g_aoDenoiserThreadCbCr;
 
 // Threads for reading and writing raw video.
 DenoiserThreadRead g_oDenoiserThreadRead;
@@ -481,6 +549,37 @@ DenoiserThreadWrite g_oDenoiserThreadWrite;
 
 
 
+// Work out which lines each band of a plane searches and outputs.
+// a_nHeight is the number of lines in the plane (in a field, if the
+// video is interlaced), a_nOverlap the number of lines that neighboring
+// bands search in common.
+template <class BAND>
+static void
+init_band_lines (BAND *a_pBands, int a_nHeight, int a_nOverlap)
+{
+	int i;
+		// Used to loop through bands.
+	int nFirst, nLast;
+		// The lines owned by the current band.
+
+	for (i = 0; i < g_nBands; ++i)
+	{
+		// Split the plane evenly, on pixel-group boundaries.
+		nFirst = (a_nHeight * i / g_nBands) & ~1;
+		nLast = (i + 1 == g_nBands) ? a_nHeight
+			: ((a_nHeight * (i + 1) / g_nBands) & ~1);
+		a_pBands[i].m_nFirstOwnLine = nFirst;
+		a_pBands[i].m_nOwnLines = nLast - nFirst;
+
+		// Search some of the neighbors' lines too.
+		nFirst = (nFirst > a_nOverlap) ? nFirst - a_nOverlap : 0;
+		nLast = (nLast + a_nOverlap < a_nHeight) ? nLast + a_nOverlap
+			: a_nHeight;
+		a_pBands[i].m_nFirstLine = nFirst;
+		a_pBands[i].m_nLines = nLast - nFirst;
+	}
+}
+
 // Initialize the denoising system.
 int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 	int a_nWidthCbCr, int a_nHeightCbCr, int a_nInputFD,
@@ -492,7 +591,11 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 	int nInterlace;
 		// A factor to apply to frames/frame-height because of
 		// interlacing.
-	
+	int nMaxBands, nRadiusCbCr;
+		// Used to limit the number of bands.
+	int i;
+		// Used to loop through bands.
+
 	// No errors yet.
 	eStatus = g_kNoError;
 
@@ -502,10 +605,43 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 	g_nWidthCbCr = a_nWidthCbCr;
 	g_nHeightCbCr = a_nHeightCbCr;
 
+	// Compare pixel-groups with SSE2 if the processor has it, unless
+	// told not to.
+	#ifdef __SSE2__
+	{
+		const char *pszSIMD = getenv ("Y4MDENOISE_SIMD");
+		g_bPixelsSSE2 = (cpu_accel() & ACCEL_X86_SSE2) != 0
+			&& (pszSIMD == NULL || strcmp (pszSIMD, "c") != 0);
+	}
+	#endif // __SSE2__
+
+	// If matches should come from block motion vectors, set up the
+	// motion search that finds them.
+	if (denoiser.fast)
+		init_motion_search();
+
 	// If the video is interlaced, that means the denoiser will see
 	// twice as many frames, half their original height.
 	nInterlace = (denoiser.interlaced) ? 2 : 1;
-	
+
+	// Don't cut the frame into bands thinner than the search radius;
+	// they would spend most of their time searching their neighbors'
+	// lines.
+	nRadiusCbCr = denoiser.radiusCbCr / denoiser.frame.ss_v;
+	g_nBands = denoiser.bands;
+	nMaxBands = a_nHeightY / nInterlace / denoiser.radiusY;
+	if (a_nHeightCbCr != 0
+	&& a_nHeightCbCr / nInterlace / nRadiusCbCr < nMaxBands)
+		nMaxBands = a_nHeightCbCr / nInterlace / nRadiusCbCr;
+	if (nMaxBands < 1)
+		nMaxBands = 1;
+	if (g_nBands > nMaxBands)
+	{
+		mjpeg_warn ("Frame is too small for %d bands, using %d",
+			g_nBands, nMaxBands);
+		g_nBands = nMaxBands;
+	}
+
 	// If input/output should be handled in separate threads, set that
 	// up.
 	if (denoiser.threads & 1)
@@ -522,19 +658,34 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 	if (a_nWidthY != 0 && a_nHeightY != 0)
 	{
 		g_bMotionSearcherY = true;
-		g_nPixelsY = (a_nWidthY * a_nHeightY) / nInterlace;
-		g_pPixelsY = new MotionSearcherY::Pixel_t [g_nPixelsY];
-		if (g_pPixelsY == NULL)
+		g_aBandsY = new DenoiserBandY [g_nBands];
+		if (g_aBandsY == NULL)
 			return -1;
-		g_oMotionSearcherY.Init (eStatus, nInterlace * a_nFrames,
-			a_nWidthY, a_nHeightY / nInterlace,
-			denoiser.radiusY, denoiser.radiusY,
-			denoiser.zThresholdY, denoiser.thresholdY,
-			denoiser.matchCountThrottle, denoiser.matchSizeThrottle);
-		if (eStatus != g_kNoError)
+		init_band_lines (g_aBandsY, a_nHeightY / nInterlace,
+			denoiser.radiusY);
+		for (i = 0; i < g_nBands; ++i)
 		{
-			delete[] g_pPixelsY;
-			return -1;
+			DenoiserBandY &rBand = g_aBandsY[i];
+
+			rBand.m_nPixels = a_nWidthY * rBand.m_nLines;
+			rBand.m_pPixels = new MotionSearcherY::Pixel_t
+				[rBand.m_nPixels];
+			if (rBand.m_pPixels == NULL)
+			{
+				delete[] g_aBandsY;
+				return -1;
+			}
+			rBand.m_oMotionSearcher.Init (eStatus,
+				nInterlace * a_nFrames, a_nWidthY, rBand.m_nLines,
+				denoiser.radiusY, denoiser.radiusY,
+				denoiser.zThresholdY, denoiser.thresholdY,
+				denoiser.matchCountThrottle,
+				denoiser.matchSizeThrottle, denoiser.fast != 0);
+			if (eStatus != g_kNoError)
+			{
+				delete[] g_aBandsY;
+				return -1;
+			}
 		}
 	}
 	else
@@ -544,34 +695,60 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 	if (a_nWidthCbCr != 0 && a_nHeightCbCr != 0)
 	{
 		g_bMotionSearcherCbCr = true;
-		g_nPixelsCbCr = (a_nWidthCbCr * a_nHeightCbCr) / nInterlace;
-		g_pPixelsCbCr = new MotionSearcherCbCr::Pixel_t [g_nPixelsCbCr];
-		if (g_pPixelsCbCr == NULL)
+		g_aBandsCbCr = new DenoiserBandCbCr [g_nBands];
+		if (g_aBandsCbCr == NULL)
 		{
-			delete[] g_pPixelsY;
+			delete[] g_aBandsY;
 			return -1;
 		}
-		g_oMotionSearcherCbCr.Init (eStatus, nInterlace * a_nFrames,
-			a_nWidthCbCr, a_nHeightCbCr / nInterlace,
-			denoiser.radiusCbCr / denoiser.frame.ss_h,
-			denoiser.radiusCbCr / denoiser.frame.ss_v,
-			denoiser.zThresholdCbCr, denoiser.thresholdCbCr,
-			denoiser.matchCountThrottle, denoiser.matchSizeThrottle);
-		if (eStatus != g_kNoError)
+		init_band_lines (g_aBandsCbCr, a_nHeightCbCr / nInterlace,
+			nRadiusCbCr);
+		for (i = 0; i < g_nBands; ++i)
 		{
-			delete[] g_pPixelsCbCr;
-			delete[] g_pPixelsY;
-			return -1;
+			DenoiserBandCbCr &rBand = g_aBandsCbCr[i];
+
+			rBand.m_nPixels = a_nWidthCbCr * rBand.m_nLines;
+			rBand.m_pPixels = new MotionSearcherCbCr::Pixel_t
+				[rBand.m_nPixels];
+			if (rBand.m_pPixels == NULL)
+			{
+				delete[] g_aBandsCbCr;
+				delete[] g_aBandsY;
+				return -1;
+			}
+			rBand.m_oMotionSearcher.Init (eStatus,
+				nInterlace * a_nFrames, a_nWidthCbCr, rBand.m_nLines,
+				denoiser.radiusCbCr / denoiser.frame.ss_h,
+				nRadiusCbCr,
+				denoiser.zThresholdCbCr, denoiser.thresholdCbCr,
+				denoiser.matchCountThrottle,
+				denoiser.matchSizeThrottle, denoiser.fast != 0);
+			if (eStatus != g_kNoError)
+			{
+				delete[] g_aBandsCbCr;
+				delete[] g_aBandsY;
+				return -1;
+			}
 		}
 
-		// If color should be denoised in a separate thread, set that
+		// If color should be denoised in separate threads, set that
 		// up.
 		if (denoiser.threads & 2)
-			g_oDenoiserThreadCbCr.Initialize();
+		{
+			g_aoDenoiserThreadCbCr = new DenoiserThreadCbCr [g_nBands];
+			for (i = 0; i < g_nBands; ++i)
+				g_aoDenoiserThreadCbCr[i].Initialize (i);
+		}
 	}
 	else
 		g_bMotionSearcherCbCr = false;
 
+	// Denoise every band after the first in a separate thread.  (The
+	// first one is denoised in the caller's thread.)
+	g_aoDenoiserThreadBand = new DenoiserThreadBand [g_nBands];
+	for (i = 1; i < g_nBands; ++i)
+		g_aoDenoiserThreadBand[i].Initialize (i);
+
 	// Initialization was successful.
 	return 0;
 }
@@ -580,10 +757,22 @@ int newdenoise_init (int a_nFrames, int a_nWidthY, int a_nHeightY,
 int
 newdenoise_shutdown (void)
 {
-	// If color was denoised in a separate thread, shut that down.
+	int i;
+		// Used to loop through bands.
+
+	// Shut down the threads that denoised bands.
+	for (i = 1; i < g_nBands; ++i)
+		g_aoDenoiserThreadBand[i].ForceShutdown();
+	delete[] g_aoDenoiserThreadBand;
+
+	// If color was denoised in separate threads, shut those down.
 	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
-		g_oDenoiserThreadCbCr.ForceShutdown();
-	
+	{
+		for (i = 0; i < g_nBands; ++i)
+			g_aoDenoiserThreadCbCr[i].ForceShutdown();
+		delete[] g_aoDenoiserThreadCbCr;
+	}
+
 	// If reading/writing is being done in separate threads, shut
 	// them down.
 	if (denoiser.threads & 1)
@@ -591,7 +780,15 @@ newdenoise_shutdown (void)
 		g_oDenoiserThreadRead.ForceShutdown();
 		g_oDenoiserThreadWrite.ForceShutdown();
 	}
-	
+
+	// Free the bands, so that the denoiser can be initialized again.
+	if (g_bMotionSearcherY)
+		delete[] g_aBandsY;
+	if (g_bMotionSearcherCbCr)
+		delete[] g_aBandsCbCr;
+	g_aBandsY = NULL;
+	g_aBandsCbCr = NULL;
+
 	// No errors.
 	return 0;
 }
@@ -632,7 +829,7 @@ newdenoise_write_frame (void)
 }
 
 // (This routine isn't used any more, but I think it should be kept around
-// as a reference.)
+// as a reference.  It only handles a frame denoised as a single band.)
 int
 newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	const uint8_t *a_pInputCr, uint8_t *a_pOutputY,
@@ -643,8 +840,13 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	const MotionSearcherY::ReferenceFrame_t *pFrameY;
 	const MotionSearcherCbCr::ReferenceFrame_t *pFrameCbCr;
 		// Denoised frame data, ready for output.
-	int i;
-		// Used to loop through pixels.
+	MotionSearcherY &rMotionSearcherY = g_aBandsY[0].m_oMotionSearcher;
+	MotionSearcherCbCr &rMotionSearcherCbCr
+		= g_aBandsCbCr[0].m_oMotionSearcher;
+		// The denoisers.
+
+	// Make sure there's only one band.
+	assert (g_nBands == 1);
 
 	// No errors yet.
 	eStatus = g_kNoError;
@@ -658,8 +860,8 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 		extern int frame;
 		if (frame % denoiser.frames == 0)
 		{
-			g_oMotionSearcherY.Purge();
-			g_oMotionSearcherCbCr.Purge();
+			rMotionSearcherY.Purge();
+			rMotionSearcherCbCr.Purge();
 		}
 	}
 
@@ -670,13 +872,14 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	{
 		// Get any remaining frame.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+			pFrameY = rMotionSearcherY.GetRemainingFrames();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
-	
+			pFrameCbCr = rMotionSearcherCbCr.GetRemainingFrames();
+
 		// Output it.
-		output_frame (pFrameY, pFrameCbCr, a_pOutputY, a_pOutputCb,
-			a_pOutputCr);
+		output_band_y (g_aBandsY[0], 0, 1, pFrameY, a_pOutputY);
+		output_band_cbcr (g_aBandsCbCr[0], 0, 1, pFrameCbCr,
+			a_pOutputCb, a_pOutputCr);
 	}
 
 	// Otherwise, if there is more input, feed the frame into the
@@ -685,44 +888,39 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	{
 		// Get any frame that's ready for output.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+			pFrameY = rMotionSearcherY.GetFrameReadyForOutput();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
-	
+			pFrameCbCr = rMotionSearcherCbCr.GetFrameReadyForOutput();
+
 		// Output it.
-		output_frame (pFrameY, pFrameCbCr, a_pOutputY, a_pOutputCb,
-			a_pOutputCr);
-	
+		output_band_y (g_aBandsY[0], 0, 1, pFrameY, a_pOutputY);
+		output_band_cbcr (g_aBandsCbCr[0], 0, 1, pFrameCbCr,
+			a_pOutputCb, a_pOutputCr);
+
 		// Pass the input frame to the denoiser.
 		if (g_bMotionSearcherY)
 		{
 			// Convert the input frame into the format needed by the
 			// denoiser.  (This step is a big waste of time & cache.
 			// I wish there was another way.)
-			for (i = 0; i < g_nPixelsY; ++i)
-				g_pPixelsY[i] = PixelY (a_pInputY + i);
+			input_band_y (g_aBandsY[0], 0, 1, a_pInputY);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+			rMotionSearcherY.AddFrame (eStatus, g_aBandsY[0].m_pPixels);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
 		if (g_bMotionSearcherCbCr)
 		{
-			PixelCbCr::Num_t aCbCr[2];
-
 			// Convert the input frame into the format needed by the
 			// denoiser.  (This step is a big waste of time & cache.
 			// I wish there was another way.)
-			for (i = 0; i < g_nPixelsCbCr; ++i)
-			{
-				aCbCr[0] = a_pInputCb[i];
-				aCbCr[1] = a_pInputCr[i];
-				g_pPixelsCbCr[i] = PixelCbCr (aCbCr);
-			}
+			input_band_cbcr (g_aBandsCbCr[0], 0, 1, a_pInputCb,
+				a_pInputCr);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			rMotionSearcherCbCr.AddFrame (eStatus,
+				g_aBandsCbCr[0].m_pPixels);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -740,16 +938,16 @@ newdenoise_frame0 (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 }
 
 int
-newdenoise_frame_intensity (const uint8_t *a_pInputY,
+newdenoise_frame_intensity (int a_nBand, const uint8_t *a_pInputY,
 	uint8_t *a_pOutputY)
 {
 	Status_t eStatus;
 		// An error that may occur.
 	const MotionSearcherY::ReferenceFrame_t *pFrameY;
 		// Denoised frame data, ready for output.
-	int i;
-		// Used to loop through pixels.
-	
+	DenoiserBandY &rBand = g_aBandsY[a_nBand];
+		// The band being denoised.
+
 	// Make sure intensity is being denoised.
 	assert (g_bMotionSearcherY);
 
@@ -763,7 +961,7 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherY.Purge();
+			rBand.m_oMotionSearcher.Purge();
 	}
 
 	// If the end of input has been reached, then return the next
@@ -771,10 +969,10 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 	if (a_pInputY == NULL)
 	{
 		// Get any remaining frame.
-		pFrameY = g_oMotionSearcherY.GetRemainingFrames();
-	
+		pFrameY = rBand.m_oMotionSearcher.GetRemainingFrames();
+
 		// Output it.
-		output_frame (pFrameY, NULL, a_pOutputY, NULL, NULL);
+		output_band_y (rBand, 0, 1, pFrameY, a_pOutputY);
 	}
 
 	// Otherwise, if there is more input, feed the frame into the
@@ -782,19 +980,18 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 	else
 	{
 		// Get any frame that's ready for output.
-		pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
-	
+		pFrameY = rBand.m_oMotionSearcher.GetFrameReadyForOutput();
+
 		// Output it.
-		output_frame (pFrameY, NULL, a_pOutputY, NULL, NULL);
-	
+		output_band_y (rBand, 0, 1, pFrameY, a_pOutputY);
+
 		// Convert the input frame into the format needed by the
 		// denoiser.  (This step is a big waste of time & cache.
 		// I wish there was another way.)
-		for (i = 0; i < g_nPixelsY; ++i)
-			g_pPixelsY[i] = PixelY (a_pInputY + i);
+		input_band_y (rBand, 0, 1, a_pInputY);
 
 		// Pass the frame to the denoiser.
-		g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+		rBand.m_oMotionSearcher.AddFrame (eStatus, rBand.m_pPixels);
 		if (eStatus != g_kNoError)
 			return -1;
 	}
@@ -804,7 +1001,7 @@ newdenoise_frame_intensity (const uint8_t *a_pInputY,
 }
 
 int
-newdenoise_frame_color (const uint8_t *a_pInputCb,
+newdenoise_frame_color (int a_nBand, const uint8_t *a_pInputCb,
 	const uint8_t *a_pInputCr, uint8_t *a_pOutputCb,
 	uint8_t *a_pOutputCr)
 {
@@ -812,9 +1009,9 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 		// An error that may occur.
 	const MotionSearcherCbCr::ReferenceFrame_t *pFrameCbCr;
 		// Denoised frame data, ready for output.
-	int i;
-		// Used to loop through pixels.
-	
+	DenoiserBandCbCr &rBand = g_aBandsCbCr[a_nBand];
+		// The band being denoised.
+
 	// Make sure color is being denoised.
 	assert (g_bMotionSearcherCbCr);
 
@@ -828,7 +1025,7 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherCbCr.Purge();
+			rBand.m_oMotionSearcher.Purge();
 	}
 
 	// If the end of input has been reached, then return the next
@@ -836,10 +1033,11 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 	if (a_pInputCr == NULL)
 	{
 		// Get any remaining frame.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
-	
+		pFrameCbCr = rBand.m_oMotionSearcher.GetRemainingFrames();
+
 		// Output it.
-		output_frame (NULL, pFrameCbCr, NULL, a_pOutputCb, a_pOutputCr);
+		output_band_cbcr (rBand, 0, 1, pFrameCbCr, a_pOutputCb,
+			a_pOutputCr);
 	}
 
 	// Otherwise, if there is more input, feed the frame into the
@@ -847,58 +1045,78 @@ newdenoise_frame_color (const uint8_t *a_pInputCb,
 	else
 	{
 		// Get any frame that's ready for output.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
-	
+		pFrameCbCr = rBand.m_oMotionSearcher.GetFrameReadyForOutput();
+
 		// Output it.
-		output_frame (NULL, pFrameCbCr, NULL, a_pOutputCb, a_pOutputCr);
-	
-		// Pass the input frame to the denoiser.
-		{
-			PixelCbCr::Num_t aCbCr[2];
+		output_band_cbcr (rBand, 0, 1, pFrameCbCr, a_pOutputCb,
+			a_pOutputCr);
 
-			// Convert the input frame into the format needed by the
-			// denoiser.  (This step is a big waste of time & cache.
-			// I wish there was another way.)
-			for (i = 0; i < g_nPixelsCbCr; ++i)
-			{
-				aCbCr[0] = a_pInputCb[i];
-				aCbCr[1] = a_pInputCr[i];
-				g_pPixelsCbCr[i] = PixelCbCr (aCbCr);
-			}
+		// Convert the input frame into the format needed by the
+		// denoiser.  (This step is a big waste of time & cache.
+		// I wish there was another way.)
+		input_band_cbcr (rBand, 0, 1, a_pInputCb, a_pInputCr);
 
-			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
-			if (eStatus != g_kNoError)
-				return -1;
-		}
+		// Pass the frame to the denoiser.
+		rBand.m_oMotionSearcher.AddFrame (eStatus, rBand.m_pPixels);
+		if (eStatus != g_kNoError)
+			return -1;
 	}
 
 	// Return whether there was an output frame this time.
 	return (pFrameCbCr != NULL) ? 0 : 1;
 }
 
-int
-newdenoise_frame (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
-	const uint8_t *a_pInputCr, uint8_t *a_pOutputY,
-	uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
+// Denoise all the bands of a frame or a pair of fields.
+static int
+newdenoise_bands (bool a_bInterlaced, const uint8_t *a_pInputY,
+	const uint8_t *a_pInputCb, const uint8_t *a_pInputCr,
+	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
 {
-	int bY, bCbCr;
+	int bY, bCbCr, bBand;
+	int i;
+		// Used to loop through bands.
 
 	// Make the compiler shut up.
 	bY = bCbCr = 0;
 
-	// Denoise intensity & color.  (Do intensity in the current
-	// thread.)
+	// Denoise intensity & color.  (The first band's intensity is
+	// denoised in the current thread.)
 	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
-		g_oDenoiserThreadCbCr.AddFrame (a_pInputCb, a_pInputCr,
-			a_pOutputCb, a_pOutputCr);
+		for (i = 0; i < g_nBands; ++i)
+			g_aoDenoiserThreadCbCr[i].AddFrame (a_pInputCb, a_pInputCr,
+				a_pOutputCb, a_pOutputCr);
+	for (i = 1; i < g_nBands; ++i)
+		g_aoDenoiserThreadBand[i].AddFrame (a_pInputY, a_pInputCb,
+			a_pInputCr, a_pOutputY, a_pOutputCb, a_pOutputCr);
 	if (g_bMotionSearcherY)
-		bY = newdenoise_frame_intensity (a_pInputY, a_pOutputY);
+		bY = ((a_bInterlaced)
+				? newdenoise_interlaced_frame_intensity
+				: newdenoise_frame_intensity)
+			(0, a_pInputY, a_pOutputY);
 	if (g_bMotionSearcherCbCr && !(denoiser.threads & 2))
-		bCbCr = newdenoise_frame_color (a_pInputCb, a_pInputCr,
-			a_pOutputCb, a_pOutputCr);
+		bCbCr = ((a_bInterlaced)
+				? newdenoise_interlaced_frame_color
+				: newdenoise_frame_color)
+			(0, a_pInputCb, a_pInputCr, a_pOutputCb, a_pOutputCr);
+
+	// Wait for the other bands.  (They're all fed the same frames, so
+	// they all have output at the same time; only errors need to be
+	// passed on.)
+	for (i = 1; i < g_nBands; ++i)
+	{
+		bBand = g_aoDenoiserThreadBand[i].WaitForAddFrame();
+		if (bBand < 0)
+			bY = bBand;
+	}
 	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
-		bCbCr = g_oDenoiserThreadCbCr.WaitForAddFrame();
+	{
+		for (i = 0; i < g_nBands; ++i)
+		{
+			bBand = g_aoDenoiserThreadCbCr[i].WaitForAddFrame();
+			if (i == 0 || bBand < 0)
+				bCbCr = bBand;
+		}
+	}
 
 	// If we're denoising both color & intensity, make sure we
 	// either got two reference frames or none at all.  (This is
@@ -907,62 +1125,143 @@ newdenoise_frame (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
 	assert (!g_bMotionSearcherY || !g_bMotionSearcherCbCr
 		|| (bY != 0 && bCbCr != 0)
 		|| (bY == 0 && bCbCr == 0));
-	
+
 	// Return 0 if there are no errors.
 	return (bY) ? bY : bCbCr;
 }
 
-static void output_frame
-	(const MotionSearcherY::ReferenceFrame_t *a_pFrameY,
-	const MotionSearcherCbCr::ReferenceFrame_t *a_pFrameCbCr,
-	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
+int
+newdenoise_frame (const uint8_t *a_pInputY, const uint8_t *a_pInputCb,
+	const uint8_t *a_pInputCr, uint8_t *a_pOutputY,
+	uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
 {
-	int i;
+	// Easy enough.
+	return newdenoise_bands (false, a_pInputY, a_pInputCb, a_pInputCr,
+		a_pOutputY, a_pOutputCb, a_pOutputCr);
+}
+
+// Convert the searched lines of an intensity band into the format
+// needed by the denoiser.  Band line y is taken from frame line
+// (y * a_nStep + a_nMask), i.e. a_nStep is 2 when denoising fields.
+static void
+input_band_y (DenoiserBandY &a_rBand, int a_nMask, int a_nStep,
+	const uint8_t *a_pInputY)
+{
+	int i, x, y;
 		// Used to loop through pixels.
 
-	// Convert any denoised intensity frame into the format expected
-	// by our caller.
-	if (a_pFrameY != NULL)
+	for (i = 0, y = a_rBand.m_nFirstLine;
+		y < a_rBand.m_nFirstLine + a_rBand.m_nLines; ++y)
 	{
-		ReferencePixelY *pY;
-			// The pixel, as it's being converted to the output format.
+		const uint8_t *pInputY
+			= a_pInputY + (y * a_nStep + a_nMask) * g_nWidthY;
+		for (x = 0; x < g_nWidthY; ++x, ++i)
+			a_rBand.m_pPixels[i] = PixelY (pInputY + x);
+	}
+	assert (i == a_rBand.m_nPixels);
+}
+
+// Convert the searched lines of a color band into the format needed
+// by the denoiser.
+static void
+input_band_cbcr (DenoiserBandCbCr &a_rBand, int a_nMask, int a_nStep,
+	const uint8_t *a_pInputCb, const uint8_t *a_pInputCr)
+{
+	int i, x, y;
+		// Used to loop through pixels.
+	PixelCbCr::Num_t aCbCr[2];
+		// One color pixel.
+
+	for (i = 0, y = a_rBand.m_nFirstLine;
+		y < a_rBand.m_nFirstLine + a_rBand.m_nLines; ++y)
+	{
+		int nOffset = (y * a_nStep + a_nMask) * g_nWidthCbCr;
+		for (x = 0; x < g_nWidthCbCr; ++x, ++i)
+		{
+			aCbCr[0] = a_pInputCb[nOffset + x];
+			aCbCr[1] = a_pInputCr[nOffset + x];
+			a_rBand.m_pPixels[i] = PixelCbCr (aCbCr);
+		}
+	}
+	assert (i == a_rBand.m_nPixels);
+}
+
+// Convert any denoised intensity band into the format expected by our
+// caller.  Only the lines the band owns are written.
+static void
+output_band_y (const DenoiserBandY &a_rBand, int a_nMask, int a_nStep,
+	const MotionSearcherY::ReferenceFrame_t *a_pFrameY,
+	uint8_t *a_pOutputY)
+{
+	int i, x, y;
+		// Used to loop through pixels.
+	ReferencePixelY *pY;
+		// The pixel, as it's being converted to the output format.
+
+	// If there's no frame, there's nothing to do.
+	if (a_pFrameY == NULL)
+		return;
 
-		// Make sure our caller gave us somewhere to write output.
-		assert (a_pOutputY != NULL);
+	// Make sure our caller gave us somewhere to write output.
+	assert (a_pOutputY != NULL);
 
-		// Loop through all the pixels, convert them to the output
-		// format.
-		for (i = 0; i < g_nPixelsY; ++i)
+	// Loop through all the pixels, convert them to the output
+	// format.
+	for (y = a_rBand.m_nFirstOwnLine;
+		y < a_rBand.m_nFirstOwnLine + a_rBand.m_nOwnLines; ++y)
+	{
+		uint8_t *pOutputY
+			= a_pOutputY + (y * a_nStep + a_nMask) * g_nWidthY;
+		i = (y - a_rBand.m_nFirstLine) * g_nWidthY;
+		for (x = 0; x < g_nWidthY; ++x, ++i)
 		{
 			pY = a_pFrameY->GetPixel (i);
 			assert (pY != NULL);
 			const PixelY &rY = pY->GetValue();
-			a_pOutputY[i] = rY[0];
+			pOutputY[x] = rY[0];
 		}
 	}
-	if (a_pFrameCbCr != NULL)
-	{
-		ReferencePixelCbCr *pCbCr;
-			// The pixel, as it's being converted to the output format.
+}
+
+// Convert any denoised color band into the format expected by our
+// caller.  Only the lines the band owns are written.
+static void
+output_band_cbcr (const DenoiserBandCbCr &a_rBand, int a_nMask,
+	int a_nStep, const MotionSearcherCbCr::ReferenceFrame_t *a_pFrameCbCr,
+	uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
+{
+	int i, x, y;
+		// Used to loop through pixels.
+	ReferencePixelCbCr *pCbCr;
+		// The pixel, as it's being converted to the output format.
 
-		// Make sure our caller gave us somewhere to write output.
-		assert (a_pOutputCb != NULL && a_pOutputCr != NULL);
+	// If there's no frame, there's nothing to do.
+	if (a_pFrameCbCr == NULL)
+		return;
 
-		// Loop through all the pixels, convert them to the output
-		// format.
-		for (i = 0; i < g_nPixelsCbCr; ++i)
+	// Make sure our caller gave us somewhere to write output.
+	assert (a_pOutputCb != NULL && a_pOutputCr != NULL);
+
+	// Loop through all the pixels, convert them to the output
+	// format.
+	for (y = a_rBand.m_nFirstOwnLine;
+		y < a_rBand.m_nFirstOwnLine + a_rBand.m_nOwnLines; ++y)
+	{
+		int nOffset = (y * a_nStep + a_nMask) * g_nWidthCbCr;
+		i = (y - a_rBand.m_nFirstLine) * g_nWidthCbCr;
+		for (x = 0; x < g_nWidthCbCr; ++x, ++i)
 		{
 			pCbCr = a_pFrameCbCr->GetPixel (i);
 			assert (pCbCr != NULL);
 			const PixelCbCr &rCbCr = pCbCr->GetValue();
-			a_pOutputCb[i] = rCbCr[0];
-			a_pOutputCr[i] = rCbCr[1];
+			a_pOutputCb[nOffset + x] = rCbCr[0];
+			a_pOutputCr[nOffset + x] = rCbCr[1];
 		}
 	}
 }
 
 // (This routine isn't used any more, but I think it should be kept around
-// as a reference.)
+// as a reference.  It only handles a frame denoised as a single band.)
 int
 newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 	const uint8_t *a_pInputCb, const uint8_t *a_pInputCr,
@@ -973,12 +1272,17 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 	const MotionSearcherY::ReferenceFrame_t *pFrameY;
 	const MotionSearcherCbCr::ReferenceFrame_t *pFrameCbCr;
 		// Denoised frame data, ready for output.
-	int i, x, y;
-		// Used to loop through pixels.
+	MotionSearcherY &rMotionSearcherY = g_aBandsY[0].m_oMotionSearcher;
+	MotionSearcherCbCr &rMotionSearcherCbCr
+		= g_aBandsCbCr[0].m_oMotionSearcher;
+		// The denoisers.
 	int nMask;
 		// Used to switch between top-field interlacing and bottom-field
 		// interlacing.
 
+	// Make sure there's only one band.
+	assert (g_nBands == 1);
+
 	// No errors yet.
 	eStatus = g_kNoError;
 
@@ -991,8 +1295,8 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 		extern int frame;
 		if (frame % denoiser.frames == 0)
 		{
-			g_oMotionSearcherY.Purge();
-			g_oMotionSearcherCbCr.Purge();
+			rMotionSearcherY.Purge();
+			rMotionSearcherCbCr.Purge();
 		}
 	}
 
@@ -1006,22 +1310,24 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 	{
 		// Get 1/2 any remaining frame.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+			pFrameY = rMotionSearcherY.GetRemainingFrames();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
-	
+			pFrameCbCr = rMotionSearcherCbCr.GetRemainingFrames();
+
 		// Output it.
-		output_field (nMask ^ 0, pFrameY, pFrameCbCr, a_pOutputY,
+		output_band_y (g_aBandsY[0], nMask ^ 0, 2, pFrameY, a_pOutputY);
+		output_band_cbcr (g_aBandsCbCr[0], nMask ^ 0, 2, pFrameCbCr,
 			a_pOutputCb, a_pOutputCr);
 
 		// Get 1/2 any remaining frame.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetRemainingFrames();
+			pFrameY = rMotionSearcherY.GetRemainingFrames();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
-	
+			pFrameCbCr = rMotionSearcherCbCr.GetRemainingFrames();
+
 		// Output it.
-		output_field (nMask ^ 1, pFrameY, pFrameCbCr, a_pOutputY,
+		output_band_y (g_aBandsY[0], nMask ^ 1, 2, pFrameY, a_pOutputY);
+		output_band_cbcr (g_aBandsCbCr[0], nMask ^ 1, 2, pFrameCbCr,
 			a_pOutputCb, a_pOutputCr);
 	}
 
@@ -1031,98 +1337,74 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 	{
 		// Get 1/2 any frame that's ready for output.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+			pFrameY = rMotionSearcherY.GetFrameReadyForOutput();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
-	
+			pFrameCbCr = rMotionSearcherCbCr.GetFrameReadyForOutput();
+
 		// Output it.
-		output_field (nMask ^ 0, pFrameY, pFrameCbCr, a_pOutputY,
+		output_band_y (g_aBandsY[0], nMask ^ 0, 2, pFrameY, a_pOutputY);
+		output_band_cbcr (g_aBandsCbCr[0], nMask ^ 0, 2, pFrameCbCr,
 			a_pOutputCb, a_pOutputCr);
-	
+
 		// Pass the input frame to the denoiser.
 		if (g_bMotionSearcherY)
 		{
 			// Convert the input frame into the format needed by the
 			// denoiser.
-			for (i = 0, y = (nMask ^ 0); y < g_nHeightY; y += 2)
-				for (x = 0; x < g_nWidthY; ++x, ++i)
-					g_pPixelsY[i]
-						= PixelY (a_pInputY + (y * g_nWidthY + x));
-			assert (i == g_nPixelsY);
+			input_band_y (g_aBandsY[0], nMask ^ 0, 2, a_pInputY);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+			rMotionSearcherY.AddFrame (eStatus, g_aBandsY[0].m_pPixels);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
 		if (g_bMotionSearcherCbCr)
 		{
-			PixelCbCr::Num_t aCbCr[2];
-
 			// Convert the input frame into the format needed by the
 			// denoiser.
-			for (i = 0, y = (nMask ^ 0); y < g_nHeightCbCr; y += 2)
-			{
-				for (x = 0; x < g_nWidthCbCr; ++x, ++i)
-				{
-					aCbCr[0] = a_pInputCb[y * g_nWidthCbCr + x];
-					aCbCr[1] = a_pInputCr[y * g_nWidthCbCr + x];
-					g_pPixelsCbCr[i] = PixelCbCr (aCbCr);
-				}
-			}
-			assert (i == g_nPixelsCbCr);
+			input_band_cbcr (g_aBandsCbCr[0], nMask ^ 0, 2, a_pInputCb,
+				a_pInputCr);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			rMotionSearcherCbCr.AddFrame (eStatus,
+				g_aBandsCbCr[0].m_pPixels);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
-	
+
 		// Get 1/2 any frame that's ready for output.
 		if (g_bMotionSearcherY)
-			pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
+			pFrameY = rMotionSearcherY.GetFrameReadyForOutput();
 		if (g_bMotionSearcherCbCr)
-			pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
-	
+			pFrameCbCr = rMotionSearcherCbCr.GetFrameReadyForOutput();
+
 		// Output it.
-		output_field (nMask ^ 1, pFrameY, pFrameCbCr, a_pOutputY,
+		output_band_y (g_aBandsY[0], nMask ^ 1, 2, pFrameY, a_pOutputY);
+		output_band_cbcr (g_aBandsCbCr[0], nMask ^ 1, 2, pFrameCbCr,
 			a_pOutputCb, a_pOutputCr);
-	
+
 		// Pass the input frame to the denoiser.
 		if (g_bMotionSearcherY)
 		{
 			// Convert the input frame into the format needed by the
 			// denoiser.
-			for (i = 0, y = (nMask ^ 1); y < g_nHeightY; y += 2)
-				for (x = 0; x < g_nWidthY; ++x, ++i)
-					g_pPixelsY[i]
-						= PixelY (a_pInputY + (y * g_nWidthY + x));
-			assert (i == g_nPixelsY);
+			input_band_y (g_aBandsY[0], nMask ^ 1, 2, a_pInputY);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+			rMotionSearcherY.AddFrame (eStatus, g_aBandsY[0].m_pPixels);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
 		if (g_bMotionSearcherCbCr)
 		{
-			PixelCbCr::Num_t aCbCr[2];
-
 			// Convert the input frame into the format needed by the
 			// denoiser.
-			for (i = 0, y = (nMask ^ 1); y < g_nHeightCbCr; y += 2)
-			{
-				for (x = 0; x < g_nWidthCbCr; ++x, ++i)
-				{
-					aCbCr[0] = a_pInputCb[y * g_nWidthCbCr + x];
-					aCbCr[1] = a_pInputCr[y * g_nWidthCbCr + x];
-					g_pPixelsCbCr[i] = PixelCbCr (aCbCr);
-				}
-			}
-			assert (i == g_nPixelsCbCr);
+			input_band_cbcr (g_aBandsCbCr[0], nMask ^ 1, 2, a_pInputCb,
+				a_pInputCr);
 
 			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
+			rMotionSearcherCbCr.AddFrame (eStatus,
+				g_aBandsCbCr[0].m_pPixels);
 			if (eStatus != g_kNoError)
 				return -1;
 		}
@@ -1140,19 +1422,19 @@ newdenoise_interlaced_frame0 (const uint8_t *a_pInputY,
 }
 
 int
-newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
-	uint8_t *a_pOutputY)
+newdenoise_interlaced_frame_intensity (int a_nBand,
+	const uint8_t *a_pInputY, uint8_t *a_pOutputY)
 {
 	Status_t eStatus;
 		// An error that may occur.
 	const MotionSearcherY::ReferenceFrame_t *pFrameY;
 		// Denoised frame data, ready for output.
-	int i, x, y;
-		// Used to loop through pixels.
+	DenoiserBandY &rBand = g_aBandsY[a_nBand];
+		// The band being denoised.
 	int nMask;
 		// Used to switch between top-field interlacing and bottom-field
 		// interlacing.
-	
+
 	// Make sure intensity is being denoised.
 	assert (g_bMotionSearcherY);
 
@@ -1166,7 +1448,7 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherY.Purge();
+			rBand.m_oMotionSearcher.Purge();
 	}
 
 	// Set up for the type of interlacing.
@@ -1177,16 +1459,16 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 	if (a_pInputY == NULL)
 	{
 		// Get 1/2 any remaining frame.
-		pFrameY = g_oMotionSearcherY.GetRemainingFrames();
-	
+		pFrameY = rBand.m_oMotionSearcher.GetRemainingFrames();
+
 		// Output it.
-		output_field (nMask ^ 0, pFrameY, NULL, a_pOutputY, NULL, NULL);
+		output_band_y (rBand, nMask ^ 0, 2, pFrameY, a_pOutputY);
 
 		// Get 1/2 any remaining frame.
-		pFrameY = g_oMotionSearcherY.GetRemainingFrames();
-	
+		pFrameY = rBand.m_oMotionSearcher.GetRemainingFrames();
+
 		// Output it.
-		output_field (nMask ^ 1, pFrameY, NULL, a_pOutputY, NULL, NULL);
+		output_band_y (rBand, nMask ^ 1, 2, pFrameY, a_pOutputY);
 	}
 
 	// Otherwise, if there is more input, feed the frame into the
@@ -1194,40 +1476,32 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 	else
 	{
 		// Get 1/2 any frame that's ready for output.
-		pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
-	
+		pFrameY = rBand.m_oMotionSearcher.GetFrameReadyForOutput();
+
 		// Output it.
-		output_field (nMask ^ 0, pFrameY, NULL, a_pOutputY, NULL, NULL);
-	
+		output_band_y (rBand, nMask ^ 0, 2, pFrameY, a_pOutputY);
+
 		// Convert the input frame into the format needed by the
 		// denoiser.
-		for (i = 0, y = (nMask ^ 0); y < g_nHeightY; y += 2)
-			for (x = 0; x < g_nWidthY; ++x, ++i)
-				g_pPixelsY[i]
-					= PixelY (a_pInputY + (y * g_nWidthY + x));
-		assert (i == g_nPixelsY);
+		input_band_y (rBand, nMask ^ 0, 2, a_pInputY);
 
 		// Pass the frame to the denoiser.
-		g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+		rBand.m_oMotionSearcher.AddFrame (eStatus, rBand.m_pPixels);
 		if (eStatus != g_kNoError)
 			return -1;
-	
+
 		// Get 1/2 any frame that's ready for output.
-		pFrameY = g_oMotionSearcherY.GetFrameReadyForOutput();
-	
+		pFrameY = rBand.m_oMotionSearcher.GetFrameReadyForOutput();
+
 		// Output it.
-		output_field (nMask ^ 1, pFrameY, NULL, a_pOutputY, NULL, NULL);
-	
+		output_band_y (rBand, nMask ^ 1, 2, pFrameY, a_pOutputY);
+
 		// Convert the input frame into the format needed by the
 		// denoiser.
-		for (i = 0, y = (nMask ^ 1); y < g_nHeightY; y += 2)
-			for (x = 0; x < g_nWidthY; ++x, ++i)
-				g_pPixelsY[i]
-					= PixelY (a_pInputY + (y * g_nWidthY + x));
-		assert (i == g_nPixelsY);
+		input_band_y (rBand, nMask ^ 1, 2, a_pInputY);
 
 		// Pass the frame to the denoiser.
-		g_oMotionSearcherY.AddFrame (eStatus, g_pPixelsY);
+		rBand.m_oMotionSearcher.AddFrame (eStatus, rBand.m_pPixels);
 		if (eStatus != g_kNoError)
 			return -1;
 	}
@@ -1237,20 +1511,20 @@ newdenoise_interlaced_frame_intensity (const uint8_t *a_pInputY,
 }
 
 int
-newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
-	const uint8_t *a_pInputCr, uint8_t *a_pOutputCb,
-	uint8_t *a_pOutputCr)
+newdenoise_interlaced_frame_color (int a_nBand,
+	const uint8_t *a_pInputCb, const uint8_t *a_pInputCr,
+	uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
 {
 	Status_t eStatus;
 		// An error that may occur.
 	const MotionSearcherCbCr::ReferenceFrame_t *pFrameCbCr;
 		// Denoised frame data, ready for output.
-	int i, x, y;
-		// Used to loop through pixels.
+	DenoiserBandCbCr &rBand = g_aBandsCbCr[a_nBand];
+		// The band being denoised.
 	int nMask;
 		// Used to switch between top-field interlacing and bottom-field
 		// interlacing.
-	
+
 	// Make sure color is being denoised.
 	assert (g_bMotionSearcherCbCr);
 
@@ -1264,7 +1538,7 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 	{
 		extern int frame;
 		if (frame % denoiser.frames == 0)
-			g_oMotionSearcherCbCr.Purge();
+			rBand.m_oMotionSearcher.Purge();
 	}
 
 	// Set up for the type of interlacing.
@@ -1275,17 +1549,17 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 	if (a_pInputCr == NULL)
 	{
 		// Get 1/2 any remaining frame.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
-	
+		pFrameCbCr = rBand.m_oMotionSearcher.GetRemainingFrames();
+
 		// Output it.
-		output_field (nMask ^ 0, NULL, pFrameCbCr, NULL, a_pOutputCb,
+		output_band_cbcr (rBand, nMask ^ 0, 2, pFrameCbCr, a_pOutputCb,
 			a_pOutputCr);
 
 		// Get 1/2 any remaining frame.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetRemainingFrames();
-	
+		pFrameCbCr = rBand.m_oMotionSearcher.GetRemainingFrames();
+
 		// Output it.
-		output_field (nMask ^ 1, NULL, pFrameCbCr, NULL, a_pOutputCb,
+		output_band_cbcr (rBand, nMask ^ 1, 2, pFrameCbCr, a_pOutputCb,
 			a_pOutputCr);
 	}
 
@@ -1294,64 +1568,36 @@ newdenoise_interlaced_frame_color (const uint8_t *a_pInputCb,
 	else
 	{
 		// Get 1/2 any frame that's ready for output.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
-	
+		pFrameCbCr = rBand.m_oMotionSearcher.GetFrameReadyForOutput();
+
 		// Output it.
-		output_field (nMask ^ 0, NULL, pFrameCbCr, NULL, a_pOutputCb,
+		output_band_cbcr (rBand, nMask ^ 0, 2, pFrameCbCr, a_pOutputCb,
 			a_pOutputCr);
-	
-		// Pass the input frame to the denoiser.
-		{
-			PixelCbCr::Num_t aCbCr[2];
 
-			// Convert the input frame into the format needed by the
-			// denoiser.
-			for (i = 0, y = (nMask ^ 0); y < g_nHeightCbCr; y += 2)
-			{
-				for (x = 0; x < g_nWidthCbCr; ++x, ++i)
-				{
-					aCbCr[0] = a_pInputCb[y * g_nWidthCbCr + x];
-					aCbCr[1] = a_pInputCr[y * g_nWidthCbCr + x];
-					g_pPixelsCbCr[i] = PixelCbCr (aCbCr);
-				}
-			}
-			assert (i == g_nPixelsCbCr);
+		// Convert the input frame into the format needed by the
+		// denoiser.
+		input_band_cbcr (rBand, nMask ^ 0, 2, a_pInputCb, a_pInputCr);
+
+		// Pass the frame to the denoiser.
+		rBand.m_oMotionSearcher.AddFrame (eStatus, rBand.m_pPixels);
+		if (eStatus != g_kNoError)
+			return -1;
 
-			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
-			if (eStatus != g_kNoError)
-				return -1;
-		}
-	
 		// Get 1/2 any frame that's ready for output.
-		pFrameCbCr = g_oMotionSearcherCbCr.GetFrameReadyForOutput();
-	
+		pFrameCbCr = rBand.m_oMotionSearcher.GetFrameReadyForOutput();
+
 		// Output it.
-		output_field (nMask ^ 1, NULL, pFrameCbCr, NULL, a_pOutputCb,
+		output_band_cbcr (rBand, nMask ^ 1, 2, pFrameCbCr, a_pOutputCb,
 			a_pOutputCr);
-	
-		// Pass the input frame to the denoiser.
-		{
-			PixelCbCr::Num_t aCbCr[2];
 
-			// Convert the input frame into the format needed by the
-			// denoiser.
-			for (i = 0, y = (nMask ^ 1); y < g_nHeightCbCr; y += 2)
-			{
-				for (x = 0; x < g_nWidthCbCr; ++x, ++i)
-				{
-					aCbCr[0] = a_pInputCb[y * g_nWidthCbCr + x];
-					aCbCr[1] = a_pInputCr[y * g_nWidthCbCr + x];
-					g_pPixelsCbCr[i] = PixelCbCr (aCbCr);
-				}
-			}
-			assert (i == g_nPixelsCbCr);
+		// Convert the input frame into the format needed by the
+		// denoiser.
+		input_band_cbcr (rBand, nMask ^ 1, 2, a_pInputCb, a_pInputCr);
 
-			// Pass the frame to the denoiser.
-			g_oMotionSearcherCbCr.AddFrame (eStatus, g_pPixelsCbCr);
-			if (eStatus != g_kNoError)
-				return -1;
-		}
+		// Pass the frame to the denoiser.
+		rBand.m_oMotionSearcher.AddFrame (eStatus, rBand.m_pPixels);
+		if (eStatus != g_kNoError)
+			return -1;
 	}
 
 	// Return whether there was an output frame this time.
@@ -1363,88 +1609,9 @@ newdenoise_interlaced_frame (const uint8_t *a_pInputY,
 	const uint8_t *a_pInputCb, const uint8_t *a_pInputCr,
 	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
 {
-	int bY, bCbCr;
-
-	// Make the compiler shut up.
-	bY = bCbCr = 0;
-
-	// Denoise intensity & color.  (Intensity is denoised in the
-	// current thread.)
-	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
-		g_oDenoiserThreadCbCr.AddFrame (a_pInputCb, a_pInputCr,
-			a_pOutputCb, a_pOutputCr);
-	if (g_bMotionSearcherY)
-		bY = newdenoise_interlaced_frame_intensity (a_pInputY,
-			a_pOutputY);
-	if (g_bMotionSearcherCbCr && !(denoiser.threads & 2))
-		bCbCr = newdenoise_interlaced_frame_color (a_pInputCb,
-			a_pInputCr, a_pOutputCb, a_pOutputCr);
-	if (g_bMotionSearcherCbCr && (denoiser.threads & 2))
-		bCbCr = g_oDenoiserThreadCbCr.WaitForAddFrame();
-
-	// If we're denoising both color & intensity, make sure we
-	// either got two reference frames or none at all.
-	assert (!g_bMotionSearcherY || !g_bMotionSearcherCbCr
-		|| (bY != 0 && bCbCr != 0)
-		|| (bY == 0 && bCbCr == 0));
-	
-	// Return 0 if there are no errors.
-	return (bY) ? bY : bCbCr;
-}
-
-static void output_field
-	(int a_nMask, const MotionSearcherY::ReferenceFrame_t *a_pFrameY,
-	const MotionSearcherCbCr::ReferenceFrame_t *a_pFrameCbCr,
-	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
-{
-	int i, x, y;
-		// Used to loop through pixels.
-
-	// Convert any denoised intensity frame into the format expected
-	// by our caller.
-	if (a_pFrameY != NULL)
-	{
-		ReferencePixelY *pY;
-			// The pixel, as it's being converted to the output format.
-
-		// Make sure our caller gave us somewhere to write output.
-		assert (a_pOutputY != NULL);
-
-		// Loop through all the pixels, convert them to the output
-		// format.
-		for (i = 0, y = a_nMask; y < g_nHeightY; y += 2)
-		{
-			for (x = 0; x < g_nWidthY; ++x, ++i)
-			{
-				pY = a_pFrameY->GetPixel (i);
-				assert (pY != NULL);
-				const PixelY &rY = pY->GetValue();
-				a_pOutputY[y * g_nWidthY + x] = rY[0];
-			}
-		}
-	}
-	if (a_pFrameCbCr != NULL)
-	{
-		ReferencePixelCbCr *pCbCr;
-			// The pixel, as it's being converted to the output format.
-
-		// Make sure our caller gave us somewhere to write output.
-		assert (a_pOutputCb != NULL && a_pOutputCr != NULL);
-
-		// Loop through all the pixels, convert them to the output
-		// format.
-		for (i = 0, y = a_nMask; y < g_nHeightCbCr; y += 2)
-		{
-			for (x = 0; x < g_nWidthCbCr; ++x, ++i)
-			{
-				pCbCr = a_pFrameCbCr->GetPixel (i);
-				assert (pCbCr != NULL);
-				const PixelCbCr &rCbCr = pCbCr->GetValue();
-				a_pOutputCb[y * g_nWidthCbCr + x] = rCbCr[0];
-				a_pOutputCr[y * g_nWidthCbCr + x] = rCbCr[1];
-			}
-		}
-	}
+	// Easy enough.
+	return newdenoise_bands (true, a_pInputY, a_pInputCb, a_pInputCr,
+		a_pOutputY, a_pOutputCb, a_pOutputCr);
 }
 
 
@@ -1552,6 +1719,345 @@ PixelCbCr::IsWithinTolerance
 
 
 
+// Compare two arrays of pixels one pixel at a time.
+// This is what Pixel<>::IsWithinTolerance() does for arrays of pixels
+// that don't have a faster version.
+template <class PIXEL>
+static bool
+pixels_within_tolerance (const PIXEL *a_pThese, const PIXEL *a_pOthers,
+	int a_nPixels, int32_t a_tnTolerance, int32_t &a_rtnSAD)
+{
+	a_rtnSAD = 0;
+	for (int i = 0; i < a_nPixels; ++i)
+	{
+		int32_t tnSAD;
+		if (!a_pThese[i].IsWithinTolerance (a_pOthers[i], a_tnTolerance,
+				tnSAD))
+			return false;
+		a_rtnSAD += tnSAD;
+	}
+	return true;
+}
+
+
+
+// Compare an array of pixels with split values one value at a time.
+// This is what Pixel<>::CompareWithSplit() does for arrays of pixels
+// that don't have a faster version.
+template <class PIXEL, int DIM>
+static void
+pixels_compare_with_split (const PIXEL *a_pThese, const PIXEL *a_pSplits,
+	int a_nPixels, int32_t a_tnTolerance, uint32_t &a_rnGreater,
+	bool &a_rbEqual, bool &a_rbWithinTolerance)
+{
+	a_rnGreater = 0;
+	a_rbEqual = a_rbWithinTolerance = false;
+	for (int p = 0; p < a_nPixels; ++p)
+	{
+		for (int i = 0; i < DIM; ++i)
+		{
+			if (a_pThese[p][i] == a_pSplits[p][i])
+				a_rbEqual = true;
+			if (a_pThese[p][i] > a_pSplits[p][i])
+				a_rnGreater |= uint32_t (1) << (p * DIM + i);
+			if (!a_rbWithinTolerance)
+			{
+				PIXEL oThis = a_pThese[p];
+				for (int j = 0; j < DIM; ++j)
+					if (j != i)
+						oThis[j] = a_pSplits[p][j];
+				if (oThis.IsWithinTolerance (a_pSplits[p], a_tnTolerance))
+					a_rbWithinTolerance = true;
+			}
+		}
+	}
+}
+
+
+
+#ifdef __SSE2__
+
+// The SSE2 versions work on pixel-groups of 8 samples, i.e. 8 intensity
+// pixels or 4 color pixels.  (The pixel classes are nothing but their
+// samples, so an array of pixels is an array of samples.)
+
+// Return true if each of 8 intensity pixels is within the tolerance of
+// the corresponding other pixel, and backpatch the sum of their absolute
+// differences.
+static inline bool
+pixels_within_tolerance_y_sse2 (const uint8_t *a_pThese,
+	const uint8_t *a_pOthers, int32_t a_tnTolerance, int32_t &a_rtnSAD)
+{
+	__m128i a = _mm_loadl_epi64 ((const __m128i *) a_pThese);
+	__m128i b = _mm_loadl_epi64 ((const __m128i *) a_pOthers);
+
+	// Every absolute difference has to be within the tolerance.
+	if (a_tnTolerance < 0)
+		return false;
+	if (a_tnTolerance < 255)
+	{
+		__m128i d = _mm_or_si128 (_mm_subs_epu8 (a, b),
+			_mm_subs_epu8 (b, a));
+		__m128i over = _mm_subs_epu8 (d,
+			_mm_set1_epi8 (char (a_tnTolerance)));
+		if ((_mm_movemask_epi8 (_mm_cmpeq_epi8 (over,
+				_mm_setzero_si128())) & 0xff) != 0xff)
+			return false;
+	}
+
+	// Sum up the absolute differences.
+	a_rtnSAD = _mm_cvtsi128_si32 (_mm_sad_epu8 (a, b));
+	return true;
+}
+
+
+
+// Return true if each of 4 color pixels is within the tolerance of the
+// corresponding other pixel, and backpatch the sum of their squared
+// distances.
+static inline bool
+pixels_within_tolerance_cbcr_sse2 (const uint8_t *a_pThese,
+	const uint8_t *a_pOthers, int32_t a_tnTolerance, int32_t &a_rtnSAD)
+{
+	__m128i z = _mm_setzero_si128();
+	__m128i a = _mm_unpacklo_epi8
+		(_mm_loadl_epi64 ((const __m128i *) a_pThese), z);
+	__m128i b = _mm_unpacklo_epi8
+		(_mm_loadl_epi64 ((const __m128i *) a_pOthers), z);
+
+	// Get each pixel's squared distance, i.e. dCb*dCb + dCr*dCr.
+	__m128i d = _mm_sub_epi16 (a, b);
+	__m128i sq = _mm_madd_epi16 (d, d);
+
+	// Every distance has to be within the tolerance.
+	if (_mm_movemask_epi8 (_mm_cmpgt_epi32 (sq,
+			_mm_set1_epi32 (a_tnTolerance))) != 0)
+		return false;
+
+	// Sum up the distances.
+	sq = _mm_add_epi32 (sq, _mm_shuffle_epi32 (sq, _MM_SHUFFLE (1,0,3,2)));
+	sq = _mm_add_epi32 (sq, _mm_shuffle_epi32 (sq, _MM_SHUFFLE (2,3,0,1)));
+	a_rtnSAD = _mm_cvtsi128_si32 (sq);
+	return true;
+}
+
+
+
+// Compare 8 samples with their split values.  Backpatch a bitmask of
+// which ones are greater, and whether any are equal.
+static inline void
+pixels_compare_with_split_sse2 (__m128i a_a, __m128i a_b,
+	uint32_t &a_rnGreater, bool &a_rbEqual)
+{
+	__m128i sign = _mm_set1_epi8 (char (0x80));
+	a_rnGreater = uint32_t (_mm_movemask_epi8 (_mm_cmpgt_epi8
+		(_mm_xor_si128 (a_a, sign), _mm_xor_si128 (a_b, sign))) & 0xff);
+	a_rbEqual = (_mm_movemask_epi8 (_mm_cmpeq_epi8 (a_a, a_b)) & 0xff)
+		!= 0;
+}
+
+
+
+// Compare 8 intensity pixels with their split values.
+static inline void
+pixels_compare_with_split_y_sse2 (const uint8_t *a_pThese,
+	const uint8_t *a_pSplits, int32_t a_tnTolerance,
+	uint32_t &a_rnGreater, bool &a_rbEqual, bool &a_rbWithinTolerance)
+{
+	__m128i a = _mm_loadl_epi64 ((const __m128i *) a_pThese);
+	__m128i b = _mm_loadl_epi64 ((const __m128i *) a_pSplits);
+	pixels_compare_with_split_sse2 (a, b, a_rnGreater, a_rbEqual);
+
+	// See if any absolute difference is within the tolerance.
+	if (a_tnTolerance < 0)
+		a_rbWithinTolerance = false;
+	else if (a_tnTolerance >= 255)
+		a_rbWithinTolerance = true;
+	else
+	{
+		__m128i d = _mm_or_si128 (_mm_subs_epu8 (a, b),
+			_mm_subs_epu8 (b, a));
+		__m128i over = _mm_subs_epu8 (d,
+			_mm_set1_epi8 (char (a_tnTolerance)));
+		a_rbWithinTolerance = (_mm_movemask_epi8 (_mm_cmpeq_epi8 (over,
+			_mm_setzero_si128())) & 0xff) != 0;
+	}
+}
+
+
+
+// Compare 4 color pixels with their split values.
+static inline void
+pixels_compare_with_split_cbcr_sse2 (const uint8_t *a_pThese,
+	const uint8_t *a_pSplits, int32_t a_tnTolerance,
+	uint32_t &a_rnGreater, bool &a_rbEqual, bool &a_rbWithinTolerance)
+{
+	__m128i a = _mm_loadl_epi64 ((const __m128i *) a_pThese);
+	__m128i b = _mm_loadl_epi64 ((const __m128i *) a_pSplits);
+	pixels_compare_with_split_sse2 (a, b, a_rnGreater, a_rbEqual);
+
+	// See if any sample, all by itself, is within the tolerance, i.e.
+	// if its squared difference is.  (That's never more than 255*255,
+	// so it fits in 16 bits.)
+	if (a_tnTolerance < 0)
+		a_rbWithinTolerance = false;
+	else if (a_tnTolerance >= 255 * 255)
+		a_rbWithinTolerance = true;
+	else
+	{
+		__m128i z = _mm_setzero_si128();
+		__m128i d = _mm_sub_epi16 (_mm_unpacklo_epi8 (a, z),
+			_mm_unpacklo_epi8 (b, z));
+		__m128i over = _mm_subs_epu16 (_mm_mullo_epi16 (d, d),
+			_mm_set1_epi16 (short (a_tnTolerance)));
+		a_rbWithinTolerance = _mm_movemask_epi8 (_mm_cmpeq_epi16 (over,
+			z)) != 0;
+	}
+}
+
+#endif // __SSE2__
+
+
+
+// Return true if each pixel in the first array is within the
+// specified tolerance of the corresponding pixel in the second array.
+template <>
+bool
+PixelY::IsWithinTolerance (const PixelY *a_pThese,
+	const PixelY *a_pOthers, int a_nPixels, int32_t a_tnTolerance,
+	int32_t &a_rtnSAD)
+{
+	#ifdef __SSE2__
+	if (g_bPixelsSSE2 && a_nPixels == 8)
+	{
+		bool bWithin = pixels_within_tolerance_y_sse2
+			((const uint8_t *) a_pThese, (const uint8_t *) a_pOthers,
+			a_tnTolerance, a_rtnSAD);
+
+		// Make sure it decided what the one-at-a-time version does.
+		#ifndef NDEBUG
+		int32_t tnSAD;
+		assert (bWithin == pixels_within_tolerance (a_pThese, a_pOthers,
+			a_nPixels, a_tnTolerance, tnSAD));
+		assert (!bWithin || tnSAD == a_rtnSAD);
+		#endif // NDEBUG
+
+		return bWithin;
+	}
+	#endif // __SSE2__
+
+	return pixels_within_tolerance (a_pThese, a_pOthers, a_nPixels,
+		a_tnTolerance, a_rtnSAD);
+}
+
+
+
+// Return true if each pixel in the first array is within the
+// specified tolerance of the corresponding pixel in the second array.
+template <>
+bool
+PixelCbCr::IsWithinTolerance (const PixelCbCr *a_pThese,
+	const PixelCbCr *a_pOthers, int a_nPixels, int32_t a_tnTolerance,
+	int32_t &a_rtnSAD)
+{
+	#ifdef __SSE2__
+	if (g_bPixelsSSE2 && a_nPixels == 4)
+	{
+		bool bWithin = pixels_within_tolerance_cbcr_sse2
+			((const uint8_t *) a_pThese, (const uint8_t *) a_pOthers,
+			a_tnTolerance, a_rtnSAD);
+
+		// Make sure it decided what the one-at-a-time version does.
+		#ifndef NDEBUG
+		int32_t tnSAD;
+		assert (bWithin == pixels_within_tolerance (a_pThese, a_pOthers,
+			a_nPixels, a_tnTolerance, tnSAD));
+		assert (!bWithin || tnSAD == a_rtnSAD);
+		#endif // NDEBUG
+
+		return bWithin;
+	}
+	#endif // __SSE2__
+
+	return pixels_within_tolerance (a_pThese, a_pOthers, a_nPixels,
+		a_tnTolerance, a_rtnSAD);
+}
+
+
+
+// Compare each dimension of each pixel in the first array with the
+// corresponding split value in the second array.
+template <>
+void
+PixelY::CompareWithSplit (const PixelY *a_pThese, const PixelY *a_pSplits,
+	int a_nPixels, int32_t a_tnTolerance, uint32_t &a_rnGreater,
+	bool &a_rbEqual, bool &a_rbWithinTolerance)
+{
+	#ifdef __SSE2__
+	if (g_bPixelsSSE2 && a_nPixels == 8)
+	{
+		pixels_compare_with_split_y_sse2 ((const uint8_t *) a_pThese,
+			(const uint8_t *) a_pSplits, a_tnTolerance, a_rnGreater,
+			a_rbEqual, a_rbWithinTolerance);
+
+		// Make sure it decided what the one-at-a-time version does.
+		#ifndef NDEBUG
+		uint32_t nGreater;
+		bool bEqual, bWithinTolerance;
+		pixels_compare_with_split<PixelY,1> (a_pThese, a_pSplits,
+			a_nPixels, a_tnTolerance, nGreater, bEqual,
+			bWithinTolerance);
+		assert (nGreater == a_rnGreater && bEqual == a_rbEqual
+			&& bWithinTolerance == a_rbWithinTolerance);
+		#endif // NDEBUG
+
+		return;
+	}
+	#endif // __SSE2__
+
+	pixels_compare_with_split<PixelY,1> (a_pThese, a_pSplits, a_nPixels,
+		a_tnTolerance, a_rnGreater, a_rbEqual, a_rbWithinTolerance);
+}
+
+
+
+// Compare each dimension of each pixel in the first array with the
+// corresponding split value in the second array.
+template <>
+void
+PixelCbCr::CompareWithSplit (const PixelCbCr *a_pThese,
+	const PixelCbCr *a_pSplits, int a_nPixels, int32_t a_tnTolerance,
+	uint32_t &a_rnGreater, bool &a_rbEqual, bool &a_rbWithinTolerance)
+{
+	#ifdef __SSE2__
+	if (g_bPixelsSSE2 && a_nPixels == 4)
+	{
+		pixels_compare_with_split_cbcr_sse2 ((const uint8_t *) a_pThese,
+			(const uint8_t *) a_pSplits, a_tnTolerance, a_rnGreater,
+			a_rbEqual, a_rbWithinTolerance);
+
+		// Make sure it decided what the one-at-a-time version does.
+		#ifndef NDEBUG
+		uint32_t nGreater;
+		bool bEqual, bWithinTolerance;
+		pixels_compare_with_split<PixelCbCr,2> (a_pThese, a_pSplits,
+			a_nPixels, a_tnTolerance, nGreater, bEqual,
+			bWithinTolerance);
+		assert (nGreater == a_rnGreater && bEqual == a_rbEqual
+			&& bWithinTolerance == a_rbWithinTolerance);
+		#endif // NDEBUG
+
+		return;
+	}
+	#endif // __SSE2__
+
+	pixels_compare_with_split<PixelCbCr,2> (a_pThese, a_pSplits,
+		a_nPixels, a_tnTolerance, a_rnGreater, a_rbEqual,
+		a_rbWithinTolerance);
+}
+
+
+
 // The ThreadMutex class.
 
 
@@ -2165,22 +2671,29 @@ DenoiserThread::WaitForAddFrame (void)
 
 
 
-// The DenoiserThreadY class.
+// The DenoiserThreadBand class.
 
 
 
 // Default constructor.
-DenoiserThreadY::DenoiserThreadY()
+DenoiserThreadBand::DenoiserThreadBand()
 {
+	// No band yet.
+	m_nBand = 0;
+
 	// No input/output buffers yet.
 	m_pInputY = NULL;
+	m_pInputCb = NULL;
+	m_pInputCr = NULL;
 	m_pOutputY = NULL;
+	m_pOutputCb = NULL;
+	m_pOutputCr = NULL;
 }
 
 
 
 // Destructor.
-DenoiserThreadY::~DenoiserThreadY()
+DenoiserThreadBand::~DenoiserThreadBand()
 {
 	// Nothing to do.
 }
@@ -2190,8 +2703,11 @@ DenoiserThreadY::~DenoiserThreadY()
 // Initialize.  Set up all private thread data and start the
 // worker thread.
 void
-DenoiserThreadY::Initialize (void)
+DenoiserThreadBand::Initialize (int a_nBand)
 {
+	// Remember which band to denoise.
+	m_nBand = a_nBand;
+
 	// Let the base class initialize itself.
 	BaseClass::Initialize();
 }
@@ -2200,20 +2716,31 @@ DenoiserThreadY::Initialize (void)
 
 // Add a frame to the denoiser.
 void
-DenoiserThreadY::AddFrame (const uint8_t *a_pInputY, uint8_t *a_pOutputY)
+DenoiserThreadBand::AddFrame (const uint8_t *a_pInputY,
+	const uint8_t *a_pInputCb, const uint8_t *a_pInputCr,
+	uint8_t *a_pOutputY, uint8_t *a_pOutputCb, uint8_t *a_pOutputCr)
 {
-	// Make sure they gave us a new frame to denoise.
-	assert (a_pInputY != NULL && a_pOutputY != NULL);
+	// Make sure they gave us a frame to denoise.  (Actually,
+	// a null input frame means that the end of input has
+	// been reached, which is OK, but there always needs to
+	// be space for an output frame.)
+	assert ((a_pInputCb == NULL && a_pInputCr == NULL)
+		|| (a_pInputCb != NULL && a_pInputCr != NULL));
+	assert (a_pOutputY != NULL);
 
 	// Get exclusive access.
 	Lock();
 
-	// Make sure there's not a current frame already.
-	assert (m_pInputY == NULL && m_pOutputY == NULL);
+	// Make sure there isn't already a current frame.
+	assert (m_pOutputY == NULL);
 
 	// Store the parameters.
 	m_pInputY = a_pInputY;
+	m_pInputCb = a_pInputCb;
+	m_pInputCr = a_pInputCr;
 	m_pOutputY = a_pOutputY;
+	m_pOutputCb = a_pOutputCb;
+	m_pOutputCr = a_pOutputCr;
 
 	// Signal the availability of input.
 	BaseClass::AddFrame();
@@ -2226,25 +2753,29 @@ DenoiserThreadY::AddFrame (const uint8_t *a_pInputY, uint8_t *a_pOutputY)
 
 // Get the next denoised frame, if any.
 int
-DenoiserThreadY::WaitForAddFrame (void)
+DenoiserThreadBand::WaitForAddFrame (void)
 {
 	// Get exclusive access.
 	Lock();
 
-	// Make sure we're denoising a frame.
-	assert (m_pInputY != NULL && m_pOutputY != NULL);
+	// Make sure there's a current frame.
+	assert (m_pOutputY != NULL);
 
-	// Wait for the current frame to finish denoising.
+	// Wait for the frame to finish denoising.
 	BaseClass::WaitForAddFrame();
 
 	// We're done denoising this frame.
 	m_pInputY = NULL;
+	m_pInputCb = NULL;
+	m_pInputCr = NULL;
 	m_pOutputY = NULL;
+	m_pOutputCb = NULL;
+	m_pOutputCr = NULL;
 
 	// Release exclusive access.
 	Unlock();
 
-	// Let our caller know if there's another frame.
+	// Let our caller know if there's a new frame.
 	return m_nWorkRetval;
 }
 
@@ -2252,16 +2783,31 @@ DenoiserThreadY::WaitForAddFrame (void)
 
 // Denoise the current frame.
 int
-DenoiserThreadY::Work (void)
+DenoiserThreadBand::Work (void)
 {
-	// Make sure we're denoising a frame.
-	assert (m_pInputY != NULL && m_pOutputY != NULL);
+	int bY, bCbCr;
 
-	// Denoise the current frame.
-	return ((denoiser.interlaced != 0)
-			? newdenoise_interlaced_frame_intensity
-			: newdenoise_frame_intensity)
-		(m_pInputY, m_pOutputY);
+	// Make sure there's a current frame.
+	assert (m_pOutputY != NULL);
+
+	// Make the compiler shut up.
+	bY = bCbCr = 0;
+
+	// Denoise this band's intensity, and its color too, unless that's
+	// being done in a thread of its own.
+	if (g_bMotionSearcherY)
+		bY = ((denoiser.interlaced != 0)
+				? newdenoise_interlaced_frame_intensity
+				: newdenoise_frame_intensity)
+			(m_nBand, m_pInputY, m_pOutputY);
+	if (g_bMotionSearcherCbCr && !(denoiser.threads & 2))
+		bCbCr = ((denoiser.interlaced != 0)
+				? newdenoise_interlaced_frame_color
+				: newdenoise_frame_color)
+			(m_nBand, m_pInputCb, m_pInputCr, m_pOutputCb, m_pOutputCr);
+
+	// Return 0 if there are no errors.
+	return (bY) ? bY : bCbCr;
 }
 
 
@@ -2273,6 +2819,9 @@ DenoiserThreadY::Work (void)
 // Default constructor.
 DenoiserThreadCbCr::DenoiserThreadCbCr()
 {
+	// No band yet.
+	m_nBand = 0;
+
 	// No input/output buffers yet.
 	m_pInputCb = NULL;
 	m_pInputCr = NULL;
@@ -2293,8 +2842,11 @@ DenoiserThreadCbCr::~DenoiserThreadCbCr()
 // Initialize.  Set up all private thread data and start the
 // worker thread.
 void
-DenoiserThreadCbCr::Initialize (void)
+DenoiserThreadCbCr::Initialize (int a_nBand)
 {
+	// Remember which band to denoise.
+	m_nBand = a_nBand;
+
 	// Let the base class initialize itself.
 	BaseClass::Initialize();
 }
@@ -2386,7 +2938,7 @@ DenoiserThreadCbCr::Work (void)
 	return ((denoiser.interlaced != 0)
 			? newdenoise_interlaced_frame_color
 			: newdenoise_frame_color)
-		(m_pInputCb, m_pInputCr, m_pOutputCb, m_pOutputCr);
+		(m_nBand, m_pInputCb, m_pInputCr, m_pOutputCb, m_pOutputCr);
 }
 
 
@@ -71,6 +71,8 @@ typedef struct DNSR_GLOBAL
 	int matchCountThrottle;	/* match throttle on count */
 	int matchSizeThrottle;	/* match throttle on size */
 	int threads;			/* bit 0=rw only, bit 1=color in parallel */
+	int bands;				/* # of bands, denoised in parallel */
+	int fast;				/* 1 to search near block vectors only */
 	struct
 	{
 		int w, h;			/* width/height of intensity frame */
@@ -0,0 +1,61 @@
+/*
+ * unsharp.h: the unsharp mask of y4munsharp, without the stream handling,
+ * so that other programs can run it on frames they have in memory:
+ *
+ *   unsharp_defaults(&settings);
+ *   unsharp_init(&u, &settings, &streaminfo);
+ *   for every frame:
+ *     unsharp_frame(&u, cur_col, dest_col, frameno, input, output);
+ *   unsharp_fini(&u);
+ *
+ * unsharp_frame() only reads 'u', so several frames may be sharpened at
+ * once, each with its own cur_col and dest_col scratch buffers of
+ * unsharp_scratch_size() bytes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef __UNSHARP_H__
+#define __UNSHARP_H__
+
+#include <sys/types.h>
+#include <yuv4mpeg.h>
+
+typedef	struct
+	{
+	double	y_radius, y_amount;	/* -L */
+	int	y_threshold;
+	double	uv_radius, uv_amount;	/* -C, uv_radius -1.0 if not given */
+	int	uv_threshold;
+	int	lowy, highy, lowuv, highuv;	/* clip limits, 0 and 255 for -N */
+	} unsharp_settings_t;
+
+typedef	struct
+	{
+	unsharp_settings_t s;
+	int	interlaced, ywidth, uvwidth, yheight, uvheight, uvlen;
+	int	cmatrix_y_len, cmatrix_uv_len;
+	double	*cmatrix_y, *cmatrix_uv, *ctable_y, *ctable_uv;
+	} unsharp_t;
+
+void	unsharp_defaults(unsharp_settings_t *);
+int	unsharp_init(unsharp_t *, const unsharp_settings_t *,
+		     const y4m_stream_info_t *);
+int	unsharp_scratch_size(const unsharp_t *);
+void	unsharp_frame(const unsharp_t *, u_char *, u_char *, int,
+		      u_char * const *, u_char * const *);
+void	unsharp_fini(unsharp_t *);
+
+#endif /* __UNSHARP_H__ */
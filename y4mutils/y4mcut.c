@@ -0,0 +1,138 @@
+/*
+ * y4mcut.c
+ *
+ * Write a range of the frames of a YUV4MPEG2 file to stdout, going
+ * straight to the first of them instead of reading (and discarding)
+ * every frame before it.  Cutting a long file into pieces for parallel
+ * encodes, or seeking in lavpipe(1) recipes, takes time proportional
+ * to the frames written, not to their position in the file.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "yuv4mpeg.h"
+#include "y4mfile.h"
+#include "mjpeg_logging.h"
+
+static	void	usage(void);
+
+int main(int argc, char **argv)
+	{
+	int	c, err, n, frames;
+	int	offset = 0, count = -1, save_index = 0, verbose = 1;
+	int	fd_out = fileno(stdout);
+	uint8_t	*planes[Y4M_MAX_NUM_PLANES];
+	y4m_file_t	*file;
+	y4m_stream_info_t istream;
+	y4m_frame_info_t iframe;
+
+	opterr = 0;
+	while	((c = getopt(argc, argv, "o:n:iv:h")) != EOF)
+		{
+		switch	(c)
+			{
+			case	'o':
+				offset = atoi(optarg);
+				break;
+			case	'n':
+				count = atoi(optarg);
+				break;
+			case	'i':
+				save_index = 1;
+				break;
+			case	'v':
+				verbose = atoi(optarg);
+				if	(verbose < 0 || verbose > 2)
+					usage();
+				break;
+			case	'h':
+			case	'?':
+			default:
+				usage();
+			}
+		}
+	if	(optind != argc - 1)
+		usage();
+	mjpeg_default_handler_verbosity(verbose);
+
+	/* samples of any depth are passed through untouched */
+	y4m_accept_extensions(2);
+
+	y4m_init_stream_info(&istream);
+	y4m_init_frame_info(&iframe);
+
+	file = y4m_file_open(argv[optind], &istream, &err);
+	if	(file == NULL)
+		mjpeg_error_exit1("Could not open %s: %s", argv[optind],
+			y4m_strerr(err));
+	frames = y4m_file_frame_count(file);
+	mjpeg_info("%s: %d frames", argv[optind], frames);
+
+	if	(save_index && y4m_file_save_index(file) != Y4M_OK)
+		mjpeg_warn("Could not save the index of %s", argv[optind]);
+
+	/* as in lavpipe, a negative offset counts back from the end */
+	if	(offset < 0)
+		offset += frames;
+	if	(offset < 0 || offset > frames)
+		mjpeg_error_exit1("Offset %d out of range (0..%d)", offset,
+			frames);
+	if	(count < 0 || count > frames - offset)
+		count = frames - offset;
+
+	err = y4m_write_stream_header(fd_out, &istream);
+	if	(err != Y4M_OK)
+		mjpeg_error_exit1("Could not write stream header: %s",
+			y4m_strerr(err));
+
+	for	(n = offset; n < offset + count; n++)
+		{
+		err = y4m_file_borrow_frame(file, n, &iframe, planes);
+		if	(err != Y4M_OK)
+			mjpeg_error_exit1("Could not read frame %d: %s", n,
+				y4m_strerr(err));
+		err = y4m_write_frame(fd_out, &istream, &iframe, planes);
+		if	(err != Y4M_OK)
+			{
+			mjpeg_error("Could not write frame %d: %s", n,
+				y4m_strerr(err));
+			break;
+			}
+		}
+	mjpeg_info("Wrote frames %d..%d", offset, n - 1);
+
+	y4m_file_close(file);
+	y4m_fini_frame_info(&iframe);
+	y4m_fini_stream_info(&istream);
+	exit(err == Y4M_OK ? 0 : 1);
+	}
+
+static void usage(void)
+	{
+
+	fprintf(stderr, "usage: y4mcut [-o offset] [-n count] [-i] [-v 0|1|2] file.y4m\n");
+	fprintf(stderr, "  Writes frames offset..offset+count-1 of file.y4m to stdout\n");
+	fprintf(stderr, "  -o offset  first frame (default 0, negative counts from the end)\n");
+	fprintf(stderr, "  -n count   number of frames (default: to the end of the file)\n");
+	fprintf(stderr, "  -i         save the frame index to file.y4m.idx for next time\n");
+	fprintf(stderr, "  -v num     verbosity (default 1)\n");
+	exit(1);
+	}
@@ -21,24 +21,34 @@
 #include <string.h>
 
 #include "yuv4mpeg.h"
+#include "y4mframepool.h"
 
 #define HALFSHIFT (shiftnum / SS_H)
 
-	void	black_border(u_char **, char *, int, int, int, int);
-	void	vertical_shift(u_char **, int, int, int, int, int, int);
+typedef struct
+	{
+	int	shiftnum, shiftY, rightshiftY, rightshiftUV;
+	int	vshift, vshiftY, monochrome, border;
+	int	width, height, SS_H, SS_V;
+	} shift_t;
+
+static	int	parse_border(char *, int, int, int, int);
+	void	black_border(u_char * const *, int, int, int, int);
+	void	vertical_shift(u_char * const *, int, int, int, int, int, int);
+static	int	shift_frame(void *, int, int, y4m_frame_info_t *,
+			    u_char * const *, u_char * const *);
 static  void    usage(char *);
 
 int main(int argc, char **argv)
         {
-        int     i, c, width, height, frames, err, chroma_ss, ilace_factor;
+        int     c, width, height, err, chroma_ss, ilace_factor;
         int     shiftnum = 0, shiftY = 0, rightshiftY, rightshiftUV;
         int     vshift = 0, vshiftY = 0, monochrome = 0;
         int     verbose = 0, fdin;
         int     SS_H = 2, SS_V = 2;
-        u_char  *yuv[3], *line;
 	char	*borderarg = NULL;
+	shift_t	shift;
         y4m_stream_info_t istream, ostream;
-        y4m_frame_info_t iframe;
 
         fdin = fileno(stdin);
 
@@ -92,7 +102,6 @@ int main(int argc, char **argv)
                 }
 
         y4m_init_stream_info(&istream);
-        y4m_init_frame_info(&iframe);
 
         err = y4m_read_stream_header(fdin, &istream);
         if      (err != Y4M_OK)
@@ -130,123 +139,138 @@ int main(int argc, char **argv)
         y4m_copy_stream_info(&ostream, &istream);
         y4m_write_stream_header(fileno(stdout), &ostream);
 
-        yuv[0] = malloc(y4m_si_get_plane_length(&istream, 0));
-        if      (yuv[0] == NULL)
-                mjpeg_error_exit1("malloc() failed for plane 0");
-        yuv[1] = malloc(y4m_si_get_plane_length(&istream, 1));
-        if      (yuv[1] == NULL)
-                mjpeg_error_exit1("malloc() failed for plane 1");
-        yuv[2] = malloc(y4m_si_get_plane_length(&istream, 2));
-        if      (yuv[2] == NULL)
-                mjpeg_error_exit1("malloc() failed for plane 2");
-
-        frames = 0;
-        for     (;y4m_read_frame(fdin,&istream,&iframe,yuv) == Y4M_OK; frames++)
+	shift.shiftnum = shiftnum;
+	shift.shiftY = shiftY;
+	shift.rightshiftY = rightshiftY;
+	shift.rightshiftUV = rightshiftUV;
+	shift.vshift = vshift;
+	shift.vshiftY = vshiftY;
+	shift.monochrome = monochrome;
+	shift.border = borderarg != NULL &&
+		parse_border(borderarg, width, height, SS_H, SS_V);
+	shift.width = width;
+	shift.height = height;
+	shift.SS_H = SS_H;
+	shift.SS_V = SS_V;
+
+	/* each frame is shifted on its own: let the frame pool spread them */
+	y4m_frame_pool_run(fdin, &istream, fileno(stdout), NULL,
+			   shift_frame, &shift);
+        y4m_fini_stream_info(&istream);
+        y4m_fini_stream_info(&ostream);
+
+        exit(0);
+        }
+
+/*
+ * Called by the frame pool, possibly for several frames at once:  works on
+ * the frame in place and touches nothing but the frame.
+*/
+
+static int shift_frame(void *arg, int thread, int frame, y4m_frame_info_t *fi,
+		       u_char * const *in, u_char * const *yuv)
+        {
+	shift_t	*s = arg;
+        int     i, width = s->width, height = s->height;
+	int	shiftnum = s->shiftnum, shiftY = s->shiftY;
+	int	rightshiftY = s->rightshiftY, rightshiftUV = s->rightshiftUV;
+	int	vshift = s->vshift, vshiftY = s->vshiftY;
+	int	SS_H = s->SS_H, SS_V = s->SS_V;
+        u_char  *line;
+
+        if      (shiftnum == 0 && shiftY == 0)
+                goto done;
+        for     (i = 0; i < height; i++)
                 {
-                if      (shiftnum == 0 && shiftY == 0)
-                        goto outputframe;
-                for     (i = 0; i < height; i++)
-                        {
 /*
  * Y
 */
-                        line = &yuv[0][i * width];
-                        if      (rightshiftY)
-                                {
-                                bcopy(line, line + shiftY, width - shiftY);
-                                memset(line, 16, shiftY); /* black */
-                                }
-                        else 
-                                {
-                                bcopy(line + shiftY, line, width - shiftY);
-                                memset(line + width - shiftY, 16, shiftY);
-                                }
+                line = &yuv[0][i * width];
+                if      (rightshiftY)
+                        {
+                        bcopy(line, line + shiftY, width - shiftY);
+                        memset(line, 16, shiftY); /* black */
                         }
+                else 
+                        {
+                        bcopy(line + shiftY, line, width - shiftY);
+                        memset(line + width - shiftY, 16, shiftY);
+                        }
+                }
 /*
  * U
 */
-                for     (i = 0; i < height / SS_V; i++)
+        for     (i = 0; i < height / SS_V; i++)
+                {
+                line = &yuv[1][i * (width / SS_H)];
+                if      (rightshiftUV)
+                        {
+                        bcopy(line, line+HALFSHIFT, (width-shiftnum)/SS_H);
+                        memset(line, 128, HALFSHIFT); /* black */
+                        }
+                else
                         {
-                        line = &yuv[1][i * (width / SS_H)];
-                        if      (rightshiftUV)
-                                {
-                                bcopy(line, line+HALFSHIFT, (width-shiftnum)/SS_H);
-                                memset(line, 128, HALFSHIFT); /* black */
-                                }
-                        else
-                                {
-                                bcopy(line+HALFSHIFT, line, (width-shiftnum)/SS_H);
-                                memset(line+(width-shiftnum)/SS_H, 128, HALFSHIFT);
-                                }
+                        bcopy(line+HALFSHIFT, line, (width-shiftnum)/SS_H);
+                        memset(line+(width-shiftnum)/SS_H, 128, HALFSHIFT);
                         }
+                }
 /*
  * V
 */
-                for     (i = 0; i < height / SS_V; i++)
+        for     (i = 0; i < height / SS_V; i++)
+                {
+                line = &yuv[2][i  * (width / SS_H)];
+                if      (rightshiftUV)
                         {
-                        line = &yuv[2][i  * (width / SS_H)];
-                        if      (rightshiftUV)
-                                {
-                                bcopy(line, line+HALFSHIFT, (width-shiftnum)/SS_H);
-                                memset(line, 128, HALFSHIFT); /* black */
-                                }
-                        else
-                                {
-                                bcopy(line+HALFSHIFT, line, (width-shiftnum)/SS_H);
-                                memset(line+(width-shiftnum)/SS_H, 128, HALFSHIFT);
-                                }
+                        bcopy(line, line+HALFSHIFT, (width-shiftnum)/SS_H);
+                        memset(line, 128, HALFSHIFT); /* black */
+                        }
+                else
+                        {
+                        bcopy(line+HALFSHIFT, line, (width-shiftnum)/SS_H);
+                        memset(line+(width-shiftnum)/SS_H, 128, HALFSHIFT);
                         }
-outputframe:
-		if	(vshift)
-			vertical_shift(yuv, vshift, vshiftY, width, height, SS_H, SS_V);
-		if	(borderarg)
-			black_border(yuv, borderarg, width, height, SS_H, SS_V);
-		if	(monochrome)
-			{
-			memset(&yuv[1][0], 128, (width / SS_H) * (height / SS_V));
-			memset(&yuv[2][0], 128, (width / SS_H) * (height / SS_V));
-			}
-                y4m_write_frame(fileno(stdout), &ostream, &iframe, yuv);
                 }
-        y4m_fini_frame_info(&iframe);
-        y4m_fini_stream_info(&istream);
-        y4m_fini_stream_info(&ostream);
-
-        exit(0);
+done:
+	if	(vshift)
+		vertical_shift(yuv, vshift, vshiftY, width, height, SS_H, SS_V);
+	if	(s->border)
+		black_border(yuv, width, height, SS_H, SS_V);
+	if	(s->monochrome)
+		{
+		memset(&yuv[1][0], 128, (width / SS_H) * (height / SS_V));
+		memset(&yuv[2][0], 128, (width / SS_H) * (height / SS_V));
+		}
+	return(Y4M_OK);
         }
 
 /*
  * -b Xoff,Yoff,Xsize,YSize
 */
 
-void black_border (u_char *yuv[], char *borderstring, int W, int H, int SS_H, int SS_V)
+static	int BX0, BX1;	/* Left, Right border columns */
+static	int BY0, BY1;	/* Top, Bottom border rows */
+
+static int parse_border(char *borderstring, int W, int H, int SS_H, int SS_V)
 	{
-	static	int parsed = -1;
-	static	int BX0, BX1;	/* Left, Right border columns */
-	static	int BY0, BY1;	/* Top, Bottom border rows */
-	int	i1, i2, i, dy, W2, H2;
-  
-	if	(parsed == -1)
+	int	i1, i2, i;
+
+	i = sscanf(borderstring, "%d,%d,%d,%d", &BX0, &BY0, &i1, &i2);
+	if	(i != 4 || (BX0 % SS_H) || (BY0 % (2*SS_V)) || i1 < 0 || i2 < 0 ||
+		 (BX0 + i1 > W) || (BY0 + i2 > H))
 		{
-		parsed = 0;
-		i = sscanf(borderstring, "%d,%d,%d,%d", &BX0, &BY0, &i1, &i2);
-		if	(i != 4 || (BX0 % SS_H) || (BY0 % (2*SS_V)) || i1 < 0 || i2 < 0 ||
-			 (BX0 + i1 > W) || (BY0 + i2 > H))
-			{
-			mjpeg_warn(" border args invalid - ignored");
-			return;
-			}
-		BX1 = BX0 + i1;
-		BY1 = BY0 + i2;
-		parsed = 1;
+		mjpeg_warn(" border args invalid - ignored");
+		return(0);
 		}
-/*
- * If a borderstring was seen but declared invalid then it
- * is being ignored so just return.
-*/
-	if	(parsed == 0)
-		return;
+	BX1 = BX0 + i1;
+	BY1 = BY0 + i2;
+	return(1);
+	}
 
+void black_border (u_char * const yuv[], int W, int H, int SS_H, int SS_V)
+	{
+	int	dy, W2, H2;
+  
 	W2 = W / SS_H;
 	H2 = H / SS_V;
 
@@ -300,7 +324,7 @@ void black_border (u_char *yuv[], char *borderstring, int W, int H, int SS_H, in
 
 	}
 
-void vertical_shift(u_char **yuv, int vshift, int vshiftY, int width, int height, int SS_H, int SS_V)
+void vertical_shift(u_char * const *yuv, int vshift, int vshiftY, int width, int height, int SS_H, int SS_V)
 	{
 	int	downshiftY, downshiftUV, w2 = width / SS_H, v2;
 
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <math.h>
 #include "yuv4mpeg.h"
+#include "y4mframepool.h"
 #include "cpu_accel.h"
 
 #ifdef HAVE_ASM_MMX
@@ -28,6 +29,7 @@ static void *my_malloc(size_t);
 static struct filter *get_coeff(int, float);
 static void convolveFrame(u_char *src,int w,int h,int interlace,struct filter *xtap,struct filter *ytap,float *yuvtmp1,float *yuvtmp2);
 static void set_accel(int w,int h);
+static int filterFrame(void *arg,int thread,int frame,y4m_frame_info_t *fi,u_char * const *in,u_char * const *yuv);
 static void usage(char *);
 
 static void (*pframe_i2f)(u_char *,float *,int);
@@ -40,18 +42,23 @@ struct filter {
     float **qfilters; // for SSE/Altivec -- repeats the filter 4 times
 };
 
+/* what filterFrame() needs; yuvtmp1/2 hold a scratch plane per thread */
+struct frame_filter {
+    int interlace, verbose;
+    int ywidth, yheight, uvwidth, uvheight;
+    struct filter *lumaXtaps, *lumaYtaps, *chromaXtaps, *chromaYtaps;
+    float **yuvtmp1, **yuvtmp2;
+};
+
 int main(int argc, char **argv)
 {
-    int    i, c, interlace, frames, err;
+    int    i, c, interlace, err, nthreads;
     int    ywidth, yheight, uvwidth, uvheight, ylen, uvlen;
     int    verbose = 0, fdin;
     int    NlumaX = 4, NlumaY = 4, NchromaX = 4, NchromaY = 4;
     float  BWlumaX = 0.8, BWlumaY = 0.8, BWchromaX = 0.7, BWchromaY = 0.7;
-    struct filter *lumaXtaps, *lumaYtaps, *chromaXtaps, *chromaYtaps;
-    u_char *yuvinout[3];
-    float *yuvtmp1,*yuvtmp2;
+    struct frame_filter ff;
     y4m_stream_info_t istream, ostream;
-    y4m_frame_info_t iframe;
 
     fdin = fileno(stdin);
     
@@ -102,7 +109,6 @@ int main(int argc, char **argv)
 
     /* initialize input stream and check chroma subsampling and interlacing */
     y4m_init_stream_info(&istream);
-    y4m_init_frame_info(&iframe);
     err = y4m_read_stream_header(fdin, &istream);
     if (err != Y4M_OK)
 	mjpeg_error_exit1("Input stream error: %s\n", y4m_strerr(err));
@@ -138,40 +144,36 @@ int main(int argc, char **argv)
     y4m_copy_stream_info(&ostream, &istream);
     y4m_write_stream_header(fileno(stdout), &ostream);
     
-    /* allocate input and output buffers */
-    yuvinout[0] = my_malloc(ylen*sizeof(u_char));
-    yuvinout[1] = my_malloc(uvlen*sizeof(u_char));
-    yuvinout[2] = my_malloc(uvlen*sizeof(u_char));
-    yuvtmp1 = my_malloc(MAX(ylen,uvlen)*sizeof(float));
-    yuvtmp2 = my_malloc(MAX(ylen,uvlen)*sizeof(float));
+    /* allocate scratch buffers, for each thread of the frame pool */
+    nthreads = y4m_frame_pool_threads(-1);
+    ff.yuvtmp1 = my_malloc(nthreads*sizeof(float *));
+    ff.yuvtmp2 = my_malloc(nthreads*sizeof(float *));
+    for (i = 0; i < nthreads; i++) {
+        ff.yuvtmp1[i] = my_malloc(MAX(ylen,uvlen)*sizeof(float));
+        ff.yuvtmp2[i] = my_malloc(MAX(ylen,uvlen)*sizeof(float));
+    }
 
     /* get filter taps */
-    lumaXtaps   = get_coeff(NlumaX, BWlumaX);
-    lumaYtaps   = get_coeff(NlumaY, BWlumaY);
-    chromaXtaps = get_coeff(NchromaX, BWchromaX);
-    chromaYtaps = get_coeff(NchromaY, BWchromaY);
+    ff.lumaXtaps   = get_coeff(NlumaX, BWlumaX);
+    ff.lumaYtaps   = get_coeff(NlumaY, BWlumaY);
+    ff.chromaXtaps = get_coeff(NchromaX, BWchromaX);
+    ff.chromaYtaps = get_coeff(NchromaY, BWchromaY);
 
     set_accel(uvwidth,uvheight);
 
     if (verbose)
 	y4m_log_stream_info(mjpeg_loglev_t("info"), "", &istream);
     
-    /* main processing loop */
-    for (frames=0; y4m_read_frame(fdin,&istream,&iframe,yuvinout) == Y4M_OK; frames++)
-	{
-	    if (verbose && ((frames % 100) == 0))
-		mjpeg_info("Frame %d\n", frames);
-	    
-            convolveFrame(yuvinout[0],ywidth,yheight,interlace,lumaXtaps,lumaYtaps,yuvtmp1,yuvtmp2);
-            convolveFrame(yuvinout[1],uvwidth,uvheight,interlace,chromaXtaps,chromaYtaps,yuvtmp1,yuvtmp2);
-            convolveFrame(yuvinout[2],uvwidth,uvheight,interlace,chromaXtaps,chromaYtaps,yuvtmp1,yuvtmp2);
-
-	    y4m_write_frame(fileno(stdout), &ostream, &iframe, yuvinout);
-
-	}
+    /* main processing loop: frames are filtered independently, in place */
+    ff.interlace = interlace;
+    ff.verbose = verbose;
+    ff.ywidth = ywidth;
+    ff.yheight = yheight;
+    ff.uvwidth = uvwidth;
+    ff.uvheight = uvheight;
+    y4m_frame_pool_run(fdin, &istream, fileno(stdout), NULL, filterFrame, &ff);
     
     /* clean up */
-    y4m_fini_frame_info(&iframe);
     y4m_fini_stream_info(&istream);
     y4m_fini_stream_info(&ostream);
     exit(0);
@@ -451,6 +453,21 @@ static void convolveFrame(u_char *src,int w,int h,int interlace,struct filter *x
     pframe_f2i(tmp1,src,w*h);
 }
 
+/* Called by the frame pool, on any of its threads */
+static int filterFrame(void *arg,int thread,int frame,y4m_frame_info_t *fi,u_char * const *in,u_char * const *yuv)
+{
+    struct frame_filter *ff=arg;
+    float *tmp1=ff->yuvtmp1[thread],*tmp2=ff->yuvtmp2[thread];
+
+    if (ff->verbose && ((frame % 100) == 0))
+        mjpeg_info("Frame %d\n", frame);
+
+    convolveFrame(yuv[0],ff->ywidth,ff->yheight,ff->interlace,ff->lumaXtaps,ff->lumaYtaps,tmp1,tmp2);
+    convolveFrame(yuv[1],ff->uvwidth,ff->uvheight,ff->interlace,ff->chromaXtaps,ff->chromaYtaps,tmp1,tmp2);
+    convolveFrame(yuv[2],ff->uvwidth,ff->uvheight,ff->interlace,ff->chromaXtaps,ff->chromaYtaps,tmp1,tmp2);
+    return Y4M_OK;
+}
+
 static void set_accel(int w,int h)
 {
     pframe_i2f=frame_i2f;
@@ -37,17 +37,18 @@
 #include <string.h>
 
 #include "yuv4mpeg.h"
+#include "y4mconvert.h"
 
 static	void	usage(char *);
 
 int
 main(int argc, char **argv)
 	{
-	int	sts, c, width = 0, height = 0, frame_len, i, yuyv = 1;
+	int	sts, c, width = 0, height = 0, frame_len, yuyv = 1;
 	y4m_ratio_t	rate_ratio = y4m_fps_FILM;
 	y4m_ratio_t	aspect_ratio = y4m_sar_SQUARE;
 	int		interlace = Y4M_ILACE_NONE;
-	u_char	*yuv[3], *input_frame, *Y_p, *Cr_p, *Cb_p, *p;
+	u_char	*yuv[3], *input_frame;
 	y4m_stream_info_t ostream;
 	y4m_frame_info_t oframe;
 
@@ -131,30 +132,7 @@ main(int argc, char **argv)
 	y4m_write_stream_header(fileno(stdout), &ostream);
 	while	(y4m_read(fileno(stdin), input_frame, frame_len) == Y4M_OK)
 		{
-		Y_p = yuv[0];
-		Cb_p = yuv[1];
-		Cr_p = yuv[2];
-		p = input_frame;
-		if	(yuyv)	/* YUYV (YUY2) */
-			{
-			for	(i = 0; i < frame_len; i += 4)
-				{
-				*Y_p++ = *p++;
-				*Cb_p++ = *p++;
-				*Y_p++ = *p++;
-				*Cr_p++ = *p++;
-				}
-			}
-		else		/* UYVY */
-			{
-			for	(i = 0; i < frame_len; i += 4)
-				{
-				*Cb_p++ = *p++;
-				*Y_p++ = *p++;
-				*Cr_p++ = *p++;
-				*Y_p++ = *p++;
-				}
-			}
+		y4m_unpack_422(yuv, input_frame, width, height, !yuyv);
 		y4m_write_frame(fileno(stdout), &ostream, &oframe, yuv);
 		}
 	free(yuv[0]);
@@ -31,6 +31,7 @@
 #include <math.h>
 #include <signal.h>
 #include "yuv4mpeg.h"
+#include "y4mframepool.h"
 #include "yuvcorrect.h"
 
 extern const uint16_t OFFSET;
@@ -62,6 +63,20 @@ void yuvcorrect_print_information (general_correction_t * gen_correct,
 void yuvcorrect_handle_args (int argc, char *argv[], overall_t * overall,
 			     general_correction_t * gen_correct);
 
+// What the frame pool callback needs to correct a frame
+typedef struct
+{
+  overall_t *overall;
+  frame_t *frame;
+  general_correction_t *gen_correct;
+  yuv_correction_t *yuv_correct;
+  rgb_correction_t *rgb_correct;
+}
+correction_t;
+static int yuvcorrect_frame (void *arg, int thread, int frame_num,
+			     y4m_frame_info_t * fi, uint8_t * const *in,
+			     uint8_t * const *out);
+
 // *************************************************************************************
 void
 yuvcorrect_print_usage (void)
@@ -431,6 +446,32 @@ main (int argc, char *argv[])
     ("yuv: Gamma=%f, InputYmin=%u, InputYmax=%u, OutputYmin=%u, OutputYmax=%u",
      yuv_correct->Gamma, yuv_correct->InputYmin, yuv_correct->InputYmax,
      yuv_correct->OutputYmin, yuv_correct->OutputYmax);
+
+  // Frames are independent of each other unless a field is carried
+  // forward to the next frame or statistics are printed in order: then
+  // several of them are corrected at a time by the frame pool
+  if (gen_correct->field_move == 0 && overall->stat == 0)
+    {
+      correction_t correction;
+
+      correction.overall = overall;
+      correction.frame = frame;
+      correction.gen_correct = gen_correct;
+      correction.yuv_correct = yuv_correct;
+      correction.rgb_correct = rgb_correct;
+      // Switched lines are copied to separate output planes
+      err = y4m_frame_pool_run (0, &gen_correct->streaminfo, 1,
+				gen_correct->line_switch ?
+				&gen_correct->streaminfo : NULL,
+				yuvcorrect_frame, &correction);
+      if (err != Y4M_OK)
+	mjpeg_error_exit1 ("Stopped on a frame error: %s", y4m_strerr (err));
+      mjpeg_info ("Normal exit: end of stream");
+      y4m_fini_stream_info (&gen_correct->streaminfo);
+      y4m_fini_frame_info (&frame->info);
+      return 0;
+    }
+
   // Master loop : continue until there is no next frame in stdin
   while ((err = yuvcorrect_y4m_read_frame (0, &gen_correct->streaminfo, frame, gen_correct->line_switch)) == Y4M_OK)
     {
@@ -527,6 +568,76 @@ out_error:
 
 // *************************************************************************************
 
+// *************************************************************************************
+// Line 'line' of the U and V planes taken one after the other, as
+// yuvcorrect_y4m_read_frame() switches them
+static uint8_t *
+uv_line (uint8_t * const *planes, const frame_t * frame, unsigned int line)
+{
+  if (line < frame->uv_height)
+    return planes[1] + line * frame->uv_width;
+  return planes[2] + (line - frame->uv_height) * frame->uv_width;
+}
+
+// *************************************************************************************
+// Frame pool callback: corrects one frame, on any of the pool's threads
+static int
+yuvcorrect_frame (void *arg, int thread, int frame_num,
+		  y4m_frame_info_t * fi, uint8_t * const *in,
+		  uint8_t * const *out)
+{
+  correction_t *correction = arg;
+  frame_t frame = *correction->frame;	// sizes, but this frame's planes
+  unsigned int line;
+
+  mjpeg_info ("Frame number %d", frame_num);
+  if (correction->gen_correct->line_switch)
+    {
+      for (line = 0; line + 1 < frame.y_height; line += 2)
+	{
+	  memcpy (out[0] + line * frame.y_width,
+		  in[0] + (line + 1) * frame.y_width, frame.y_width);
+	  memcpy (out[0] + (line + 1) * frame.y_width,
+		  in[0] + line * frame.y_width, frame.y_width);
+	}
+      if (line < frame.y_height)
+	memcpy (out[0] + line * frame.y_width,
+		in[0] + line * frame.y_width, frame.y_width);
+      for (line = 0; line + 1 < (frame.uv_height << 1); line += 2)
+	{
+	  memcpy (uv_line (out, &frame, line),
+		  uv_line (in, &frame, line + 1), frame.uv_width);
+	  memcpy (uv_line (out, &frame, line + 1),
+		  uv_line (in, &frame, line), frame.uv_width);
+	}
+    }
+  frame.y = out[0];
+  frame.u = out[1];
+  frame.v = out[2];
+
+  if (correction->overall->rgbfirst == 1)
+    {
+      // RGB correction
+      if (correction->rgb_correct->rgb == 1)
+	yuvcorrect_RGB_treatment (&frame, correction->rgb_correct);
+    }
+  // luminance correction
+  if (correction->yuv_correct->luma == 1)
+    yuvcorrect_luminance_treatment (&frame, correction->yuv_correct);
+  // chrominance correction
+  if (correction->yuv_correct->chroma == 1)
+    yuvcorrect_chrominance_treatment (&frame, correction->yuv_correct);
+  if (correction->overall->rgbfirst != 1)
+    {
+      // RGB correction
+      if (correction->rgb_correct->rgb == 1)
+	yuvcorrect_RGB_treatment (&frame, correction->rgb_correct);
+    }
+  return Y4M_OK;
+}
+
+// *************************************************************************************
+
 /* 
  * Local variables:
  *  tab-width: 8
@@ -149,5 +149,9 @@ void
 handle_args_yuv_rgb (int argc, char *argv[], yuv_correction_t * yuv_correct, rgb_correction_t * rgb_correct);
 void initialisation1(int, frame_t * frame, general_correction_t * gen_correct,
 		     yuv_correction_t * yuv_correct, rgb_correction_t * rgb_correct);
+void yuvcorrect_stream_init(const y4m_stream_info_t * si, frame_t * frame,
+			    general_correction_t * gen_correct,
+			    yuv_correction_t * yuv_correct,
+			    rgb_correction_t * rgb_correct);
 void initialisation2(yuv_correction_t * yuv_correct, rgb_correction_t * rgb_correct);
 void ref_frame_init(int fd,ref_frame_t *ref_frame);
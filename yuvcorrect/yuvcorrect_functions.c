@@ -351,6 +351,26 @@ void initialisation1(int fd,frame_t * frame, general_correction_t * gen_correct,
 		     yuv_correction_t * yuv_correct, rgb_correction_t * rgb_correct)
 		    
 {
+  y4m_stream_info_t streaminfo;
+
+  y4m_init_stream_info (&streaminfo);
+  if (y4m_read_stream_header (fd, &streaminfo) != Y4M_OK)
+      mjpeg_error_exit1("Couldn't read yuv4mpeg header!");
+  yuvcorrect_stream_init (&streaminfo, frame, gen_correct, yuv_correct,
+			  rgb_correct);
+  y4m_fini_stream_info (&streaminfo);
+}
+// *************************************************************************************
+
+
+// *************************************************************************************
+void yuvcorrect_stream_init(const y4m_stream_info_t * si, frame_t * frame,
+			    general_correction_t * gen_correct,
+			    yuv_correction_t * yuv_correct,
+			    rgb_correction_t * rgb_correct)
+{
+  // initialisation1() without the header read, for a stream whose
+  // header is already known
    uint8_t *u_c_p;		//u_c_p = uint8_t pointer
 
   // gen_correct 
@@ -358,8 +378,7 @@ void initialisation1(int fd,frame_t * frame, general_correction_t * gen_correct,
   gen_correct->field_move = 0;
 
   y4m_init_stream_info (&gen_correct->streaminfo);
-  if (y4m_read_stream_header (fd, &gen_correct->streaminfo) != Y4M_OK)
-      mjpeg_error_exit1("Couldn't read yuv4mpeg header!");
+  y4m_copy_stream_info (&gen_correct->streaminfo, si);
 
   if (y4m_si_get_plane_count(&gen_correct->streaminfo) != 3)
       mjpeg_error_exit1("Only 3 plane formats supported");
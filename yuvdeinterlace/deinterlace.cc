@@ -22,6 +22,7 @@
 #include "mjpeg_logging.h"
 #include "cpu_accel.h"
 #include "motionsearch.h"
+#include "yuvdeinterlace.h"
 
 #ifdef __GNUC__
 #define RESTRICT __restrict__
@@ -32,24 +33,6 @@
 namespace
 {
 
-class y4mstream
-{
-public:
-  int fd_in;
-  int fd_out;
-  y4m_frame_info_t iframeinfo;
-  y4m_stream_info_t istreaminfo;
-  y4m_frame_info_t oframeinfo;
-  y4m_stream_info_t ostreaminfo;
-
-    y4mstream ()
-  {
-    fd_in = 0;
-    fd_out = 1;
-  };
-
-};
-
 class deinterlacer
 {
 public:
@@ -59,14 +42,13 @@ public:
   int cheight;
   int field_order;
   int both_fields;
-  int verbose;
-  int input_chroma_subsampling;
-  int output_chroma_subsampling;
   int vertical_overshot_luma;
   int vertical_overshot_chroma;
   int just_anti_alias;
 
-  y4mstream Y4MStream;
+  yuvdeinterlace_put_t put;
+  void *put_arg;
+  int put_status;
 
   uint8_t *inframe[3];
   uint8_t *inframe0[3];
@@ -127,6 +109,15 @@ public:
   {
     both_fields = 0;
     just_anti_alias = 0;
+    put_status = Y4M_OK;
+  }
+
+  // hands a finished frame to the caller; after an error the
+  // remaining frames are dropped
+  void put_frame (uint8_t ** frame)
+  {
+    if (put_status == Y4M_OK)
+      put_status = put (put_arg, frame);
   }
 
   ~deinterlacer ()
@@ -757,8 +748,7 @@ public:
 	    temporal_reconstruct_frame (outframe[1], inframe[1], inframe0[1],  inframe1[1], cwidth, cheight, 1, motion[1]);
 	    temporal_reconstruct_frame (outframe[2], inframe[2], inframe0[2],  inframe1[2], cwidth, cheight, 1, motion[1]);
 
-	    y4m_write_frame (Y4MStream.fd_out, &Y4MStream.ostreaminfo,
-	                     &Y4MStream.oframeinfo, outframe);
+	    put_frame (outframe);
 
 	    if (frame == 1)
 	      scale_motion_vectors (-1, both_fields);
@@ -769,8 +759,7 @@ public:
 		temporal_reconstruct_frame (outframe[1], inframe[1], inframe0[1],  inframe1[1], cwidth, cheight, 0, motion[1]);
 		temporal_reconstruct_frame (outframe[2], inframe[2], inframe0[2],  inframe1[2], cwidth, cheight, 0, motion[1]);
 
-		y4m_write_frame (Y4MStream.fd_out, &Y4MStream.ostreaminfo,
-		                 &Y4MStream.oframeinfo, outframe);
+		put_frame (outframe);
 	      }
 	  }
 	else
@@ -779,8 +768,7 @@ public:
 	    temporal_reconstruct_frame (outframe[1], inframe[1], inframe0[1],  inframe1[1], cwidth, cheight, 0, motion[1]);
 	    temporal_reconstruct_frame (outframe[2], inframe[2], inframe0[2],  inframe1[2], cwidth, cheight, 0, motion[1]);
 
-	    y4m_write_frame (Y4MStream.fd_out, &Y4MStream.ostreaminfo,
-	                     &Y4MStream.oframeinfo, outframe);
+	    put_frame (outframe);
 
 	    if (frame == 1)
 	      scale_motion_vectors (-1, both_fields);
@@ -791,8 +779,7 @@ public:
 		temporal_reconstruct_frame (outframe[1], inframe[1], inframe0[1],  inframe1[1], cwidth, cheight, 1, motion[1]);
 		temporal_reconstruct_frame (outframe[2], inframe[2], inframe0[2],  inframe1[2], cwidth, cheight, 1, motion[1]);
 
-		y4m_write_frame (Y4MStream.fd_out, &Y4MStream.ostreaminfo,
-		                 &Y4MStream.oframeinfo, outframe);
+		put_frame (outframe);
 	      }
 	  }
 
@@ -908,122 +895,24 @@ public:
     antialias_plane (inframe[1], cwidth, cheight);
     antialias_plane (inframe[2], cwidth, cheight);
 
-    y4m_write_frame (Y4MStream.fd_out, &Y4MStream.ostreaminfo, &Y4MStream.oframeinfo, inframe);
+    put_frame (inframe);
   }
 };
 
 }
 
+
+static deinterlacer *deint;
+static int frames;
+
 int
-main (int argc, char *argv[])
+yuvdeinterlace_init (const yuvdeinterlace_settings_t * s, int w, int h,
+		     int chroma, yuvdeinterlace_put_t put, void *arg)
 {
-  int frame = 0;
-  int errno = 0;
   int ss_h, ss_v;
 
-  deinterlacer YUVdeint;
-
-  char c;
-
-  YUVdeint.field_order = -1;
-
-  mjpeg_info("-------------------------------------------------");
-  mjpeg_info( "       Motion-Compensating-Deinterlacer");
-  mjpeg_info("-------------------------------------------------");
-
-  while ((c = getopt (argc, argv, "hvds:t:a")) != -1)
-    {
-      switch (c)
-	{
-	case 'h':
-	  {
-	    mjpeg_info(" Usage of the deinterlacer");
-	    mjpeg_info(" -------------------------");
-	    mjpeg_info(" -v be verbose");
-	    mjpeg_info(" -d output both fields");
-	    mjpeg_info(" -a just antialias the frames! This will");
-	    mjpeg_info("    assume progressive but aliased input.");
-	    mjpeg_info("    you can use this to improve badly deinterlaced");
-	    mjpeg_info("    footage. EG: deinterlaced with cubic-interpolation");
-	    mjpeg_info("    or worse...");
-
-	    mjpeg_info(" -s [n=0/1] forces field-order in case of misflagged streams");
-	    mjpeg_info("    -s0 is bottom-field-first");
-	    mjpeg_info("    -s1 is top-field-first");
-	    exit (0);
-	    break;
-	  }
-	case 'v':
-	  {
-	    YUVdeint.verbose = 1;
-	    break;
-	  }
-	case 'd':
-	  {
-	    YUVdeint.both_fields = 1;
-	    mjpeg_info("Regenerating both fields. Please fix the Framerate.");
-	    break;
-	  }
-	case 'a':
-	  {
-	    YUVdeint.just_anti_alias = 1;
-	    YUVdeint.field_order = 0;	// just to prevent the program to barf in this case
-	    mjpeg_info("I will just anti-alias the frames. make sure they are progressive!");
-	    break;
-	  }
-	case 't':
-	  {
-	    mjpeg_info("motion-threshold not used");
-	    break;
-	  }
-	case 's':
-	  {
-	    YUVdeint.field_order = atoi (optarg);
-	    if (YUVdeint.field_order != 0)
-	      {
-		mjpeg_info("forced top-field-first!");
-		YUVdeint.field_order = 1;
-	      }
-	    else
-	      {
-		mjpeg_info("forced bottom-field-first!");
-		YUVdeint.field_order = 0;
-	      }
-	    break;
-	  }
-	}
-    }
-
-  // initialize motionsearch-library      
-  init_motion_search ();
-
-#ifdef HAVE_ALTIVEC
-  reset_motion_simd ("sad_00");
-#endif
-
-  // initialize stream-information 
-  y4m_accept_extensions (1);
-  y4m_init_stream_info (&YUVdeint.Y4MStream.istreaminfo);
-  y4m_init_frame_info (&YUVdeint.Y4MStream.iframeinfo);
-  y4m_init_stream_info (&YUVdeint.Y4MStream.ostreaminfo);
-  y4m_init_frame_info (&YUVdeint.Y4MStream.oframeinfo);
-
-/* open input stream */
-  if ((errno = y4m_read_stream_header (YUVdeint.Y4MStream.fd_in,
-				       &YUVdeint.Y4MStream.istreaminfo)) != Y4M_OK)
-    {
-      mjpeg_error_exit1 ("Couldn't read YUV4MPEG header: %s!", y4m_strerr (errno));
-    }
-
-  /* get format information */
-  YUVdeint.width = y4m_si_get_width (&YUVdeint.Y4MStream.istreaminfo);
-  YUVdeint.height = y4m_si_get_height (&YUVdeint.Y4MStream.istreaminfo);
-  YUVdeint.input_chroma_subsampling = y4m_si_get_chroma (&YUVdeint.Y4MStream.istreaminfo);
-  mjpeg_info("Y4M-Stream is %ix%i(%s)", YUVdeint.width,
-	     YUVdeint.height, y4m_chroma_keyword (YUVdeint.input_chroma_subsampling));
-
   /* if chroma-subsampling isn't supported bail out ... */
-  switch (YUVdeint.input_chroma_subsampling)
+  switch (chroma)
     {
     case Y4M_CHROMA_420JPEG:
     case Y4M_CHROMA_420MPEG2:
@@ -1031,77 +920,64 @@ main (int argc, char *argv[])
     case Y4M_CHROMA_444:
     case Y4M_CHROMA_422:
     case Y4M_CHROMA_411:
-      ss_h = y4m_chroma_ss_x_ratio (YUVdeint.input_chroma_subsampling).d;
-      ss_v = y4m_chroma_ss_y_ratio (YUVdeint.input_chroma_subsampling).d;
-      YUVdeint.cwidth = YUVdeint.width / ss_h;
-      YUVdeint.cheight = YUVdeint.height / ss_v;
+      ss_h = y4m_chroma_ss_x_ratio (chroma).d;
+      ss_v = y4m_chroma_ss_y_ratio (chroma).d;
       break;
     default:
-      mjpeg_error_exit1 ("%s is not in supported chroma-format. Sorry.",
-			 y4m_chroma_keyword (YUVdeint.input_chroma_subsampling));
+      mjpeg_error ("%s is not in supported chroma-format. Sorry.",
+		   y4m_chroma_keyword (chroma));
+      return -1;
     }
 
-  /* the output is progressive 4:2:0 MPEG 1 */
-  y4m_si_set_interlace (&YUVdeint.Y4MStream.ostreaminfo, Y4M_ILACE_NONE);
-  y4m_si_set_chroma (&YUVdeint.Y4MStream.ostreaminfo, YUVdeint.input_chroma_subsampling);
-  y4m_si_set_width (&YUVdeint.Y4MStream.ostreaminfo, YUVdeint.width);
-  y4m_si_set_height (&YUVdeint.Y4MStream.ostreaminfo, YUVdeint.height);
-  y4m_si_set_framerate (&YUVdeint.Y4MStream.ostreaminfo,
-			y4m_si_get_framerate (&YUVdeint.Y4MStream.istreaminfo));
-  y4m_si_set_sampleaspect (&YUVdeint.Y4MStream.ostreaminfo,
-			   y4m_si_get_sampleaspect (&YUVdeint.Y4MStream.istreaminfo));
-
-/* check for field dominance */
+  // initialize motionsearch-library      
+  init_motion_search ();
 
-  if (YUVdeint.field_order == -1)
-    {
-      /* field-order was not specified on commandline. So we try to
-       * get it from the stream itself...
-       */
+#ifdef HAVE_ALTIVEC
+  reset_motion_simd ("sad_00");
+#endif
 
-      if (y4m_si_get_interlace (&YUVdeint.Y4MStream.istreaminfo) == Y4M_ILACE_TOP_FIRST)
-	{
-	  /* got it: Top-field-first... */
-	  mjpeg_info(" Stream is interlaced, top-field-first.");
-	  YUVdeint.field_order = 1;
-	}
-      else if (y4m_si_get_interlace (&YUVdeint.Y4MStream.istreaminfo) == Y4M_ILACE_BOTTOM_FIRST)
-	{
-	  /* got it: Bottom-field-first... */
-	  mjpeg_info(" Stream is interlaced, bottom-field-first.");
-	  YUVdeint.field_order = 0;
-	}
-      else
-	{
-	  mjpeg_error("Unable to determine field-order from input-stream.");
-	  mjpeg_error("This is most likely the case when using mplayer to produce the input-stream.");
-	  mjpeg_error("Either the stream is misflagged or progressive...");
-	  mjpeg_error("I will stop here, sorry. Please choose a field-order");
-	  mjpeg_error("with -s0 or -s1. Otherwise I can't do anything for you. TERMINATED. Thanks...");
-	  exit (-1);
-	}
-    }
+  deint = new deinterlacer;
+  deint->field_order = s->field_order;
+  deint->both_fields = s->both_fields;
+  deint->just_anti_alias = s->just_anti_alias;
+  deint->put = put;
+  deint->put_arg = arg;
 
   // initialize deinterlacer internals
-  YUVdeint.initialize_memory (YUVdeint.width, YUVdeint.height, YUVdeint.cwidth, YUVdeint.cheight);
+  deint->initialize_memory (w, h, w / ss_h, h / ss_v);
+  frames = 0;
+  return 0;
+}
 
-  /* write the outstream header */
-  y4m_write_stream_header (YUVdeint.Y4MStream.fd_out, &YUVdeint.Y4MStream.ostreaminfo);
+uint8_t **
+yuvdeinterlace_input (void)
+{
+  return deint->inframe;
+}
 
-  /* read every frame until the end of the input stream and process it */
-  while (Y4M_OK == (errno = y4m_read_frame (YUVdeint.Y4MStream.fd_in,
-					    &YUVdeint.Y4MStream.istreaminfo,
-					    &YUVdeint.Y4MStream.iframeinfo, YUVdeint.inframe)))
-    {
-      if (!YUVdeint.just_anti_alias)
-	YUVdeint.deinterlace_motion_compensated (frame);
-      else
-	YUVdeint.antialias_frame ();
-      frame++;
-    }
+int
+yuvdeinterlace_frame (void)
+{
+  if (!deint->just_anti_alias)
+    deint->deinterlace_motion_compensated (frames);
+  else
+    deint->antialias_frame ();
+  frames++;
+  return deint->put_status;
+}
 
-  if (!YUVdeint.just_anti_alias)
-    YUVdeint.deinterlace_motion_compensated (-frame);
+int
+yuvdeinterlace_flush (void)
+{
+  if (!deint->just_anti_alias)
+    deint->deinterlace_motion_compensated (-frames);
+  frames = 0;
+  return deint->put_status;
+}
 
-  return 0;
+void
+yuvdeinterlace_fini (void)
+{
+  delete deint;
+  deint = NULL;
 }
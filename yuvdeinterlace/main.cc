@@ -0,0 +1,219 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+#include <cstdlib>
+#include <unistd.h>
+#include "mjpeg_types.h"
+#include "yuv4mpeg.h"
+#include "mjpeg_logging.h"
+#include "yuvdeinterlace.h"
+
+namespace
+{
+
+class y4mstream
+{
+public:
+  int fd_in;
+  int fd_out;
+  y4m_frame_info_t iframeinfo;
+  y4m_stream_info_t istreaminfo;
+  y4m_frame_info_t oframeinfo;
+  y4m_stream_info_t ostreaminfo;
+
+    y4mstream ()
+  {
+    fd_in = 0;
+    fd_out = 1;
+  };
+
+};
+
+int
+write_frame (void *arg, uint8_t ** planes)
+{
+  y4mstream *Y4MStream = (y4mstream *) arg;
+
+  return y4m_write_frame (Y4MStream->fd_out, &Y4MStream->ostreaminfo,
+			  &Y4MStream->oframeinfo, planes);
+}
+
+}
+
+int
+main (int argc, char *argv[])
+{
+  int errno = 0;
+  int width, height, chroma;
+
+  y4mstream Y4MStream;
+  yuvdeinterlace_settings_t settings;
+
+  char c;
+
+  settings.field_order = -1;
+  settings.both_fields = 0;
+  settings.just_anti_alias = 0;
+
+  mjpeg_info("-------------------------------------------------");
+  mjpeg_info( "       Motion-Compensating-Deinterlacer");
+  mjpeg_info("-------------------------------------------------");
+
+  while ((c = getopt (argc, argv, "hvds:t:a")) != -1)
+    {
+      switch (c)
+	{
+	case 'h':
+	  {
+	    mjpeg_info(" Usage of the deinterlacer");
+	    mjpeg_info(" -------------------------");
+	    mjpeg_info(" -v be verbose");
+	    mjpeg_info(" -d output both fields");
+	    mjpeg_info(" -a just antialias the frames! This will");
+	    mjpeg_info("    assume progressive but aliased input.");
+	    mjpeg_info("    you can use this to improve badly deinterlaced");
+	    mjpeg_info("    footage. EG: deinterlaced with cubic-interpolation");
+	    mjpeg_info("    or worse...");
+
+	    mjpeg_info(" -s [n=0/1] forces field-order in case of misflagged streams");
+	    mjpeg_info("    -s0 is bottom-field-first");
+	    mjpeg_info("    -s1 is top-field-first");
+	    exit (0);
+	    break;
+	  }
+	case 'v':
+	  {
+	    break;
+	  }
+	case 'd':
+	  {
+	    settings.both_fields = 1;
+	    mjpeg_info("Regenerating both fields. Please fix the Framerate.");
+	    break;
+	  }
+	case 'a':
+	  {
+	    settings.just_anti_alias = 1;
+	    settings.field_order = 0;	// just to prevent the program to barf in this case
+	    mjpeg_info("I will just anti-alias the frames. make sure they are progressive!");
+	    break;
+	  }
+	case 't':
+	  {
+	    mjpeg_info("motion-threshold not used");
+	    break;
+	  }
+	case 's':
+	  {
+	    settings.field_order = atoi (optarg);
+	    if (settings.field_order != 0)
+	      {
+		mjpeg_info("forced top-field-first!");
+		settings.field_order = 1;
+	      }
+	    else
+	      {
+		mjpeg_info("forced bottom-field-first!");
+		settings.field_order = 0;
+	      }
+	    break;
+	  }
+	}
+    }
+
+  // initialize stream-information 
+  y4m_accept_extensions (1);
+  y4m_init_stream_info (&Y4MStream.istreaminfo);
+  y4m_init_frame_info (&Y4MStream.iframeinfo);
+  y4m_init_stream_info (&Y4MStream.ostreaminfo);
+  y4m_init_frame_info (&Y4MStream.oframeinfo);
+
+/* open input stream */
+  if ((errno = y4m_read_stream_header (Y4MStream.fd_in,
+				       &Y4MStream.istreaminfo)) != Y4M_OK)
+    {
+      mjpeg_error_exit1 ("Couldn't read YUV4MPEG header: %s!", y4m_strerr (errno));
+    }
+
+  /* get format information */
+  width = y4m_si_get_width (&Y4MStream.istreaminfo);
+  height = y4m_si_get_height (&Y4MStream.istreaminfo);
+  chroma = y4m_si_get_chroma (&Y4MStream.istreaminfo);
+  mjpeg_info("Y4M-Stream is %ix%i(%s)", width,
+	     height, y4m_chroma_keyword (chroma));
+
+  /* the output is progressive 4:2:0 MPEG 1 */
+  y4m_si_set_interlace (&Y4MStream.ostreaminfo, Y4M_ILACE_NONE);
+  y4m_si_set_chroma (&Y4MStream.ostreaminfo, chroma);
+  y4m_si_set_width (&Y4MStream.ostreaminfo, width);
+  y4m_si_set_height (&Y4MStream.ostreaminfo, height);
+  y4m_si_set_framerate (&Y4MStream.ostreaminfo,
+			y4m_si_get_framerate (&Y4MStream.istreaminfo));
+  y4m_si_set_sampleaspect (&Y4MStream.ostreaminfo,
+			   y4m_si_get_sampleaspect (&Y4MStream.istreaminfo));
+
+/* check for field dominance */
+
+  if (settings.field_order == -1)
+    {
+      /* field-order was not specified on commandline. So we try to
+       * get it from the stream itself...
+       */
+
+      if (y4m_si_get_interlace (&Y4MStream.istreaminfo) == Y4M_ILACE_TOP_FIRST)
+	{
+	  /* got it: Top-field-first... */
+	  mjpeg_info(" Stream is interlaced, top-field-first.");
+	  settings.field_order = 1;
+	}
+      else if (y4m_si_get_interlace (&Y4MStream.istreaminfo) == Y4M_ILACE_BOTTOM_FIRST)
+	{
+	  /* got it: Bottom-field-first... */
+	  mjpeg_info(" Stream is interlaced, bottom-field-first.");
+	  settings.field_order = 0;
+	}
+      else
+	{
+	  mjpeg_error("Unable to determine field-order from input-stream.");
+	  mjpeg_error("This is most likely the case when using mplayer to produce the input-stream.");
+	  mjpeg_error("Either the stream is misflagged or progressive...");
+	  mjpeg_error("I will stop here, sorry. Please choose a field-order");
+	  mjpeg_error("with -s0 or -s1. Otherwise I can't do anything for you. TERMINATED. Thanks...");
+	  exit (-1);
+	}
+    }
+
+  // initialize deinterlacer internals
+  if (yuvdeinterlace_init (&settings, width, height, chroma,
+			   write_frame, &Y4MStream))
+    exit (1);
+
+  /* write the outstream header */
+  y4m_write_stream_header (Y4MStream.fd_out, &Y4MStream.ostreaminfo);
+
+  /* read every frame until the end of the input stream and process it */
+  while (Y4M_OK == (errno = y4m_read_frame (Y4MStream.fd_in,
+					    &Y4MStream.istreaminfo,
+					    &Y4MStream.iframeinfo,
+					    yuvdeinterlace_input ())))
+    yuvdeinterlace_frame ();
+
+  yuvdeinterlace_flush ();
+  yuvdeinterlace_fini ();
+
+  return 0;
+}
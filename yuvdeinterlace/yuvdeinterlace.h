@@ -0,0 +1,64 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* The deinterlacer of yuvdeinterlace, without the stream handling, so
+ * that other programs can run it on frames they have in memory:
+ *
+ *   yuvdeinterlace_init (&settings, width, height, chroma, put, arg);
+ *   for every frame:
+ *     put it into the planes yuvdeinterlace_input() returns
+ *     yuvdeinterlace_frame ();
+ *   yuvdeinterlace_flush ();
+ *   yuvdeinterlace_fini ();
+ *
+ * Every output frame is handed to put(arg, planes), whose planes are only
+ * valid during the call.  Unless just_anti_alias is set, the output is one
+ * frame behind the input, and there are two output frames per input frame
+ * if both_fields is set.  yuvdeinterlace_frame() and yuvdeinterlace_flush()
+ * return Y4M_OK, or the first error put() returned; the frames after that
+ * are dropped.  There is one deinterlacer per process.
+ */
+
+#ifndef __YUVDEINTERLACE_H__
+#define __YUVDEINTERLACE_H__
+
+#include "mjpeg_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  int field_order;		/* 0: bottom field first, 1: top field first */
+  int both_fields;		/* -d, a frame for each field */
+  int just_anti_alias;		/* -a, progressive input */
+} yuvdeinterlace_settings_t;
+
+typedef int (*yuvdeinterlace_put_t) (void *arg, uint8_t ** planes);
+
+int yuvdeinterlace_init (const yuvdeinterlace_settings_t * s, int w, int h,
+			 int chroma, yuvdeinterlace_put_t put, void *arg);
+uint8_t **yuvdeinterlace_input (void);
+int yuvdeinterlace_frame (void);
+int yuvdeinterlace_flush (void);
+void yuvdeinterlace_fini (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __YUVDEINTERLACE_H__ */
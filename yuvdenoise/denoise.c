@@ -0,0 +1,2487 @@
+/***********************************************************
+ * YUVDENOISER for the mjpegtools                          *
+ * ------------------------------------------------------- *
+ * (C) 2001-2004 Stefan Fendt                              *
+ *                                                         *
+ * Licensed and protected by the GNU-General-Public-       *
+ * License version 2 or if you prefer any later version of *
+ * that license). See the file LICENSE for detailed infor- *
+ * mation.                                                 *
+ *                                                         *
+ * FILE: denoise.c                                         *
+ *                                                         *
+ ***********************************************************/
+
+/* 2010-09-22, Franz Brauße <dev@karlchenofhell.org>
+ *  - added SSE2-accelerated versions of filter_plane_median()
+ *    and temporal_filter_planes()
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "config.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "mjpeg_types.h"
+#include "yuv4mpeg.h"
+#include "mjpeg_logging.h"
+#include "cpu_accel.h"
+#include "motionsearch.h"
+#include "yuvdenoise.h"
+
+#if defined(__SSE3__)
+# include <pmmintrin.h>
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+/* The AVX2 and AVX-512BW kernels are built for their instruction sets by
+ * function attributes, whatever the flags of the rest of the file, and are
+ * picked at run time.  They compute exactly what the SSE2 kernels do, so
+ * they are left out when those are built with the OLD_ROUNDING variants.
+ */
+#if defined(__SSE2__) && !defined(OLD_ROUNDING) && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+# include <immintrin.h>
+# define HAVE_AVX_KERNELS 1
+# define AVX2_FN __attribute__ ((target ("avx2")))
+# define AVX512_FN __attribute__ ((target ("avx2,avx512f,avx512bw")))
+#endif
+
+static int width = 0;
+static int height = 0;
+static int lwidth = 0;
+static int lheight = 0;
+static int cwidth = 0;
+static int cheight = 0;
+static int input_chroma_subsampling = 0;
+static int input_interlaced = 0;
+static int hq_mode = 0;
+static int sample_size = 1;		/* bytes: 2 for more than 8 bits */
+static int shift = 0;			/* the bits above 8 */
+
+static yuvdenoise_settings_t settings;
+static uint32_t frame_nr = 0;
+static int frames_left = -1;	/* to be flushed, -1 before the first flush */
+
+/* The temporal filters take the frame 'radius' frames back, and the
+ * 'radius' frames before and after it.  These are kept in a ring of
+ * slots, which moves on by one slot a frame: the slot of the oldest frame
+ * is the one the next frame is read into.
+ */
+#define MAX_RADIUS YUVDENOISE_MAX_RADIUS
+static int radius = 3;
+static int ring_slots = 7;
+static uint8_t *ring[2 * MAX_RADIUS + 1][3];
+static int ring_pos = 0;		/* slot of the newest frame */
+
+/* the planes of the frame read 'age' frames ago */
+static inline uint8_t **
+frame_at (int age)
+{
+  return ring[(ring_pos + age) % ring_slots];
+}
+
+static uint8_t *scratchplane1[3];
+static uint8_t *scratchplane2[3];
+static uint8_t *outframe[3];
+
+static int buff_offset;
+static int buff_size;
+
+uint16_t transform_L16[256];
+uint8_t transform_G8[65536];
+
+/***********************************************************
+ * bands and threads                                       *
+ ***********************************************************/
+
+/* Every filter pass is cut into bands of consecutive pixels of a plane.
+ * A band may read anything of its source planes, but writes only its own
+ * pixels of the destination plane, so all bands of a pass -- of all three
+ * planes -- can run at the same time.  The last band of a plane runs on to
+ * wherever the whole-plane filter stopped, overshooting into the buffer
+ * margin as it always did, and the output does not depend on the number
+ * of threads.
+ */
+typedef struct band_s band_t;
+struct band_s
+{
+  void (*filter) (const band_t *);
+  int idx;			/* plane 0, 1 or 2 */
+  uint8_t *src;
+  uint8_t *dst;
+  int w, h, t;
+  int first, last;		/* pixels first ... last-1 */
+  int final;			/* last band of the plane */
+};
+
+#define MAX_THREADS 64
+
+/* a multiple of the 14 pixels the SSE2 passes take at a time, and of 4 */
+#define BAND_ALIGN 28
+
+static int threads = 1;
+static band_t bands[3 * MAX_THREADS];
+static int nbands = 0;
+
+static void
+add_bands (void (*filter) (const band_t *), int idx, uint8_t * src,
+	   uint8_t * dst, int t, int size, int align)
+{
+  int w = idx ? cwidth : lwidth;
+  int h = idx ? cheight : lheight;
+  int k, first = 0, last;
+  band_t *b;
+
+  for (k = 1; k <= threads; k++)
+    {
+      if (k == threads)
+	last = size;
+      else
+	last = (int) ((int64_t) size * k / threads) / align * align;
+      if (last <= first)
+	continue;
+      b = &bands[nbands++];
+      b->filter = filter;
+      b->idx = idx;
+      b->src = src;
+      b->dst = dst;
+      b->w = w;
+      b->h = h;
+      b->t = t;
+      b->first = first;
+      b->last = last;
+      b->final = (k == threads);
+      first = last;
+    }
+}
+
+#ifdef HAVE_PTHREAD
+static pthread_t workers[MAX_THREADS];
+static pthread_mutex_t band_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done = PTHREAD_COND_INITIALIZER;
+static int queued = 0;		/* bands [next_band, queued) wait for a thread */
+static int next_band = 0;
+static int bands_left = 0;	/* not finished yet */
+static int quit = 0;
+
+static void *
+band_worker (void *arg)
+{
+  int b;
+
+  pthread_mutex_lock (&band_lock);
+  for (;;)
+    {
+      while (next_band >= queued && !quit)
+	pthread_cond_wait (&band_queued, &band_lock);
+      if (quit)
+	break;
+      b = next_band++;
+      pthread_mutex_unlock (&band_lock);
+
+      bands[b].filter (&bands[b]);
+
+      pthread_mutex_lock (&band_lock);
+      if (--bands_left == 0)
+	pthread_cond_signal (&band_done);
+    }
+  pthread_mutex_unlock (&band_lock);
+  return NULL;
+}
+#endif
+
+/* n threads, or if n is 0, YUVDENOISE_THREADS or one per processor */
+static void
+start_threads (int n)
+{
+  const char *env = getenv ("YUVDENOISE_THREADS");
+
+  if (n <= 0 && env != NULL)
+    n = atoi (env);
+  else if (n <= 0)
+    n = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  if (n > MAX_THREADS)
+    n = MAX_THREADS;
+  threads = 1;
+#ifdef HAVE_PTHREAD
+  quit = 0;
+  /* the calling thread is one of them */
+  for (threads = 1; threads < n; threads++)
+    if (pthread_create (&workers[threads], NULL, band_worker, NULL))
+      {
+	mjpeg_warn ("Only %d of %d threads started", threads, n);
+	break;
+      }
+#endif
+  mjpeg_info ("Filtering with %d thread(s)", threads);
+}
+
+static void
+stop_threads (void)
+{
+#ifdef HAVE_PTHREAD
+  int i;
+
+  pthread_mutex_lock (&band_lock);
+  quit = 1;
+  pthread_cond_broadcast (&band_queued);
+  pthread_mutex_unlock (&band_lock);
+  for (i = 1; i < threads; i++)
+    pthread_join (workers[i], NULL);
+#endif
+}
+
+/* filter the bands added since the last call, and wait for all of them */
+static void
+run_bands (void)
+{
+  int b;
+
+#ifdef HAVE_PTHREAD
+  if (threads > 1)
+    {
+      pthread_mutex_lock (&band_lock);
+      next_band = 0;
+      queued = bands_left = nbands;
+      pthread_cond_broadcast (&band_queued);
+      for (;;)
+	{
+	  while (next_band < queued)
+	    {
+	      b = next_band++;
+	      pthread_mutex_unlock (&band_lock);
+	      bands[b].filter (&bands[b]);
+	      pthread_mutex_lock (&band_lock);
+	      bands_left--;
+	    }
+	  if (bands_left == 0)
+	    break;
+	  pthread_cond_wait (&band_done, &band_lock);
+	}
+      next_band = queued = 0;
+      pthread_mutex_unlock (&band_lock);
+      nbands = 0;
+      return;
+    }
+#endif
+  for (b = 0; b < nbands; b++)
+    bands[b].filter (&bands[b]);
+  nbands = 0;
+}
+
+/***********************************************************
+ * helper-functions                                        *
+ ***********************************************************/
+
+static void (*gauss_filter_band_fn)(const band_t *);
+static void (*filter_band_median1)(const band_t *);
+static void (*filter_band_median2)(const band_t *);
+static void (*temporal_filter_band)(const band_t *);
+static void (*temporal_filter_band_hq)(const band_t *);
+static uint32_t (*block_sad)(uint8_t *, uint8_t *, int);
+
+
+static void
+gauss_filter_band (const band_t * b)
+{
+int i;
+int v;
+int w = b->w;
+int t = b->t;
+uint8_t * src = b->src + b->first;
+uint8_t * dst = b->dst + b->first;
+
+for(i=b->first;i<b->last;i++)
+	{
+
+	v  = *(src    -2)*1;
+
+	v += *(src-w  -1)*1;
+	v += *(src    -1)*2;
+	v += *(src+w  -1)*1;
+
+	v += *(src-w*2  )*1;
+	v += *(src-w    )*2;
+	v += *(src      )*4;
+	v += *(src+w    )*2;
+	v += *(src+w*2  )*1;
+
+	v += *(src-w  +1)*1;
+	v += *(src    +1)*2;
+	v += *(src+w  +1)*1;
+
+	v += *(src    +2)*1;
+
+	v /= 20;
+
+	v = *(src)*(256-t) + (v)*(t);
+	v /= 256;
+
+	*(dst)=v;
+
+	dst++;
+	src++;
+	}
+}
+
+static void
+gauss_filter_planes (uint8_t * frame[3], const int t[3])
+{
+int i, w, h;
+
+for(i=0;i<3;i++)
+	{
+	if(t[i]==0) continue;
+
+	w = i ? cwidth : lwidth;
+	h = i ? cheight : lheight;
+
+	// in bytes
+	w *= sample_size;
+
+	memcpy ( frame[i]-w*2, frame[i], w );
+	memcpy ( frame[i]-w  , frame[i], w );
+
+	memcpy ( frame[i]+(w*h)  , frame[i]+(w*h)-w, w );
+	memcpy ( frame[i]+(w*h)+w, frame[i]+(w*h)-w, w );
+
+	add_bands ( gauss_filter_band_fn, i, frame[i], scratchplane1[i], t[i], w/sample_size*h, 1 );
+	}
+run_bands ();
+
+for(i=0;i<3;i++)
+	if(t[i]!=0)
+		memcpy ( frame[i], scratchplane1[i], (i ? cwidth*cheight : lwidth*lheight) * sample_size );
+}
+
+/* SAD of the 16x16 blocks at blk1 and blk2, lines w apart */
+static uint32_t
+block_sad_psad (uint8_t * blk1, uint8_t * blk2, int w)
+{
+  return psad_00 (blk1, blk2, w, 16, 0x00ffffff);
+}
+
+/* Pointers at 'first' into plane idx of the frame filtered (*centre) and
+ * of the frames around it (ref), nearest first, and of each pair the later
+ * frame first.  Returns the number of frames in ref, 2 * radius.
+ */
+static int
+temporal_planes (int idx, int first, uint8_t ** centre, uint8_t * ref[])
+{
+  int k, n = 0;
+
+  first *= sample_size;
+  *centre = frame_at (radius)[idx] + first;
+  for (k = 1; k <= radius; k++)
+    {
+      ref[n++] = frame_at (radius - k)[idx] + first;
+      ref[n++] = frame_at (radius + k)[idx] + first;
+    }
+  return n;
+}
+
+/* bands of whole rows of 16x16 blocks; a block sticking out on the right
+ * writes into the next line, which in the next band is left to that band */
+static void
+temporal_filter_band_MC (const band_t * b)
+{
+  int idx = b->idx;
+  int w = b->w;
+  int h = b->final ? b->h : b->last / w;
+  int t = b->t;
+
+  uint32_t sad,min;
+  uint32_t r, c, m;
+  int32_t d;
+  int x,y,sx,sy;
+  int k, n, px, py;
+
+  uint32_t v;
+  int vx[2 * MAX_RADIUS], vy[2 * MAX_RADIUS];
+
+  uint8_t *f4, *f[2 * MAX_RADIUS];
+  uint8_t *of = outframe[idx];
+
+  n = temporal_planes (idx, 0, &f4, f);
+
+#if 1
+
+  if (t == 0)			// shortcircuit filter if t = 0...
+    {
+      memcpy (of + b->first, f4 + b->first, b->last - b->first);
+      return;
+    }
+#endif
+
+      for (y = b->first / w; y < h; y+=16)
+      for (x = 0; x < w; x+=16)
+	{
+
+	// find best matching 16x16 block for each frame, searching around
+	// the vector found for the frame next to it on the same side
+	for (k = 0; k < n; k++)
+	{
+	px = k < 2 ? 0 : vx[k-2];
+	py = k < 2 ? 0 : vy[k-2];
+	min=block_sad ( f4+(x)+(y)*w,f[k]+(x)+(y)*w,w );
+	vx[k]=vy[k]=0;
+	for (sy=(py-4); sy < (py+4); sy++)
+	for (sx=(px-4); sx < (px+4); sx++)
+	{
+		sad  = block_sad ( f4+(x)+(y)*w,f[k]+(x+sx)+(y+sy)*w,w );
+		sad += block_sad ( f4+(x+8)+(y)*w,f[k]+(x+sx+8)+(y+sy)*w,w );
+		if(sad<min)
+		{
+		vx[k] = sx;
+		vy[k] = sy;
+		min = sad;
+		}
+	}
+	}
+
+	for (sy=0; sy < 16; sy++)
+	for (sx=0; sx < 16; sx++)
+	{
+		// gauss-filtered reference pixel
+		r  = *(f4+(x+sx-1)+(y+sy-1)*w);
+		r += *(f4+(x+sx  )+(y+sy-1)*w)*2;
+		r += *(f4+(x+sx+1)+(y+sy-1)*w);
+		r += *(f4+(x+sx-1)+(y+sy  )*w)*2;
+		r += *(f4+(x+sx  )+(y+sy  )*w)*4;
+		r += *(f4+(x+sx+1)+(y+sy  )*w)*2;
+		r += *(f4+(x+sx-1)+(y+sy+1)*w);
+		r += *(f4+(x+sx  )+(y+sy+1)*w)*2;
+		r += *(f4+(x+sx+1)+(y+sy+1)*w);
+		r /= 16;
+
+		// add non-filtered reference to the accummulator
+		m = *(f4+(x+sx  )+(y+sy  )*w)*t;
+		c = t;
+
+		for (k = 0; k < n; k++)
+		{
+		// gauss-filtered and translated test pixel
+		uint8_t *p = f[k]+(x+sx+vx[k])+(y+sy+vy[k])*w;
+
+		v  = *(p-1-w);
+		v += *(p  -w)*2;
+		v += *(p+1-w);
+		v += *(p-1  )*2;
+		v += *(p    )*4;
+		v += *(p+1  )*2;
+		v += *(p-1+w);
+		v += *(p  +w)*2;
+		v += *(p+1+w);
+		v /= 16;
+
+		// add weighted and translated but non-filtered test-pixel
+		d = t - abs (r-v);
+		d = d<0? 0:d;
+	  	c += d;
+          	m += *(p)*d;
+		}
+
+		if (b->final || (x+sx)+(y+sy)*w < b->last)
+		*(of+(x+sx)+(y+sy)*w) = m/c;
+
+	}
+	}
+}
+
+static void renoise (uint8_t * frame, int w, int h, int level )
+{
+uint8_t random[8192];
+int i;
+static int cnt=0;
+
+for(i=0;i<8192;i++)
+	random[(i+cnt/2)&8191]=(i+i+i+i*i*i+1-random[i-1]+random[i-20]*random[i-5]*random[i-25])&255;
+cnt++;
+
+if(sample_size>1)
+	{
+	uint16_t * f = (uint16_t *) frame;
+	for(i=0;i<(w*h);i++)
+		*(f+i)=(*(f+i)*(255-level)+(random[i&8191]<<shift)*level)/255;
+	return;
+	}
+for(i=0;i<(w*h);i++)
+	*(frame+i)=(*(frame+i)*(255-level)+random[i&8191]*level)/255;
+}
+
+#if defined(__SSE2__)
+
+/* The quotients below are rounded to whole pixel values, so they have to be
+ * exact: with -ffast-math gcc would compute them from an approximate
+ * reciprocal, which rounds halves either way, and differently for SSE, AVX
+ * and AVX-512.  Hence the division in assembler.
+ */
+static inline __m128 div_ps(__m128 a, const __m128 b) {
+	__asm__ ("divps %1, %0" : "+x" (a) : "x" (b));
+	return a;
+}
+
+static inline __m128i tf0(const __m128i mask, const __m128i l0, const __m128i vt, const __m128i vc, const __m128i vb) {
+	__m128i k0, k1, k2, k3, d0; /* temp storage, pixel surroundings, 16-bit words */
+	
+	/* even pixels */
+	/* extract and add the pixels above and below the current one */
+	k0 = _mm_and_si128(_mm_srli_si128(vt, 1), mask);
+	k1 = _mm_and_si128(_mm_srli_si128(vb, 1), mask);
+	k0 = _mm_add_epi16(k0, k1);
+	
+	/* add together the 4 corner pixels diagonal of the current one */
+	k2 = _mm_add_epi16(_mm_and_si128(vt, mask), _mm_and_si128(vb, mask));
+	k2 = _mm_add_epi16(k2, _mm_srli_si128(k2, 2));
+	
+	/* add pixels left and right of the current */
+	k3 = _mm_and_si128(vc, mask);
+	k3 = _mm_add_epi16(k3, _mm_srli_si128(k3, 2));
+	
+	/* add weighted current pixel and the above results */
+	k1 = _mm_and_si128(_mm_srli_si128(vc, 1), mask);
+	d0 = _mm_slli_epi16(k1, 1); /* center * 4 */
+	d0 = _mm_add_epi16(d0, k0);
+	d0 = _mm_add_epi16(d0, k3);
+	d0 = _mm_slli_epi16(d0, 1); /* + above,below,left,right * 2 */
+	d0 = _mm_add_epi16(d0, k2); /* + diagonal * 1 */
+	d0 = _mm_srli_epi16(d0, 4); /* all / 16 */
+	return d0;
+}
+
+static inline __m128i tf1(const __m128i mask, const __m128i l0, const __m128i vt, const __m128i vc, const __m128i vb) {
+	__m128i k0, k1, k2, k3, d1;
+	
+	k0 = _mm_srli_si128(_mm_add_epi16(_mm_and_si128(vt, mask), _mm_and_si128(vb, mask)), 2);
+	
+	k1 = _mm_and_si128(_mm_srli_si128(vt, 1), mask);
+	k2 = _mm_and_si128(_mm_srli_si128(vb, 1), mask);
+	k2 = _mm_add_epi16(k1, k2);
+	k2 = _mm_add_epi16(k2, _mm_srli_si128(k2, 2));
+	
+	k3 = _mm_and_si128(_mm_srli_si128(vc, 1), mask);
+	k3 = _mm_add_epi16(k3, _mm_srli_si128(k3, 2));
+	
+	k1 = _mm_and_si128(_mm_srli_si128(vc, 2), mask);
+	d1 = _mm_slli_epi16(k1, 1);
+	d1 = _mm_add_epi16(d1, k0);
+	d1 = _mm_add_epi16(d1, k3);
+	d1 = _mm_slli_epi16(d1, 1);
+	d1 = _mm_add_epi16(d1, k2);
+	d1 = _mm_srli_epi16(d1, 4);
+	return d1;
+}
+
+/* 8 times as fast on x86_64, 2.2 times as fast on i686 */
+static void temporal_filter_band_sse2(const band_t *b)
+{
+	int x, k;
+	int idx = b->idx;
+	int w = b->w;
+	int t = b->t;
+	
+	int n;
+	uint8_t *f4, *f[2 * MAX_RADIUS];
+	uint8_t *of = outframe[idx] + b->first;
+	
+	n = temporal_planes (idx, b->first, &f4, f);
+	
+	if (t == 0)			// shortcircuit filter if t = 0...
+	{
+		memcpy (of, f4, b->last - b->first);
+		return;
+	}
+	
+	/* vt: x x x x x x x x x x x x x x x x
+	 * vc: x 0 1 2 3 4 5 6 7 8 9 a b c d x
+	 * vb: x x x x x x x x x x x x x x x x
+	 *
+	 * c0, d0, m0 and m1 store the respective values for even pixels,
+	 * m0 for 0, 2, 4 and 6, m1 for 8, a and c in its lower dwords;
+	 * c1, d1, m2 and m3 store the values for the odd pixels,
+	 * m2 for 1, 3, 5 and 7, m3 for 9, b and d in its lower dwords;
+	 * whereas computation for each pixel is as follows (equivalent to the
+	 * non-SSE-accelerated variant of this function):
+	 *
+	 * for each pixel k1 of the 14 pixels per block:
+	 * vt:  k2  k0  k2
+	 * vc:  k3  k1  k3
+	 * vb:  k2  k0  k2
+	 *
+	 * r = *f4++;
+	 * c = t + 1;
+	 * m = r * (t+1);
+	 * for (i=0; i<2*radius; i++) {
+	 *   d = sum(k2) + 2 * (sum(k0) + sum(k3) + 2 * k1)
+	 *   d = saturate(t - abs(r-d));
+	 *   c += d;
+	 *   m += *f[i]++ * d;
+	 * }
+	 * m *= 2;
+	 * *of++ = (m / c + 1) / 2;
+	 *
+	 * For each frame, first the 7 even pixels are being processed, then the 7
+	 * odd ones.
+	 */
+	
+	__m128i vt, vc, vb;      /* top-, center- and bottom-line of 3x16 block */
+	__m128i c0, c1, m0, m1, m2, m3; /* c: 16-bit words, m: 32-bit dwords */
+	__m128i d0, d1, r0, r1;  /* 16-bit words, 0: even, 1: odd */
+	const __m128i mask = _mm_set1_epi16(0x00ff);
+	const __m128i l0 = _mm_set1_epi16(t);
+	
+#ifndef OLD_ROUNDING
+	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
+#endif
+	
+	for (x = b->first; x < b->last; x+=14)
+	{
+		vt = _mm_loadu_si128((__m128i *)(f4 - 1 - w));
+		vc = _mm_loadu_si128((__m128i *)(f4 - 1    ));
+		vb = _mm_loadu_si128((__m128i *)(f4 - 1 + w));
+		f4 += 14;
+		
+		r0 = tf0(mask, l0, vt, vc, vb);  /* even pixels */
+		r1 = tf1(mask, l0, vt, vc, vb);  /* odd pixels */
+		
+		c0 = c1 = _mm_set1_epi16(t + 1);
+		
+		/* m = *f4 * (t+1) */
+		/* The low 16-bit of the multiplication suffice, because both operands are
+		 * only 8-bit-values */
+		d0 = _mm_mullo_epi16(_mm_and_si128(_mm_srli_si128(vc, 1), mask), c0);
+		m0 = _mm_unpacklo_epi16(d0, _mm_setzero_si128());
+		m1 = _mm_unpackhi_epi16(d0, _mm_setzero_si128());
+		d1 = _mm_mullo_epi16(_mm_and_si128(_mm_srli_si128(vc, 2), mask), c0);
+		m2 = _mm_unpacklo_epi16(d1, _mm_setzero_si128());
+		m3 = _mm_unpackhi_epi16(d1, _mm_setzero_si128());
+		
+		for (k=0; k<n; k++) {
+			vt = _mm_loadu_si128((__m128i *)(f[k] - 1 - w));
+			vc = _mm_loadu_si128((__m128i *)(f[k] - 1    ));
+			vb = _mm_loadu_si128((__m128i *)(f[k] - 1 + w));
+			f[k] += 14;
+			
+			/* even pixels */
+			d0 = tf0(mask, l0, vt, vc, vb);
+			/* d = l - abs(r-d) */
+			d0 = _mm_subs_epu16(l0, _mm_sub_epi16(_mm_max_epi16(r0, d0), _mm_min_epi16(r0, d0)));
+			c0 = _mm_add_epi16(c0, d0);
+			/* d *= *f[k] */
+			d0 = _mm_mullo_epi16(_mm_and_si128(_mm_srli_si128(vc, 1), mask), d0);
+			m0 = _mm_add_epi32(m0, _mm_unpacklo_epi16(d0, _mm_setzero_si128()));
+			m1 = _mm_add_epi32(m1, _mm_unpackhi_epi16(d0, _mm_setzero_si128()));
+			
+			/* odd pixels */
+			d1 = tf1(mask, l0, vt, vc, vb);
+			d1 = _mm_subs_epu16(l0, _mm_sub_epi16(_mm_max_epi16(r1, d1), _mm_min_epi16(r1, d1)));
+			c1 = _mm_add_epi16(c1, d1);
+			d1 = _mm_mullo_epi16(_mm_and_si128(_mm_srli_si128(vc, 2), mask), d1);
+			m2 = _mm_add_epi32(m2, _mm_unpacklo_epi16(d1, _mm_setzero_si128()));
+			m3 = _mm_add_epi32(m3, _mm_unpackhi_epi16(d1, _mm_setzero_si128()));
+		}
+		
+		/* extract results from c0, c1 and m0 to m3:
+		 * 14 byte result = interleave_bytes((m0,m1) / c0, (m2,m3) / c1) */
+#ifdef OLD_ROUNDING
+		/* r = m*2/c */
+		/* multiply each m with 2 */
+		m0 = _mm_slli_epi32(m0, 1);
+		m1 = _mm_slli_epi32(m1, 1);
+		m2 = _mm_slli_epi32(m2, 1);
+		m3 = _mm_slli_epi32(m3, 1);
+#endif
+		
+		/* m0-m3 each contain 4 values of at most 21 bits ((8-bit)^2 * 17 with
+		 * MAX_RADIUS 8), so a single precision float with 23-bit mantissa can
+		 * hold these without precision loss */
+		/* r = m/c */
+		__m128i k0 = _mm_setzero_si128();
+		__m128 f0, f1, f2, f3;
+		f0 = div_ps(_mm_cvtepi32_ps(m0), _mm_cvtepi32_ps(_mm_unpacklo_epi16(c0, k0)));
+		f1 = div_ps(_mm_cvtepi32_ps(m1), _mm_cvtepi32_ps(_mm_unpackhi_epi16(c0, k0)));
+		f2 = div_ps(_mm_cvtepi32_ps(m2), _mm_cvtepi32_ps(_mm_unpacklo_epi16(c1, k0)));
+		f3 = div_ps(_mm_cvtepi32_ps(m3), _mm_cvtepi32_ps(_mm_unpackhi_epi16(c1, k0)));
+		
+#ifdef OLD_ROUNDING
+		m0 = _mm_cvttps_epi32(f0);
+		m1 = _mm_cvttps_epi32(f1);
+		m2 = _mm_cvttps_epi32(f2);
+		m3 = _mm_cvttps_epi32(f3);
+#else
+		m0 = _mm_cvtps_epi32(f0);
+		m1 = _mm_cvtps_epi32(f1);
+		m2 = _mm_cvtps_epi32(f2);
+		m3 = _mm_cvtps_epi32(f3);
+#endif
+		
+		r0 = _mm_packs_epi32(m0, m1); /* 7 words f0,f1 */
+		r1 = _mm_packs_epi32(m2, m3); /* 7 words f2,f3 */
+		
+#ifdef OLD_ROUNDING
+		/* (r+1)/2 */
+		k0 = _mm_set1_epi16(1);
+		r0 = _mm_srli_epi16(_mm_add_epi16(r0, k0), 1);
+		r1 = _mm_srli_epi16(_mm_add_epi16(r1, k0), 1);
+#endif
+		
+		/* 7 words r0 interleaved with 7 words r1, all converted to bytes */
+		r0 = _mm_packus_epi16(_mm_unpacklo_epi16(r0, r1), _mm_unpackhi_epi16(r0, r1));
+		/* write 16, but the 2 bytes overlap will be overwritten by the next pass;
+		 * at the end of a band they belong to the next band */
+		if (b->final || x + 16 <= b->last)
+			_mm_storeu_si128((__m128i *)of, r0);
+		else
+		{
+			uint8_t tmp[16];
+			_mm_storeu_si128((__m128i *)tmp, r0);
+			memcpy(of, tmp, b->last - x);
+		}
+		of += 14;
+	}
+	_mm_empty();
+}
+#endif
+
+static void temporal_filter_band_p (const band_t *b)
+{
+	uint32_t r, c, m;
+	int32_t d;
+	int x, k, n;
+	int idx = b->idx;
+	int w = b->w;
+	int t = b->t;
+
+	uint8_t *f4, *f[2 * MAX_RADIUS];
+	uint8_t *of = outframe[idx] + b->first;
+
+	n = temporal_planes (idx, b->first, &f4, f);
+
+	if (t == 0)			// shortcircuit filter if t = 0...
+	{
+		memcpy (of, f4, b->last - b->first);
+		return;
+	}
+
+	for (x = b->first; x < b->last; x++)
+	{
+		r  = *(f4-1-w);
+		r += *(f4  -w)*2;
+		r += *(f4+1-w);
+		r += *(f4-1  )*2;
+		r += *(f4    )*4;
+		r += *(f4+1  )*2;
+		r += *(f4-1+w);
+		r += *(f4  +w)*2;
+		r += *(f4+1+w);
+		r /= 16;
+
+		m = *(f4)*(t+1)*2;
+		c = t+1;
+
+		for (k = 0; k < n; k++)
+		{
+			uint8_t *p = f[k];
+
+			d  = *(p-1-w);
+			d += *(p  -w)*2;
+			d += *(p+1-w);
+			d += *(p-1  )*2;
+			d += *(p    )*4;
+			d += *(p+1  )*2;
+			d += *(p-1+w);
+			d += *(p  +w)*2;
+			d += *(p+1+w);
+			d /= 16;
+
+			d = t - abs (r-d);
+			d = d<0? 0:d;
+			c += d;
+			m += *(p)*d*2;
+
+			f[k]++;
+		}
+
+		*(of) = ((m/c)+1)/2;
+
+		f4++;
+		of++;
+	}
+}
+
+#if defined(__SSE2__)
+/* 4 to 5 times faster */
+static void filter_band_median1_sse2(const band_t *band) {
+	int i;
+	int w = band->w;
+	uint8_t * p;
+	uint8_t * d;
+	
+	p = band->src;
+	d = band->dst;
+
+	// remove strong outliers from the image. An outlier is a pixel which lies outside
+	// of max-thres and min+thres of the surrounding pixels. This should not cause blurring
+	// and it should leave an evenly spread noise-floor to the image.
+	for (i=band->first; i<band->last; i+=14) {
+		__m128i t, c, b, min, max, minmin, maxmax;
+		
+		t = _mm_loadu_si128((__m128i *)&p[i-1-w]);
+		c = _mm_loadu_si128((__m128i *)&p[i-1  ]);
+		b = _mm_loadu_si128((__m128i *)&p[i-1+w]);
+		min = _mm_min_epu8(t, b);      /* k: (0,k), (2,k) */
+		max = _mm_max_epu8(t, b);
+		minmin = _mm_min_epu8(min, c); /* k: (0,k), (1,k), (2,k) */
+		maxmax = _mm_max_epu8(max, c);
+		
+		/* k: (0,k), (1,k), (2,k). (0,k+2), (1,k+2), (2,k+2) */
+		minmin = _mm_min_epu8(minmin, _mm_srli_si128(minmin, 2));
+		maxmax = _mm_max_epu8(maxmax, _mm_srli_si128(maxmax, 2));
+		/* k: (0,k), (1,k), (2,k). (0,k+2), (1,k+2), (2,k+2), (0,k+1), (2,k+1) */
+		min = _mm_min_epu8(minmin, _mm_srli_si128(min, 1));
+		max = _mm_max_epu8(maxmax, _mm_srli_si128(max, 1));
+		
+		/* limit c to range [min,max] */
+		c = _mm_max_epu8(min, _mm_min_epu8(max, _mm_srli_si128(c, 1)));
+		/* write 14 valid pixels, the 2 remaining bytes are overwritten subsequently
+		 * or lie outside the frame area -- or belong to the next band */
+		if (band->final || i + 16 <= band->last)
+			_mm_storeu_si128((__m128i *)&d[i], c);
+		else
+		{
+			uint8_t tmp[16];
+			_mm_storeu_si128((__m128i *)tmp, c);
+			memcpy(&d[i], tmp, band->last - i);
+		}
+	}
+}
+
+static void filter_band_median2_sse2(const band_t *b) {
+	int i;
+	int w = b->w;
+	int level = b->t;
+	int avg; /*should not be needed any more */
+	int cnt; /* should not be needed any more */
+	uint8_t * p;
+	uint8_t * d;
+	
+	// in the second stage we try to average similar spatial pixels, only. This, like
+	// a median, should also not reduce sharpness but flatten the noisefloor. This
+	// part is quite similar to what 2dclean/yuvmedianfilter do. But because of the
+	// different weights given to the pixels it is less aggressive...
+
+	p = b->src + b->first;
+	d = b->dst + b->first;
+	
+	__m128i lvl = _mm_set1_epi16(level);
+	
+#ifndef OLD_ROUNDING
+	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
+#endif
+	
+	for (i=b->first; i<b->last; i+=4)
+	{
+		uint64_t k0, k1, k2, k3, k6;
+		__m128i c0, c1, v[4], t[4], e[4], a[4];
+		
+		/* p points to pixel a. There are 3 stages, each processing 8 surrounding
+		 * pixels, resulting in the complete neighbourhood of 24 pixels.
+		 *
+		 *     0 1 2 3 4 5 6 7
+		 * k0: x x x x x x x x
+		 * k1: x x x x x x x x
+		 * k6: x x a b c d x x
+		 * k2: x x x x x x x x
+		 * k3: x x x x x x x x
+		 *
+		 * a,b and c,d each share two 2x4-blocks in their surrounding area, which
+		 * are processed by stages 1 and 2. These blocks are referred to as c0 and
+		 * c1 by the code below. The remaining surrounding pixels are processed for
+		 * each pixel out of a,b,c,d individually in stage 3.
+		 * Stage 4 assembles the results, adds the weighted averages and weights
+		 * together for each pixel, computes the median and stores it in the
+		 * scratch plane.
+		 * Coordinates (y,x) originate from the top left of the above diagram. */
+		
+		k0 = *(uint64_t *)(p-w*2-2);
+		k1 = *(uint64_t *)(p-w*1-2);
+		k6 = *(uint64_t *)(p    -2);
+		k2 = *(uint64_t *)(p+w*1-2);
+		k3 = *(uint64_t *)(p+w*2-2);
+		
+		v[0] = _mm_set1_epi16((k6 >> 16) & 0xff); /* pixel a */
+		v[1] = _mm_set1_epi16((k6 >> 24) & 0xff); /* pixel b */
+		v[2] = _mm_set1_epi16((k6 >> 32) & 0xff); /* pixel c */
+		v[3] = _mm_set1_epi16((k6 >> 40) & 0xff); /* pixel d */
+		
+		// stage 1: c0 for a,b: (0,1) -> (1,4), c1 for c,d: (0,3) -> (1,6)
+		c0  = _mm_set_epi32((k0 >>  8) & 0xff00ff, (k0 >> 16) & 0xff00ff,
+												(k1 >>  8) & 0xff00ff, (k1 >> 16) & 0xff00ff);
+		c1  = _mm_set_epi32((k0 >> 24) & 0xff00ff, (k0 >> 32) & 0xff00ff,
+												(k1 >> 24) & 0xff00ff, (k1 >> 32) & 0xff00ff);
+		t[0] = _mm_sub_epi16(_mm_max_epu8(c0, v[0]), _mm_min_epu8(c0, v[0]));
+		t[1] = _mm_sub_epi16(_mm_max_epu8(c0, v[1]), _mm_min_epu8(c0, v[1]));
+		t[2] = _mm_sub_epi16(_mm_max_epu8(c1, v[2]), _mm_min_epu8(c1, v[2]));
+		t[3] = _mm_sub_epi16(_mm_max_epu8(c1, v[3]), _mm_min_epu8(c1, v[3]));
+		e[0] = _mm_subs_epu16(lvl, t[0]);
+		e[1] = _mm_subs_epu16(lvl, t[1]);
+		e[2] = _mm_subs_epu16(lvl, t[2]);
+		e[3] = _mm_subs_epu16(lvl, t[3]);
+		a[0] = _mm_madd_epi16(e[0], c0);
+		a[1] = _mm_madd_epi16(e[1], c0);
+		a[2] = _mm_madd_epi16(e[2], c1);
+		a[3] = _mm_madd_epi16(e[3], c1);
+		
+		// stage 2: c0 for a,b: (3,1) -> (4,4), c1 for c,d: (3,3) -> (4,6)
+		c0  = _mm_set_epi32((k2 >>  8) & 0xff00ff, (k2 >> 16) & 0xff00ff,
+												(k3 >>  8) & 0xff00ff, (k3 >> 16) & 0xff00ff);
+		c1  = _mm_set_epi32((k2 >> 24) & 0xff00ff, (k2 >> 32) & 0xff00ff,
+												(k3 >> 24) & 0xff00ff, (k3 >> 32) & 0xff00ff);
+		t[0] = _mm_sub_epi16(_mm_max_epu8(c0, v[0]), _mm_min_epu8(c0, v[0]));
+		t[1] = _mm_sub_epi16(_mm_max_epu8(c0, v[1]), _mm_min_epu8(c0, v[1]));
+		t[2] = _mm_sub_epi16(_mm_max_epu8(c1, v[2]), _mm_min_epu8(c1, v[2]));
+		t[3] = _mm_sub_epi16(_mm_max_epu8(c1, v[3]), _mm_min_epu8(c1, v[3]));
+		t[0] = _mm_subs_epu16(lvl, t[0]);
+		t[1] = _mm_subs_epu16(lvl, t[1]);
+		t[2] = _mm_subs_epu16(lvl, t[2]);
+		t[3] = _mm_subs_epu16(lvl, t[3]);
+		e[0] = _mm_add_epi16(t[0], e[0]);
+		e[1] = _mm_add_epi16(t[1], e[1]);
+		e[2] = _mm_add_epi16(t[2], e[2]);
+		e[3] = _mm_add_epi16(t[3], e[3]);
+		a[0] = _mm_add_epi32(_mm_madd_epi16(t[0], c0), a[0]);
+		a[1] = _mm_add_epi32(_mm_madd_epi16(t[1], c0), a[1]);
+		a[2] = _mm_add_epi32(_mm_madd_epi16(t[2], c1), a[2]);
+		a[3] = _mm_add_epi32(_mm_madd_epi16(t[3], c1), a[3]);
+		
+		// stage 3:
+		// pixel a: (0,0) -> (4,0), (2,1), (2,3), (2,4)
+		c0 = _mm_set_epi32(((k0 & 0xff) << 16) | (k1 & 0xff),
+		                   ((k2 & 0xff) << 16) | (k3 & 0xff),
+		                   (k6 >> 8) & 0xff00ff,
+		                   (k6 & 0xff) | ((k6 >> 16) & 0xff0000));
+		t[0] = _mm_sub_epi16(_mm_max_epu8(c0, v[0]), _mm_min_epu8(c0, v[0]));
+		t[0] = _mm_subs_epu16(lvl, t[0]);
+		e[0] = _mm_add_epi16(t[0], e[0]);
+		a[0] = _mm_add_epi32(_mm_madd_epi16(t[0], c0), a[0]);
+		
+		// pixel c: (0,2) -> (4,2), (2,3), (2,5), (2,6)
+		c1 = _mm_set_epi32((k0 & 0xff0000) | ((k1 >> 16) & 0xff),
+		                   (k2 & 0xff0000) | ((k3 >> 16) & 0xff),
+		                   (k6 >> 24) & 0xff00ff,
+		                   ((k6 >> 16) & 0xff) | ((k6 >> 32) & 0xff0000));
+		t[2] = _mm_sub_epi16(_mm_max_epu8(c1, v[2]), _mm_min_epu8(c1, v[2]));
+		t[2] = _mm_subs_epu16(lvl, t[2]);
+		e[2] = _mm_add_epi16(t[2], e[2]);
+		a[2] = _mm_add_epi32(_mm_madd_epi16(t[2], c1), a[2]);
+		
+		// pixel b: (0,5) -> (4,5), (2,1), (2,2), (2,4), (2,5)
+		c0 = _mm_set_epi32(((k0 >> 24) & 0xff0000) | ((k1 >> 40) & 0xff),
+		                   ((k2 >> 24) & 0xff0000) | ((k3 >> 40) & 0xff),
+		                   (k6 >> 16) & 0xff00ff,
+		                   ((k6 >> 8) & 0xff) | ((k6 >> 24) & 0xff0000));
+		t[1] = _mm_sub_epi16(_mm_max_epu8(c0, v[1]), _mm_min_epu8(c0, v[1]));
+		t[1] = _mm_subs_epu16(lvl, t[1]);
+		e[1] = _mm_add_epi16(t[1], e[1]);
+		a[1] = _mm_add_epi32(_mm_madd_epi16(t[1], c0), a[1]);
+		
+		// pixel d: (0,7) -> (4,7), (2,3), (2,4), (2,6), (2,7)
+		c1 = _mm_set_epi32(((k0 >> 40) & 0xff0000) | (k1 >> 56),
+		                   ((k2 >> 40) & 0xff0000) | (k3 >> 56),
+		                   (k6 >> 32) & 0xff00ff,
+		                   ((k6 >> 24) & 0xff) | ((k6 >> 40) & 0xff0000));
+		t[3] = _mm_sub_epi16(_mm_max_epu8(c1, v[3]), _mm_min_epu8(c1, v[3]));
+		t[3] = _mm_subs_epu16(lvl, t[3]);
+		e[3] = _mm_add_epi16(t[3], e[3]);
+		a[3] = _mm_add_epi32(_mm_madd_epi16(t[3], c1), a[3]);
+		
+		/* add them all together (a loop j=0 to 4 slows things down with gcc 4.4.4) */
+		uint32_t tmp;
+		
+#if defined(__SSE3__)
+		int j;
+		__m128 f0, f1, f2, flvl;
+		__m128i zero, vv;
+		flvl = _mm_set1_ps((float)level);
+		zero = _mm_setzero_si128();
+		vv = _mm_set_epi32((k6 >> 40) & 0xff, (k6 >> 32) & 0xff, (k6 >> 24) & 0xff, (k6 >> 16) & 0xff);
+		
+		f0 = _mm_hadd_ps(_mm_cvtepi32_ps(a[0]), _mm_cvtepi32_ps(a[1]));
+		f1 = _mm_hadd_ps(_mm_cvtepi32_ps(a[2]), _mm_cvtepi32_ps(a[3]));
+		f0 = _mm_hadd_ps(f0, f1);
+		f0 = _mm_add_ps(f0, _mm_mul_ps(flvl, _mm_cvtepi32_ps(vv)));
+		
+# ifdef OLD_ROUNDING
+		/* avg *= 2 */
+		f0 = _mm_mul_ps(f0, _mm_set1_ps(2.0f));
+# endif
+		
+		for (j=0; j<4; j++)
+			e[j] = _mm_unpacklo_epi16(_mm_add_epi16(e[j], _mm_srli_si128(e[j], 8)), zero);
+		f1 = _mm_hadd_ps(_mm_cvtepi32_ps(e[0]), _mm_cvtepi32_ps(e[1]));
+		f2 = _mm_hadd_ps(_mm_cvtepi32_ps(e[2]), _mm_cvtepi32_ps(e[3]));
+		f1 = _mm_hadd_ps(f1, f2);
+		f1 = _mm_add_ps(f1, flvl);
+		
+		f0 = div_ps(f0, f1);
+# ifdef OLD_ROUNDING
+		/* r = (r+1) / 2 */
+		vv = _mm_cvttps_epi32(f0);
+		vv = _mm_srli_epi32(_mm_add_epi32(vv, _mm_set1_epi32(1)), 1);
+# else
+		vv = _mm_cvtps_epi32(f0);
+# endif
+		vv = _mm_packus_epi16(_mm_packs_epi32(vv, zero), zero);
+		tmp = _mm_cvtsi128_si32(vv);
+		
+#else
+		
+		// p[0]
+		e[0] = _mm_add_epi16(e[0], _mm_srli_si128(e[0], 8)); /* 8 words */
+		e[0] = _mm_add_epi16(e[0], _mm_srli_si128(e[0], 4));
+		e[0] = _mm_add_epi16(e[0], _mm_srli_si128(e[0], 2));
+		cnt = level + (_mm_cvtsi128_si32(e[0]) & 0xffff);
+		a[0] = _mm_add_epi32(a[0], _mm_srli_si128(a[0], 8)); /* 4 dwords */
+		a[0] = _mm_add_epi32(a[0], _mm_srli_si128(a[0], 4));
+		avg = p[0] * level * 2 + (_mm_cvtsi128_si32(a[0]) << 1);
+		tmp = ((avg/cnt) + 1) / 2;
+		
+		// p[1]
+		e[1] = _mm_add_epi16(e[1], _mm_srli_si128(e[1], 8)); /* 8 words */
+		e[1] = _mm_add_epi16(e[1], _mm_srli_si128(e[1], 4));
+		e[1] = _mm_add_epi16(e[1], _mm_srli_si128(e[1], 2));
+		cnt = level + (_mm_cvtsi128_si32(e[1]) & 0xffff);
+		a[1] = _mm_add_epi32(a[1], _mm_srli_si128(a[1], 8)); /* 4 dwords */
+		a[1] = _mm_add_epi32(a[1], _mm_srli_si128(a[1], 4));
+		avg = p[1] * level * 2 + (_mm_cvtsi128_si32(a[1]) << 1);
+		tmp |= (((avg/cnt) + 1) / 2) << 8;
+		
+		// p[2]
+		e[2] = _mm_add_epi16(e[2], _mm_srli_si128(e[2], 8)); /* 8 words */
+		e[2] = _mm_add_epi16(e[2], _mm_srli_si128(e[2], 4));
+		e[2] = _mm_add_epi16(e[2], _mm_srli_si128(e[2], 2));
+		cnt = level + (_mm_cvtsi128_si32(e[2]) & 0xffff);
+		a[2] = _mm_add_epi32(a[2], _mm_srli_si128(a[2], 8)); /* 4 dwords */
+		a[2] = _mm_add_epi32(a[2], _mm_srli_si128(a[2], 4));
+		avg = p[2] * level * 2 + (_mm_cvtsi128_si32(a[2]) << 1);
+		tmp |= (((avg/cnt) + 1) / 2) << 16;
+		
+		// p[3]
+		e[3] = _mm_add_epi16(e[3], _mm_srli_si128(e[3], 8)); /* 8 words */
+		e[3] = _mm_add_epi16(e[3], _mm_srli_si128(e[3], 4));
+		e[3] = _mm_add_epi16(e[3], _mm_srli_si128(e[3], 2));
+		cnt = level + (_mm_cvtsi128_si32(e[3]) & 0xffff);
+		a[3] = _mm_add_epi32(a[3], _mm_srli_si128(a[3], 8)); /* 4 dwords */
+		a[3] = _mm_add_epi32(a[3], _mm_srli_si128(a[3], 4));
+		avg = p[3] * level * 2 + (_mm_cvtsi128_si32(a[3]) << 1);
+		tmp |= (((avg/cnt) + 1) / 2) << 24;
+#endif
+		
+		*(uint32_t *)d = tmp;
+		
+		d += 4;
+		p += 4;
+	}
+	_mm_empty();
+}
+#endif
+
+static void filter_band_median1_p (const band_t *b)
+{
+	int i;
+	int w = b->w;
+	int min;
+	int max;
+	uint8_t * p;
+	uint8_t * d;
+
+	p = b->src + b->first;
+	d = b->dst + b->first;
+
+	// remove strong outliers from the image. An outlier is a pixel which lies outside
+	// of max-thres and min+thres of the surrounding pixels. This should not cause blurring
+	// and it should leave an evenly spread noise-floor to the image.
+	for(i=b->first;i<b->last;i++)
+	{
+	// reset min/max-filter
+	min=255;
+	max=0;
+	// check every remaining position arround the reference-pixel for being min/max...
+
+	min=(min>*(p-w-1))? *(p-w-1):min;
+	max=(max<*(p-w-1))? *(p-w-1):max;
+	min=(min>*(p-w+0))? *(p-w+0):min;
+	max=(max<*(p-w+0))? *(p-w+0):max;
+	min=(min>*(p-w+1))? *(p-w+1):min;
+	max=(max<*(p-w+1))? *(p-w+1):max;
+
+	min=(min>*(p  -1))? *(p  -1):min;
+	max=(max<*(p  -1))? *(p  -1):max;
+	min=(min>*(p  +1))? *(p  +1):min;
+	max=(max<*(p  +1))? *(p  +1):max;
+
+	min=(min>*(p+w-1))? *(p+w-1):min;
+	max=(max<*(p+w-1))? *(p+w-1):max;
+	min=(min>*(p+w+0))? *(p+w+0):min;
+	max=(max<*(p+w+0))? *(p+w+0):max;
+	min=(min>*(p+w+1))? *(p+w+1):min;
+	max=(max<*(p+w+1))? *(p+w+1):max;
+
+	if( *(p)<(min) )
+	{
+	*(d)=min;
+	}
+	else
+	if( *(p)>(max) )
+	{
+	*(d)=max;
+	}
+	else
+	{
+	*(d)=*(p);
+	}
+
+	d++;
+	p++;
+	}
+}
+
+static void filter_band_median2_p (const band_t *b)
+{
+	int i;
+	int w = b->w;
+	int level = b->t;
+	int avg;
+	int cnt;
+	int c;
+	int e;
+	uint8_t * p;
+	uint8_t * d;
+
+	// in the second stage we try to average similar spatial pixels, only. This, like
+	// a median, should also not reduce sharpness but flatten the noisefloor. This
+	// part is quite similar to what 2dclean/yuvmedianfilter do. But because of the
+	// different weights given to the pixels it is less aggressive...
+
+	p = b->src + b->first;
+	d = b->dst + b->first;
+
+	for(i=b->first;i<b->last;i++)
+	{
+		avg=*(p)*level*2;
+		cnt=level;
+
+		c = *(p-w*2-2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*2-1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*2+1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*2+2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*1-2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*1-1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*1+1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-w*1+2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p-1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*1-2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*1-1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*1+1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*1+2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*2-2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*2-1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*2+1);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		c = *(p+w*2+2);
+		e = abs(c-*(p));
+		e = ((level-e)<0)? 0:level-e;
+		avg += e*c*2;
+		cnt += e;
+
+		*(d)=(((avg/cnt)+1)/2);
+
+		d++;
+		p++;
+	}
+}
+
+/***********************************************************
+ * Deep-sample kernels                                     *
+ ***********************************************************/
+
+/* The filters above for samples of more than 8 bits, two bytes each (in
+ * host order here: see swap_planes()).  The thresholds stay on the 8-bit
+ * scale of the options and are scaled to the samples, so a stream gives
+ * about the same picture at any depth; the weighted sums need 64 bits.
+ * There are no SIMD versions of these yet.
+ */
+
+static void
+gauss_filter_band_deep (const band_t * b)
+{
+  int i, v;
+  int w = b->w;
+  int t = b->t;
+  const uint16_t *src = (const uint16_t *) b->src + b->first;
+  uint16_t *dst = (uint16_t *) b->dst + b->first;
+
+  for (i = b->first; i < b->last; i++, src++, dst++)
+    {
+      v = src[-2] + src[-w - 1] + src[-1] * 2 + src[w - 1]
+	+ src[-w * 2] + src[-w] * 2 + src[0] * 4 + src[w] * 2 + src[w * 2]
+	+ src[-w + 1] + src[1] * 2 + src[w + 1] + src[2];
+      v /= 20;
+      *dst = (src[0] * (256 - t) + v * t) / 256;
+    }
+}
+
+/* SAD of the 16x16 blocks at blk1 and blk2, lines w apart */
+static uint32_t
+block_sad_deep (const uint16_t * blk1, const uint16_t * blk2, int w)
+{
+  uint32_t sad = 0;
+  int x, y;
+
+  for (y = 0; y < 16; y++, blk1 += w, blk2 += w)
+    for (x = 0; x < 16; x++)
+      sad += abs (blk1[x] - blk2[x]);
+  return sad;
+}
+
+/* 3x3 gauss around p, as the temporal filters weigh their pixels */
+static inline uint32_t
+gauss3_deep (const uint16_t * p, int w)
+{
+  return (p[-1 - w] + p[-w] * 2 + p[1 - w]
+	  + p[-1] * 2 + p[0] * 4 + p[1] * 2
+	  + p[-1 + w] + p[w] * 2 + p[1 + w]) / 16;
+}
+
+static void
+temporal_filter_band_MC_deep (const band_t * b)
+{
+  int idx = b->idx;
+  int w = b->w;
+  int h = b->final ? b->h : b->last / w;
+  int t = b->t << shift;
+  uint32_t sad, min, r, c;
+  uint64_t m;
+  int32_t d;
+  int x, y, sx, sy, k, n, px, py;
+  int vx[2 * MAX_RADIUS], vy[2 * MAX_RADIUS];
+  uint8_t *f4b, *fb[2 * MAX_RADIUS];
+  uint16_t *f4, *f[2 * MAX_RADIUS];
+  uint16_t *of = (uint16_t *) outframe[idx];
+
+  n = temporal_planes (idx, 0, &f4b, fb);
+  f4 = (uint16_t *) f4b;
+  for (k = 0; k < n; k++)
+    f[k] = (uint16_t *) fb[k];
+
+  if (t == 0)
+    {
+      memcpy (of + b->first, f4 + b->first,
+	      (b->last - b->first) * sizeof *of);
+      return;
+    }
+
+  for (y = b->first / w; y < h; y += 16)
+    for (x = 0; x < w; x += 16)
+      {
+	for (k = 0; k < n; k++)
+	  {
+	    px = k < 2 ? 0 : vx[k - 2];
+	    py = k < 2 ? 0 : vy[k - 2];
+	    min = block_sad_deep (f4 + x + y * w, f[k] + x + y * w, w);
+	    vx[k] = vy[k] = 0;
+	    for (sy = py - 4; sy < py + 4; sy++)
+	      for (sx = px - 4; sx < px + 4; sx++)
+		{
+		  sad = block_sad_deep (f4 + x + y * w,
+					f[k] + (x + sx) + (y + sy) * w, w);
+		  sad += block_sad_deep (f4 + (x + 8) + y * w,
+					 f[k] + (x + sx + 8) + (y + sy) * w, w);
+		  if (sad < min)
+		    {
+		      vx[k] = sx;
+		      vy[k] = sy;
+		      min = sad;
+		    }
+		}
+	  }
+
+	for (sy = 0; sy < 16; sy++)
+	  for (sx = 0; sx < 16; sx++)
+	    {
+	      const uint16_t *p0 = f4 + (x + sx) + (y + sy) * w;
+
+	      r = gauss3_deep (p0, w);
+	      m = (uint64_t) * p0 * t;
+	      c = t;
+	      for (k = 0; k < n; k++)
+		{
+		  const uint16_t *p = f[k] + (x + sx + vx[k]) + (y + sy + vy[k]) * w;
+
+		  d = t - abs ((int32_t) r - (int32_t) gauss3_deep (p, w));
+		  d = d < 0 ? 0 : d;
+		  c += d;
+		  m += (uint64_t) * p * d;
+		}
+	      if (b->final || (x + sx) + (y + sy) * w < b->last)
+		of[(x + sx) + (y + sy) * w] = m / c;
+	    }
+      }
+}
+
+static void
+temporal_filter_band_deep (const band_t * b)
+{
+  uint32_t r, c;
+  uint64_t m;
+  int32_t d;
+  int x, k, n;
+  int idx = b->idx;
+  int w = b->w;
+  int t = b->t << shift;
+  uint8_t *f4b, *fb[2 * MAX_RADIUS];
+  const uint16_t *f4, *f[2 * MAX_RADIUS];
+  uint16_t *of = (uint16_t *) outframe[idx] + b->first;
+
+  n = temporal_planes (idx, b->first, &f4b, fb);
+  f4 = (const uint16_t *) f4b;
+  for (k = 0; k < n; k++)
+    f[k] = (const uint16_t *) fb[k];
+
+  if (t == 0)
+    {
+      memcpy (of, f4, (b->last - b->first) * sizeof *of);
+      return;
+    }
+
+  for (x = b->first; x < b->last; x++)
+    {
+      r = gauss3_deep (f4, w);
+      m = (uint64_t) * f4 * (t + 1) * 2;
+      c = t + 1;
+      for (k = 0; k < n; k++)
+	{
+	  d = t - abs ((int32_t) r - (int32_t) gauss3_deep (f[k], w));
+	  d = d < 0 ? 0 : d;
+	  c += d;
+	  m += (uint64_t) * f[k] * d * 2;
+	  f[k]++;
+	}
+      *of++ = ((m / c) + 1) / 2;
+      f4++;
+    }
+}
+
+static void
+filter_band_median1_deep (const band_t * b)
+{
+  static const int dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+  static const int dy[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+  int i, k, v, min, max;
+  int w = b->w;
+  const uint16_t *p = (const uint16_t *) b->src + b->first;
+  uint16_t *d = (uint16_t *) b->dst + b->first;
+
+  // the same outliers as filter_band_median1_p() removes
+  for (i = b->first; i < b->last; i++, p++, d++)
+    {
+      min = 65535;
+      max = 0;
+      for (k = 0; k < 8; k++)
+	{
+	  v = p[dx[k] + dy[k] * w];
+	  min = v < min ? v : min;
+	  max = v > max ? v : max;
+	}
+      *d = *p < min ? min : *p > max ? max : *p;
+    }
+}
+
+static void
+filter_band_median2_deep (const band_t * b)
+{
+  int i, x, y, c, e;
+  int w = b->w;
+  int level = b->t << shift;
+  int64_t avg;
+  int cnt;
+  const uint16_t *p = (const uint16_t *) b->src + b->first;
+  uint16_t *d = (uint16_t *) b->dst + b->first;
+
+  // the 5x5 weighted average of filter_band_median2_p()
+  for (i = b->first; i < b->last; i++, p++, d++)
+    {
+      avg = (int64_t) * p * level * 2;
+      cnt = level;
+      for (y = -2; y <= 2; y++)
+	for (x = -2; x <= 2; x++)
+	  {
+	    if (!x && !y)
+	      continue;
+	    c = p[x + y * w];
+	    e = level - abs (c - *p);
+	    e = e < 0 ? 0 : e;
+	    avg += (int64_t) e * c * 2;
+	    cnt += e;
+	  }
+      *d = ((avg / cnt) + 1) / 2;
+    }
+}
+
+#if defined(HAVE_AVX_KERNELS)
+
+/***********************************************************
+ * AVX2 and AVX-512BW kernels                              *
+ ***********************************************************/
+
+/* The temporal filter and the first median stage run 2 (AVX2) or 4
+ * (AVX-512BW) of the SSE2 kernels' blocks of 14 pixels side by side, one in
+ * each 128-bit lane, where every SSE2 operation has its lane-wise twin.
+ * Each lane writes 16 bytes, the last 2 of which the next lane overwrites,
+ * in the order the SSE2 kernel would.  What is left at the end of a band
+ * goes to the SSE2 kernel, so its last block writes what it always did.
+ */
+
+static inline AVX2_FN __m256i
+load2_avx2 (const uint8_t * p)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+	                               _mm_loadu_si128((const __m128i *)(p + 14)), 1);
+}
+
+static inline AVX2_FN void
+store2_avx2 (uint8_t * p, const __m256i v)
+{
+	_mm_storeu_si128((__m128i *)p, _mm256_castsi256_si128(v));
+	_mm_storeu_si128((__m128i *)(p + 14), _mm256_extracti128_si256(v, 1));
+}
+
+static inline AVX512_FN __m512i
+load4_avx512 (const uint8_t * p)
+{
+	__m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i *)p));
+	v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(p + 14)), 1);
+	v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(p + 28)), 2);
+	return _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(p + 42)), 3);
+}
+
+static inline AVX512_FN void
+store4_avx512 (uint8_t * p, const __m512i v)
+{
+	_mm_storeu_si128((__m128i *)p, _mm512_castsi512_si128(v));
+	_mm_storeu_si128((__m128i *)(p + 14), _mm512_extracti32x4_epi32(v, 1));
+	_mm_storeu_si128((__m128i *)(p + 28), _mm512_extracti32x4_epi32(v, 2));
+	_mm_storeu_si128((__m128i *)(p + 42), _mm512_extracti32x4_epi32(v, 3));
+}
+
+/* div_ps() */
+static inline AVX2_FN __m256
+div_ps_avx2 (const __m256 a, const __m256 b)
+{
+	__m256 r;
+	__asm__ ("vdivps %2, %1, %0" : "=x" (r) : "x" (a), "x" (b));
+	return r;
+}
+
+static inline AVX512_FN __m512
+div_ps_avx512 (const __m512 a, const __m512 b)
+{
+	__m512 r;
+	__asm__ ("vdivps %2, %1, %0" : "=v" (r) : "v" (a), "v" (b));
+	return r;
+}
+
+/* tf0() and tf1() */
+static inline AVX2_FN __m256i
+tf0_avx2 (const __m256i mask, const __m256i vt, const __m256i vc, const __m256i vb)
+{
+	__m256i k0, k1, k2, k3, d0;
+
+	k0 = _mm256_and_si256(_mm256_srli_si256(vt, 1), mask);
+	k1 = _mm256_and_si256(_mm256_srli_si256(vb, 1), mask);
+	k0 = _mm256_add_epi16(k0, k1);
+	k2 = _mm256_add_epi16(_mm256_and_si256(vt, mask), _mm256_and_si256(vb, mask));
+	k2 = _mm256_add_epi16(k2, _mm256_srli_si256(k2, 2));
+	k3 = _mm256_and_si256(vc, mask);
+	k3 = _mm256_add_epi16(k3, _mm256_srli_si256(k3, 2));
+	k1 = _mm256_and_si256(_mm256_srli_si256(vc, 1), mask);
+	d0 = _mm256_slli_epi16(k1, 1);
+	d0 = _mm256_add_epi16(d0, k0);
+	d0 = _mm256_add_epi16(d0, k3);
+	d0 = _mm256_slli_epi16(d0, 1);
+	d0 = _mm256_add_epi16(d0, k2);
+	return _mm256_srli_epi16(d0, 4);
+}
+
+static inline AVX2_FN __m256i
+tf1_avx2 (const __m256i mask, const __m256i vt, const __m256i vc, const __m256i vb)
+{
+	__m256i k0, k1, k2, k3, d1;
+
+	k0 = _mm256_srli_si256(_mm256_add_epi16(_mm256_and_si256(vt, mask), _mm256_and_si256(vb, mask)), 2);
+	k1 = _mm256_and_si256(_mm256_srli_si256(vt, 1), mask);
+	k2 = _mm256_and_si256(_mm256_srli_si256(vb, 1), mask);
+	k2 = _mm256_add_epi16(k1, k2);
+	k2 = _mm256_add_epi16(k2, _mm256_srli_si256(k2, 2));
+	k3 = _mm256_and_si256(_mm256_srli_si256(vc, 1), mask);
+	k3 = _mm256_add_epi16(k3, _mm256_srli_si256(k3, 2));
+	k1 = _mm256_and_si256(_mm256_srli_si256(vc, 2), mask);
+	d1 = _mm256_slli_epi16(k1, 1);
+	d1 = _mm256_add_epi16(d1, k0);
+	d1 = _mm256_add_epi16(d1, k3);
+	d1 = _mm256_slli_epi16(d1, 1);
+	d1 = _mm256_add_epi16(d1, k2);
+	return _mm256_srli_epi16(d1, 4);
+}
+
+static inline AVX512_FN __m512i
+tf0_avx512 (const __m512i mask, const __m512i vt, const __m512i vc, const __m512i vb)
+{
+	__m512i k0, k1, k2, k3, d0;
+
+	k0 = _mm512_and_si512(_mm512_bsrli_epi128(vt, 1), mask);
+	k1 = _mm512_and_si512(_mm512_bsrli_epi128(vb, 1), mask);
+	k0 = _mm512_add_epi16(k0, k1);
+	k2 = _mm512_add_epi16(_mm512_and_si512(vt, mask), _mm512_and_si512(vb, mask));
+	k2 = _mm512_add_epi16(k2, _mm512_bsrli_epi128(k2, 2));
+	k3 = _mm512_and_si512(vc, mask);
+	k3 = _mm512_add_epi16(k3, _mm512_bsrli_epi128(k3, 2));
+	k1 = _mm512_and_si512(_mm512_bsrli_epi128(vc, 1), mask);
+	d0 = _mm512_slli_epi16(k1, 1);
+	d0 = _mm512_add_epi16(d0, k0);
+	d0 = _mm512_add_epi16(d0, k3);
+	d0 = _mm512_slli_epi16(d0, 1);
+	d0 = _mm512_add_epi16(d0, k2);
+	return _mm512_srli_epi16(d0, 4);
+}
+
+static inline AVX512_FN __m512i
+tf1_avx512 (const __m512i mask, const __m512i vt, const __m512i vc, const __m512i vb)
+{
+	__m512i k0, k1, k2, k3, d1;
+
+	k0 = _mm512_bsrli_epi128(_mm512_add_epi16(_mm512_and_si512(vt, mask), _mm512_and_si512(vb, mask)), 2);
+	k1 = _mm512_and_si512(_mm512_bsrli_epi128(vt, 1), mask);
+	k2 = _mm512_and_si512(_mm512_bsrli_epi128(vb, 1), mask);
+	k2 = _mm512_add_epi16(k1, k2);
+	k2 = _mm512_add_epi16(k2, _mm512_bsrli_epi128(k2, 2));
+	k3 = _mm512_and_si512(_mm512_bsrli_epi128(vc, 1), mask);
+	k3 = _mm512_add_epi16(k3, _mm512_bsrli_epi128(k3, 2));
+	k1 = _mm512_and_si512(_mm512_bsrli_epi128(vc, 2), mask);
+	d1 = _mm512_slli_epi16(k1, 1);
+	d1 = _mm512_add_epi16(d1, k0);
+	d1 = _mm512_add_epi16(d1, k3);
+	d1 = _mm512_slli_epi16(d1, 1);
+	d1 = _mm512_add_epi16(d1, k2);
+	return _mm512_srli_epi16(d1, 4);
+}
+
+static AVX2_FN void
+temporal_filter_band_avx2 (const band_t * b)
+{
+	band_t rest = *b;
+	int x, k;
+	int idx = b->idx;
+	int w = b->w;
+	int t = b->t;
+
+	int n;
+	uint8_t *f4, *f[2 * MAX_RADIUS];
+	uint8_t *of = outframe[idx] + b->first;
+
+	n = temporal_planes (idx, b->first, &f4, f);
+
+	if (t == 0)
+	{
+		memcpy (of, f4, b->last - b->first);
+		return;
+	}
+
+	__m256i vt, vc, vb;
+	__m256i c0, c1, m0, m1, m2, m3;
+	__m256i d0, d1, r0, r1;
+	__m256 g0, g1, g2, g3;
+	const __m256i mask = _mm256_set1_epi16(0x00ff);
+	const __m256i l0 = _mm256_set1_epi16(t);
+	const __m256i zero = _mm256_setzero_si256();
+
+	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
+
+	/* 28 pixels, and the 2 bytes written past them, within the band */
+	for (x = b->first; x + 30 <= b->last; x += 28)
+	{
+		vt = load2_avx2(f4 - 1 - w);
+		vc = load2_avx2(f4 - 1    );
+		vb = load2_avx2(f4 - 1 + w);
+		f4 += 28;
+
+		r0 = tf0_avx2(mask, vt, vc, vb);
+		r1 = tf1_avx2(mask, vt, vc, vb);
+
+		c0 = c1 = _mm256_set1_epi16(t + 1);
+
+		d0 = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_si256(vc, 1), mask), c0);
+		m0 = _mm256_unpacklo_epi16(d0, zero);
+		m1 = _mm256_unpackhi_epi16(d0, zero);
+		d1 = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_si256(vc, 2), mask), c0);
+		m2 = _mm256_unpacklo_epi16(d1, zero);
+		m3 = _mm256_unpackhi_epi16(d1, zero);
+
+		for (k=0; k<n; k++) {
+			vt = load2_avx2(f[k] - 1 - w);
+			vc = load2_avx2(f[k] - 1    );
+			vb = load2_avx2(f[k] - 1 + w);
+			f[k] += 28;
+
+			d0 = tf0_avx2(mask, vt, vc, vb);
+			d0 = _mm256_subs_epu16(l0, _mm256_sub_epi16(_mm256_max_epi16(r0, d0), _mm256_min_epi16(r0, d0)));
+			c0 = _mm256_add_epi16(c0, d0);
+			d0 = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_si256(vc, 1), mask), d0);
+			m0 = _mm256_add_epi32(m0, _mm256_unpacklo_epi16(d0, zero));
+			m1 = _mm256_add_epi32(m1, _mm256_unpackhi_epi16(d0, zero));
+
+			d1 = tf1_avx2(mask, vt, vc, vb);
+			d1 = _mm256_subs_epu16(l0, _mm256_sub_epi16(_mm256_max_epi16(r1, d1), _mm256_min_epi16(r1, d1)));
+			c1 = _mm256_add_epi16(c1, d1);
+			d1 = _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_si256(vc, 2), mask), d1);
+			m2 = _mm256_add_epi32(m2, _mm256_unpacklo_epi16(d1, zero));
+			m3 = _mm256_add_epi32(m3, _mm256_unpackhi_epi16(d1, zero));
+		}
+
+		g0 = div_ps_avx2(_mm256_cvtepi32_ps(m0), _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(c0, zero)));
+		g1 = div_ps_avx2(_mm256_cvtepi32_ps(m1), _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(c0, zero)));
+		g2 = div_ps_avx2(_mm256_cvtepi32_ps(m2), _mm256_cvtepi32_ps(_mm256_unpacklo_epi16(c1, zero)));
+		g3 = div_ps_avx2(_mm256_cvtepi32_ps(m3), _mm256_cvtepi32_ps(_mm256_unpackhi_epi16(c1, zero)));
+
+		r0 = _mm256_packs_epi32(_mm256_cvtps_epi32(g0), _mm256_cvtps_epi32(g1));
+		r1 = _mm256_packs_epi32(_mm256_cvtps_epi32(g2), _mm256_cvtps_epi32(g3));
+		r0 = _mm256_packus_epi16(_mm256_unpacklo_epi16(r0, r1), _mm256_unpackhi_epi16(r0, r1));
+		store2_avx2(of, r0);
+		of += 28;
+	}
+
+	rest.first = x;
+	temporal_filter_band_sse2(&rest);
+}
+
+static AVX512_FN void
+temporal_filter_band_avx512 (const band_t * b)
+{
+	band_t rest = *b;
+	int x, k;
+	int idx = b->idx;
+	int w = b->w;
+	int t = b->t;
+
+	int n;
+	uint8_t *f4, *f[2 * MAX_RADIUS];
+	uint8_t *of = outframe[idx] + b->first;
+
+	n = temporal_planes (idx, b->first, &f4, f);
+
+	if (t == 0)
+	{
+		memcpy (of, f4, b->last - b->first);
+		return;
+	}
+
+	__m512i vt, vc, vb;
+	__m512i c0, c1, m0, m1, m2, m3;
+	__m512i d0, d1, r0, r1;
+	__m512 g0, g1, g2, g3;
+	const __m512i mask = _mm512_set1_epi16(0x00ff);
+	const __m512i l0 = _mm512_set1_epi16(t);
+	const __m512i zero = _mm512_setzero_si512();
+
+	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
+
+	for (x = b->first; x + 58 <= b->last; x += 56)
+	{
+		vt = load4_avx512(f4 - 1 - w);
+		vc = load4_avx512(f4 - 1    );
+		vb = load4_avx512(f4 - 1 + w);
+		f4 += 56;
+
+		r0 = tf0_avx512(mask, vt, vc, vb);
+		r1 = tf1_avx512(mask, vt, vc, vb);
+
+		c0 = c1 = _mm512_set1_epi16(t + 1);
+
+		d0 = _mm512_mullo_epi16(_mm512_and_si512(_mm512_bsrli_epi128(vc, 1), mask), c0);
+		m0 = _mm512_unpacklo_epi16(d0, zero);
+		m1 = _mm512_unpackhi_epi16(d0, zero);
+		d1 = _mm512_mullo_epi16(_mm512_and_si512(_mm512_bsrli_epi128(vc, 2), mask), c0);
+		m2 = _mm512_unpacklo_epi16(d1, zero);
+		m3 = _mm512_unpackhi_epi16(d1, zero);
+
+		for (k=0; k<n; k++) {
+			vt = load4_avx512(f[k] - 1 - w);
+			vc = load4_avx512(f[k] - 1    );
+			vb = load4_avx512(f[k] - 1 + w);
+			f[k] += 56;
+
+			d0 = tf0_avx512(mask, vt, vc, vb);
+			d0 = _mm512_subs_epu16(l0, _mm512_sub_epi16(_mm512_max_epi16(r0, d0), _mm512_min_epi16(r0, d0)));
+			c0 = _mm512_add_epi16(c0, d0);
+			d0 = _mm512_mullo_epi16(_mm512_and_si512(_mm512_bsrli_epi128(vc, 1), mask), d0);
+			m0 = _mm512_add_epi32(m0, _mm512_unpacklo_epi16(d0, zero));
+			m1 = _mm512_add_epi32(m1, _mm512_unpackhi_epi16(d0, zero));
+
+			d1 = tf1_avx512(mask, vt, vc, vb);
+			d1 = _mm512_subs_epu16(l0, _mm512_sub_epi16(_mm512_max_epi16(r1, d1), _mm512_min_epi16(r1, d1)));
+			c1 = _mm512_add_epi16(c1, d1);
+			d1 = _mm512_mullo_epi16(_mm512_and_si512(_mm512_bsrli_epi128(vc, 2), mask), d1);
+			m2 = _mm512_add_epi32(m2, _mm512_unpacklo_epi16(d1, zero));
+			m3 = _mm512_add_epi32(m3, _mm512_unpackhi_epi16(d1, zero));
+		}
+
+		g0 = div_ps_avx512(_mm512_cvtepi32_ps(m0), _mm512_cvtepi32_ps(_mm512_unpacklo_epi16(c0, zero)));
+		g1 = div_ps_avx512(_mm512_cvtepi32_ps(m1), _mm512_cvtepi32_ps(_mm512_unpackhi_epi16(c0, zero)));
+		g2 = div_ps_avx512(_mm512_cvtepi32_ps(m2), _mm512_cvtepi32_ps(_mm512_unpacklo_epi16(c1, zero)));
+		g3 = div_ps_avx512(_mm512_cvtepi32_ps(m3), _mm512_cvtepi32_ps(_mm512_unpackhi_epi16(c1, zero)));
+
+		r0 = _mm512_packs_epi32(_mm512_cvtps_epi32(g0), _mm512_cvtps_epi32(g1));
+		r1 = _mm512_packs_epi32(_mm512_cvtps_epi32(g2), _mm512_cvtps_epi32(g3));
+		r0 = _mm512_packus_epi16(_mm512_unpacklo_epi16(r0, r1), _mm512_unpackhi_epi16(r0, r1));
+		store4_avx512(of, r0);
+		of += 56;
+	}
+
+	rest.first = x;
+	temporal_filter_band_sse2(&rest);
+}
+
+static AVX2_FN void
+filter_band_median1_avx2 (const band_t * band)
+{
+	band_t rest = *band;
+	int i;
+	int w = band->w;
+	uint8_t * p = band->src;
+	uint8_t * d = band->dst;
+
+	for (i=band->first; i + 30 <= band->last; i+=28) {
+		__m256i t, c, b, min, max, minmin, maxmax;
+
+		t = load2_avx2(&p[i-1-w]);
+		c = load2_avx2(&p[i-1  ]);
+		b = load2_avx2(&p[i-1+w]);
+		min = _mm256_min_epu8(t, b);
+		max = _mm256_max_epu8(t, b);
+		minmin = _mm256_min_epu8(min, c);
+		maxmax = _mm256_max_epu8(max, c);
+		minmin = _mm256_min_epu8(minmin, _mm256_srli_si256(minmin, 2));
+		maxmax = _mm256_max_epu8(maxmax, _mm256_srli_si256(maxmax, 2));
+		min = _mm256_min_epu8(minmin, _mm256_srli_si256(min, 1));
+		max = _mm256_max_epu8(maxmax, _mm256_srli_si256(max, 1));
+		c = _mm256_max_epu8(min, _mm256_min_epu8(max, _mm256_srli_si256(c, 1)));
+		store2_avx2(&d[i], c);
+	}
+
+	rest.first = i;
+	filter_band_median1_sse2(&rest);
+}
+
+static AVX512_FN void
+filter_band_median1_avx512 (const band_t * band)
+{
+	band_t rest = *band;
+	int i;
+	int w = band->w;
+	uint8_t * p = band->src;
+	uint8_t * d = band->dst;
+
+	for (i=band->first; i + 58 <= band->last; i+=56) {
+		__m512i t, c, b, min, max, minmin, maxmax;
+
+		t = load4_avx512(&p[i-1-w]);
+		c = load4_avx512(&p[i-1  ]);
+		b = load4_avx512(&p[i-1+w]);
+		min = _mm512_min_epu8(t, b);
+		max = _mm512_max_epu8(t, b);
+		minmin = _mm512_min_epu8(min, c);
+		maxmax = _mm512_max_epu8(max, c);
+		minmin = _mm512_min_epu8(minmin, _mm512_bsrli_epi128(minmin, 2));
+		maxmax = _mm512_max_epu8(maxmax, _mm512_bsrli_epi128(maxmax, 2));
+		min = _mm512_min_epu8(minmin, _mm512_bsrli_epi128(min, 1));
+		max = _mm512_max_epu8(maxmax, _mm512_bsrli_epi128(max, 1));
+		c = _mm512_max_epu8(min, _mm512_min_epu8(max, _mm512_bsrli_epi128(c, 1)));
+		store4_avx512(&d[i], c);
+	}
+
+	rest.first = i;
+	filter_band_median1_sse2(&rest);
+}
+
+/* The second median stage of the SSE2 kernel gathers the neighbourhood of
+ * 4 pixels into registers; these take 16 (AVX2) or 32 (AVX-512BW) pixels at
+ * a time and go through the 24 positions around them.  Either way the sums
+ * of weights and of weighted pixels are exact integers, and the result is
+ * rounded from them as the SSE2 kernel does: by the division in floating
+ * point with SSE3, and in integers without.
+ */
+static AVX2_FN void
+filter_band_median2_avx2 (const band_t * b)
+{
+	band_t rest = *b;
+	int i, dx, dy;
+	int w = b->w;
+	uint8_t * p = b->src;
+	uint8_t * d = b->dst;
+	const __m256i lvl = _mm256_set1_epi16(b->t);
+	const __m256i lvl32 = _mm256_set1_epi32(b->t);
+
+	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
+
+	for (i=b->first; i + 16 <= b->last; i+=16)
+	{
+		__m256i v, c, e, cnt, a[2], r[2];
+		int k;
+
+		v = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)&p[i]));
+		cnt = a[0] = a[1] = _mm256_setzero_si256();
+
+		for (dy=-2; dy<=2; dy++)
+		for (dx=-2; dx<=2; dx++)
+		{
+			if (dx == 0 && dy == 0)
+				continue;
+			c = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)&p[i+dy*w+dx]));
+			e = _mm256_subs_epu16(lvl, _mm256_abs_epi16(_mm256_sub_epi16(c, v)));
+			cnt = _mm256_add_epi16(cnt, e);
+			/* at most 255 * 255, so the low 16 bits are all of it */
+			e = _mm256_mullo_epi16(e, c);
+			a[0] = _mm256_add_epi32(a[0], _mm256_cvtepu16_epi32(_mm256_castsi256_si128(e)));
+			a[1] = _mm256_add_epi32(a[1], _mm256_cvtepu16_epi32(_mm256_extracti128_si256(e, 1)));
+		}
+
+		for (k=0; k<2; k++)
+		{
+			__m256i pix = _mm256_cvtepu16_epi32(k ? _mm256_extracti128_si256(v, 1) : _mm256_castsi256_si128(v));
+			__m256i num = _mm256_add_epi32(a[k], _mm256_mullo_epi32(pix, lvl32));
+			__m256i den = _mm256_add_epi32(lvl32, _mm256_cvtepu16_epi32(k ? _mm256_extracti128_si256(cnt, 1) : _mm256_castsi256_si128(cnt)));
+#if defined(__SSE3__)
+			r[k] = _mm256_cvtps_epi32(div_ps_avx2(_mm256_cvtepi32_ps(num), _mm256_cvtepi32_ps(den)));
+#else
+			/* ((2 * num / den) + 1) / 2; the quotient in floating point is
+			 * never too small, and at most one too big */
+			num = _mm256_slli_epi32(num, 1);
+			r[k] = _mm256_cvttps_epi32(div_ps_avx2(_mm256_cvtepi32_ps(num), _mm256_cvtepi32_ps(den)));
+			r[k] = _mm256_add_epi32(r[k], _mm256_cmpgt_epi32(_mm256_mullo_epi32(r[k], den), num));
+			r[k] = _mm256_srli_epi32(_mm256_add_epi32(r[k], _mm256_set1_epi32(1)), 1);
+#endif
+		}
+
+		/* the packs work within lanes: put pixels 4..7 back after 0..3 */
+		r[0] = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[0], r[1]), 0xd8);
+		_mm_storeu_si128((__m128i *)&d[i],
+		                 _mm_packus_epi16(_mm256_castsi256_si128(r[0]), _mm256_extracti128_si256(r[0], 1)));
+	}
+
+	rest.first = i;
+	filter_band_median2_sse2(&rest);
+}
+
+static AVX512_FN void
+filter_band_median2_avx512 (const band_t * b)
+{
+	band_t rest = *b;
+	int i, dx, dy;
+	int w = b->w;
+	uint8_t * p = b->src;
+	uint8_t * d = b->dst;
+	const __m512i lvl = _mm512_set1_epi16(b->t);
+	const __m512i lvl32 = _mm512_set1_epi32(b->t);
+
+	_MM_SET_ROUNDING_MODE(_MM_ROUND_NEAREST);
+
+	for (i=b->first; i + 32 <= b->last; i+=32)
+	{
+		__m512i v, c, e, cnt, a[2], r;
+		int k;
+
+		v = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *)&p[i]));
+		cnt = a[0] = a[1] = _mm512_setzero_si512();
+
+		for (dy=-2; dy<=2; dy++)
+		for (dx=-2; dx<=2; dx++)
+		{
+			if (dx == 0 && dy == 0)
+				continue;
+			c = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *)&p[i+dy*w+dx]));
+			e = _mm512_subs_epu16(lvl, _mm512_abs_epi16(_mm512_sub_epi16(c, v)));
+			cnt = _mm512_add_epi16(cnt, e);
+			e = _mm512_mullo_epi16(e, c);
+			a[0] = _mm512_add_epi32(a[0], _mm512_cvtepu16_epi32(_mm512_castsi512_si256(e)));
+			a[1] = _mm512_add_epi32(a[1], _mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(e, 1)));
+		}
+
+		for (k=0; k<2; k++)
+		{
+			__m512i pix = _mm512_cvtepu16_epi32(k ? _mm512_extracti64x4_epi64(v, 1) : _mm512_castsi512_si256(v));
+			__m512i num = _mm512_add_epi32(a[k], _mm512_mullo_epi32(pix, lvl32));
+			__m512i den = _mm512_add_epi32(lvl32, _mm512_cvtepu16_epi32(k ? _mm512_extracti64x4_epi64(cnt, 1) : _mm512_castsi512_si256(cnt)));
+#if defined(__SSE3__)
+			r = _mm512_cvtps_epi32(div_ps_avx512(_mm512_cvtepi32_ps(num), _mm512_cvtepi32_ps(den)));
+#else
+			num = _mm512_slli_epi32(num, 1);
+			r = _mm512_cvttps_epi32(div_ps_avx512(_mm512_cvtepi32_ps(num), _mm512_cvtepi32_ps(den)));
+			r = _mm512_mask_sub_epi32(r, _mm512_cmpgt_epi32_mask(_mm512_mullo_epi32(r, den), num), r, _mm512_set1_epi32(1));
+			r = _mm512_srli_epi32(_mm512_add_epi32(r, _mm512_set1_epi32(1)), 1);
+#endif
+			_mm_storeu_si128((__m128i *)&d[i+16*k], _mm512_cvtusepi32_epi8(r));
+		}
+	}
+
+	rest.first = i;
+	filter_band_median2_sse2(&rest);
+}
+
+/* block_sad_psad(), 2 or 4 lines at a time */
+static AVX2_FN uint32_t
+block_sad_avx2 (uint8_t * blk1, uint8_t * blk2, int w)
+{
+	__m256i s = _mm256_setzero_si256();
+	__m128i r;
+	int j;
+
+	for (j=0; j<16; j+=2)
+	{
+		__m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i *)blk1)),
+		                                    _mm_loadu_si128((__m128i *)(blk1 + w)), 1);
+		__m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((__m128i *)blk2)),
+		                                    _mm_loadu_si128((__m128i *)(blk2 + w)), 1);
+		s = _mm256_add_epi64(s, _mm256_sad_epu8(a, b));
+		blk1 += w*2;
+		blk2 += w*2;
+	}
+	r = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+	r = _mm_add_epi64(r, _mm_srli_si128(r, 8));
+	return _mm_cvtsi128_si32(r);
+}
+
+static AVX512_FN uint32_t
+block_sad_avx512 (uint8_t * blk1, uint8_t * blk2, int w)
+{
+	__m512i s = _mm512_setzero_si512();
+	__m256i h;
+	__m128i r;
+	int j;
+
+	for (j=0; j<16; j+=4)
+	{
+		__m512i a = _mm512_castsi128_si512(_mm_loadu_si128((__m128i *)blk1));
+		__m512i b = _mm512_castsi128_si512(_mm_loadu_si128((__m128i *)blk2));
+		a = _mm512_inserti32x4(a, _mm_loadu_si128((__m128i *)(blk1 + w)), 1);
+		b = _mm512_inserti32x4(b, _mm_loadu_si128((__m128i *)(blk2 + w)), 1);
+		a = _mm512_inserti32x4(a, _mm_loadu_si128((__m128i *)(blk1 + w*2)), 2);
+		b = _mm512_inserti32x4(b, _mm_loadu_si128((__m128i *)(blk2 + w*2)), 2);
+		a = _mm512_inserti32x4(a, _mm_loadu_si128((__m128i *)(blk1 + w*3)), 3);
+		b = _mm512_inserti32x4(b, _mm_loadu_si128((__m128i *)(blk2 + w*3)), 3);
+		s = _mm512_add_epi64(s, _mm512_sad_epu8(a, b));
+		blk1 += w*4;
+		blk2 += w*4;
+	}
+	h = _mm256_add_epi64(_mm512_castsi512_si256(s), _mm512_extracti64x4_epi64(s, 1));
+	r = _mm_add_epi64(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+	r = _mm_add_epi64(r, _mm_srli_si128(r, 8));
+	return _mm_cvtsi128_si32(r);
+}
+
+#endif /* HAVE_AVX_KERNELS */
+
+static void filter_planes_median ( uint8_t * plane[3], const int level[3])
+{
+	int i, w, h;
+	uint8_t * p;
+
+	for(i=0;i<3;i++)
+		if(level[i]!=0)
+		{
+			w = i ? cwidth : lwidth;
+			h = i ? cheight : lheight;
+			add_bands ( filter_band_median1, i, plane[i], scratchplane1[i], level[i], w*h+1, BAND_ALIGN );
+		}
+	run_bands ();
+
+	for(i=0;i<3;i++)
+		if(level[i]!=0)
+		{
+			w = i ? cwidth : lwidth;
+			h = i ? cheight : lheight;
+			p = scratchplane1[i];
+
+			// this filter needs values outside of the imageplane, so we just copy the first line 
+			// and the last line into the out-of-range area...
+
+			w *= sample_size;
+			memcpy ( p-w  , p, w );
+			memcpy ( p-w*2, p, w );
+
+			memcpy ( p+(w*h)  , p+(w*h)-w, w );
+			memcpy ( p+(w*h)+w, p+(w*h)-w, w );
+
+			add_bands ( filter_band_median2, i, p, scratchplane2[i], level[i], w/sample_size*h+1, BAND_ALIGN );
+		}
+	run_bands ();
+
+	for(i=0;i<3;i++)
+		if(level[i]!=0)
+			memcpy ( plane[i], scratchplane2[i], (i ? cwidth*cheight : lwidth*lheight) * sample_size );
+}
+
+static void temporal_filter_planes ( const int t[3] )
+{
+	int i, w, h;
+
+	for(i=0;i<3;i++)
+	{
+		w = i ? cwidth : lwidth;
+		h = i ? cheight : lheight;
+		if(hq_mode==1)
+			add_bands ( temporal_filter_band_hq, i, NULL, outframe[i], t[i], w*h, w*16 );
+		else
+			add_bands ( temporal_filter_band, i, NULL, outframe[i], t[i], w*h, BAND_ALIGN );
+	}
+	run_bands ();
+}
+
+/***********************************************************
+ * Setup and the frame interface (see yuvdenoise.h)        *
+ ***********************************************************/
+
+/* A plane buffer of buff_size bytes, cache aligned, returned at the plane
+ * after the border of buff_offset bytes.  The filters read a little around
+ * the planes, where nothing is ever written: it is zeroed, for the output
+ * not to depend on what was there. */
+static uint8_t *
+alloc_plane (void)
+{
+  uint8_t *buf = bufalloc (buff_size);
+
+  memset (buf, 0, buff_size);
+  return buf + buff_offset;
+}
+
+/* The kernels, from the plain C ones up; YUVDENOISE_SIMD picks a lower
+ * level than the processor allows, to compare them. */
+enum { SIMD_C, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512 };
+static const char *simd_names[] = { "c", "sse2", "avx2", "avx512" };
+
+static void init_accel() {
+	int32_t accel = cpu_accel ();
+	int avail = SIMD_C, level;
+	const char *env;
+
+	gauss_filter_band_fn = gauss_filter_band;
+	filter_band_median1 = filter_band_median1_p;
+	filter_band_median2 = filter_band_median2_p;
+	temporal_filter_band = temporal_filter_band_p;
+	temporal_filter_band_hq = temporal_filter_band_MC;
+	block_sad = block_sad_psad;
+
+	if (sample_size > 1) {
+		mjpeg_info("Deep samples: using the plain C filters");
+		gauss_filter_band_fn = gauss_filter_band_deep;
+		filter_band_median1 = filter_band_median1_deep;
+		filter_band_median2 = filter_band_median2_deep;
+		temporal_filter_band = temporal_filter_band_deep;
+		temporal_filter_band_hq = temporal_filter_band_MC_deep;
+		return;
+	}
+
+#if defined(__SSE2__)
+	if (accel & ACCEL_X86_SSE2)
+		avail = SIMD_SSE2;
+#endif
+#if defined(HAVE_AVX_KERNELS)
+	if (avail == SIMD_SSE2 && (accel & ACCEL_X86_AVX2))
+		avail = SIMD_AVX2;
+	if (avail == SIMD_AVX2 && (accel & ACCEL_X86_AVX512BW))
+		avail = SIMD_AVX512;
+#endif
+
+	level = avail;
+	if ((env = getenv ("YUVDENOISE_SIMD")) != NULL)
+	{
+		for (level = SIMD_AVX512; level >= SIMD_C; level--)
+			if (strcasecmp (env, simd_names[level]) == 0)
+				break;
+		if (level < SIMD_C)
+		{
+			mjpeg_warn ("Unknown YUVDENOISE_SIMD \"%s\", using %s", env, simd_names[avail]);
+			level = avail;
+		}
+		else if (level > avail)
+		{
+			mjpeg_warn ("YUVDENOISE_SIMD \"%s\" not available, using %s", env, simd_names[avail]);
+			level = avail;
+		}
+	}
+
+#if defined(__SSE2__)
+	if (level >= SIMD_SSE2) {
+		mjpeg_info("SETTING SSE2 for standard Temporal-Noise-Filter");
+		temporal_filter_band = temporal_filter_band_sse2;
+#if defined(__x86_64__)
+		mjpeg_info("SETTING SSE2 for Median-Filter");
+		filter_band_median1 = filter_band_median1_sse2;
+		filter_band_median2 = filter_band_median2_sse2;
+#endif
+	}
+#endif
+#if defined(HAVE_AVX_KERNELS)
+	if (level == SIMD_AVX2) {
+		mjpeg_info("SETTING AVX2 for Temporal-Noise-Filter, Median-Filter and block SAD");
+		temporal_filter_band = temporal_filter_band_avx2;
+		block_sad = block_sad_avx2;
+#if defined(__x86_64__)
+		filter_band_median1 = filter_band_median1_avx2;
+		filter_band_median2 = filter_band_median2_avx2;
+#endif
+	}
+	if (level == SIMD_AVX512) {
+		mjpeg_info("SETTING AVX-512BW for Temporal-Noise-Filter, Median-Filter and block SAD");
+		temporal_filter_band = temporal_filter_band_avx512;
+		block_sad = block_sad_avx512;
+#if defined(__x86_64__)
+		filter_band_median1 = filter_band_median1_avx512;
+		filter_band_median2 = filter_band_median2_avx512;
+#endif
+	}
+#endif
+}
+
+
+/* Set up the filters for a stream of the given size, chroma subsampling,
+ * interlacing and bits per sample.  Returns 0, or -1 if the stream can't
+ * be filtered.
+ */
+int
+yuvdenoise_init (const yuvdenoise_settings_t * s, int w, int h,
+		 int chroma, int interlaced, int bitdepth)
+{
+  int i, k;
+  char *msg = NULL;
+  y4m_ratio_t rx, ry;
+
+  settings = *s;
+  radius = settings.radius;
+  hq_mode = settings.hq_mode;
+  if (radius < 1 || radius > MAX_RADIUS)
+    {
+      mjpeg_error ("Temporal radius must be 1 ... %d", MAX_RADIUS);
+      return -1;
+    }
+
+  width = w;
+  height = h;
+  input_chroma_subsampling = chroma;
+  input_interlaced = interlaced;
+  sample_size = bitdepth > 8 ? 2 : 1;
+  shift = bitdepth - 8;
+
+  lwidth = width;
+  lheight = height;
+
+  // Setup the denoiser to use the appropriate chroma processing
+  if (input_chroma_subsampling == Y4M_CHROMA_420JPEG ||
+      input_chroma_subsampling == Y4M_CHROMA_420MPEG2 ||
+      input_chroma_subsampling == Y4M_CHROMA_420PALDV)
+    msg = "Processing Mode : 4:2:0";
+  else if (input_chroma_subsampling == Y4M_CHROMA_411)
+    msg = "Processing Mode : 4:1:1";
+  else if (input_chroma_subsampling == Y4M_CHROMA_422)
+    msg = "Processing Mode : 4:2:2";
+  else if (input_chroma_subsampling == Y4M_CHROMA_444)
+    msg = "Processing Mode : 4:4:4";
+  else
+    {
+      mjpeg_error (" ### Unsupported Y4M Chroma sampling ### ");
+      return -1;
+    }
+
+  rx = y4m_chroma_ss_x_ratio (input_chroma_subsampling);
+  ry = y4m_chroma_ss_y_ratio (input_chroma_subsampling);
+  cwidth = width / rx.d;
+  cheight = height / ry.d;
+
+  mjpeg_info("%s %s", msg,
+	     (input_interlaced ==
+	      Y4M_ILACE_NONE) ? "progressive" : "interlaced");
+  mjpeg_info("Luma-Plane      : %ix%i pixels", lwidth, lheight);
+  mjpeg_info("Chroma-Plane    : %ix%i pixels", cwidth, cheight);
+  if (bitdepth > 8)
+    mjpeg_info("Samples         : %i bits", bitdepth);
+
+  if (input_interlaced != Y4M_ILACE_NONE)
+    {
+      // process the fields as images side by side
+      lwidth *= 2;
+      cwidth *= 2;
+      lheight /= 2;
+      cheight /= 2;
+    }
+
+  /* now allocate the needed buffers */
+  {
+    /* calculate the memory offset needed to allow the processing
+     * functions to overshot. The biggest overshot is needed for the
+     * MC-functions: their search reaches 4 lines further with every frame
+     * of the radius, and their blocks 16 lines down from there, so we'll
+     * use that many lines, in whole cache lines...
+     */
+    buff_offset = (lwidth * (4 * radius + 18) * sample_size + 63) & ~63;
+    buff_size = buff_offset * 2 + lwidth * lheight * sample_size;
+    ring_slots = 2 * radius + 1;
+
+    for (k = 0; k < ring_slots; k++)
+      for (i = 0; i < 3; i++)
+	ring[k][i] = alloc_plane ();
+
+    for (i = 0; i < 3; i++)
+      {
+	outframe[i] = alloc_plane ();
+	/* one pair per plane, for the planes are filtered at the same time */
+	scratchplane1[i] = alloc_plane ();
+	scratchplane2[i] = alloc_plane ();
+      }
+
+    mjpeg_info("Buffers allocated.");
+  }
+
+  /* initialize motion_library */
+  init_motion_search ();
+
+  init_accel ();
+  start_threads (settings.threads);
+
+  frame_nr = 0;
+  frames_left = -1;
+  ring_pos = 0;
+  return 0;
+}
+
+/* The planes to put the next frame into. */
+uint8_t **
+yuvdenoise_input (void)
+{
+  return frame_at (0);
+}
+
+/* Deep samples are filtered in host order, but come and go least
+ * significant byte first. */
+static void
+swap_planes (uint8_t * planes[3])
+{
+#ifdef WORDS_BIGENDIAN
+  int i, k, n;
+  uint16_t *p;
+
+  if (sample_size == 1)
+    return;
+  for (i = 0; i < 3; i++)
+    {
+      n = i ? cwidth * cheight : lwidth * lheight;
+      for (p = (uint16_t *) planes[i], k = 0; k < n; k++)
+	p[k] = (uint16_t) ((p[k] >> 8) | (p[k] << 8));
+    }
+#endif
+}
+
+/* Filter the frame put into yuvdenoise_input().  Returns the planes of the
+ * filtered frame 'radius' frames back, or NULL while there is none yet.
+ * They stay valid until the next call.
+ */
+uint8_t **
+yuvdenoise_frame (void)
+{
+  frame_nr++;
+
+  swap_planes (frame_at (0));
+
+  gauss_filter_planes (frame_at (0), settings.gauss);
+
+  filter_planes_median (frame_at (0), settings.med_pre);
+
+  temporal_filter_planes (settings.temporal);
+
+  filter_planes_median (outframe, settings.med_post);
+
+  renoise (outframe[0], lwidth, lheight, settings.renoise[0]);
+  renoise (outframe[1], cwidth, cheight, settings.renoise[1]);
+  renoise (outframe[2], cwidth, cheight, settings.renoise[2]);
+
+  // move the ring on: the oldest frame's slot takes the next one
+  ring_pos = (ring_pos + ring_slots - 1) % ring_slots;
+
+  if (frame_nr <= radius)
+    return NULL;
+  swap_planes (outframe);
+  return outframe;
+}
+
+/* At the end of the stream: the planes of the next of the frames left,
+ * which never got to the middle, or NULL after the last one.
+ */
+uint8_t **
+yuvdenoise_flush (void)
+{
+  if (frames_left < 0)
+    frames_left = (frame_nr < radius ? frame_nr : radius);
+  if (frames_left == 0)
+    return NULL;
+  swap_planes (frame_at (frames_left));
+  return frame_at (frames_left--);
+}
+
+/* Stop the threads and free the buffers. */
+void
+yuvdenoise_fini (void)
+{
+  int i, k;
+
+  stop_threads ();
+
+  /* free allocated buffers */
+  for (k = 0; k < ring_slots; k++)
+    for (i = 0; i < 3; i++)
+      free (ring[k][i] - buff_offset);
+
+  for (i = 0; i < 3; i++)
+    {
+      free (outframe[i] - buff_offset);
+      free (scratchplane1[i] - buff_offset);
+      free (scratchplane2[i] - buff_offset);
+    }
+
+  mjpeg_info("Buffers freed.");
+}
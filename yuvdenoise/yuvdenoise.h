@@ -0,0 +1,57 @@
+/***********************************************************
+ * YUVDENOISER for the mjpegtools                          *
+ * ------------------------------------------------------- *
+ * (C) 2001-2004 Stefan Fendt                              *
+ *                                                         *
+ * Licensed and protected by the GNU-General-Public-       *
+ * License version 2 or if you prefer any later version of *
+ * that license). See the file LICENSE for detailed infor- *
+ * mation.                                                 *
+ *                                                         *
+ * FILE: yuvdenoise.h                                      *
+ *                                                         *
+ ***********************************************************/
+
+/* The filters of yuvdenoise, without the stream handling, so that other
+ * programs can run them on frames they have in memory:
+ *
+ *   yuvdenoise_init (&settings, width, height, chroma, interlaced, bitdepth);
+ *   for every frame:
+ *     put it into the planes yuvdenoise_input() returns
+ *     if ((out = yuvdenoise_frame ()) != NULL)  use out
+ *   while ((out = yuvdenoise_flush ()) != NULL)  use out
+ *   yuvdenoise_fini ();
+ *
+ * The output is delayed by 'radius' frames.  With a bitdepth above 8, the
+ * planes hold samples of two bytes, least significant first, and the
+ * thresholds are still given on the 8-bit scale.  There is one denoiser
+ * per process.
+ */
+
+#ifndef __YUVDENOISE_H__
+#define __YUVDENOISE_H__
+
+#include "mjpeg_types.h"
+
+#define YUVDENOISE_MAX_RADIUS 8
+
+typedef struct
+{
+  int gauss[3];			/* -g, for Y, U and V, 0 for off */
+  int med_pre[3];		/* -m */
+  int temporal[3];		/* -t */
+  int med_post[3];		/* -M */
+  int renoise[3];		/* -r */
+  int radius;			/* -T, 1 ... YUVDENOISE_MAX_RADIUS */
+  int hq_mode;			/* -q, motion-compensated temporal filter */
+  int threads;			/* 0: YUVDENOISE_THREADS or the processors */
+} yuvdenoise_settings_t;
+
+int yuvdenoise_init (const yuvdenoise_settings_t * s, int w, int h,
+		     int chroma, int interlaced, int bitdepth);
+uint8_t **yuvdenoise_input (void);
+uint8_t **yuvdenoise_frame (void);
+uint8_t **yuvdenoise_flush (void);
+void yuvdenoise_fini (void);
+
+#endif /* __YUVDENOISE_H__ */
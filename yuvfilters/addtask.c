@@ -27,6 +27,10 @@ YfAddNewTask(const YfTaskClass_t *filter,
   if (h0) {
     while (h0->handle_outgoing)
       h0 = h0->handle_outgoing;
+    if (y4m_si_get_bitdepth(&h0->si) > 8 && !(filter->flags & YF_DEEP)) {
+      WERROR("only 8-bit samples supported");
+      return NULL;
+    }
     h = (*filter->init)(argc, argv, h0);
     if (!h)
       return NULL;
@@ -0,0 +1,1036 @@
+/*
+ *  denoisebench.c:  Speed and quality benchmark of the denoisers.
+ *
+ *  Clean test sequences (a textured pan and textured objects moving
+ *  over a still background) are synthesised in memory, Gaussian noise
+ *  of several strengths is added to them, and each of the denoisers
+ *  (yuvdenoise, y4mdenoise, yuvmedianfilter, yuvycsnoise) is run on
+ *  the noisy frames through its library interface, without pipes.
+ *  For every denoiser, sequence, noise level, frame size and number of
+ *  threads, the frame rate and the PSNR and SSIM of the output against
+ *  the clean sequence are written as JSON, one result per line.
+ *
+ *  Given the output of an earlier run with -b, the results are
+ *  compared with it, and the exit status is 1 if any of them got
+ *  slower or worse, so that speed and quality regressions are caught
+ *  automatically.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License
+ *  as published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "yuv4mpeg.h"
+#include "newdenoise.hh"
+#include "yuvdenoise.h"
+#include "yuvfilters.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* The denoisers' configuration and y4mdenoise's input frame count,
+   which their libraries expect the program to define. */
+DNSR_GLOBAL denoiser;
+int frame = 0;
+int verbose = 0;
+
+DECLARE_YFTASKCLASS(yuvmedianfilter);
+DECLARE_YFTASKCLASS(yuvycsnoise);
+
+/**************************************************************
+ *
+ * Test sequences
+ *
+ **************************************************************/
+
+/* A 4:2:0 sequence, all frames in memory.  The frames are laid out
+   as the yuvfilters expect them, so that they can be handed to those
+   directly. */
+typedef struct
+{
+  int w, h, cw, ch;		/* luma and chroma plane sizes */
+  int nframes;
+  YfFrame_t **frames;
+} sequence_t;
+
+static const char *patterns[] = { "pan", "objects" };
+#define NPATTERNS ((int)(sizeof patterns / sizeof patterns[0]))
+
+/* Offsets that keep the texture coordinates positive. */
+#define ORIGIN 4096
+
+static uint8_t
+clip (double v)
+{
+  return v < 0.0 ? 0 : v > 255.0 ? 255 : (uint8_t) (v + 0.5);
+}
+
+/* The endless test picture at luma position (x, y): smooth shading,
+   fine gratings, and hard-edged checkered blocks, so that the
+   denoisers see flat areas, detail and edges.  Plane 0 is luma, 1 and
+   2 are chroma. */
+static uint8_t
+texture (int plane, int x, int y)
+{
+  double v;
+
+  x += ORIGIN;
+  y += ORIGIN;
+  if (plane == 0)
+    {
+      v = 110.0 + 45.0 * sin (x * 0.013) * cos (y * 0.017)
+	+ 20.0 * sin ((x + 2 * y) * 0.21);
+      if ((y >> 5) & 1)
+	v += 12.0 * sin (x * 0.9);
+      if (((x >> 6) + (y >> 6)) % 3 == 0)
+	v += (((x >> 3) ^ (y >> 3)) & 1) ? 35.0 : -35.0;
+    }
+  else
+    {
+      v = 128.0 + 30.0 * sin (x * 0.011 + plane) * cos (y * 0.015 - plane);
+      if (((x >> 7) + (y >> 6) + plane) % 4 == 0)
+	v += plane == 1 ? 25.0 : -25.0;
+    }
+  return clip (v);
+}
+
+static void
+frame_planes (const sequence_t *s, int n, uint8_t *p[3])
+{
+  p[0] = s->frames[n]->data;
+  p[1] = p[0] + s->w * s->h;
+  p[2] = p[1] + s->cw * s->ch;
+}
+
+static sequence_t *
+alloc_sequence (int w, int h, int nframes)
+{
+  sequence_t *s = malloc (sizeof *s);
+  int i;
+
+  s->w = w;
+  s->h = h;
+  s->cw = w / 2;
+  s->ch = h / 2;
+  s->nframes = nframes;
+  s->frames = malloc (nframes * sizeof s->frames[0]);
+  for (i = 0; i < nframes; i++)
+    {
+      s->frames[i] = malloc (FRAMEBYTES (Y4M_CHROMA_420JPEG, w, h));
+      y4m_init_frame_info (&s->frames[i]->fi);
+      memset (s->frames[i]->data, 0, DATABYTES (Y4M_CHROMA_420JPEG, w, h));
+    }
+  return s;
+}
+
+static void
+free_sequence (sequence_t *s)
+{
+  int i;
+
+  for (i = 0; i < s->nframes; i++)
+    {
+      y4m_fini_frame_info (&s->frames[i]->fi);
+      free (s->frames[i]);
+    }
+  free (s->frames);
+  free (s);
+}
+
+/* The moving objects of the "objects" pattern: size as a fraction of
+   the frame, start position and motion per frame. */
+static const struct
+{
+  int wdiv, hdiv, x, y, dx, dy;
+} objects[] = {
+  { 5, 4, 40, 30, 2, 1 },
+  { 7, 5, 300, 120, -3, 2 },
+  { 6, 6, 150, 200, 4, -1 },
+};
+#define NOBJECTS ((int)(sizeof objects / sizeof objects[0]))
+
+/* Synthesise a clean sequence. */
+static sequence_t *
+make_clean (int pattern, int w, int h, int nframes)
+{
+  sequence_t *s = alloc_sequence (w, h, nframes);
+  uint8_t *p[3];
+  int n, i, x, y, plane, sub, pw, ph;
+
+  for (n = 0; n < nframes; n++)
+    {
+      frame_planes (s, n, p);
+      for (plane = 0; plane < 3; plane++)
+	{
+	  sub = plane ? 2 : 1;
+	  pw = plane ? s->cw : w;
+	  ph = plane ? s->ch : h;
+
+	  /* A camera pan, or the still background. */
+	  for (y = 0; y < ph; y++)
+	    for (x = 0; x < pw; x++)
+	      p[plane][y * pw + x] = pattern == 0
+		? texture (plane, x * sub + 3 * n, y * sub + n)
+		: texture (plane, x * sub, y * sub);
+	  if (pattern == 0)
+	    continue;
+
+	  /* Objects that move on their own, entering on one side again
+	     once they have left on the other. */
+	  for (i = 0; i < NOBJECTS; i++)
+	    {
+	      int ow = w / objects[i].wdiv, oh = h / objects[i].hdiv;
+	      int ox = (objects[i].x + objects[i].dx * n) % (w + ow);
+	      int oy = (objects[i].y + objects[i].dy * n) % (h + oh);
+	      if (ox < 0)
+		ox += w + ow;
+	      if (oy < 0)
+		oy += h + oh;
+	      ox -= ow;
+	      oy -= oh;
+	      for (y = 0; y < oh / sub; y++)
+		for (x = 0; x < ow / sub; x++)
+		  {
+		    int px = ox / sub + x, py = oy / sub + y;
+		    if (px >= 0 && px < pw && py >= 0 && py < ph)
+		      p[plane][py * pw + px]
+			= texture (plane, x * sub + 1000 * (i + 1),
+				   y * sub + 700 * (i + 1));
+		  }
+	    }
+	}
+    }
+  return s;
+}
+
+/* A small, fast and repeatable random number generator (xorshift64*),
+   so that every run denoises the same noise. */
+static uint64_t rng_state;
+
+static double
+rng_uniform (void)
+{
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return ((rng_state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Add Gaussian noise of the given standard deviation to a copy of the
+   clean sequence, with the Box-Muller transform. */
+static sequence_t *
+make_noisy (const sequence_t *clean, double sigma, uint64_t seed)
+{
+  sequence_t *s = alloc_sequence (clean->w, clean->h, clean->nframes);
+  int n, i, bytes = DATABYTES (Y4M_CHROMA_420JPEG, clean->w, clean->h);
+  double u, v;
+
+  rng_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+  for (n = 0; n < s->nframes; n++)
+    {
+      const uint8_t *src = clean->frames[n]->data;
+      uint8_t *dst = s->frames[n]->data;
+      for (i = 0; i < bytes; i += 2)
+	{
+	  u = sqrt (-2.0 * log (1.0 - rng_uniform ())) * sigma;
+	  v = 2.0 * M_PI * rng_uniform ();
+	  dst[i] = clip (src[i] + u * cos (v));
+	  if (i + 1 < bytes)
+	    dst[i + 1] = clip (src[i + 1] + u * sin (v));
+	}
+    }
+  return s;
+}
+
+/**************************************************************
+ *
+ * Quality
+ *
+ **************************************************************/
+
+static double
+psnr (double sse, double samples)
+{
+  if (sse == 0.0)
+    return 99.0;
+  return 10.0 * log10 (255.0 * 255.0 * samples / sse);
+}
+
+/* PSNR of the luma and of all planes, over the whole sequence. */
+static void
+sequence_psnr (const sequence_t *a, const sequence_t *b,
+	       double *psnr_y, double *psnr_all)
+{
+  int n, i, d, ybytes = a->w * a->h;
+  int bytes = DATABYTES (Y4M_CHROMA_420JPEG, a->w, a->h);
+  double sse_y = 0.0, sse_c = 0.0;
+
+  for (n = 0; n < a->nframes; n++)
+    {
+      const uint8_t *pa = a->frames[n]->data, *pb = b->frames[n]->data;
+      for (i = 0; i < ybytes; i++)
+	{
+	  d = pa[i] - pb[i];
+	  sse_y += d * d;
+	}
+      for (; i < bytes; i++)
+	{
+	  d = pa[i] - pb[i];
+	  sse_c += d * d;
+	}
+    }
+  *psnr_y = psnr (sse_y, (double) a->w * a->h * a->nframes);
+  *psnr_all = psnr (sse_y + sse_c, (double) bytes * a->nframes);
+}
+
+/* Mean SSIM of the luma, over 8x8 windows every 4 pixels. */
+static double
+sequence_ssim (const sequence_t *a, const sequence_t *b)
+{
+  const double c1 = (0.01 * 255) * (0.01 * 255);
+  const double c2 = (0.03 * 255) * (0.03 * 255);
+  double total = 0.0;
+  long windows = 0;
+  int n, x, y, i, j;
+
+  for (n = 0; n < a->nframes; n++)
+    {
+      const uint8_t *pa = a->frames[n]->data, *pb = b->frames[n]->data;
+      for (y = 0; y + 8 <= a->h; y += 4)
+	for (x = 0; x + 8 <= a->w; x += 4)
+	  {
+	    int sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+	    double ma, mb, va, vb, cov;
+	    for (j = 0; j < 8; j++)
+	      for (i = 0; i < 8; i++)
+		{
+		  int va_ = pa[(y + j) * a->w + x + i];
+		  int vb_ = pb[(y + j) * a->w + x + i];
+		  sa += va_;
+		  sb += vb_;
+		  saa += va_ * va_;
+		  sbb += vb_ * vb_;
+		  sab += va_ * vb_;
+		}
+	    ma = sa / 64.0;
+	    mb = sb / 64.0;
+	    va = saa / 64.0 - ma * ma;
+	    vb = sbb / 64.0 - mb * mb;
+	    cov = sab / 64.0 - ma * mb;
+	    total += ((2.0 * ma * mb + c1) * (2.0 * cov + c2))
+	      / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+	    windows++;
+	  }
+    }
+  return windows ? total / windows : 1.0;
+}
+
+/**************************************************************
+ *
+ * The denoisers
+ *
+ * Each runs the noisy sequence through one denoiser with the given
+ * number of threads, stores the output frames and the time that took,
+ * and returns the number of frames output, or -1 on error.
+ *
+ **************************************************************/
+
+static double
+now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static int
+run_yuvdenoise_with (const sequence_t *in, sequence_t *out, int threads,
+		     int hq_mode, double *seconds)
+{
+  yuvdenoise_settings_t s;
+  uint8_t *p[3], **dst, **o;
+  int i, n = 0;
+  double t;
+
+  /* The settings yuvdenoise(1) recommends. */
+  memset (&s, 0, sizeof s);
+  s.temporal[0] = 4;
+  s.temporal[1] = s.temporal[2] = 8;
+  s.radius = 3;
+  s.hq_mode = hq_mode;
+  s.threads = threads;
+  if (yuvdenoise_init (&s, in->w, in->h, Y4M_CHROMA_420JPEG, Y4M_ILACE_NONE, 8))
+    return -1;
+
+  t = now ();
+  for (i = 0; i < in->nframes; i++)
+    {
+      frame_planes (in, i, p);
+      dst = yuvdenoise_input ();
+      memcpy (dst[0], p[0], in->w * in->h);
+      memcpy (dst[1], p[1], in->cw * in->ch);
+      memcpy (dst[2], p[2], in->cw * in->ch);
+      if ((o = yuvdenoise_frame ()) != NULL && n < out->nframes)
+	{
+	  frame_planes (out, n++, p);
+	  memcpy (p[0], o[0], in->w * in->h);
+	  memcpy (p[1], o[1], in->cw * in->ch);
+	  memcpy (p[2], o[2], in->cw * in->ch);
+	}
+    }
+  while ((o = yuvdenoise_flush ()) != NULL)
+    if (n < out->nframes)
+      {
+	frame_planes (out, n++, p);
+	memcpy (p[0], o[0], in->w * in->h);
+	memcpy (p[1], o[1], in->cw * in->ch);
+	memcpy (p[2], o[2], in->cw * in->ch);
+      }
+  *seconds = now () - t;
+
+  yuvdenoise_fini ();
+  return n;
+}
+
+static int
+run_yuvdenoise (const sequence_t *in, sequence_t *out, int threads,
+		double *seconds)
+{
+  return run_yuvdenoise_with (in, out, threads, 0, seconds);
+}
+
+static int
+run_yuvdenoise_mc (const sequence_t *in, sequence_t *out, int threads,
+		   double *seconds)
+{
+  return run_yuvdenoise_with (in, out, threads, 1, seconds);
+}
+
+static int
+run_y4mdenoise_with (const sequence_t *in, sequence_t *out, int threads,
+		     int fast, double *seconds)
+{
+  uint8_t *p[3], *o[3];
+  int i, n = 0, ret;
+  double t;
+
+  /* The defaults of y4mdenoise(1).  Reading and writing in their own
+     threads needs file descriptors, so only the color planes and the
+     bands are denoised in parallel. */
+  memset (&denoiser, 0, sizeof denoiser);
+  denoiser.frames = 10;
+  denoiser.radiusY = denoiser.radiusCbCr = 16;
+  denoiser.thresholdY = denoiser.thresholdCbCr = 3;
+  denoiser.matchCountThrottle = 16;
+  denoiser.matchSizeThrottle = 256;
+  denoiser.threads = threads > 1 ? 2 : 0;
+  denoiser.bands = threads;
+  denoiser.fast = fast;
+  denoiser.frame.w = in->w;
+  denoiser.frame.h = in->h;
+  denoiser.frame.Cw = in->cw;
+  denoiser.frame.Ch = in->ch;
+  denoiser.frame.ss_h = denoiser.frame.ss_v = 2;
+  if (newdenoise_init (denoiser.frames, in->w, in->h, in->cw, in->ch,
+		       -1, -1, NULL, NULL) != 0)
+    return -1;
+
+  frame = 0;
+  t = now ();
+  for (i = 0; n < out->nframes; i++)
+    {
+      frame++;
+      if (i < in->nframes)
+	frame_planes (in, i, p);
+      else
+	p[0] = p[1] = p[2] = NULL;
+      frame_planes (out, n, o);
+      ret = newdenoise_frame (p[0], p[1], p[2], o[0], o[1], o[2]);
+      if (ret < 0)
+	{
+	  newdenoise_shutdown ();
+	  return -1;
+	}
+      if (ret == 0)
+	n++;
+      else if (i >= in->nframes)
+	break;
+    }
+  *seconds = now () - t;
+
+  newdenoise_shutdown ();
+  return n;
+}
+
+static int
+run_y4mdenoise (const sequence_t *in, sequence_t *out, int threads,
+		double *seconds)
+{
+  return run_y4mdenoise_with (in, out, threads, 0, seconds);
+}
+
+static int
+run_y4mdenoise_fast (const sequence_t *in, sequence_t *out, int threads,
+		     double *seconds)
+{
+  return run_y4mdenoise_with (in, out, threads, 1, seconds);
+}
+
+/* The yuvfilters are run as a chain of tasks, between a reader that
+   hands out the noisy frames and a writer that stores the output.
+   Both are set up here rather than by their init(). */
+typedef struct
+{
+  YfTaskCore_t _;
+  const sequence_t *seq;
+} bench_reader_t;
+
+typedef struct
+{
+  YfTaskCore_t _;
+  sequence_t *seq;
+  int *count;
+} bench_writer_t;
+
+DEFINE_YFTASKCLASS (static, reader, bench_reader);
+DEFINE_YFTASKCLASS (static, writer, bench_writer);
+
+static const char *
+reader_usage (void)
+{
+  return "";
+}
+
+static YfTaskCore_t *
+reader_init (int argc, char **argv, const YfTaskCore_t *h0)
+{
+  return NULL;
+}
+
+static void
+reader_fini (YfTaskCore_t *handle)
+{
+  YfFreeTask (handle);
+}
+
+static int
+reader_frame (YfTaskCore_t *handle, const YfTaskCore_t *h0,
+	      const YfFrame_t *frame0)
+{
+  bench_reader_t *h = (bench_reader_t *) handle;
+  int i, ret;
+
+  for (i = 0; i < h->seq->nframes; i++)
+    if ((ret = YfPutFrame (handle, h->seq->frames[i])) != Y4M_OK)
+      return ret;
+  return Y4M_OK;
+}
+
+static const char *
+writer_usage (void)
+{
+  return "";
+}
+
+static YfTaskCore_t *
+writer_init (int argc, char **argv, const YfTaskCore_t *h0)
+{
+  return NULL;
+}
+
+static void
+writer_fini (YfTaskCore_t *handle)
+{
+  YfFreeTask (handle);
+}
+
+static int
+writer_frame (YfTaskCore_t *handle, const YfTaskCore_t *h0,
+	      const YfFrame_t *frame0)
+{
+  bench_writer_t *h = (bench_writer_t *) handle;
+
+  if (*h->count < h->seq->nframes)
+    memcpy (h->seq->frames[*h->count]->data, frame0->data,
+	    DATABYTES (Y4M_CHROMA_420JPEG, h->seq->w, h->seq->h));
+  ++*h->count;
+  return Y4M_OK;
+}
+
+static int
+run_yuvfilter (const YfTaskClass_t *filter, const char *name,
+	       const sequence_t *in, sequence_t *out, int threads,
+	       double *seconds)
+{
+  YfTaskCore_t *hreader, *hfilter, *h;
+  bench_reader_t *r;
+  bench_writer_t *w;
+  char argv0[64], *argv[2];
+  y4m_ratio_t ntsc = { 30000, 1001 };
+  int n = 0, ret;
+  double t;
+
+  if (!(hreader = YfAllocateTask (&bench_reader, sizeof *r, NULL)))
+    return -1;
+  r = (bench_reader_t *) hreader;
+  r->seq = in;
+  y4m_si_set_width (&hreader->si, in->w);
+  y4m_si_set_height (&hreader->si, in->h);
+  y4m_si_set_chroma (&hreader->si, Y4M_CHROMA_420JPEG);
+  y4m_si_set_interlace (&hreader->si, Y4M_ILACE_NONE);
+  y4m_si_set_framerate (&hreader->si, ntsc);
+  y4m_si_set_sampleaspect (&hreader->si, y4m_sar_SQUARE);
+  hreader->width = in->w;
+  hreader->height = in->h;
+  hreader->fpscode = 4;
+
+  /* The filter's default options; filters that split frames into bands
+     take the number of threads from the environment. */
+  snprintf (argv0, sizeof argv0, "%d", threads);
+  setenv ("YUVFILTERS_THREADS", argv0, 1);
+  snprintf (argv0, sizeof argv0, "%s", name);
+  argv[0] = argv0;
+  argv[1] = NULL;
+  optind = 1;
+  if (!(hfilter = YfAddNewTask (filter, 1, argv, hreader)))
+    {
+      YfFreeTask (hreader);
+      return -1;
+    }
+
+  if (!(h = YfAllocateTask (&bench_writer, sizeof *w, hfilter)))
+    {
+      (*hfilter->method->fini) (hfilter);
+      YfFreeTask (hreader);
+      return -1;
+    }
+  w = (bench_writer_t *) h;
+  w->seq = out;
+  w->count = &n;
+  hfilter->handle_outgoing = h;
+
+  t = now ();
+  ret = YfRunTasks (hreader, threads);
+  *seconds = now () - t;
+  if (ret != Y4M_OK)
+    {
+      mjpeg_error ("%s: %s", name, y4m_strerr (ret));
+      return -1;
+    }
+  return n < out->nframes ? n : out->nframes;
+}
+
+static int
+run_yuvmedianfilter (const sequence_t *in, sequence_t *out, int threads,
+		     double *seconds)
+{
+  return run_yuvfilter (&yuvmedianfilter, "yuvmedianfilter", in, out,
+			threads, seconds);
+}
+
+static int
+run_yuvycsnoise (const sequence_t *in, sequence_t *out, int threads,
+		 double *seconds)
+{
+  return run_yuvfilter (&yuvycsnoise, "yuvycsnoise", in, out,
+			threads, seconds);
+}
+
+static const struct
+{
+  const char *name;
+  int (*run) (const sequence_t *in, sequence_t *out, int threads,
+	      double *seconds);
+  int by_default;
+} denoisers[] = {
+  { "yuvdenoise", run_yuvdenoise, 1 },
+  { "yuvdenoise-mc", run_yuvdenoise_mc, 0 },
+  { "y4mdenoise", run_y4mdenoise, 1 },
+  { "y4mdenoise-fast", run_y4mdenoise_fast, 1 },
+  { "yuvmedianfilter", run_yuvmedianfilter, 1 },
+  { "yuvycsnoise", run_yuvycsnoise, 1 },
+};
+#define NDENOISERS ((int)(sizeof denoisers / sizeof denoisers[0]))
+
+/**************************************************************
+ *
+ * Results, and comparing them with an earlier run
+ *
+ **************************************************************/
+
+typedef struct
+{
+  char denoiser[32], pattern[32];
+  int sigma, width, height, threads;
+  double fps, psnr_y, psnr, ssim_y;
+} result_t;
+
+static int
+same_run (const result_t *a, const result_t *b)
+{
+  return !strcmp (a->denoiser, b->denoiser)
+    && !strcmp (a->pattern, b->pattern)
+    && a->sigma == b->sigma && a->width == b->width
+    && a->height == b->height && a->threads == b->threads;
+}
+
+static void
+print_result (FILE *fp, const result_t *r, int last)
+{
+  fprintf (fp, "    {\"denoiser\": \"%s\", \"pattern\": \"%s\", "
+	   "\"sigma\": %d, \"width\": %d, \"height\": %d, \"threads\": %d, "
+	   "\"fps\": %.2f, \"psnr_y\": %.3f, \"psnr\": %.3f, "
+	   "\"ssim_y\": %.5f}%s\n",
+	   r->denoiser, r->pattern, r->sigma, r->width, r->height,
+	   r->threads, r->fps, r->psnr_y, r->psnr, r->ssim_y,
+	   last ? "" : ",");
+}
+
+/* Find "key": in a line of our own output and return what follows. */
+static const char *
+json_field (const char *line, const char *key)
+{
+  char pattern[64];
+  const char *p;
+
+  snprintf (pattern, sizeof pattern, "\"%s\": ", key);
+  if ((p = strstr (line, pattern)) == NULL)
+    return NULL;
+  return p + strlen (pattern);
+}
+
+static int
+parse_result (const char *line, result_t *r)
+{
+  const char *p;
+
+  memset (r, 0, sizeof *r);
+  if ((p = json_field (line, "denoiser")) == NULL
+      || sscanf (p, "\"%31[^\"]\"", r->denoiser) != 1
+      || (p = json_field (line, "pattern")) == NULL
+      || sscanf (p, "\"%31[^\"]\"", r->pattern) != 1)
+    return 0;
+#define FIELD(NAME, FORMAT) \
+  if ((p = json_field (line, #NAME)) == NULL \
+      || sscanf (p, FORMAT, &r->NAME) != 1) \
+    return 0
+  FIELD (sigma, "%d");
+  FIELD (width, "%d");
+  FIELD (height, "%d");
+  FIELD (threads, "%d");
+  FIELD (fps, "%lf");
+  FIELD (psnr_y, "%lf");
+  FIELD (psnr, "%lf");
+  FIELD (ssim_y, "%lf");
+#undef FIELD
+  return 1;
+}
+
+/* Compare the results with those in the baseline file, report every
+   one that got slower or worse, and return how many did. */
+static int
+compare_baseline (const char *filename, const result_t *results, int nresults,
+		  double db_tolerance, double speed_tolerance)
+{
+  FILE *fp;
+  char line[1024];
+  result_t base;
+  int i, regressions = 0, compared = 0;
+
+  if ((fp = fopen (filename, "r")) == NULL)
+    {
+      mjpeg_error ("Can't open baseline %s", filename);
+      return -1;
+    }
+  while (fgets (line, sizeof line, fp) != NULL)
+    {
+      if (!parse_result (line, &base))
+	continue;
+      for (i = 0; i < nresults; i++)
+	if (same_run (&results[i], &base))
+	  break;
+      if (i == nresults)
+	continue;
+      compared++;
+
+#define REPORT(WHAT, FORMAT, NOW, WAS) \
+      mjpeg_warn ("%s %s sigma %d %dx%d %d thread(s): " WHAT " " FORMAT \
+		  ", was " FORMAT, base.denoiser, base.pattern, base.sigma, \
+		  base.width, base.height, base.threads, NOW, WAS)
+      if (results[i].psnr_y < base.psnr_y - db_tolerance)
+	{
+	  REPORT ("luma PSNR", "%.3f dB", results[i].psnr_y, base.psnr_y);
+	  regressions++;
+	}
+      else if (results[i].psnr < base.psnr - db_tolerance)
+	{
+	  REPORT ("PSNR", "%.3f dB", results[i].psnr, base.psnr);
+	  regressions++;
+	}
+      else if (results[i].ssim_y < base.ssim_y - db_tolerance / 100.0)
+	{
+	  REPORT ("luma SSIM", "%.5f", results[i].ssim_y, base.ssim_y);
+	  regressions++;
+	}
+      if (speed_tolerance > 0.0
+	  && results[i].fps < base.fps * (1.0 - speed_tolerance / 100.0))
+	{
+	  REPORT ("speed", "%.2f fps", results[i].fps, base.fps);
+	  regressions++;
+	}
+#undef REPORT
+    }
+  fclose (fp);
+  mjpeg_info ("Compared %d result(s) with %s, %d regression(s)",
+	      compared, filename, regressions);
+  return regressions;
+}
+
+/**************************************************************
+ *
+ * Main
+ *
+ **************************************************************/
+
+static void
+usage (char *prog)
+{
+  int i;
+
+  fprintf (stderr,
+	   "Usage: %s [options]\n"
+	   "  -n frames       frames per sequence (default 16)\n"
+	   "  -s WxH,...      frame sizes (default 352x240,720x480)\n"
+	   "  -j n,...        numbers of threads (default 1 and the processors)\n"
+	   "  -N sigma,...    noise levels (default 2,5,10)\n"
+	   "  -p pattern,...  test sequences:", prog);
+  for (i = 0; i < NPATTERNS; i++)
+    fprintf (stderr, " %s", patterns[i]);
+  fprintf (stderr, "\n"
+	   "  -d name,...     denoisers (default all but yuvdenoise-mc):");
+  for (i = 0; i < NDENOISERS; i++)
+    fprintf (stderr, " %s", denoisers[i].name);
+  fprintf (stderr, "\n"
+	   "  -r repeats      time each run this often, keep the best (default 1)\n"
+	   "  -o file         write the JSON there instead of to stdout\n"
+	   "  -b file         compare with the JSON of an earlier run\n"
+	   "  -t dB           PSNR tolerance for -b, a 100th of it for SSIM (default 0.05)\n"
+	   "  -S percent      speed tolerance for -b, 0 not to check (default 10)\n"
+	   "  -v level        verbosity [0..2] (default 1)\n");
+  exit (1);
+}
+
+/* Split a comma-separated list in place. */
+static int
+split_list (char *list, char **items, int max)
+{
+  int n = 0;
+  char *p;
+
+  for (p = strtok (list, ","); p != NULL && n < max; p = strtok (NULL, ","))
+    items[n++] = p;
+  return n;
+}
+
+#define MAX_LIST 16
+
+int
+main (int argc, char *argv[])
+{
+  char sizes_default[] = "352x240,720x480", sigmas_default[] = "2,5,10";
+  char *sizes_arg = sizes_default, *sigmas_arg = sigmas_default;
+  char *threads_arg = NULL, *patterns_arg = NULL, *denoisers_arg = NULL;
+  char *outfile = NULL, *basefile = NULL;
+  char *items[MAX_LIST];
+  int sizes[MAX_LIST][2], sigmas[MAX_LIST], threads[MAX_LIST];
+  int use_pattern[NPATTERNS], use_denoiser[NDENOISERS];
+  int nsizes, nsigmas, nthreads, nframes = 16, repeats = 1, verbosity = 1;
+  double db_tolerance = 0.05, speed_tolerance = 10.0;
+  result_t *results;
+  int nresults = 0, maxresults, failed = 0;
+  int i, j, c, si, pi, ni, di, ti, rep;
+  FILE *fp = stdout;
+
+  while ((c = getopt (argc, argv, "n:s:j:N:p:d:r:o:b:t:S:v:h")) != -1)
+    switch (c)
+      {
+      case 'n': nframes = atoi (optarg); break;
+      case 's': sizes_arg = optarg; break;
+      case 'j': threads_arg = optarg; break;
+      case 'N': sigmas_arg = optarg; break;
+      case 'p': patterns_arg = optarg; break;
+      case 'd': denoisers_arg = optarg; break;
+      case 'r': repeats = atoi (optarg); break;
+      case 'o': outfile = optarg; break;
+      case 'b': basefile = optarg; break;
+      case 't': db_tolerance = atof (optarg); break;
+      case 'S': speed_tolerance = atof (optarg); break;
+      case 'v': verbosity = atoi (optarg); break;
+      default: usage (argv[0]);
+      }
+  if (optind != argc || nframes < 1 || repeats < 1)
+    usage (argv[0]);
+  mjpeg_default_handler_verbosity (verbosity);
+
+  nsizes = split_list (sizes_arg, items, MAX_LIST);
+  for (i = 0; i < nsizes; i++)
+    if (sscanf (items[i], "%dx%d", &sizes[i][0], &sizes[i][1]) != 2
+	|| sizes[i][0] < 64 || sizes[i][1] < 64
+	|| (sizes[i][0] & 15) || (sizes[i][1] & 15))
+      mjpeg_error_exit1 ("Bad frame size %s: multiples of 16, at least 64",
+			 items[i]);
+
+  nsigmas = split_list (sigmas_arg, items, MAX_LIST);
+  for (i = 0; i < nsigmas; i++)
+    sigmas[i] = atoi (items[i]);
+
+  if (threads_arg != NULL)
+    {
+      nthreads = split_list (threads_arg, items, MAX_LIST);
+      for (i = 0; i < nthreads; i++)
+	if ((threads[i] = atoi (items[i])) < 1)
+	  usage (argv[0]);
+    }
+  else
+    {
+      threads[0] = 1;
+      threads[1] = sysconf (_SC_NPROCESSORS_ONLN);
+      nthreads = threads[1] > 1 ? 2 : 1;
+    }
+
+  for (i = 0; i < NPATTERNS; i++)
+    use_pattern[i] = patterns_arg == NULL;
+  if (patterns_arg != NULL)
+    for (j = split_list (patterns_arg, items, MAX_LIST); j-- > 0;)
+      {
+	for (i = 0; i < NPATTERNS && strcmp (items[j], patterns[i]); i++)
+	  ;
+	if (i == NPATTERNS)
+	  mjpeg_error_exit1 ("Unknown pattern %s", items[j]);
+	use_pattern[i] = 1;
+      }
+
+  for (i = 0; i < NDENOISERS; i++)
+    use_denoiser[i] = denoisers_arg == NULL && denoisers[i].by_default;
+  if (denoisers_arg != NULL)
+    for (j = split_list (denoisers_arg, items, MAX_LIST); j-- > 0;)
+      {
+	for (i = 0; i < NDENOISERS && strcmp (items[j], denoisers[i].name); i++)
+	  ;
+	if (i == NDENOISERS)
+	  mjpeg_error_exit1 ("Unknown denoiser %s", items[j]);
+	use_denoiser[i] = 1;
+      }
+
+  if (outfile != NULL && (fp = fopen (outfile, "w")) == NULL)
+    mjpeg_error_exit1 ("Can't create %s", outfile);
+
+  maxresults = nsizes * NPATTERNS * nsigmas * NDENOISERS * nthreads;
+  results = malloc (maxresults * sizeof results[0]);
+
+  for (si = 0; si < nsizes; si++)
+    for (pi = 0; pi < NPATTERNS; pi++)
+      {
+	sequence_t *clean, *noisy, *out;
+
+	if (!use_pattern[pi])
+	  continue;
+	clean = make_clean (pi, sizes[si][0], sizes[si][1], nframes);
+	out = alloc_sequence (clean->w, clean->h, nframes);
+	for (ni = 0; ni < nsigmas; ni++)
+	  {
+	    double in_psnr_y, in_psnr;
+
+	    noisy = make_noisy (clean, sigmas[ni], (si * NPATTERNS + pi)
+				* MAX_LIST + ni);
+	    sequence_psnr (clean, noisy, &in_psnr_y, &in_psnr);
+	    mjpeg_info ("%s %dx%d, sigma %d: noisy input has luma PSNR "
+			"%.2f dB, SSIM %.4f", patterns[pi], clean->w,
+			clean->h, sigmas[ni], in_psnr_y,
+			sequence_ssim (clean, noisy));
+
+	    for (di = 0; di < NDENOISERS; di++)
+	      for (ti = 0; ti < nthreads; ti++)
+		{
+		  result_t *r = &results[nresults];
+		  double seconds, best = 0.0;
+		  int frames = 0;
+
+		  if (!use_denoiser[di])
+		    continue;
+		  for (rep = 0; rep < repeats; rep++)
+		    {
+		      frames = (*denoisers[di].run) (noisy, out, threads[ti],
+						     &seconds);
+		      if (frames < 0)
+			break;
+		      if (rep == 0 || seconds < best)
+			best = seconds;
+		    }
+		  if (frames != nframes)
+		    {
+		      mjpeg_error ("%s returned %d of %d frames",
+				   denoisers[di].name, frames, nframes);
+		      failed = 1;
+		      continue;
+		    }
+
+		  memset (r, 0, sizeof *r);
+		  snprintf (r->denoiser, sizeof r->denoiser, "%s",
+			    denoisers[di].name);
+		  snprintf (r->pattern, sizeof r->pattern, "%s",
+			    patterns[pi]);
+		  r->sigma = sigmas[ni];
+		  r->width = clean->w;
+		  r->height = clean->h;
+		  r->threads = threads[ti];
+		  r->fps = best > 0.0 ? nframes / best : 0.0;
+		  sequence_psnr (clean, out, &r->psnr_y, &r->psnr);
+		  r->ssim_y = sequence_ssim (clean, out);
+		  mjpeg_info ("%-16s %d thread(s): %8.2f fps, luma PSNR "
+			      "%.2f dB, SSIM %.4f", r->denoiser, r->threads,
+			      r->fps, r->psnr_y, r->ssim_y);
+		  nresults++;
+		}
+	    free_sequence (noisy);
+	  }
+	free_sequence (out);
+	free_sequence (clean);
+      }
+
+  fprintf (fp, "{\n  \"benchmark\": \"denoisebench\",\n"
+	   "  \"version\": \"%s\",\n  \"frames\": %d,\n  \"repeats\": %d,\n"
+	   "  \"results\": [\n", VERSION, nframes, repeats);
+  for (i = 0; i < nresults; i++)
+    print_result (fp, &results[i], i == nresults - 1);
+  fprintf (fp, "  ]\n}\n");
+  if (fp != stdout)
+    fclose (fp);
+
+  if (basefile != NULL
+      && compare_baseline (basefile, results, nresults, db_tolerance,
+			   speed_tolerance) != 0)
+    failed = 1;
+  free (results);
+  return failed;
+}
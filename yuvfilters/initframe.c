@@ -26,7 +26,7 @@ YfFrame_t *
 YfInitFrame(YfFrame_t *frame, const YfTaskCore_t *h0)
 {
   if (!frame) {
-    if (!(frame = malloc(FRAMEBYTES(y4m_si_get_chroma(&h0->si), h0->width, h0->height)))) {
+    if (!(frame = malloc(SIFRAMEBYTES(&h0->si, h0->width, h0->height)))) {
       perror("malloc");
       return NULL;
     }
@@ -60,7 +60,7 @@ int
 main(int argc, char **argv)
 {
   YfTaskCore_t *h, *hreader;
-  int ret;
+  int ret, threads;
   char *p;
 
   if (1 < argc && (!strcmp(argv[1], "-?") ||
@@ -71,8 +71,12 @@ main(int argc, char **argv)
   }
   if ((p = getenv("MJPEG_VERBOSITY")))
     verbose = atoi(p);
+  if ((p = getenv("YUVFILTERS_THREADS")))
+    threads = atoi(p);
+  else
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
 
-   y4m_accept_extensions(1);
+   y4m_accept_extensions(2);
 
   ret = 1;
 #ifndef FILTER
@@ -87,11 +91,10 @@ main(int argc, char **argv)
   if (!YfAddNewTask(&WRITER, argc, argv, hreader))
     goto FINI;
 
-  ret = (*READER.frame)(hreader, NULL, NULL);
-  if (ret == Y4M_ERR_EOF)
-    ret = Y4M_OK;
+  ret = YfRunTasks(hreader, threads);
   if (ret != Y4M_OK)
     WERRORL(y4m_strerr(ret));
+  goto RETURN;
 
  FINI:
   for (h = hreader; h; h = hreader) {
@@ -22,6 +22,8 @@
 int
 YfPutFrame(const YfTaskCore_t *handle, const YfFrame_t *frame)
 {
+  if (handle->queue_outgoing)
+    return YfQueueFrame(handle->queue_outgoing, frame);
   return (*handle->handle_outgoing->method->frame)(handle->handle_outgoing,
 						   handle, frame);
 }
@@ -0,0 +1,342 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * Running a chain of tasks.
+ *
+ * With more than one thread, every task after the reader runs in a
+ * thread of its own, fed through a bounded queue: YfPutFrame() copies
+ * the frame into one from the queue's pool and returns as soon as
+ * there is room.  An error returned by the receiving task is returned
+ * by the YfPutFrame() calls after it.
+ *
+ * Stateless tasks (YF_STATELESS) get several threads, each handling
+ * whole frames.  The frames a thread puts while handling one frame are
+ * held back until those for all earlier frames have been queued, so
+ * the order of the output does not change.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "yuvfilters.h"
+
+#ifdef HAVE_PTHREAD
+
+#define QUEUEFRAMES 4
+
+typedef struct YfQueueItem_tag {
+  struct YfQueueItem_tag *next;
+  unsigned long seq;
+  YfFrame_t frame;		/* last: frame data follows */
+} YfQueueItem_t;
+
+typedef struct {
+  YfQueueItem_t *head, *tail;
+} YfItemList_t;
+
+typedef struct YfQueue_tag {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  const YfTaskCore_t *from;
+  YfTaskCore_t *to;
+  size_t itembytes;
+  YfItemList_t queued;
+  int nqueued, maxqueued;
+  YfQueueItem_t *pool;
+  unsigned long seq;		/* of the next frame taken from the queue */
+  unsigned long turn;		/* next frame whose output may be queued */
+  int eof, err;
+  int nthreads;
+  pthread_t threads[1];		/* ...nthreads */
+} YfQueue_t;
+
+/* frames held back by a thread of a stateless task */
+static pthread_key_t held_key;
+static pthread_once_t held_once = PTHREAD_ONCE_INIT;
+
+static void
+held_key_init(void)
+{
+  pthread_key_create(&held_key, NULL);
+}
+
+static void
+append(YfItemList_t *l, YfQueueItem_t *it)
+{
+  it->next = NULL;
+  if (l->tail)
+    l->tail->next = it;
+  else
+    l->head = it;
+  l->tail = it;
+}
+
+/* lock held */
+static YfQueueItem_t *
+getitem(YfQueue_t *q)
+{
+  YfQueueItem_t *it = q->pool;
+
+  if (it) {
+    q->pool = it->next;
+    return it;
+  }
+  if (!(it = malloc(q->itembytes))) {
+    perror("malloc");
+    return NULL;
+  }
+  YfInitFrame(&it->frame, q->from);
+  return it;
+}
+
+/* lock held */
+static void
+putitem(YfQueue_t *q, YfQueueItem_t *it)
+{
+  it->next = q->pool;
+  q->pool = it;
+}
+
+static int
+enqueue(YfQueue_t *q, YfQueueItem_t *it)
+{
+  int ret;
+
+  pthread_mutex_lock(&q->lock);
+  while (q->nqueued >= q->maxqueued && !q->err)
+    pthread_cond_wait(&q->changed, &q->lock);
+  if (!(ret = q->err)) {
+    append(&q->queued, it);
+    q->nqueued++;
+    pthread_cond_broadcast(&q->changed);
+  } else
+    putitem(q, it);
+  pthread_mutex_unlock(&q->lock);
+  return ret;
+}
+
+int
+YfQueueFrame(YfQueue_t *q, const YfFrame_t *frame)
+{
+  YfItemList_t *held;
+  YfQueueItem_t *it;
+  int ret;
+
+  pthread_mutex_lock(&q->lock);
+  ret = q->err;
+  it = ret? NULL: getitem(q);
+  pthread_mutex_unlock(&q->lock);
+  if (ret)
+    return ret;
+  if (!it)
+    return Y4M_ERR_SYSTEM;
+  y4m_copy_frame_info(&it->frame.fi, &frame->fi);
+  memcpy(it->frame.data, frame->data,
+	 SIDATABYTES(&q->from->si, q->from->width, q->from->height));
+  if ((held = pthread_getspecific(held_key))) {
+    append(held, it);
+    return Y4M_OK;
+  }
+  return enqueue(q, it);
+}
+
+/* queue the frames held back by a thread of a stateless task */
+static int
+putheld(YfQueue_t *q, YfItemList_t *held, int ret)
+{
+  YfQueueItem_t *it, *next;
+
+  for (it = held->head; it; it = next) {
+    next = it->next;
+    if (!ret)
+      ret = enqueue(q, it);
+    else {
+      pthread_mutex_lock(&q->lock);
+      putitem(q, it);
+      pthread_mutex_unlock(&q->lock);
+    }
+  }
+  held->head = held->tail = NULL;
+  return ret;
+}
+
+static void *
+runqueue(void *arg)
+{
+  YfQueue_t *q = arg;
+  YfQueueItem_t *it;
+  YfItemList_t held = { NULL, NULL };
+  int ordered = (q->nthreads > 1 && q->to->queue_outgoing);
+  int ret;
+
+  if (ordered)
+    pthread_setspecific(held_key, &held);
+  pthread_mutex_lock(&q->lock);
+  for (;;) {
+    while (!q->queued.head && !q->eof)
+      pthread_cond_wait(&q->changed, &q->lock);
+    if (!(it = q->queued.head))
+      break;
+    if (!(q->queued.head = it->next))
+      q->queued.tail = NULL;
+    q->nqueued--;
+    it->seq = q->seq++;
+    ret = q->err;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+
+    /* after an error the remaining frames are just dropped */
+    if (!ret)
+      ret = (*q->to->method->frame)(q->to, q->from, &it->frame);
+    if (ordered) {
+      pthread_mutex_lock(&q->lock);
+      while (q->turn != it->seq)
+	pthread_cond_wait(&q->changed, &q->lock);
+      pthread_mutex_unlock(&q->lock);
+      ret = putheld(q->to->queue_outgoing, &held, ret);
+    }
+
+    pthread_mutex_lock(&q->lock);
+    if (ordered)
+      q->turn++;
+    if (ret && !q->err)
+      q->err = ret;
+    putitem(q, it);
+    pthread_cond_broadcast(&q->changed);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return NULL;
+}
+
+/* queue from handle h to the task after it, run by its own thread(s) */
+static YfQueue_t *
+newqueue(YfTaskCore_t *h, int threads)
+{
+  YfQueue_t *q;
+  int i;
+
+  /* parallel frames need the task's output to be queued for ordering */
+  if (!(h->handle_outgoing->method->flags & YF_STATELESS) ||
+      (h->handle_outgoing->handle_outgoing &&
+       !h->handle_outgoing->queue_outgoing))
+    threads = 1;
+  if (!(q = malloc(sizeof *q + (threads - 1) * sizeof q->threads[0]))) {
+    perror("malloc");
+    return NULL;
+  }
+  memset(q, 0, sizeof *q);
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->changed, NULL);
+  q->from = h;
+  q->to = h->handle_outgoing;
+  q->itembytes = (offsetof(YfQueueItem_t, frame) +
+		  SIFRAMEBYTES(&h->si, h->width, h->height));
+  q->maxqueued = QUEUEFRAMES + threads;
+  /* set before any thread starts, tells them whether to hold frames */
+  q->nthreads = threads;
+  for (i = 0; i < threads; i++)
+    if (pthread_create(&q->threads[i], NULL, runqueue, q))
+      break;
+  if (i < threads) {
+    WERROR("cannot create filter thread");
+    pthread_mutex_lock(&q->lock);
+    q->eof = 1;
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    while (0 <= --i)
+      pthread_join(q->threads[i], NULL);
+    pthread_cond_destroy(&q->changed);
+    pthread_mutex_destroy(&q->lock);
+    free(q);
+    return NULL;
+  }
+  return q;
+}
+
+/* wait for the queued frames to be processed, returns the first error */
+static int
+closequeue(YfQueue_t *q)
+{
+  YfQueueItem_t *it;
+  int i, ret;
+
+  pthread_mutex_lock(&q->lock);
+  q->eof = 1;
+  pthread_cond_broadcast(&q->changed);
+  pthread_mutex_unlock(&q->lock);
+  for (i = 0; i < q->nthreads; i++)
+    pthread_join(q->threads[i], NULL);
+  ret = q->err;
+  while ((it = q->pool)) {
+    q->pool = it->next;
+    YfFiniFrame(&it->frame);
+    free(it);
+  }
+  pthread_cond_destroy(&q->changed);
+  pthread_mutex_destroy(&q->lock);
+  free(q);
+  return ret;
+}
+
+#endif /* HAVE_PTHREAD */
+
+int
+YfRunTasks(YfTaskCore_t *hreader, int threads)
+{
+  YfTaskCore_t *h, *hnext;
+  int ret;
+#ifdef HAVE_PTHREAD
+  YfQueue_t *q;
+  int err;
+
+  /* queues are set up from the writer end, so that a task's outgoing
+     queue is known before its own thread(s) start */
+  if (1 < threads) {
+    int n, i;
+    pthread_once(&held_once, held_key_init);
+    for (n = 0, h = hreader; h->handle_outgoing; h = h->handle_outgoing)
+      n++;
+    while (0 <= --n) {
+      for (i = 0, h = hreader; i < n; i++)
+	h = h->handle_outgoing;
+      h->queue_outgoing = newqueue(h, threads);
+    }
+  }
+#endif
+
+  ret = (*hreader->method->frame)(hreader, NULL, NULL);
+  if (ret == Y4M_ERR_EOF)
+    ret = Y4M_OK;
+
+  /* a task's fini may still put frames, to a task not yet finished */
+  for (h = hreader; h; h = hnext) {
+    hnext = h->handle_outgoing;
+#ifdef HAVE_PTHREAD
+    q = h->queue_outgoing;
+    (*h->method->fini)(h);
+    if (q && (err = closequeue(q)) && ret == Y4M_OK)
+      ret = err;
+#else
+    (*h->method->fini)(h);
+#endif
+  }
+  return ret;
+}
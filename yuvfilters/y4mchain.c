@@ -0,0 +1,158 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * y4mchain: run several filters in one process.
+ *
+ *   y4mchain FILTER [options] [: FILTER [options]]...
+ *
+ * is the same as
+ *
+ *   FILTER [options] | FILTER [options] | ...
+ *
+ * but frames are handed from one filter to the next in memory, without
+ * being written to and parsed from a pipe.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "yuvfilters.h"
+
+#define SEPARATOR ":"
+
+DECLARE_YFTASKCLASS(yuvstdin);
+DECLARE_YFTASKCLASS(yuvstdout);
+DECLARE_YFTASKCLASS(y4mdenoise);
+DECLARE_YFTASKCLASS(y4munsharp);
+DECLARE_YFTASKCLASS(yuvcorrect);
+DECLARE_YFTASKCLASS(yuvdeinterlace);
+DECLARE_YFTASKCLASS(yuvdenoise);
+DECLARE_YFTASKCLASS(yuvkineco);
+DECLARE_YFTASKCLASS(yuvmedianfilter);
+DECLARE_YFTASKCLASS(yuvscaler);
+DECLARE_YFTASKCLASS(yuvycsnoise);
+
+static const struct {
+  const char *name;
+  const YfTaskClass_t *filter;
+} filters[] = {
+  { "y4mdenoise",      &y4mdenoise, },
+  { "y4munsharp",      &y4munsharp, },
+  { "yuvcorrect",      &yuvcorrect, },
+  { "yuvdeinterlace",  &yuvdeinterlace, },
+  { "yuvdenoise",      &yuvdenoise, },
+  { "yuvkineco",       &yuvkineco, },
+  { "yuvmedianfilter", &yuvmedianfilter, },
+  { "yuvscaler",       &yuvscaler, },
+  { "yuvycsnoise",     &yuvycsnoise, },
+};
+#define NFILTERS ((int)(sizeof filters / sizeof filters[0]))
+
+int verbose = 1;
+
+static void
+usage(char **argv)
+{
+  char buf[1024];
+  int i;
+
+  sprintf(buf, "Usage: %s FILTER [options] [" SEPARATOR " FILTER [options]]...",
+	  argv[0]);
+  WERRORL(buf);
+  for (i = 0; i < NFILTERS; i++) {
+    snprintf(buf, sizeof buf, "%s %s",
+	     filters[i].name, (*filters[i].filter->usage)());
+    WERRORL(buf);
+  }
+}
+
+static const YfTaskClass_t *
+findfilter(const char *name)
+{
+  int i;
+
+  for (i = 0; i < NFILTERS; i++)
+    if (!strcmp(filters[i].name, name))
+      return filters[i].filter;
+  return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+  YfTaskCore_t *h, *hreader;
+  const YfTaskClass_t *filter;
+  int ret, threads, i, n;
+  char *p;
+
+  if (argc < 2 || !strcmp(argv[1], "-?") ||
+      !strcmp(argv[1], "-h") ||
+      !strcmp(argv[1], "--help")) {
+    usage(argv);
+    return argc < 2;
+  }
+  if ((p = getenv("MJPEG_VERBOSITY")))
+    verbose = atoi(p);
+  /* for the filters that log through mjpeg_*() */
+  mjpeg_default_handler_verbosity(verbose);
+  if ((p = getenv("YUVFILTERS_THREADS")))
+    threads = atoi(p);
+  else
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+  y4m_accept_extensions(2);
+
+  ret = 1;
+  if (!(hreader = YfAddNewTask(&yuvstdin, argc, argv, NULL)))
+    goto RETURN;
+  /* each filter gets its own part of the command line, starting with
+     its name */
+  for (i = 1; i < argc; i += n + 1) {
+    for (n = 0; i + n < argc && strcmp(argv[i + n], SEPARATOR); n++)
+      ;
+    if (!n || !(filter = findfilter(argv[i]))) {
+      char buf[1024];
+      snprintf(buf, sizeof buf, "unknown filter: %s", n? argv[i]: "");
+      WERRORL(buf);
+      goto FINI;
+    }
+    p = argv[i + n];
+    argv[i + n] = NULL;
+    optind = 1;
+    h = YfAddNewTask(filter, n, &argv[i], hreader);
+    argv[i + n] = p;
+    if (!h)
+      goto FINI;
+  }
+  if (!YfAddNewTask(&yuvstdout, argc, argv, hreader))
+    goto FINI;
+
+  ret = YfRunTasks(hreader, threads);
+  if (ret != Y4M_OK)
+    WERRORL(y4m_strerr(ret));
+  goto RETURN;
+
+ FINI:
+  for (h = hreader; h; h = hreader) {
+    hreader = h->handle_outgoing;
+    (*h->method->fini)(h);
+  }
+ RETURN:
+  return ret;
+}
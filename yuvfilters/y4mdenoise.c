@@ -0,0 +1,263 @@
+/*
+ *  y4mdenoise as a task, for y4mchain: the denoiser of
+ *  y4mdenoise/newdenoise.cc with the options of y4mdenoise(1), except
+ *  -v and -h.  Reading and writing in threads of their own (bit 0 of -p)
+ *  needs the file descriptors, so in a chain only the color planes (-p 2)
+ *  and the bands (-j) are denoised in parallel.  There is one such
+ *  denoiser per process, so a chain may have only one y4mdenoise.  Its
+ *  output is behind its input; the frames left at the end of the stream
+ *  are put out by do_fini().
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "yuvfilters.h"
+#include "newdenoise.hh"
+
+/* The denoiser's configuration and input frame count, which its
+   library expects the program to define. */
+DNSR_GLOBAL denoiser;
+int frame = 0;
+
+typedef struct {
+  YfTaskCore_t _;
+  int frames;			/* put into the denoiser */
+  int ylen, uvlen;
+  YfFrame_t frame;
+} YfTask_t;
+
+static int running;
+
+DEFINE_STD_YFTASKCLASS(y4mdenoise);
+
+static const char *
+do_usage(void)
+{
+  return "[-p 0|2] [-j bands] [-r radius] [-R radius] [-t error] [-T error] [-z error] [-Z error] [-m count] [-M size] [-f frames] [-F] [-B] [-I 0|1|2]";
+}
+
+static YfTaskCore_t *
+do_init(int argc, char **argv, const YfTaskCore_t *h0)
+{
+  YfTask_t *h;
+  int c, chroma;
+
+  memset(&denoiser, 0, sizeof denoiser);
+  denoiser.frames = 10;
+  denoiser.interlaced = -1;
+  denoiser.radiusY = 16;
+  denoiser.radiusCbCr = -1;
+  denoiser.zThresholdCbCr = -1;
+  denoiser.thresholdY = 3;
+  denoiser.thresholdCbCr = -1;
+  denoiser.matchCountThrottle = 16;
+  denoiser.matchSizeThrottle = 256;
+  denoiser.bands = 1;
+  while ((c = getopt(argc, argv, "z:Z:t:T:r:R:m:M:f:FBI:p:j:")) != -1) {
+    switch (c) {
+    case 'r':
+      denoiser.radiusY = atoi(optarg);
+      if (denoiser.radiusY < 4) {
+	denoiser.radiusY = 4;
+	WWARN("Minimum allowed search radius is 4 pixels.");
+      }
+      break;
+    case 'R':
+      denoiser.radiusCbCr = atoi(optarg);
+      if (denoiser.radiusCbCr < 4) {
+	denoiser.radiusCbCr = 4;
+	WWARN("Minimum allowed color search radius is 4 pixel.");
+      }
+      break;
+    case 'z':
+      denoiser.zThresholdY = atoi(optarg);
+      break;
+    case 'Z':
+      denoiser.zThresholdCbCr = atoi(optarg);
+      break;
+    case 't':
+      denoiser.thresholdY = atoi(optarg);
+      break;
+    case 'T':
+      denoiser.thresholdCbCr = atoi(optarg);
+      break;
+    case 'm':
+      denoiser.matchCountThrottle = atoi(optarg);
+      break;
+    case 'M':
+      denoiser.matchSizeThrottle = atoi(optarg);
+      break;
+    case 'f':
+      denoiser.frames = atoi(optarg);
+      break;
+    case 'F':
+      denoiser.fast = 1;
+      break;
+    case 'B':
+      denoiser.bwonly = 1;
+      break;
+    case 'I':
+      denoiser.interlaced = atoi(optarg);
+      if (denoiser.interlaced < 0 || 2 < denoiser.interlaced) {
+	WERROR("-I must be either 0, 1, or 2");
+	return NULL;
+      }
+      break;
+    case 'p':
+      denoiser.threads = atoi(optarg);
+      if (denoiser.threads < 0 || 3 < denoiser.threads) {
+	WERROR("-p must be either 0, 1, 2, or 3");
+	return NULL;
+      }
+      denoiser.threads &= ~1;
+      break;
+    case 'j':
+      denoiser.bands = atoi(optarg);
+      if (denoiser.bands < 1) {
+	WERROR("-j must be at least 1");
+	return NULL;
+      }
+      break;
+    default:
+      return NULL;
+    }
+  }
+  if (denoiser.radiusCbCr == -1)
+    denoiser.radiusCbCr = denoiser.radiusY;
+  if (denoiser.thresholdCbCr == -1)
+    denoiser.thresholdCbCr = denoiser.thresholdY;
+  if (denoiser.zThresholdCbCr == -1)
+    denoiser.zThresholdCbCr = denoiser.zThresholdY;
+  if (denoiser.zThresholdY > denoiser.thresholdY ||
+      denoiser.zThresholdCbCr > denoiser.thresholdCbCr) {
+    WERROR("-z/-Z setting cannot be larger than -t/-T setting");
+    return NULL;
+  }
+  if (running) {
+    WERROR("only one y4mdenoise per chain");
+    return NULL;
+  }
+  if (y4m_si_get_plane_count(&h0->si) != 3) {
+    WERROR("Only 3-plane formats supported.");
+    return NULL;
+  }
+  if (denoiser.interlaced == -1) {
+    switch (y4m_si_get_interlace(&h0->si)) {
+    case Y4M_ILACE_TOP_FIRST:
+      denoiser.interlaced = 1;
+      break;
+    case Y4M_ILACE_BOTTOM_FIRST:
+      denoiser.interlaced = 2;
+      break;
+    case Y4M_ILACE_NONE:
+      denoiser.interlaced = 0;
+      break;
+    default:
+      WWARN("Unknown interlacing, assuming non-interlaced");
+      denoiser.interlaced = 0;
+      break;
+    }
+  }
+  if (denoiser.interlaced != 0 && (denoiser.frames & 1) != 0) {
+    WERROR("When denoising interlaced material, -f must be a multiple of 2");
+    return NULL;
+  }
+
+  chroma = y4m_si_get_chroma(&h0->si);
+  denoiser.frame.w = h0->width;
+  denoiser.frame.h = h0->height;
+  denoiser.frame.ss_h = y4m_chroma_ss_x_ratio(chroma).d;
+  denoiser.frame.ss_v = y4m_chroma_ss_y_ratio(chroma).d;
+  denoiser.frame.Cw = denoiser.frame.w / denoiser.frame.ss_h;
+  denoiser.frame.Ch = denoiser.frame.h / denoiser.frame.ss_v;
+  h = (YfTask_t *)
+    YfAllocateTask(&y4mdenoise,
+		   sizeof *h + DATABYTES(chroma, h0->width, h0->height), h0);
+  if (!h)
+    return NULL;
+  if (newdenoise_init(denoiser.frames, denoiser.frame.w, denoiser.frame.h,
+		      denoiser.bwonly ? 0 : denoiser.frame.Cw,
+		      denoiser.bwonly ? 0 : denoiser.frame.Ch,
+		      -1, -1, NULL, NULL) != 0) {
+    WERROR("Could not initialize denoiser");
+    YfFreeTask((YfTaskCore_t *)h);
+    return NULL;
+  }
+  running = 1;
+  frame = 0;
+  h->ylen = denoiser.frame.w * denoiser.frame.h;
+  h->uvlen = denoiser.frame.Cw * denoiser.frame.Ch;
+  YfInitFrame(&h->frame, &h->_);
+  return (YfTaskCore_t *)h;
+}
+
+/* Denoise a frame, or with data NULL get one of those left at the end,
+   and put out the output frame if there is one.  *put tells if there
+   was. */
+static int
+denoise(YfTask_t *h, const uint8_t *data, int *put)
+{
+  uint8_t *out = h->frame.data;
+  int ret;
+
+  frame++;
+  *put = 0;
+  ret = (denoiser.interlaced ? newdenoise_interlaced_frame : newdenoise_frame)
+    (data, data ? data + h->ylen : NULL, data ? data + h->ylen + h->uvlen : NULL,
+     out, out + h->ylen, out + h->ylen + h->uvlen);
+  if (ret < 0) {
+    WERROR("Could not denoise frame");
+    return Y4M_ERR_SYSTEM;
+  }
+  if (ret == 1)
+    return Y4M_OK;
+  /* if b/w was selected, set the frame color to white */
+  if (denoiser.bwonly)
+    memset(out + h->ylen, 128, h->uvlen * 2);
+  *put = 1;
+  return YfPutFrame(&h->_, &h->frame);
+}
+
+static void
+do_fini(YfTaskCore_t *handle)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  int put;
+
+  if (h->frames)
+    while (denoise(h, NULL, &put) == Y4M_OK && put)
+      ;
+  newdenoise_shutdown();
+  running = 0;
+  YfFiniFrame(&h->frame);
+  YfFreeTask(handle);
+}
+
+static int
+do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  int put;
+
+  if (!frame0)
+    return 0;
+  h->frames++;
+  return denoise(h, frame0->data, &put);
+}
@@ -0,0 +1,207 @@
+/*
+ *  y4munsharp as a task, for y4mchain: the unsharp mask of
+ *  y4munsharp/unsharp.c with the options of y4munsharp(1), except
+ *  -v (the verbosity is MJPEG_VERBOSITY's).
+ *
+ *  Frames are sharpened independently of each other (YF_STATELESS),
+ *  each with a work area of its own.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "yuvfilters.h"
+#include "unsharp.h"
+
+typedef struct Work_tag {
+  struct Work_tag *next;	/* in the idle list */
+  struct Work_tag *all;		/* in the list of all of them */
+  u_char *cur_col, *dest_col;
+  YfFrame_t frame;		/* last, for its data */
+} Work_t;
+
+typedef struct {
+  YfTaskCore_t _;
+  unsharp_t unsharp;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t lock;
+#endif
+  Work_t *idle;
+  Work_t *works;
+} YfTask_t;
+
+DEFINE_STATELESS_YFTASKCLASS(y4munsharp);
+
+static const char *
+do_usage(void)
+{
+  return "[-N] [-L radius,amount,threshold] [-C radius,amount,threshold]";
+}
+
+static YfTaskCore_t *
+do_init(int argc, char **argv, const YfTaskCore_t *h0)
+{
+  YfTask_t *h;
+  unsharp_settings_t s;
+  int c;
+
+  unsharp_defaults(&s);
+  while ((c = getopt(argc, argv, "NL:C:")) != -1) {
+    switch (c) {
+    case 'N':
+      s.lowy = s.lowuv = 0;
+      s.highy = s.highuv = 255;
+      break;
+    case 'L':
+      if (sscanf(optarg, "%lf,%lf,%d",
+		 &s.y_radius, &s.y_amount, &s.y_threshold) != 3) {
+	WERROR("-L radius,amount,threshold");
+	return NULL;
+      }
+      break;
+    case 'C':
+      if (sscanf(optarg, "%lf,%lf,%d",
+		 &s.uv_radius, &s.uv_amount, &s.uv_threshold) != 3) {
+	WERROR("-C radius,amount,threshold");
+	return NULL;
+      }
+      break;
+    default:
+      return NULL;
+    }
+  }
+  h = (YfTask_t *)YfAllocateTask(&y4munsharp, sizeof *h, h0);
+  if (!h)
+    return NULL;
+  if (unsharp_init(&h->unsharp, &s, &h0->si)) {
+    YfFreeTask((YfTaskCore_t *)h);
+    return NULL;
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_init(&h->lock, NULL);
+#endif
+  return (YfTaskCore_t *)h;
+}
+
+static void
+do_fini(YfTaskCore_t *handle)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  Work_t *w;
+
+  while ((w = h->works)) {
+    h->works = w->all;
+    free(w->cur_col);
+    free(w->dest_col);
+    YfFiniFrame(&w->frame);
+    free(w);
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_destroy(&h->lock);
+#endif
+  unsharp_fini(&h->unsharp);
+  YfFreeTask(handle);
+}
+
+static Work_t *
+get_work(YfTask_t *h)
+{
+  Work_t *w;
+  int size;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&h->lock);
+#endif
+  if ((w = h->idle))
+    h->idle = w->next;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&h->lock);
+#endif
+  if (w)
+    return w;
+
+  if (!(w = malloc(FRAMEBYTES(y4m_si_get_chroma(&h->_.si), h->_.width, h->_.height) +
+		   offsetof(Work_t, frame)))) {
+    perror("malloc");
+    return NULL;
+  }
+  size = unsharp_scratch_size(&h->unsharp);
+  w->cur_col = malloc(size);
+  w->dest_col = malloc(size);
+  if (!w->cur_col || !w->dest_col) {
+    perror("malloc");
+    free(w->cur_col);
+    free(w->dest_col);
+    free(w);
+    return NULL;
+  }
+  YfInitFrame(&w->frame, &h->_);
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&h->lock);
+#endif
+  w->all = h->works;
+  h->works = w;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&h->lock);
+#endif
+  return w;
+}
+
+static void
+put_work(YfTask_t *h, Work_t *w)
+{
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&h->lock);
+#endif
+  w->next = h->idle;
+  h->idle = w;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&h->lock);
+#endif
+}
+
+static int
+do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  Work_t *w;
+  u_char *input[3], *output[3];
+  int ylen = h->_.width * h->_.height;
+  int ret;
+
+  if (!frame0)
+    return 0;
+  if (!(w = get_work(h)))
+    return Y4M_ERR_SYSTEM;
+
+  input[0] = (u_char *)frame0->data;
+  input[1] = input[0] + ylen;
+  input[2] = input[1] + h->unsharp.uvlen;
+  output[0] = w->frame.data;
+  output[1] = output[0] + ylen;
+  output[2] = output[1] + h->unsharp.uvlen;
+  unsharp_frame(&h->unsharp, w->cur_col, w->dest_col, 0, input, output);
+  y4m_copy_frame_info(&w->frame.fi, &frame0->fi);
+  /* the frame is copied or passed on before YfPutFrame() returns */
+  ret = YfPutFrame(&h->_, &w->frame);
+  put_work(h, w);
+  return ret;
+}
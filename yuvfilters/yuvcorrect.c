@@ -0,0 +1,298 @@
+/*
+ *  yuvcorrect as a task, for y4mchain: the corrections of
+ *  yuvcorrect/yuvcorrect_functions.c with the options of yuvcorrect(1),
+ *  except -v and -h, and -T NO_HEADER which has no use inside a chain.
+ *
+ *  Frames are corrected independently of each other (YF_STATELESS),
+ *  each in a work area of its own, unless -T BOTT_FORWARD|TOP_FORWARD
+ *  carries a field from one frame to the next or -M STAT prints their
+ *  statistics: then they are corrected in order.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "yuvfilters.h"
+#include "yuvcorrect.h"
+
+typedef struct Work_tag {
+  struct Work_tag *next;	/* in the idle list */
+  struct Work_tag *all;		/* in the list of all of them */
+  YfFrame_t frame;		/* last, for its data */
+} Work_t;
+
+typedef struct {
+  YfTaskCore_t _;
+  frame_t frame;		/* sizes, and the fields carried forward */
+  general_correction_t gen;
+  yuv_correction_t yuv;
+  rgb_correction_t rgb;
+  int stat, rgbfirst;
+  unsigned long frames;		/* only counted in order */
+#ifdef HAVE_PTHREAD
+  pthread_mutex_t lock;
+#endif
+  Work_t *idle;
+  Work_t *works;
+} YfTask_t;
+
+DEFINE_STATELESS_YFTASKCLASS(yuvcorrect);
+
+/* the same task, with its frames in order */
+static const YfTaskClass_t yuvcorrect_ordered = {
+  do_usage, do_init, do_fini, do_frame, 0,
+};
+
+static const char *
+do_usage(void)
+{
+  return "[-M STAT|RGBFIRST] [-T general_keyword] [-Y yuv_keyword] [-R RGB_keyword]";
+}
+
+static YfTaskCore_t *
+do_init(int argc, char **argv, const YfTaskCore_t *h0)
+{
+  YfTask_t *h;
+  frame_t frame;
+  general_correction_t gen;
+  yuv_correction_t yuv;
+  rgb_correction_t rgb;
+  int stat = 0, rgbfirst = 0, interlace = -1;
+  int c;
+
+  if (y4m_si_get_plane_count(&h0->si) != 3) {
+    WERROR("Only 3 plane formats supported");
+    return NULL;
+  }
+  yuvcorrect_stream_init(&h0->si, &frame, &gen, &yuv, &rgb);
+  while ((c = getopt(argc, argv, "M:T:Y:R:")) != -1) {
+    switch (c) {
+    case 'M':
+      if (!strcmp(optarg, "STAT"))
+	stat = 1;
+      else if (!strcmp(optarg, "RGBFIRST"))
+	rgbfirst = 1;
+      else {
+	WERRORL(optarg);
+	WERROR("unrecognized MODE keyword");
+	return NULL;
+      }
+      break;
+    case 'T':
+      if (!strcmp(optarg, "INTERLACED_TOP_FIRST"))
+	interlace = Y4M_ILACE_TOP_FIRST;
+      else if (!strcmp(optarg, "INTERLACED_BOTTOM_FIRST"))
+	interlace = Y4M_ILACE_BOTTOM_FIRST;
+      else if (!strcmp(optarg, "NOT_INTERLACED") ||
+	       !strcmp(optarg, "PROGRESSIVE"))
+	interlace = Y4M_ILACE_NONE;
+      else if (!strcmp(optarg, "LINE_SWITCH"))
+	gen.line_switch = 1;
+      else if (!strcmp(optarg, "BOTT_FORWARD"))
+	gen.field_move = 1;
+      else if (!strcmp(optarg, "TOP_FORWARD"))
+	gen.field_move = -1;
+      else {
+	WERRORL(optarg);
+	WERROR("unrecognized or unusable GENERAL keyword");
+	return NULL;
+      }
+      break;
+    case 'Y':
+    case 'R':
+      break;
+    default:
+      return NULL;
+    }
+  }
+  handle_args_yuv_rgb(argc, argv, &yuv, &rgb);
+
+  h = (YfTask_t *)
+    YfAllocateTask((gen.field_move || stat) ? &yuvcorrect_ordered : &yuvcorrect,
+		   sizeof *h, h0);
+  if (!h)
+    return NULL;
+  if (gen.field_move &&
+      (!(frame.field1 = malloc(frame.length >> 1)) ||
+       !(frame.field2 = malloc(frame.length >> 1)))) {
+    perror("malloc");
+    free(frame.field1);
+    YfFreeTask((YfTaskCore_t *)h);
+    return NULL;
+  }
+  initialisation2(&yuv, &rgb);
+  if (interlace != -1)
+    y4m_si_set_interlace(&h->_.si, interlace);
+  h->frame = frame;
+  h->gen = gen;
+  h->yuv = yuv;
+  h->rgb = rgb;
+  h->stat = stat;
+  h->rgbfirst = rgbfirst;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_init(&h->lock, NULL);
+#endif
+  return (YfTaskCore_t *)h;
+}
+
+static void
+do_fini(YfTaskCore_t *handle)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  Work_t *w;
+
+  while ((w = h->works)) {
+    h->works = w->all;
+    YfFiniFrame(&w->frame);
+    free(w);
+  }
+#ifdef HAVE_PTHREAD
+  pthread_mutex_destroy(&h->lock);
+#endif
+  free(h->frame.field1);
+  free(h->frame.field2);
+  y4m_fini_stream_info(&h->gen.streaminfo);
+  YfFreeTask(handle);
+}
+
+static Work_t *
+get_work(YfTask_t *h)
+{
+  Work_t *w;
+
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&h->lock);
+#endif
+  if ((w = h->idle))
+    h->idle = w->next;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&h->lock);
+#endif
+  if (w)
+    return w;
+
+  if (!(w = malloc(FRAMEBYTES(y4m_si_get_chroma(&h->_.si), h->_.width, h->_.height) +
+		   offsetof(Work_t, frame)))) {
+    perror("malloc");
+    return NULL;
+  }
+  YfInitFrame(&w->frame, &h->_);
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&h->lock);
+#endif
+  w->all = h->works;
+  h->works = w;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&h->lock);
+#endif
+  return w;
+}
+
+static void
+put_work(YfTask_t *h, Work_t *w)
+{
+#ifdef HAVE_PTHREAD
+  pthread_mutex_lock(&h->lock);
+#endif
+  w->next = h->idle;
+  h->idle = w;
+#ifdef HAVE_PTHREAD
+  pthread_mutex_unlock(&h->lock);
+#endif
+}
+
+/* copy with the lines swapped two by two, as yuvcorrect_y4m_read_frame()
+   reads them for -T LINE_SWITCH */
+static void
+switch_lines(uint8_t *dst, const uint8_t *src, int width, int lines)
+{
+  int line;
+
+  for (line = 0; line < lines; line += 2) {
+    memcpy(dst + width, src, width);
+    memcpy(dst, src + width, width);
+    src += 2 * width;
+    dst += 2 * width;
+  }
+}
+
+static int
+do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  Work_t *w;
+  frame_t frame;
+  uint8_t oddeven;
+  int ret;
+
+  if (!frame0)
+    return 0;
+  if (!(w = get_work(h)))
+    return Y4M_ERR_SYSTEM;
+
+  /* the fields carried forward are only used in order */
+  frame = h->frame;
+  frame.y = w->frame.data;
+  frame.u = frame.y + frame.nb_y;
+  frame.v = frame.u + frame.nb_uv;
+  if (h->gen.line_switch) {
+    switch_lines(frame.y, frame0->data, frame.y_width, frame.y_height);
+    switch_lines(frame.u, frame0->data + frame.nb_y,
+		 frame.uv_width, frame.uv_height << 1);
+  } else
+    memcpy(frame.y, frame0->data, frame.length);
+
+  if (h->stat)
+    yuvstat(&frame);
+
+  if (h->gen.field_move) {
+    oddeven = h->frames & 1;
+    if (h->gen.field_move == 1)
+      bottom_field_storage(&frame, oddeven, frame.field1, frame.field2);
+    else
+      top_field_storage(&frame, oddeven, frame.field1, frame.field2);
+    /* the first frame only gives its field to the second */
+    if (h->frames++ == 0) {
+      put_work(h, w);
+      return 0;
+    }
+    if (h->gen.field_move == 1)
+      bottom_field_replace(&frame, oddeven, frame.field1, frame.field2);
+    else
+      top_field_replace(&frame, oddeven, frame.field1, frame.field2);
+  }
+
+  if (h->rgbfirst && h->rgb.rgb)
+    yuvcorrect_RGB_treatment(&frame, &h->rgb);
+  if (h->yuv.luma)
+    yuvcorrect_luminance_treatment(&frame, &h->yuv);
+  if (h->yuv.chroma)
+    yuvcorrect_chrominance_treatment(&frame, &h->yuv);
+  if (!h->rgbfirst && h->rgb.rgb)
+    yuvcorrect_RGB_treatment(&frame, &h->rgb);
+
+  y4m_copy_frame_info(&w->frame.fi, &frame0->fi);
+  /* the frame is copied or passed on before YfPutFrame() returns */
+  ret = YfPutFrame(&h->_, &w->frame);
+  put_work(h, w);
+  return ret;
+}
@@ -0,0 +1,146 @@
+/*
+ *  yuvdeinterlace as a task, for y4mchain: the deinterlacer of
+ *  yuvdeinterlace/deinterlace.cc with the options of yuvdeinterlace(1),
+ *  except -v and -h.  There is one such deinterlacer per process, so a
+ *  chain may have only one yuvdeinterlace.  Unless -a is given, its
+ *  output is one frame behind its input; the frame left at the end of the
+ *  stream is put out by do_fini().
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "yuvfilters.h"
+#include "yuvdeinterlace.h"
+
+typedef struct {
+  YfTaskCore_t _;
+  int ylen, uvlen;
+  YfFrame_t frame;
+} YfTask_t;
+
+static int running;
+
+DEFINE_STD_YFTASKCLASS(yuvdeinterlace);
+
+static const char *
+do_usage(void)
+{
+  return "[-d] [-a] [-s 0|1]";
+}
+
+static int
+put_planes(void *arg, uint8_t **planes)
+{
+  YfTask_t *h = (YfTask_t *)arg;
+
+  memcpy(h->frame.data, planes[0], h->ylen);
+  memcpy(h->frame.data + h->ylen, planes[1], h->uvlen);
+  memcpy(h->frame.data + h->ylen + h->uvlen, planes[2], h->uvlen);
+  return YfPutFrame(&h->_, &h->frame);
+}
+
+static YfTaskCore_t *
+do_init(int argc, char **argv, const YfTaskCore_t *h0)
+{
+  YfTask_t *h;
+  yuvdeinterlace_settings_t s;
+  int c, chroma = y4m_si_get_chroma(&h0->si);
+
+  memset(&s, 0, sizeof s);
+  s.field_order = -1;
+  while ((c = getopt(argc, argv, "ds:t:a")) != -1) {
+    switch (c) {
+    case 'd':
+      s.both_fields = 1;
+      break;
+    case 'a':
+      s.just_anti_alias = 1;
+      s.field_order = 0;
+      break;
+    case 't':
+      break;
+    case 's':
+      s.field_order = !!atoi(optarg);
+      break;
+    default:
+      return NULL;
+    }
+  }
+  if (running) {
+    WERROR("only one yuvdeinterlace per chain");
+    return NULL;
+  }
+  if (s.field_order == -1) {
+    switch (y4m_si_get_interlace(&h0->si)) {
+    case Y4M_ILACE_TOP_FIRST:
+      s.field_order = 1;
+      break;
+    case Y4M_ILACE_BOTTOM_FIRST:
+      s.field_order = 0;
+      break;
+    default:
+      WERROR("unknown field order: give -s 0 or -s 1");
+      return NULL;
+    }
+  }
+  h = (YfTask_t *)
+    YfAllocateTask(&yuvdeinterlace,
+		   sizeof *h + DATABYTES(chroma, h0->width, h0->height), h0);
+  if (!h)
+    return NULL;
+  if (yuvdeinterlace_init(&s, h0->width, h0->height, chroma,
+			  put_planes, h)) {
+    YfFreeTask((YfTaskCore_t *)h);
+    return NULL;
+  }
+  running = 1;
+  y4m_si_set_interlace(&h->_.si, Y4M_ILACE_NONE);
+  h->ylen = h0->width * h0->height;
+  h->uvlen = (h0->width / CWDIV(chroma)) * (h0->height / CHDIV(chroma));
+  YfInitFrame(&h->frame, &h->_);
+  return (YfTaskCore_t *)h;
+}
+
+static void
+do_fini(YfTaskCore_t *handle)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+
+  yuvdeinterlace_flush();
+  yuvdeinterlace_fini();
+  running = 0;
+  YfFiniFrame(&h->frame);
+  YfFreeTask(handle);
+}
+
+static int
+do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  uint8_t **in;
+
+  if (!frame0)
+    return 0;
+  in = yuvdeinterlace_input();
+  memcpy(in[0], frame0->data, h->ylen);
+  memcpy(in[1], frame0->data + h->ylen, h->uvlen);
+  memcpy(in[2], frame0->data + h->ylen + h->uvlen, h->uvlen);
+  return yuvdeinterlace_frame();
+}
@@ -0,0 +1,155 @@
+/*
+ *  yuvdenoise as a task, for y4mchain: the filters of
+ *  yuvdenoise/denoise.c with the options of yuvdenoise(1), except -v and
+ *  -h.  There is one such denoiser per process, so a chain may have only
+ *  one yuvdenoise.  Its output is 'radius' (-T) frames behind its input;
+ *  the frames left at the end of the stream are put out by do_fini().
+ *  Samples of more than 8 bits (YF_DEEP) are filtered at their depth.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "yuvfilters.h"
+#include "yuvdenoise.h"
+
+typedef struct {
+  YfTaskCore_t _;
+  int frames;			/* put into the denoiser */
+  int ylen, uvlen;
+  YfFrame_t frame;
+} YfTask_t;
+
+static int running;
+
+DEFINE_FLAGGED_YFTASKCLASS(yuvdenoise, YF_DEEP);
+
+static const char *
+do_usage(void)
+{
+  return "[-q] [-T radius] [-g Y,U,V] [-m Y,U,V] [-t Y,U,V] [-M Y,U,V] [-G Y,U,V] [-r Y,U,V]";
+}
+
+static YfTaskCore_t *
+do_init(int argc, char **argv, const YfTaskCore_t *h0)
+{
+  YfTask_t *h;
+  yuvdenoise_settings_t s;
+  int c, chroma = y4m_si_get_chroma(&h0->si);
+
+  memset(&s, 0, sizeof s);
+  s.radius = 3;
+  while ((c = getopt(argc, argv, "qt:T:g:m:M:r:G:")) != -1) {
+    switch (c) {
+    case 'q':
+      s.hq_mode = 1;
+      break;
+    case 't':
+      sscanf(optarg, "%i,%i,%i", &s.temporal[0], &s.temporal[1], &s.temporal[2]);
+      break;
+    case 'T':
+      s.radius = atoi(optarg);
+      break;
+    case 'g':
+      sscanf(optarg, "%i,%i,%i", &s.gauss[0], &s.gauss[1], &s.gauss[2]);
+      break;
+    case 'm':
+      sscanf(optarg, "%i,%i,%i", &s.med_pre[0], &s.med_pre[1], &s.med_pre[2]);
+      break;
+    case 'M':
+      sscanf(optarg, "%i,%i,%i", &s.med_post[0], &s.med_post[1], &s.med_post[2]);
+      break;
+    case 'G':
+      sscanf(optarg, "%i,%i,%i", &s.med_pre[0], &s.med_pre[1], &s.med_pre[2]);
+      for (c = 0; c < 3; c++) {
+	s.med_post[c] = s.med_pre[c];
+	s.temporal[c] = s.med_pre[c] * 2;
+      }
+      break;
+    case 'r':
+      sscanf(optarg, "%i,%i,%i", &s.renoise[0], &s.renoise[1], &s.renoise[2]);
+      break;
+    default:
+      return NULL;
+    }
+  }
+  if (running) {
+    WERROR("only one yuvdenoise per chain");
+    return NULL;
+  }
+  h = (YfTask_t *)
+    YfAllocateTask(&yuvdenoise,
+		   sizeof *h + SIDATABYTES(&h0->si, h0->width, h0->height), h0);
+  if (!h)
+    return NULL;
+  if (yuvdenoise_init(&s, h0->width, h0->height, chroma,
+		      y4m_si_get_interlace(&h0->si),
+		      y4m_si_get_bitdepth(&h0->si))) {
+    YfFreeTask((YfTaskCore_t *)h);
+    return NULL;
+  }
+  running = 1;
+  h->ylen = h0->width * h0->height * y4m_si_get_sample_size(&h0->si);
+  h->uvlen = (h0->width / CWDIV(chroma)) * (h0->height / CHDIV(chroma)) *
+    y4m_si_get_sample_size(&h0->si);
+  YfInitFrame(&h->frame, &h->_);
+  return (YfTaskCore_t *)h;
+}
+
+static int
+put_planes(YfTask_t *h, uint8_t **planes)
+{
+  memcpy(h->frame.data, planes[0], h->ylen);
+  memcpy(h->frame.data + h->ylen, planes[1], h->uvlen);
+  memcpy(h->frame.data + h->ylen + h->uvlen, planes[2], h->uvlen);
+  return YfPutFrame(&h->_, &h->frame);
+}
+
+static void
+do_fini(YfTaskCore_t *handle)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  uint8_t **out;
+
+  if (h->frames)
+    while ((out = yuvdenoise_flush()) && put_planes(h, out) == Y4M_OK)
+      ;
+  yuvdenoise_fini();
+  running = 0;
+  YfFiniFrame(&h->frame);
+  YfFreeTask(handle);
+}
+
+static int
+do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+  uint8_t **in, **out;
+
+  if (!frame0)
+    return 0;
+  in = yuvdenoise_input();
+  memcpy(in[0], frame0->data, h->ylen);
+  memcpy(in[1], frame0->data + h->ylen, h->uvlen);
+  memcpy(in[2], frame0->data + h->ylen + h->uvlen, h->uvlen);
+  h->frames++;
+  if ((out = yuvdenoise_frame()))
+    return put_planes(h, out);
+  return 0;
+}
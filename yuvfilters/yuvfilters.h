@@ -54,13 +54,19 @@ typedef struct {
 #define DATABYTES(C,W,H) \
 (((W)*(H))+(((C)==Y4M_CHROMA_MONO)?0:(((W)/CWDIV(C))*((H)/CHDIV(C))*2)))
 #define FRAMEBYTES(C,W,H) (sizeof ((YfFrame_t *)0)->fi + DATABYTES(C,W,H))
+/* the same for a stream's sample size: 2 bytes if more than 8 bits */
+#define SIDATABYTES(SI,W,H) \
+(DATABYTES(y4m_si_get_chroma(SI),W,H)*y4m_si_get_sample_size(SI))
+#define SIFRAMEBYTES(SI,W,H) (sizeof ((YfFrame_t *)0)->fi + SIDATABYTES(SI,W,H))
 
 struct YfTaskClass_tag;
+struct YfQueue_tag;
 
 typedef struct YfTaskCore_tag {
   /* private: filter may not touch */
   const struct YfTaskClass_tag *method;
   struct YfTaskCore_tag *handle_outgoing;
+  struct YfQueue_tag *queue_outgoing;	/* to handle_outgoing's thread */
   /* protected: filter must set */
   y4m_stream_info_t si;
   int width, height, fpscode;
@@ -71,8 +77,17 @@ typedef struct YfTaskClass_tag {
   YfTaskCore_t *(*init)(int argc, char **argv, const YfTaskCore_t *h0);
   void (*fini)(YfTaskCore_t *handle);
   int (*frame)(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0);
+  unsigned int flags;
 } YfTaskClass_t;
 
+/* flags of YfTaskClass_t */
+/* frame() only reads the handle and keeps nothing from one frame to the
+   next, so that frames can be processed in parallel */
+#define YF_STATELESS 1
+/* frame() takes samples of more than 8 bits (2 bytes each, least
+   significant first); tasks without it refuse such streams */
+#define YF_DEEP 2
+
 
 #define DECLARE_YFTASKCLASS(name) \
 extern const YfTaskClass_t name
@@ -86,6 +101,16 @@ const YfTaskClass_t name = { prefix##_usage, prefix##_init, prefix##_fini, prefi
 
 #define DEFINE_STD_YFTASKCLASS(name) DEFINE_YFTASKCLASS(static,do,name)
 
+#define DEFINE_FLAGGED_YFTASKCLASS(name, flags) \
+static const char *do_usage(void); \
+static YfTaskCore_t *do_init(int argc, char **argv, const YfTaskCore_t *h0); \
+static void do_fini(YfTaskCore_t *handle); \
+static int do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t * frame0); \
+const YfTaskClass_t name = { do_usage, do_init, do_fini, do_frame, flags, }
+
+#define DEFINE_STATELESS_YFTASKCLASS(name) \
+DEFINE_FLAGGED_YFTASKCLASS(name, YF_STATELESS)
+
 extern int verbose;
 
 extern YfTaskCore_t *YfAllocateTask(const YfTaskClass_t *filter, size_t size, const YfTaskCore_t *h0);
@@ -95,6 +120,8 @@ extern void YfFiniFrame(YfFrame_t *frame);
 extern int YfPutFrame(const YfTaskCore_t *handle, const YfFrame_t *frame);
 extern YfTaskCore_t *YfAddNewTask(const YfTaskClass_t *filter,
 				  int argc, char **argv, const YfTaskCore_t *h0);
+extern int YfRunTasks(YfTaskCore_t *hreader, int threads);
+extern int YfQueueFrame(struct YfQueue_tag *queue, const YfFrame_t *frame);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,1371 @@
+/*
+ *    Copyright (C) 2001 Mike Bernson <mike@mlb.org>
+ *
+ *    This program is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *    Filter Based on code from Jim Cassburi filter: 2dclean
+ *
+ *    This filter look around the current point for a radius and averages
+ *    this values that fall inside a threshold.
+ *
+ *    The values around each point are not scanned one by one: each
+ *    column keeps a histogram of the values in the window's rows (or,
+ *    in fast mode, just their sum), updated as the window moves down,
+ *    and the window's histogram is made of those of its columns as it
+ *    moves right, 16 bins at a time and only where the threshold needs
+ *    it.  So the time per point does not depend on the radius.  (For
+ *    small radii, scanning 16 points at a time is still cheaper.)
+ *
+ *    Frames are filtered independently of each other (YF_STATELESS),
+ *    each with a work area of its own, so that several can be filtered
+ *    at a time.  Only skipping the first frames (-S) needs them in order.
+ *    Each plane may also be split into bands of rows, filtered at the
+ *    same time by the task's band threads; by default only when frames
+ *    are not already filtered in parallel.
+ *
+ *    Samples of more than 8 bits (YF_DEEP) are filtered the same way,
+ *    with the thresholds scaled to their depth, but always looked at
+ *    one by one: a histogram of 2^16 bins per column would not stay in
+ *    any cache.  So with them, large radii are slow.
+ */
+#include <config.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "yuvfilters.h"
+#include "mjpeg_logging.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+/* deep samples are stored least significant byte first */
+#ifdef WORDS_BIGENDIAN
+# define LE16(v) ((uint16_t)(((v) >> 8) | ((v) << 8)))
+#else
+# define LE16(v) (v)
+#endif
+
+
+// must be less than 24
+#define DIVISORBITS 20
+
+#define	NUMAVG	1024
+
+/* window histograms count up to (2 * MAXRADIUS + 1)^2 values in 16 bits */
+#define MAXRADIUS	127
+
+/* up to this radius, looking at every value around a pixel is faster */
+#define DIRECTRADIUS	5
+
+/* output columns whose column histograms are kept at a time */
+#define STRIPE		256
+
+#define MAXBANDS	16
+#define MINBANDROWS	16	/* fewer rows are not worth a thread */
+
+/* what each band thread works with */
+typedef struct {
+	uint8_t	*colhist;	/* per column of a stripe, 256 bins: values in
+				   the window's rows */
+	uint16_t *colsum;	/* per column: sum of the values in the window's rows */
+	uint32_t *colsum_deep;	/* the same, for deep samples */
+	unsigned long avg_replace[NUMAVG];
+} Band_t;
+
+struct Work_tag;
+
+/* One band of rows of every plane of a frame, for a band thread. */
+typedef struct BandJob_tag {
+	struct BandJob_tag *next;	/* in the task's list of waiting ones */
+	struct Work_tag *w;
+	int	band;
+} BandJob_t;
+
+/* what a frame is filtered with: one for each frame filtered at a time */
+typedef struct Work_tag {
+	struct Work_tag *next;	/* in the task's list of idle ones */
+	struct Work_tag *all;	/* in the task's list of all of them */
+	unsigned int frames;
+	uint8_t	*const *input;	/* of the frame being filtered */
+	uint8_t	**output;
+	int	bands_left;	/* not finished yet */
+	BandJob_t jobs[MAXBANDS];
+	Band_t	bands[MAXBANDS];
+	YfFrame_t frame;	/* last: frame data follows */
+} Work_t;
+
+typedef struct {
+	YfTaskCore_t _;
+	int	threshold_luma, threshold_chroma;
+	int	radius_luma, radius_chroma;
+	int	interlace;
+	int	skip;
+	int	fast;
+	int	weight_type;	/* 0 = use weight, 1 = 8, 2 = 2.667,
+				   3 = 13.333, 4 = 24 */
+	double	weight;
+	double	cutoff;
+	int	ss_h, ss_v;
+	int	deep;		/* samples of more than 8 bits */
+	int	shift;		/* the bits above 8 */
+	int	skipped;
+	int	nbands;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t lock;	/* guards idle, works and the band jobs */
+	pthread_cond_t queued, done;
+	BandJob_t *jobs;	/* waiting for a thread */
+	int	quit;
+	int	nthreads;
+	pthread_t threads[MAXBANDS];
+#endif
+	Work_t	*idle;
+	Work_t	*works;
+} YfTask_t;
+
+static int divisor[NUMAVG],divoffset[NUMAVG];
+
+static void	filter(YfTask_t *h, Work_t *w, uint8_t *const input[], uint8_t *output[]);
+static void	filter_band(YfTask_t *h, Work_t *w, int band);
+#ifdef HAVE_PTHREAD
+static void	*band_thread(void *arg);
+#endif
+static void	filter_rows(YfTask_t *h, Band_t *b, int width, int height, int stride, int radius, int threshold, const uint8_t *input, uint8_t *output, int first, int last);
+static void	filter_rows_fast(YfTask_t *h, Band_t *b, int width, int height, int stride, int radius, int threshold, const uint8_t *input, uint8_t *output, int first, int last);
+static void	filter_rows_deep(YfTask_t *h, Band_t *b, int width, int height, int stride, int radius, int threshold, const uint16_t *input, uint16_t *output, int first, int last);
+static void	filter_rows_fast_deep(YfTask_t *h, Band_t *b, int width, int height, int stride, int radius, int threshold, const uint16_t *input, uint16_t *output, int first, int last);
+
+DEFINE_FLAGGED_YFTASKCLASS(yuvmedianfilter, YF_STATELESS | YF_DEEP);
+
+/* with -S, which frames are filtered depends on their order */
+static const YfTaskClass_t yuvmedianfilter_ordered = {
+	do_usage, do_init, do_fini, do_frame, YF_DEEP,
+};
+
+static const char *
+do_usage(void)
+{
+	return "[-h] [-r num] [-R num] [-t num] [-T num] [-c cutoff] [-v num]\n"
+		"-h   - Print out this help\n"
+		"-r   - Radius for luma median (default: 2 pixels)\n"
+		"-R   - Radius for chroma median (default: 2 pixels)\n"
+		"-t   - Trigger luma threshold (default: 2 [0=disable], on the 8-bit scale)\n"
+		"-T   - Trigger chroma threshold (default: 2 [0=disable], on the 8-bit scale)\n"
+		"-I   - Interlacing 0=off 1=on (default: taken from yuv stream)\n"
+		"-f   - Fast mode (i.e. no trigger threshold, just simple mean)\n"
+		"-w   - Weight given to current pixel vs. pixel in radius (default: 8)\n"
+		"-c   - Fraction of pixels that must be within threshold (default: 0.333)\n"
+		"-v   - Verbosity [0..2]";
+}
+
+static YfTaskCore_t *
+do_init(int argc, char **argv, const YfTaskCore_t *h0)
+{
+	YfTask_t *h;
+	int	i;
+	int	c;
+	int	threshold_luma = 2;
+	int	threshold_chroma = 2;
+	int	radius_luma = 2;
+	int	radius_chroma = 2;
+	int	interlace = -1;
+	int	param_skip = 0;
+	int	param_fast = 0;
+	int	param_weight_type = 0;
+	double	param_weight = -1.0;
+	double	cutoff = 0.3333333;
+	int	threads, rows;
+	char	*p;
+
+	while((c = getopt(argc, argv, "r:R:t:T:v:S:hI:w:fc:")) != -1) {
+		switch(c) {
+		case 'r':
+			radius_luma = atoi(optarg);
+			break;
+		case 'R':
+			radius_chroma = atoi(optarg);
+			break;
+		case 't':
+			threshold_luma = atoi(optarg);
+			break;
+		case 'T':
+			threshold_chroma = atoi(optarg);
+			break;
+		case 'I':
+			interlace = atoi (optarg);
+			if (interlace != 0 && interlace != 1)
+				return NULL;
+			break;
+		case 'S':
+			param_skip = atoi (optarg);
+			break;
+		case 'f':
+			param_fast = 1;
+			break;
+		case 'w':
+			if (strcmp (optarg, "8") == 0)
+				param_weight_type = 1;
+			else if (strcmp (optarg, "2.667") == 0)
+				param_weight_type = 2;
+			else if (strcmp (optarg, "13.333") == 0)
+				param_weight_type = 3;
+			else if (strcmp (optarg, "24") == 0)
+				param_weight_type = 4;
+			else
+				param_weight_type = 0;
+			param_weight = atof (optarg);
+			break;
+		case 'c':
+			cutoff = atof(optarg);
+			break;
+		case 'v':
+			verbose = atoi (optarg);
+			if (verbose < 0 || verbose >2)
+				return NULL;
+			break;
+		default:
+			return NULL;
+		}
+	}
+
+	if( param_weight < 0 ) {
+		if( param_fast )
+			param_weight = 8.0;
+		else
+			param_weight = 1.0;
+	}
+
+	for( i=1; i<NUMAVG; i++ ) {
+		divisor[i]=((1<<DIVISORBITS)+(i>>1))/i;
+		divoffset[i]=divisor[i]*(i>>1)+(divisor[i]>>1);
+	}
+
+	mjpeg_info ("fast %d, weight type %d\n", param_fast,
+		param_weight_type);
+
+	if (radius_luma <= 0 || radius_chroma <= 0) {
+		WERROR("radius values must be > 0!");
+		return NULL;
+	}
+
+	if (radius_luma > MAXRADIUS || radius_chroma > MAXRADIUS) {
+		WERROR("radius values must be <= 127!");
+		return NULL;
+	}
+
+	if (threshold_luma < 0 || threshold_chroma < 0) {
+		WERROR("threshold values must be >= 0!");
+		return NULL;
+	}
+
+	(void)mjpeg_default_handler_verbosity(verbose);
+
+	if (y4m_si_get_plane_count(&h0->si) != 3) {
+		WERROR("Only 3 plane formats supported");
+		return NULL;
+	}
+
+	if (interlace == -1)
+	{
+	  i = y4m_si_get_interlace(&h0->si);
+	  switch (i)
+	  {
+	  case Y4M_ILACE_NONE:
+	       interlace = 0;
+	       break;
+	  case Y4M_ILACE_BOTTOM_FIRST:
+	  case Y4M_ILACE_TOP_FIRST:
+	       interlace = 1;
+	       break;
+	  default:
+	       mjpeg_warn("Unknown interlacing '%d', assuming non-interlaced", i);
+	       interlace = 0;
+	       break;
+	  }
+	}
+
+	if( interlace && h0->height % 2 != 0 ) {
+		WERROR("Input images have odd number of lines - can't treats as interlaced!" );
+		return NULL;
+	}
+
+	h = (YfTask_t *)
+	  YfAllocateTask(param_skip ? &yuvmedianfilter_ordered : &yuvmedianfilter,
+			 sizeof *h, h0);
+	if (!h)
+		return NULL;
+	h->threshold_luma = threshold_luma;
+	h->threshold_chroma = threshold_chroma;
+	h->radius_luma = radius_luma;
+	h->radius_chroma = radius_chroma;
+	h->interlace = interlace;
+	h->skip = param_skip;
+	h->fast = param_fast;
+	h->weight_type = param_weight_type;
+	h->weight = param_weight;
+	h->cutoff = cutoff;
+	h->ss_h = CWDIV(y4m_si_get_chroma(&h0->si));
+	h->ss_v = CHDIV(y4m_si_get_chroma(&h0->si));
+	h->deep = y4m_si_get_sample_size(&h0->si) > 1;
+	h->shift = y4m_si_get_bitdepth(&h0->si) - 8;
+
+	/* As many bands as YUVMEDIANFILTER_BANDS says, or else, unless
+	   frames are filtered in parallel already, as threads; but none
+	   thinner than MINBANDROWS rows of a luma field. */
+#ifdef HAVE_PTHREAD
+	if ((p = getenv("YUVMEDIANFILTER_BANDS")))
+		threads = atoi(p);
+	else if (h->_.method->flags & YF_STATELESS)
+		threads = 1;
+	else if ((p = getenv("YUVFILTERS_THREADS")))
+		threads = atoi(p);
+	else
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	threads = 1;
+#endif
+	rows = (interlace ? h0->height / 2 : h0->height) / MINBANDROWS;
+	if (threads > rows)
+		threads = rows;
+	if (threads > MAXBANDS)
+		threads = MAXBANDS;
+	h->nbands = (threads > 1) ? threads : 1;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&h->lock, NULL);
+	pthread_cond_init(&h->queued, NULL);
+	pthread_cond_init(&h->done, NULL);
+	/* the thread filtering a frame does one of its bands */
+	for (h->nthreads = 0; h->nthreads < h->nbands - 1; h->nthreads++)
+		if (pthread_create(&h->threads[h->nthreads], NULL, band_thread, h)) {
+			mjpeg_warn("Only %d of %d band threads started",
+				   h->nthreads, h->nbands - 1);
+			break;
+		}
+#endif
+
+	mjpeg_debug("chroma subsampling: %dH %dV\n",h->ss_h,h->ss_v);
+	mjpeg_debug("width=%d height=%d luma_r=%d chroma_r=%d luma_t=%d chroma_t=%d", h0->width, h0->height, radius_luma, radius_chroma, threshold_luma, threshold_chroma);
+	mjpeg_debug("%d band(s)", h->nbands);
+
+	return (YfTaskCore_t *)h;
+}
+
+static void
+do_fini(YfTaskCore_t *handle)
+{
+	YfTask_t *h = (YfTask_t *)handle;
+	unsigned long avg_replace[NUMAVG];
+	unsigned int frames = (unsigned int)h->skipped;
+	long long avg, total;
+	Work_t	*w;
+	int	i, j;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&h->lock);
+	h->quit = 1;
+	pthread_cond_broadcast(&h->queued);
+	pthread_mutex_unlock(&h->lock);
+	for (i = 0; i < h->nthreads; i++)
+		pthread_join(h->threads[i], NULL);
+#endif
+
+	memset(avg_replace, 0, sizeof avg_replace);
+	while ((w = h->works)) {
+		h->works = w->all;
+		frames += w->frames;
+		for (j=0; j < h->nbands; j++) {
+			for (i=0; i < NUMAVG; i++)
+				avg_replace[i] += w->bands[j].avg_replace[i];
+			free(w->bands[j].colhist);
+			free(w->bands[j].colsum);
+			free(w->bands[j].colsum_deep);
+		}
+		YfFiniFrame(&w->frame);
+		free(w);
+	}
+
+	for (total=0, avg=0, i=0; i < NUMAVG; i++) {
+		total += avg_replace[i];
+		avg   += avg_replace[i] * i;
+	}
+	mjpeg_info("frames=%u avg=%3.1f", frames, ((double)avg)/((double)total));
+
+	for (i=0; i < NUMAVG; i++) {
+		mjpeg_debug( "%02d: %6.2f", i,
+			(((double)avg_replace[i]) * 100.0)/(double)(total));
+	}
+
+#ifdef HAVE_PTHREAD
+	pthread_cond_destroy(&h->done);
+	pthread_cond_destroy(&h->queued);
+	pthread_mutex_destroy(&h->lock);
+#endif
+	YfFreeTask(handle);
+}
+
+/* A work area for a frame: an idle one, or a new one. */
+static Work_t *
+get_work(YfTask_t *h)
+{
+	Work_t	*w;
+	int	i, radius;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&h->lock);
+#endif
+	if ((w = h->idle))
+		h->idle = w->next;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&h->lock);
+#endif
+	if (w)
+		return w;
+
+	if (!(w = malloc(sizeof *w + SIDATABYTES(&h->_.si, h->_.width, h->_.height)))) {
+		perror("malloc");
+		return NULL;
+	}
+	memset(w, 0, sizeof *w);
+	radius = (h->radius_luma > h->radius_chroma) ? h->radius_luma : h->radius_chroma;
+	for (i = 0; i < h->nbands; i++) {
+		Band_t *b = &w->bands[i];
+		if (h->fast && h->deep)
+			b->colsum_deep = malloc(h->_.width * sizeof *b->colsum_deep);
+		else if (h->fast)
+			b->colsum = malloc(h->_.width * sizeof *b->colsum);
+		else if (radius > DIRECTRADIUS && !h->deep)
+			b->colhist = malloc((STRIPE + 2 * radius) * 256);
+		else
+			continue;
+		if (!b->colsum && !b->colhist && !b->colsum_deep) {
+			perror("malloc");
+			while (i-- > 0) {
+				free(w->bands[i].colhist);
+				free(w->bands[i].colsum);
+				free(w->bands[i].colsum_deep);
+			}
+			free(w);
+			return NULL;
+		}
+	}
+	YfInitFrame(&w->frame, &h->_);
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&h->lock);
+#endif
+	w->all = h->works;
+	h->works = w;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&h->lock);
+#endif
+	return w;
+}
+
+static void
+put_work(YfTask_t *h, Work_t *w)
+{
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&h->lock);
+#endif
+	w->next = h->idle;
+	h->idle = w;
+#ifdef HAVE_PTHREAD
+	pthread_mutex_unlock(&h->lock);
+#endif
+}
+
+static int
+do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0)
+{
+	YfTask_t *h = (YfTask_t *)handle;
+	Work_t	*w;
+	uint8_t	*input[3];
+	uint8_t	*output[3];
+	int	size = y4m_si_get_sample_size(&h->_.si);
+	int	ylen = h->_.width * h->_.height * size;
+	int	uvlen = (h->_.width / h->ss_h) * (h->_.height / h->ss_v) * size;
+	int	ret;
+
+	if (!frame0)
+		return 0;
+	/* only the ordered class has a skip */
+	if (h->skipped < h->skip) {
+		h->skipped++;
+		return YfPutFrame(&h->_, frame0);
+	}
+	if (!(w = get_work(h)))
+		return Y4M_ERR_SYSTEM;
+
+	input[0] = (uint8_t *)frame0->data;
+	input[1] = input[0] + ylen;
+	input[2] = input[1] + uvlen;
+	output[0] = w->frame.data;
+	output[1] = output[0] + ylen;
+	output[2] = output[1] + uvlen;
+	filter(h, w, input, output);
+	w->frames++;
+	y4m_copy_frame_info(&w->frame.fi, &frame0->fi);
+	/* the frame is copied or passed on before YfPutFrame() returns */
+	ret = YfPutFrame(&h->_, &w->frame);
+	put_work(h, w);
+	return ret;
+}
+
+#ifdef HAVE_PTHREAD
+/* lock held; filter a waiting band, and tell if it was a frame's last */
+static void
+run_job(YfTask_t *h)
+{
+	BandJob_t *job = h->jobs;
+
+	h->jobs = job->next;
+	pthread_mutex_unlock(&h->lock);
+	filter_band(h, job->w, job->band);
+	pthread_mutex_lock(&h->lock);
+	if (--job->w->bands_left == 0)
+		pthread_cond_broadcast(&h->done);
+}
+
+/* Band threads live as long as the task, and filter the bands queued by
+   the threads filtering frames. */
+static void *
+band_thread(void *arg)
+{
+	YfTask_t *h = arg;
+
+	pthread_mutex_lock(&h->lock);
+	for (;;) {
+		while (!h->jobs && !h->quit)
+			pthread_cond_wait(&h->queued, &h->lock);
+		if (!h->jobs)
+			break;
+		run_job(h);
+	}
+	pthread_mutex_unlock(&h->lock);
+	return NULL;
+}
+#endif
+
+static void
+filter(YfTask_t *h, Work_t *w, uint8_t * const input[], uint8_t *output[])
+{
+#ifdef HAVE_PTHREAD
+	int	i;
+#endif
+
+	w->input = input;
+	w->output = output;
+#ifdef HAVE_PTHREAD
+	if (h->nbands > 1) {
+		pthread_mutex_lock(&h->lock);
+		w->bands_left = h->nbands - 1;
+		for (i = 1; i < h->nbands; i++) {
+			w->jobs[i].w = w;
+			w->jobs[i].band = i;
+			w->jobs[i].next = h->jobs;
+			h->jobs = &w->jobs[i];
+		}
+		pthread_cond_broadcast(&h->queued);
+		pthread_mutex_unlock(&h->lock);
+
+		filter_band(h, w, 0);
+
+		/* lend a hand with the bands not taken yet, then wait for
+		   the others */
+		pthread_mutex_lock(&h->lock);
+		while (w->bands_left > 0) {
+			if (h->jobs)
+				run_job(h);
+			else
+				pthread_cond_wait(&h->done, &h->lock);
+		}
+		pthread_mutex_unlock(&h->lock);
+		return;
+	}
+#endif
+	filter_band(h, w, 0);
+}
+
+static void
+filter_band(YfTask_t *h, Work_t *w, int band)
+{
+	Band_t	*b = &w->bands[band];
+	int	fields = h->interlace ? 2 : 1;
+	int	plane, field, width, height, radius, threshold;
+
+	for (plane = 0; plane < 3; plane++) {
+		if (plane == 0) {
+			width = h->_.width;
+			height = h->_.height / fields;
+			radius = h->radius_luma;
+			threshold = h->threshold_luma;
+		} else {
+			width = h->_.width / h->ss_h;
+			height = (h->_.height / h->ss_v) / fields;
+			radius = h->radius_chroma;
+			threshold = h->threshold_chroma;
+		}
+		/* the fields of interlaced material are filtered separately */
+		for (field = 0; field < fields; field++) {
+			if (h->deep)
+				(h->fast ? filter_rows_fast_deep : filter_rows_deep)
+					(h, b, width, height, width * fields,
+					 radius, threshold << h->shift,
+					 (const uint16_t *)w->input[plane] + field * width,
+					 (uint16_t *)w->output[plane] + field * width,
+					 height * band / h->nbands,
+					 height * (band + 1) / h->nbands);
+			else
+				(h->fast ? filter_rows_fast : filter_rows)
+					(h, b, width, height, width * fields,
+					 radius, threshold,
+					 w->input[plane] + field * width,
+					 w->output[plane] + field * width,
+					 height * band / h->nbands,
+					 height * (band + 1) / h->nbands);
+		}
+	}
+}
+
+/* Copy the rows [first, last) that are too close to the top or the
+   bottom to be filtered, and return the first and last row that are
+   not, in *y0 and *y1.  Sizes are in samples of 'size' bytes. */
+static void
+copy_border_rows(int width, int height, int stride, int radius, int size,
+		 const uint8_t *input, uint8_t *output, int first, int last,
+		 int *y0, int *y1)
+{
+	int	y;
+
+	*y0 = (first > radius) ? first : radius;
+	*y1 = (last < height - radius) ? last : height - radius;
+	if (width <= 2 * radius || *y0 >= *y1)
+		*y0 = *y1 = last;
+	for (y = first; y < last; y++)
+		if (y < *y0 || y >= *y1)
+			memcpy(&output[y * stride * size], &input[y * stride * size],
+			       width * size);
+}
+
+/* Copy the columns of a row that are too close to the left or the
+   right to be filtered. */
+static inline void
+copy_border_columns(int width, int radius, int size, const uint8_t *refpix, uint8_t *outpix)
+{
+	memcpy(outpix, refpix, radius * size);
+	memcpy(outpix + (width - radius) * size, refpix + (width - radius) * size,
+	       radius * size);
+}
+
+/* Replace a pixel with the mean of the 'count' values around it that
+   are within the threshold, 'total' being the sum of their
+   differences to it; or, with too few of those, with a weighted mean
+   of its neighbours. */
+static inline void tally(YfTask_t *h,Band_t *b,uint8_t *outpix,const uint8_t *refpix,int total,int count,int min_count,int row_stride)
+{
+    ++b->avg_replace[(count < NUMAVG) ? count : NUMAVG - 1];
+
+    /*
+     * If we don't have enough samples to make a decent
+     * pseudo-median use a simple mean
+     */
+    if (count <= min_count)
+    {
+        *outpix =  
+            ( ( (refpix[-row_stride-1] + refpix[-row_stride]) + 
+                (refpix[-row_stride+1] +  refpix[-1]) 
+                ) 
+              + 
+              ( ((refpix[0]<<3) + 8 + refpix[1]) +
+                (refpix[row_stride-1] + refpix[row_stride]) + 
+                refpix[row_stride+1]
+                  )
+                ) >> 4;
+    } else {
+        count += h->weight - 1;
+        //*outpix = (refpix[0]*count + total + count/2) / count;
+        if (count < NUMAVG)
+            *outpix = refpix[0] + ((total * divisor[count] + divoffset[count])>>DIVISORBITS);
+        else {
+            /* (total + count/2) / count, rounding towards -infinity */
+            int n = 2 * total + count, d = 2 * count;
+            *outpix = refpix[0] + ((n >= 0) ? n / d : -((d - 1 - n) / d));
+        }
+    }
+}
+
+/* bins[0..15] += add[0..15] */
+static inline void
+add_bins(uint16_t *bins, const uint8_t *add)
+{
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_loadu_si128((const __m128i *)add);
+	__m128i lo = _mm_loadu_si128((const __m128i *)bins);
+	__m128i hi = _mm_loadu_si128((const __m128i *)(bins + 8));
+	lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(a, zero));
+	hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(a, zero));
+	_mm_storeu_si128((__m128i *)bins, lo);
+	_mm_storeu_si128((__m128i *)(bins + 8), hi);
+#else
+	int	i;
+
+	for (i = 0; i < 16; i++)
+		bins[i] += add[i];
+#endif
+}
+
+/* bins[0..15] += add[0..15] - sub[0..15] */
+static inline void
+move_bins(uint16_t *bins, const uint8_t *add, const uint8_t *sub)
+{
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_loadu_si128((const __m128i *)add);
+	__m128i s = _mm_loadu_si128((const __m128i *)sub);
+	__m128i lo = _mm_loadu_si128((const __m128i *)bins);
+	__m128i hi = _mm_loadu_si128((const __m128i *)(bins + 8));
+	lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(a, zero));
+	hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(a, zero));
+	lo = _mm_sub_epi16(lo, _mm_unpacklo_epi8(s, zero));
+	hi = _mm_sub_epi16(hi, _mm_unpackhi_epi8(s, zero));
+	_mm_storeu_si128((__m128i *)bins, lo);
+	_mm_storeu_si128((__m128i *)(bins + 8), hi);
+#else
+	int	i;
+
+	for (i = 0; i < 16; i++)
+		bins[i] += add[i] - sub[i];
+#endif
+}
+
+/* Bring bins 16*k ... 16*k+15 of the window's histogram 'hist' from
+   the window around column lastx[k], where they were last used, to
+   the one around column x (both counted from the stripe's first
+   column).  Each column moved adds one column's bins
+   and subtracts another's; from further away than the radius, adding
+   up the window's columns from scratch is cheaper.  Either way the
+   bins move along a row only once, so the time per pixel does not
+   depend on the radius. */
+static inline void
+update_bins(uint16_t *hist, const uint8_t *colhist, int k, int x,
+	    int *lastx, int radius)
+{
+	uint16_t *bins = hist + 16 * k;
+	int	c;
+
+	if (x - lastx[k] > radius) {
+		memset(bins, 0, 16 * sizeof *bins);
+		for (c = x - radius; c <= x + radius; c++)
+			add_bins(bins, colhist + 256 * c + 16 * k);
+	} else {
+		for (c = lastx[k] + 1; c <= x; c++)
+			move_bins(bins, colhist + 256 * (c + radius) + 16 * k,
+				  colhist + 256 * (c - radius - 1) + 16 * k);
+	}
+	lastx[k] = x;
+}
+
+/* The thresholded mean of the pixels of a row, from the values around
+   each of them, looked at one by one, 16 pixels at a time.  For small
+   radii this is cheaper than keeping histograms. */
+static void
+filter_row_direct(YfTask_t *h, Band_t *b, int width, int row_stride,
+		  int radius, int threshold, int min_count,
+		  const uint8_t *refpix, uint8_t *outpix)
+{
+	int	radius_count = radius + radius + 1;
+	int	x = radius, a, i, j, d, count, total;
+	const uint8_t *pixel;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i limit = _mm_set1_epi8((char)((threshold > 255) ? 255 : threshold - 1));
+	uint8_t counts[16];
+	uint16_t sums[16];
+
+	for (; x + 16 <= width - radius; x += 16)
+	{
+		__m128i ref = _mm_loadu_si128((const __m128i *)&refpix[x]);
+		__m128i cnt = zero, sumlo = zero, sumhi = zero;
+
+		pixel = &refpix[x - radius - radius * row_stride];
+		for (j = 0; j < radius_count; j++, pixel += row_stride)
+			for (i = 0; i < radius_count; i++) {
+				__m128i p = _mm_loadu_si128((const __m128i *)&pixel[i]);
+				/* |p - ref| <= threshold - 1 ? 0xff : 0 */
+				__m128i diff = _mm_or_si128(_mm_subs_epu8(p, ref),
+							    _mm_subs_epu8(ref, p));
+				__m128i in = _mm_cmpeq_epi8(_mm_min_epu8(diff, limit), diff);
+				cnt = _mm_sub_epi8(cnt, in);
+				p = _mm_and_si128(p, in);
+				sumlo = _mm_add_epi16(sumlo, _mm_unpacklo_epi8(p, zero));
+				sumhi = _mm_add_epi16(sumhi, _mm_unpackhi_epi8(p, zero));
+			}
+		_mm_storeu_si128((__m128i *)counts, cnt);
+		_mm_storeu_si128((__m128i *)sums, sumlo);
+		_mm_storeu_si128((__m128i *)&sums[8], sumhi);
+		for (i = 0; i < 16; i++)
+			tally(h, b, &outpix[x + i], &refpix[x + i],
+			      sums[i] - refpix[x + i] * counts[i], counts[i],
+			      min_count, row_stride);
+	}
+#endif
+	for (; x < width - radius; x++)
+	{
+		count = 0;
+		total = 0;
+		pixel = &refpix[x - radius - radius * row_stride];
+		for (j = 0; j < radius_count; j++, pixel += row_stride)
+			for (a = 0; a < radius_count; a++) {
+				d = pixel[a] - refpix[x];
+				if (d < threshold && d > -threshold) {
+					total += d;
+					count++;
+				}
+			}
+		tally(h, b, &outpix[x], &refpix[x], total, count, min_count, row_stride);
+	}
+}
+
+/* The thresholded mean of the pixels sx ... ex-1 of a row, from the
+   histograms of the columns of their windows; b->colhist starts with
+   column cx. */
+static void
+filter_row_hist(YfTask_t *h, Band_t *b, int cx, int sx, int ex,
+		int row_stride, int radius, int threshold, int min_count,
+		const uint8_t *refpix, uint8_t *outpix)
+{
+	uint16_t hist[256];
+	int	lastx[16];
+	int	x, k, v, lo, hi, count, total;
+
+	/* None of the window's bins are up to date yet. */
+	for (k = 0; k < 16; k++)
+		lastx[k] = -2 * radius - 2;
+
+	for (x = sx; x < ex; x++)
+	{
+		/* Count and add up the values within the threshold, i.e.
+		   those in the bins from refpix[x] - threshold + 1 to
+		   refpix[x] + threshold - 1. */
+		lo = refpix[x] - threshold + 1;
+		hi = refpix[x] + threshold - 1;
+		if (lo < 0)
+			lo = 0;
+		if (hi > 255)
+			hi = 255;
+		for (k = lo >> 4; k <= hi >> 4; k++)
+			if (lastx[k] != x)
+				update_bins(hist, b->colhist, k, x - cx, lastx,
+					    radius);
+		count = 0;
+		total = 0;
+		for (v = lo; v <= hi; v++) {
+			count += hist[v];
+			total += hist[v] * v;
+		}
+		total -= refpix[x] * count;
+		tally(h, b, &outpix[x], &refpix[x], total, count, min_count, row_stride);
+	}
+}
+
+/* The thresholded mean of the rows [first, last) of a plane. */
+static void
+filter_rows(YfTask_t *h, Band_t *b, int width, int height, int row_stride,
+	    int radius, int threshold, const uint8_t *input, uint8_t *output,
+	    int first, int last)
+{
+	uint8_t	*colhist = b->colhist;
+	const uint8_t *oldrow, *newrow;
+	int	radius_count, min_count;
+	int	x, y, y0, y1, cx, sx, ex, ncols;
+
+	if (threshold == 0)
+	   {
+	   for (y = first; y < last; y++)
+	       memcpy(&output[y * row_stride], &input[y * row_stride], width);
+	   return;
+	   }
+
+	radius_count = radius + radius + 1;
+	min_count = ceil((radius_count * radius_count) * h->cutoff);
+
+	copy_border_rows(width, height, row_stride, radius, 1, input, output,
+			 first, last, &y0, &y1);
+	if (y0 >= y1)
+		return;
+
+	if (radius <= DIRECTRADIUS) {
+		for (y = y0; y < y1; y++) {
+			copy_border_columns(width, radius, 1, &input[y * row_stride],
+					    &output[y * row_stride]);
+			filter_row_direct(h, b, width, row_stride, radius,
+					  threshold, min_count,
+					  &input[y * row_stride],
+					  &output[y * row_stride]);
+		}
+		return;
+	}
+
+	for (y = y0; y < y1; y++)
+		copy_border_columns(width, radius, 1, &input[y * row_stride],
+				    &output[y * row_stride]);
+
+	/* A stripe of STRIPE output columns at a time, so that the
+	   histograms of the columns they need stay in the cache. */
+	for (sx = radius; sx < width - radius; sx += STRIPE)
+	{
+		ex = (sx + STRIPE < width - radius) ? sx + STRIPE : width - radius;
+		cx = sx - radius;
+		ncols = ex + radius - cx;
+
+		/* Histograms of the columns of the first row's window... */
+		memset(colhist, 0, ncols * 256);
+		for (y = y0 - radius; y <= y0 + radius; y++) {
+			newrow = &input[y * row_stride + cx];
+			for (x = 0; x < ncols; x++)
+				++colhist[256 * x + newrow[x]];
+		}
+
+		for (y = y0; y < y1; y++)
+		{
+			/* ...moved down a row for each of the others. */
+			if (y > y0) {
+				oldrow = &input[(y - radius - 1) * row_stride + cx];
+				newrow = &input[(y + radius) * row_stride + cx];
+				for (x = 0; x < ncols; x++) {
+					--colhist[256 * x + oldrow[x]];
+					++colhist[256 * x + newrow[x]];
+				}
+			}
+			filter_row_hist(h, b, cx, sx, ex, row_stride, radius,
+					threshold, min_count,
+					&input[y * row_stride],
+					&output[y * row_stride]);
+		}
+	}
+}
+
+/* colsum[0..width-1] += add[0..width-1] - sub[0..width-1] */
+static void
+move_colsum(uint16_t *colsum, const uint8_t *add, const uint8_t *sub, int width)
+{
+	int	x = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(add + x));
+		__m128i s = _mm_loadu_si128((const __m128i *)(sub + x));
+		__m128i lo = _mm_loadu_si128((const __m128i *)(colsum + x));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(colsum + x + 8));
+		lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(a, zero));
+		hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(a, zero));
+		lo = _mm_sub_epi16(lo, _mm_unpacklo_epi8(s, zero));
+		hi = _mm_sub_epi16(hi, _mm_unpackhi_epi8(s, zero));
+		_mm_storeu_si128((__m128i *)(colsum + x), lo);
+		_mm_storeu_si128((__m128i *)(colsum + x + 8), hi);
+	}
+#endif
+	for (; x < width; x++)
+		colsum[x] += add[x] - sub[x];
+}
+
+/* The simple weighted mean of the rows [first, last) of a plane, from
+   running sums of the window's columns and rows. */
+static void
+filter_rows_fast(YfTask_t *h, Band_t *b, int width, int height, int row_stride,
+		 int radius, int threshold, const uint8_t *input, uint8_t *output,
+		 int first, int last)
+{
+	uint16_t *colsum = b->colsum;
+	const uint8_t *refpix;
+	uint8_t *outpix;
+	int	radius_count, count, fasttype, stat;
+	int	x, y, y0, y1, sum, total, c;
+
+	/* If no filtering should be done, just copy data and leave. */
+	if (threshold == 0)
+	   {
+	   for (y = first; y < last; y++)
+	       memcpy(&output[y * row_stride], &input[y * row_stride], width);
+	   return;
+	   }
+
+	/* Calculate the number of pixels from one extreme of the radius
+	   to the other extreme, and the number of them around the
+	   current one. */
+	radius_count = radius + radius + 1;
+	count = radius_count * radius_count - 1;
+
+	/* Figure out which optimized filtering algorithm to use, if any. */
+	if (radius == 1 && h->weight_type == 2)
+		fasttype = 1;
+	else if (radius == 1 && h->weight_type == 1)
+		fasttype = 2;
+	else if (radius == 2 && h->weight_type == 1)
+		fasttype = 3;
+	else if (radius == 1 && h->weight_type == 3)
+		fasttype = 4;
+	else if (radius == 1 && h->weight_type == 4)
+		fasttype = 5;
+	else
+		fasttype = 0;
+	stat = (fasttype == 0 && count < NUMAVG) ? count
+		: (fasttype == 3) ? 25 : (fasttype == 0) ? NUMAVG - 1 : 9;
+
+	/* Copy the top and bottom rows and leftmost/rightmost columns of
+	   the picture, without filtering. */
+	copy_border_rows(width, height, row_stride, radius, 1, input, output,
+			 first, last, &y0, &y1);
+	if (y0 >= y1)
+		return;
+
+	/* Sums of the columns of the first row's window, moved down a
+	   row for each of the others. */
+	memset(colsum, 0, width * sizeof *colsum);
+	for (y = y0 - radius; y <= y0 + radius; y++)
+		for (x = 0; x < width; x++)
+			colsum[x] += input[y * row_stride + x];
+
+	for (y = y0; y < y1; y++)
+	{
+		if (y > y0)
+			move_colsum(colsum, &input[(y + radius) * row_stride],
+				    &input[(y - radius - 1) * row_stride], width);
+
+		refpix = &input[y * row_stride];
+		outpix = &output[y * row_stride];
+		copy_border_columns(width, radius, 1, refpix, outpix);
+		b->avg_replace[stat] += width - radius - radius;
+
+		/* The sum of the window, moved right a column at a time. */
+		for (sum = 0, x = 0; x < radius_count; x++)
+			sum += colsum[x];
+
+		/* Use a simple mean, but process certain combinations of
+		   radius/weight pairs more efficiently.  Note that adding
+		   half the pixel count to the pixel value accomplishes
+		   rounding the pixel value to the nearest whole value. */
+		for (x = radius; ; )
+		{
+			c = refpix[x];
+			total = sum - c;
+			switch (fasttype)
+			{
+			case 1:
+				/* Radius 1, weight 2.667.  The 8 pixels surrounding
+				   the current one have a weight of 3, the current
+				   pixel has a weight of 8, for a total weight of
+				   8*3+8 = 32. */
+				outpix[x] = (3 * total + (c << 3) + 16) >> 5;
+				break;
+			case 2:
+				/* Radius 1, weight 8.  The 8 pixels surrounding the
+				   current one have a weight of 1, the current pixel has
+				   a weight of 8, for a total weight of 8*1+8 = 16. */
+				outpix[x] = (total + (c << 3) + 8) >> 4;
+				break;
+			case 3:
+				/* Radius 2, weight 8.  The 24 pixels surrounding the
+				   current one have a weight of 1, the current pixel
+				   has a weight of 8, for a total weight of
+				   24*1+8 = 32. */
+				outpix[x] = (total + (c << 3) + 16) >> 5;
+				break;
+			case 4:
+				/* Radius 1, weight 13.333.  The 8 pixels surrounding
+				   the current one have a weight of 3, the current
+				   pixel has a weight of 40, for a total weight of
+				   8*3+40 = 64. */
+				outpix[x] = (3 * total + c * 40 + 32) >> 6;
+				break;
+			case 5:
+				/* Radius 1, weight 24.  The 8 pixels surrounding the
+				   current one have a weight of 1, the current pixel has
+				   a weight of 24, for a total weight of 8*1+24 = 32. */
+				outpix[x] = (total + c * 24 + 16) >> 5;
+				break;
+			default:
+				outpix[x] = (total + (c * h->weight)
+					+ (count >> 1)) / (count + h->weight);
+				break;
+			}
+			if (++x >= width - radius)
+				break;
+			sum += colsum[x + radius] - colsum[x - radius - 1];
+		}
+	}
+}
+
+/* tally(), for a deep sample, whose differences may add up to more
+   than an int holds */
+static inline void tally_deep(YfTask_t *h,Band_t *b,uint16_t *outpix,const uint16_t *refpix,int64_t total,int count,int min_count,int row_stride)
+{
+    int v;
+
+    ++b->avg_replace[(count < NUMAVG) ? count : NUMAVG - 1];
+
+    if (count <= min_count)
+    {
+        v = ( ( (LE16(refpix[-row_stride-1]) + LE16(refpix[-row_stride])) +
+                (LE16(refpix[-row_stride+1]) + LE16(refpix[-1]))
+                )
+              +
+              ( ((LE16(refpix[0])<<3) + 8 + LE16(refpix[1])) +
+                (LE16(refpix[row_stride-1]) + LE16(refpix[row_stride])) +
+                LE16(refpix[row_stride+1])
+                  )
+                ) >> 4;
+    } else {
+        count += h->weight - 1;
+        if (count < NUMAVG)
+            v = LE16(refpix[0]) + (int)((total * divisor[count] + divoffset[count])>>DIVISORBITS);
+        else {
+            int64_t n = 2 * total + count, d = 2 * count;
+            v = LE16(refpix[0]) + (int)((n >= 0) ? n / d : -((d - 1 - n) / d));
+        }
+    }
+    *outpix = LE16((uint16_t)v);
+}
+
+/* filter_row_direct(), for deep samples, 8 pixels at a time */
+static void
+filter_row_direct_deep(YfTask_t *h, Band_t *b, int width, int row_stride,
+		       int radius, int threshold, int min_count,
+		       const uint16_t *refpix, uint16_t *outpix)
+{
+	int	radius_count = radius + radius + 1;
+	int	x = radius, a, i, j, d, count;
+	int64_t	total;
+	const uint16_t *pixel;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i bias = _mm_set1_epi16((short)0x8000);
+	/* threshold - 1, biased for a signed comparison */
+	const __m128i limit = _mm_set1_epi16((short)(((threshold > 65536) ? 65535 : threshold - 1) ^ 0x8000));
+	const __m128i all = _mm_set1_epi16((short)(radius_count * radius_count));
+	uint16_t counts[8];
+	uint32_t sums[8];
+
+	for (; x + 8 <= width - radius; x += 8)
+	{
+		__m128i ref = _mm_loadu_si128((const __m128i *)&refpix[x]);
+		__m128i cnt = all, sumlo = zero, sumhi = zero;
+
+		pixel = &refpix[x - radius - radius * row_stride];
+		for (j = 0; j < radius_count; j++, pixel += row_stride)
+			for (i = 0; i < radius_count; i++) {
+				__m128i p = _mm_loadu_si128((const __m128i *)&pixel[i]);
+				/* |p - ref| > threshold - 1 ? 0xffff : 0 */
+				__m128i diff = _mm_or_si128(_mm_subs_epu16(p, ref),
+							    _mm_subs_epu16(ref, p));
+				__m128i out = _mm_cmpgt_epi16(_mm_xor_si128(diff, bias), limit);
+				cnt = _mm_add_epi16(cnt, out);
+				p = _mm_andnot_si128(out, p);
+				sumlo = _mm_add_epi32(sumlo, _mm_unpacklo_epi16(p, zero));
+				sumhi = _mm_add_epi32(sumhi, _mm_unpackhi_epi16(p, zero));
+			}
+		_mm_storeu_si128((__m128i *)counts, cnt);
+		_mm_storeu_si128((__m128i *)sums, sumlo);
+		_mm_storeu_si128((__m128i *)&sums[4], sumhi);
+		for (i = 0; i < 8; i++)
+			tally_deep(h, b, &outpix[x + i], &refpix[x + i],
+				   (int64_t)sums[i] - (int64_t)refpix[x + i] * counts[i],
+				   counts[i], min_count, row_stride);
+	}
+#endif
+	for (; x < width - radius; x++)
+	{
+		count = 0;
+		total = 0;
+		pixel = &refpix[x - radius - radius * row_stride];
+		for (j = 0; j < radius_count; j++, pixel += row_stride)
+			for (a = 0; a < radius_count; a++) {
+				d = LE16(pixel[a]) - LE16(refpix[x]);
+				if (d < threshold && d > -threshold) {
+					total += d;
+					count++;
+				}
+			}
+		tally_deep(h, b, &outpix[x], &refpix[x], total, count, min_count, row_stride);
+	}
+}
+
+/* filter_rows(), for deep samples: every radius is looked at directly */
+static void
+filter_rows_deep(YfTask_t *h, Band_t *b, int width, int height, int row_stride,
+		 int radius, int threshold, const uint16_t *input, uint16_t *output,
+		 int first, int last)
+{
+	int	radius_count, min_count;
+	int	y, y0, y1;
+
+	if (threshold == 0)
+	   {
+	   for (y = first; y < last; y++)
+	       memcpy(&output[y * row_stride], &input[y * row_stride], width * 2);
+	   return;
+	   }
+
+	radius_count = radius + radius + 1;
+	min_count = ceil((radius_count * radius_count) * h->cutoff);
+
+	copy_border_rows(width, height, row_stride, radius, 2,
+			 (const uint8_t *)input, (uint8_t *)output,
+			 first, last, &y0, &y1);
+	for (y = y0; y < y1; y++) {
+		copy_border_columns(width, radius, 2,
+				    (const uint8_t *)&input[y * row_stride],
+				    (uint8_t *)&output[y * row_stride]);
+		filter_row_direct_deep(h, b, width, row_stride, radius,
+				       threshold, min_count,
+				       &input[y * row_stride],
+				       &output[y * row_stride]);
+	}
+}
+
+/* colsum[0..width-1] += add[0..width-1] - sub[0..width-1], for deep
+   samples */
+static void
+move_colsum_deep(uint32_t *colsum, const uint16_t *add, const uint16_t *sub, int width)
+{
+	int	x = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; x + 8 <= width; x += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(add + x));
+		__m128i s = _mm_loadu_si128((const __m128i *)(sub + x));
+		__m128i lo = _mm_loadu_si128((const __m128i *)(colsum + x));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(colsum + x + 4));
+		lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(a, zero));
+		hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(a, zero));
+		lo = _mm_sub_epi32(lo, _mm_unpacklo_epi16(s, zero));
+		hi = _mm_sub_epi32(hi, _mm_unpackhi_epi16(s, zero));
+		_mm_storeu_si128((__m128i *)(colsum + x), lo);
+		_mm_storeu_si128((__m128i *)(colsum + x + 4), hi);
+	}
+#endif
+	for (; x < width; x++)
+		colsum[x] += LE16(add[x]) - LE16(sub[x]);
+}
+
+/* filter_rows_fast(), for deep samples */
+static void
+filter_rows_fast_deep(YfTask_t *h, Band_t *b, int width, int height, int row_stride,
+		      int radius, int threshold, const uint16_t *input, uint16_t *output,
+		      int first, int last)
+{
+	uint32_t *colsum = b->colsum_deep;
+	const uint16_t *refpix;
+	uint16_t *outpix;
+	int	radius_count, count, fasttype, stat;
+	int	x, y, y0, y1, c;
+	int64_t	sum, total;
+
+	if (threshold == 0)
+	   {
+	   for (y = first; y < last; y++)
+	       memcpy(&output[y * row_stride], &input[y * row_stride], width * 2);
+	   return;
+	   }
+
+	radius_count = radius + radius + 1;
+	count = radius_count * radius_count - 1;
+
+	if (radius == 1 && h->weight_type == 2)
+		fasttype = 1;
+	else if (radius == 1 && h->weight_type == 1)
+		fasttype = 2;
+	else if (radius == 2 && h->weight_type == 1)
+		fasttype = 3;
+	else if (radius == 1 && h->weight_type == 3)
+		fasttype = 4;
+	else if (radius == 1 && h->weight_type == 4)
+		fasttype = 5;
+	else
+		fasttype = 0;
+	stat = (fasttype == 0 && count < NUMAVG) ? count
+		: (fasttype == 3) ? 25 : (fasttype == 0) ? NUMAVG - 1 : 9;
+
+	copy_border_rows(width, height, row_stride, radius, 2,
+			 (const uint8_t *)input, (uint8_t *)output,
+			 first, last, &y0, &y1);
+	if (y0 >= y1)
+		return;
+
+	memset(colsum, 0, width * sizeof *colsum);
+	for (y = y0 - radius; y <= y0 + radius; y++)
+		for (x = 0; x < width; x++)
+			colsum[x] += LE16(input[y * row_stride + x]);
+
+	for (y = y0; y < y1; y++)
+	{
+		if (y > y0)
+			move_colsum_deep(colsum, &input[(y + radius) * row_stride],
+					 &input[(y - radius - 1) * row_stride], width);
+
+		refpix = &input[y * row_stride];
+		outpix = &output[y * row_stride];
+		copy_border_columns(width, radius, 2, (const uint8_t *)refpix,
+				    (uint8_t *)outpix);
+		b->avg_replace[stat] += width - radius - radius;
+
+		for (sum = 0, x = 0; x < radius_count; x++)
+			sum += colsum[x];
+
+		/* the weights of filter_rows_fast() */
+		for (x = radius; ; )
+		{
+			c = LE16(refpix[x]);
+			total = sum - c;
+			switch (fasttype)
+			{
+			case 1:
+				c = (3 * total + (c << 3) + 16) >> 5;
+				break;
+			case 2:
+				c = (total + (c << 3) + 8) >> 4;
+				break;
+			case 3:
+				c = (total + (c << 3) + 16) >> 5;
+				break;
+			case 4:
+				c = (3 * total + c * 40 + 32) >> 6;
+				break;
+			case 5:
+				c = (total + c * 24 + 16) >> 5;
+				break;
+			default:
+				c = (total + (c * h->weight)
+				     + (count >> 1)) / (count + h->weight);
+				break;
+			}
+			outpix[x] = LE16((uint16_t)c);
+			if (++x >= width - radius)
+				break;
+			sum += (int64_t)colsum[x + radius] - colsum[x - radius - 1];
+		}
+	}
+}
@@ -0,0 +1,124 @@
+/*
+ *  yuvscaler as a task, for y4mchain: the scaler of yuvscaler/yuvscaler.c
+ *  with the options of yuvscaler(1), except -v and -h, and -M NO_HEADER
+ *  which has no use inside a chain.  Its state is global, so a chain may
+ *  have only one yuvscaler.  Only 4:2:0 streams are scaled; samples of
+ *  more than 8 bits (YF_DEEP) are scaled at their depth.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "yuvfilters.h"
+#include "yuvscaler.h"
+
+typedef struct {
+  YfTaskCore_t _;
+  int inlen, outlen;
+  YfFrame_t frame;
+} YfTask_t;
+
+static int running;
+
+DEFINE_FLAGGED_YFTASKCLASS(yuvscaler, YF_DEEP);
+
+static const char *
+do_usage(void)
+{
+  return "[-I input_keyword] [-M mode_keyword] [-O output_keyword] [-n p|s|n]";
+}
+
+static YfTaskCore_t *
+do_init(int argc, char **argv, const YfTaskCore_t *h0)
+{
+  YfTask_t *h;
+  y4m_stream_info_t si;
+  int c, chroma = y4m_si_get_chroma(&h0->si);
+
+  /* yuvscaler's own parsing exits on -h and -v sets its verbosity, so
+     look at the options first */
+  while ((c = getopt(argc, argv, "k:I:d:n:M:m:O:wtg")) != -1) {
+    switch (c) {
+    case 'M':
+      if (!strcmp(optarg, "NO_HEADER")) {
+	WERROR("-M NO_HEADER has no use in a chain");
+	return NULL;
+      }
+      break;
+    case '?':
+      return NULL;
+    }
+  }
+  if (optind != argc) {
+    WERROR("yuvscaler takes no arguments");
+    return NULL;
+  }
+  if (chroma != Y4M_CHROMA_420JPEG && chroma != Y4M_CHROMA_420MPEG2 &&
+      chroma != Y4M_CHROMA_420PALDV) {
+    WERROR("only 4:2:0 streams supported");
+    return NULL;
+  }
+  if (running) {
+    WERROR("only one yuvscaler per chain");
+    return NULL;
+  }
+  optind = 1;
+  handle_args_global(argc, argv);
+  y4m_init_stream_info(&si);
+  yuvscaler_init(argc, argv, &h0->si, &si);
+  h = (YfTask_t *)
+    YfAllocateTask(&yuvscaler,
+		   sizeof *h + SIDATABYTES(&si, y4m_si_get_width(&si),
+					   y4m_si_get_height(&si)), h0);
+  if (!h) {
+    y4m_fini_stream_info(&si);
+    return NULL;
+  }
+  y4m_copy_stream_info(&h->_.si, &si);
+  y4m_fini_stream_info(&si);
+  h->_.width = y4m_si_get_width(&h->_.si);
+  h->_.height = y4m_si_get_height(&h->_.si);
+  running = 1;
+  h->inlen = SIDATABYTES(&h0->si, h0->width, h0->height);
+  h->outlen = SIDATABYTES(&h->_.si, h->_.width, h->_.height);
+  YfInitFrame(&h->frame, &h->_);
+  return (YfTaskCore_t *)h;
+}
+
+static void
+do_fini(YfTaskCore_t *handle)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+
+  running = 0;
+  YfFiniFrame(&h->frame);
+  YfFreeTask(handle);
+}
+
+static int
+do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t *frame0)
+{
+  YfTask_t *h = (YfTask_t *)handle;
+
+  if (!frame0)
+    return 0;
+  memcpy(yuvscaler_input(), frame0->data, h->inlen);
+  memcpy(h->frame.data, yuvscaler_frame(), h->outlen);
+  return YfPutFrame(&h->_, &h->frame);
+}
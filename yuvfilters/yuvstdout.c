@@ -23,7 +23,7 @@
 #include <mpegconsts.h>
 #include "yuvfilters.h"
 
-DEFINE_STD_YFTASKCLASS(yuvstdout);
+DEFINE_FLAGGED_YFTASKCLASS(yuvstdout, YF_DEEP);
 
 static const char *
 do_usage(void)
@@ -41,7 +41,9 @@ do_init(int argc, char **argv, const YfTaskCore_t *h0)
     return NULL;
   y4m_si_set_width(&h->si, h0->width);
   y4m_si_set_height(&h->si, h0->height);
-  y4m_si_set_framerate(&h->si, mpeg_framerate(h0->fpscode));
+  /* keep rates without an MPEG frame rate code unless a task changed it */
+  if (mpeg_framerate_code(y4m_si_get_framerate(&h->si)) != h0->fpscode)
+    y4m_si_set_framerate(&h->si, mpeg_framerate(h0->fpscode));
   if (y4m_write_stream_header(1, &h->si) != Y4M_OK) {
     YfFreeTask(h);
     h = NULL;
@@ -60,8 +62,9 @@ do_frame(YfTaskCore_t *handle, const YfTaskCore_t *h0, const YfFrame_t * frame0)
 {
   uint8_t * yuv[3];
   yuv[0] = (uint8_t*)frame0->data;
-  yuv[1] = yuv[0] + (handle->width * handle->height);
+  yuv[1] = yuv[0] + (handle->width * handle->height) * y4m_si_get_sample_size(&handle->si);
   yuv[2] = yuv[1] + ((handle->width  / CWDIV(y4m_si_get_chroma(&handle->si))) *
-		     (handle->height / CHDIV(y4m_si_get_chroma(&handle->si))));
+		     (handle->height / CHDIV(y4m_si_get_chroma(&handle->si)))) *
+    y4m_si_get_sample_size(&handle->si);
   return y4m_write_frame(1, &handle->si, &frame0->fi, yuv);
 }
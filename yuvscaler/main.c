@@ -0,0 +1,155 @@
+/*
+  *  main.c
+  *  Copyright (C) 2001-2004 Xavier Biquard <xbiquard@free.fr>
+  * 
+  *  
+  *  yuvscaler: reads the stream, has the frames scaled by yuvscaler.c and writes them
+  * 
+  *  This program is free software; you can redistribute it and/or modify
+  *  it under the terms of the GNU General Public License as published by
+  *  the Free Software Foundation; either version 2 of the License, or
+  *  (at your option) any later version.
+  *
+  *  This program is distributed in the hope that it will be useful,
+  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  *  GNU General Public License for more details.
+  *
+  *  You should have received a copy of the GNU General Public License
+  *  along with this program; if not, write to the Free Software
+  *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+  */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "mjpeg_logging.h"
+#include "yuv4mpeg.h"
+#include "mjpeg_types.h"
+#include "yuvscaler.h"
+
+#define yuvscaler_VERSION "11-Dec-2007"
+
+extern unsigned int input_width;
+extern unsigned int input_height;
+extern unsigned int display_width;
+extern unsigned int display_height;
+extern uint8_t no_header;
+
+// *************************************************************************************
+int
+yuvscaler_y4m_read_frame (int fd, y4m_stream_info_t *si, 
+			y4m_frame_info_t * frameinfo,
+			unsigned long int buflen, uint8_t * buf)
+{
+  // This function reads a frame from input stream. It does the same thing as the y4m_read_frame function (from yuv4mpeg.c)
+  // May be replaced directly by it in the near future
+  static int err = Y4M_OK;
+   if ((err = y4m_read_frame_header (fd, si, frameinfo)) == Y4M_OK)
+     {
+	if ((err = y4m_read (fd, buf, buflen)) != Y4M_OK)
+	  {
+	     mjpeg_info ("Couldn't read FRAME content: %s!",
+			 y4m_strerr (err));
+	     return (err);
+	  }
+     }
+   else
+     {
+	if (err != Y4M_ERR_EOF)
+	  mjpeg_info ("Couldn't read FRAME header: %s!", y4m_strerr (err));
+	else
+	  mjpeg_info ("End of stream!");
+	return (err);
+     }
+   return Y4M_OK;
+}
+
+// *************************************************************************************
+
+
+
+// *************************************************************************************
+// MAIN
+// *************************************************************************************
+int
+main (int argc, char *argv[])
+{
+  int input_fd = 0;
+  int output_fd = 1;
+  int err = Y4M_OK, verbose;
+  long int frame_num = 0;
+  const uint8_t *output;
+
+  // SPECIFIC TO YUV4MPEG 
+  unsigned long int nb_pixels, sample_size;
+  y4m_frame_info_t frameinfo;
+  y4m_stream_info_t in_streaminfo;
+  y4m_stream_info_t out_streaminfo;
+
+  // Initialisation of global variables that are independent of the input stream, input_file in particular
+  verbose = handle_args_global (argc, argv);
+
+  // Information output
+  if (verbose)
+     {
+     mjpeg_info ("yuvscaler %s %s", PACKAGE_VERSION, yuvscaler_VERSION);
+     mjpeg_info ("(C) 2001-2004 Xavier Biquard <xbiquard@free.fr>, yuvscaler -h for help, or man yuvscaler");
+     }
+
+  // mjpeg tools global initialisations
+  mjpeg_default_handler_verbosity (verbose);
+  y4m_init_stream_info (&in_streaminfo);
+  y4m_init_stream_info (&out_streaminfo);
+  y4m_init_frame_info (&frameinfo);
+  y4m_accept_extensions (2);
+
+  if (y4m_read_stream_header (input_fd, &in_streaminfo) != Y4M_OK)
+    mjpeg_error_exit1 ("Could'nt read YUV4MPEG header!");
+
+  // The rest of the initialisations, which depend on the input stream
+  yuvscaler_init (argc, argv, &in_streaminfo, &out_streaminfo);
+  sample_size = y4m_si_get_sample_size (&in_streaminfo);
+  nb_pixels = (input_width * input_height * 3) / 2;
+
+  // SCALE AND OUTPUT FRAMES 
+  // Output file header
+  if (no_header == 0)
+    y4m_write_stream_header (output_fd, &out_streaminfo);
+
+  // Master loop : continue until there is no next frame in stdin
+  while ((err = yuvscaler_y4m_read_frame
+	  (input_fd, &in_streaminfo, &frameinfo, nb_pixels * sample_size,
+	   yuvscaler_input ())) == Y4M_OK)
+    {
+      mjpeg_info ("Frame number %ld", frame_num);
+      frame_num++;
+
+      // Output Frame Header
+      if (y4m_write_frame_header (output_fd, &out_streaminfo, &frameinfo) != Y4M_OK)
+	goto out_error;
+
+      output = yuvscaler_frame ();
+      if (y4m_write (output_fd, output,
+		     (display_width * display_height * 3) / 2 * sample_size) != Y4M_OK)
+	goto out_error;
+    }
+  // End of master loop => no more frame in stdin
+
+  if (err != Y4M_ERR_EOF)
+    mjpeg_error_exit1 ("Couldn't read frame number %ld!", frame_num);
+  else
+    mjpeg_info ("Normal exit: end of stream with frame number %ld!",
+		frame_num);
+  y4m_fini_stream_info (&in_streaminfo);
+  y4m_fini_stream_info (&out_streaminfo);
+  y4m_fini_frame_info (&frameinfo);
+  return 0;
+
+out_error:
+  mjpeg_error_exit1 ("Unable to write to output - aborting!");
+  return 1;
+}
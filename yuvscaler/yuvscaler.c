@@ -43,6 +43,9 @@
 // MMX version will implement dedicated cspline_w and cspline_h pointers for MMX treatment
 // 
 // 
+// The stream handling is in main.c; yuvscaler_init () and yuvscaler_frame () are also
+// used by yuvfilters/y4mchain.
+// 
 // TODO:
 // no more global variables for librarification
 
@@ -70,13 +73,10 @@
 #include "../utils/mmx.h"
 #endif
 
-#define yuvscaler_VERSION "11-Dec-2007"
 // For pointer address alignement
 #define ALIGNEMENT 16		// 16 bytes alignement for mmx registers in SIMD instructions for Pentium
 #define MAXWIDTHNEIGHBORS 16
 
-float PI = 3.141592654;
-
 
 // For input
 unsigned int input_width;
@@ -144,6 +144,8 @@ int infile = 0;			// =0 for stdin (default) =1 for file
 int algorithm = -1;		// =0 for resample, and =1 for bicubic
 unsigned int specific = 0;	// is >0 if a specific downscaling speed enhanced treatment of data is possible
 unsigned int mono = 0;		// is =1 for monochrome output
+int bitdepth = 8;		// bits per sample, from the input stream
+unsigned int sample_size = 1;	// =2 for samples of more than 8 bits, least significant byte first
 
 // Keywords for argument passing 
 const char VCD_KEYWORD[] = "VCD";
@@ -182,7 +184,7 @@ uint8_t *divide;
 unsigned short int *u_i_p;
 unsigned int out_nb_col_slice, out_nb_line_slice;
 const static char *legal_opt_flags = "k:I:d:n:v:M:m:O:whtg";
-int verbose = 1;
+static int verbose = 1;
 #define PARAM_LINE_MAX 256
 
 uint8_t blacky = 16;
@@ -399,40 +401,35 @@ yuvscaler_calculate_output_sar (int out_w, int out_h,
 
 
 // *************************************************************************************
-int
-yuvscaler_y4m_read_frame (int fd, y4m_stream_info_t *si, 
-			y4m_frame_info_t * frameinfo,
-			unsigned long int buflen, uint8_t * buf)
+// PREPROCESSING
+// *************************************************************************************
+static uint8_t *
+put_sample (uint8_t * p, uint8_t value)
 {
-  // This function reads a frame from input stream. It does the same thing as the y4m_read_frame function (from yuv4mpeg.c)
-  // May be replaced directly by it in the near future
-  static int err = Y4M_OK;
-   if ((err = y4m_read_frame_header (fd, si, frameinfo)) == Y4M_OK)
-     {
-	if ((err = y4m_read (fd, buf, buflen)) != Y4M_OK)
-	  {
-	     mjpeg_info ("Couldn't read FRAME content: %s!",
-			 y4m_strerr (err));
-	     return (err);
-	  }
-     }
-   else
-     {
-	if (err != Y4M_ERR_EOF)
-	  mjpeg_info ("Couldn't read FRAME header: %s!", y4m_strerr (err));
-	else
-	  mjpeg_info ("End of stream!");
-	return (err);
-     }
-   return Y4M_OK;
+  // one sample of value, on the 8-bit scale, and the next one
+  if (sample_size == 1)
+    *(p++) = value;
+  else
+    {
+      *(uint16_t *) p = value << (bitdepth - 8);
+      p += 2;
+    }
+  return p;
 }
 
-// *************************************************************************************
+static void
+blacken (uint8_t * p, uint8_t value, unsigned int nb)
+{
+  // memset of nb samples, value being on the 8-bit scale
+  uint16_t *deep = (uint16_t *) p;
 
+  if (sample_size == 1)
+    memset (p, value, nb);
+  else
+    while (nb--)
+      *(deep++) = value << (bitdepth - 8);
+}
 
-// *************************************************************************************
-// PREPROCESSING
-// *************************************************************************************
 int
 blackout (uint8_t * input_y, uint8_t * input_u, uint8_t * input_v)
 {
@@ -443,59 +440,59 @@ blackout (uint8_t * input_y, uint8_t * input_u, uint8_t * input_v)
 
   for (line = 0; line < input_black_line_above; line++)
     {
-      memset (input_y, blacky, input_useful_width);
-      input_y += input_width;
+      blacken (input_y, blacky, input_useful_width);
+      input_y += input_width * sample_size;
     }
-  right = input_y + input_black_col_left + input_active_width;
+  right = input_y + (input_black_col_left + input_active_width) * sample_size;
   for (line = 0; line < input_active_height; line++)
     {
-      memset (input_y, blacky, input_black_col_left);
-      memset (right, blacky, input_black_col_right);
-      input_y += input_width;
-      right += input_width;
+      blacken (input_y, blacky, input_black_col_left);
+      blacken (right, blacky, input_black_col_right);
+      input_y += input_width * sample_size;
+      right += input_width * sample_size;
     }
   for (line = 0; line < input_black_line_under; line++)
     {
-      memset (input_y, blacky, input_useful_width);
-      input_y += input_width;
+      blacken (input_y, blacky, input_useful_width);
+      input_y += input_width * sample_size;
     }
   // U COMPONENT
   for (line = 0; line < (input_black_line_above >> 1); line++)
     {
-      memset (input_u, blackuv, input_useful_width >> 1);
-      input_u += input_width >> 1;
+      blacken (input_u, blackuv, input_useful_width >> 1);
+      input_u += (input_width >> 1) * sample_size;
     }
-  right = input_u + ((input_black_col_left + input_active_width) >> 1);
+  right = input_u + ((input_black_col_left + input_active_width) >> 1) * sample_size;
   for (line = 0; line < (input_active_height >> 1); line++)
     {
-      memset (input_u, blackuv, input_black_col_left >> 1);
-      memset (right, blackuv, input_black_col_right >> 1);
-      input_u += input_width >> 1;
-      right += input_width >> 1;
+      blacken (input_u, blackuv, input_black_col_left >> 1);
+      blacken (right, blackuv, input_black_col_right >> 1);
+      input_u += (input_width >> 1) * sample_size;
+      right += (input_width >> 1) * sample_size;
     }
   for (line = 0; line < (input_black_line_under >> 1); line++)
     {
-      memset (input_u, blackuv, input_useful_width >> 1);
-      input_u += input_width >> 1;
+      blacken (input_u, blackuv, input_useful_width >> 1);
+      input_u += (input_width >> 1) * sample_size;
     }
   // V COMPONENT
   for (line = 0; line < (input_black_line_above >> 1); line++)
     {
-      memset (input_v, blackuv, input_useful_width >> 1);
-      input_v += input_width >> 1;
+      blacken (input_v, blackuv, input_useful_width >> 1);
+      input_v += (input_width >> 1) * sample_size;
     }
-  right = input_v + ((input_black_col_left + input_active_width) >> 1);
+  right = input_v + ((input_black_col_left + input_active_width) >> 1) * sample_size;
   for (line = 0; line < (input_active_height >> 1); line++)
     {
-      memset (input_v, blackuv, input_black_col_left >> 1);
-      memset (right, blackuv, input_black_col_right >> 1);
-      input_v += input_width >> 1;
-      right += input_width >> 1;
+      blacken (input_v, blackuv, input_black_col_left >> 1);
+      blacken (right, blackuv, input_black_col_right >> 1);
+      input_v += (input_width >> 1) * sample_size;
+      right += (input_width >> 1) * sample_size;
     }
   for (line = 0; line < (input_black_line_under >> 1); line++)
     {
-      memset (input_v, blackuv, input_useful_width >> 1);
-      input_v += input_width >> 1;
+      blacken (input_v, blackuv, input_useful_width >> 1);
+      input_v += (input_width >> 1) * sample_size;
     }
   return (0);
 }
@@ -504,7 +501,7 @@ blackout (uint8_t * input_y, uint8_t * input_u, uint8_t * input_v)
 
 
 // *************************************************************************************
-void
+int
 handle_args_global (int argc, char *argv[])
 {
   // This function takes care of the global variables 
@@ -554,7 +551,7 @@ handle_args_global (int argc, char *argv[])
     }
   if (optind != argc)
     yuvscaler_print_usage (argv);
-
+  return verbose;
 }
 
 
@@ -1145,83 +1142,65 @@ handle_args_dependent (int argc, char *argv[])
 
 
 // *************************************************************************************
-// MAIN
+// THE SCALER
 // *************************************************************************************
-int
-main (int argc, char *argv[])
-{
-  int input_fd = 0;
-  int output_fd = 1;
+// Its state, set up by yuvscaler_init () for the frames of one stream
+static unsigned int *height_coeff = NULL, *width_coeff = NULL;
+static uint8_t *input = NULL, *output = NULL, *display = NULL,
+  *padded_input = NULL, *padded_bottom = NULL, *padded_top = NULL;
+static uint8_t *input_y, *input_u, *input_v;
+static uint8_t *output_y, *output_u, *output_v;
+static uint8_t *frame_y, *frame_u, *frame_v;
+static int swap_output = 0;	// =1 on big endian machines, for samples of more than 8 bits
+
+// SPECIFIC TO BICUBIC
+static unsigned int *in_line = NULL, *in_col = NULL;
+static int16_t *cspline_w=NULL,*cspline_h=NULL;
+static uint16_t left_offset=0,top_offset=0,right_offset=0,bottom_offset=0;
+static uint16_t width_pad=0,width_neighbors=0,height_neighbors=0;
+// On constate que souvent, le dernier coeff cspline est nul => 
+// pas la peine de le prendre en compte dans les calculs
+// Attention ! optimisation vitesse yuvscaler_bicubic.c suppose que zero_width_neighbors=0 ou 1 seulement
+static uint8_t zero_width_neighbors=1,zero_height_neighbors=1;
 
-//  DDD and time use
-//   int input_fd  = open("./yuvscaler.input",O_RDONLY);
-//   int output_fd = open("./yuvscaler.output",O_WRONLY);
-// DDD use
 
-  int err = Y4M_OK, nb;
+int
+yuvscaler_init (int argc, char *argv[], const y4m_stream_info_t *in_si,
+		y4m_stream_info_t *out_si)
+{
+  int nb;
   unsigned long int i, j, h, w;
-
-  long int frame_num = 0;
-  unsigned int *height_coeff = NULL, *width_coeff = NULL;
-  uint8_t *input = NULL, *output = NULL,
-    *padded_input = NULL, *padded_bottom = NULL, *padded_top = NULL;
-  uint8_t *input_y, *input_u, *input_v;
-  uint8_t *output_y, *output_u, *output_v;
-  uint8_t *frame_y, *frame_u, *frame_v;
-  uint8_t **frame_y_p = NULL, **frame_u_p = NULL, **frame_v_p = NULL;	// size is not yet known => pointer of pointer
   uint8_t *u_c_p;		//u_c_p = uint8_t pointer
   unsigned int divider;
 
   // SPECIFIC TO BICUBIC
-  unsigned int *in_line = NULL, *in_col = NULL, out_line, out_col;
+  unsigned int out_line, out_col;
   unsigned long int somme;
   float *a = NULL, *b = NULL;
-  int16_t *cspline_w=NULL,*cspline_h=NULL;
-  uint16_t width_offset=0,height_offset=0,left_offset=0,top_offset=0,right_offset=0,bottom_offset=0;
-  uint16_t height_pad=0,width_pad=0,width_neighbors=0,height_neighbors=0;
-   // On constate que souvent, le dernier coeff cspline est nul => 
-   // pas la peine de le prendre en compte dans les calculs
-   // Attention ! optimisation vitesse yuvscaler_bicubic.c suppose que zero_width_neighbors=0 ou 1 seulement
-  uint8_t zero_width_neighbors=1,zero_height_neighbors=1;
+  uint16_t width_offset=0,height_offset=0;
+  uint16_t height_pad=0;
   float width_scale,height_scale;
   int16_t cspline_value = 0;
   int16_t *pointer;
      
 
   // SPECIFIC TO YUV4MPEG 
-  unsigned long int nb_pixels;
-  y4m_frame_info_t frameinfo;
   y4m_stream_info_t in_streaminfo;
-  y4m_stream_info_t out_streaminfo;
   y4m_ratio_t frame_rate = y4m_fps_UNKNOWN;
 
-  // Initialisation of global variables that are independent of the input stream, input_file in particular
-  handle_args_global (argc, argv);
-
-  // Information output
-  if (verbose)
-     {
-     mjpeg_info ("yuvscaler %s %s", PACKAGE_VERSION, yuvscaler_VERSION);
-     mjpeg_info ("(C) 2001-2004 Xavier Biquard <xbiquard@free.fr>, yuvscaler -h for help, or man yuvscaler");
-     }
-
-  // mjpeg tools global initialisations
-  mjpeg_default_handler_verbosity (verbose);
   y4m_init_stream_info (&in_streaminfo);
-  y4m_init_stream_info (&out_streaminfo);
-  y4m_init_frame_info (&frameinfo);
+  y4m_copy_stream_info (&in_streaminfo, in_si);
 
 
   // ***************************************************************
   // Get video stream informations (size, framerate, interlacing, sample aspect ratio).
-  // The in_streaminfo structure is filled in accordingly 
   // ***************************************************************
-  if (y4m_read_stream_header (input_fd, &in_streaminfo) != Y4M_OK)
-    mjpeg_error_exit1 ("Could'nt read YUV4MPEG header!");
   input_width = y4m_si_get_width (&in_streaminfo);
   input_height = y4m_si_get_height (&in_streaminfo);
   frame_rate = y4m_si_get_framerate (&in_streaminfo);
   interlaced = y4m_si_get_interlace (&in_streaminfo);
+  bitdepth = y4m_si_get_bitdepth (&in_streaminfo);
+  sample_size = y4m_si_get_sample_size (&in_streaminfo);
   // ***************************************************************
 
 
@@ -1409,6 +1388,9 @@ main (int argc, char *argv[])
       if ((input_height_slice == 8) && (output_height_slice == 3)
 	  && (input_width_slice == 2) && (output_width_slice == 1))
 	specific = 8;
+      // average_deep does every ratio
+      if (sample_size > 1)
+	specific = 0;
       if (specific)
 	mjpeg_info ("Specific downscaling routing number %u", specific);
 
@@ -1577,6 +1559,11 @@ main (int argc, char *argv[])
 	  (int32_t *) ((((unsigned long int) mmx_res / ALIGNEMENT) + 1) *
 		       ALIGNEMENT);
        
+       if (mmx==1 && sample_size > 1)
+	 {
+	    mmx=0;
+	    mjpeg_info("No MMX treatment for samples of more than 8 bits");
+	 }
        if (mmx==1)
 	 {
 	    if (width_neighbors <= MAXWIDTHNEIGHBORS)
@@ -1660,7 +1647,7 @@ main (int argc, char *argv[])
 	{
 	  if (!(padded_input =
 		(uint8_t *) malloc ((input_useful_width + width_neighbors) *
-				    (input_useful_height + height_neighbors)+2*ALIGNEMENT)))
+				    (input_useful_height + height_neighbors) * sample_size +2*ALIGNEMENT)))
 	    mjpeg_error_exit1
 	      ("Could not allocate memory for padded_input table. STOP!");
 	}
@@ -1668,10 +1655,10 @@ main (int argc, char *argv[])
 	{
 	  if (!(padded_top =
 		(uint8_t *) malloc ((input_useful_width + width_neighbors) *
-				    (input_useful_height / 2 + height_neighbors)+2*ALIGNEMENT)) ||
+				    (input_useful_height / 2 + height_neighbors) * sample_size +2*ALIGNEMENT)) ||
 	      !(padded_bottom =
 		(uint8_t *) malloc ((input_useful_width + width_neighbors) *
-				    (input_useful_height / 2 + height_neighbors)+2*ALIGNEMENT)))
+				    (input_useful_height / 2 + height_neighbors) * sample_size +2*ALIGNEMENT)))
 	    mjpeg_error_exit1
 	      ("Could not allocate memory for padded_top|bottom tables. STOP!");
 	}
@@ -1685,8 +1672,8 @@ main (int argc, char *argv[])
 
 
   // Pointers allocations
-  if (!(input = malloc (((input_width * input_height * 3) / 2) + ALIGNEMENT)) ||
-      !(output = malloc (((output_width * output_height * 3) / 2) + ALIGNEMENT))
+  if (!(input = malloc (((input_width * input_height * 3) / 2) * sample_size + ALIGNEMENT)) ||
+      !(output = malloc (((output_width * output_height * 3) / 2) * sample_size + ALIGNEMENT))
       )
     mjpeg_error_exit1
       ("Could not allocate memory for input or output tables. STOP!");
@@ -1702,14 +1689,15 @@ main (int argc, char *argv[])
   mjpeg_debug ("after alignement: input=%p output=%p", input, output);
 
 
-  // if skip_col==1
-  if (!(frame_y_p = (uint8_t **) malloc (display_height * sizeof (uint8_t *)))
-      || !(frame_u_p =
-	   (uint8_t **) malloc (display_height / 2 * sizeof (uint8_t *)))
-      || !(frame_v_p =
-	   (uint8_t **) malloc (display_height / 2 * sizeof (uint8_t *))))
+  // the display frame, if parts of the output frame are not displayed
+  // or, on big endian machines, for the output frame of samples of more than 8 bits in their byte order
+#ifdef WORDS_BIGENDIAN
+  swap_output = sample_size > 1;
+#endif
+  if ((skip == 1 || swap_output) &&
+      !(display = malloc (((display_width * display_height * 3) / 2) * sample_size)))
     mjpeg_error_exit1
-      ("Could not allocate memory for frame_y_p, frame_u_p or frame_v_p tables. STOP!");
+      ("Could not allocate memory for display table. STOP!");
 
   // Incorporate blacks lines and columns directly into output matrix since this will never change. 
   // BLACK pixel in YUV = (16,128,128)
@@ -1718,71 +1706,71 @@ main (int argc, char *argv[])
       u_c_p = output;
       // Y component
       for (i = 0; i < output_black_line_above * output_width; i++)
-	*(u_c_p++) = blacky;
+	u_c_p = put_sample (u_c_p, blacky);
       if (black_col == 0)
-	u_c_p += output_active_height * output_width;
+	u_c_p += output_active_height * output_width * sample_size;
       else
 	{
 	  for (i = 0; i < output_active_height; i++)
 	    {
 	      for (j = 0; j < output_black_col_left; j++)
-		*(u_c_p++) = blacky;
-	      u_c_p += output_active_width;
+		u_c_p = put_sample (u_c_p, blacky);
+	      u_c_p += output_active_width * sample_size;
 	      for (j = 0; j < output_black_col_right; j++)
-		*(u_c_p++) = blacky;
+		u_c_p = put_sample (u_c_p, blacky);
 	    }
 	}
       for (i = 0; i < output_black_line_under * output_width; i++)
-	*(u_c_p++) = blacky;
+	u_c_p = put_sample (u_c_p, blacky);
 
       // U component
       //   u_c_p=output+output_width*output_height;
       for (i = 0; i < output_black_line_above / 2 * output_width / 2; i++)
-	*(u_c_p++) = blackuv;
+	u_c_p = put_sample (u_c_p, blackuv);
       if (black_col == 0)
-	u_c_p += output_active_height / 2 * output_width / 2;
+	u_c_p += output_active_height / 2 * output_width / 2 * sample_size;
       else
 	{
 	  for (i = 0; i < output_active_height / 2; i++)
 	    {
 	      for (j = 0; j < output_black_col_left / 2; j++)
-		*(u_c_p++) = blackuv;
-	      u_c_p += output_active_width / 2;
+		u_c_p = put_sample (u_c_p, blackuv);
+	      u_c_p += output_active_width / 2 * sample_size;
 	      for (j = 0; j < output_black_col_right / 2; j++)
-		*(u_c_p++) = blackuv;
+		u_c_p = put_sample (u_c_p, blackuv);
 	    }
 	}
       for (i = 0; i < output_black_line_under / 2 * output_width / 2; i++)
-	*(u_c_p++) = blackuv;
+	u_c_p = put_sample (u_c_p, blackuv);
 
       // V component
       //   u_c_p=output+(output_width*output_height*5)/4;
       for (i = 0; i < output_black_line_above / 2 * output_width / 2; i++)
-	*(u_c_p++) = blackuv;
+	u_c_p = put_sample (u_c_p, blackuv);
       if (black_col == 0)
-	u_c_p += output_active_height / 2 * output_width / 2;
+	u_c_p += output_active_height / 2 * output_width / 2 * sample_size;
       else
 	{
 	  for (i = 0; i < output_active_height / 2; i++)
 	    {
 	      for (j = 0; j < output_black_col_left / 2; j++)
-		*(u_c_p++) = blackuv;
-	      u_c_p += output_active_width / 2;
+		u_c_p = put_sample (u_c_p, blackuv);
+	      u_c_p += output_active_width / 2 * sample_size;
 	      for (j = 0; j < output_black_col_right / 2; j++)
-		*(u_c_p++) = blackuv;
+		u_c_p = put_sample (u_c_p, blackuv);
 	    }
 	}
       for (i = 0; i < output_black_line_under / 2 * output_width / 2; i++)
-	*(u_c_p++) = blackuv;
+	u_c_p = put_sample (u_c_p, blackuv);
     }
 
   // MONOCHROME FRAMES
   if (mono == 1)
     {
       // the U and V components of output frame will always be 128
-      u_c_p = output + output_width * output_height;
+      u_c_p = output + output_width * output_height * sample_size;
       for (i = 0; i < 2 * output_width / 2 * output_height / 2; i++)
-	*(u_c_p++) = blackuv;
+	u_c_p = put_sample (u_c_p, blackuv);
     }
 
 
@@ -1790,47 +1778,35 @@ main (int argc, char *argv[])
   out_nb_col_slice = output_active_width / output_width_slice;
   out_nb_line_slice = output_active_height / output_height_slice;
   input_y =
-    input + input_discard_line_above * input_width + input_discard_col_left;
+    input + (input_discard_line_above * input_width + input_discard_col_left) * sample_size;
   input_u =
-    input + input_width * input_height +
-    input_discard_line_above / 2 * input_width / 2 +
-    input_discard_col_left / 2;
+    input + (input_width * input_height +
+	     input_discard_line_above / 2 * input_width / 2 +
+	     input_discard_col_left / 2) * sample_size;
   input_v =
-    input + (input_height * input_width * 5) / 4 +
-    input_discard_line_above / 2 * input_width / 2 +
-    input_discard_col_left / 2;
+    input + ((input_height * input_width * 5) / 4 +
+	     input_discard_line_above / 2 * input_width / 2 +
+	     input_discard_col_left / 2) * sample_size;
   output_y =
-    output + output_black_line_above * output_width + output_black_col_left;
+    output + (output_black_line_above * output_width + output_black_col_left) * sample_size;
   output_u =
-    output + output_width * output_height +
-    output_black_line_above / 2 * output_width / 2 +
-    output_black_col_left / 2;
+    output + (output_width * output_height +
+	      output_black_line_above / 2 * output_width / 2 +
+	      output_black_col_left / 2) * sample_size;
   output_v =
-    output + (output_width * output_height * 5) / 4 +
-    output_black_line_above / 2 * output_width / 2 +
-    output_black_col_left / 2;
+    output + ((output_width * output_height * 5) / 4 +
+	      output_black_line_above / 2 * output_width / 2 +
+	      output_black_col_left / 2) * sample_size;
 
   // Other initialisations for frame output
   frame_y =
-    output + output_skip_line_above * output_width + output_skip_col_left;
+    output + (output_skip_line_above * output_width + output_skip_col_left) * sample_size;
   frame_u =
-    output + output_width * output_height +
-    output_skip_line_above / 2 * output_width / 2 + output_skip_col_left / 2;
+    output + (output_width * output_height +
+	      output_skip_line_above / 2 * output_width / 2 + output_skip_col_left / 2) * sample_size;
   frame_v =
-    output + (output_width * output_height * 5) / 4 +
-    output_skip_line_above / 2 * output_width / 2 + output_skip_col_left / 2;
-  if (skip_col == 1)
-    {
-      for (i = 0; i < display_height; i++)
-	frame_y_p[i] = frame_y + i * output_width;
-      for (i = 0; i < display_height / 2; i++)
-	{
-	  frame_u_p[i] = frame_u + i * output_width / 2;
-	  frame_v_p[i] = frame_v + i * output_width / 2;
-	}
-    }
-
-  nb_pixels = (input_width * input_height * 3) / 2;
+    output + ((output_width * output_height * 5) / 4 +
+	      output_skip_line_above / 2 * output_width / 2 + output_skip_col_left / 2) * sample_size;
 
   mjpeg_debug ("End of Initialisation");
   // END OF INITIALISATION
@@ -1838,203 +1814,227 @@ main (int argc, char *argv[])
   // END OF INITIALISATION
 
 
-  // SCALE AND OUTPUT FRAMES 
-  // Output file header
-  y4m_copy_stream_info (&out_streaminfo, &in_streaminfo);
-  y4m_si_set_width (&out_streaminfo, display_width);
-  y4m_si_set_height (&out_streaminfo, display_height);
-  y4m_si_set_interlace (&out_streaminfo, interlaced);
-  y4m_si_set_sampleaspect (&out_streaminfo,
+  // Output stream info
+  y4m_copy_stream_info (out_si, &in_streaminfo);
+  y4m_si_set_width (out_si, display_width);
+  y4m_si_set_height (out_si, display_height);
+  y4m_si_set_interlace (out_si, interlaced);
+  y4m_si_set_sampleaspect (out_si,
 			   yuvscaler_calculate_output_sar (output_width_slice,
 							   output_height_slice,
 							   input_width_slice,
 							   input_height_slice,
 							   y4m_si_get_sampleaspect
 							   (&in_streaminfo)));
-  if (no_header == 0)
-    y4m_write_stream_header (output_fd, &out_streaminfo);
-  y4m_log_stream_info (mjpeg_loglev_t("info"), "output: ", &out_streaminfo);
-   
-  
-   
+  y4m_log_stream_info (mjpeg_loglev_t("info"), "output: ", out_si);
+  y4m_fini_stream_info (&in_streaminfo);
+  return 0;
+}
 
-  // Master loop : continue until there is no next frame in stdin
-  while ((err = yuvscaler_y4m_read_frame
-	  (input_fd, &in_streaminfo, &frameinfo, nb_pixels, input)) == Y4M_OK)
-    {
-      mjpeg_info ("Frame number %ld", frame_num);
 
-      // Blackout if necessary
-      if (input_black == 1)
-	blackout (input_y, input_u, input_v);
-      frame_num++;
+// *************************************************************************************
+uint8_t *
+yuvscaler_input (void)
+{
+  // The planes of an input frame, one after the other
+  return input;
+}
+
+
+// *************************************************************************************
+static void
+swap_samples (uint8_t * to, const uint8_t * from, unsigned long int nb)
+{
+  // nb samples of 2 bytes from "from" to "to", the other byte first (to may be from)
+  uint16_t *p = (uint16_t *) to;
+  const uint16_t *q = (const uint16_t *) from;
+
+  while (nb--)
+    {
+      *p = (uint16_t) ((*q >> 8) | (*q << 8));
+      p++;
+      q++;
+    }
+}
 
-      // Output Frame Header
-      if (y4m_write_frame_header (output_fd, &out_streaminfo, &frameinfo) != Y4M_OK)
-	goto out_error;
 
+// *************************************************************************************
+static void
+scale_frame_deep (void)
+{
+  // The frame scaling of yuvscaler_frame, for samples of more than 8 bits
+  uint16_t *in[3] = { (uint16_t *) input_y, (uint16_t *) input_u, (uint16_t *) input_v };
+  uint16_t *out[3] = { (uint16_t *) output_y, (uint16_t *) output_u, (uint16_t *) output_v };
+  unsigned int c, nb = mono ? 1 : 3;
 
-      // ***************
-      // SCALE THE FRAME
-      // ***************
-      // RESAMPLE ALGORITHM       
-      // ***************
+  for (c = 0; c < nb; c++)
+    {
       if (algorithm == 0)
+	average_deep (in[c], out[c], height_coeff, width_coeff, c > 0);
+      else if (interlaced != Y4M_ILACE_NONE)
 	{
-	  if (specific) 
-	     {
-		average_specific (input_y, output_y, height_coeff,width_coeff, 0);
-		if (!mono) 
-		  {
-		     average_specific (input_u, output_u, height_coeff,
-				       width_coeff, 1);
-		     average_specific (input_v, output_v, height_coeff,
-				       width_coeff, 1);
-		  }
-	     }
-	   else 
-	     {
-		average (input_y, output_y, height_coeff, width_coeff, 0);
-		if (!mono) 
-		  {
-		  average (input_u, output_u, height_coeff, width_coeff, 1);
-		  average (input_v, output_v, height_coeff, width_coeff, 1);
-		  }
-	     }
-	}
-      // ***************
-      // RESAMPLE ALGO
-      // ***************
-      // BICIBIC ALGO
-      // ***************
-      if (algorithm == 1)
-	{
-	   // INPUT FRAME PADDING BEFORE BICUBIC INTERPOLATION
-	   // PADDING IS DONE SEPARATELY FOR EACH COMPONENT
-	   // 
-	   if (interlaced != Y4M_ILACE_NONE)
-	     {
-		padding_interlaced (padded_top, padded_bottom, input_y, 0,left_offset,top_offset,right_offset,bottom_offset,width_pad);
-		cubic_scale_interlaced (padded_top, padded_bottom, output_y, 
-					in_col, in_line,
-					cspline_w, width_neighbors, zero_width_neighbors,
-					cspline_h, height_neighbors, zero_height_neighbors,
-					0);
-		if (!mono) 
-		  {
-		     padding_interlaced (padded_top, padded_bottom, input_u, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
-		     cubic_scale_interlaced (padded_top, padded_bottom, output_u, 
-					     in_col, in_line,
-					     cspline_w, width_neighbors,zero_width_neighbors,
-					     cspline_h, height_neighbors,zero_height_neighbors,
-					     1);
-		     padding_interlaced (padded_top, padded_bottom, input_v, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
-		     cubic_scale_interlaced (padded_top, padded_bottom, output_v, 
-					     in_col, in_line,
-					     cspline_w, width_neighbors,zero_width_neighbors,
-					     cspline_h, height_neighbors,zero_height_neighbors,
-					     1);
-		  }
-	     }
-	   else
-	     {
-		padding (padded_input, input_y, 0,left_offset,top_offset,right_offset,bottom_offset,width_pad);
-		cubic_scale (padded_input, output_y, 
-			     in_col, in_line,
-			     cspline_w, width_neighbors,  zero_width_neighbors,
-			     cspline_h, height_neighbors, zero_height_neighbors,
-			     0);
-		if (!mono) 
-		  {
-		     padding (padded_input, input_u, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
-		     cubic_scale (padded_input, output_u, 
-				  in_col, in_line,
-				  cspline_w, width_neighbors, zero_width_neighbors,
-				  cspline_h, height_neighbors, zero_height_neighbors,
-				  1);
-		     padding (padded_input, input_v, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
-		     cubic_scale (padded_input, output_v, 
-				  in_col, in_line,
-				  cspline_w, width_neighbors, zero_width_neighbors,
-				  cspline_h, height_neighbors, zero_height_neighbors,
-				  1);
-		  }
-	     }
-	}
-      // ***************
-      // BICIBIC ALGO
-      // ***************
-      // END OF SCALE THE FRAME
-      // **********************
-
-      // OUTPUT FRAME CONTENTS
-      if (skip == 0)
-	{
-	  // Here, display=output_active 
-	  if (y4m_write
-	      (output_fd, output,
-	       (display_width * display_height * 3) / 2) != Y4M_OK)
-	    goto out_error;
+	  padding_interlaced_deep ((uint16_t *) padded_top, (uint16_t *) padded_bottom, in[c], c > 0,
+				   left_offset, top_offset, right_offset, bottom_offset, width_pad);
+	  cubic_scale_interlaced_deep ((uint16_t *) padded_top, (uint16_t *) padded_bottom, out[c],
+				       in_col, in_line,
+				       cspline_w, width_neighbors, zero_width_neighbors,
+				       cspline_h, height_neighbors, zero_height_neighbors,
+				       c > 0);
 	}
       else
 	{
-	  // skip == 1
-	  if (skip_col == 0)
-	    {
-	      // output_active_width==display_width, component per component frame output
-	      if (y4m_write
-		  (output_fd, frame_y,
-		   display_width * display_height) != Y4M_OK)
-		goto out_error;
-	      if (y4m_write
-		  (output_fd, frame_u,
-		   display_width / 2 * display_height / 2) != Y4M_OK)
-		goto out_error;
-	      if (y4m_write
-		  (output_fd, frame_v,
-		   display_width / 2 * display_height / 2) != Y4M_OK)
-		goto out_error;
-	    }
-	  else
-	    {
-	      // output_active_width > display_width, line per line frame output for each component
-	      for (i = 0; i < display_height; i++)
-		{
-		  if (y4m_write (output_fd, frame_y_p[i], display_width)
-		      != Y4M_OK)
-		    goto out_error;
-		}
-	      for (i = 0; i < display_height / 2; i++)
-		{
-		  if (y4m_write
-		      (output_fd, frame_u_p[i], display_width / 2) != Y4M_OK)
-		    goto out_error;
-		}
-	      for (i = 0; i < display_height / 2; i++)
-		{
-		  if (y4m_write
-		      (output_fd, frame_v_p[i], display_width / 2) != Y4M_OK)
-		    goto out_error;
-
-		}
-	    }
+	  padding_deep ((uint16_t *) padded_input, in[c], c > 0,
+			left_offset, top_offset, right_offset, bottom_offset, width_pad);
+	  cubic_scale_deep ((uint16_t *) padded_input, out[c],
+			    in_col, in_line,
+			    cspline_w, width_neighbors, zero_width_neighbors,
+			    cspline_h, height_neighbors, zero_height_neighbors,
+			    c > 0);
 	}
     }
-  // End of master loop => no more frame in stdin
+}
 
-  if (err != Y4M_ERR_EOF)
-    mjpeg_error_exit1 ("Couldn't read frame number %ld!", frame_num);
-  else
-    mjpeg_info ("Normal exit: end of stream with frame number %ld!",
-		frame_num);
-  y4m_fini_stream_info (&in_streaminfo);
-  y4m_fini_stream_info (&out_streaminfo);
-  y4m_fini_frame_info (&frameinfo);
-  return 0;
 
-out_error:
-  mjpeg_error_exit1 ("Unable to write to output - aborting!");
-  return 1;
+// *************************************************************************************
+const uint8_t *
+yuvscaler_frame (void)
+{
+  unsigned long int i;
+  uint8_t *u_c_p;
+
+  // Samples of more than 8 bits are scaled in the byte order of the machine
+  if (swap_output)
+    swap_samples (input, input, (input_width * input_height * 3) / 2);
+
+  // Blackout if necessary
+  if (input_black == 1)
+    blackout (input_y, input_u, input_v);
+
+  // ***************
+  // SCALE THE FRAME
+  // ***************
+  // RESAMPLE ALGORITHM       
+  // ***************
+  if (sample_size > 1)
+    scale_frame_deep ();
+  else if (algorithm == 0)
+    {
+      if (specific) 
+	 {
+	    average_specific (input_y, output_y, height_coeff,width_coeff, 0);
+	    if (!mono) 
+	      {
+		 average_specific (input_u, output_u, height_coeff,
+				   width_coeff, 1);
+		 average_specific (input_v, output_v, height_coeff,
+				   width_coeff, 1);
+	      }
+	 }
+       else 
+	 {
+	    average (input_y, output_y, height_coeff, width_coeff, 0);
+	    if (!mono) 
+	      {
+	      average (input_u, output_u, height_coeff, width_coeff, 1);
+	      average (input_v, output_v, height_coeff, width_coeff, 1);
+	      }
+	 }
+    }
+  // ***************
+  // RESAMPLE ALGO
+  // ***************
+  // BICIBIC ALGO
+  // ***************
+  else if (algorithm == 1)
+    {
+       // INPUT FRAME PADDING BEFORE BICUBIC INTERPOLATION
+       // PADDING IS DONE SEPARATELY FOR EACH COMPONENT
+       // 
+       if (interlaced != Y4M_ILACE_NONE)
+	 {
+	    padding_interlaced (padded_top, padded_bottom, input_y, 0,left_offset,top_offset,right_offset,bottom_offset,width_pad);
+	    cubic_scale_interlaced (padded_top, padded_bottom, output_y, 
+				    in_col, in_line,
+				    cspline_w, width_neighbors, zero_width_neighbors,
+				    cspline_h, height_neighbors, zero_height_neighbors,
+				    0);
+	    if (!mono) 
+	      {
+		 padding_interlaced (padded_top, padded_bottom, input_u, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
+		 cubic_scale_interlaced (padded_top, padded_bottom, output_u, 
+					 in_col, in_line,
+					 cspline_w, width_neighbors,zero_width_neighbors,
+					 cspline_h, height_neighbors,zero_height_neighbors,
+					 1);
+		 padding_interlaced (padded_top, padded_bottom, input_v, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
+		 cubic_scale_interlaced (padded_top, padded_bottom, output_v, 
+					 in_col, in_line,
+					 cspline_w, width_neighbors,zero_width_neighbors,
+					 cspline_h, height_neighbors,zero_height_neighbors,
+					 1);
+	      }
+	 }
+       else
+	 {
+	    padding (padded_input, input_y, 0,left_offset,top_offset,right_offset,bottom_offset,width_pad);
+	    cubic_scale (padded_input, output_y, 
+			 in_col, in_line,
+			 cspline_w, width_neighbors,  zero_width_neighbors,
+			 cspline_h, height_neighbors, zero_height_neighbors,
+			 0);
+	    if (!mono) 
+	      {
+		 padding (padded_input, input_u, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
+		 cubic_scale (padded_input, output_u, 
+			      in_col, in_line,
+			      cspline_w, width_neighbors, zero_width_neighbors,
+			      cspline_h, height_neighbors, zero_height_neighbors,
+			      1);
+		 padding (padded_input, input_v, 1,left_offset,top_offset,right_offset,bottom_offset,width_pad);
+		 cubic_scale (padded_input, output_v, 
+			      in_col, in_line,
+			      cspline_w, width_neighbors, zero_width_neighbors,
+			      cspline_h, height_neighbors, zero_height_neighbors,
+			      1);
+	      }
+	 }
+    }
+  // ***************
+  // BICIBIC ALGO
+  // ***************
+  // END OF SCALE THE FRAME
+  // **********************
+
+  // OUTPUT FRAME CONTENTS
+  // Here, display=output_active
+  if (skip == 0)
+    {
+      if (!swap_output)
+	return output;
+      swap_samples (display, output, (display_width * display_height * 3) / 2);
+      return display;
+    }
+
+  // Otherwise, the displayed part of each component, line per line
+  u_c_p = display;
+  for (i = 0; i < display_height; i++)
+    {
+      memcpy (u_c_p, frame_y + i * output_width * sample_size, display_width * sample_size);
+      u_c_p += display_width * sample_size;
+    }
+  for (i = 0; i < display_height / 2; i++)
+    {
+      memcpy (u_c_p, frame_u + i * output_width / 2 * sample_size, display_width / 2 * sample_size);
+      u_c_p += display_width / 2 * sample_size;
+    }
+  for (i = 0; i < display_height / 2; i++)
+    {
+      memcpy (u_c_p, frame_v + i * output_width / 2 * sample_size, display_width / 2 * sample_size);
+      u_c_p += display_width / 2 * sample_size;
+    }
+  if (swap_output)
+    swap_samples (display, display, (display_width * display_height * 3) / 2);
+  return display;
 }
 
 
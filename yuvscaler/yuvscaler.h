@@ -1,20 +1,37 @@
-// yuvscaler.c
+// yuvscaler.c: the scaler, without the stream handling, also used by yuvfilters/y4mchain
+//   handle_args_global (argc, argv);                    returns the -v verbosity
+//   yuvscaler_init (argc, argv, &in_streaminfo, &out_streaminfo);
+//   for every frame:
+//     put its 4:2:0 planes, one after the other, where yuvscaler_input () points
+//     the output frame of out_streaminfo's size is at yuvscaler_frame ()
+// Samples of more than 8 bits take 2 bytes, least significant first, in
+// both frames; they are scaled by the _deep functions below.
+// Its settings are global variables, so there is one scaler per process.
+// Wrong options are fatal (mjpeg_error_exit1).
+int handle_args_global (int argc, char *argv[]);
+int yuvscaler_init (int argc, char *argv[], const y4m_stream_info_t *in_si,
+		    y4m_stream_info_t *out_si);
+uint8_t *yuvscaler_input (void);
+const uint8_t *yuvscaler_frame (void);
+
 void yuvscaler_print_usage (char *argv[]);
 void yuvscaler_print_information (y4m_stream_info_t in_streaminfo, y4m_ratio_t frame_rate);
 uint8_t yuvscaler_nearest_integer_division (unsigned long int, unsigned long int);
 //static y4m_ratio_t yuvscaler_calculate_output_sar (int out_w, int out_h,
 //				int in_w, int in_h, y4m_ratio_t in_sar);
-int yuvscaler_y4m_read_frame (int fd, y4m_stream_info_t *, y4m_frame_info_t * frameinfo,unsigned long int buflen, uint8_t * buf);
 int blackout(uint8_t *input_y,uint8_t *input_u,uint8_t *input_v);
-void handle_args_global (int argc, char *argv[]);
 void handle_args_dependent (int argc, char *argv[]);
-int main (int argc, char *argv[]);
 unsigned int pgcd(unsigned int,unsigned int);
 
+// main.c
+int yuvscaler_y4m_read_frame (int fd, y4m_stream_info_t *, y4m_frame_info_t * frameinfo,unsigned long int buflen, uint8_t * buf);
+int main (int argc, char *argv[]);
+
 // yuvscaler_resample.c
 int average_coeff(unsigned int,unsigned int,unsigned int *);
 int average(unsigned char *,unsigned char *, unsigned int *, unsigned int *,unsigned int);
 int average_specific(unsigned char *,unsigned char *, unsigned int *, unsigned int *, unsigned int);
+int average_deep(uint16_t *,uint16_t *, unsigned int *, unsigned int *,unsigned int);
 
 // yuvscaler_bicubic.c
 int16_t cubic_spline(float,unsigned int);
@@ -37,3 +54,21 @@ int cubic_scale (uint8_t *, uint8_t *,
 			    int16_t *, uint16_t, uint8_t,
 			    int16_t *, uint16_t, uint8_t,
 			    unsigned int);
+int
+padding_interlaced_deep (uint16_t * padded_top, uint16_t * padded_bottom, uint16_t * input, unsigned int half,
+			 uint16_t left_offset, uint16_t top_offset, uint16_t right_offset, uint16_t bottom_offset,
+			 uint16_t width_pad);
+int
+padding_deep (uint16_t * padded_input, uint16_t * input, unsigned int half,
+	      uint16_t left_offset, uint16_t top_offset, uint16_t right_offset, uint16_t bottom_offset,
+	      uint16_t width_pad);
+int cubic_scale_interlaced_deep (uint16_t *, uint16_t *, uint16_t *,
+				 unsigned int *, unsigned int *,
+				 int16_t *, uint16_t, uint8_t,
+				 int16_t *, uint16_t, uint8_t,
+				 unsigned int);
+int cubic_scale_deep (uint16_t *, uint16_t *,
+		      unsigned int *, unsigned int *,
+		      int16_t *, uint16_t, uint8_t,
+		      int16_t *, uint16_t, uint8_t,
+		      unsigned int);
@@ -61,6 +61,7 @@ extern int mmx;			// =1 for mmx activated
 // MMX test
 
 extern int32_t *intermediate;
+extern int bitdepth;
 
 // *************************************************************************************
 int
@@ -819,6 +820,225 @@ padding_interlaced (uint8_t * padded_top, uint8_t * padded_bottom, uint8_t * inp
 
 }
 
+// *************************************************************************************
+
+// *************************************************************************************
+// SAMPLES OF MORE THAN 8 BITS
+// *************************************************************************************
+// The _deep functions below do what their 8-bit counterparts do, in plain C, on uint16_t samples.
+// As the two fields of an interlaced frame are scaled the same way, each field is scaled as a frame of its own
+
+static uint16_t *
+fill_deep (uint16_t * p, uint16_t value, unsigned long int nb)
+{
+  while (nb--)
+    *(p++) = value;
+  return (p);
+}
+
+static uint16_t
+clip_deep (int64_t value, unsigned int power, int32_t maximum)
+{
+  // value is already rounded, that is FLOAT2INTOFFSET or DBLEFLOAT2INTOFFSET is in it
+  if (value < 0)
+    return (0);
+  value >>= power;
+  if (value > maximum)
+    return (maximum);
+  return ((uint16_t) value);
+}
+
+// *************************************************************************************
+static void
+cubic_scale_frame_deep (uint16_t * padded_input, unsigned int padded_width, unsigned int padded_height,
+			uint16_t * output, unsigned int output_stride,
+			unsigned int active_width, unsigned int active_height,
+			unsigned int *in_col, unsigned int *in_line,
+			int16_t * cspline_w, uint16_t width_neighbors, uint8_t zero_width_neighbors,
+			int16_t * cspline_h, uint16_t height_neighbors, uint8_t zero_height_neighbors)
+{
+  // There are width_neighbors (height_neighbors) coefficients per output column (line) in cspline_w (cspline_h),
+  // the last of which is not used if zero_width_neighbors (zero_height_neighbors)
+  int32_t maximum = (1 << bitdepth) - 1;
+  unsigned int nb_w = width_neighbors - zero_width_neighbors;
+  unsigned int nb_h = height_neighbors - zero_height_neighbors;
+  unsigned int out_line, out_col, w, h;
+  uint16_t *line, *output_p;
+  int16_t *cspline;
+  int32_t *intermediate_p;
+  int64_t value;
+
+  switch (specific)
+    {
+    case 0:
+      // First scale along the width, into intermediate, then along the height.
+      // The second sums may be larger than 32 bits
+      intermediate_p = intermediate;
+      for (out_line = 0; out_line < padded_height; out_line++)
+	for (out_col = 0; out_col < active_width; out_col++)
+	  {
+	    line = padded_input + out_line * padded_width + in_col[out_col];
+	    cspline = cspline_w + out_col * width_neighbors;
+	    value = 0;
+	    for (w = 0; w < nb_w; w++)
+	      value += line[w] * cspline[w];
+	    *(intermediate_p++) = (int32_t) value;
+	  }
+      for (out_line = 0; out_line < active_height; out_line++)
+	{
+	  output_p = output + out_line * output_stride;
+	  cspline = cspline_h + out_line * height_neighbors;
+	  for (out_col = 0; out_col < active_width; out_col++)
+	    {
+	      intermediate_p = intermediate + in_line[out_line] * active_width + out_col;
+	      value = 0;
+	      for (h = 0; h < nb_h; h++)
+		value += (int64_t) intermediate_p[h * active_width] * cspline[h];
+	      *(output_p++) = clip_deep (value + DBLEFLOAT2INTOFFSET, DBLEFLOAT2INT, maximum);
+	    }
+	}
+      break;
+
+    case 1:
+      // We only scale on width, not height
+      for (out_line = 0; out_line < active_height; out_line++)
+	{
+	  output_p = output + out_line * output_stride;
+	  for (out_col = 0; out_col < active_width; out_col++)
+	    {
+	      line = padded_input + out_line * padded_width + in_col[out_col];
+	      cspline = cspline_w + out_col * width_neighbors;
+	      value = 0;
+	      for (w = 0; w < nb_w; w++)
+		value += line[w] * cspline[w];
+	      *(output_p++) = clip_deep (value + FLOAT2INTOFFSET, FLOAT2INTEGERPOWER, maximum);
+	    }
+	}
+      break;
+
+    case 5:
+      // We only scale on height, not width
+      for (out_line = 0; out_line < active_height; out_line++)
+	{
+	  output_p = output + out_line * output_stride;
+	  cspline = cspline_h + out_line * height_neighbors;
+	  for (out_col = 0; out_col < active_width; out_col++)
+	    {
+	      line = padded_input + in_line[out_line] * padded_width + out_col;
+	      value = 0;
+	      for (h = 0; h < nb_h; h++)
+		value += line[h * padded_width] * cspline[h];
+	      *(output_p++) = clip_deep (value + FLOAT2INTOFFSET, FLOAT2INTEGERPOWER, maximum);
+	    }
+	}
+      break;
+    }
+}
+
+// *************************************************************************************
+int
+cubic_scale_deep (uint16_t * padded_input, uint16_t * output,
+		  unsigned int *in_col, unsigned int *in_line,
+		  int16_t * cspline_w, uint16_t width_neighbors, uint8_t zero_width_neighbors,
+		  int16_t * cspline_h, uint16_t height_neighbors, uint8_t zero_height_neighbors,
+		  unsigned int half)
+{
+  cubic_scale_frame_deep (padded_input,
+			  (input_useful_width >> half) + width_neighbors - 1,
+			  (input_useful_height >> half) + height_neighbors - 1,
+			  output, output_width >> half,
+			  output_active_width >> half, output_active_height >> half,
+			  in_col, in_line,
+			  cspline_w, width_neighbors, zero_width_neighbors,
+			  cspline_h, height_neighbors, zero_height_neighbors);
+  return (0);
+}
+
+// *************************************************************************************
+int
+cubic_scale_interlaced_deep (uint16_t * padded_top, uint16_t * padded_bottom, uint16_t * output,
+			     unsigned int *in_col, unsigned int *in_line,
+			     int16_t * cspline_w, uint16_t width_neighbors, uint8_t zero_width_neighbors,
+			     int16_t * cspline_h, uint16_t height_neighbors, uint8_t zero_height_neighbors,
+			     unsigned int half)
+{
+  // padded_top goes to the even lines of output, padded_bottom to the odd ones
+  unsigned int local_output_width = output_width >> half;
+  unsigned int padded_width = (input_useful_width >> half) + width_neighbors - 1;
+  unsigned int padded_height = ((input_useful_height >> half) >> 1) + height_neighbors - 1;
+
+  cubic_scale_frame_deep (padded_top, padded_width, padded_height,
+			  output, 2 * local_output_width,
+			  output_active_width >> half, (output_active_height >> half) >> 1,
+			  in_col, in_line,
+			  cspline_w, width_neighbors, zero_width_neighbors,
+			  cspline_h, height_neighbors, zero_height_neighbors);
+  cubic_scale_frame_deep (padded_bottom, padded_width, padded_height,
+			  output + local_output_width, 2 * local_output_width,
+			  output_active_width >> half, (output_active_height >> half) >> 1,
+			  in_col, in_line,
+			  cspline_w, width_neighbors, zero_width_neighbors,
+			  cspline_h, height_neighbors, zero_height_neighbors);
+  return (0);
+}
+
+// *************************************************************************************
+int
+padding_deep (uint16_t * padded_input, uint16_t * input, unsigned int half,
+	      uint16_t left_offset, uint16_t top_offset, uint16_t right_offset, uint16_t bottom_offset,
+	      uint16_t width_pad)
+{
+  unsigned int local_input_useful_width = input_useful_width >> half;
+  unsigned int local_input_useful_height = input_useful_height >> half;
+  unsigned int local_padded_width = local_input_useful_width + width_pad;
+  unsigned int local_input_width = input_width >> half;
+  unsigned int line;
+  uint16_t black = (half ? 128 : 16) << (bitdepth - 8), *pad = padded_input;
+
+  pad = fill_deep (pad, black, top_offset * local_padded_width);
+  for (line = 0; line < local_input_useful_height; line++)
+    {
+      pad = fill_deep (pad, black, left_offset);
+      memcpy (pad, input, local_input_useful_width * sizeof (uint16_t));
+      pad += local_input_useful_width;
+      input += local_input_width;
+      pad = fill_deep (pad, black, right_offset);
+    }
+  fill_deep (pad, black, bottom_offset * local_padded_width);
+  return (0);
+}
+
+// *************************************************************************************
+int
+padding_interlaced_deep (uint16_t * padded_top, uint16_t * padded_bottom, uint16_t * input, unsigned int half,
+			 uint16_t left_offset, uint16_t top_offset, uint16_t right_offset, uint16_t bottom_offset,
+			 uint16_t width_pad)
+{
+  unsigned int local_input_useful_width = input_useful_width >> half;
+  unsigned int local_input_useful_height = input_useful_height >> half;
+  unsigned int local_padded_width = local_input_useful_width + width_pad;
+  unsigned int local_input_width = input_width >> half;
+  unsigned int line;
+  uint16_t black = (half ? 128 : 16) << (bitdepth - 8);
+
+  padded_top = fill_deep (padded_top, black, top_offset * local_padded_width);
+  padded_bottom = fill_deep (padded_bottom, black, top_offset * local_padded_width);
+  for (line = 0; line < (local_input_useful_height >> 1); line++)
+    {
+      padded_top = fill_deep (padded_top, black, left_offset);
+      memcpy (padded_top, input, local_input_useful_width * sizeof (uint16_t));
+      padded_top = fill_deep (padded_top + local_input_useful_width, black, right_offset);
+      input += local_input_width;
+      padded_bottom = fill_deep (padded_bottom, black, left_offset);
+      memcpy (padded_bottom, input, local_input_useful_width * sizeof (uint16_t));
+      padded_bottom = fill_deep (padded_bottom + local_input_useful_width, black, right_offset);
+      input += local_input_width;
+    }
+  fill_deep (padded_top, black, bottom_offset * local_padded_width);
+  fill_deep (padded_bottom, black, bottom_offset * local_padded_width);
+  return (0);
+}
+
 // *************************************************************************************
 
 				  // THE FOLLOWING LINE "if (!mmx) mmx=0;" DOES NO USEFUL CALCULATION BUT
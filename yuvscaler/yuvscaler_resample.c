@@ -32,6 +32,7 @@ extern unsigned int specific;
 
 extern unsigned int out_nb_col_slice, out_nb_line_slice;
 extern uint8_t *divide;
+extern unsigned long int diviseur;
 
 // From inside MAIN function
 
@@ -354,6 +355,96 @@ average (uint8_t * input, uint8_t * output, unsigned int *height_coeff,
 
 
 
+// *************************************************************************************
+int
+average_deep (uint16_t * input, uint16_t * output, unsigned int *height_coeff,
+	      unsigned int *width_coeff, unsigned int half)
+{
+  // average for samples of more than 8 bits, whatever the downscaling ratio.
+  // A divide table for all possible sums would be far too large, so each sum is divided here,
+  // to its nearest integer as in yuvscaler_nearest_integer_division.
+  // If the output is interlaced, input and output lines go by 2, as in average
+  unsigned int local_input_width = input_width >> half;
+  unsigned int local_output_width = output_width >> half;
+  unsigned int local_out_nb_col_slice = out_nb_col_slice >> half;
+  unsigned int local_out_nb_line_slice = out_nb_line_slice >> half;
+  unsigned int step = (interlaced == Y4M_ILACE_NONE) ? 1 : 2;
+  uint16_t *input_line_p[input_height_slice];
+  uint16_t *output_line_p[output_height_slice];
+  unsigned int *H_var, *W_var, *H, *W;
+  uint16_t *u_s_p;
+  int j, nb_H, nb_W, in_line, first_line, out_line;
+  int out_col_slice, out_col;
+  int out_line_slice, line_slice;
+  int current_line, last_line;
+  unsigned long int value = 0;
+
+  for (out_line_slice = 0; out_line_slice < local_out_nb_line_slice;
+       out_line_slice++)
+    {
+      // the first line of the slice, and that of its field if interlaced
+      line_slice = (step == 1) ? out_line_slice : (out_line_slice & ~(unsigned int) 1);
+      u_s_p = input +
+	(line_slice * input_height_slice + out_line_slice % step) * local_input_width;
+      for (in_line = 0; in_line < input_height_slice; in_line++)
+	{
+	  input_line_p[in_line] = u_s_p;
+	  u_s_p += step * local_input_width;
+	}
+      u_s_p = output +
+	(line_slice * output_height_slice + out_line_slice % step) * local_output_width;
+      for (out_line = 0; out_line < output_height_slice; out_line++)
+	{
+	  output_line_p[out_line] = u_s_p;
+	  u_s_p += step * local_output_width;
+	}
+      for (out_col_slice = 0; out_col_slice < local_out_nb_col_slice;
+	   out_col_slice++)
+	{
+	  H = height_coeff;
+	  first_line = 0;
+	  for (out_line = 0; out_line < output_height_slice; out_line++)
+	    {
+	      nb_H = *H;
+	      W = width_coeff;
+	      for (out_col = 0; out_col < output_width_slice; out_col++)
+		{
+		  H_var = H + 1;
+		  nb_W = *W;
+		  value = 0;
+		  last_line = first_line + nb_H;
+		  for (current_line = first_line;
+		       current_line < last_line; current_line++)
+		    {
+		      W_var = W + 1;
+		      for (j = 0; j < nb_W - 1; j++)
+			value +=
+			  (*H_var) * (*W_var++) *
+			  (*input_line_p[current_line]++);
+		      value +=
+			(*H_var++) * (*W_var) *
+			(*input_line_p[current_line]);
+		    }
+		  *(output_line_p[out_line]++) = value / diviseur +
+		    (value % diviseur >= diviseur - diviseur / 2);
+		  W += nb_W + 1;
+		}
+	      H += nb_H + 1;
+	      first_line += nb_H - 1;
+	      input_line_p[first_line] -= input_width_slice - 1;
+	    }
+	  input_line_p[first_line] += input_width_slice - 1;
+	  for (in_line = 0; in_line < input_height_slice; in_line++)
+	    input_line_p[in_line]++;
+	}
+    }
+  return (0);
+}
+
+// *************************************************************************************
+
+
+
 // *************************************************************************************
 int
 average_specific (uint8_t * input, uint8_t * output,